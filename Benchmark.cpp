@@ -0,0 +1,249 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+using namespace DirectX;
+
+/// <summary>
+/// Splits a command line into arguments, honoring double quotes
+/// </summary>
+static std::vector<std::string> SplitCommandLine(const char* commandLine)
+{
+	std::vector<std::string> args;
+	std::string current;
+	bool inQuotes = false;
+	bool hasToken = false;
+
+	for (const char* c = commandLine; c && *c; c++)
+	{
+		if (*c == '"') { inQuotes = !inQuotes; hasToken = true; }
+		else if ((*c == ' ' || *c == '\t') && !inQuotes)
+		{
+			if (hasToken) args.push_back(current);
+			current.clear();
+			hasToken = false;
+		}
+		else { current += *c; hasToken = true; }
+	}
+
+	if (hasToken) args.push_back(current);
+	return args;
+}
+
+/// <summary>
+/// Reads benchmark settings from the command line. Unknown arguments are ignored.
+/// </summary>
+/// <param name="commandLine">The program's arguments (without the executable name)</param>
+BenchmarkOptions BenchmarkOptions::Parse(const char* commandLine)
+{
+	BenchmarkOptions options;
+	std::vector<std::string> args = SplitCommandLine(commandLine);
+
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+		bool hasValue = i + 1 < args.size();
+
+		if (arg == "-benchmark") options.Enabled = true;
+		else if (arg == "-frames" && hasValue) options.FrameCount = (unsigned int)std::max(1, atoi(args[++i].c_str()));
+		else if (arg == "-warmup" && hasValue) options.WarmupFrames = (unsigned int)std::max(0, atoi(args[++i].c_str()));
+		else if (arg == "-dt" && hasValue) options.FixedDeltaTime = std::max(0.0001f, (float)atof(args[++i].c_str()));
+		else if (arg == "-out" && hasValue) options.OutputPath = args[++i];
+		else if (arg == "-entities" && hasValue) options.Scene.EntityCount = (unsigned int)std::max(0, atoi(args[++i].c_str()));
+		else if (arg == "-seed" && hasValue) options.Scene.Seed = (unsigned int)strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "-meshes" && hasValue) options.Scene.MeshVariety = (unsigned int)std::max(0, atoi(args[++i].c_str()));
+		else if (arg == "-materials" && hasValue) options.Scene.MaterialVariety = (unsigned int)std::max(0, atoi(args[++i].c_str()));
+		else if (arg == "-depth" && hasValue) options.Scene.HierarchyDepth = (unsigned int)std::max(1, atoi(args[++i].c_str()));
+		else if (arg == "-lights" && hasValue) options.Scene.LightCount = (unsigned int)std::max(0, atoi(args[++i].c_str()));
+		else if (arg == "-motion" && hasValue) options.Scene.Motion = SceneGenerator::ParseMotion(args[++i]);
+		else if (arg == "-texturebench") options.TextureBenchmark = true;
+		else if (arg == "-repeats" && hasValue) options.TextureRepeats = (unsigned int)std::max(1, atoi(args[++i].c_str()));
+		else if (arg == "-nobatch") options.BatchMaterials = false;
+		else if (arg == "-prepass") options.DepthPrepass = true;
+		else if (arg == "-coarse") options.CoarseShading = true;
+		else if (arg == "-probeambient") options.ProbeAmbientOnly = true;
+		else if (arg == "-dynres" && hasValue) options.DynamicResolutionMs = std::max(0.0f, (float)atof(args[++i].c_str()));
+		else if (arg == "-stream" && hasValue) options.StreamBudgetMB = (unsigned int)std::max(0, atoi(args[++i].c_str()));
+		else if (arg == "-spacing" && hasValue) options.Scene.Spacing = std::max(0.1f, (float)atof(args[++i].c_str()));
+	}
+
+	return options;
+}
+
+/// <summary>
+/// Adds a keyframe. Keyframes must be added in increasing time order.
+/// </summary>
+void CameraPath::AddKeyframe(float time, XMFLOAT3 position, XMFLOAT3 pitchYawRoll)
+{
+	keyframes.push_back({ time, position, pitchYawRoll });
+}
+
+/// <summary>
+/// Time of the last keyframe, after which the path loops
+/// </summary>
+float CameraPath::GetDuration() const
+{
+	return keyframes.empty() ? 0.0f : keyframes.back().Time;
+}
+
+/// <summary>
+/// Samples the path at the given time
+/// </summary>
+/// <param name="time">Time in seconds, wrapped to the path's duration</param>
+/// <param name="position">Output position</param>
+/// <param name="pitchYawRoll">Output rotation</param>
+void CameraPath::Evaluate(float time, XMFLOAT3& position, XMFLOAT3& pitchYawRoll) const
+{
+	if (keyframes.empty())
+		return;
+
+	float duration = GetDuration();
+	if (keyframes.size() == 1 || duration <= 0.0f)
+	{
+		position = keyframes[0].Position;
+		pitchYawRoll = keyframes[0].PitchYawRoll;
+		return;
+	}
+
+	// Wrap time and find the segment it falls in
+	time = fmodf(time, duration);
+	if (time < 0.0f) time += duration;
+
+	size_t last = keyframes.size() - 1;
+	size_t seg = 0;
+	while (seg < last - 1 && time >= keyframes[seg + 1].Time)
+		seg++;
+
+	const CameraKeyframe& k1 = keyframes[seg];
+	const CameraKeyframe& k2 = keyframes[seg + 1];
+	const CameraKeyframe& k0 = keyframes[seg > 0 ? seg - 1 : 0];
+	const CameraKeyframe& k3 = keyframes[std::min(seg + 2, last)];
+
+	float segmentLength = k2.Time - k1.Time;
+	float t = segmentLength > 0.0f ? (time - k1.Time) / segmentLength : 0.0f;
+
+	XMStoreFloat3(&position, XMVectorCatmullRom(
+		XMLoadFloat3(&k0.Position), XMLoadFloat3(&k1.Position),
+		XMLoadFloat3(&k2.Position), XMLoadFloat3(&k3.Position), t));
+	XMStoreFloat3(&pitchYawRoll, XMVectorLerp(XMLoadFloat3(&k1.PitchYawRoll), XMLoadFloat3(&k2.PitchYawRoll), t));
+}
+
+/// <summary>
+/// Builds a path that circles a point twice, moving in and out and up and
+/// down while always looking at the center
+/// </summary>
+/// <param name="center">The point to circle</param>
+/// <param name="radius">Average distance from the center</param>
+/// <param name="height">Average height above the center</param>
+/// <param name="duration">Length of the whole path in seconds</param>
+CameraPath CameraPath::CreateFlythrough(XMFLOAT3 center, float radius, float height, float duration)
+{
+	CameraPath path;
+	const int keyCount = 16;
+
+	for (int i = 0; i <= keyCount; i++)
+	{
+		float t = (float)i / keyCount;
+		float angle = t * XM_2PI * 2.0f - XM_PIDIV2;	// Start in front of the center (negative Z)
+		float r = radius * (1.0f + 0.5f * sinf(t * XM_2PI * 3.0f));
+		float h = height * (1.0f + 0.75f * cosf(t * XM_2PI * 2.0f));
+
+		XMFLOAT3 pos(center.x + cosf(angle) * r, center.y + h, center.z + sinf(angle) * r);
+
+		// Look at the center. Yaw keeps increasing instead of wrapping,
+		// so linear interpolation never spins the wrong way around.
+		float dx = center.x - pos.x;
+		float dy = center.y - pos.y;
+		float dz = center.z - pos.z;
+		float pitch = atan2f(-dy, sqrtf(dx * dx + dz * dz));
+		float yaw = atan2f(dx, dz);
+		if (i > 0)
+		{
+			float previousYaw = path.keyframes.back().PitchYawRoll.y;
+			while (yaw - previousYaw > XM_PI) yaw -= XM_2PI;
+			while (yaw - previousYaw < -XM_PI) yaw += XM_2PI;
+		}
+
+		path.AddKeyframe(t * duration, pos, XMFLOAT3(pitch, yaw, 0.0f));
+	}
+
+	return path;
+}
+
+/// <summary>
+/// Formats the results as a readable table
+/// </summary>
+std::string BenchmarkReport::ToString(const BenchmarkOptions& options, const ProfileAggregator& cpuStats, const FrameStatsSummary& frames, const DrawStats& draws)
+{
+	char line[256];
+	std::string result;
+
+	snprintf(line, sizeof(line), "Benchmark: %u frames (+%u warmup) at fixed dt %.5fs\n", options.FrameCount, options.WarmupFrames, options.FixedDeltaTime);
+	result += line;
+	if (options.Scene.EntityCount > 0)
+	{
+		snprintf(line, sizeof(line), "Scene: %s\n", options.Scene.ToString().c_str());
+		result += line;
+	}
+	snprintf(line, sizeof(line), "Frame: avg %.3fms  p50 %.3fms  p95 %.3fms  p99 %.3fms  max %.3fms  hitches %u\n",
+		frames.AverageMs, frames.P50Ms, frames.P95Ms, frames.P99Ms, frames.MaxMs, frames.HitchCount);
+	result += line;
+	snprintf(line, sizeof(line), "Draws: %u calls  %u bind groups  %u instances  %u depth pre-pass calls per frame (%s)\n",
+		draws.DrawCalls, draws.BindGroups, draws.Instances, draws.DepthDrawCalls, draws.Batched ? "batched" : "per entity");
+	result += line;
+
+	for (const ProfileScopeStats& s : cpuStats.GetAllStats())
+	{
+		double mean = s.SampleCount > 0 ? s.TotalMs / s.SampleCount : 0.0;
+		snprintf(line, sizeof(line), "  %-24s mean %8.4fms  min %8.4fms  max %8.4fms\n", s.Name.c_str(), mean, s.MinMs, s.MaxMs);
+		result += line;
+	}
+
+	return result;
+}
+
+/// <summary>
+/// Writes the results as JSON so runs can be compared by scripts
+/// </summary>
+/// <returns>False if the file could not be opened</returns>
+bool BenchmarkReport::WriteJson(const std::string& path, const BenchmarkOptions& options, const ProfileAggregator& cpuStats, const FrameStatsSummary& frames, const DrawStats& draws)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	char line[512];
+	snprintf(line, sizeof(line), "{\n  \"frames\": %u,\n  \"warmupFrames\": %u,\n  \"fixedDeltaTime\": %.6f,\n", options.FrameCount, options.WarmupFrames, options.FixedDeltaTime);
+	file << line;
+	if (options.Scene.EntityCount > 0)
+	{
+		snprintf(line, sizeof(line), "  \"scene\": { \"seed\": %u, \"entities\": %u, \"meshes\": %u, \"materials\": %u, \"depth\": %u, \"lights\": %u, \"motion\": \"%s\" },\n",
+			options.Scene.Seed, options.Scene.EntityCount, options.Scene.MeshVariety, options.Scene.MaterialVariety,
+			options.Scene.HierarchyDepth, options.Scene.LightCount, SceneGenerator::GetMotionName(options.Scene.Motion));
+		file << line;
+	}
+	snprintf(line, sizeof(line), "  \"frameTime\": { \"avg_ms\": %.4f, \"min_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, \"hitches\": %u },\n",
+		frames.AverageMs, frames.MinMs, frames.P50Ms, frames.P95Ms, frames.P99Ms, frames.MaxMs, frames.HitchCount);
+	file << line;
+	snprintf(line, sizeof(line), "  \"draws\": { \"calls\": %u, \"bind_groups\": %u, \"instances\": %u, \"depth_calls\": %u, \"batched\": %s },\n",
+		draws.DrawCalls, draws.BindGroups, draws.Instances, draws.DepthDrawCalls, draws.Batched ? "true" : "false");
+	file << line;
+
+	file << "  \"cpu\": {\n";
+	const std::vector<ProfileScopeStats>& stats = cpuStats.GetAllStats();
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		const ProfileScopeStats& s = stats[i];
+		double mean = s.SampleCount > 0 ? s.TotalMs / s.SampleCount : 0.0;
+		snprintf(line, sizeof(line), "    \"%s\": { \"mean_ms\": %.5f, \"min_ms\": %.5f, \"max_ms\": %.5f, \"samples\": %llu }%s\n",
+			s.Name.c_str(), mean, s.MinMs, s.MaxMs, s.SampleCount, i + 1 < stats.size() ? "," : "");
+		file << line;
+	}
+	file << "  }\n}\n";
+
+	return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+#include "FrameStats.h"
+#include "Profiler.h"
+#include "SceneGenerator.h"
+
+// --------------------------------------------------------
+// Settings for the headless benchmark, parsed from the
+// command line, ex:
+//
+//  DX11Starter.exe -benchmark -frames 2000 -dt 0.016666 -out report.json
+//
+// The scene flags also work without -benchmark, ex:
+//
+//  DX11Starter.exe -entities 5000 -seed 7 -depth 3 -lights 32 -motion orbit
+//
+// Texture loading is timed on its own, without running any frames:
+//
+//  DX11Starter.exe -texturebench -repeats 5 -out textures.json
+//
+// -nobatch draws one entity at a time instead of instancing
+// across materials, for comparison.
+//
+// -prepass starts with the depth pre-pass on.
+//
+// -coarse lights far and small entities once per 2x2 quad
+// (interactive runs start with this on).
+//
+// -dynres <ms> scales the resolution to hold that GPU frame
+// time (benchmarks otherwise draw at full size).
+//
+// -probeambient lights the ambient term from probes' SH alone,
+// skipping the sky's prefiltered cube and BRDF table (and the
+// time to build them), for low-end setups.
+//
+// -stream <MB> streams texture mips in and out of that much
+// video memory instead of loading every mip up front (and
+// turns batching off, since texture arrays hold every mip).
+// --------------------------------------------------------
+struct BenchmarkOptions
+{
+	bool Enabled = false;
+	unsigned int FrameCount = 1000;		// Measured frames
+	unsigned int WarmupFrames = 60;		// Frames run before stats are reset
+	float FixedDeltaTime = 1.0f / 60.0f;
+	std::string OutputPath = "BenchmarkReport.json";
+	SceneSettings Scene;				// Generated scene, if Scene.EntityCount > 0
+	bool TextureBenchmark = false;		// Time texture loading instead of frames
+	unsigned int TextureRepeats = 3;	// Runs per thread count, the best is kept
+	bool BatchMaterials = true;			// Instanced draws through the material table
+	unsigned int StreamBudgetMB = 0;	// Texture streaming budget, 0 loads every mip
+	bool DepthPrepass = false;			// Depth only first, then shade with an EQUAL test
+	bool CoarseShading = false;			// Far or small entities lit once per 2x2 quad
+	bool ProbeAmbientOnly = false;		// Ambient from probes' SH, without the sky's cube or BRDF table
+	float DynamicResolutionMs = 0.0f;	// GPU frame time to scale the resolution for, 0 stays at full size
+
+	static BenchmarkOptions Parse(const char* commandLine);
+};
+
+// A single point on a scripted camera path
+struct CameraKeyframe
+{
+	float Time;
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 PitchYawRoll;
+};
+
+// --------------------------------------------------------
+// Looping camera path through a list of keyframes. Positions
+// use a Catmull-Rom spline, rotations are interpolated linearly.
+// --------------------------------------------------------
+class CameraPath
+{
+	public:
+		void AddKeyframe(float time, DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 pitchYawRoll);
+		void Evaluate(float time, DirectX::XMFLOAT3& position, DirectX::XMFLOAT3& pitchYawRoll) const;
+		float GetDuration() const;
+
+		// A fly-around that circles a point while changing height and distance
+		static CameraPath CreateFlythrough(DirectX::XMFLOAT3 center, float radius, float height, float duration);
+
+	private:
+		std::vector<CameraKeyframe> keyframes;
+};
+
+// --------------------------------------------------------
+// Writes the results of a benchmark run
+// --------------------------------------------------------
+class BenchmarkReport
+{
+	public:
+		static std::string ToString(const BenchmarkOptions& options, const ProfileAggregator& cpuStats, const FrameStatsSummary& frames, const DrawStats& draws);
+		static bool WriteJson(const std::string& path, const BenchmarkOptions& options, const ProfileAggregator& cpuStats, const FrameStatsSummary& frames, const DrawStats& draws);
+};
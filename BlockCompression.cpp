@@ -0,0 +1,638 @@
+#include "BlockCompression.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BLOCK_COMPRESSION_SSE2
+#endif
+
+// BC7 4-bit index weights, out of 64
+static const int BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+// A block split into one array per channel, so four pixels fill a register
+struct BlockPixels
+{
+	float R[16];
+	float G[16];
+	float B[16];
+	float A[16];
+};
+
+static void LoadPixels(const unsigned char rgba[64], BlockPixels& pixels, bool useAlpha)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		pixels.R[i] = rgba[i * 4 + 0];
+		pixels.G[i] = rgba[i * 4 + 1];
+		pixels.B[i] = rgba[i * 4 + 2];
+		pixels.A[i] = useAlpha ? rgba[i * 4 + 3] : 0.0f;
+	}
+}
+
+static float Clamp255(float value)
+{
+	return value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+}
+
+// Picks the closest palette entry (4 floats each, RGBA) for every pixel
+// and returns the total squared error
+static float FindClosest(const BlockPixels& pixels, const float* palette, int count, int indices[16])
+{
+	float total = 0.0f;
+
+#ifdef BLOCK_COMPRESSION_SSE2
+	for (int p = 0; p < 16; p += 4)
+	{
+		__m128 r = _mm_loadu_ps(pixels.R + p);
+		__m128 g = _mm_loadu_ps(pixels.G + p);
+		__m128 b = _mm_loadu_ps(pixels.B + p);
+		__m128 a = _mm_loadu_ps(pixels.A + p);
+
+		__m128 best = _mm_set1_ps(3.4e38f);
+		__m128i bestIndex = _mm_setzero_si128();
+		for (int i = 0; i < count; i++)
+		{
+			__m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[i * 4 + 0]));
+			__m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[i * 4 + 1]));
+			__m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[i * 4 + 2]));
+			__m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[i * 4 + 3]));
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+				_mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(da, da)));
+
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+			best = _mm_min_ps(distance, best);
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(i)), _mm_andnot_si128(closer, bestIndex));
+		}
+
+		int index[4];
+		float error[4];
+		_mm_storeu_si128((__m128i*)index, bestIndex);
+		_mm_storeu_ps(error, best);
+		for (int k = 0; k < 4; k++)
+		{
+			indices[p + k] = index[k];
+			total += error[k];
+		}
+	}
+#else
+	for (int p = 0; p < 16; p++)
+	{
+		float best = 3.4e38f;
+		for (int i = 0; i < count; i++)
+		{
+			float dr = pixels.R[p] - palette[i * 4 + 0];
+			float dg = pixels.G[p] - palette[i * 4 + 1];
+			float db = pixels.B[p] - palette[i * 4 + 2];
+			float da = pixels.A[p] - palette[i * 4 + 3];
+			float distance = dr * dr + dg * dg + db * db + da * da;
+			if (distance < best)
+			{
+				best = distance;
+				indices[p] = i;
+			}
+		}
+		total += best;
+	}
+#endif
+
+	return total;
+}
+
+// Fits a line through the block's colors: the two ends of the
+// principal axis (found by power iteration) where the pixels lie
+static void FitLine(const BlockPixels& pixels, float start[4], float end[4])
+{
+	const float* channels[4] = { pixels.R, pixels.G, pixels.B, pixels.A };
+
+	float mean[4] = { 0, 0, 0, 0 };
+	for (int c = 0; c < 4; c++)
+	{
+		for (int i = 0; i < 16; i++)
+			mean[c] += channels[c][i];
+		mean[c] /= 16.0f;
+	}
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float d[4];
+		for (int c = 0; c < 4; c++)
+			d[c] = channels[c][i] - mean[c];
+		for (int x = 0; x < 4; x++)
+			for (int y = 0; y < 4; y++)
+				covariance[x][y] += d[x] * d[y];
+	}
+
+	// Start from the channel that varies the most
+	int widest = 0;
+	for (int c = 1; c < 4; c++)
+		if (covariance[c][c] > covariance[widest][widest])
+			widest = c;
+
+	float axis[4] = { covariance[widest][0], covariance[widest][1], covariance[widest][2], covariance[widest][3] };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = { 0, 0, 0, 0 };
+		float largest = 0.0f;
+		for (int x = 0; x < 4; x++)
+		{
+			for (int y = 0; y < 4; y++)
+				next[x] += covariance[x][y] * axis[y];
+			largest = fabsf(next[x]) > largest ? fabsf(next[x]) : largest;
+		}
+
+		// Flat block, every pixel is the mean
+		if (largest == 0.0f)
+			break;
+		for (int c = 0; c < 4; c++)
+			axis[c] = next[c] / largest;
+	}
+
+	float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+	if (length > 0.0f)
+		for (int c = 0; c < 4; c++)
+			axis[c] /= length;
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < 4; c++)
+			t += (channels[c][i] - mean[c]) * axis[c];
+		minT = t < minT ? t : minT;
+		maxT = t > maxT ? t : maxT;
+	}
+
+	for (int c = 0; c < 4; c++)
+	{
+		start[c] = Clamp255(mean[c] + axis[c] * minT);
+		end[c] = Clamp255(mean[c] + axis[c] * maxT);
+	}
+}
+
+// Least squares endpoints for a set of indices, where pixel i is
+// approximated by start * (1 - weights[indices[i]]) + end * weights[indices[i]]
+static bool SolveEndpoints(const BlockPixels& pixels, const int indices[16], const float* weights, float start[4], float end[4])
+{
+	const float* channels[4] = { pixels.R, pixels.G, pixels.B, pixels.A };
+
+	float aa = 0, ab = 0, bb = 0;
+	float ap[4] = { 0, 0, 0, 0 };
+	float bp[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		float b = weights[indices[i]];
+		float a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < 4; c++)
+		{
+			ap[c] += a * channels[c][i];
+			bp[c] += b * channels[c][i];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+
+	for (int c = 0; c < 4; c++)
+	{
+		start[c] = Clamp255((bb * ap[c] - ab * bp[c]) / determinant);
+		end[c] = Clamp255((aa * bp[c] - ab * ap[c]) / determinant);
+	}
+	return true;
+}
+
+// Writes values into a block, least significant bit first
+struct BlockBitWriter
+{
+	unsigned char* Block;
+	int Position;
+
+	void Write(unsigned int value, int bits)
+	{
+		for (int i = 0; i < bits; i++, Position++)
+			if ((value >> i) & 1)
+				Block[Position >> 3] |= (unsigned char)(1 << (Position & 7));
+	}
+};
+
+struct BlockBitReader
+{
+	const unsigned char* Block;
+	int Position;
+
+	unsigned int Read(int bits)
+	{
+		unsigned int value = 0;
+		for (int i = 0; i < bits; i++, Position++)
+			value |= (unsigned int)((Block[Position >> 3] >> (Position & 7)) & 1) << i;
+		return value;
+	}
+};
+
+// --------------------------------------------------------
+// BC1
+// --------------------------------------------------------
+static unsigned short To565(const float color[4])
+{
+	int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void From565(unsigned short value, int color[3])
+{
+	int r = (value >> 11) & 31;
+	int g = (value >> 5) & 63;
+	int b = value & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// The four colors a pair of endpoints decodes to (c0 > c1)
+static void BC1Palette(unsigned short c0, unsigned short c1, int palette[4][3])
+{
+	From565(c0, palette[0]);
+	From565(c1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+	}
+}
+
+// Quantizes a pair of endpoints and picks indices
+static float TryBC1(const BlockPixels& pixels, const float start[4], const float end[4], unsigned short& c0, unsigned short& c1, int indices[16])
+{
+	c0 = To565(end);
+	c1 = To565(start);
+	if (c0 < c1)
+	{
+		unsigned short swap = c0;
+		c0 = c1;
+		c1 = swap;
+	}
+
+	int colors[4][3];
+	BC1Palette(c0, c1, colors);
+
+	float palette[16] = {};
+	for (int i = 0; i < 4; i++)
+		for (int c = 0; c < 3; c++)
+			palette[i * 4 + c] = (float)colors[i][c];
+
+	// Equal endpoints would switch the decoder to 3-color mode
+	return FindClosest(pixels, palette, c0 == c1 ? 1 : 4, indices);
+}
+
+/// <summary>
+/// Encodes an opaque block as BC1. Endpoints come from the block's
+/// principal axis, then get one least squares refinement.
+/// </summary>
+void BlockCompression::EncodeBC1(const unsigned char rgba[64], unsigned char block[8])
+{
+	BlockPixels pixels;
+	LoadPixels(rgba, pixels, false);
+
+	float start[4], end[4];
+	FitLine(pixels, start, end);
+
+	unsigned short c0, c1;
+	int indices[16];
+	float error = TryBC1(pixels, start, end, c0, c1, indices);
+
+	// Index 0 is c0, 1 is c1, 2 and 3 are 1/3 and 2/3 of the way from c0
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	if (c0 != c1 && SolveEndpoints(pixels, indices, weights, start, end))
+	{
+		unsigned short refined0, refined1;
+		int refinedIndices[16];
+		float refinedError = TryBC1(pixels, start, end, refined0, refined1, refinedIndices);
+		if (refinedError < error)
+		{
+			c0 = refined0;
+			c1 = refined1;
+			memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	unsigned int bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (unsigned int)(c0 == c1 ? 0 : indices[i]) << (i * 2);
+
+	block[0] = (unsigned char)(c0 & 0xFF);
+	block[1] = (unsigned char)(c0 >> 8);
+	block[2] = (unsigned char)(c1 & 0xFF);
+	block[3] = (unsigned char)(c1 >> 8);
+	for (int i = 0; i < 4; i++)
+		block[4 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+/// <summary>
+/// Decodes a BC1 block, including the 3-color + transparent mode
+/// </summary>
+void BlockCompression::DecodeBC1(const unsigned char block[8], unsigned char rgba[64])
+{
+	unsigned short c0 = (unsigned short)(block[0] | (block[1] << 8));
+	unsigned short c1 = (unsigned short)(block[2] | (block[3] << 8));
+	unsigned int bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+
+	int palette[4][3];
+	int alpha[4] = { 255, 255, 255, 255 };
+	if (c0 > c1)
+	{
+		BC1Palette(c0, c1, palette);
+	}
+	else
+	{
+		From565(c0, palette[0]);
+		From565(c1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+		alpha[3] = 0;
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		int index = (bits >> (i * 2)) & 3;
+		rgba[i * 4 + 0] = (unsigned char)palette[index][0];
+		rgba[i * 4 + 1] = (unsigned char)palette[index][1];
+		rgba[i * 4 + 2] = (unsigned char)palette[index][2];
+		rgba[i * 4 + 3] = (unsigned char)alpha[index];
+	}
+}
+
+// --------------------------------------------------------
+// BC4 / BC5
+// --------------------------------------------------------
+
+/// <summary>
+/// Encodes one channel as BC4, using the block's min and max as
+/// endpoints in the 8-value mode
+/// </summary>
+void BlockCompression::EncodeBC4(const unsigned char values[16], unsigned char block[8])
+{
+	int low = 255, high = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		low = values[i] < low ? values[i] : low;
+		high = values[i] > high ? values[i] : high;
+	}
+
+	block[0] = (unsigned char)high;
+	block[1] = (unsigned char)low;
+	memset(block + 2, 0, 6);
+	if (high == low)
+		return;
+
+	int palette[8];
+	palette[0] = high;
+	palette[1] = low;
+	for (int i = 2; i < 8; i++)
+		palette[i] = ((8 - i) * high + (i - 1) * low + 3) / 7;
+
+	unsigned long long bits = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0;
+		int bestDistance = 256;
+		for (int p = 0; p < 8; p++)
+		{
+			int distance = values[i] > palette[p] ? values[i] - palette[p] : palette[p] - values[i];
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				best = p;
+			}
+		}
+		bits |= (unsigned long long)best << (i * 3);
+	}
+
+	for (int i = 0; i < 6; i++)
+		block[2 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+/// <summary>
+/// Decodes a BC4 block (either mode)
+/// </summary>
+void BlockCompression::DecodeBC4(const unsigned char block[8], unsigned char values[16])
+{
+	int e0 = block[0];
+	int e1 = block[1];
+
+	int palette[8];
+	palette[0] = e0;
+	palette[1] = e1;
+	if (e0 > e1)
+	{
+		for (int i = 2; i < 8; i++)
+			palette[i] = ((8 - i) * e0 + (i - 1) * e1 + 3) / 7;
+	}
+	else
+	{
+		for (int i = 2; i < 6; i++)
+			palette[i] = ((6 - i) * e0 + (i - 1) * e1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	unsigned long long bits = 0;
+	for (int i = 0; i < 6; i++)
+		bits |= (unsigned long long)block[2 + i] << (i * 8);
+
+	for (int i = 0; i < 16; i++)
+		values[i] = (unsigned char)palette[(bits >> (i * 3)) & 7];
+}
+
+/// <summary>
+/// Encodes two channels (normal map X and Y) as BC5
+/// </summary>
+void BlockCompression::EncodeBC5(const unsigned char red[16], const unsigned char green[16], unsigned char block[16])
+{
+	EncodeBC4(red, block);
+	EncodeBC4(green, block + 8);
+}
+
+/// <summary>
+/// Decodes a BC5 block to (red, green, 0, 255)
+/// </summary>
+void BlockCompression::DecodeBC5(const unsigned char block[16], unsigned char rgba[64])
+{
+	unsigned char red[16], green[16];
+	DecodeBC4(block, red);
+	DecodeBC4(block + 8, green);
+
+	for (int i = 0; i < 16; i++)
+	{
+		rgba[i * 4 + 0] = red[i];
+		rgba[i * 4 + 1] = green[i];
+		rgba[i * 4 + 2] = 0;
+		rgba[i * 4 + 3] = 255;
+	}
+}
+
+// --------------------------------------------------------
+// BC7
+// --------------------------------------------------------
+
+// Quantizes endpoints to mode 6's 7 bits + a shared p-bit each
+// and picks indices, returning the total error
+static float TryBC7Mode6(const BlockPixels& pixels, const float start[4], const float end[4], int quantized[2][4], int pbits[2], int indices[16])
+{
+	const float* endpoints[2] = { start, end };
+	int values[2][4];
+
+	for (int e = 0; e < 2; e++)
+	{
+		float bestError = 3.4e38f;
+		for (int p = 0; p < 2; p++)
+		{
+			int q[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				int v = (int)floorf((endpoints[e][c] - p) / 2.0f + 0.5f);
+				q[c] = v < 0 ? 0 : (v > 127 ? 127 : v);
+				float difference = (float)((q[c] << 1) | p) - endpoints[e][c];
+				error += difference * difference;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				pbits[e] = p;
+				for (int c = 0; c < 4; c++)
+				{
+					quantized[e][c] = q[c];
+					values[e][c] = (q[c] << 1) | p;
+				}
+			}
+		}
+	}
+
+	float palette[64];
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			palette[i * 4 + c] = (float)(((64 - BC7Weights[i]) * values[0][c] + BC7Weights[i] * values[1][c] + 32) >> 6);
+
+	return FindClosest(pixels, palette, 16, indices);
+}
+
+/// <summary>
+/// Encodes a block as BC7 mode 6: one subset, RGBA endpoints and
+/// 4-bit indices. It's the most accurate single mode for smooth
+/// color and alpha, and keeps the encoder simple and fast.
+/// </summary>
+void BlockCompression::EncodeBC7(const unsigned char rgba[64], unsigned char block[16])
+{
+	BlockPixels pixels;
+	LoadPixels(rgba, pixels, true);
+
+	float start[4], end[4];
+	FitLine(pixels, start, end);
+
+	int quantized[2][4], pbits[2], indices[16];
+	float error = TryBC7Mode6(pixels, start, end, quantized, pbits, indices);
+
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = BC7Weights[i] / 64.0f;
+
+	if (SolveEndpoints(pixels, indices, weights, start, end))
+	{
+		int refinedQuantized[2][4], refinedPbits[2], refinedIndices[16];
+		float refinedError = TryBC7Mode6(pixels, start, end, refinedQuantized, refinedPbits, refinedIndices);
+		if (refinedError < error)
+		{
+			memcpy(quantized, refinedQuantized, sizeof(quantized));
+			memcpy(pbits, refinedPbits, sizeof(pbits));
+			memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	// The first index only stores 3 bits, so its top bit must be 0
+	if (indices[0] & 8)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			int swap = quantized[0][c];
+			quantized[0][c] = quantized[1][c];
+			quantized[1][c] = swap;
+		}
+		int swap = pbits[0];
+		pbits[0] = pbits[1];
+		pbits[1] = swap;
+		for (int i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(block, 0, 16);
+	BlockBitWriter writer = { block, 0 };
+	writer.Write(1 << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		writer.Write(quantized[0][c], 7);
+		writer.Write(quantized[1][c], 7);
+	}
+	writer.Write(pbits[0], 1);
+	writer.Write(pbits[1], 1);
+	for (int i = 0; i < 16; i++)
+		writer.Write(indices[i], i == 0 ? 3 : 4);
+}
+
+/// <summary>
+/// Decodes a BC7 block written by EncodeBC7
+/// </summary>
+/// <returns>False (and magenta pixels) for any mode other than 6</returns>
+bool BlockCompression::DecodeBC7(const unsigned char block[16], unsigned char rgba[64])
+{
+	if ((block[0] & 0x7F) != 0x40)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			rgba[i * 4 + 0] = 255;
+			rgba[i * 4 + 1] = 0;
+			rgba[i * 4 + 2] = 255;
+			rgba[i * 4 + 3] = 255;
+		}
+		return false;
+	}
+
+	BlockBitReader reader = { block, 7 };
+	int quantized[2][4];
+	for (int c = 0; c < 4; c++)
+	{
+		quantized[0][c] = reader.Read(7);
+		quantized[1][c] = reader.Read(7);
+	}
+	int p0 = reader.Read(1);
+	int p1 = reader.Read(1);
+
+	for (int i = 0; i < 16; i++)
+	{
+		int index = reader.Read(i == 0 ? 3 : 4);
+		int w = BC7Weights[index];
+		for (int c = 0; c < 4; c++)
+		{
+			int v0 = (quantized[0][c] << 1) | p0;
+			int v1 = (quantized[1][c] << 1) | p1;
+			rgba[i * 4 + c] = (unsigned char)(((64 - w) * v0 + w * v1 + 32) >> 6);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// --------------------------------------------------------
+// CPU encoders and decoders for single 4x4 blocks of the
+// BC formats the texture cooker writes. Pixels are passed
+// as 16 entries in row order; RGBA input is 64 bytes.
+//
+//  BC1 - opaque RGB, 8 bytes (4-color mode only)
+//  BC4 - one channel, 8 bytes
+//  BC5 - two channels, 16 bytes (two BC4 blocks)
+//  BC7 - RGBA, 16 bytes (mode 6 only)
+//
+// Nothing here touches D3D, so it builds on any platform.
+// --------------------------------------------------------
+class BlockCompression
+{
+	public:
+		static void EncodeBC1(const unsigned char rgba[64], unsigned char block[8]);
+		static void EncodeBC4(const unsigned char values[16], unsigned char block[8]);
+		static void EncodeBC5(const unsigned char red[16], const unsigned char green[16], unsigned char block[16]);
+		static void EncodeBC7(const unsigned char rgba[64], unsigned char block[16]);
+
+		// Decoders write RGBA, filling unused channels like the GPU would
+		static void DecodeBC1(const unsigned char block[8], unsigned char rgba[64]);
+		static void DecodeBC4(const unsigned char block[8], unsigned char values[16]);
+		static void DecodeBC5(const unsigned char block[16], unsigned char rgba[64]);
+		static bool DecodeBC7(const unsigned char block[16], unsigned char rgba[64]);
+};
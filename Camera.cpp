@@ -108,3 +108,7 @@ void Camera::UpdateProjectionMatrix(float _aspectRatio)
 Transform* Camera::GetTransform() { return &transform; }
 DirectX::XMFLOAT4X4 Camera::GetViewMatrix() { return viewMatrix; }
 DirectX::XMFLOAT4X4 Camera::GetProjectionMatrix() { return projectionMatrix; }
+float Camera::GetFieldOfView() { return fieldOfView; }
+float Camera::GetAspectRatio() { return aspectRatio; }
+float Camera::GetNearPlane() { return nearPlane; }
+float Camera::GetFarPlane() { return farPlane; }
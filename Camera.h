@@ -18,6 +18,10 @@ class Camera
 		Transform* GetTransform();
 		DirectX::XMFLOAT4X4 GetViewMatrix();
 		DirectX::XMFLOAT4X4 GetProjectionMatrix();
+		float GetFieldOfView();
+		float GetAspectRatio();
+		float GetNearPlane();
+		float GetFarPlane();
 
 	private:
 		// Camera Matrices
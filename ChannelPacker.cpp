@@ -0,0 +1,73 @@
+#include "ChannelPacker.h"
+
+#include <algorithm>
+#include <math.h>
+
+// Bilinear sample of one channel at a position given in 0-1 UVs
+static unsigned char SampleChannel(const CpuImage& image, int channel, float u, float v)
+{
+	float x = u * image.Width - 0.5f;
+	float y = v * image.Height - 0.5f;
+	float fx = x - floorf(x);
+	float fy = y - floorf(y);
+
+	// Clamp to the edges
+	int lastX = (int)image.Width - 1;
+	int lastY = (int)image.Height - 1;
+	int x0 = (std::max)(0, (std::min)(lastX, (int)floorf(x)));
+	int y0 = (std::max)(0, (std::min)(lastY, (int)floorf(y)));
+	int x1 = (std::max)(0, (std::min)(lastX, (int)floorf(x) + 1));
+	int y1 = (std::max)(0, (std::min)(lastY, (int)floorf(y) + 1));
+
+	const unsigned char* p = image.Pixels.data();
+	float top = p[((size_t)y0 * image.Width + x0) * 4 + channel] * (1.0f - fx) + p[((size_t)y0 * image.Width + x1) * 4 + channel] * fx;
+	float bottom = p[((size_t)y1 * image.Width + x0) * 4 + channel] * (1.0f - fx) + p[((size_t)y1 * image.Width + x1) * 4 + channel] * fx;
+	return (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+}
+
+/// <summary>
+/// Builds an RGBA image whose channels each come from a source
+/// image's channel (or a constant)
+/// </summary>
+/// <param name="sources">One source per output channel, RGBA order</param>
+/// <param name="packed">The result, as big as the largest source (1x1 if all are constants)</param>
+void ChannelPacker::Pack(const ChannelSource sources[4], CpuImage& packed)
+{
+	packed.Width = 1;
+	packed.Height = 1;
+	for (int c = 0; c < 4; c++)
+	{
+		const CpuImage* image = sources[c].Image;
+		if (image && !image->Pixels.empty())
+		{
+			packed.Width = (std::max)(packed.Width, image->Width);
+			packed.Height = (std::max)(packed.Height, image->Height);
+		}
+	}
+	packed.Pixels.resize((size_t)packed.Width * packed.Height * 4);
+
+	for (int c = 0; c < 4; c++)
+	{
+		const ChannelSource& source = sources[c];
+		const CpuImage* image = source.Image;
+		unsigned char* out = packed.Pixels.data() + c;
+
+		if (!image || image->Pixels.empty())
+		{
+			for (size_t i = 0; i < (size_t)packed.Width * packed.Height; i++)
+				out[i * 4] = source.Constant;
+		}
+		else if (image->Width == packed.Width && image->Height == packed.Height)
+		{
+			const unsigned char* in = image->Pixels.data() + source.Channel;
+			for (size_t i = 0; i < (size_t)packed.Width * packed.Height; i++)
+				out[i * 4] = in[i * 4];
+		}
+		else
+		{
+			for (unsigned int y = 0; y < packed.Height; y++)
+				for (unsigned int x = 0; x < packed.Width; x++)
+					out[((size_t)y * packed.Width + x) * 4] = SampleChannel(*image, source.Channel, (x + 0.5f) / packed.Width, (y + 0.5f) / packed.Height);
+		}
+	}
+}
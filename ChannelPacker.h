@@ -0,0 +1,29 @@
+#pragma once
+
+#include "PngReader.h"
+
+// Where one channel of a packed texture comes from
+struct ChannelSource
+{
+	const CpuImage* Image = 0;		// Null (or empty) for a constant
+	int Channel = 0;				// 0-3 = RGBA of the image
+	unsigned char Constant = 255;
+};
+
+// --------------------------------------------------------
+// Combines single-channel maps into the channels of one
+// RGBA texture, so a material binds (and the shader samples)
+// one texture instead of several. Sources of different
+// sizes are resampled to the largest.
+//
+// The ORM layout used for materials:
+//  R - ambient occlusion (white if the set has none)
+//  G - roughness
+//  B - metalness
+//  A - unused (white)
+// --------------------------------------------------------
+class ChannelPacker
+{
+	public:
+		static void Pack(const ChannelSource sources[4], CpuImage& packed);
+};
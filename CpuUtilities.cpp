@@ -0,0 +1,125 @@
+#include "CpuUtilities.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_UTILITIES_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef CPU_UTILITIES_X86
+static bool DetectAvx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// The OS has to save the YMM registers, too
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	unsigned int a, b, c, d;
+	if (!__get_cpuid(1, &a, &b, &c, &d) || (c & (1u << 27)) == 0 || (c & (1u << 28)) == 0)
+		return false;
+
+	// The OS has to save the YMM registers, too
+	unsigned int low, high;
+	__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	if ((low & 6) != 6)
+		return false;
+
+	return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1u << 5)) != 0;
+#endif
+}
+#endif
+
+/// <summary>
+/// Whether this CPU (and OS) can run the AVX2 paths
+/// </summary>
+bool CpuUtilities::HasAvx2()
+{
+#ifdef CPU_UTILITIES_X86
+	static bool available = DetectAvx2();
+	return available;
+#else
+	return false;
+#endif
+}
+
+/// <summary>
+/// Rounds to the nearest half float. Too big becomes the largest
+/// half rather than infinity; too small becomes zero.
+/// </summary>
+unsigned short CpuUtilities::FloatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int floatExponent = (bits >> 23) & 0xFF;
+	unsigned int mantissa = bits & 0x7FFFFF;
+
+	if (floatExponent == 0xFF)
+		return (unsigned short)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+
+	int exponent = (int)floatExponent - 127 + 15;
+	if (exponent >= 31)
+		return (unsigned short)(sign | 0x7BFF);
+
+	// Subnormal halves keep fewer mantissa bits
+	unsigned int shift = 13;
+	unsigned int half = 0;
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return (unsigned short)sign;
+		mantissa |= 0x800000;
+		shift = 14 - exponent;
+	}
+	else
+	{
+		half = (unsigned int)exponent << 10;
+	}
+
+	// Round to nearest, ties to even; a carry into the exponent is correct
+	half += mantissa >> shift;
+	unsigned int rest = mantissa & ((1u << shift) - 1);
+	unsigned int halfway = 1u << (shift - 1);
+	if (rest > halfway || (rest == halfway && (half & 1)))
+		half++;
+	return (unsigned short)(sign | (std::min)(half, 0x7BFFu));
+}
+
+/// <summary>
+/// Expands a half float, like f16tof32() in HLSL
+/// </summary>
+float CpuUtilities::HalfToFloat(unsigned short half)
+{
+	unsigned int sign = (unsigned int)(half & 0x8000) << 16;
+	unsigned int exponent = (half >> 10) & 0x1F;
+	unsigned int mantissa = half & 0x3FF;
+
+	if (exponent == 0)
+	{
+		float value = ldexpf((float)mantissa, -24);
+		return sign ? -value : value;
+	}
+
+	unsigned int bits = exponent == 31 ?
+		sign | 0x7F800000 | (mantissa << 13) :
+		sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// --------------------------------------------------------
+// What the CPU-side modules share below their own work:
+// whether their AVX2 paths can run here, and half floats
+// packed and unpacked the way the GPU reads them.
+// --------------------------------------------------------
+class CpuUtilities
+{
+	public:
+		static bool HasAvx2();
+
+		// Half floats
+		static unsigned short FloatToHalf(float value);
+		static float HalfToFloat(unsigned short half);
+};
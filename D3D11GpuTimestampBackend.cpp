@@ -0,0 +1,62 @@
+#include "D3D11GpuTimestampBackend.h"
+
+/// <summary>
+/// Constructor that creates every query for every slot up front
+/// </summary>
+/// <param name="device">Reference to the device</param>
+/// <param name="_context">The context the queries are issued on</param>
+D3D11GpuTimestampBackend::D3D11GpuTimestampBackend(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context)
+{
+	context = _context;
+
+	D3D11_QUERY_DESC disjointDesc = {};
+	disjointDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+
+	D3D11_QUERY_DESC timestampDesc = {};
+	timestampDesc.Query = D3D11_QUERY_TIMESTAMP;
+
+	for (unsigned int slot = 0; slot < GpuProfiler::FrameLatency; slot++)
+	{
+		device->CreateQuery(&disjointDesc, disjointQueries[slot].GetAddressOf());
+		for (unsigned int i = 0; i < GpuProfiler::MaxTimestampsPerFrame; i++)
+			device->CreateQuery(&timestampDesc, timestampQueries[slot][i].GetAddressOf());
+	}
+}
+
+void D3D11GpuTimestampBackend::BeginFrame(unsigned int slot)
+{
+	context->Begin(disjointQueries[slot].Get());
+}
+
+void D3D11GpuTimestampBackend::WriteTimestamp(unsigned int slot, unsigned int index)
+{
+	// Timestamp queries only have an End()
+	context->End(timestampQueries[slot][index].Get());
+}
+
+void D3D11GpuTimestampBackend::EndFrame(unsigned int slot)
+{
+	context->End(disjointQueries[slot].Get());
+}
+
+/// <summary>
+/// Polls the slot's queries without flushing or waiting
+/// </summary>
+bool D3D11GpuTimestampBackend::TryReadFrame(unsigned int slot, unsigned int timestampCount, unsigned long long* timestamps, unsigned long long& frequency, bool& disjoint)
+{
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData = {};
+	if (context->GetData(disjointQueries[slot].Get(), &disjointData, sizeof(disjointData), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return false;
+
+	for (unsigned int i = 0; i < timestampCount; i++)
+	{
+		UINT64 ticks = 0;
+		if (context->GetData(timestampQueries[slot][i].Get(), &ticks, sizeof(ticks), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			return false;
+		timestamps[i] = ticks;
+	}
+
+	frequency = disjointData.Frequency;
+	disjoint = disjointData.Disjoint != FALSE;
+	return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Profiler.h"
+#include <d3d11.h>
+#include <wrl/client.h>
+
+// --------------------------------------------------------
+// GPU timestamp backend built on D3D11 timestamp queries.
+// One disjoint query brackets each frame slot so the tick
+// frequency (and any clock changes) are known per frame.
+// --------------------------------------------------------
+class D3D11GpuTimestampBackend : public GpuTimestampBackend
+{
+	public:
+		D3D11GpuTimestampBackend(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context);
+
+		void BeginFrame(unsigned int slot);
+		void WriteTimestamp(unsigned int slot, unsigned int index);
+		void EndFrame(unsigned int slot);
+		bool TryReadFrame(unsigned int slot, unsigned int timestampCount, unsigned long long* timestamps, unsigned long long& frequency, bool& disjoint);
+
+	private:
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		Microsoft::WRL::ComPtr<ID3D11Query> disjointQueries[GpuProfiler::FrameLatency];
+		Microsoft::WRL::ComPtr<ID3D11Query> timestampQueries[GpuProfiler::FrameLatency][GpuProfiler::MaxTimestampsPerFrame];
+};
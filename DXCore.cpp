@@ -2,7 +2,7 @@
 #include "Input.h"
 
 #include <WindowsX.h>
-#include <sstream>
+#include <stdio.h>
 
 // Define the static instance variable so our OS-level 
 // message handling function below can talk to our object
@@ -51,7 +51,7 @@ DXCore::DXCore(
 	// Initialize fields
 	this->hasFocus = true; 
 	
-	this->fpsFrameCount = 0;
+	this->titleStatsFirstFrame = 0;
 	this->fpsTimeElapsed = 0.0f;
 	this->currentTime = 0;
 	this->deltaTime = 0;
@@ -284,6 +284,73 @@ HRESULT DXCore::InitDirectX()
 	return S_OK;
 }
 
+// --------------------------------------------------------
+// Initializes DirectX without a window or swap chain, for
+// headless benchmarking.  Everything is rendered into an
+// offscreen texture that stands in for the back buffer.
+// --------------------------------------------------------
+HRESULT DXCore::InitDirectXHeadless()
+{
+	// This will hold options for DirectX initialization
+	unsigned int deviceFlags = 0;
+
+#if defined(DEBUG) || defined(_DEBUG)
+	deviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+	// Create just the device and context
+	HRESULT hr = D3D11CreateDevice(
+		0,							// Default adapter
+		D3D_DRIVER_TYPE_HARDWARE,	// We want to use the hardware (GPU)
+		0,							// Used when doing software rendering
+		deviceFlags,				// Any special options
+		0,							// Default feature levels
+		0,							// The number of fallbacks in the above param
+		D3D11_SDK_VERSION,			// Current version of the SDK
+		device.GetAddressOf(),		// Pointer to our Device pointer
+		&dxFeatureLevel,			// This will hold the actual feature level the app will use
+		context.GetAddressOf());	// Pointer to our Device Context pointer
+	if (FAILED(hr)) return hr;
+
+	// Offscreen color target in place of the back buffer
+	D3D11_TEXTURE2D_DESC colorDesc = {};
+	colorDesc.Width				= width;
+	colorDesc.Height			= height;
+	colorDesc.MipLevels			= 1;
+	colorDesc.ArraySize			= 1;
+	colorDesc.Format			= DXGI_FORMAT_R8G8B8A8_UNORM;
+	colorDesc.Usage				= D3D11_USAGE_DEFAULT;
+	colorDesc.BindFlags			= D3D11_BIND_RENDER_TARGET;
+	colorDesc.SampleDesc.Count	= 1;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> colorTexture;
+	hr = device->CreateTexture2D(&colorDesc, 0, colorTexture.GetAddressOf());
+	if (FAILED(hr)) return hr;
+	device->CreateRenderTargetView(colorTexture.Get(), 0, backBufferRTV.GetAddressOf());
+
+	// Depth buffer matching the one made in InitDirectX()
+	D3D11_TEXTURE2D_DESC depthStencilDesc = colorDesc;
+	depthStencilDesc.Format		= DXGI_FORMAT_D24_UNORM_S8_UINT;
+	depthStencilDesc.BindFlags	= D3D11_BIND_DEPTH_STENCIL;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> depthBufferTexture;
+	hr = device->CreateTexture2D(&depthStencilDesc, 0, depthBufferTexture.GetAddressOf());
+	if (FAILED(hr)) return hr;
+	device->CreateDepthStencilView(depthBufferTexture.Get(), 0, depthStencilView.GetAddressOf());
+
+	// Bind the views and set up the viewport
+	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width		= (float)width;
+	viewport.Height		= (float)height;
+	viewport.MinDepth	= 0.0f;
+	viewport.MaxDepth	= 1.0f;
+	context->RSSetViewports(1, &viewport);
+
+	return S_OK;
+}
+
 // --------------------------------------------------------
 // When the window is resized, the underlying 
 // buffers (textures) must also be resized to match.
@@ -398,8 +465,10 @@ HRESULT DXCore::Run()
 		}
 		else
 		{
-			// Update timer and title bar (if necessary)
+			// Update timer, frame stats and title bar (if necessary)
 			UpdateTimer();
+			frameStats.RecordFrame(deltaTime);
+			frameStats.Update(totalTime);
 			if(titleBarStats)
 				UpdateTitleBarStats();
 
@@ -421,6 +490,48 @@ HRESULT DXCore::Run()
 }
 
 
+// --------------------------------------------------------
+// Deterministic game loop for benchmarking:
+//  - No window messages or input
+//  - Every frame advances time by exactly fixedDeltaTime
+//  - frameStats records the measured wall-clock time of each
+//    frame rather than the fixed step
+// --------------------------------------------------------
+HRESULT DXCore::RunHeadless(unsigned int frameCount, float fixedDeltaTime)
+{
+	__int64 now;
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	startTime = now;
+	currentTime = now;
+	previousTime = now;
+
+	// Give subclass a chance to initialize
+	Init();
+
+	deltaTime = fixedDeltaTime;
+	totalTime = 0.0f;
+	QueryPerformanceCounter((LARGE_INTEGER*)&previousTime);
+
+	for (unsigned int frame = 0; frame < frameCount; frame++)
+	{
+		Update(deltaTime, totalTime);
+		Draw(deltaTime, totalTime);
+
+		// Submit the frame's work, since there's no Present() to do it
+		context->Flush();
+
+		// Measure how long the frame actually took
+		QueryPerformanceCounter((LARGE_INTEGER*)&currentTime);
+		frameStats.RecordFrame((float)((currentTime - previousTime) * perfCounterSeconds));
+		previousTime = currentTime;
+
+		totalTime += fixedDeltaTime;
+	}
+
+	return S_OK;
+}
+
+
 // --------------------------------------------------------
 // Sends an OS-level window close message to our process, which
 // will be handled by our message processing function
@@ -459,46 +570,46 @@ void DXCore::UpdateTimer()
 // Updates the window's title bar with several stats once
 // per second, including:
 //  - The window's width & height
-//  - The current FPS and ms/frame
+//  - The FPS and frame time percentiles over the last second
+//  - The number of hitches in the last second
 //  - The version of DirectX actually being used (usually 11)
+//
+// The stats themselves come from frameStats, which records
+// every frame whether or not the title bar is updated.
 // --------------------------------------------------------
 void DXCore::UpdateTitleBarStats()
 {
-	fpsFrameCount++;
-
-	// Only calc FPS and update title bar once per second
+	// Only update the title bar once per second
 	float timeDiff = totalTime - fpsTimeElapsed;
 	if (timeDiff < 1.0f)
 		return;
 
-	// How long did each frame take?  (Approx)
-	float mspf = 1000.0f / (float)fpsFrameCount;
-
-	// Quick and dirty title bar text (mostly for debugging)
-	std::ostringstream output;
-	output.precision(6);
-	output << titleBarText <<
-		"    Width: "		<< width <<
-		"    Height: "		<< height <<
-		"    FPS: "			<< fpsFrameCount <<
-		"    Frame Time: "	<< mspf << "ms";
+	FrameStatsSummary summary = frameStats.Summarize(titleStatsFirstFrame);
 
-	// Append the version of DirectX the app is using
+	// Determine the version of DirectX the app is using
+	const char* dxVersion = "DX ???";
 	switch (dxFeatureLevel)
 	{
-	case D3D_FEATURE_LEVEL_11_1: output << "    DX 11.1"; break;
-	case D3D_FEATURE_LEVEL_11_0: output << "    DX 11.0"; break;
-	case D3D_FEATURE_LEVEL_10_1: output << "    DX 10.1"; break;
-	case D3D_FEATURE_LEVEL_10_0: output << "    DX 10.0"; break;
-	case D3D_FEATURE_LEVEL_9_3:  output << "    DX 9.3";  break;
-	case D3D_FEATURE_LEVEL_9_2:  output << "    DX 9.2";  break;
-	case D3D_FEATURE_LEVEL_9_1:  output << "    DX 9.1";  break;
-	default:                     output << "    DX ???";  break;
+	case D3D_FEATURE_LEVEL_11_1: dxVersion = "DX 11.1"; break;
+	case D3D_FEATURE_LEVEL_11_0: dxVersion = "DX 11.0"; break;
+	case D3D_FEATURE_LEVEL_10_1: dxVersion = "DX 10.1"; break;
+	case D3D_FEATURE_LEVEL_10_0: dxVersion = "DX 10.0"; break;
+	case D3D_FEATURE_LEVEL_9_3:  dxVersion = "DX 9.3";  break;
+	case D3D_FEATURE_LEVEL_9_2:  dxVersion = "DX 9.2";  break;
+	case D3D_FEATURE_LEVEL_9_1:  dxVersion = "DX 9.1";  break;
 	}
 
-	// Actually update the title bar and reset fps data
-	SetWindowText(hWnd, output.str().c_str());
-	fpsFrameCount = 0;
+	// Quick title bar text (mostly for debugging), built without
+	// any allocations since this runs every second for the whole session
+	char output[512];
+	snprintf(output, sizeof(output),
+		"%s    Width: %u    Height: %u    FPS: %u    p50: %.2fms    p95: %.2fms    p99: %.2fms    Max: %.2fms    Hitches: %u    %s",
+		titleBarText.c_str(), width, height, summary.FrameCount,
+		summary.P50Ms, summary.P95Ms, summary.P99Ms, summary.MaxMs, summary.HitchCount, dxVersion);
+
+	// Actually update the title bar and start the next window
+	SetWindowText(hWnd, output);
+	titleStatsFirstFrame = frameStats.GetFrameCount();
 	fpsTimeElapsed += 1.0f;
 }
 
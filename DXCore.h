@@ -4,6 +4,7 @@
 #include <d3d11.h>
 #include <string>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+#include "FrameStats.h"
 
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
@@ -36,6 +37,10 @@ public:
 	HRESULT InitWindow();
 	HRESULT InitDirectX();
 	HRESULT Run();
+
+	// Windowless versions for benchmarking (no swap chain, fixed timestep)
+	HRESULT InitDirectXHeadless();
+	HRESULT RunHeadless(unsigned int frameCount, float fixedDeltaTime);
 	void Quit();
 	virtual void OnResize();
 
@@ -77,6 +82,8 @@ protected:
 	std::string GetFullPathTo(std::string relativeFilePath);
 	std::wstring GetFullPathTo_Wide(std::wstring relativeFilePath);
 
+	// Every frame's delta time, for percentiles, hitches and dumps
+	FrameStats frameStats;
 
 private:
 	// Timing related data
@@ -87,8 +94,8 @@ private:
 	__int64 currentTime;
 	__int64 previousTime;
 
-	// FPS calculation
-	int fpsFrameCount;
+	// Title bar stats window
+	unsigned long long titleStatsFirstFrame;
 	float fpsTimeElapsed;
 
 	void UpdateTimer();			// Updates the timer for this frame
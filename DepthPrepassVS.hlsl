@@ -0,0 +1,35 @@
+#include "ShaderIncludes.hlsli"
+
+// --------------------------------------------------------
+// Depth only, from the camera, ahead of the main pass (see
+// Game::DrawDepthPrepass()). Positions go through the same
+// functions as VertexShader.hlsl's, so the main pass can test
+// for EQUAL. Only the position stream is bound; there's no
+// pixel shader.
+// --------------------------------------------------------
+cbuffer ExternalData : register(b0)
+{
+#ifndef BATCHED
+	matrix world;
+#endif
+	matrix view;
+	matrix projection;
+	float3 positionScale;	// The mesh's, to unpack positions
+	float3 positionOffset;
+#ifdef BATCHED
+	uint instanceOffset;	// SV_InstanceID always starts at zero
+#endif
+}
+
+#ifdef BATCHED
+StructuredBuffer<InstanceData> Instances : register(t0);
+
+float4 main(float4 packedPosition : POSITION_UNORM16, uint instanceID : SV_InstanceID) : SV_POSITION
+{
+	matrix world = Instances[instanceOffset + instanceID].world;
+#else
+float4 main(float4 packedPosition : POSITION_UNORM16) : SV_POSITION
+{
+#endif
+	return ProjectPosition(UnpackPosition(packedPosition, positionScale, positionOffset), world, view, projection);
+}
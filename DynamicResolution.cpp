@@ -0,0 +1,184 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace DirectX;
+
+// UpscalePS.hlsl's Scene register, unbound once the upscale is done
+static const UINT SceneSlot = 0;
+
+/// <summary>
+/// Constructor. Nothing is scaled until Resize() has made the targets.
+/// </summary>
+/// <param name="_fullScreenShader">FullScreenVS.hlsl</param>
+/// <param name="_upscaleShader">UpscalePS.hlsl</param>
+/// <param name="_settings">Target GPU time, scale limits and the controller's gains</param>
+DynamicResolution::DynamicResolution(
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	std::shared_ptr<RenderStateCache> _renderStates,
+	std::shared_ptr<SimpleVertexShader> _fullScreenShader,
+	std::shared_ptr<SimplePixelShader> _upscaleShader,
+	ResolutionSettings _settings)
+	:
+	device(_device),
+	context(_context),
+	renderStates(_renderStates),
+	fullScreenShader(_fullScreenShader),
+	upscaleShader(_upscaleShader),
+	controller(_settings),
+	enabled(true),
+	width(0),
+	height(0)
+{
+	// Bilinear, and never wrapping around to the other edge
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	linearClamp = renderStates->GetSampler(renderStates->GetSamplerId(samplerDesc));
+}
+
+/// <summary>
+/// (Re)creates the offscreen targets at the back buffer's size.
+/// Call after the back buffer is resized.
+/// </summary>
+/// <returns>False if a target couldn't be made; the scene is then drawn at full size</returns>
+bool DynamicResolution::Resize(unsigned int _width, unsigned int _height)
+{
+	sceneRTV.Reset();
+	sceneSRV.Reset();
+	sceneDSV.Reset();
+	width = _width;
+	height = _height;
+	if (width == 0 || height == 0)
+		return false;
+
+	// Matches the back buffer, so the upscale is the only difference
+	D3D11_TEXTURE2D_DESC colorDesc = {};
+	colorDesc.Width = width;
+	colorDesc.Height = height;
+	colorDesc.MipLevels = 1;
+	colorDesc.ArraySize = 1;
+	colorDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	colorDesc.SampleDesc.Count = 1;
+	colorDesc.Usage = D3D11_USAGE_DEFAULT;
+	colorDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> colorTexture;
+	if (FAILED(device->CreateTexture2D(&colorDesc, 0, colorTexture.GetAddressOf())) ||
+		FAILED(device->CreateRenderTargetView(colorTexture.Get(), 0, sceneRTV.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(colorTexture.Get(), 0, sceneSRV.GetAddressOf())))
+	{
+		sceneRTV.Reset();
+		sceneSRV.Reset();
+		return false;
+	}
+
+	D3D11_TEXTURE2D_DESC depthDesc = colorDesc;
+	depthDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> depthTexture;
+	if (FAILED(device->CreateTexture2D(&depthDesc, 0, depthTexture.GetAddressOf())) ||
+		FAILED(device->CreateDepthStencilView(depthTexture.Get(), 0, sceneDSV.GetAddressOf())))
+	{
+		sceneRTV.Reset();
+		sceneSRV.Reset();
+		sceneDSV.Reset();
+		return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// Feeds the controller one frame's GPU time, if the scene is being scaled
+/// </summary>
+/// <returns>True if the scale changed</returns>
+bool DynamicResolution::AddGpuTime(float gpuMs)
+{
+	return IsActive() && controller.AddSample(gpuMs);
+}
+
+/// <summary>
+/// Stretches the drawn corner of the scene target over the back
+/// buffer. Leaves the back buffer bound, without a depth buffer,
+/// and the full viewport set.
+/// </summary>
+void DynamicResolution::Upscale(Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBuffer)
+{
+	if (!IsActive())
+		return;
+
+	D3D11_VIEWPORT scaled = GetViewport();
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)width;
+	viewport.Height = (float)height;
+	viewport.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &viewport);
+	context->OMSetRenderTargets(1, backBuffer.GetAddressOf(), 0);
+	renderStates->Apply(RenderState());
+
+	fullScreenShader->SetShader();
+	upscaleShader->SetShader();
+	upscaleShader->SetFloat2("uvScale", XMFLOAT2(scaled.Width / width, scaled.Height / height));
+	upscaleShader->SetFloat2("uvMax", XMFLOAT2((scaled.Width - 0.5f) / width, (scaled.Height - 0.5f) / height));
+	upscaleShader->SetShaderResourceView("Scene", sceneSRV);
+	upscaleShader->SetSamplerState("LinearClamp", linearClamp);
+	upscaleShader->CopyAllBufferData();
+	context->Draw(3, 0);
+
+	// Next frame draws into it again, which it can't while it's bound to be read
+	ID3D11ShaderResourceView* none = 0;
+	context->PSSetShaderResources(SceneSlot, 1, &none);
+}
+
+// Getters
+bool DynamicResolution::IsEnabled() { return enabled; }
+Microsoft::WRL::ComPtr<ID3D11RenderTargetView> DynamicResolution::GetRenderTarget() { return sceneRTV; }
+Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DynamicResolution::GetDepthStencil() { return sceneDSV; }
+ResolutionController& DynamicResolution::GetController() { return controller; }
+
+/// <summary>
+/// Whether the scene is drawn into the offscreen targets this frame:
+/// only if enabled, and the targets and upscale shaders are ready
+/// </summary>
+bool DynamicResolution::IsActive()
+{
+	return enabled && sceneRTV && sceneDSV && fullScreenShader->IsShaderValid() && upscaleShader->IsShaderValid();
+}
+
+/// <summary>
+/// The scale of each axis the scene is drawn at; 1 when it isn't scaled
+/// </summary>
+float DynamicResolution::GetScale()
+{
+	return IsActive() ? controller.GetScale() : 1.0f;
+}
+
+/// <summary>
+/// The viewport to draw the scene through: the top left of the
+/// targets, in whole pixels
+/// </summary>
+D3D11_VIEWPORT DynamicResolution::GetViewport()
+{
+	float scale = GetScale();
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (std::max)(1.0f, roundf(width * scale));
+	viewport.Height = (std::max)(1.0f, roundf(height * scale));
+	viewport.MaxDepth = 1.0f;
+	return viewport;
+}
+
+// Setters
+
+/// <summary>
+/// Turns scaling on or off; turned on, it starts again from full size
+/// </summary>
+void DynamicResolution::SetEnabled(bool _enabled)
+{
+	if (_enabled && !enabled)
+		controller.Reset(controller.GetSettings().MaxScale);
+	enabled = _enabled;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include "RenderStateCache.h"
+#include "ResolutionController.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Draws the scene smaller when the GPU can't keep up. The
+// scene goes into the top left corner of offscreen color
+// and depth targets the size of the back buffer, through a
+// viewport scaled on each axis by a ResolutionController
+// fed with measured GPU frame times; Upscale() then
+// stretches that corner over the back buffer, filtered.
+//
+// Targets are made at full size, so changing the scale only
+// changes the viewport: nothing is recreated mid-game.
+// --------------------------------------------------------
+class DynamicResolution
+{
+	public:
+		DynamicResolution(
+			Microsoft::WRL::ComPtr<ID3D11Device> _device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+			std::shared_ptr<RenderStateCache> _renderStates,
+			std::shared_ptr<SimpleVertexShader> _fullScreenShader,
+			std::shared_ptr<SimplePixelShader> _upscaleShader,
+			ResolutionSettings _settings);
+
+		bool Resize(unsigned int _width, unsigned int _height);
+		bool AddGpuTime(float gpuMs);
+		void Upscale(Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBuffer);
+
+		// Getters
+		bool IsEnabled();
+		bool IsActive();
+		float GetScale();
+		D3D11_VIEWPORT GetViewport();
+		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> GetRenderTarget();
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> GetDepthStencil();
+		ResolutionController& GetController();
+
+		// Setters
+		void SetEnabled(bool _enabled);
+
+	private:
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		std::shared_ptr<RenderStateCache> renderStates;
+		std::shared_ptr<SimpleVertexShader> fullScreenShader;
+		std::shared_ptr<SimplePixelShader> upscaleShader;
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> linearClamp;
+
+		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> sceneRTV;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sceneSRV;
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> sceneDSV;
+
+		ResolutionController controller;
+		bool enabled;
+		unsigned int width;		// Of the targets, and the back buffer
+		unsigned int height;
+};
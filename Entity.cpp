@@ -1,4 +1,6 @@
 #include "Entity.h"
+#include <algorithm>
+#include <math.h>
 
 /// <summary>
 /// Constructor for Entity. Takes a mesh pointer and creates its own transform
@@ -7,14 +9,35 @@ Entity::Entity(std::shared_ptr<Mesh> _mesh, std::shared_ptr<Material> _material)
 {
     mesh = _mesh;
     material = _material;
+    lod = 0;
+    shadingRate = ShadingRate::Full;
 }
 
 // Getters
 Transform* Entity::GetTransform() { return &transform; }
 std::shared_ptr<Mesh> Entity::GetMesh() { return mesh; }
 std::shared_ptr<Material> Entity::GetMaterial() { return material; }
+unsigned int Entity::GetLod() { return lod; }
+ShadingRate Entity::GetShadingRate() { return shadingRate; }
+
+/// <summary>
+/// The mesh's bounding sphere in world space; the radius is scaled by the largest axis scale
+/// </summary>
+void Entity::GetWorldBounds(DirectX::XMFLOAT3& center, float& radius)
+{
+    DirectX::XMFLOAT4X4 world = transform.GetWorldMatrix();
+    DirectX::XMFLOAT3 localCenter = mesh->GetBoundsCenter();
+    DirectX::XMStoreFloat3(&center, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&localCenter), DirectX::XMLoadFloat4x4(&world)));
+    float scaleSquared = (std::max)((std::max)(
+        world._11 * world._11 + world._12 * world._12 + world._13 * world._13,
+        world._21 * world._21 + world._22 * world._22 + world._23 * world._23),
+        world._31 * world._31 + world._32 * world._32 + world._33 * world._33);
+    radius = mesh->GetBoundsRadius() * sqrtf(scaleSquared);
+}
 
 // Setters
-void Entity::SetTransform(Transform _transform) { transform = _transform; }
+void Entity::SetTransform(const Transform& _transform) { transform = _transform; }
 void Entity::SetMesh(std::shared_ptr<Mesh> _mesh) { mesh = _mesh; }
 void Entity::SetMaterial(std::shared_ptr<Material> _material) { material = _material; }
+void Entity::SetLod(unsigned int _lod) { lod = _lod; }
+void Entity::SetShadingRate(ShadingRate _shadingRate) { shadingRate = _shadingRate; }
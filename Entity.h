@@ -2,6 +2,7 @@
 #include "Mesh.h"
 #include "Transform.h"
 #include "Material.h"
+#include "ShadingRate.h"
 #include <memory>
 class Entity
 {
@@ -11,15 +12,22 @@ class Entity
 		Transform* GetTransform();
 		std::shared_ptr<Mesh> GetMesh();
 		std::shared_ptr<Material> GetMaterial();
+		void GetWorldBounds(DirectX::XMFLOAT3& center, float& radius);
+		unsigned int GetLod();
+		ShadingRate GetShadingRate();
 
 		// Setters
-		void SetTransform(Transform _transform);
+		void SetTransform(const Transform& _transform);
 		void SetMesh(std::shared_ptr<Mesh> _mesh);
 		void SetMaterial(std::shared_ptr<Material> _material);
+		void SetLod(unsigned int _lod);
+		void SetShadingRate(ShadingRate _shadingRate);
 
 	private:
 		Transform transform;
 		std::shared_ptr<Mesh> mesh;
 		std::shared_ptr<Material> material;
+		unsigned int lod;	// The mesh's level of detail to draw; picked every frame, with hysteresis
+		ShadingRate shadingRate;	// How often its lights are evaluated; picked like lod
 };
 
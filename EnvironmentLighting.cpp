@@ -0,0 +1,433 @@
+#include "EnvironmentLighting.h"
+#include "BlockCompression.h"
+#include "ShProbeGrid.h"
+
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DirectX::PackedVector;
+
+// The sky is read back at (at most) this size; the lighting is low frequency anyway
+static const unsigned int ReadBackSize = 256;
+
+// Resolution the SH projection reads
+static const unsigned int ShSourceSize = 64;
+
+// Prefiltered specular cube
+static const unsigned int SpecularSize = 128;
+static const unsigned int SpecularLevels = 6;
+static const unsigned int SpecularSamples = 128;
+
+// BRDF table
+static const unsigned int BrdfLutSize = 128;
+static const unsigned int BrdfLutSamples = 1024;
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+static float SrgbToLinear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+// Turns one mapped face into what the sampler would return for it, as RGB floats
+// Returns false for formats it doesn't know
+static bool DecodeFace(DXGI_FORMAT format, const unsigned char* data, UINT rowPitch, unsigned int size, float* rgb)
+{
+	bool srgb = false;
+	switch (format)
+	{
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			srgb = true;
+			break;
+		default:
+			break;
+	}
+
+	switch (format)
+	{
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		{
+			bool bgra = format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+			for (unsigned int y = 0; y < size; y++)
+			{
+				const unsigned char* row = data + (size_t)y * rowPitch;
+				for (unsigned int x = 0; x < size; x++)
+				{
+					float* output = &rgb[((size_t)y * size + x) * 3];
+					output[0] = row[x * 4 + (bgra ? 2 : 0)] / 255.0f;
+					output[1] = row[x * 4 + 1] / 255.0f;
+					output[2] = row[x * 4 + (bgra ? 0 : 2)] / 255.0f;
+				}
+			}
+			break;
+		}
+
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+			for (unsigned int y = 0; y < size; y++)
+			{
+				const HALF* row = (const HALF*)(data + (size_t)y * rowPitch);
+				for (unsigned int x = 0; x < size; x++)
+					for (int c = 0; c < 3; c++)
+						rgb[((size_t)y * size + x) * 3 + c] = XMConvertHalfToFloat(row[x * 4 + c]);
+			}
+			break;
+
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			for (unsigned int y = 0; y < size; y++)
+			{
+				const float* row = (const float*)(data + (size_t)y * rowPitch);
+				for (unsigned int x = 0; x < size; x++)
+					for (int c = 0; c < 3; c++)
+						rgb[((size_t)y * size + x) * 3 + c] = row[x * 4 + c];
+			}
+			break;
+
+		// Block compressed: rowPitch covers a row of 4x4 blocks
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+		{
+			bool bc1 = format == DXGI_FORMAT_BC1_UNORM || format == DXGI_FORMAT_BC1_UNORM_SRGB;
+			bool bc3 = format == DXGI_FORMAT_BC3_UNORM || format == DXGI_FORMAT_BC3_UNORM_SRGB;
+			unsigned int blockBytes = bc1 ? 8 : 16;
+			unsigned int blocks = (size + 3) / 4;
+			unsigned char rgba[64];
+			for (unsigned int by = 0; by < blocks; by++)
+			{
+				for (unsigned int bx = 0; bx < blocks; bx++)
+				{
+					const unsigned char* block = data + (size_t)by * rowPitch + (size_t)bx * blockBytes;
+					if (bc1)
+						BlockCompression::DecodeBC1(block, rgba);
+					else if (bc3)
+						BlockCompression::DecodeBC1(block + 8, rgba);	// The color half of a BC3 block is a BC1 block
+					else if (!BlockCompression::DecodeBC7(block, rgba))
+						memset(rgba, 0, sizeof(rgba));
+
+					for (unsigned int i = 0; i < 16; i++)
+					{
+						unsigned int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+						if (x < size && y < size)
+							for (int c = 0; c < 3; c++)
+								rgb[((size_t)y * size + x) * 3 + c] = rgba[i * 4 + c] / 255.0f;
+					}
+				}
+			}
+			break;
+		}
+
+		default:
+			return false;
+	}
+
+	if (srgb)
+	{
+		for (size_t i = 0; i < (size_t)size * size * 3; i++)
+			rgb[i] = SrgbToLinear(rgb[i]);
+	}
+	return true;
+}
+
+/// <summary>
+/// Constructor. Nothing is lit by the environment until Build() succeeds.
+/// </summary>
+/// <param name="_renderStates">Where the lookup sampler comes from</param>
+EnvironmentLighting::EnvironmentLighting(
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	std::shared_ptr<RenderStateCache> _renderStates)
+	:
+	device(_device),
+	context(_context),
+	renderStates(_renderStates),
+	specularLevels(0),
+	diffuseReady(false),
+	ready(false),
+	enabled(true),
+	buildMs(0.0),
+	diffuseMs(0.0),
+	brdfLutCached(false)
+{
+	memset(shAmbient, 0, sizeof(shAmbient));
+
+	// Both lookups are filtered, and neither should wrap
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	clampSampler = renderStates->GetSampler(renderStates->GetSamplerId(samplerDesc));
+}
+
+/// <summary>
+/// Precomputes the lighting for an environment cube map
+/// </summary>
+/// <param name="environment">A cube map view, ex. the sky's</param>
+/// <param name="brdfLutCachePath">File the BRDF table is loaded from (or saved to)</param>
+/// <returns>False if the cube can't be read back or the results can't be uploaded</returns>
+bool EnvironmentLighting::Build(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> environment, const std::string& brdfLutCachePath)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ready = false;
+
+	std::vector<CubeImage> chain;
+	if (!ReadChain(environment, chain))
+		return false;
+
+	JobQueue queue((std::max)(1u, std::thread::hardware_concurrency()));
+	ProjectDiffuse(chain, &queue);
+
+	// Specular; a small sky gets a small cube, and fewer levels
+	unsigned int size = (std::min)(SpecularSize, chain[0].Size);
+	unsigned int levels = 1;
+	while (levels < SpecularLevels && (size >> levels) > 0)
+		levels++;
+	std::vector<CubeImage> specular;
+	IblPrecompute::PrefilterSpecular(chain, size, levels, SpecularSamples, specular, &queue);
+
+	BrdfLut lut;
+	if (!IblPrecompute::GetBrdfLut(brdfLutCachePath, BrdfLutSize, BrdfLutSamples, lut, &queue, &brdfLutCached))
+		return false;
+
+	if (!CreateSpecularCube(specular) || !CreateBrdfLut(lut))
+		return false;
+
+	specularLevels = levels;
+	ready = true;
+	buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+/// <summary>
+/// Projects the sky onto nine SH coefficients and nothing more:
+/// enough for ambient probes (and the shader's SH-only ambient),
+/// without the prefiltered cube or the BRDF table. Build() does
+/// this as well.
+/// </summary>
+/// <param name="environment">A cube map view, ex. the sky's</param>
+/// <returns>False if the cube can't be read back</returns>
+bool EnvironmentLighting::BuildDiffuse(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> environment)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::vector<CubeImage> chain;
+	if (!ReadChain(environment, chain))
+		return false;
+
+	JobQueue queue((std::max)(1u, std::thread::hardware_concurrency()));
+	ProjectDiffuse(chain, &queue);
+	diffuseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+/// <summary>
+/// Sets the environment lighting's textures, sampler and constants.
+/// Call before the shader's CopyAllBufferData().
+/// </summary>
+void EnvironmentLighting::Bind(std::shared_ptr<SimplePixelShader> pixelShader)
+{
+	pixelShader->SetShaderResourceView("SpecularIbl", specularSRV);
+	pixelShader->SetShaderResourceView("BrdfLut", brdfLutSRV);
+	pixelShader->SetSamplerState("ClampSampler", clampSampler);
+	pixelShader->SetData("shAmbient", shAmbient, sizeof(shAmbient));
+	pixelShader->SetFloat("specularIblMips", specularLevels > 0 ? (float)(specularLevels - 1) : 0.0f);
+	pixelShader->SetFloat("iblIntensity", ready && enabled ? 1.0f : 0.0f);
+}
+
+// Getters
+bool EnvironmentLighting::IsReady() { return ready; }
+bool EnvironmentLighting::IsDiffuseReady() { return diffuseReady; }
+bool EnvironmentLighting::IsEnabled() { return enabled; }
+double EnvironmentLighting::GetBuildMs() { return buildMs; }
+double EnvironmentLighting::GetDiffuseMs() { return diffuseMs; }
+bool EnvironmentLighting::WasBrdfLutCached() { return brdfLutCached; }
+ShCoefficients EnvironmentLighting::GetSkyRadiance() { return skyRadiance; }
+
+// Setters
+void EnvironmentLighting::SetEnabled(bool _enabled) { enabled = _enabled; }
+
+/// <summary>
+/// Reads the cube back, linearizes it and builds its chain of
+/// smaller levels
+/// </summary>
+/// <returns>False if the cube can't be read back</returns>
+bool EnvironmentLighting::ReadChain(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> environment, std::vector<CubeImage>& chain)
+{
+	CubeImage top;
+	if (!environment || !ReadBack(environment.Get(), top))
+		return false;
+
+	// Colors in the sky are gamma encoded, like albedo
+	for (int face = 0; face < 6; face++)
+		for (float& value : top.Faces[face])
+			value = powf((std::max)(value, 0.0f), 2.2f);
+
+	IblPrecompute::BuildChain(top, chain);
+	return true;
+}
+
+/// <summary>
+/// Projects the first level small enough onto SH, for the
+/// diffuse term and the probes
+/// </summary>
+void EnvironmentLighting::ProjectDiffuse(const std::vector<CubeImage>& chain, JobQueue* queue)
+{
+	size_t shLevel = 0;
+	while (shLevel + 1 < chain.size() && chain[shLevel].Size > ShSourceSize)
+		shLevel++;
+	skyRadiance = ShProbeGrid::ProjectCube(chain[shLevel], true, queue);
+	IblPrecompute::PackForShader(IblPrecompute::ConvolveLambert(skyRadiance), shAmbient);
+	diffuseReady = true;
+}
+
+/// <summary>
+/// Copies the cube's faces (from the first mip no bigger than
+/// ReadBackSize) to a staging texture and decodes them
+/// </summary>
+/// <returns>False if it isn't a cube, or its format isn't supported</returns>
+bool EnvironmentLighting::ReadBack(ID3D11ShaderResourceView* environment, CubeImage& cube)
+{
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	environment->GetResource(resource.GetAddressOf());
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(resource.As(&texture)))
+		return false;
+
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+	if (desc.ArraySize < 6 || desc.Width != desc.Height || (desc.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE) == 0)
+		return false;
+
+	UINT mip = 0;
+	while (mip + 1 < desc.MipLevels && (desc.Width >> mip) > ReadBackSize)
+		mip++;
+	unsigned int size = (std::max)(1u, desc.Width >> mip);
+
+	D3D11_TEXTURE2D_DESC stagingDesc = {};
+	stagingDesc.Width = size;
+	stagingDesc.Height = size;
+	stagingDesc.MipLevels = 1;
+	stagingDesc.ArraySize = 6;
+	stagingDesc.Format = desc.Format;
+	stagingDesc.SampleDesc.Count = 1;
+	stagingDesc.Usage = D3D11_USAGE_STAGING;
+	stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staging;
+	if (FAILED(device->CreateTexture2D(&stagingDesc, 0, staging.GetAddressOf())))
+		return false;
+
+	cube.Size = size;
+	for (UINT face = 0; face < 6; face++)
+	{
+		context->CopySubresourceRegion(staging.Get(), face, 0, 0, 0, texture.Get(), D3D11CalcSubresource(mip, face, desc.MipLevels), 0);
+
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(context->Map(staging.Get(), face, D3D11_MAP_READ, 0, &mapped)))
+			return false;
+
+		cube.Faces[face].resize((size_t)size * size * 3);
+		bool decoded = DecodeFace(desc.Format, (const unsigned char*)mapped.pData, mapped.RowPitch, size, cube.Faces[face].data());
+		context->Unmap(staging.Get(), face);
+		if (!decoded)
+		{
+			printf("Environment lighting: unsupported sky format %d\n", (int)desc.Format);
+			return false;
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Uploads the prefiltered levels as a half float cube
+/// </summary>
+bool EnvironmentLighting::CreateSpecularCube(const std::vector<CubeImage>& levels)
+{
+	UINT mipCount = (UINT)levels.size();
+	std::vector<std::vector<HALF>> texels(6 * mipCount);
+	std::vector<D3D11_SUBRESOURCE_DATA> initialData(6 * mipCount);
+	for (UINT face = 0; face < 6; face++)
+	{
+		for (UINT mip = 0; mip < mipCount; mip++)
+		{
+			const CubeImage& level = levels[mip];
+			UINT subresource = D3D11CalcSubresource(mip, face, mipCount);
+			std::vector<HALF>& halves = texels[subresource];
+			halves.resize((size_t)level.Size * level.Size * 4);
+			for (size_t i = 0; i < (size_t)level.Size * level.Size; i++)
+			{
+				for (int c = 0; c < 3; c++)
+					halves[i * 4 + c] = XMConvertFloatToHalf(level.Faces[face][i * 3 + c]);
+				halves[i * 4 + 3] = XMConvertFloatToHalf(1.0f);
+			}
+			initialData[subresource].pSysMem = halves.data();
+			initialData[subresource].SysMemPitch = level.Size * 4 * sizeof(HALF);
+		}
+	}
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = levels[0].Size;
+	desc.Height = levels[0].Size;
+	desc.MipLevels = mipCount;
+	desc.ArraySize = 6;
+	desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(device->CreateTexture2D(&desc, initialData.data(), texture.GetAddressOf())))
+		return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = desc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MipLevels = mipCount;
+	return SUCCEEDED(device->CreateShaderResourceView(texture.Get(), &srvDesc, specularSRV.ReleaseAndGetAddressOf()));
+}
+
+/// <summary>
+/// Uploads the BRDF table as a two channel half float texture
+/// </summary>
+bool EnvironmentLighting::CreateBrdfLut(const BrdfLut& lut)
+{
+	std::vector<HALF> halves(lut.Values.size());
+	for (size_t i = 0; i < halves.size(); i++)
+		halves[i] = XMConvertFloatToHalf(lut.Values[i]);
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = lut.Size;
+	desc.Height = lut.Size;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R16G16_FLOAT;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = halves.data();
+	initialData.SysMemPitch = lut.Size * 2 * sizeof(HALF);
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(device->CreateTexture2D(&desc, &initialData, texture.GetAddressOf())))
+		return false;
+	return SUCCEEDED(device->CreateShaderResourceView(texture.Get(), 0, brdfLutSRV.ReleaseAndGetAddressOf()));
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include "IblPrecompute.h"
+#include "RenderStateCache.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Image-based lighting from the sky's cube map, for the PBR
+// pixel shader's ambient term. Build() reads the cube back
+// from the GPU once and runs IblPrecompute on it:
+//
+//  - Diffuse:  nine SH coefficients, in the constant buffer
+//    (the radiance before convolving seeds ProbeVolume).
+//    BuildDiffuse() makes only these, for setups that light
+//    with probes and skip the rest.
+//  - Specular: a cube with one GGX roughness per mip
+//  - The split-sum BRDF table, cached in a file after the
+//    first run, since it doesn't depend on the environment
+//
+// Sky texels are treated like the rest of the renderer's
+// colors: what the sampler returns is gamma encoded, and
+// lighting happens after raising it to 2.2.
+// --------------------------------------------------------
+class EnvironmentLighting
+{
+	public:
+		EnvironmentLighting(
+			Microsoft::WRL::ComPtr<ID3D11Device> _device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+			std::shared_ptr<RenderStateCache> _renderStates);
+
+		bool Build(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> environment, const std::string& brdfLutCachePath);
+		bool BuildDiffuse(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> environment);
+		void Bind(std::shared_ptr<SimplePixelShader> pixelShader);
+
+		// Getters
+		bool IsReady();
+		bool IsDiffuseReady();
+		bool IsEnabled();
+		double GetBuildMs();
+		double GetDiffuseMs();
+		bool WasBrdfLutCached();
+		ShCoefficients GetSkyRadiance();
+
+		// Setters
+		void SetEnabled(bool _enabled);
+
+	private:
+		bool ReadChain(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> environment, std::vector<CubeImage>& chain);
+		void ProjectDiffuse(const std::vector<CubeImage>& chain, JobQueue* queue);
+		bool ReadBack(ID3D11ShaderResourceView* environment, CubeImage& cube);
+		bool CreateSpecularCube(const std::vector<CubeImage>& levels);
+		bool CreateBrdfLut(const BrdfLut& lut);
+
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		std::shared_ptr<RenderStateCache> renderStates;
+
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> specularSRV;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> brdfLutSRV;
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> clampSampler;
+		ShCoefficients skyRadiance;
+		float shAmbient[9][4];
+		unsigned int specularLevels;
+
+		bool diffuseReady;		// The SH coefficients; ready means the cube and table too
+		bool ready;
+		bool enabled;
+		double buildMs;
+		double diffuseMs;
+		bool brdfLutCached;
+};
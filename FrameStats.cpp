@@ -0,0 +1,214 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+const float FrameStatsSummary::HistogramEdges[HistogramBuckets] = { 4.0f, 8.0f, 12.0f, 16.7f, 20.0f, 25.0f, 33.3f, 50.0f, 100.0f, INFINITY };
+
+/// <summary>
+/// Constructor for the frame stats
+/// </summary>
+/// <param name="_hitchThresholdMs">Any frame longer than this is a hitch</param>
+/// <param name="_hitchMedianMultiplier">Any frame this many times longer than the window's median is a hitch</param>
+FrameStats::FrameStats(float _hitchThresholdMs, float _hitchMedianMultiplier)
+{
+	hitchThresholdMs = _hitchThresholdMs;
+	hitchMedianMultiplier = _hitchMedianMultiplier;
+
+	for (unsigned int i = 0; i < Capacity; i++)
+		samples[i].store(0.0f, std::memory_order_relaxed);
+	writeIndex.store(0);
+
+	dumpsEnabled = false;
+	dumpHeaderWritten = false;
+	dumpFormat = FrameStatsFormat::Csv;
+	dumpInterval = 0.0f;
+	lastDumpTime = 0.0f;
+	dumpTimeStarted = false;
+	lastDumpFrame = 0;
+}
+
+/// <summary>
+/// Adds one frame to the ring. Never blocks or allocates.
+/// </summary>
+/// <param name="deltaSeconds">The frame's delta time in seconds</param>
+void FrameStats::RecordFrame(float deltaSeconds)
+{
+	unsigned long long index = writeIndex.load(std::memory_order_relaxed);
+	samples[index & (Capacity - 1)].store(deltaSeconds * 1000.0f, std::memory_order_relaxed);
+	writeIndex.store(index + 1, std::memory_order_release);
+}
+
+/// <summary>
+/// Total number of frames ever recorded
+/// </summary>
+unsigned long long FrameStats::GetFrameCount() const
+{
+	return writeIndex.load(std::memory_order_acquire);
+}
+
+/// <summary>
+/// Summarizes the most recent frames
+/// </summary>
+/// <param name="frameCount">How many frames to include</param>
+FrameStatsSummary FrameStats::SummarizeLatest(unsigned int frameCount) const
+{
+	unsigned long long end = GetFrameCount();
+	return Summarize(end > frameCount ? end - frameCount : 0);
+}
+
+/// <summary>
+/// Summarizes every frame recorded from firstFrame up to now. Frames that
+/// have already been overwritten in the ring are skipped.
+/// </summary>
+/// <param name="firstFrame">Index of the first frame in the window</param>
+FrameStatsSummary FrameStats::Summarize(unsigned long long firstFrame) const
+{
+	FrameStatsSummary summary;
+
+	// Copy the window out of the ring
+	unsigned long long end = writeIndex.load(std::memory_order_acquire);
+	unsigned long long start = std::max(firstFrame, end > Capacity ? end - Capacity : 0ull);
+	if (start >= end)
+		return summary;
+
+	std::vector<float> window;
+	window.reserve((size_t)(end - start));
+	for (unsigned long long i = start; i < end; i++)
+		window.push_back(samples[i & (Capacity - 1)].load(std::memory_order_relaxed));
+
+	// The producer may have lapped us while copying, so drop anything it overwrote
+	unsigned long long endAfterCopy = writeIndex.load(std::memory_order_acquire);
+	if (endAfterCopy > Capacity && endAfterCopy - Capacity > start)
+	{
+		size_t overwritten = (size_t)std::min<unsigned long long>(endAfterCopy - Capacity - start, window.size());
+		window.erase(window.begin(), window.begin() + overwritten);
+		if (window.empty())
+			return summary;
+	}
+
+	// Histogram, average and hitches against the fixed threshold
+	double total = 0.0;
+	for (float ms : window)
+	{
+		total += ms;
+
+		unsigned int bucket = 0;
+		while (bucket < FrameStatsSummary::HistogramBuckets - 1 && ms > FrameStatsSummary::HistogramEdges[bucket])
+			bucket++;
+		summary.Histogram[bucket]++;
+	}
+
+	summary.FrameCount = (unsigned int)window.size();
+	summary.AverageMs = (float)(total / window.size());
+
+	// Percentiles (nearest rank)
+	std::sort(window.begin(), window.end());
+	auto percentile = [&](float p)
+	{
+		size_t rank = (size_t)std::ceil(p * window.size());
+		return window[std::min(window.size() - 1, rank > 0 ? rank - 1 : 0)];
+	};
+	summary.MinMs = window.front();
+	summary.P50Ms = percentile(0.50f);
+	summary.P95Ms = percentile(0.95f);
+	summary.P99Ms = percentile(0.99f);
+	summary.MaxMs = window.back();
+
+	// A hitch is a frame that is slow in absolute terms or relative to the median
+	float hitchMs = std::min(hitchThresholdMs, summary.P50Ms * hitchMedianMultiplier);
+	summary.HitchCount = (unsigned int)(window.end() - std::upper_bound(window.begin(), window.end(), hitchMs));
+
+	return summary;
+}
+
+/// <summary>
+/// Turns on periodic dumps of summaries to a file. Each dump appends
+/// one CSV row or one JSON object per line.
+/// </summary>
+/// <param name="_path">The file to append to</param>
+/// <param name="_format">CSV or JSON lines</param>
+/// <param name="_intervalSeconds">Time between dumps</param>
+void FrameStats::EnableDumps(const std::string& _path, FrameStatsFormat _format, float _intervalSeconds)
+{
+	dumpPath = _path;
+	dumpFormat = _format;
+	dumpInterval = _intervalSeconds;
+	dumpsEnabled = true;
+	dumpHeaderWritten = false;
+	dumpTimeStarted = false;
+	lastDumpFrame = GetFrameCount();
+}
+
+void FrameStats::DisableDumps() { dumpsEnabled = false; }
+bool FrameStats::AreDumpsEnabled() const { return dumpsEnabled; }
+
+/// <summary>
+/// Writes a dump if one is due. The first call after EnableDumps
+/// only starts the interval, so the first dump comes a full
+/// interval after dumps are turned on.
+/// </summary>
+/// <param name="totalTime">Time since the program started</param>
+void FrameStats::Update(float totalTime)
+{
+	if (dumpsEnabled && !dumpTimeStarted)
+	{
+		lastDumpTime = totalTime;
+		lastDumpFrame = GetFrameCount();
+		dumpTimeStarted = true;
+		return;
+	}
+	if (!dumpsEnabled || totalTime - lastDumpTime < dumpInterval)
+		return;
+
+	Dump(Summarize(lastDumpFrame), totalTime);
+	lastDumpTime = totalTime;
+	lastDumpFrame = GetFrameCount();
+}
+
+/// <summary>
+/// Appends a summary to the dump file
+/// </summary>
+/// <returns>False if the file could not be opened</returns>
+bool FrameStats::Dump(const FrameStatsSummary& summary, float totalTime)
+{
+	std::ofstream file(dumpPath, std::ios::app);
+	if (!file.is_open())
+		return false;
+
+	char line[512];
+	if (dumpFormat == FrameStatsFormat::Csv)
+	{
+		if (!dumpHeaderWritten)
+		{
+			file << "time_s,frames,avg_ms,min_ms,p50_ms,p95_ms,p99_ms,max_ms,hitches";
+			for (unsigned int b = 0; b < FrameStatsSummary::HistogramBuckets; b++)
+				file << ",hist_" << b;
+			file << "\n";
+		}
+
+		snprintf(line, sizeof(line), "%.3f,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%u",
+			totalTime, summary.FrameCount, summary.AverageMs, summary.MinMs,
+			summary.P50Ms, summary.P95Ms, summary.P99Ms, summary.MaxMs, summary.HitchCount);
+		file << line;
+		for (unsigned int b = 0; b < FrameStatsSummary::HistogramBuckets; b++)
+			file << "," << summary.Histogram[b];
+		file << "\n";
+	}
+	else
+	{
+		snprintf(line, sizeof(line), "{\"time_s\":%.3f,\"frames\":%u,\"avg_ms\":%.3f,\"min_ms\":%.3f,\"p50_ms\":%.3f,\"p95_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f,\"hitches\":%u,\"histogram\":[",
+			totalTime, summary.FrameCount, summary.AverageMs, summary.MinMs,
+			summary.P50Ms, summary.P95Ms, summary.P99Ms, summary.MaxMs, summary.HitchCount);
+		file << line;
+		for (unsigned int b = 0; b < FrameStatsSummary::HistogramBuckets; b++)
+			file << (b == 0 ? "" : ",") << summary.Histogram[b];
+		file << "]}\n";
+	}
+
+	dumpHeaderWritten = true;
+	return true;
+}
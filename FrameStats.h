@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+// File formats for periodic frame stat dumps
+enum class FrameStatsFormat
+{
+	Csv,
+	Json
+};
+
+// --------------------------------------------------------
+// Summary of a window of frames
+// --------------------------------------------------------
+struct FrameStatsSummary
+{
+	static const unsigned int HistogramBuckets = 10;
+
+	// Upper edge (ms) of each histogram bucket, the last one is open ended
+	static const float HistogramEdges[HistogramBuckets];
+
+	unsigned int FrameCount = 0;
+	float AverageMs = 0.0f;
+	float MinMs = 0.0f;
+	float P50Ms = 0.0f;
+	float P95Ms = 0.0f;
+	float P99Ms = 0.0f;
+	float MaxMs = 0.0f;
+	unsigned int HitchCount = 0;
+	unsigned int Histogram[HistogramBuckets] = {};
+};
+
+// --------------------------------------------------------
+// What drawing the scene cost in API work, per frame
+// --------------------------------------------------------
+struct DrawStats
+{
+	unsigned int DrawCalls = 0;
+	unsigned int BindGroups = 0;	// Material bindings (shaders, textures, samplers) applied
+	unsigned int Instances = 0;		// Entities drawn
+	unsigned int DepthDrawCalls = 0;	// Depth pre-pass draws, not counted in DrawCalls
+	bool Batched = false;			// Drawn from the material table with instancing
+};
+
+// --------------------------------------------------------
+// Records every frame's delta time into a lock-free ring and
+// computes percentiles, hitch counts and a histogram from it.
+//
+// RecordFrame() is meant to be called by exactly one thread
+// (the game loop); summaries may be built from any thread.
+// --------------------------------------------------------
+class FrameStats
+{
+	public:
+		static const unsigned int Capacity = 8192;	// Must be a power of two
+
+		FrameStats(float _hitchThresholdMs = 50.0f, float _hitchMedianMultiplier = 2.5f);
+
+		// Producer side
+		void RecordFrame(float deltaSeconds);
+
+		// Summaries
+		unsigned long long GetFrameCount() const;
+		FrameStatsSummary Summarize(unsigned long long firstFrame) const;
+		FrameStatsSummary SummarizeLatest(unsigned int frameCount) const;
+
+		// Periodic dumps
+		void EnableDumps(const std::string& _path, FrameStatsFormat _format, float _intervalSeconds);
+		void DisableDumps();
+		bool AreDumpsEnabled() const;
+		void Update(float totalTime);
+		bool Dump(const FrameStatsSummary& summary, float totalTime);
+
+	private:
+		float hitchThresholdMs;
+		float hitchMedianMultiplier;
+
+		// Ring buffer of frame times in milliseconds
+		std::atomic<float> samples[Capacity];
+		std::atomic<unsigned long long> writeIndex;
+
+		// Dump settings
+		bool dumpsEnabled;
+		bool dumpHeaderWritten;
+		std::string dumpPath;
+		FrameStatsFormat dumpFormat;
+		float dumpInterval;
+		float lastDumpTime;				// Not started until the first Update after EnableDumps
+		bool dumpTimeStarted;
+		unsigned long long lastDumpFrame;
+};
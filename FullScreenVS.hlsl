@@ -0,0 +1,20 @@
+// The corners come from SV_VertexID alone; there's no vertex buffer
+struct VertexToPixel
+{
+	float4 position			: SV_POSITION;
+	float2 uv				: TEXCOORD;
+};
+
+// --------------------------------------------------------
+// One triangle covering the whole screen, like the sky's:
+// corners at (-1, 1), (3, 1) and (-1, -3) in clip space,
+// clockwise. UVs run 0 to 1 across the screen, with (0, 0)
+// at the top left.
+// --------------------------------------------------------
+VertexToPixel main(uint vertexID : SV_VertexID)
+{
+	VertexToPixel output;
+	output.uv = float2((vertexID << 1) & 2, vertexID & 2);
+	output.position = float4(output.uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+	return output;
+}
@@ -1,6 +1,11 @@
 #include "Game.h"
 #include "Vertex.h"
 #include "Input.h"
+#include "D3D11GpuTimestampBackend.h"
+#include <algorithm>
+#include <float.h>
+#include <filesystem>
+#include <thread>
 //#include "WICTextureLoader.h"
 #include "packages/directxtk_desktop_win10.2022.3.24.2/include/WICTextureLoader.h"
 #include "packages/directxtk_desktop_win10.2022.3.24.2/include/DDSTextureLoader.h"
@@ -20,15 +25,28 @@ using namespace DirectX;
 // DirectX itself, and our window, are not ready yet!
 //
 // hInstance - the application's OS-level handle (unique ID)
+// _benchmark - settings for the headless benchmark mode
 // --------------------------------------------------------
-Game::Game(HINSTANCE hInstance)
+Game::Game(HINSTANCE hInstance, BenchmarkOptions _benchmark)
 	: DXCore(
 		hInstance,		   // The application's handle
 		"DirectX Game",	   // Text for the window's title bar
 		1280,			   // Width of the window's client area
 		720,			   // Height of the window's client area
 		true),			   // Show extra stats (fps) in title bar?
-	vsync(false)
+	vsync(false),
+	batchMaterials(_benchmark.BatchMaterials && _benchmark.StreamBudgetMB == 0),
+	lodsEnabled(true),
+	coarseShading(_benchmark.CoarseShading || !_benchmark.Enabled),
+	coarseEntities(0),
+	clusterCulling(true),
+	occlusionCulling(true),
+	depthPrepass(_benchmark.DepthPrepass),
+	depthPrepassActive(false),
+	depthEqualState(0),
+	gpuFrameSamples(0),
+	benchmark(_benchmark),
+	benchmarkFrame(0)
 {
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
@@ -61,8 +79,19 @@ void Game::Init()
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
+	renderStates = std::make_shared<RenderStateCache>(device, context);
 	LoadShaders();
 	CreateBasicGeometry();
+
+	// Scales the resolution for a 60 Hz frame; benchmarks stay at full
+	// size, unless they're given a GPU time to hold
+	ResolutionSettings resolutionSettings;
+	if (benchmark.DynamicResolutionMs > 0.0f)
+		resolutionSettings.TargetMs = benchmark.DynamicResolutionMs;
+	dynamicResolution = std::make_shared<DynamicResolution>(device, context, renderStates, fullScreenVertexShader, upscalePixelShader, resolutionSettings);
+	dynamicResolution->SetEnabled(!benchmark.Enabled || benchmark.DynamicResolutionMs > 0.0f);
+	if (!dynamicResolution->Resize(width, height))
+		printf("Unable to create the dynamic resolution targets\n");
 	
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
@@ -73,28 +102,28 @@ void Game::Init()
 	ambientLight = DirectX::XMFLOAT3(0.0f, 0.0f, 0.05f);
 
 	// Directinal Light 1
-	directionalLight1 = {};
+	Light directionalLight1 = {};
 	directionalLight1.Type = 0;
 	directionalLight1.Direction = DirectX::XMFLOAT3(1, -1, 0);
 	directionalLight1.Color = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
 	directionalLight1.Intensity = 0.5f;
 
 	// Directional Light 2
-	directionalLight2 = {};
+	Light directionalLight2 = {};
 	directionalLight2.Type = 0;
 	directionalLight2.Direction = DirectX::XMFLOAT3(-1, -1, 0);
 	directionalLight2.Color = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
 	directionalLight2.Intensity = 0.5f;
 
 	// Directional Light 3
-	directionalLight3 = {};
+	Light directionalLight3 = {};
 	directionalLight3.Type = 0;
 	directionalLight3.Direction = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
 	directionalLight3.Color = DirectX::XMFLOAT3(1.0, 0.0f, 0.0f);
 	directionalLight3.Intensity = 0.5f;
 
 	// Point Light 1
-	pointLight1 = {};
+	Light pointLight1 = {};
 	pointLight1.Type = 1;
 	pointLight1.Range = 4.0f;
 	pointLight1.Position = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
@@ -102,31 +131,199 @@ void Game::Init()
 	pointLight1.Color = DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f);
 
 	// Point Light 2
-	pointLight2 = {};
+	Light pointLight2 = {};
 	pointLight2.Type = 1;
 	pointLight2.Range = 4.0f;
 	pointLight2.Position = DirectX::XMFLOAT3(4.0f, 1.0f, 0.0f);
 	pointLight2.Intensity = 3.0f;
 	pointLight2.Color = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
 
+	lights.push_back(directionalLight1);
+	lights.push_back(directionalLight2);
+	lights.push_back(directionalLight3);
+	lights.push_back(pointLight1);
+	lights.push_back(pointLight2);
+
+	// Swaps the hand-built scene for a generated one, built from the 3D meshes
+	// (everything after the three 2D shapes) and copies of the PBR materials
+	if (benchmark.Scene.EntityCount > 0)
+	{
+		std::vector<std::shared_ptr<Mesh>> meshPool(meshes.begin() + 3, meshes.end());
+		std::vector<std::shared_ptr<Material>> materialPool = materials;
+
+		entities.clear();
+		std::vector<std::shared_ptr<Material>> generatedMaterials;
+		sceneGenerator = std::make_shared<SceneGenerator>(benchmark.Scene);
+		sceneGenerator->Generate((unsigned int)meshPool.size(), (unsigned int)materialPool.size(),
+			[&](const MaterialVariation& variation)
+			{
+				std::shared_ptr<Material> material = std::make_shared<Material>(*materialPool[variation.BaseMaterial]);
+				material->SetColorTint(variation.ColorTint);
+				material->SetRoughness(variation.Roughness);
+				material->SetUvOffset(variation.UvOffset);
+				generatedMaterials.push_back(material);
+				materials.push_back(material);
+			},
+			[&](unsigned int mesh, unsigned int material)
+			{
+				entities.push_back(std::make_shared<Entity>(meshPool[mesh], generatedMaterials[material]));
+				return entities.back()->GetTransform();
+			},
+			lights);
+	}
+
+	// Materials on the PBR shader can share draws once their textures are in arrays
+	materialTable = std::make_shared<MaterialTable>(device, context, std::vector<std::string>{ "AlbedoTexture", "NormalMap", "OrmMap" });
+	for (std::shared_ptr<Material>& material : materials)
+	{
+		if (material->GetPixelShader() == pixelShader)
+			materialTable->Add(material);
+	}
+	PrecompilePixelShaderVariants();
+	instanceBatcher = std::make_shared<InstanceBatcher>(device, context);
+	occlusionCuller = std::make_shared<OcclusionCuller>(OcclusionSettings());
+
+	// After the depth pre-pass, the main pass only draws what matches it
+	D3D11_DEPTH_STENCIL_DESC equalDesc = {};
+	equalDesc.DepthEnable = true;
+	equalDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	equalDesc.DepthFunc = D3D11_COMPARISON_EQUAL;
+	depthEqualState = renderStates->GetDepthStencilId(equalDesc);
+	shadowRenderer = std::make_shared<ShadowRenderer>(device, context, renderStates, shadowVertexShader, CascadeSettings());
+
+	// Sets up the profilers
+	cpuProfiler = std::make_shared<CpuProfiler>();
+	gpuProfiler = std::make_shared<GpuProfiler>(std::make_shared<D3D11GpuTimestampBackend>(device, context));
+
+	// The benchmark flies the camera around the scene once over the measured frames
+	if (benchmark.Enabled)
+	{
+		float radius = sceneGenerator ? (std::max)(sceneGenerator->GetRadius() * 1.2f, 10.0f) : 20.0f;
+		benchmarkPath = CameraPath::CreateFlythrough(XMFLOAT3(0.0f, 0.0f, 0.0f), radius, radius * 0.2f, benchmark.FrameCount * benchmark.FixedDeltaTime);
+	}
 }
 
 // --------------------------------------------------------
-// Loads shaders from compiled shader object (.cso) files
-// and also created the Input Layout that describes our 
-// vertex data to the rendering pipeline. 
-// - Input Layout creation is done here because it must 
-//    be verified against vertex shader byte code
-// - We'll have that byte code already loaded below
+// Loads shaders through the shader manager, which compiles
+// the HLSL source on a background thread (or pulls it from
+// the on-disk cache) and builds each vertex shader's Input
+// Layout from its reflected inputs.
+// - The prebuilt .cso files are used if the source is missing
+// - Edited .hlsl/.hlsli files are recompiled while running
 // --------------------------------------------------------
 void Game::LoadShaders()
 {
+	shaderManager = std::make_shared<ShaderManager>(
+		device,
+		context,
+		GetFullPathTo("../../"),
+		GetFullPathTo("ShaderCache"),
+		GetExePath());
+
+	// Benchmarks shouldn't change halfway through a run
+	shaderManager->SetHotReload(!benchmark.Enabled);
+
 	// Loads in the simple shaders
-	vertexShader = std::make_shared<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"VertexShader.cso").c_str());
-	pixelShader = std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"PixelShader.cso").c_str());
-	customPS = std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"CustomPS.cso").c_str());
-	skyVertexShader = std::make_shared<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"SkyVertexShader.cso").c_str());
-	skyPixelShader = std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"SkyPixelShader.cso").c_str());
+	vertexShader = shaderManager->GetVertexShader("VertexShader.hlsl");
+	pixelShader = shaderManager->GetPixelShader("PixelShader.hlsl");
+	customPS = shaderManager->GetPixelShader("CustomPS.hlsl");
+	skyVertexShader = shaderManager->GetVertexShader("SkyVertexShader.hlsl");
+	skyPixelShader = shaderManager->GetPixelShader("SkyPixelShader.hlsl");
+	shadowVertexShader = shaderManager->GetVertexShader("ShadowDepthVS.hlsl");
+	depthPrepassVertexShader = shaderManager->GetVertexShader("DepthPrepassVS.hlsl");
+
+	// The same shaders, reading transforms and materials from buffers
+	std::vector<ShaderDefine> batched = { { "BATCHED", "1" } };
+	batchedVertexShader = shaderManager->GetVertexShader("VertexShader.hlsl", batched);
+	batchedDepthPrepassVertexShader = shaderManager->GetVertexShader("DepthPrepassVS.hlsl", batched);
+
+	// The PBR shader's permutations. The full ones (every map, the sky,
+	// lights looped over) stand in while the rest compile: one at a time
+	// or batched, and lit per pixel or once per 2x2 quad, for entities
+	// far away or small on screen.
+	pixelShaderVariants = std::make_shared<ShaderVariantCache<std::shared_ptr<SimplePixelShader>>>(
+		[this](const std::vector<ShaderDefine>& defines) { return shaderManager->GetPixelShader("PixelShader.hlsl", defines); });
+	for (unsigned int pipeline : { 0u, ShaderPermutations::Batched, ShaderPermutations::CoarseLighting, ShaderPermutations::Batched | ShaderPermutations::CoarseLighting })
+		pixelShaderVariants->Get(ShaderPermutations::MakeKey(ShaderPermutations::Full | pipeline, ShaderPermutations::LoopedLights));
+
+	// Stretches a smaller scene over the back buffer
+	fullScreenVertexShader = shaderManager->GetVertexShader("FullScreenVS.hlsl");
+	upscalePixelShader = shaderManager->GetPixelShader("UpscalePS.hlsl");
+
+	// Everything here is needed for the first frame
+	shaderManager->WaitForAll();
+}
+
+// --------------------------------------------------------
+// Compiles the PBR shader's permutations the scene will ask
+// for: each material's maps, without ambient light, with the
+// sky's if it's built (F5), and with SH-only ambient if the
+// sky's SH is (for the probes); per pixel and per quad, for
+// the lights there are. Waits for them, so the first frames
+// don't draw with fallbacks.
+// --------------------------------------------------------
+void Game::PrecompilePixelShaderVariants()
+{
+	int lightCount = (int)(std::min)(lights.size(), (size_t)MAX_LIGHTS);
+	std::vector<unsigned int> featureSets = { ShaderPermutations::Maps | ShaderPermutations::Batched };
+	for (std::shared_ptr<Material>& material : materials)
+	{
+		if (material->GetPixelShader() == pixelShader &&
+			std::find(featureSets.begin(), featureSets.end(), material->GetShaderFeatures()) == featureSets.end())
+			featureSets.push_back(material->GetShaderFeatures());
+	}
+
+	std::vector<unsigned int> scenes = { 0u };
+	if (environmentLighting->IsReady())
+		scenes.push_back(ShaderPermutations::EnvironmentLight);
+	if (environmentLighting->IsDiffuseReady())
+		scenes.push_back(ShaderPermutations::ProbeAmbientOnly);
+
+	for (unsigned int features : featureSets)
+	{
+		for (unsigned int scene : scenes)
+		{
+			pixelShaderVariants->Get(ShaderPermutations::MakeKey(features | scene, lightCount));
+			pixelShaderVariants->Get(ShaderPermutations::MakeKey(features | scene | ShaderPermutations::CoarseLighting, lightCount));
+		}
+	}
+	shaderManager->WaitForAll();
+	printf("%zu pixel shader permutations (%s for the PBR materials)\n", pixelShaderVariants->GetCount(),
+		ShaderPermutations::Describe(ShaderPermutations::MakeKey(ShaderPermutations::Full, lightCount)).c_str());
+}
+
+// --------------------------------------------------------
+// The PBR shader's permutation for a feature mask and light
+// count. One that's still compiling (or failed to) falls
+// back to the full permutation with the same pipeline bits,
+// which draws the same for materials with every map (and
+// ignores the sky when its intensity is 0).
+// --------------------------------------------------------
+std::shared_ptr<SimplePixelShader> Game::GetPixelShaderVariant(unsigned int features, int lightCount)
+{
+	std::shared_ptr<SimplePixelShader> variant = pixelShaderVariants->Get(ShaderPermutations::MakeKey(features, lightCount));
+	if (variant->IsShaderValid())
+		return variant;
+
+	unsigned int pipeline = features & (ShaderPermutations::Batched | ShaderPermutations::CoarseLighting);
+	return pixelShaderVariants->Get(ShaderPermutations::MakeKey(ShaderPermutations::Full | pipeline, ShaderPermutations::LoopedLights));
+}
+
+// --------------------------------------------------------
+// Features every PBR draw this frame shares: the sky's
+// light, once it's built and while it's on. Without it,
+// picked probes still light the scene from their SH alone,
+// as does the sky's own SH when only that was built
+// (-probeambient).
+// --------------------------------------------------------
+unsigned int Game::GetSceneShaderFeatures()
+{
+	if (environmentLighting->IsReady() && environmentLighting->IsEnabled())
+		return ShaderPermutations::EnvironmentLight;
+	bool probesPicked = probeVolume->IsReady() && probeVolume->GetMode() != AmbientMode::Sky;
+	if (probesPicked || (!environmentLighting->IsReady() && environmentLighting->IsDiffuseReady()))
+		return ShaderPermutations::ProbeAmbientOnly;
+	return 0;
 }
 
 
@@ -198,7 +395,7 @@ void Game::CreateBasicGeometry()
 	std::shared_ptr<Mesh> mesh3 = std::make_shared<Mesh>(vertices3, sizeof(vertices3)/sizeof(Vertex), indices3, sizeof(indices3)/sizeof(unsigned int), device, context);
 	meshes.push_back(mesh3);
 
-	// Creates a sampler state
+	// Gets a sampler state
 	D3D11_SAMPLER_DESC ssd = {};
 	ssd.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
 	ssd.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -206,42 +403,18 @@ void Game::CreateBasicGeometry()
 	ssd.Filter = D3D11_FILTER_ANISOTROPIC;
 	ssd.MaxAnisotropy = 16;
 	ssd.MaxLOD = D3D11_FLOAT32_MAX;
-	device->CreateSamplerState(&ssd, samplerState.GetAddressOf());
-
-	// Loads in textures
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/cushion.png").c_str(), nullptr, texture1.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/cushion_normals.png").c_str(), nullptr, normal1.GetAddressOf());
-
-	// Loads in PBR textures
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/scratched_albedo.png").c_str(), nullptr, albedo1.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/scratched_normals.png").c_str(), nullptr, normals1.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/scratched_roughness.png").c_str(), nullptr, roughness1.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/scratched_metalness.png").c_str(), nullptr, metalness1.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/floor_albedo.png").c_str(), nullptr, albedo2.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/floor_normals.png").c_str(), nullptr, normals2.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/floor_roughness.png").c_str(), nullptr, roughness2.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/floor_metalness.png").c_str(), nullptr, metalness2.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/paint_albedo.png").c_str(), nullptr, albedo3.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/paint_normals.png").c_str(), nullptr, normals3.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/paint_roughness.png").c_str(), nullptr, roughness3.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/paint_metalness.png").c_str(), nullptr, metalness3.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/rough_albedo.png").c_str(), nullptr, albedo4.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/rough_normals.png").c_str(), nullptr, normals4.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/rough_roughness.png").c_str(), nullptr, roughness4.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/rough_metalness.png").c_str(), nullptr, metalness4.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/cobblestone_albedo.png").c_str(), nullptr, albedo5.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/cobblestone_normals.png").c_str(), nullptr, normals5.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/cobblestone_roughness.png").c_str(), nullptr, roughness5.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/cobblestone_metalness.png").c_str(), nullptr, metalness5.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/bronze_albedo.png").c_str(), nullptr, albedo6.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/bronze_normals.png").c_str(), nullptr, normals6.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/bronze_roughness.png").c_str(), nullptr, roughness6.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/bronze_metalness.png").c_str(), nullptr, metalness6.GetAddressOf());
+	samplerState = renderStates->GetSampler(renderStates->GetSamplerId(ssd));
+
+	// Starts loading textures. They show placeholders until they've
+	// been decoded (on worker threads) and uploaded (in Update).
+	textureManager = std::make_shared<TextureManager>(device, context);
+	if (benchmark.StreamBudgetMB > 0)
+	{
+		textureStreamer = std::make_shared<TextureStreamer>(device, context, (size_t)benchmark.StreamBudgetMB * 1024 * 1024);
+		textureManager->SetStreamer(textureStreamer);
+	}
+	texture1 = textureManager->Load(GetFullPathTo_Wide(L"../../Assets/Textures/cushion.png"));
+	normal1 = textureManager->Load(GetFullPathTo_Wide(L"../../Assets/Textures/cushion_normals.png"), TexturePlaceholder::FlatNormal);
 
 	// Creates Materials
 	materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), vertexShader, pixelShader, 0.5f, 1.0f, XMFLOAT2(0.0f, 0.0f)));
@@ -253,78 +426,69 @@ void Game::CreateBasicGeometry()
 
 	// Adds the texture to the materials
 	/*
-	materials[0]->AddTextureSRV("SurfaceTexture", texture1);
-	materials[0]->AddTextureSRV("NormalMap", normal1);
+	materials[0]->AddTexture("SurfaceTexture", texture1);
+	materials[0]->AddTexture("NormalMap", normal1);
 	materials[0]->AddSampler("BasicSampler", samplerState);
 
-	materials[1]->AddTextureSRV("SurfaceTexture", texture1);
-	materials[1]->AddTextureSRV("NormalMap", normal1);
+	materials[1]->AddTexture("SurfaceTexture", texture1);
+	materials[1]->AddTexture("NormalMap", normal1);
 	materials[1]->AddSampler("BasicSampler", samplerState);
 
-	materials[2]->AddTextureSRV("SurfaceTexture", texture1);
-	materials[2]->AddTextureSRV("NormalMap", normal1);
+	materials[2]->AddTexture("SurfaceTexture", texture1);
+	materials[2]->AddTexture("NormalMap", normal1);
 	materials[2]->AddSampler("BasicSampler", samplerState);
 
-	materials[3]->AddTextureSRV("SurfaceTexture", texture1);
-	materials[3]->AddTextureSRV("NormalMap", normal1);
+	materials[3]->AddTexture("SurfaceTexture", texture1);
+	materials[3]->AddTexture("NormalMap", normal1);
 	materials[3]->AddSampler("BasicSampler", samplerState);
 
-	materials[4]->AddTextureSRV("SurfaceTexture", texture1);
-	materials[4]->AddTextureSRV("NormalMap", normal1);
+	materials[4]->AddTexture("SurfaceTexture", texture1);
+	materials[4]->AddTexture("NormalMap", normal1);
 	materials[4]->AddSampler("BasicSampler", samplerState);
 	*/
 
-	materials[0]->AddTextureSRV("AlbedoTexture", albedo1);
-	materials[0]->AddTextureSRV("NormalMap", normals1);
-	materials[0]->AddTextureSRV("RoughnessMap", roughness1);
-	materials[0]->AddTextureSRV("MetalnessMap", metalness1);
-	materials[0]->AddSampler("BasicSampler", samplerState);
-
-	materials[1]->AddTextureSRV("AlbedoTexture", albedo2);
-	materials[1]->AddTextureSRV("NormalMap", normals2);
-	materials[1]->AddTextureSRV("RoughnessMap", roughness2);
-	materials[1]->AddTextureSRV("MetalnessMap", metalness2);
-	materials[1]->AddSampler("BasicSampler", samplerState);
-
-	materials[2]->AddTextureSRV("AlbedoTexture", albedo3);
-	materials[2]->AddTextureSRV("NormalMap", normals3);
-	materials[2]->AddTextureSRV("RoughnessMap", roughness3);
-	materials[2]->AddTextureSRV("MetalnessMap", metalness3);
-	materials[2]->AddSampler("BasicSampler", samplerState);
-
-	materials[3]->AddTextureSRV("AlbedoTexture", albedo4);
-	materials[3]->AddTextureSRV("NormalMap", normals4);
-	materials[3]->AddTextureSRV("RoughnessMap", roughness4);
-	materials[3]->AddTextureSRV("MetalnessMap", metalness4);
-	materials[3]->AddSampler("BasicSampler", samplerState);
-
-	materials[4]->AddTextureSRV("AlbedoTexture", albedo5);
-	materials[4]->AddTextureSRV("NormalMap", normals5);
-	materials[4]->AddTextureSRV("RoughnessMap", roughness5);
-	materials[4]->AddTextureSRV("MetalnessMap", metalness5);
-	materials[4]->AddSampler("BasicSampler", samplerState);
+	// PBR textures, one set per material
+	const wchar_t* pbrSets[] = { L"scratched", L"floor", L"paint", L"rough", L"cobblestone", L"bronze" };
+	for (int i = 0; i < 6; i++)
+	{
+		std::wstring path = GetFullPathTo_Wide(L"../../Assets/Textures/PBR/") + pbrSets[i];
+		materials[i]->AddTexture("AlbedoTexture", textureManager->Load(path + L"_albedo.png"));
+		materials[i]->AddTexture("NormalMap", textureManager->Load(path + L"_normals.png", TexturePlaceholder::FlatNormal));
+
+		// Occlusion, roughness and metalness share one texture (see ChannelPacker)
+		TextureChannel orm[4] = {
+			{ std::filesystem::exists(path + L"_ao.png") ? path + L"_ao.png" : L"", 0, 255 },
+			{ path + L"_roughness.png", 0, 128 },
+			{ path + L"_metal.png", 0, 0 },
+			{ L"", 0, 255 } };
+		materials[i]->AddTexture("OrmMap", textureManager->LoadPacked(orm, TexturePlaceholder::Orm));
+		materials[i]->AddSampler("BasicSampler", samplerState);
+	}
 
-	materials[5]->AddTextureSRV("AlbedoTexture", albedo6);
-	materials[5]->AddTextureSRV("NormalMap", normals6);
-	materials[5]->AddTextureSRV("RoughnessMap", roughness6);
-	materials[5]->AddTextureSRV("MetalnessMap", metalness6);
-	materials[5]->AddSampler("BasicSampler", samplerState);
+	// Benchmarks should measure the finished scene, not placeholders
+	if (benchmark.Enabled)
+		textureManager->WaitForAll();
 
-	// Creates mesh from 3D object
-	std::shared_ptr<Mesh> mesh4 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/sphere.obj").c_str(), device);
+	// Creates mesh from 3D object. The models share one set of workers for
+	// their levels of detail; not the texture or shader queues, since each
+	// model waits for its queue to go idle.
+	JobQueue meshQueue((std::max)(1u, std::thread::hardware_concurrency()));
+	std::shared_ptr<Mesh> mesh4 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/sphere.obj").c_str(), device, true, &meshQueue);
 	meshes.push_back(mesh4);
-	std::shared_ptr<Mesh> mesh5 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/helix.obj").c_str(), device);
+	std::shared_ptr<Mesh> mesh5 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/helix.obj").c_str(), device, true, &meshQueue);
 	meshes.push_back(mesh5);
-	std::shared_ptr<Mesh> mesh6 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/cylinder.obj").c_str(), device);
+	std::shared_ptr<Mesh> mesh6 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/cylinder.obj").c_str(), device, true, &meshQueue);
 	meshes.push_back(mesh6);
-	std::shared_ptr<Mesh> mesh7 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/quad.obj").c_str(), device);
+	std::shared_ptr<Mesh> mesh7 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/quad.obj").c_str(), device, true, &meshQueue);
 	meshes.push_back(mesh7);
-	std::shared_ptr<Mesh> mesh8 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/quad_double_sided.obj").c_str(), device);
+	std::shared_ptr<Mesh> mesh8 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/quad_double_sided.obj").c_str(), device, true, &meshQueue);
 	meshes.push_back(mesh8);
-	std::shared_ptr<Mesh> mesh9 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/torus.obj").c_str(), device);
+	std::shared_ptr<Mesh> mesh9 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/torus.obj").c_str(), device, true, &meshQueue);
 	meshes.push_back(mesh9);
-	std::shared_ptr<Mesh> mesh10 = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/cube.obj").c_str(), device);
-	meshes.push_back(mesh10);
+
+	// Benchmarks log what packing and simplifying the models cost
+	if (benchmark.Enabled)
+		PrintMeshReports();
 
 	entities.push_back(std::make_shared<Entity>(meshes[3], materials[0]));
 	entities.push_back(std::make_shared<Entity>(meshes[4], materials[1]));
@@ -335,7 +499,28 @@ void Game::CreateBasicGeometry()
 
 	// Creates the skybox texture
 	CreateDDSTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/sunnyCubeMap.dds").c_str(), nullptr, skyboxTexture.GetAddressOf());
-	skybox = std::make_shared<Sky>(meshes[9], samplerState, device, skyVertexShader, skyPixelShader, skyboxTexture);
+	skybox = std::make_shared<Sky>(samplerState, renderStates, skyVertexShader, skyPixelShader, skyboxTexture);
+
+	// Precomputes the sky's diffuse and specular lighting; the BRDF table is cached next to the executable.
+	// With -probeambient only its SH is projected, which is all the probes need.
+	environmentLighting = std::make_shared<EnvironmentLighting>(device, context, renderStates);
+	if (benchmark.ProbeAmbientOnly)
+	{
+		if (environmentLighting->BuildDiffuse(skyboxTexture))
+			printf("Sky SH projected in %.1f ms (no prefiltered cube or BRDF table)\n", environmentLighting->GetDiffuseMs());
+		else
+			printf("Unable to project the skybox's ambient light\n");
+	}
+	else if (environmentLighting->Build(skyboxTexture, GetFullPathTo("BrdfLut.bin")))
+		printf("Environment lighting built in %.1f ms (BRDF table %s)\n", environmentLighting->GetBuildMs(), environmentLighting->WasBrdfLutCached() ? "cached" : "computed");
+	else
+		printf("Unable to build environment lighting from the skybox\n");
+
+	probeVolume = std::make_shared<ProbeVolume>(device, context);
+	if (environmentLighting->IsDiffuseReady())
+		BuildProbeVolume();
+	if (benchmark.ProbeAmbientOnly && probeVolume->IsReady())
+		probeVolume->SetMode(AmbientMode::ProbePerEntity);
 }
 
 
@@ -348,6 +533,9 @@ void Game::OnResize()
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
 
+	// The scene's targets match the back buffer
+	if (dynamicResolution)
+		dynamicResolution->Resize(width, height);
 
 	camera->UpdateProjectionMatrix((float)width/height);
 }
@@ -357,9 +545,160 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
-	// Example input checking: Quit if the escape key is pressed
-	if (Input::GetInstance().KeyDown(VK_ESCAPE))
-		Quit();
+	cpuProfiler->BeginFrame();
+
+	// Stats from the benchmark's warmup frames are thrown away
+	if (benchmark.Enabled && benchmarkFrame++ == benchmark.WarmupFrames)
+		cpuProfiler->ResetStats();
+
+	ProfileScope<CpuProfiler> updateScope(*cpuProfiler, "Update");
+
+	// Picks up finished shader compiles and hot reloads
+	cpuProfiler->BeginScope("Update.Shaders");
+	shaderManager->Update();
+	cpuProfiler->EndScope("Update.Shaders");
+
+	// Uploads a few finished textures per frame
+	cpuProfiler->BeginScope("Update.Textures");
+	textureManager->Update(4);
+	cpuProfiler->EndScope("Update.Textures");
+
+	// There's no window (and no input) while benchmarking
+	if (!benchmark.Enabled)
+	{
+		ProfileScope<CpuProfiler> inputScope(*cpuProfiler, "Update.Input");
+
+		// Example input checking: Quit if the escape key is pressed
+		if (Input::GetInstance().KeyDown(VK_ESCAPE))
+			Quit();
+
+		// Prints the latest CPU and GPU timings to the console
+		if (Input::GetInstance().KeyPress(VK_F1))
+		{
+			printf("%s", cpuProfiler->GetStats().ToString("CPU Timings").c_str());
+			printf("%s", gpuProfiler->GetStats().ToString("GPU Timings").c_str());
+			if (textureStreamer)
+			{
+				ResidencyStats streaming = textureStreamer->GetStats();
+				printf("Texture streaming: %.1f / %.1f MB resident (%.1f MB wanted), %u / %u textures satisfied, %u loads, %u evictions\n",
+					streaming.ResidentBytes / 1048576.0, streaming.BudgetBytes / 1048576.0, streaming.WantedBytes / 1048576.0,
+					streaming.SatisfiedTextures, streaming.Textures, streaming.LoadsIssued, streaming.Evictions);
+			}
+			RenderStateStats states = renderStates->GetStats();
+			printf("Render states: %u samplers, %u rasterizers, %u depth-stencils (%llu of %llu lookups shared), %llu binds, %llu skipped\n",
+				states.Samplers, states.Rasterizers, states.DepthStencils, states.Hits, states.Lookups, states.Binds, states.BindsSkipped);
+		}
+
+		// Toggles periodic frame time dumps
+		if (Input::GetInstance().KeyPress(VK_F2))
+		{
+			if (frameStats.AreDumpsEnabled()) frameStats.DisableDumps();
+			else frameStats.EnableDumps(GetFullPathTo("FrameStats.csv"), FrameStatsFormat::Csv, 5.0f);
+		}
+
+		// Toggles the frame stats in the title bar
+		if (Input::GetInstance().KeyPress(VK_F3))
+			titleBarStats = !titleBarStats;
+
+		// Toggles batched drawing and prints what the last frame cost
+		if (Input::GetInstance().KeyPress(VK_F4) && !textureStreamer)
+		{
+			batchMaterials = !batchMaterials;
+			printf("Batched drawing %s (last frame: %u draws, %u bind groups, %u instances)\n",
+				batchMaterials ? "on" : "off", drawStats.DrawCalls, drawStats.BindGroups, drawStats.Instances);
+		}
+
+		// Toggles the sky's ambient lighting; picked probes (F6) still light from their SH
+		if (Input::GetInstance().KeyPress(VK_F5) && environmentLighting->IsReady())
+		{
+			environmentLighting->SetEnabled(!environmentLighting->IsEnabled());
+			printf("Environment lighting %s\n", environmentLighting->IsEnabled() ? "on" : "off");
+		}
+
+		// Cycles where the diffuse ambient light comes from: sky, probe per entity, probe per pixel
+		if (Input::GetInstance().KeyPress(VK_F6) && probeVolume->IsReady())
+		{
+			AmbientMode mode = (AmbientMode)(((int)probeVolume->GetMode() + 1) % 3);
+			probeVolume->SetMode(mode);
+			const char* names[] = { "sky", "probe per entity", "probe grid per pixel" };
+			printf("Ambient light: %s%s\n", names[(int)mode], GetSceneShaderFeatures() == ShaderPermutations::ProbeAmbientOnly ? " (SH only)" : "");
+		}
+
+		// Toggles levels of detail and prints how many entities drew each level last frame
+		if (Input::GetInstance().KeyPress(VK_F8))
+		{
+			unsigned int counts[4] = {};
+			for (std::shared_ptr<Entity>& entity : entities)
+				counts[(std::min)(entity->GetLod(), 3u)]++;
+			lodsEnabled = !lodsEnabled;
+			printf("Levels of detail %s (last frame: %u / %u / %u / %u+ entities at levels 0 / 1 / 2 / 3)\n", lodsEnabled ? "on" : "off",
+				counts[0], counts[1], counts[2], counts[3]);
+		}
+
+		// Toggles cluster culling and prints what it rejected last frame
+		if (Input::GetInstance().KeyPress(VK_F9))
+		{
+			clusterCulling = !clusterCulling;
+			printf("Cluster culling %s (last frame: %u meshlets, %u outside the view, %u facing away, %u of %u triangles culled, %u draws)\n",
+				clusterCulling ? "on" : "off", meshletStats.Meshlets, meshletStats.FrustumCulled, meshletStats.BackfaceCulled,
+				meshletStats.TrianglesCulled, meshletStats.Triangles, meshletStats.Ranges);
+		}
+
+		// Toggles occlusion culling and prints what it rejected last frame
+		if (Input::GetInstance().KeyPress(VK_F10))
+		{
+			OcclusionStats occlusion = occlusionCuller->GetStats();
+			occlusionCulling = !occlusionCulling;
+			printf("Occlusion culling %s (last frame: %u occluders, %u of %u triangles rasterized, %u of %u entities culled, %.3f ms raster, %.3f ms Hi-Z)\n",
+				occlusionCulling ? "on" : "off", occlusion.Occluders, occlusion.Rasterized, occlusion.Triangles, occlusion.Culled, occlusion.Tested,
+				occlusion.RasterMs, occlusion.HiZMs);
+		}
+
+		// Toggles the depth pre-pass and prints the overdraw it saves, estimated from last frame's entities
+		if (Input::GetInstance().KeyPress(VK_F11))
+		{
+			depthPrepass = !depthPrepass;
+			BuildOverdrawSpheres();
+			OverdrawEstimate overdraw = OverdrawEstimator::Estimate(overdrawSpheres.data(), overdrawSpheres.size(), width, height, OverdrawSettings());
+			printf("Depth pre-pass %s (last frame: %u depth draws; estimated overdraw %.2fx in scene order, %.2fx front to back, %.2fx with the pre-pass)\n",
+				depthPrepass ? "on" : "off", drawStats.DepthDrawCalls, overdraw.GetOverdraw(overdraw.ShadedSubmitted),
+				overdraw.GetOverdraw(overdraw.ShadedFrontToBack), overdraw.GetOverdraw(overdraw.ShadedPrepass));
+		}
+
+		// Toggles coarse shading and prints how many entities it covered
+		if (Input::GetInstance().KeyPress('V'))
+		{
+			coarseShading = !coarseShading;
+			printf("Coarse shading %s (last frame: %u of %zu entities lit once per 2x2 quad)\n", coarseShading ? "on" : "off", coarseEntities, entities.size());
+		}
+
+		// Toggles dynamic resolution and prints where it had got to
+		if (Input::GetInstance().KeyPress('R'))
+		{
+			const ProfileScopeStats* gpuFrame = gpuProfiler->GetStats().GetStats("Frame");
+			float scale = dynamicResolution->GetScale();
+			dynamicResolution->SetEnabled(!dynamicResolution->IsEnabled());
+			printf("Dynamic resolution %s (last frame: %.0f%% of each axis, %.2f ms on the GPU for a %.1f ms target, %u changes)\n",
+				dynamicResolution->IsEnabled() ? "on" : "off", scale * 100.0f, gpuFrame ? gpuFrame->LastMs : 0.0,
+				dynamicResolution->GetController().GetSettings().TargetMs, dynamicResolution->GetController().GetChangeCount());
+		}
+
+		// Prints each model's vertex packing and levels of detail
+		if (Input::GetInstance().KeyPress('M'))
+			PrintMeshReports();
+
+		// Toggles shadows and prints what the last frame's shadow pass cost
+		if (Input::GetInstance().KeyPress(VK_F7))
+		{
+			ShadowStats shadows = shadowRenderer->GetStats();
+			shadowRenderer->SetEnabled(!shadowRenderer->IsEnabled());
+			printf("Shadows %s (last frame: %u cascades, %u draws, %.3f ms fitting and culling; casters", shadowRenderer->IsEnabled() ? "on" : "off",
+				shadows.Cascades, shadows.DrawCalls, shadows.CullMs);
+			for (unsigned int c = 0; c < shadows.Cascades; c++)
+				printf(" %u", shadows.Casters[c]);
+			printf(")\n");
+		}
+	}
 
 	// Updates the test transform
 	/*
@@ -376,12 +715,28 @@ void Game::Update(float deltaTime, float totalTime)
 	//entities[3]->GetTransform()->MoveAbsolute(-0.5f * deltaTime, -0.5f * deltaTime, 0);
 	//entities[4]->GetTransform()->Rotate(0, 0, deltaTime * 0.3f);
 
-	entities[0]->GetTransform()->SetPosition(-10.0f, 0.0f, 0.0f);
-	entities[1]->GetTransform()->SetPosition(-6.0f, 0.0f, 0.0f);
-	entities[2]->GetTransform()->SetPosition(-2.0f, 0.0f, 0.0f);
-	entities[3]->GetTransform()->SetPosition(2.0f, 0.0f, 0.0f);
-	entities[4]->GetTransform()->SetPosition(6.0f, 0.0f, 0.0f);
-	entities[5]->GetTransform()->SetPosition(10.0f, 0.0f, 0.0f);
+	cpuProfiler->BeginScope("Update.Entities");
+	if (sceneGenerator)
+	{
+		sceneGenerator->Update(totalTime);
+	}
+	else
+	{
+		entities[0]->GetTransform()->SetPosition(-10.0f, 0.0f, 0.0f);
+		entities[1]->GetTransform()->SetPosition(-6.0f, 0.0f, 0.0f);
+		entities[2]->GetTransform()->SetPosition(-2.0f, 0.0f, 0.0f);
+		entities[3]->GetTransform()->SetPosition(2.0f, 0.0f, 0.0f);
+		entities[4]->GetTransform()->SetPosition(6.0f, 0.0f, 0.0f);
+		entities[5]->GetTransform()->SetPosition(10.0f, 0.0f, 0.0f);
+	}
+	cpuProfiler->EndScope("Update.Entities");
+
+	// Streams texture mips in and out based on what the camera saw last frame
+	if (textureStreamer)
+	{
+		ProfileScope<CpuProfiler> streamingScope(*cpuProfiler, "Update.Streaming");
+		StreamTextures();
+	}
 
 	/*
 	std::shared_ptr<SimplePixelShader> ps = entities[0]->GetMaterial()->GetPixelShader();
@@ -390,7 +745,33 @@ void Game::Update(float deltaTime, float totalTime)
 	ps->SetFloat("totalTime", totalTime);
 	*/
 
-	camera->Update(deltaTime);
+	// Either follow the scripted benchmark path or the user's input
+	{
+		ProfileScope<CpuProfiler> cameraScope(*cpuProfiler, "Update.Camera");
+		if (benchmark.Enabled)
+		{
+			XMFLOAT3 position;
+			XMFLOAT3 rotation;
+			benchmarkPath.Evaluate(totalTime, position, rotation);
+			camera->GetTransform()->SetPosition(position.x, position.y, position.z);
+			camera->GetTransform()->SetRotation(rotation.x, rotation.y, rotation.z);
+			camera->UpdateViewMatrix();
+		}
+		else
+		{
+			camera->Update(deltaTime);
+		}
+	}
+
+	// Levels of detail for where the camera ended up
+	{
+		ProfileScope<CpuProfiler> lodScope(*cpuProfiler, "Update.Lods");
+		SelectLods();
+	}
+
+	// Occluders are drawn at the levels just picked, the ones the GPU will draw
+	ProfileScope<CpuProfiler> occlusionScope(*cpuProfiler, "Update.Occlusion");
+	CullOccluded();
 }
 
 // --------------------------------------------------------
@@ -398,19 +779,36 @@ void Game::Update(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	gpuProfiler->BeginFrame();
+
+	// Picks this frame's resolution from the latest GPU frame time (a few frames old)
+	const ProfileScopeStats* gpuFrame = gpuProfiler->GetStats().GetStats("Frame");
+	if (gpuFrame && gpuFrame->SampleCount != gpuFrameSamples)
+	{
+		gpuFrameSamples = gpuFrame->SampleCount;
+		dynamicResolution->AddGpuTime((float)gpuFrame->LastMs);
+	}
+
+	// The scene goes into the scaled targets, or straight into the back buffer
+	bool scaled = dynamicResolution->IsActive();
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> sceneRTV = scaled ? dynamicResolution->GetRenderTarget() : backBufferRTV;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> sceneDSV = scaled ? dynamicResolution->GetDepthStencil() : depthStencilView;
+
 	// Background color (Cornflower Blue in this case) for clearing
 	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
 
 	// Clear the render target and depth buffer (erases what's on the screen)
 	//  - Do this ONCE PER FRAME
 	//  - At the beginning of Draw (before drawing *anything*)
-	context->ClearRenderTargetView(backBufferRTV.Get(), color);
+	context->ClearRenderTargetView(sceneRTV.Get(), color);
 	context->ClearDepthStencilView(
-		depthStencilView.Get(),
+		sceneDSV.Get(),
 		D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
 		1.0f,
 		0);
 
+	// Nothing else tracks what's bound, so the first draw sets it all
+	renderStates->Invalidate();
 
 	// Set the vertex and pixel shaders to use for the next Draw() command
 	//  - These don't technically need to be set every frame
@@ -427,63 +825,597 @@ void Game::Draw(float deltaTime, float totalTime)
 	// - However, this isn't always the case (but might be for this course)
 	//context->IASetInputLayout(inputLayout.Get());
 
-	// Loop through all entities and draw their information
-	for (int i = 0; i < entities.size(); i++)
-	{
-		// Set the current shaders
-		entities[i]->GetMaterial()->GetVertexShader()->SetShader();
-		entities[i]->GetMaterial()->GetPixelShader()->SetShader();
-
-		// Defines the Vertex Shader data
-		std::shared_ptr<SimpleVertexShader> vs = entities[i]->GetMaterial()->GetVertexShader();
-		vs->SetMatrix4x4("world", entities[i]->GetTransform()->GetWorldMatrix());
-		vs->SetMatrix4x4("worldInvTranspose", entities[i]->GetTransform()->GetWorldInverseTranposeMatrix());
-		vs->SetMatrix4x4("view", camera->GetViewMatrix());
-		vs->SetMatrix4x4("projection", camera->GetProjectionMatrix());
-		vs->CopyAllBufferData();
-
-		// Defines the Pixel Shader data
-		std::shared_ptr<SimplePixelShader> ps = entities[i]->GetMaterial()->GetPixelShader();
-		ps->SetFloat4("colorTint", entities[i]->GetMaterial()->GetColorTint());
-		ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
-		ps->SetFloat("roughness", entities[i]->GetMaterial()->GetRoughness());
-		ps->SetFloat3("cameraPos", camera->GetTransform()->GetPosition());
-		ps->SetFloat3("ambientLight", ambientLight);
-		ps->SetFloat("uvScale", entities[i]->GetMaterial()->GetUvScale());
-		ps->SetFloat2("uvOffset", entities[i]->GetMaterial()->GetUvOffset());
-		ps->SetData("directionalLight1", &directionalLight1, sizeof(Light));
-		ps->SetData("directionalLight2", &directionalLight2, sizeof(Light));
-		ps->SetData("directionalLight3", &directionalLight3, sizeof(Light));
-		ps->SetData("pointLight1", &pointLight1, sizeof(Light));
-		ps->SetData("pointLight2", &pointLight2, sizeof(Light));
-		entities[i]->GetMaterial()->SetMaps();
-		ps->CopyAllBufferData();
-
-		// Sets stride and offset
-		UINT stride = sizeof(Vertex);
-		UINT offset = 0;
-
-		// Sets the Vertex and Index Buffers
-		context->IASetVertexBuffers(0, 1, entities[i]->GetMesh()->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-		context->IASetIndexBuffer(entities[i]->GetMesh()->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
-
-		// Draws the mesh to the screen
-		context->DrawIndexed(
-			entities[i]->GetMesh()->GetIndexCount(),
-			0,
-			0);
+	// Only as many lights as the shader's array can hold
+	int lightCount = (int)(std::min)(lights.size(), (size_t)MAX_LIGHTS);
+
+	// Entities whose materials are in the table are drawn a mesh at a time,
+	// the rest (or everything, if batching is off) one at a time
+	{
+		ProfileScope<CpuProfiler> cpuScope(*cpuProfiler, "Draw.Shadows");
+		ProfileScope<GpuProfiler> gpuScope(*gpuProfiler, "Shadows");
+		shadowRenderer->Render(camera, lights, lightCount, entities);
+
+		// The shadow pass draws into its own targets
+		D3D11_VIEWPORT viewport = dynamicResolution->GetViewport();
+		context->RSSetViewports(1, &viewport);
+		context->OMSetRenderTargets(1, sceneRTV.GetAddressOf(), sceneDSV.Get());
 	}
 
+	// Batched materials have every map (see MaterialTable); the rest is the scene's
+	unsigned int batchedFeatures = ShaderPermutations::Maps | ShaderPermutations::Batched | GetSceneShaderFeatures();
+	std::shared_ptr<SimplePixelShader> batchedPixelShader = GetPixelShaderVariant(batchedFeatures, lightCount);
+	std::shared_ptr<SimplePixelShader> batchedCoarsePixelShader = GetPixelShaderVariant(batchedFeatures | ShaderPermutations::CoarseLighting, lightCount);
+
+	drawStats = DrawStats();
+	bool batched = batchMaterials && materialTable->Build() && batchedVertexShader->IsShaderValid() && batchedPixelShader->IsShaderValid();
+
+	// Depth only, so the main pass shades each pixel about once
+	depthPrepassActive = depthPrepass && depthPrepassVertexShader->IsShaderValid() && (!batched || batchedDepthPrepassVertexShader->IsShaderValid());
+	if (depthPrepassActive)
+	{
+		ProfileScope<CpuProfiler> cpuScope(*cpuProfiler, "Draw.DepthPrepass");
+		ProfileScope<GpuProfiler> gpuScope(*gpuProfiler, "DepthPrepass");
+		DrawDepthPrepass(batched);
+	}
+
+	cpuProfiler->BeginScope("Draw.Entities");
+	gpuProfiler->BeginScope("Entities");
+	meshletStats = MeshletCullStats();
+	unbatchedEntities.clear();
+	if (batched)
+	{
+		materialTable->UpdateParams();
+
+		batchedVertexShader->SetShader();
+		batchedVertexShader->SetMatrix4x4("view", camera->GetViewMatrix());
+		batchedVertexShader->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+
+		// Both rates' shaders get the frame's data; the batcher picks between them
+		for (std::shared_ptr<SimplePixelShader> ps : { batchedCoarsePixelShader, batchedPixelShader })
+		{
+			ps->SetShader();
+			ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
+			ps->SetFloat3("cameraPos", camera->GetTransform()->GetPosition());
+			ps->SetFloat3("ambientLight", ambientLight);
+			ps->SetInt("lightCount", lightCount);
+			ps->SetData("lights", lights.data(), sizeof(Light) * lightCount);
+			ps->SetSamplerState("BasicSampler", samplerState);
+			environmentLighting->Bind(ps);
+			probeVolume->Bind(ps, 0);
+			shadowRenderer->Bind(ps);
+			ps->CopyAllBufferData();
+		}
+
+		instanceBatcher->Draw(visibleEntities, *materialTable, *renderStates, batchedVertexShader, batchedPixelShader,
+			coarseShading ? batchedCoarsePixelShader : nullptr, unbatchedEntities, drawStats, depthPrepassActive ? depthEqualState : 0);
+	}
+	else
+	{
+		unbatchedEntities = visibleEntities;
+	}
+
+	// Draws sharing a render state go together; compared by ID, not by object
+	std::stable_sort(unbatchedEntities.begin(), unbatchedEntities.end(), [](const std::shared_ptr<Entity>& a, const std::shared_ptr<Entity>& b)
+	{
+		return a->GetMaterial()->GetRenderState().GetKey() < b->GetMaterial()->GetRenderState().GetKey();
+	});
+
+	for (std::shared_ptr<Entity>& entity : unbatchedEntities)
+	{
+		unsigned int draws = DrawEntity(entity, lightCount);
+		if (draws == 0)
+			continue;
+		drawStats.DrawCalls += draws;
+		drawStats.BindGroups++;
+		drawStats.Instances++;
+	}
+	gpuProfiler->EndScope("Entities");
+	cpuProfiler->EndScope("Draw.Entities");
+
 	// Draws the skybox
-	skybox->Draw(context, camera);
-	
+	{
+		ProfileScope<CpuProfiler> cpuScope(*cpuProfiler, "Draw.Sky");
+		ProfileScope<GpuProfiler> gpuScope(*gpuProfiler, "Sky");
+		skybox->Draw(context, camera);
+	}
+
+	// Stretches the smaller scene over the back buffer
+	if (scaled)
+	{
+		ProfileScope<CpuProfiler> cpuScope(*cpuProfiler, "Draw.Upscale");
+		ProfileScope<GpuProfiler> gpuScope(*gpuProfiler, "Upscale");
+		dynamicResolution->Upscale(backBufferRTV);
+	}
+	gpuProfiler->EndFrame();
 
 	// Present the back buffer to the user
 	//  - Puts the final frame we're drawing into the window so the user can see it
 	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
-	swapChain->Present(vsync ? 1 : 0, 0);
+	// (there's no swap chain while benchmarking)
+	if (swapChain)
+	{
+		cpuProfiler->BeginScope("Present");
+		swapChain->Present(vsync ? 1 : 0, 0);
+		cpuProfiler->EndScope("Present");
+	}
 
 	// Due to the usage of a more sophisticated swap chain,
 	// the render target must be re-bound after every call to Present()
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
-}
\ No newline at end of file
+
+	cpuProfiler->EndFrame();
+}
+
+// --------------------------------------------------------
+// Prints, per model, what packing its vertices saved (and
+// cost in precision) and its levels of detail
+// --------------------------------------------------------
+void Game::PrintMeshReports()
+{
+	// What packing the vertices saved, per model, and what it cost in precision
+	size_t sourceBytes = 0;
+	size_t packedBytes = 0;
+	printf("Vertex packing (%zu -> %zu bytes a vertex, %zu for depth-only passes with split positions):\n", sizeof(Vertex), sizeof(PackedVertex), sizeof(PackedPosition));
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		VertexPackingReport report = meshes[i]->GetPackingReport();
+		printf("  %-18s %6u verts, %7.1f -> %6.1f KB, position %.5f (bound %.5f), normal %.4f deg, tangent %.4f deg, uv %.5f, %u mirrored, %.2f ms\n",
+			meshes[i]->GetName().empty() ? "(built in)" : meshes[i]->GetName().c_str(), report.Vertices, report.SourceBytes / 1024.0, report.PackedBytes / 1024.0,
+			report.Error.MaxPosition, report.Error.PositionBound, report.Error.MaxNormalDegrees, report.Error.MaxTangentDegrees,
+			report.Error.MaxUv, report.Error.Mirrored, report.EncodeMs);
+		sourceBytes += report.SourceBytes;
+		packedBytes += report.PackedBytes;
+	}
+	printf("  Total %.1f -> %.1f KB of vertices (%.0f%% of the fetch bandwidth)\n", sourceBytes / 1024.0, packedBytes / 1024.0, 100.0 * packedBytes / (std::max)(sourceBytes, (size_t)1));
+
+	// Each model's levels of detail, and what simplifying them cost
+	printf("Levels of detail (%.0f px error budget):\n", lodSelection.PixelError);
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		LodReport report = meshes[i]->GetLodReport();
+		printf("  %-18s", meshes[i]->GetName().empty() ? "(built in)" : meshes[i]->GetName().c_str());
+		for (const MeshLod& lod : meshes[i]->GetLods())
+			printf(" %6u tris (%.4f)", lod.IndexCount / 3, lod.Error);
+		printf(", %.2f ms on %u threads\n", report.BuildMs, report.Threads);
+	}
+}
+
+// --------------------------------------------------------
+// Bakes ambient probes over the scene's bounds: every entity's
+// position, padded by its mesh's radius. Only the sky goes in;
+// the scene's lights are drawn directly, so baking them too
+// would count them twice.
+// --------------------------------------------------------
+void Game::BuildProbeVolume()
+{
+	if (entities.empty())
+		return;
+
+	XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (std::shared_ptr<Entity>& entity : entities)
+	{
+		XMFLOAT3 position;
+		float radius;
+		entity->GetWorldBounds(position, radius);
+		boundsMin = XMFLOAT3((std::min)(boundsMin.x, position.x - radius), (std::min)(boundsMin.y, position.y - radius), (std::min)(boundsMin.z, position.z - radius));
+		boundsMax = XMFLOAT3((std::max)(boundsMax.x, position.x + radius), (std::max)(boundsMax.y, position.y + radius), (std::max)(boundsMax.z, position.z + radius));
+	}
+
+	const unsigned int counts[3] = { 8, 4, 8 };
+	if (probeVolume->Build(boundsMin, boundsMax, counts, environmentLighting->GetSkyRadiance(), std::vector<Light>()))
+		printf("Baked %zu ambient probes in %.2f ms\n", probeVolume->GetProbeCount(), probeVolume->GetBakeMs());
+	else
+		printf("Unable to create the ambient probe buffer\n");
+}
+
+// --------------------------------------------------------
+// Draws one entity with its own material bindings, as one
+// draw per run of visible meshlets; returns how many draws
+// that took (none if every meshlet was culled)
+// --------------------------------------------------------
+unsigned int Game::DrawEntity(std::shared_ptr<Entity> entity, int lightCount)
+{
+	// The entity's level of detail, less what can't be seen
+	meshletRanges.clear();
+	if (clusterCulling)
+	{
+		CullMeshlets(entity);
+		if (meshletRanges.empty())
+			return 0;
+	}
+	else
+	{
+		MeshLod lod = entity->GetMesh()->GetLod(entity->GetLod());
+		meshletRanges.push_back({ lod.IndexStart, lod.IndexCount });
+	}
+
+	// Set the current shaders. PBR entities get the permutation for their
+	// material's maps and the scene; far or small ones light each quad once.
+	std::shared_ptr<SimplePixelShader> ps = entity->GetMaterial()->GetPixelShader();
+	if (ps == pixelShader)
+	{
+		unsigned int features = entity->GetMaterial()->GetShaderFeatures() | GetSceneShaderFeatures();
+		if (coarseShading && entity->GetShadingRate() == ShadingRate::Coarse)
+			features |= ShaderPermutations::CoarseLighting;
+		ps = GetPixelShaderVariant(features, lightCount);
+	}
+	entity->GetMaterial()->GetVertexShader()->SetShader();
+	ps->SetShader();
+	RenderState state = entity->GetMaterial()->GetRenderState();
+	if (depthPrepassActive && UsesDepthPrepass(entity.get(), false))
+		state.DepthStencil = depthEqualState;
+	renderStates->Apply(state);
+
+	// Defines the Vertex Shader data
+	std::shared_ptr<SimpleVertexShader> vs = entity->GetMaterial()->GetVertexShader();
+	vs->SetMatrix4x4("world", entity->GetTransform()->GetWorldMatrix());
+	vs->SetMatrix4x4("worldInvTranspose", entity->GetTransform()->GetWorldInverseTranposeMatrix());
+	vs->SetMatrix4x4("view", camera->GetViewMatrix());
+	vs->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+	vs->SetFloat3("positionScale", entity->GetMesh()->GetPositionScale());
+	vs->SetFloat3("positionOffset", entity->GetMesh()->GetPositionOffset());
+	vs->CopyAllBufferData();
+
+	// Defines the Pixel Shader data
+	ps->SetFloat4("colorTint", entity->GetMaterial()->GetColorTint());
+	ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
+	ps->SetFloat("roughness", entity->GetMaterial()->GetRoughness());
+	ps->SetFloat3("cameraPos", camera->GetTransform()->GetPosition());
+	ps->SetFloat3("ambientLight", ambientLight);
+	ps->SetFloat("uvScale", entity->GetMaterial()->GetUvScale());
+	ps->SetFloat2("uvOffset", entity->GetMaterial()->GetUvOffset());
+	ps->SetInt("lightCount", lightCount);
+	ps->SetData("lights", lights.data(), sizeof(Light) * lightCount);
+	environmentLighting->Bind(ps);
+	XMFLOAT3 center;
+	float radius;
+	entity->GetWorldBounds(center, radius);
+	probeVolume->Bind(ps, &center);
+	shadowRenderer->Bind(ps);
+	entity->GetMaterial()->SetMaps(ps);
+	ps->CopyAllBufferData();
+
+	// Sets the Vertex and Index Buffers
+	entity->GetMesh()->SetBuffers(context, false);
+
+	// Draws the entity's visible ranges to the screen
+	for (const MeshletRange& range : meshletRanges)
+		context->DrawIndexed(
+			range.IndexCount,
+			range.IndexStart,
+			0);
+	return (unsigned int)meshletRanges.size();
+}
+
+// --------------------------------------------------------
+// Draws the depth of every visible entity that can take part
+// (see UsesDepthPrepass()), nearest first. Whole levels of
+// detail are drawn, not just the meshlets culling keeps, so
+// the main pass never finds a hole in the depth buffer.
+// --------------------------------------------------------
+void Game::DrawDepthPrepass(bool batched)
+{
+	BuildOverdrawSpheres();
+	OverdrawEstimator::SortFrontToBack(overdrawSpheres.data(), overdrawSpheres.size(), prepassOrder);
+	prepassEntities.clear();
+	for (unsigned int i : prepassOrder)
+	{
+		if (UsesDepthPrepass(visibleEntities[i].get(), batched))
+			prepassEntities.push_back(visibleEntities[i]);
+	}
+
+	// No pixel shader: the depth is all that's written
+	context->PSSetShader(0, 0, 0);
+	unbatchedPrepassEntities.clear();
+	if (batched)
+	{
+		batchedDepthPrepassVertexShader->SetShader();
+		batchedDepthPrepassVertexShader->SetMatrix4x4("view", camera->GetViewMatrix());
+		batchedDepthPrepassVertexShader->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+		instanceBatcher->DrawDepth(prepassEntities, *materialTable, *renderStates, batchedDepthPrepassVertexShader, unbatchedPrepassEntities, drawStats);
+	}
+	else
+	{
+		unbatchedPrepassEntities = prepassEntities;
+	}
+
+	if (unbatchedPrepassEntities.empty())
+		return;
+
+	depthPrepassVertexShader->SetShader();
+	depthPrepassVertexShader->SetMatrix4x4("view", camera->GetViewMatrix());
+	depthPrepassVertexShader->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+	for (std::shared_ptr<Entity>& entity : unbatchedPrepassEntities)
+	{
+		std::shared_ptr<Mesh> mesh = entity->GetMesh();
+		renderStates->Apply(entity->GetMaterial()->GetRenderState());
+		depthPrepassVertexShader->SetMatrix4x4("world", entity->GetTransform()->GetWorldMatrix());
+		depthPrepassVertexShader->SetFloat3("positionScale", mesh->GetPositionScale());
+		depthPrepassVertexShader->SetFloat3("positionOffset", mesh->GetPositionOffset());
+		depthPrepassVertexShader->CopyAllBufferData();
+
+		MeshLod lod = mesh->GetLod(entity->GetLod());
+		mesh->SetBuffers(context, true);
+		context->DrawIndexed(lod.IndexCount, lod.IndexStart, 0);
+		drawStats.DepthDrawCalls++;
+	}
+}
+
+// --------------------------------------------------------
+// Whether an entity's depth goes in the pre-pass (and its
+// main pass tests for EQUAL): its material has to keep the
+// default depth test, and its main pass has to place
+// vertices exactly as DepthPrepassVS.hlsl does, which
+// VertexShader.hlsl (batched or not) does.
+// --------------------------------------------------------
+bool Game::UsesDepthPrepass(Entity* entity, bool batched)
+{
+	std::shared_ptr<Material> material = entity->GetMaterial();
+	if (material->GetRenderState().DepthStencil != 0)
+		return false;
+	return material->GetVertexShader() == vertexShader || (batched && materialTable->GetIndex(material.get()) >= 0);
+}
+
+// --------------------------------------------------------
+// Projects the visible entities' bounding spheres to the
+// screen for OverdrawEstimator. Spheres the camera is inside
+// (or nearly) cover the whole screen.
+// --------------------------------------------------------
+void Game::BuildOverdrawSpheres()
+{
+	XMFLOAT4X4 viewMatrix = camera->GetViewMatrix();
+	XMFLOAT4X4 projectionMatrix = camera->GetProjectionMatrix();
+	XMMATRIX view = XMLoadFloat4x4(&viewMatrix);
+	XMMATRIX viewProjection = XMMatrixMultiply(view, XMLoadFloat4x4(&projectionMatrix));
+
+	overdrawSpheres.resize(visibleEntities.size());
+	for (size_t i = 0; i < visibleEntities.size(); i++)
+	{
+		XMFLOAT3 center;
+		float radius;
+		visibleEntities[i]->GetWorldBounds(center, radius);
+		OverdrawSphere& sphere = overdrawSpheres[i];
+		sphere.Radius = radius;
+		sphere.ViewDepth = XMVectorGetZ(XMVector3Transform(XMLoadFloat3(&center), view));
+		sphere.ScreenRadius = MeshSimplifier::GetScreenRadius(radius, sphere.ViewDepth, projectionMatrix._22, (float)height);
+		if (sphere.ViewDepth - radius <= camera->GetNearPlane() || sphere.ScreenRadius > (float)(width + height))
+		{
+			sphere.ScreenX = width * 0.5f;
+			sphere.ScreenY = height * 0.5f;
+			sphere.ScreenRadius = (float)(width + height);
+			continue;
+		}
+
+		XMFLOAT3 projected;
+		XMStoreFloat3(&projected, XMVector3TransformCoord(XMLoadFloat3(&center), viewProjection));
+		sphere.ScreenX = (projected.x * 0.5f + 0.5f) * width;
+		sphere.ScreenY = (0.5f - projected.y * 0.5f) * height;
+	}
+}
+
+// --------------------------------------------------------
+// Culls the meshlets of an entity's level of detail into
+// meshletRanges. Culling happens in model space: the frustum
+// planes come from world * view * projection, and the camera
+// is brought into the mesh's space for the normal cones.
+// Materials that don't cull back faces, and mirrored
+// transforms (which flip the winding), only get the frustum.
+// --------------------------------------------------------
+void Game::CullMeshlets(std::shared_ptr<Entity> entity)
+{
+	std::shared_ptr<Mesh> mesh = entity->GetMesh();
+	unsigned int count;
+	const Meshlet* meshlets = mesh->GetMeshlets(entity->GetLod(), count);
+
+	XMFLOAT4X4 worldMatrix = entity->GetTransform()->GetWorldMatrix();
+	XMFLOAT4X4 viewMatrix = camera->GetViewMatrix();
+	XMFLOAT4X4 projectionMatrix = camera->GetProjectionMatrix();
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+	XMFLOAT4X4 worldViewProjection;
+	XMStoreFloat4x4(&worldViewProjection, XMMatrixMultiply(world, XMMatrixMultiply(XMLoadFloat4x4(&viewMatrix), XMLoadFloat4x4(&projectionMatrix))));
+
+	XMVECTOR determinant;
+	XMMATRIX inverseWorld = XMMatrixInverse(&determinant, world);
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	XMFLOAT3 eye;
+	XMStoreFloat3(&eye, XMVector3Transform(XMLoadFloat3(&cameraPosition), inverseWorld));
+	bool cullBackfaces = entity->GetMaterial()->GetRenderState().Rasterizer == 0 && XMVectorGetX(determinant) > 0.0f;
+
+	Meshlets::Cull(meshlets, count, &worldViewProjection._11, &eye.x, cullBackfaces, meshletRanges, meshletStats);
+}
+
+// --------------------------------------------------------
+// Tells the texture streamer how finely each entity's
+// textures are seen: its bounding sphere gives the distance
+// and screen coverage, and the mesh's UV density (times the
+// material's UV scale) turns distance into a mip level.
+// --------------------------------------------------------
+void Game::StreamTextures()
+{
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	XMFLOAT3 cameraForward = camera->GetTransform()->GetForward();
+	XMVECTOR eye = XMLoadFloat3(&cameraPosition);
+	XMVECTOR forward = XMLoadFloat3(&cameraForward);
+	float fieldOfView = camera->GetFieldOfView();
+
+	textureStreamer->BeginFrame(fieldOfView, (float)height);
+	for (std::shared_ptr<Entity>& entity : entities)
+	{
+		std::shared_ptr<Mesh> mesh = entity->GetMesh();
+		std::shared_ptr<Material> material = entity->GetMaterial();
+
+		// Bounds in world space, with the largest axis scale
+		XMFLOAT4X4 world = entity->GetTransform()->GetWorldMatrix();
+		XMFLOAT3 localCenter = mesh->GetBoundsCenter();
+		XMVECTOR center = XMVector3Transform(XMLoadFloat3(&localCenter), XMLoadFloat4x4(&world));
+		float scale = (std::max)((std::max)(
+			XMVectorGetX(XMVector3Length(XMVectorSet(world._11, world._12, world._13, 0.0f))),
+			XMVectorGetX(XMVector3Length(XMVectorSet(world._21, world._22, world._23, 0.0f)))),
+			XMVectorGetX(XMVector3Length(XMVectorSet(world._31, world._32, world._33, 0.0f))));
+		float radius = mesh->GetBoundsRadius() * scale;
+
+		// Entirely behind the camera
+		XMVECTOR toCenter = XMVectorSubtract(center, eye);
+		if (XMVectorGetX(XMVector3Dot(toCenter, forward)) < -radius)
+			continue;
+
+		float distance = (std::max)(camera->GetNearPlane(), XMVectorGetX(XMVector3Length(toCenter)) - radius);
+		float screenArea = TextureResidency::ComputeScreenArea(radius, distance, fieldOfView, (float)height);
+		float uvDensity = mesh->GetUvDensity() * fabsf(material->GetUvScale()) / (std::max)(scale, 0.0001f);
+
+		for (const std::pair<const std::string, std::shared_ptr<Texture>>& texture : material->GetTextures())
+			textureStreamer->Request(texture.second.get(), uvDensity, distance, screenArea);
+	}
+	textureStreamer->Update();
+}
+
+// --------------------------------------------------------
+// Picks each entity's level of detail: the coarsest whose
+// error, scaled by the bounding sphere's size on screen,
+// stays under the pixel budget (see MeshSimplifier). With
+// levels off, everything draws the full mesh. Pixels are
+// counted at the scene's resolution, so a scaled-down scene
+// draws coarser levels too. Shading rates are picked from
+// the same bounds (see ShadingRateSelector).
+// --------------------------------------------------------
+void Game::SelectLods()
+{
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	float projectionScale = camera->GetProjectionMatrix()._22;
+	float sceneHeight = height * dynamicResolution->GetScale();
+
+	coarseEntities = 0;
+	for (std::shared_ptr<Entity>& entity : entities)
+	{
+		XMFLOAT3 center;
+		float radius;
+		entity->GetWorldBounds(center, radius);
+		float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&center), XMLoadFloat3(&cameraPosition))));
+		float screenRadius = MeshSimplifier::GetScreenRadius(radius, distance, projectionScale, sceneHeight);
+
+		ShadingRate rate = coarseShading ? ShadingRateSelector::Select(distance, screenRadius, entity->GetShadingRate(), shadingRateSelection) : ShadingRate::Full;
+		entity->SetShadingRate(rate);
+		coarseEntities += rate == ShadingRate::Coarse;
+
+		const std::vector<MeshLod>& lods = entity->GetMesh()->GetLods();
+		if (!lodsEnabled || lods.size() < 2)
+		{
+			entity->SetLod(0);
+			continue;
+		}
+		entity->SetLod(MeshSimplifier::SelectLod(lods, screenRadius, entity->GetLod(), lodSelection));
+	}
+}
+
+// --------------------------------------------------------
+// Fills visibleEntities with the entities not hidden behind
+// the biggest ones on screen (see OcclusionCuller). Only
+// entities that draw depth with back faces culled, and
+// aren't mirrored, can occlude; occluders are tested too,
+// and always pass, since nothing is in front of their own
+// nearest point. Shadows still get every entity.
+// --------------------------------------------------------
+void Game::CullOccluded()
+{
+	visibleEntities.clear();
+	if (!occlusionCulling)
+	{
+		visibleEntities = entities;
+		return;
+	}
+
+	XMFLOAT4X4 viewMatrix = camera->GetViewMatrix();
+	XMFLOAT4X4 projectionMatrix = camera->GetProjectionMatrix();
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&viewMatrix), XMLoadFloat4x4(&projectionMatrix)));
+	occlusionCuller->BeginFrame(&viewProjection._11);
+
+	// The biggest on screen, largest first
+	const unsigned int maxOccluders = 16;
+	const float minOccluderRadius = 0.1f;	// Of the screen's height
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	std::vector<std::pair<float, std::shared_ptr<Entity>>> occluders;
+	for (std::shared_ptr<Entity>& entity : entities)
+	{
+		if (entity->GetMaterial()->GetRenderState().GetKey() != 0 || entity->GetMesh()->GetCpuIndices().empty())
+			continue;
+		XMFLOAT4X4 world = entity->GetTransform()->GetWorldMatrix();
+		if (XMVectorGetX(XMMatrixDeterminant(XMLoadFloat4x4(&world))) <= 0.0f)
+			continue;
+
+		XMFLOAT3 center;
+		float radius;
+		entity->GetWorldBounds(center, radius);
+		float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&center), XMLoadFloat3(&cameraPosition))));
+		float screenRadius = MeshSimplifier::GetScreenRadius(radius, distance, projectionMatrix._22, (float)height);
+		if (screenRadius >= minOccluderRadius * height)
+			occluders.push_back(std::make_pair(screenRadius, entity));
+	}
+	std::sort(occluders.begin(), occluders.end(), [](const std::pair<float, std::shared_ptr<Entity>>& a, const std::pair<float, std::shared_ptr<Entity>>& b)
+	{
+		return a.first > b.first;
+	});
+	if (occluders.size() > maxOccluders)
+		occluders.resize(maxOccluders);
+
+	for (std::pair<float, std::shared_ptr<Entity>>& occluder : occluders)
+	{
+		std::shared_ptr<Mesh> mesh = occluder.second->GetMesh();
+		MeshLod lod = mesh->GetLod(occluder.second->GetLod());
+		XMFLOAT4X4 world = occluder.second->GetTransform()->GetWorldMatrix();
+		occlusionCuller->AddOccluder(mesh->GetCpuPositions().data(), mesh->GetCpuIndices().data() + lod.IndexStart, lod.IndexCount, &world._11);
+	}
+	occlusionCuller->Rasterize();
+
+	for (std::shared_ptr<Entity>& entity : entities)
+	{
+		XMFLOAT3 center;
+		float radius;
+		entity->GetWorldBounds(center, radius);
+		if (occlusionCuller->IsVisible(&center.x, radius))
+			visibleEntities.push_back(entity);
+	}
+}
+
+// --------------------------------------------------------
+// Prints the benchmark results and writes them to the
+// output file given on the command line
+// --------------------------------------------------------
+void Game::FinishBenchmark()
+{
+	FrameStatsSummary frames = frameStats.Summarize(benchmark.WarmupFrames);
+	std::string report = BenchmarkReport::ToString(benchmark, cpuProfiler->GetStats(), frames, drawStats);
+	printf("%s", report.c_str());
+	OutputDebugString(report.c_str());
+
+	if (!BenchmarkReport::WriteJson(benchmark.OutputPath, benchmark, cpuProfiler->GetStats(), frames, drawStats))
+		printf("Unable to write benchmark report to '%s'\n", benchmark.OutputPath.c_str());
+}
+
+// --------------------------------------------------------
+// Loads every texture in the PBR folder from scratch with
+// one, two, four, eight and all hardware threads, printing a
+// table and writing the results to the benchmark output file.
+// Runs right after InitDirectXHeadless(), without Init().
+// --------------------------------------------------------
+void Game::RunTextureBenchmark()
+{
+	std::vector<std::wstring> paths;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(GetFullPathTo_Wide(L"../../Assets/Textures/PBR"), error))
+	{
+		if (entry.path().extension() == L".png")
+			paths.push_back(entry.path().wstring());
+	}
+	std::sort(paths.begin(), paths.end());
+
+	std::vector<unsigned int> threadCounts = { 1, 2, 4, 8 };
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	if (hardwareThreads > 0 && std::find(threadCounts.begin(), threadCounts.end(), hardwareThreads) == threadCounts.end())
+		threadCounts.push_back(hardwareThreads);
+
+	std::string report = TextureManager::RunLoadBenchmark(device, context, paths, threadCounts, benchmark.TextureRepeats, benchmark.OutputPath);
+	printf("%s", report.c_str());
+	OutputDebugString(report.c_str());
+}
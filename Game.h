@@ -6,9 +6,25 @@
 #include "Entity.h"
 #include "Camera.h"
 #include "SimpleShader.h"
+#include "ShaderManager.h"
 #include "Material.h"
 #include "Light.h"
 #include "Sky.h"
+#include "Profiler.h"
+#include "Benchmark.h"
+#include "SceneGenerator.h"
+#include "TextureManager.h"
+#include "TextureStreamer.h"
+#include "MaterialTable.h"
+#include "InstanceBatcher.h"
+#include "RenderStateCache.h"
+#include "EnvironmentLighting.h"
+#include "ProbeVolume.h"
+#include "ShadowRenderer.h"
+#include "OcclusionCuller.h"
+#include "OverdrawEstimator.h"
+#include "DynamicResolution.h"
+#include "ShaderPermutations.h"
 #include <DirectXMath.h>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include <memory>
@@ -19,7 +35,7 @@ class Game
 {
 
 public:
-	Game(HINSTANCE hInstance);
+	Game(HINSTANCE hInstance, BenchmarkOptions _benchmark = BenchmarkOptions());
 	~Game();
 
 	// Overridden setup and game loop methods, which
@@ -29,6 +45,12 @@ public:
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
 
+	// Prints and saves the results of a headless benchmark run
+	void FinishBenchmark();
+
+	// Times loading the PBR textures with different thread counts
+	void RunTextureBenchmark();
+
 private:
 
 	// Should we use vsync to limit the frame rate?
@@ -37,6 +59,19 @@ private:
 	// Initialization helper methods - feel free to customize, combine, etc.
 	void LoadShaders(); 
 	void CreateBasicGeometry();
+	void BuildProbeVolume();
+	void PrintMeshReports();
+	unsigned int DrawEntity(std::shared_ptr<Entity> entity, int lightCount);
+	void CullMeshlets(std::shared_ptr<Entity> entity);
+	void StreamTextures();
+	void SelectLods();
+	void CullOccluded();
+	void DrawDepthPrepass(bool batched);
+	bool UsesDepthPrepass(Entity* entity, bool batched);
+	void BuildOverdrawSpheres();
+	void PrecompilePixelShaderVariants();
+	std::shared_ptr<SimplePixelShader> GetPixelShaderVariant(unsigned int features, int lightCount);
+	unsigned int GetSceneShaderFeatures();
 
 	// Vector that contains all the list items
 	std::vector < std::shared_ptr<Mesh> > meshes;
@@ -44,42 +79,14 @@ private:
 	std::vector < std::shared_ptr<Material> > materials;
 	std::shared_ptr<Camera> camera;
 
-	// Textures
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture1;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normal1;
-
-	// PBR Textures
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> albedo1;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normals1;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughness1;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> metalness1;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> albedo2;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normals2;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughness2;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> metalness2;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> albedo3;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normals3;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughness3;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> metalness3;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> albedo4;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normals4;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughness4;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> metalness4;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> albedo5;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normals5;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughness5;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> metalness5;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> albedo6;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normals6;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughness6;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> metalness6;
-
-	// Sampler State(s)
+	// Textures, decoded on worker threads and uploaded in Update()
+	std::shared_ptr<TextureManager> textureManager;
+	std::shared_ptr<TextureStreamer> textureStreamer;	// Null unless -stream is given
+	std::shared_ptr<Texture> texture1;
+	std::shared_ptr<Texture> normal1;
+
+	// Sampler, rasterizer and depth states, each made once and shared
+	std::shared_ptr<RenderStateCache> renderStates;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState;
 
 	// Note the usage of ComPtr below
@@ -92,22 +99,93 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 	
 	// Simple Shaders
+	std::shared_ptr<ShaderManager> shaderManager;
 	std::shared_ptr<SimpleVertexShader> vertexShader;
 	std::shared_ptr<SimplePixelShader> pixelShader;
 	std::shared_ptr<SimplePixelShader> customPS;
 	std::shared_ptr<SimpleVertexShader> skyVertexShader;
 	std::shared_ptr<SimplePixelShader> skyPixelShader;
+	std::shared_ptr<SimpleVertexShader> shadowVertexShader;
+	std::shared_ptr<SimpleVertexShader> depthPrepassVertexShader;
+	std::shared_ptr<SimpleVertexShader> batchedDepthPrepassVertexShader;
+	std::shared_ptr<SimpleVertexShader> fullScreenVertexShader;
+	std::shared_ptr<SimplePixelShader> upscalePixelShader;
+
+	// Permutations of the PBR pixel shader, by ShaderPermutations key:
+	// only the maps, sky and light count each draw needs
+	std::shared_ptr<ShaderVariantCache<std::shared_ptr<SimplePixelShader>>> pixelShaderVariants;
+
+	// Batched drawing: materials become indices into texture arrays,
+	// and entities with the same mesh are drawn as instances
+	std::shared_ptr<SimpleVertexShader> batchedVertexShader;
+	std::shared_ptr<MaterialTable> materialTable;
+	std::shared_ptr<InstanceBatcher> instanceBatcher;
+	std::vector<std::shared_ptr<Entity>> unbatchedEntities;
+	bool batchMaterials;
+	DrawStats drawStats;	// From the last frame
+
+	// Levels of detail, picked per entity from its size on screen
+	LodSelection lodSelection;
+	bool lodsEnabled;
+
+	// Coarse shading: entities far away or small on screen are lit
+	// once per 2x2 quad, by a permutation of the PBR pixel shader
+	bool coarseShading;
+	ShadingRateSelection shadingRateSelection;
+	unsigned int coarseEntities;	// Picked this frame
+
+	// Cluster culling: entities drawn one at a time skip meshlets
+	// outside the view or facing away
+	bool clusterCulling;
+	std::vector<MeshletRange> meshletRanges;	// Reused for every entity
+	MeshletCullStats meshletStats;				// From the last frame
+
+	// Occlusion culling: the biggest entities on screen are drawn
+	// on the CPU, and the rest are tested against them
+	std::shared_ptr<OcclusionCuller> occlusionCuller;
+	bool occlusionCulling;
+	std::vector<std::shared_ptr<Entity>> visibleEntities;	// This frame's, drawn instead of entities
+
+	// Depth pre-pass: depth first, nearest first, then the main
+	// pass only shades the fragments that ended up in front
+	bool depthPrepass;
+	bool depthPrepassActive;		// This frame (its shaders may still be compiling)
+	RenderStateId depthEqualState;	// The main pass's depth test after the pre-pass
+	std::vector<OverdrawSphere> overdrawSpheres;	// visibleEntities' bounds on screen
+	std::vector<unsigned int> prepassOrder;
+	std::vector<std::shared_ptr<Entity>> prepassEntities;
+	std::vector<std::shared_ptr<Entity>> unbatchedPrepassEntities;
+
+	// Dynamic resolution: the scene is drawn smaller when the GPU
+	// runs over its frame time, then upscaled to the back buffer
+	std::shared_ptr<DynamicResolution> dynamicResolution;
+	unsigned long long gpuFrameSamples;	// GPU frame times the controller has seen
 
 	// Lights
 	DirectX::XMFLOAT3 ambientLight;
-	Light directionalLight1;
-	Light directionalLight2;
-	Light directionalLight3;
-	Light pointLight1;
-	Light pointLight2;
+	std::vector<Light> lights;	// At most MAX_LIGHTS are sent to the shader
+
+	// Procedural stress scene, replaces the hand-built one when requested
+	std::shared_ptr<SceneGenerator> sceneGenerator;
 
 	// Skybox + Texture
 	std::shared_ptr<Sky> skybox;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skyboxTexture;
+
+	// Ambient light precomputed from the skybox
+	std::shared_ptr<EnvironmentLighting> environmentLighting;
+	std::shared_ptr<ProbeVolume> probeVolume;
+
+	// Cascaded shadow maps for the first directional light
+	std::shared_ptr<ShadowRenderer> shadowRenderer;
+
+	// Profiling
+	std::shared_ptr<CpuProfiler> cpuProfiler;
+	std::shared_ptr<GpuProfiler> gpuProfiler;
+
+	// Headless benchmark mode
+	BenchmarkOptions benchmark;
+	CameraPath benchmarkPath;
+	unsigned int benchmarkFrame;
 };
 
@@ -0,0 +1,734 @@
+#include "IblPrecompute.h"
+#include "CpuUtilities.h"
+
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IBL_PRECOMPUTE_AVX2
+#if defined(_MSC_VER)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+static const float Pi = 3.14159265359f;
+
+const float IblPrecompute::ShBasis[9] = { 0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+
+// First bytes of a cached BRDF LUT; bump the digit when the integrand changes
+static const char BrdfLutMagic[8] = { 'B', 'R', 'D', 'F', 'L', 'U', 'T', '1' };
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+// Second coordinate of the Hammersley point set: i's bits mirrored
+static float RadicalInverse(unsigned int i)
+{
+	i = (i << 16) | (i >> 16);
+	i = ((i & 0x55555555u) << 1) | ((i & 0xAAAAAAAAu) >> 1);
+	i = ((i & 0x33333333u) << 2) | ((i & 0xCCCCCCCCu) >> 2);
+	i = ((i & 0x0F0F0F0Fu) << 4) | ((i & 0xF0F0F0F0u) >> 4);
+	i = ((i & 0x00FF00FFu) << 8) | ((i & 0xFF00FF00u) >> 8);
+	return (float)i * 2.3283064365386963e-10f;
+}
+
+// Everything about a GGX sample that doesn't depend on roughness
+struct SampleTable
+{
+	std::vector<float> CosPhi;
+	std::vector<float> SinPhi;
+	std::vector<float> Xi;
+};
+
+static void BuildSampleTable(unsigned int count, SampleTable& table)
+{
+	table.CosPhi.resize(count);
+	table.SinPhi.resize(count);
+	table.Xi.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float phi = 2.0f * Pi * ((float)i / count);
+		table.CosPhi[i] = cosf(phi);
+		table.SinPhi[i] = sinf(phi);
+		table.Xi[i] = RadicalInverse(i);
+	}
+}
+
+// GGX half vector elevation for a uniform random number
+static float SampleCosTheta(float xi, float alpha2)
+{
+	return sqrtf((1.0f - xi) / (1.0f + (alpha2 - 1.0f) * xi));
+}
+
+static void SH9(const float d[3], float basis[9])
+{
+	basis[0] = IblPrecompute::ShBasis[0];
+	basis[1] = IblPrecompute::ShBasis[1] * d[1];
+	basis[2] = IblPrecompute::ShBasis[2] * d[2];
+	basis[3] = IblPrecompute::ShBasis[3] * d[0];
+	basis[4] = IblPrecompute::ShBasis[4] * d[0] * d[1];
+	basis[5] = IblPrecompute::ShBasis[5] * d[1] * d[2];
+	basis[6] = IblPrecompute::ShBasis[6] * (3.0f * d[2] * d[2] - 1.0f);
+	basis[7] = IblPrecompute::ShBasis[7] * d[0] * d[2];
+	basis[8] = IblPrecompute::ShBasis[8] * (d[0] * d[0] - d[1] * d[1]);
+}
+
+static void Normalize(float v[3])
+{
+	float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	v[0] /= length;
+	v[1] /= length;
+	v[2] /= length;
+}
+
+// Texel center on a face, in [-1, 1]
+static float TexelCoordinate(unsigned int texel, unsigned int size)
+{
+	return 2.0f * (texel + 0.5f) / size - 1.0f;
+}
+
+// Solid angle a texel covers (before normalizing the whole cube to 4 pi)
+static float TexelSolidAngle(float u, float v, unsigned int size)
+{
+	float d = 1.0f + u * u + v * v;
+	return 4.0f / ((float)size * size * d * sqrtf(d));
+}
+
+// Inverse of GetDirection(): which face a direction hits, and where
+static unsigned int FindFace(const float d[3], float& u, float& v)
+{
+	float x = fabsf(d[0]), y = fabsf(d[1]), z = fabsf(d[2]);
+	if (x >= y && x >= z)
+	{
+		u = (d[0] > 0 ? -d[2] : d[2]) / x;
+		v = -d[1] / x;
+		return d[0] > 0 ? 0 : 1;
+	}
+	if (y >= z)
+	{
+		u = d[0] / y;
+		v = (d[1] > 0 ? d[2] : -d[2]) / y;
+		return d[1] > 0 ? 2 : 3;
+	}
+	u = (d[2] > 0 ? d[0] : -d[0]) / z;
+	v = -d[1] / z;
+	return d[2] > 0 ? 4 : 5;
+}
+
+// Bilinear within one face; edges clamp rather than crossing to the next face
+static void SampleFace(const CubeImage& cube, unsigned int face, float u, float v, float rgb[3])
+{
+	float x = (u + 1.0f) * 0.5f * cube.Size - 0.5f;
+	float y = (v + 1.0f) * 0.5f * cube.Size - 0.5f;
+	float maxCoordinate = (float)(cube.Size - 1);
+	x = (std::min)((std::max)(x, 0.0f), maxCoordinate);
+	y = (std::min)((std::max)(y, 0.0f), maxCoordinate);
+
+	unsigned int x0 = (unsigned int)x, y0 = (unsigned int)y;
+	unsigned int x1 = (std::min)(x0 + 1, cube.Size - 1), y1 = (std::min)(y0 + 1, cube.Size - 1);
+	float fx = x - x0, fy = y - y0;
+
+	const float* texels = cube.Faces[face].data();
+	const float* a = &texels[((size_t)y0 * cube.Size + x0) * 3];
+	const float* b = &texels[((size_t)y0 * cube.Size + x1) * 3];
+	const float* c = &texels[((size_t)y1 * cube.Size + x0) * 3];
+	const float* d = &texels[((size_t)y1 * cube.Size + x1) * 3];
+	for (int i = 0; i < 3; i++)
+	{
+		float top = a[i] + (b[i] - a[i]) * fx;
+		float bottom = c[i] + (d[i] - c[i]) * fx;
+		rgb[i] = top + (bottom - top) * fy;
+	}
+}
+
+// Any two axes perpendicular to n (and each other)
+static void BuildFrame(const float n[3], float tangent[3], float bitangent[3])
+{
+	float up[3] = { 0.0f, 0.0f, 1.0f };
+	if (fabsf(n[2]) > 0.999f)
+	{
+		up[0] = 1.0f;
+		up[2] = 0.0f;
+	}
+	tangent[0] = up[1] * n[2] - up[2] * n[1];
+	tangent[1] = up[2] * n[0] - up[0] * n[2];
+	tangent[2] = up[0] * n[1] - up[1] * n[0];
+	Normalize(tangent);
+	bitangent[0] = n[1] * tangent[2] - n[2] * tangent[1];
+	bitangent[1] = n[2] * tangent[0] - n[0] * tangent[2];
+	bitangent[2] = n[0] * tangent[1] - n[1] * tangent[0];
+}
+
+// A light direction for prefiltering, around N = V = (0, 0, 1)
+struct PrefilterSample
+{
+	float Direction[3];
+	float NdotL;
+	float Lod;		// Source mip whose texels cover about the sample's solid angle
+};
+
+// The same samples serve every texel of a level, so they're made once
+static void BuildPrefilterSamples(float roughness, unsigned int count, unsigned int sourceSize, std::vector<PrefilterSample>& samples)
+{
+	SampleTable table;
+	BuildSampleTable(count, table);
+
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+	float texelSolidAngle = 4.0f * Pi / (6.0f * sourceSize * sourceSize);
+
+	samples.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float cosTheta = SampleCosTheta(table.Xi[i], alpha2);
+		float sinTheta = sqrtf((std::max)(0.0f, 1.0f - cosTheta * cosTheta));
+
+		// L is H reflected about N; with N = V, N dot H = V dot H
+		PrefilterSample sample;
+		sample.Direction[0] = 2.0f * cosTheta * sinTheta * table.CosPhi[i];
+		sample.Direction[1] = 2.0f * cosTheta * sinTheta * table.SinPhi[i];
+		sample.Direction[2] = 2.0f * cosTheta * cosTheta - 1.0f;
+		sample.NdotL = sample.Direction[2];
+		if (sample.NdotL <= 0.0f)
+			continue;
+
+		// pdf(L) = D * NdotH / (4 * VdotH) = D / 4
+		float denominator = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+		float pdf = alpha2 / (Pi * denominator * denominator) / 4.0f;
+		float sampleSolidAngle = 1.0f / (count * pdf + 0.0001f);
+		sample.Lod = (std::max)(0.0f, 0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f);
+		samples.push_back(sample);
+	}
+}
+
+// One face of one output level
+static void PrefilterFace(const std::vector<CubeImage>& chain, const std::vector<PrefilterSample>& samples, float mirrorLod, CubeImage& target, unsigned int face)
+{
+	for (unsigned int y = 0; y < target.Size; y++)
+	{
+		for (unsigned int x = 0; x < target.Size; x++)
+		{
+			float n[3];
+			IblPrecompute::GetDirection(face, TexelCoordinate(x, target.Size), TexelCoordinate(y, target.Size), n);
+			Normalize(n);
+			float* output = &target.Faces[face][((size_t)y * target.Size + x) * 3];
+
+			// Perfectly smooth: just the source, at this level's resolution
+			if (samples.empty())
+			{
+				IblPrecompute::Sample(chain, n, mirrorLod, output);
+				continue;
+			}
+
+			float tangent[3], bitangent[3];
+			BuildFrame(n, tangent, bitangent);
+
+			double sum[3] = { 0.0, 0.0, 0.0 };
+			double weight = 0.0;
+			for (const PrefilterSample& sample : samples)
+			{
+				float l[3];
+				for (int i = 0; i < 3; i++)
+					l[i] = tangent[i] * sample.Direction[0] + bitangent[i] * sample.Direction[1] + n[i] * sample.Direction[2];
+
+				float rgb[3];
+				IblPrecompute::Sample(chain, l, sample.Lod, rgb);
+				for (int i = 0; i < 3; i++)
+					sum[i] += rgb[i] * sample.NdotL;
+				weight += sample.NdotL;
+			}
+			for (int i = 0; i < 3; i++)
+				output[i] = (float)(sum[i] / weight);
+		}
+	}
+}
+
+// Split-sum integrand (Karis 2013) for one texel, from sample first on.
+// V = (sin, 0, cos) around N = (0, 0, 1).
+static void IntegrateBrdf(float NdotV, float roughness, const SampleTable& table, unsigned int first, double& scale, double& bias)
+{
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+	float k = alpha / 2.0f;
+	float vx = sqrtf(1.0f - NdotV * NdotV);
+	float geometryV = NdotV / (NdotV * (1.0f - k) + k);
+
+	for (unsigned int i = first; i < table.Xi.size(); i++)
+	{
+		float cosTheta = SampleCosTheta(table.Xi[i], alpha2);
+		float sinTheta = sqrtf((std::max)(0.0f, 1.0f - cosTheta * cosTheta));
+		float hx = sinTheta * table.CosPhi[i];
+
+		float VdotH = vx * hx + NdotV * cosTheta;
+		float NdotL = 2.0f * VdotH * cosTheta - NdotV;
+		if (NdotL <= 0.0f)
+			continue;
+
+		VdotH = (std::max)(VdotH, 0.0f);
+		float geometryL = NdotL / (NdotL * (1.0f - k) + k);
+		float visibility = geometryV * geometryL * VdotH / (cosTheta * NdotV);
+		float f = 1.0f - VdotH;
+		float fresnel = f * f * f * f * f;
+		scale += (1.0f - fresnel) * visibility;
+		bias += fresnel * visibility;
+	}
+}
+
+#ifdef IBL_PRECOMPUTE_AVX2
+// IntegrateBrdf(), eight samples at a time
+// Returns how many samples it did; the scalar version finishes the rest
+AVX2_FUNCTION static unsigned int IntegrateBrdfAvx2(float NdotV, float roughness, const SampleTable& table, double& scale, double& bias)
+{
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+	float k = alpha / 2.0f;
+
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 alpha2Minus1 = _mm256_set1_ps(alpha2 - 1.0f);
+	const __m256 oneMinusK = _mm256_set1_ps(1.0f - k);
+	const __m256 kVector = _mm256_set1_ps(k);
+	const __m256 vx = _mm256_set1_ps(sqrtf(1.0f - NdotV * NdotV));
+	const __m256 vz = _mm256_set1_ps(NdotV);
+	const __m256 geometryV = _mm256_set1_ps(NdotV / (NdotV * (1.0f - k) + k));
+
+	__m256 scaleSum = zero;
+	__m256 biasSum = zero;
+	unsigned int count = (unsigned int)table.Xi.size() & ~7u;
+	for (unsigned int i = 0; i < count; i += 8)
+	{
+		__m256 xi = _mm256_loadu_ps(&table.Xi[i]);
+		__m256 cosTheta = _mm256_sqrt_ps(_mm256_div_ps(_mm256_sub_ps(one, xi), _mm256_add_ps(one, _mm256_mul_ps(alpha2Minus1, xi))));
+		__m256 sinTheta = _mm256_sqrt_ps(_mm256_max_ps(zero, _mm256_sub_ps(one, _mm256_mul_ps(cosTheta, cosTheta))));
+		__m256 hx = _mm256_mul_ps(sinTheta, _mm256_loadu_ps(&table.CosPhi[i]));
+
+		__m256 VdotH = _mm256_add_ps(_mm256_mul_ps(vx, hx), _mm256_mul_ps(vz, cosTheta));
+		__m256 NdotL = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(VdotH, VdotH), cosTheta), vz);
+		__m256 lit = _mm256_cmp_ps(NdotL, zero, _CMP_GT_OQ);
+
+		VdotH = _mm256_max_ps(VdotH, zero);
+		__m256 geometryL = _mm256_div_ps(NdotL, _mm256_add_ps(_mm256_mul_ps(NdotL, oneMinusK), kVector));
+		__m256 visibility = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(geometryV, geometryL), VdotH), _mm256_mul_ps(cosTheta, vz));
+
+		__m256 f = _mm256_sub_ps(one, VdotH);
+		__m256 f2 = _mm256_mul_ps(f, f);
+		__m256 fresnel = _mm256_mul_ps(_mm256_mul_ps(f2, f2), f);
+
+		// Unlit lanes may hold NaNs; the mask zeroes their bits either way
+		scaleSum = _mm256_add_ps(scaleSum, _mm256_and_ps(lit, _mm256_mul_ps(_mm256_sub_ps(one, fresnel), visibility)));
+		biasSum = _mm256_add_ps(biasSum, _mm256_and_ps(lit, _mm256_mul_ps(fresnel, visibility)));
+	}
+
+	float lanes[8];
+	_mm256_storeu_ps(lanes, scaleSum);
+	for (int i = 0; i < 8; i++)
+		scale += lanes[i];
+	_mm256_storeu_ps(lanes, biasSum);
+	for (int i = 0; i < 8; i++)
+		bias += lanes[i];
+	return count;
+}
+#endif
+
+// A band of LUT rows
+static void ComputeBrdfRows(BrdfLut& lut, const SampleTable& table, unsigned int firstRow, unsigned int endRow, bool simd)
+{
+	for (unsigned int y = firstRow; y < endRow; y++)
+	{
+		float roughness = (y + 0.5f) / lut.Size;
+		for (unsigned int x = 0; x < lut.Size; x++)
+		{
+			float NdotV = (x + 0.5f) / lut.Size;
+			double scale = 0.0, bias = 0.0;
+			unsigned int done = 0;
+#ifdef IBL_PRECOMPUTE_AVX2
+			if (simd)
+				done = IntegrateBrdfAvx2(NdotV, roughness, table, scale, bias);
+#endif
+			IntegrateBrdf(NdotV, roughness, table, done, scale, bias);
+
+			float* output = &lut.Values[((size_t)y * lut.Size + x) * 2];
+			output[0] = (float)(scale / lut.Samples);
+			output[1] = (float)(bias / lut.Samples);
+		}
+	}
+}
+
+/// <summary>
+/// Direction through a point on a cube face, as D3D samples it (not normalized)
+/// </summary>
+/// <param name="u">Across the face, -1 (left) to 1 (right)</param>
+/// <param name="v">Down the face, -1 (top) to 1 (bottom)</param>
+void IblPrecompute::GetDirection(unsigned int face, float u, float v, float direction[3])
+{
+	switch (face)
+	{
+		case 0: direction[0] = 1.0f; direction[1] = -v; direction[2] = -u; break;
+		case 1: direction[0] = -1.0f; direction[1] = -v; direction[2] = u; break;
+		case 2: direction[0] = u; direction[1] = 1.0f; direction[2] = v; break;
+		case 3: direction[0] = u; direction[1] = -1.0f; direction[2] = -v; break;
+		case 4: direction[0] = u; direction[1] = -v; direction[2] = 1.0f; break;
+		default: direction[0] = -u; direction[1] = -v; direction[2] = -1.0f; break;
+	}
+}
+
+/// <summary>
+/// Halves a cube's size, averaging 2x2 texels
+/// </summary>
+void IblPrecompute::Downsample(const CubeImage& source, CubeImage& target)
+{
+	target.Size = (std::max)(1u, source.Size / 2);
+	unsigned int step = source.Size > 1 ? 2 : 1;
+	for (int face = 0; face < 6; face++)
+	{
+		target.Faces[face].resize((size_t)target.Size * target.Size * 3);
+		for (unsigned int y = 0; y < target.Size; y++)
+		{
+			for (unsigned int x = 0; x < target.Size; x++)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					float sum = 0.0f;
+					for (unsigned int dy = 0; dy < step; dy++)
+						for (unsigned int dx = 0; dx < step; dx++)
+							sum += source.Faces[face][(((size_t)y * step + dy) * source.Size + x * step + dx) * 3 + i];
+					target.Faces[face][((size_t)y * target.Size + x) * 3 + i] = sum / (step * step);
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Makes every mip of a cube, down to 1x1
+/// </summary>
+/// <param name="chain">Replaced with the levels, top (a copy) first</param>
+void IblPrecompute::BuildChain(const CubeImage& top, std::vector<CubeImage>& chain)
+{
+	chain.clear();
+	chain.push_back(top);
+	while (chain.back().Size > 1)
+	{
+		CubeImage next;
+		Downsample(chain.back(), next);
+		chain.push_back(std::move(next));
+	}
+}
+
+/// <summary>
+/// Trilinear lookup in a mip chain, like SampleLevel()
+/// </summary>
+/// <param name="lod">Fractional mip, clamped to the chain</param>
+void IblPrecompute::Sample(const std::vector<CubeImage>& chain, const float direction[3], float lod, float rgb[3])
+{
+	float u, v;
+	unsigned int face = FindFace(direction, u, v);
+
+	lod = (std::min)((std::max)(lod, 0.0f), (float)(chain.size() - 1));
+	unsigned int level = (unsigned int)lod;
+	float blend = lod - level;
+
+	SampleFace(chain[level], face, u, v, rgb);
+	if (blend > 0.0f && level + 1 < chain.size())
+	{
+		float next[3];
+		SampleFace(chain[level + 1], face, u, v, next);
+		for (int i = 0; i < 3; i++)
+			rgb[i] += (next[i] - rgb[i]) * blend;
+	}
+}
+
+/// <summary>
+/// Projects a cube's radiance onto the first nine SH basis
+/// functions, weighing each texel by the solid angle it covers
+/// </summary>
+ShCoefficients IblPrecompute::ProjectRadiance(const CubeImage& cube)
+{
+	double sums[9][3] = {};
+	double totalWeight = 0.0;
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < cube.Size; y++)
+		{
+			for (unsigned int x = 0; x < cube.Size; x++)
+			{
+				float u = TexelCoordinate(x, cube.Size), v = TexelCoordinate(y, cube.Size);
+				float direction[3];
+				GetDirection(face, u, v, direction);
+				Normalize(direction);
+
+				float basis[9];
+				SH9(direction, basis);
+				float weight = TexelSolidAngle(u, v, cube.Size);
+				const float* rgb = &cube.Faces[face][((size_t)y * cube.Size + x) * 3];
+				for (int i = 0; i < 9; i++)
+					for (int c = 0; c < 3; c++)
+						sums[i][c] += (double)rgb[c] * basis[i] * weight;
+				totalWeight += weight;
+			}
+		}
+	}
+
+	// The texel solid angles are close to, but don't add up to exactly, 4 pi
+	ShCoefficients sh;
+	double normalize = 4.0 * Pi / totalWeight;
+	for (int i = 0; i < 9; i++)
+		for (int c = 0; c < 3; c++)
+			sh.Rgb[i][c] = (float)(sums[i][c] * normalize);
+	return sh;
+}
+
+/// <summary>
+/// Turns radiance coefficients into irradiance over pi: what a
+/// white Lambertian surface facing a direction reflects
+/// </summary>
+ShCoefficients IblPrecompute::ConvolveLambert(const ShCoefficients& radiance)
+{
+	// Cosine lobe per band (pi, 2 pi / 3, pi / 4), over pi
+	static const float bands[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+	ShCoefficients irradiance;
+	for (int i = 0; i < 9; i++)
+		for (int c = 0; c < 3; c++)
+			irradiance.Rgb[i][c] = radiance.Rgb[i][c] * bands[i];
+	return irradiance;
+}
+
+/// <summary>
+/// Evaluates the coefficients in a direction
+/// </summary>
+/// <param name="direction">Must be normalized</param>
+void IblPrecompute::Evaluate(const ShCoefficients& sh, const float direction[3], float rgb[3])
+{
+	float basis[9];
+	SH9(direction, basis);
+	for (int c = 0; c < 3; c++)
+	{
+		rgb[c] = 0.0f;
+		for (int i = 0; i < 9; i++)
+			rgb[c] += sh.Rgb[i][c] * basis[i];
+	}
+}
+
+/// <summary>
+/// The nine basis functions in a direction
+/// </summary>
+/// <param name="direction">Must be normalized</param>
+void IblPrecompute::GetBasis(const float direction[3], float basis[9])
+{
+	SH9(direction, basis);
+}
+
+/// <summary>
+/// Irradiance over pi by summing every texel. Slow, but exact
+/// (up to the cube's resolution); for validating the SH path.
+/// </summary>
+/// <param name="normal">Must be normalized</param>
+void IblPrecompute::BruteForceIrradiance(const CubeImage& cube, const float normal[3], float rgb[3])
+{
+	double sums[3] = {};
+	double totalWeight = 0.0;
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < cube.Size; y++)
+		{
+			for (unsigned int x = 0; x < cube.Size; x++)
+			{
+				float u = TexelCoordinate(x, cube.Size), v = TexelCoordinate(y, cube.Size);
+				float direction[3];
+				GetDirection(face, u, v, direction);
+				Normalize(direction);
+
+				float weight = TexelSolidAngle(u, v, cube.Size);
+				totalWeight += weight;
+				float cosine = normal[0] * direction[0] + normal[1] * direction[1] + normal[2] * direction[2];
+				if (cosine <= 0.0f)
+					continue;
+
+				const float* texel = &cube.Faces[face][((size_t)y * cube.Size + x) * 3];
+				for (int c = 0; c < 3; c++)
+					sums[c] += (double)texel[c] * cosine * weight;
+			}
+		}
+	}
+
+	for (int c = 0; c < 3; c++)
+		rgb[c] = (float)(sums[c] * (4.0 * Pi / totalWeight) / Pi);
+}
+
+/// <summary>
+/// Folds the basis constants into the coefficients, so the shader
+/// only multiplies them by polynomials of the normal: 1, y, z, x,
+/// xy, yz, 3z^2 - 1, xz, x^2 - y^2 (see PixelShader.hlsl)
+/// </summary>
+/// <param name="packed">float4s for a constant buffer; w is unused</param>
+void IblPrecompute::PackForShader(const ShCoefficients& sh, float packed[9][4])
+{
+	for (int i = 0; i < 9; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			packed[i][c] = sh.Rgb[i][c] * ShBasis[i];
+		packed[i][3] = 0.0f;
+	}
+}
+
+/// <summary>
+/// Roughness a prefiltered mip was made for. The shader picks a mip
+/// with the inverse: roughness * (levels - 1).
+/// </summary>
+float IblPrecompute::GetMipRoughness(unsigned int level, unsigned int levels)
+{
+	return levels > 1 ? (float)level / (levels - 1) : 0.0f;
+}
+
+/// <summary>
+/// Convolves an environment with the GGX lobe for each output mip's
+/// roughness, assuming N = V = R. Each sample reads the source mip
+/// whose texels match its solid angle, which keeps the bright spots
+/// of a low sample count from turning into noise.
+/// </summary>
+/// <param name="sourceChain">From BuildChain()</param>
+/// <param name="size">Width of the output's top level</param>
+/// <param name="samples">Per texel, for every level but the first</param>
+/// <param name="output">Replaced with the levels, largest first</param>
+/// <param name="queue">Spreads the faces of each level across its threads, if given</param>
+void IblPrecompute::PrefilterSpecular(const std::vector<CubeImage>& sourceChain, unsigned int size, unsigned int levels, unsigned int samples,
+	std::vector<CubeImage>& output, JobQueue* queue)
+{
+	output.clear();
+	output.resize(levels);
+
+	std::vector<std::vector<PrefilterSample>> levelSamples(levels);
+	for (unsigned int level = 0; level < levels; level++)
+	{
+		CubeImage& target = output[level];
+		target.Size = (std::max)(1u, size >> level);
+		for (int face = 0; face < 6; face++)
+			target.Faces[face].resize((size_t)target.Size * target.Size * 3);
+
+		float roughness = GetMipRoughness(level, levels);
+		if (roughness > 0.0f)
+			BuildPrefilterSamples(roughness, samples, sourceChain[0].Size, levelSamples[level]);
+	}
+
+	for (unsigned int level = 0; level < levels; level++)
+	{
+		float mirrorLod = log2f((float)sourceChain[0].Size / output[level].Size);
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			const std::vector<PrefilterSample>* levelList = &levelSamples[level];
+			CubeImage* target = &output[level];
+			if (queue)
+				queue->Push([&sourceChain, levelList, mirrorLod, target, face]() { PrefilterFace(sourceChain, *levelList, mirrorLod, *target, face); });
+			else
+				PrefilterFace(sourceChain, *levelList, mirrorLod, *target, face);
+		}
+	}
+
+	if (queue)
+		queue->WaitIdle();
+}
+
+/// <summary>
+/// Integrates the split-sum BRDF table
+/// </summary>
+/// <param name="size">Width and height</param>
+/// <param name="samples">Hammersley samples per texel</param>
+/// <param name="useSimd">AVX2, when the CPU has it. Sums in a different order, so the
+/// results differ from the scalar path's in the last bits.</param>
+/// <param name="queue">Spreads bands of rows across its threads, if given</param>
+void IblPrecompute::ComputeBrdfLut(unsigned int size, unsigned int samples, BrdfLut& lut, bool useSimd, JobQueue* queue)
+{
+	lut.Size = size;
+	lut.Samples = samples;
+	lut.Values.assign((size_t)size * size * 2, 0.0f);
+
+	SampleTable table;
+	BuildSampleTable(samples, table);
+	bool simd = useSimd && CpuUtilities::HasAvx2();
+
+	const unsigned int rowsPerJob = 4;
+	for (unsigned int row = 0; row < size; row += rowsPerJob)
+	{
+		unsigned int end = (std::min)(row + rowsPerJob, size);
+		if (queue)
+			queue->Push([&lut, &table, row, end, simd]() { ComputeBrdfRows(lut, table, row, end, simd); });
+		else
+			ComputeBrdfRows(lut, table, row, end, simd);
+	}
+
+	if (queue)
+		queue->WaitIdle();
+}
+
+/// <summary>
+/// Reads a table saved by SaveBrdfLut()
+/// </summary>
+/// <returns>False if the file is missing, damaged, or made with a different size or sample count</returns>
+bool IblPrecompute::LoadBrdfLut(const std::string& path, unsigned int size, unsigned int samples, BrdfLut& lut)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	char magic[8];
+	unsigned int header[2];
+	if (!file.read(magic, sizeof(magic)) || memcmp(magic, BrdfLutMagic, sizeof(magic)) != 0 ||
+		!file.read((char*)header, sizeof(header)) || header[0] != size || header[1] != samples)
+		return false;
+
+	std::vector<float> values((size_t)size * size * 2);
+	if (!file.read((char*)values.data(), values.size() * sizeof(float)))
+		return false;
+
+	lut.Size = size;
+	lut.Samples = samples;
+	lut.Values = std::move(values);
+	return true;
+}
+
+/// <summary>
+/// Writes a table for LoadBrdfLut()
+/// </summary>
+/// <returns>False if the file can't be written</returns>
+bool IblPrecompute::SaveBrdfLut(const std::string& path, const BrdfLut& lut)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	unsigned int header[2] = { lut.Size, lut.Samples };
+	file.write(BrdfLutMagic, sizeof(BrdfLutMagic));
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)lut.Values.data(), lut.Values.size() * sizeof(float));
+	return (bool)file;
+}
+
+/// <summary>
+/// Loads the table from the cache file, or computes and saves it
+/// </summary>
+/// <param name="fromCache">Set to whether the file was used, if given</param>
+/// <returns>False only if the table couldn't be loaded or computed; a cache
+/// file that can't be written just means computing it again next time</returns>
+bool IblPrecompute::GetBrdfLut(const std::string& path, unsigned int size, unsigned int samples, BrdfLut& lut, JobQueue* queue, bool* fromCache)
+{
+	bool loaded = !path.empty() && LoadBrdfLut(path, size, samples, lut);
+	if (fromCache)
+		*fromCache = loaded;
+	if (loaded)
+		return true;
+
+	if (size == 0 || samples == 0)
+		return false;
+
+	ComputeBrdfLut(size, samples, lut, true, queue);
+	if (!path.empty())
+		SaveBrdfLut(path, lut);
+	return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "JobQueue.h"
+
+// A cube map in linear RGB floats. Faces are in D3D's order
+// (+X, -X, +Y, -Y, +Z, -Z), rows top to bottom.
+struct CubeImage
+{
+	unsigned int Size = 0;
+	std::vector<float> Faces[6];	// Size * Size texels, 3 floats each
+};
+
+// Nine RGB coefficients: spherical harmonics bands 0 to 2
+struct ShCoefficients
+{
+	float Rgb[9][3] = {};
+};
+
+// Split-sum environment BRDF: for each (N dot V, roughness),
+// the scale and bias applied to F0
+struct BrdfLut
+{
+	unsigned int Size = 0;
+	unsigned int Samples = 0;	// Per texel
+	std::vector<float> Values;	// Size * Size pairs; columns are N dot V, rows roughness
+};
+
+// --------------------------------------------------------
+// CPU integrators for image-based lighting:
+//
+//  - Diffuse: the environment's radiance projected onto nine
+//    SH coefficients, then convolved with the cosine lobe, so
+//    the shader gets irradiance from one small polynomial
+//  - Specular: the environment importance sampled with GGX
+//    for increasing roughness, one level per mip
+//  - The BRDF lookup table for the split-sum approximation,
+//    with an AVX2 path, across a JobQueue, and cached on disk
+//
+// The GGX conventions match PixelShader.hlsl: alpha is the
+// roughness squared, and the IBL geometry term uses k = alpha / 2.
+// --------------------------------------------------------
+class IblPrecompute
+{
+	public:
+		// Cube maps
+		static void GetDirection(unsigned int face, float u, float v, float direction[3]);
+		static void Downsample(const CubeImage& source, CubeImage& target);
+		static void BuildChain(const CubeImage& top, std::vector<CubeImage>& chain);
+		static void Sample(const std::vector<CubeImage>& chain, const float direction[3], float lod, float rgb[3]);
+
+		// Diffuse
+		static const float ShBasis[9];	// Band constants of the real SH basis, in coefficient order
+		static ShCoefficients ProjectRadiance(const CubeImage& cube);
+		static ShCoefficients ConvolveLambert(const ShCoefficients& radiance);
+		static void Evaluate(const ShCoefficients& sh, const float direction[3], float rgb[3]);
+		static void GetBasis(const float direction[3], float basis[9]);
+		static void BruteForceIrradiance(const CubeImage& cube, const float normal[3], float rgb[3]);
+		static void PackForShader(const ShCoefficients& sh, float packed[9][4]);
+
+		// Specular
+		static float GetMipRoughness(unsigned int level, unsigned int levels);
+		static void PrefilterSpecular(const std::vector<CubeImage>& sourceChain, unsigned int size, unsigned int levels, unsigned int samples,
+			std::vector<CubeImage>& output, JobQueue* queue = 0);
+
+		// BRDF lookup table
+		static void ComputeBrdfLut(unsigned int size, unsigned int samples, BrdfLut& lut, bool useSimd = true, JobQueue* queue = 0);
+		static bool LoadBrdfLut(const std::string& path, unsigned int size, unsigned int samples, BrdfLut& lut);
+		static bool SaveBrdfLut(const std::string& path, const BrdfLut& lut);
+		static bool GetBrdfLut(const std::string& path, unsigned int size, unsigned int samples, BrdfLut& lut, JobQueue* queue = 0, bool* fromCache = 0);
+};
@@ -0,0 +1,268 @@
+#include "InstanceBatcher.h"
+
+#include <algorithm>
+#include <string.h>
+
+/// <summary>
+/// Creates a batcher. The instance buffer is made on the first draw.
+/// </summary>
+InstanceBatcher::InstanceBatcher(
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context)
+	:
+	device(_device),
+	context(_context),
+	capacity(0)
+{
+}
+
+/// <summary>
+/// Draws every entity whose material is in the table. The shaders
+/// must already be set, with their per-frame data (camera, lights)
+/// filled in and copied, in both pixel shaders.
+/// </summary>
+/// <param name="coarsePixelShader">For entities at ShadingRate::Coarse; if null, or not valid, everything is drawn at full rate</param>
+/// <param name="unbatched">Filled with entities the caller has to draw itself</param>
+/// <param name="stats">Draw calls, bindings and instances are added to this</param>
+/// <param name="depthStencilOverride">If not 0, replaces the default depth-stencil state (ex. EQUAL after a depth pre-pass)</param>
+void InstanceBatcher::Draw(
+	const std::vector<std::shared_ptr<Entity>>& entities,
+	MaterialTable& materialTable,
+	RenderStateCache& renderStates,
+	std::shared_ptr<SimpleVertexShader> vertexShader,
+	std::shared_ptr<SimplePixelShader> pixelShader,
+	std::shared_ptr<SimplePixelShader> coarsePixelShader,
+	std::vector<std::shared_ptr<Entity>>& unbatched,
+	DrawStats& stats,
+	RenderStateId depthStencilOverride)
+{
+	bool coarse = coarsePixelShader && coarsePixelShader->IsShaderValid();
+	keys.clear();
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		int material = materialTable.GetIndex(entities[i]->GetMaterial().get());
+		if (material < 0)
+		{
+			unbatched.push_back(entities[i]);
+			continue;
+		}
+		unsigned int state = GetState(entities[i].get(), depthStencilOverride).GetKey();
+		unsigned int rate = coarse && entities[i]->GetShadingRate() == ShadingRate::Coarse ? 0 : 1;
+		keys.push_back({ rate, state, materialTable.GetGroup((unsigned int)material), entities[i]->GetMesh().get(), entities[i]->GetLod(), (unsigned int)i, (unsigned int)material });
+	}
+
+	if (keys.empty())
+		return;
+
+	// Shader, state and group changes cost a rebind, mesh (and level of detail) changes a new draw
+	std::sort(keys.begin(), keys.end(), [](const DrawKey& a, const DrawKey& b)
+	{
+		if (a.Rate != b.Rate) return a.Rate < b.Rate;
+		if (a.State != b.State) return a.State < b.State;
+		if (a.Group != b.Group) return a.Group < b.Group;
+		if (a.EntityMesh != b.EntityMesh) return a.EntityMesh < b.EntityMesh;
+		if (a.Lod != b.Lod) return a.Lod < b.Lod;
+		return a.Entity < b.Entity;
+	});
+
+	// Without the instance buffer, the caller draws them one at a time
+	if (!Upload(entities))
+	{
+		for (const DrawKey& key : keys)
+			unbatched.push_back(entities[key.Entity]);
+		return;
+	}
+
+	vertexShader->SetShaderResourceView("Instances", instanceSRV);
+
+	size_t first = 0;
+	while (first < keys.size())
+	{
+		size_t end = first + 1;
+		while (end < keys.size() && keys[end].Rate == keys[first].Rate && keys[end].State == keys[first].State && keys[end].Group == keys[first].Group &&
+			keys[end].EntityMesh == keys[first].EntityMesh && keys[end].Lod == keys[first].Lod)
+			end++;
+
+		// The coarse entities come first; the full rate shader takes over after them
+		bool newRate = first == 0 || keys[first].Rate != keys[first - 1].Rate;
+		std::shared_ptr<SimplePixelShader> shader = keys[first].Rate == 0 ? coarsePixelShader : pixelShader;
+		if (newRate)
+			shader->SetShader();
+
+		if (newRate || keys[first].State != keys[first - 1].State)
+			renderStates.Apply(GetState(entities[keys[first].Entity].get(), depthStencilOverride));
+
+		if (newRate || keys[first].Group != keys[first - 1].Group)
+		{
+			materialTable.Bind(shader, keys[first].Group);
+			stats.BindGroups++;
+		}
+
+		// SV_InstanceID restarts at zero for every draw; positions unpack per mesh
+		Mesh* mesh = keys[first].EntityMesh;
+		vertexShader->SetInt("instanceOffset", (int)first);
+		vertexShader->SetFloat3("positionScale", mesh->GetPositionScale());
+		vertexShader->SetFloat3("positionOffset", mesh->GetPositionOffset());
+		vertexShader->CopyAllBufferData();
+
+		MeshLod lod = mesh->GetLod(keys[first].Lod);
+		mesh->SetBuffers(context, false);
+		context->DrawIndexedInstanced(lod.IndexCount, (UINT)(end - first), lod.IndexStart, 0, 0);
+
+		stats.DrawCalls++;
+		stats.Instances += (unsigned int)(end - first);
+		first = end;
+	}
+	stats.Batched = true;
+}
+
+/// <summary>
+/// Draws the depth of every entity whose material is in the table, a
+/// run of the same mesh (and level of detail, and rasterizer state)
+/// at a time. Entities should come nearest first: each run keeps that
+/// order, and runs are drawn by their nearest entity. The depth-only
+/// shader must already be set, with the camera filled in, and no pixel
+/// shader.
+/// </summary>
+/// <param name="unbatched">Filled with entities the caller has to draw itself, in order</param>
+/// <param name="stats">Depth draw calls are added to this</param>
+void InstanceBatcher::DrawDepth(
+	const std::vector<std::shared_ptr<Entity>>& entities,
+	MaterialTable& materialTable,
+	RenderStateCache& renderStates,
+	std::shared_ptr<SimpleVertexShader> vertexShader,
+	std::vector<std::shared_ptr<Entity>>& unbatched,
+	DrawStats& stats)
+{
+	keys.clear();
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		int material = materialTable.GetIndex(entities[i]->GetMaterial().get());
+		if (material < 0)
+		{
+			unbatched.push_back(entities[i]);
+			continue;
+		}
+		unsigned int state = entities[i]->GetMaterial()->GetRenderState().GetKey();
+		keys.push_back({ 1, state, 0, entities[i]->GetMesh().get(), entities[i]->GetLod(), (unsigned int)i, (unsigned int)material });
+	}
+
+	if (keys.empty())
+		return;
+
+	// Entity order breaks ties, so each run starts with its nearest
+	std::sort(keys.begin(), keys.end(), [](const DrawKey& a, const DrawKey& b)
+	{
+		if (a.State != b.State) return a.State < b.State;
+		if (a.EntityMesh != b.EntityMesh) return a.EntityMesh < b.EntityMesh;
+		if (a.Lod != b.Lod) return a.Lod < b.Lod;
+		return a.Entity < b.Entity;
+	});
+
+	if (!Upload(entities))
+	{
+		for (const DrawKey& key : keys)
+			unbatched.push_back(entities[key.Entity]);
+		return;
+	}
+
+	runs.clear();
+	size_t first = 0;
+	while (first < keys.size())
+	{
+		size_t end = first + 1;
+		while (end < keys.size() && keys[end].State == keys[first].State && keys[end].EntityMesh == keys[first].EntityMesh && keys[end].Lod == keys[first].Lod)
+			end++;
+		runs.push_back(std::make_pair(first, end));
+		first = end;
+	}
+	std::sort(runs.begin(), runs.end(), [this](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b)
+	{
+		return keys[a.first].Entity < keys[b.first].Entity;
+	});
+
+	vertexShader->SetShaderResourceView("Instances", instanceSRV);
+	for (const std::pair<size_t, size_t>& run : runs)
+	{
+		renderStates.Apply(entities[keys[run.first].Entity]->GetMaterial()->GetRenderState());
+
+		Mesh* mesh = keys[run.first].EntityMesh;
+		vertexShader->SetInt("instanceOffset", (int)run.first);
+		vertexShader->SetFloat3("positionScale", mesh->GetPositionScale());
+		vertexShader->SetFloat3("positionOffset", mesh->GetPositionOffset());
+		vertexShader->CopyAllBufferData();
+
+		MeshLod lod = mesh->GetLod(keys[run.first].Lod);
+		mesh->SetBuffers(context, true);
+		context->DrawIndexedInstanced(lod.IndexCount, (UINT)(run.second - run.first), lod.IndexStart, 0, 0);
+
+		stats.DepthDrawCalls++;
+	}
+}
+
+/// <summary>
+/// The render state an entity draws with: its material's, with the
+/// default depth-stencil state swapped for the override, if any
+/// </summary>
+RenderState InstanceBatcher::GetState(Entity* entity, RenderStateId depthStencilOverride)
+{
+	RenderState state = entity->GetMaterial()->GetRenderState();
+	if (depthStencilOverride != 0 && state.DepthStencil == 0)
+		state.DepthStencil = depthStencilOverride;
+	return state;
+}
+
+/// <summary>
+/// Fills the instance buffer from the sorted keys
+/// </summary>
+/// <returns>False if the buffer can't be made or mapped</returns>
+bool InstanceBatcher::Upload(const std::vector<std::shared_ptr<Entity>>& entities)
+{
+	instances.resize(keys.size());
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		Transform* transform = entities[keys[i].Entity]->GetTransform();
+		instances[i].World = transform->GetWorldMatrix();
+		instances[i].WorldInvTranspose = transform->GetWorldInverseTranposeMatrix();
+		instances[i].MaterialIndex = keys[i].Material;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (!Reserve(instances.size()) || FAILED(context->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return false;
+	memcpy(mapped.pData, instances.data(), sizeof(InstanceData) * instances.size());
+	context->Unmap(instanceBuffer.Get(), 0);
+	return true;
+}
+
+/// <summary>
+/// Makes sure the instance buffer holds at least count instances,
+/// growing it by half again each time it's too small
+/// </summary>
+/// <returns>False if the buffer can't be created</returns>
+bool InstanceBatcher::Reserve(size_t count)
+{
+	if (count <= capacity && instanceBuffer)
+		return true;
+
+	size_t newCapacity = (std::max)(count, capacity + capacity / 2);
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = (UINT)(sizeof(InstanceData) * newCapacity);
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = sizeof(InstanceData);
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(device->CreateBuffer(&desc, 0, buffer.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(buffer.Get(), 0, srv.GetAddressOf())))
+		return false;
+
+	instanceBuffer = buffer;
+	instanceSRV = srv;
+	capacity = newCapacity;
+	return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <wrl/client.h>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Entity.h"
+#include "FrameStats.h"
+#include "MaterialTable.h"
+#include "RenderStateCache.h"
+#include "SimpleShader.h"
+
+// One instance in the instance buffer (must match InstanceData in ShaderIncludes.hlsli)
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInvTranspose;
+	unsigned int MaterialIndex;
+	unsigned int Padding[3];
+};
+
+// --------------------------------------------------------
+// Draws entities in as few calls as possible: they're sorted
+// by render state, material group, then mesh, and each run
+// of the same mesh becomes one instanced draw, whatever its
+// materials (as long as their render states match). Entities
+// lit at the coarse shading rate go first, with the coarse
+// permutation of the pixel shader, then the rest.
+// Transforms and material indices go through a structured
+// buffer that grows as needed.
+//
+// DrawDepth() does the same for a depth pre-pass, where
+// materials don't matter: runs of a mesh are drawn nearest
+// first, so the pre-pass itself rejects what it can early.
+// --------------------------------------------------------
+class InstanceBatcher
+{
+	public:
+		InstanceBatcher(
+			Microsoft::WRL::ComPtr<ID3D11Device> _device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context);
+
+		void Draw(
+			const std::vector<std::shared_ptr<Entity>>& entities,
+			MaterialTable& materialTable,
+			RenderStateCache& renderStates,
+			std::shared_ptr<SimpleVertexShader> vertexShader,
+			std::shared_ptr<SimplePixelShader> pixelShader,
+			std::shared_ptr<SimplePixelShader> coarsePixelShader,
+			std::vector<std::shared_ptr<Entity>>& unbatched,
+			DrawStats& stats,
+			RenderStateId depthStencilOverride = 0);
+
+		void DrawDepth(
+			const std::vector<std::shared_ptr<Entity>>& entities,
+			MaterialTable& materialTable,
+			RenderStateCache& renderStates,
+			std::shared_ptr<SimpleVertexShader> vertexShader,
+			std::vector<std::shared_ptr<Entity>>& unbatched,
+			DrawStats& stats);
+
+	private:
+		// An entity's place in the sorted draw order
+		struct DrawKey
+		{
+			unsigned int Rate;		// 0 for coarse, 1 for full, so coarse sorts first
+			unsigned int State;		// RenderState::GetKey()
+			unsigned int Group;
+			Mesh* EntityMesh;
+			unsigned int Lod;
+			unsigned int Entity;
+			unsigned int Material;
+		};
+
+		static RenderState GetState(Entity* entity, RenderStateId depthStencilOverride);
+		bool Upload(const std::vector<std::shared_ptr<Entity>>& entities);
+		bool Reserve(size_t count);
+
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+		Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> instanceSRV;
+		size_t capacity;
+
+		// Reused every frame
+		std::vector<DrawKey> keys;
+		std::vector<InstanceData> instances;
+		std::vector<std::pair<size_t, size_t>> runs;	// DrawDepth()'s, as [first, end) of keys
+};
@@ -0,0 +1,91 @@
+#include "JobQueue.h"
+
+/// <summary>
+/// Constructor. Starts the worker threads right away.
+/// </summary>
+/// <param name="_threadCount">Number of workers, at least one</param>
+JobQueue::JobQueue(unsigned int _threadCount)
+	: activeJobs(0), stopping(false)
+{
+	if (_threadCount == 0)
+		_threadCount = 1;
+
+	for (unsigned int i = 0; i < _threadCount; i++)
+		workers.push_back(std::thread(&JobQueue::WorkerLoop, this));
+}
+
+/// <summary>
+/// Destructor. Finishes every queued job, then joins the workers.
+/// </summary>
+JobQueue::~JobQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAdded.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+/// <summary>
+/// Adds a job to the back of the queue
+/// </summary>
+void JobQueue::Push(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(job);
+	}
+	jobAdded.notify_one();
+}
+
+/// <summary>
+/// Blocks until the queue is empty and no job is running
+/// </summary>
+void JobQueue::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobFinished.wait(lock, [this] { return jobs.empty() && activeJobs == 0; });
+}
+
+/// <summary>
+/// Jobs that are queued or running
+/// </summary>
+size_t JobQueue::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return jobs.size() + activeJobs;
+}
+
+unsigned int JobQueue::GetThreadCount() { return (unsigned int)workers.size(); }
+
+/// <summary>
+/// Runs jobs until the queue is stopped and drained
+/// </summary>
+void JobQueue::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAdded.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+				return;
+
+			job = jobs.front();
+			jobs.pop_front();
+			activeJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeJobs--;
+		}
+		jobFinished.notify_all();
+	}
+}
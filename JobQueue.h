@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A fixed set of worker threads pulling jobs off a shared
+// first-in, first-out queue. Jobs must not touch the D3D
+// immediate context; hand results back to the main thread.
+// --------------------------------------------------------
+class JobQueue
+{
+	public:
+		JobQueue(unsigned int _threadCount = 1);
+		~JobQueue();
+
+		JobQueue(const JobQueue&) = delete;
+		JobQueue& operator=(const JobQueue&) = delete;
+
+		void Push(std::function<void()> job);
+		void WaitIdle();
+
+		// Getters
+		size_t GetPendingCount();
+		unsigned int GetThreadCount();
+
+	private:
+		void WorkerLoop();
+
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> jobs;
+		std::mutex mutex;
+		std::condition_variable jobAdded;
+		std::condition_variable jobFinished;
+		unsigned int activeJobs;
+		bool stopping;
+};
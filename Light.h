@@ -3,6 +3,7 @@
 #define LIGHT_TYPE_DIRECTIONAL	0
 #define LIGHT_TYPE_POINT		1
 #define LIGHT_TYPE_SPOT			2
+#define MAX_LIGHTS				64	// Must match ShaderIncludes.hlsli
 
 // Struct for all types of lights
 struct Light
@@ -18,13 +18,41 @@ int WINAPI WinMain(
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+	// Check for the headless benchmark mode
+	BenchmarkOptions benchmark = BenchmarkOptions::Parse(lpCmdLine);
+
 	// Create the Game object using
 	// the app handle we got from WinMain
-	Game dxGame(hInstance);
+	Game dxGame(hInstance, benchmark);
 
 	// Result variable for function calls below
 	HRESULT hr = S_OK;
 
+	// Benchmarks run a fixed number of frames without a window,
+	// reporting to the console we were launched from (if any)
+	if (benchmark.Enabled || benchmark.TextureBenchmark)
+	{
+		if (AttachConsole(ATTACH_PARENT_PROCESS))
+		{
+			FILE* stream;
+			freopen_s(&stream, "CONOUT$", "w", stdout);
+		}
+
+		hr = dxGame.InitDirectXHeadless();
+		if (FAILED(hr)) return hr;
+
+		// Only needs the device, not the scene
+		if (benchmark.TextureBenchmark)
+		{
+			dxGame.RunTextureBenchmark();
+			return hr;
+		}
+
+		hr = dxGame.RunHeadless(benchmark.WarmupFrames + benchmark.FrameCount, benchmark.FixedDeltaTime);
+		dxGame.FinishBenchmark();
+		return hr;
+	}
+
 	// Attempt to create the window for our program, and
 	// exit early if something failed
 	hr = dxGame.InitWindow();
@@ -14,6 +14,7 @@ Material::Material(DirectX::XMFLOAT4 _colorTint, std::shared_ptr<SimpleVertexSha
 	roughness = _roughness;
 	uvScale = _uvScale;
 	uvOffset = _uvOffset;
+	shaderFeatures = 0;
 }
 
 // Deconstructor, currently empty
@@ -28,6 +29,8 @@ std::shared_ptr<SimplePixelShader> Material::GetPixelShader() { return pixelShad
 float Material::GetRoughness() { return roughness; }
 float Material::GetUvScale() { return uvScale; }
 DirectX::XMFLOAT2 Material::GetUvOffset() { return uvOffset; }
+RenderState Material::GetRenderState() { return renderState; }
+unsigned int Material::GetShaderFeatures() { return shaderFeatures; }
 
 // Setters
 void Material::SetColorTint(DirectX::XMFLOAT4 _colorTint) { colorTint = _colorTint; }
@@ -36,6 +39,25 @@ void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> _pixelShader) {
 void Material::SetRoughness(float _roughness) { roughness = _roughness; }
 void Material::SetUvScale(float _uvScale) {	uvScale = _uvScale; }
 void Material::SetUvOffset(DirectX::XMFLOAT2 _uvOffset) { uvOffset = _uvOffset; }
+void Material::SetRenderState(RenderState _renderState) { renderState = _renderState; }
+
+/// <summary>
+/// Finds a texture added with AddTexture()
+/// </summary>
+/// <returns>The texture, or null if there isn't one by that name</returns>
+std::shared_ptr<Texture> Material::GetTexture(const std::string& name)
+{
+	std::unordered_map<std::string, std::shared_ptr<Texture>>::iterator found = textures.find(name);
+	return found == textures.end() ? nullptr : found->second;
+}
+
+/// <summary>
+/// Every texture added with AddTexture(), by name
+/// </summary>
+const std::unordered_map<std::string, std::shared_ptr<Texture>>& Material::GetTextures()
+{
+	return textures;
+}
 
 /// <summary>
 /// Adds a texture to the shader resource view map
@@ -45,6 +67,19 @@ void Material::SetUvOffset(DirectX::XMFLOAT2 _uvOffset) { uvOffset = _uvOffset;
 void Material::AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture)
 {
 	textureSRVs.insert({ name, texture });
+	shaderFeatures |= ShaderPermutations::GetMapFeature(name);
+}
+
+/// <summary>
+/// Adds a texture from the TextureManager. Its current view (the
+/// placeholder, until it finishes loading) is bound in SetMaps().
+/// </summary>
+/// <param name="name">The name of the shader resource</param>
+/// <param name="texture">The texture handle</param>
+void Material::AddTexture(std::string name, std::shared_ptr<Texture> texture)
+{
+	textures.insert({ name, texture });
+	shaderFeatures |= ShaderPermutations::GetMapFeature(name);
 }
 
 /// <summary>
@@ -60,9 +95,12 @@ void Material::AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11Sampler
 /// <summary>
 /// Sets the Shader Resource View and Sampler State in the pixel shader
 /// </summary>
-void Material::SetMaps()
+/// <param name="variant">A permutation of the material's pixel shader to set them in instead, if not null</param>
+void Material::SetMaps(std::shared_ptr<SimplePixelShader> variant)
 {
-	for (auto& t : textureSRVs) { pixelShader->SetShaderResourceView(t.first.c_str(), t.second); }
-	for (auto& s : samplers) { pixelShader->SetSamplerState(s.first.c_str(), s.second); }
-	pixelShader->CopyAllBufferData();
+	std::shared_ptr<SimplePixelShader> shader = variant ? variant : pixelShader;
+	for (auto& t : textureSRVs) { shader->SetShaderResourceView(t.first.c_str(), t.second); }
+	for (auto& t : textures) { shader->SetShaderResourceView(t.first.c_str(), t.second->GetSRV()); }
+	for (auto& s : samplers) { shader->SetSamplerState(s.first.c_str(), s.second); }
+	shader->CopyAllBufferData();
 }
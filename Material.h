@@ -3,7 +3,10 @@
 #include <DirectXMath.h>
 #include <memory>
 #include <unordered_map>
+#include "RenderStateCache.h"
+#include "ShaderPermutations.h"
 #include "SimpleShader.h"
+#include "TextureManager.h"
 class Material
 {
 	public:
@@ -18,6 +21,8 @@ class Material
 		float GetRoughness();
 		float GetUvScale();
 		DirectX::XMFLOAT2 GetUvOffset();
+		RenderState GetRenderState();
+		unsigned int GetShaderFeatures();
 
 		// Setters
 		void SetColorTint(DirectX::XMFLOAT4 _colorTint);
@@ -26,11 +31,15 @@ class Material
 		void SetRoughness(float _roughness);
 		void SetUvScale(float _uvScale);
 		void SetUvOffset(DirectX::XMFLOAT2 _uvOffset);
+		void SetRenderState(RenderState _renderState);
 
 		// Texture Functions
 		void AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture);
+		void AddTexture(std::string name, std::shared_ptr<Texture> texture);
+		std::shared_ptr<Texture> GetTexture(const std::string& name);
+		const std::unordered_map<std::string, std::shared_ptr<Texture>>& GetTextures();
 		void AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> state);
-		void SetMaps();
+		void SetMaps(std::shared_ptr<SimplePixelShader> variant = nullptr);
 
 	private:
 		// Fields
@@ -40,9 +49,12 @@ class Material
 		float roughness;
 		float uvScale;
 		DirectX::XMFLOAT2 uvOffset;
+		RenderState renderState;	// IDs from the RenderStateCache; defaults unless set
+		unsigned int shaderFeatures;	// ShaderPermutations map bits, for the textures added
 
 		// Unordered maps
 		std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
+		std::unordered_map<std::string, std::shared_ptr<Texture>> textures;	// May still be loading
 		std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
 };
 
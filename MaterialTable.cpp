@@ -0,0 +1,276 @@
+#include "MaterialTable.h"
+
+#include <algorithm>
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+// The texture behind a shader resource view, and its description
+static bool GetTexture2D(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture, D3D11_TEXTURE2D_DESC& desc)
+{
+	if (!srv)
+		return false;
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	srv->GetResource(resource.GetAddressOf());
+	if (FAILED(resource.As(&texture)))
+		return false;
+
+	texture->GetDesc(&desc);
+	return desc.ArraySize == 1 && desc.SampleDesc.Count == 1;
+}
+
+// Bytes in one mip level, for the formats textures are loaded as
+static size_t GetLevelBytes(DXGI_FORMAT format, unsigned int width, unsigned int height)
+{
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	switch (format)
+	{
+		case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC4_UNORM: case DXGI_FORMAT_BC4_SNORM:
+			return blocks * 8;
+		case DXGI_FORMAT_BC2_UNORM: case DXGI_FORMAT_BC2_UNORM_SRGB:
+		case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC5_UNORM: case DXGI_FORMAT_BC5_SNORM:
+		case DXGI_FORMAT_BC7_UNORM: case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return blocks * 16;
+		default:
+			return (size_t)width * height * 4;
+	}
+}
+
+/// <summary>
+/// Creates an empty table
+/// </summary>
+/// <param name="_slots">Texture names to pack into arrays, ex: "AlbedoTexture"</param>
+MaterialTable::MaterialTable(
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	std::vector<std::string> _slots)
+	:
+	device(_device),
+	context(_context),
+	slots(_slots),
+	arrayBytes(0),
+	built(false)
+{
+}
+
+/// <summary>
+/// Adds a material. Only takes effect if the table hasn't been built yet.
+/// </summary>
+void MaterialTable::Add(std::shared_ptr<Material> material)
+{
+	if (built || indices.find(material.get()) != indices.end())
+		return;
+
+	indices[material.get()] = -1;
+	materials.push_back(material);
+}
+
+/// <summary>
+/// Groups the materials and copies their textures into arrays. Waits
+/// for textures that are still loading, so call it until it succeeds.
+/// Materials missing a slot's texture are left out (GetIndex() is -1).
+/// </summary>
+/// <returns>True once the table is built</returns>
+bool MaterialTable::Build()
+{
+	if (built)
+		return true;
+
+	// Anything still loading would be copied as its placeholder
+	for (std::shared_ptr<Material>& material : materials)
+	{
+		for (const std::string& slot : slots)
+		{
+			std::shared_ptr<Texture> texture = material->GetTexture(slot);
+			if (texture && texture->GetState() == TextureState::Loading)
+				return false;
+		}
+	}
+
+	// Materials with identical textures share a slice, and slices of
+	// the same size, mip count and format share a group
+	std::map<std::vector<Texture*>, std::pair<unsigned int, unsigned int>> sliceLookup;
+	std::map<std::vector<unsigned int>, unsigned int> groupLookup;
+	std::vector<std::vector<std::vector<std::shared_ptr<Texture>>>> groupSlices;
+
+	materialGroups.assign(materials.size(), 0);
+	materialSlices.assign(materials.size(), 0);
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		std::vector<std::shared_ptr<Texture>> textures;
+		std::vector<Texture*> key;
+		std::vector<unsigned int> signature;
+		for (const std::string& slot : slots)
+		{
+			std::shared_ptr<Texture> texture = materials[i]->GetTexture(slot);
+			Microsoft::WRL::ComPtr<ID3D11Texture2D> resource;
+			D3D11_TEXTURE2D_DESC desc;
+			if (!texture || !GetTexture2D(texture->GetSRV(), resource, desc))
+				break;
+
+			textures.push_back(texture);
+			key.push_back(texture.get());
+			signature.insert(signature.end(), { desc.Width, desc.Height, desc.MipLevels, (unsigned int)desc.Format });
+		}
+
+		if (textures.size() != slots.size())
+			continue;
+
+		std::map<std::vector<Texture*>, std::pair<unsigned int, unsigned int>>::iterator slice = sliceLookup.find(key);
+		if (slice == sliceLookup.end())
+		{
+			std::map<std::vector<unsigned int>, unsigned int>::iterator group = groupLookup.find(signature);
+			if (group == groupLookup.end())
+			{
+				group = groupLookup.insert({ signature, (unsigned int)groups.size() }).first;
+				groups.push_back(MaterialGroup());
+				groupSlices.push_back({});
+			}
+
+			std::vector<std::vector<std::shared_ptr<Texture>>>& slices = groupSlices[group->second];
+			slice = sliceLookup.insert({ key, { group->second, (unsigned int)slices.size() } }).first;
+			slices.push_back(textures);
+		}
+
+		indices[materials[i].get()] = (int)i;
+		materialGroups[i] = slice->second.first;
+		materialSlices[i] = slice->second.second;
+	}
+
+	for (size_t g = 0; g < groups.size(); g++)
+	{
+		if (CreateArrays(groups[g], groupSlices[g]))
+			continue;
+
+		// Those materials stay on the regular path
+		for (size_t i = 0; i < materials.size(); i++)
+			if (materialGroups[i] == g)
+				indices[materials[i].get()] = -1;
+	}
+
+	// Every material gets an entry, batched or not, so indices match the list
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = (UINT)(sizeof(MaterialParams) * (std::max)((size_t)1, materials.size()));
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = sizeof(MaterialParams);
+	device->CreateBuffer(&desc, 0, paramsBuffer.GetAddressOf());
+	if (paramsBuffer)
+		device->CreateShaderResourceView(paramsBuffer.Get(), 0, paramsSRV.GetAddressOf());
+
+	built = true;
+	UpdateParams();
+	return true;
+}
+
+/// <summary>
+/// Copies every material's current parameters to the GPU, so
+/// changes like SetColorTint() show up in batched draws
+/// </summary>
+void MaterialTable::UpdateParams()
+{
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (!built || !paramsBuffer || FAILED(context->Map(paramsBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+
+	MaterialParams* params = (MaterialParams*)mapped.pData;
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		params[i] = {};
+		params[i].ColorTint = materials[i]->GetColorTint();
+		params[i].Roughness = materials[i]->GetRoughness();
+		params[i].UvScale = materials[i]->GetUvScale();
+		params[i].UvOffset = materials[i]->GetUvOffset();
+		params[i].Slice = materialSlices[i];
+	}
+	context->Unmap(paramsBuffer.Get(), 0);
+}
+
+/// <summary>
+/// Binds one group's texture arrays and the material buffer
+/// </summary>
+void MaterialTable::Bind(std::shared_ptr<SimplePixelShader> pixelShader, unsigned int group)
+{
+	for (size_t i = 0; i < slots.size(); i++)
+		pixelShader->SetShaderResourceView(slots[i] + "Array", groups[group].Arrays[i]);
+	pixelShader->SetShaderResourceView("Materials", paramsSRV);
+}
+
+// Getters
+bool MaterialTable::IsBuilt() { return built; }
+unsigned int MaterialTable::GetGroup(unsigned int materialIndex) { return materialGroups[materialIndex]; }
+unsigned int MaterialTable::GetGroupCount() { return (unsigned int)groups.size(); }
+unsigned int MaterialTable::GetMaterialCount() { return (unsigned int)materials.size(); }
+size_t MaterialTable::GetArrayBytes() { return arrayBytes; }
+
+/// <summary>
+/// Finds a material's index in the material buffer
+/// </summary>
+/// <returns>The index, or -1 if the material isn't batched</returns>
+int MaterialTable::GetIndex(Material* material)
+{
+	std::unordered_map<Material*, int>::iterator found = indices.find(material);
+	return built && found != indices.end() ? found->second : -1;
+}
+
+/// <summary>
+/// Creates one texture array per slot and copies every slice's
+/// texture (all mips) into it
+/// </summary>
+/// <returns>False if a texture or view can't be created</returns>
+bool MaterialTable::CreateArrays(MaterialGroup& group, const std::vector<std::vector<std::shared_ptr<Texture>>>& slices)
+{
+	group.SliceCount = (unsigned int)slices.size();
+	group.Arrays.resize(slots.size());
+	for (size_t s = 0; s < slots.size(); s++)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> source;
+		D3D11_TEXTURE2D_DESC desc;
+		if (!GetTexture2D(slices[0][s]->GetSRV(), source, desc))
+			return false;
+
+		group.Width = desc.Width;
+		group.Height = desc.Height;
+
+		// Only ever read from, so none of the source's render target flags
+		desc.ArraySize = group.SliceCount;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = 0;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> textureArray;
+		if (FAILED(device->CreateTexture2D(&desc, 0, textureArray.GetAddressOf())))
+			return false;
+
+		for (unsigned int slice = 0; slice < group.SliceCount; slice++)
+		{
+			D3D11_TEXTURE2D_DESC sliceDesc;
+			if (!GetTexture2D(slices[slice][s]->GetSRV(), source, sliceDesc))
+				return false;
+
+			for (unsigned int mip = 0; mip < desc.MipLevels; mip++)
+			{
+				context->CopySubresourceRegion(
+					textureArray.Get(), D3D11CalcSubresource(mip, slice, desc.MipLevels), 0, 0, 0,
+					source.Get(), D3D11CalcSubresource(mip, 0, desc.MipLevels), 0);
+				arrayBytes += GetLevelBytes(desc.Format, (std::max)(1u, desc.Width >> mip), (std::max)(1u, desc.Height >> mip));
+			}
+		}
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = desc.Format;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+		srvDesc.Texture2DArray.ArraySize = group.SliceCount;
+		if (FAILED(device->CreateShaderResourceView(textureArray.Get(), &srvDesc, group.Arrays[s].GetAddressOf())))
+			return false;
+	}
+	return true;
+}
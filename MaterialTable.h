@@ -0,0 +1,84 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <wrl/client.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Material.h"
+#include "SimpleShader.h"
+
+// One material in the GPU-side material buffer (must match MaterialParams in PixelShader.hlsl)
+struct MaterialParams
+{
+	DirectX::XMFLOAT4 ColorTint;
+	float Roughness;
+	float UvScale;
+	DirectX::XMFLOAT2 UvOffset;
+	unsigned int Slice;			// Layer of its group's texture arrays
+	unsigned int Padding[3];
+};
+
+// Materials whose textures match in size, mip count and format. Each
+// slot's textures become one Texture2DArray, so the whole group is a
+// single set of bindings.
+struct MaterialGroup
+{
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> Arrays;	// One per slot
+	unsigned int SliceCount = 0;
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+};
+
+// --------------------------------------------------------
+// Turns materials into indices. Their textures are copied
+// into texture arrays (one set per MaterialGroup) and their
+// parameters into a structured buffer, so entities with
+// different materials can share one instanced draw.
+//
+// Slots are the texture names materials use, ex. "NormalMap";
+// the shader's array for a slot is the same name + "Array".
+// Materials sharing the same textures share a slice.
+// --------------------------------------------------------
+class MaterialTable
+{
+	public:
+		MaterialTable(
+			Microsoft::WRL::ComPtr<ID3D11Device> _device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+			std::vector<std::string> _slots);
+
+		void Add(std::shared_ptr<Material> material);
+		bool Build();
+		void UpdateParams();
+		void Bind(std::shared_ptr<SimplePixelShader> pixelShader, unsigned int group);
+
+		// Getters
+		bool IsBuilt();
+		int GetIndex(Material* material);
+		unsigned int GetGroup(unsigned int materialIndex);
+		unsigned int GetGroupCount();
+		unsigned int GetMaterialCount();
+		size_t GetArrayBytes();
+
+	private:
+		bool CreateArrays(MaterialGroup& group, const std::vector<std::vector<std::shared_ptr<Texture>>>& slices);
+
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		std::vector<std::string> slots;
+
+		std::vector<std::shared_ptr<Material>> materials;
+		std::unordered_map<Material*, int> indices;	// -1 for materials that can't be batched
+		std::vector<unsigned int> materialGroups;
+		std::vector<unsigned int> materialSlices;
+		std::vector<MaterialGroup> groups;
+		size_t arrayBytes;
+		bool built;
+
+		Microsoft::WRL::ComPtr<ID3D11Buffer> paramsBuffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paramsSRV;
+};
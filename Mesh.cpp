@@ -1,5 +1,9 @@
 #include "Mesh.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
+#include <math.h>
 #include <DirectXMath.h>
 #include <vector>
 
@@ -12,53 +16,23 @@
 /// <param name="_numIndices">The number of indices in drawing the mesh</param>
 /// <param name="_device">A reference to the device object</param>
 /// <param name="_context">A reference to the context object</param>
-Mesh::Mesh(Vertex* _vertices, int _numVertices, unsigned int* _indices, int _numIndices, Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context)
+/// <param name="_splitPositions">Whether positions get a buffer of their own, for depth-only passes</param>
+/// <param name="_queue">Workers to simplify the levels of detail on, or null to do it on this thread</param>
+Mesh::Mesh(Vertex* _vertices, int _numVertices, unsigned int* _indices, int _numIndices, Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, bool _splitPositions, JobQueue* _queue)
 {
 	// Connect appropriate fields
-	numIndices = _numIndices;
 	context = _context;
+	splitPositions = _splitPositions;
 
-	// Calculates Tangents
-	CalculateTangents(_vertices, _numVertices, _indices, numIndices);
-
-	// Sets Up The Vertex Buffer
-	// Creates the Vertex Buffer Description
-	D3D11_BUFFER_DESC vbd = {};
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * _numVertices;
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbd.CPUAccessFlags = 0;
-	vbd.MiscFlags = 0;
-	vbd.StructureByteStride = 0;
-
-	// Create struct to hold vertex data
-	D3D11_SUBRESOURCE_DATA initialVertexData = {};
-	initialVertexData.pSysMem = _vertices;
-
-	// Create the Vertex Buffer with the appropriate data
-	_device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
-
-	// Sets up the Index Buffer
-	// Creates the Index Buffer Description
-	D3D11_BUFFER_DESC ibd = {};
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(unsigned int) * numIndices;
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibd.CPUAccessFlags = 0;
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
-
-	// Create struct to hold index data
-	D3D11_SUBRESOURCE_DATA initialIndexData = {};
-	initialIndexData.pSysMem = _indices;
-
-	// Create the Index Buffer with the appropriate data
-	_device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+	CreateBuffers(_vertices, _numVertices, _indices, _numIndices, _device, _queue);
 }
 
 
-Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> _device)
+Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> _device, bool _splitPositions, JobQueue* _queue)
 {
+	splitPositions = _splitPositions;
+	name = std::filesystem::path(objFile).stem().string();
+
 	// Author: Chris Cascioli
 	// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
 	// File input object
@@ -242,32 +216,81 @@ Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> _device)
 	// Close the file and create the actual buffers
 	obj.close();
 
-	// Calculate Tangents
-	CalculateTangents(verts.data(), vertCounter, indices.data(), indexCounter);
+	CreateBuffers(verts.data(), vertCounter, indices.data(), indexCounter, _device, _queue);
 
-	// Sets Up The Vertex Buffer
-	// Creates the Vertex Buffer Description
-	D3D11_BUFFER_DESC vbd = {};
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * vertCounter;
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbd.CPUAccessFlags = 0;
-	vbd.MiscFlags = 0;
-	vbd.StructureByteStride = 0;
 
-	// Create struct to hold vertex data
-	D3D11_SUBRESOURCE_DATA initialVertexData = {};
-	initialVertexData.pSysMem = &verts[0];
+	// - At this point, "verts" is a vector of Vertex structs, and can be used
+	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
+	//
+	// - The vector "indices" is similar. It's a vector of unsigned ints and
+	//    can be used directly for the index buffer: &indices[0] is the address of the first int
+	//
+	// - "vertCounter" is the number of vertices
+	// - "indexCounter" is the number of indices
+	// - Yes, these are effectively the same since OBJs do not index entire vertices!  This means
+	//    an index buffer isn't doing much for us.  We could try to optimize the mesh ourselves
+	//    and detect duplicate vertices, but at that point it would be better to use a more
+	//    sophisticated model loading library like TinyOBJLoader or AssImp (yes, that's its name)
+	//    (CreateBuffers() now welds them, so simplification can find shared edges)
+}
 
-	// Create the Vertex Buffer with the appropriate data
-	_device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
+/// <summary>
+/// Welds the vertices, calculates tangents and bounds, builds the
+/// levels of detail (see MeshSimplifier) and their meshlets (see
+/// Meshlets), and creates the buffers:
+/// one vertex buffer, and every level's indices back to back in
+/// one index buffer
+/// </summary>
+/// <param name="queue">Shared workers for the levels, or null; it's waited on until idle</param>
+void Mesh::CreateBuffers(Vertex* verts, int numVerts, unsigned int* indices, int indexCount, Microsoft::WRL::ComPtr<ID3D11Device> device, JobQueue* queue)
+{
+	static_assert(sizeof(Vertex) == sizeof(SourceVertex), "MeshSimplifier reads Vertex as SourceVertex");
+	std::vector<SourceVertex> welded;
+	std::vector<unsigned int> weldedIndices;
+	MeshSimplifier::Weld(reinterpret_cast<const SourceVertex*>(verts), numVerts, indices, indexCount, welded, weldedIndices);
+	Vertex* weldedVerts = reinterpret_cast<Vertex*>(welded.data());
+	int weldedCount = (int)welded.size();
+	int fullCount = (int)weldedIndices.size();
 
+	// Calculates Tangents
+	CalculateTangents(weldedVerts, weldedCount, weldedIndices.data(), fullCount);
+	CalculateBounds(weldedVerts, weldedCount, weldedIndices.data(), fullCount);
+
+	// Levels are simplified in parallel, one job each
+	std::vector<unsigned int> lodIndices;
+	lodReport = MeshSimplifier::BuildLods(welded.data(), welded.size(), weldedIndices.data(), weldedIndices.size(),
+		LodSettings(), lodIndices, lods, queue);
+	numIndices = lods.empty() ? 0 : (int)lods[0].IndexCount;
+
+	// Each level's triangles get regrouped into meshlets, for cluster culling
+	meshlets.clear();
+	lodMeshletStarts.assign(1, 0);
+	for (const MeshLod& lod : lods)
+	{
+		Meshlets::Build(welded.data(), welded.size(), lodIndices.data(), lod.IndexStart, lod.IndexCount, MeshletSettings(), meshlets);
+		lodMeshletStarts.push_back((unsigned int)meshlets.size());
+	}
+
+	// Kept for the CPU to rasterize as an occluder
+	cpuPositions.resize(welded.size() * 3);
+	for (size_t i = 0; i < welded.size(); i++)
+	{
+		cpuPositions[i * 3 + 0] = welded[i].Position[0];
+		cpuPositions[i * 3 + 1] = welded[i].Position[1];
+		cpuPositions[i * 3 + 2] = welded[i].Position[2];
+	}
+	cpuIndices = lodIndices;
+
+	// Sets Up The Vertex Buffer
+	CreateVertexBuffer(weldedVerts, weldedCount, weldedIndices.data(), fullCount, device);
+	if (lodIndices.empty())
+		return;
 
 	// Sets up the Index Buffer
 	// Creates the Index Buffer Description
 	D3D11_BUFFER_DESC ibd = {};
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(unsigned int) * indexCounter;
+	ibd.ByteWidth = sizeof(unsigned int) * (UINT)lodIndices.size();
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -275,27 +298,10 @@ Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> _device)
 
 	// Create struct to hold index data
 	D3D11_SUBRESOURCE_DATA initialIndexData = {};
-	initialIndexData.pSysMem = &indices[0];
+	initialIndexData.pSysMem = lodIndices.data();
 
 	// Create the Index Buffer with the appropriate data
-	_device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
-
-	numIndices = indexCounter;
-
-
-
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is the number of vertices
-	// - "indexCounter" is the number of indices
-	// - Yes, these are effectively the same since OBJs do not index entire vertices!  This means
-	//    an index buffer isn't doing much for us.  We could try to optimize the mesh ourselves
-	//    and detect duplicate vertices, but at that point it would be better to use a more
-	//    sophisticated model loading library like TinyOBJLoader or AssImp (yes, that's its name)
+	device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
 }
 
 // Deconstructor (Currently empty as all pointers delete themselves)
@@ -304,7 +310,8 @@ Mesh::~Mesh()
 }
 
 /// <summary>
-/// Returns a reference to the mesh's vertex buffer
+/// Returns a reference to the mesh's vertex buffer: whole packed
+/// vertices, or just their attributes if positions are split
 /// </summary>
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
 {
@@ -321,13 +328,292 @@ Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
 }
 
 /// <summary>
-/// Returns the number of indices in the mesh
+/// Returns the number of indices in the full mesh (level of detail 0)
 /// </summary>
 int Mesh::GetIndexCount()
 {
 	return numIndices;
 }
 
+/// <summary>
+/// Returns the center of the mesh's bounding sphere, in model space
+/// </summary>
+DirectX::XMFLOAT3 Mesh::GetBoundsCenter()
+{
+	return boundsCenter;
+}
+
+/// <summary>
+/// Returns the radius of the mesh's bounding sphere, in model space
+/// </summary>
+float Mesh::GetBoundsRadius()
+{
+	return boundsRadius;
+}
+
+/// <summary>
+/// Returns how many UV units span one model space unit of the
+/// mesh's surface, on average (for picking texture mips)
+/// </summary>
+float Mesh::GetUvDensity()
+{
+	return uvDensity;
+}
+
+/// <summary>
+/// Binds the vertex streams and index buffer. Positions are input
+/// slot 0 and the rest of the vertex slot 1 (see SimpleVertexShader);
+/// unsplit vertices bind one buffer to both, at different offsets.
+/// </summary>
+/// <param name="positionsOnly">For depth-only passes, whose shaders read nothing else</param>
+void Mesh::SetBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, bool positionsOnly)
+{
+	ID3D11Buffer* buffers[2] = { vertexBuffer.Get(), vertexBuffer.Get() };
+	UINT strides[2] = { sizeof(PackedVertex), sizeof(PackedVertex) };
+	UINT offsets[2] = { 0, sizeof(PackedPosition) };
+	if (splitPositions)
+	{
+		buffers[0] = positionBuffer.Get();
+		strides[0] = sizeof(PackedPosition);
+		strides[1] = sizeof(PackedAttributes);
+		offsets[1] = 0;
+	}
+
+	deviceContext->IASetVertexBuffers(0, positionsOnly ? 1 : 2, buffers, strides, offsets);
+	deviceContext->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+}
+
+/// <summary>
+/// Returns how many bytes of vertex data a draw fetches per vertex:
+/// a depth-only pass reads just the positions if they're split off
+/// </summary>
+UINT Mesh::GetVertexBytes(bool positionsOnly)
+{
+	return positionsOnly && splitPositions ? sizeof(PackedPosition) : sizeof(PackedVertex);
+}
+
+/// <summary>
+/// Returns whether positions have a buffer of their own
+/// </summary>
+bool Mesh::HasSplitPositions()
+{
+	return splitPositions;
+}
+
+/// <summary>
+/// Returns how the vertex shader turns packed positions back
+/// into model space: unorm * scale + offset
+/// </summary>
+DirectX::XMFLOAT3 Mesh::GetPositionScale()
+{
+	return DirectX::XMFLOAT3(positionDecode.Scale);
+}
+
+DirectX::XMFLOAT3 Mesh::GetPositionOffset()
+{
+	return DirectX::XMFLOAT3(positionDecode.Offset);
+}
+
+/// <summary>
+/// The name of the .obj file the mesh was loaded from
+/// </summary>
+/// <returns>An empty string if it was built from arrays</returns>
+const std::string& Mesh::GetName()
+{
+	return name;
+}
+
+/// <summary>
+/// Returns how much packing the vertices saved, and how far
+/// they moved
+/// </summary>
+VertexPackingReport Mesh::GetPackingReport()
+{
+	return packingReport;
+}
+
+/// <summary>
+/// Returns how many levels of detail the mesh has, including the
+/// full mesh; levels that barely shrank aren't kept
+/// </summary>
+unsigned int Mesh::GetLodCount()
+{
+	return (unsigned int)lods.size();
+}
+
+/// <summary>
+/// Returns a level's range of the index buffer, and its error;
+/// past the last level, the last level
+/// </summary>
+MeshLod Mesh::GetLod(unsigned int level)
+{
+	if (lods.empty())
+		return MeshLod();
+	return lods[(std::min)(level, (unsigned int)lods.size() - 1)];
+}
+
+const std::vector<MeshLod>& Mesh::GetLods()
+{
+	return lods;
+}
+
+/// <summary>
+/// Returns what building the levels of detail cost
+/// </summary>
+LodReport Mesh::GetLodReport()
+{
+	return lodReport;
+}
+
+/// <summary>
+/// Returns a level's meshlets (past the last level, the last level's),
+/// whose index ranges tile the level's range of the index buffer
+/// </summary>
+const Meshlet* Mesh::GetMeshlets(unsigned int level, unsigned int& count)
+{
+	count = 0;
+	if (lods.empty())
+		return 0;
+	level = (std::min)(level, (unsigned int)lods.size() - 1);
+	count = lodMeshletStarts[level + 1] - lodMeshletStarts[level];
+	return meshlets.data() + lodMeshletStarts[level];
+}
+
+/// <summary>
+/// Returns how many meshlets all levels have together
+/// </summary>
+unsigned int Mesh::GetMeshletCount()
+{
+	return (unsigned int)meshlets.size();
+}
+
+/// <summary>
+/// Returns the welded positions, three floats per vertex, unquantized
+/// </summary>
+const std::vector<float>& Mesh::GetCpuPositions()
+{
+	return cpuPositions;
+}
+
+/// <summary>
+/// Returns every level's indices into GetCpuPositions(), laid out as in
+/// the index buffer (see GetLod())
+/// </summary>
+const std::vector<unsigned int>& Mesh::GetCpuIndices()
+{
+	return cpuIndices;
+}
+
+/// <summary>
+/// Packs the vertices (see VertexPacking) and creates the vertex
+/// buffer from them, or a position buffer and an attribute buffer
+/// if positions are split. Tangents have to be calculated first.
+/// </summary>
+void Mesh::CreateVertexBuffer(Vertex* verts, int numVerts, unsigned int* indices, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	static_assert(sizeof(Vertex) == sizeof(SourceVertex), "VertexPacking reads Vertex as SourceVertex");
+	const SourceVertex* source = reinterpret_cast<const SourceVertex*>(verts);
+	std::vector<PackedVertex> packed(numVerts);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	positionDecode = VertexPacking::Encode(source, numVerts, indices, numIndices, packed.data());
+	packingReport.EncodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	packingReport.Vertices = numVerts;
+	packingReport.SourceBytes = sizeof(Vertex) * numVerts;
+	packingReport.PackedBytes = sizeof(PackedVertex) * numVerts;
+	packingReport.Error = VertexPacking::Measure(source, packed.data(), numVerts, positionDecode);
+
+	// Creates the Vertex Buffer Description
+	D3D11_BUFFER_DESC vbd = {};
+	vbd.Usage = D3D11_USAGE_IMMUTABLE;
+	vbd.ByteWidth = sizeof(PackedVertex) * numVerts;
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbd.CPUAccessFlags = 0;
+	vbd.MiscFlags = 0;
+	vbd.StructureByteStride = 0;
+
+	// Create struct to hold vertex data
+	D3D11_SUBRESOURCE_DATA initialVertexData = {};
+	initialVertexData.pSysMem = packed.data();
+
+	if (!splitPositions)
+	{
+		// Create the Vertex Buffer with the appropriate data
+		device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
+		return;
+	}
+
+	// Same bytes, in two buffers
+	std::vector<PackedPosition> positions(numVerts);
+	std::vector<PackedAttributes> attributes(numVerts);
+	VertexPacking::SplitStreams(packed.data(), numVerts, positions.data(), attributes.data());
+
+	vbd.ByteWidth = sizeof(PackedPosition) * numVerts;
+	initialVertexData.pSysMem = positions.data();
+	device->CreateBuffer(&vbd, &initialVertexData, positionBuffer.GetAddressOf());
+
+	vbd.ByteWidth = sizeof(PackedAttributes) * numVerts;
+	initialVertexData.pSysMem = attributes.data();
+	device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
+}
+
+/// <summary>
+/// Finds a bounding sphere around the vertices (centered on their box),
+/// and the average UV density across the triangles' surface
+/// </summary>
+void Mesh::CalculateBounds(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+{
+	boundsCenter = DirectX::XMFLOAT3(0, 0, 0);
+	boundsRadius = 0.0f;
+	uvDensity = 1.0f;
+	if (numVerts <= 0)
+		return;
+
+	DirectX::XMFLOAT3 min = verts[0].Position;
+	DirectX::XMFLOAT3 max = verts[0].Position;
+	for (int i = 1; i < numVerts; i++)
+	{
+		min.x = (std::min)(min.x, verts[i].Position.x);
+		min.y = (std::min)(min.y, verts[i].Position.y);
+		min.z = (std::min)(min.z, verts[i].Position.z);
+		max.x = (std::max)(max.x, verts[i].Position.x);
+		max.y = (std::max)(max.y, verts[i].Position.y);
+		max.z = (std::max)(max.z, verts[i].Position.z);
+	}
+	boundsCenter = DirectX::XMFLOAT3((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+
+	for (int i = 0; i < numVerts; i++)
+	{
+		float dx = verts[i].Position.x - boundsCenter.x;
+		float dy = verts[i].Position.y - boundsCenter.y;
+		float dz = verts[i].Position.z - boundsCenter.z;
+		boundsRadius = (std::max)(boundsRadius, sqrtf(dx * dx + dy * dy + dz * dz));
+	}
+
+	// Ratio of the total UV area to the total surface area, as a length
+	double worldArea = 0.0;
+	double uvArea = 0.0;
+	for (int i = 0; i + 2 < numIndices; i += 3)
+	{
+		const Vertex& v1 = verts[indices[i]];
+		const Vertex& v2 = verts[indices[i + 1]];
+		const Vertex& v3 = verts[indices[i + 2]];
+
+		float ax = v2.Position.x - v1.Position.x, ay = v2.Position.y - v1.Position.y, az = v2.Position.z - v1.Position.z;
+		float bx = v3.Position.x - v1.Position.x, by = v3.Position.y - v1.Position.y, bz = v3.Position.z - v1.Position.z;
+		float cx = ay * bz - az * by;
+		float cy = az * bx - ax * bz;
+		float cz = ax * by - ay * bx;
+		worldArea += 0.5 * sqrt(cx * cx + cy * cy + cz * cz);
+
+		float s1 = v2.UV.x - v1.UV.x, t1 = v2.UV.y - v1.UV.y;
+		float s2 = v3.UV.x - v1.UV.x, t2 = v3.UV.y - v1.UV.y;
+		uvArea += 0.5 * fabs(s1 * t2 - s2 * t1);
+	}
+	if (worldArea > 0.0 && uvArea > 0.0)
+		uvDensity = (float)sqrt(uvArea / worldArea);
+}
+
 // --------------------------------------------------------
 // Author: Chris Cascioli
 // Purpose: Calculates the tangents of the vertices in a mesh
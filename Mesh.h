@@ -1,21 +1,45 @@
 #pragma once
 
 #include "Vertex.h"
+#include "VertexPacking.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "JobQueue.h"
 #include <d3d11.h>
+#include <DirectXMath.h>
 #include <wrl/client.h>
+#include <string>
+#include <vector>
 
 // Purpose is create and store the buffers for objects to be drawn to the screen
 class Mesh
 {
 	private:
 		// Fields
-		Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;		// Attributes, or whole vertices if positions aren't split
+		Microsoft::WRL::ComPtr<ID3D11Buffer> positionBuffer;	// Positions alone, if they're split
 		Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		std::string name;		// The .obj file's name, empty if built from arrays
 		int numIndices;
+		DirectX::XMFLOAT3 boundsCenter;
+		float boundsRadius;
+		float uvDensity;
+		PositionDecode positionDecode;
+		VertexPackingReport packingReport;
+		bool splitPositions;
+		std::vector<MeshLod> lods;		// Level 0 is the full mesh; all share the vertex buffer
+		LodReport lodReport;
+		std::vector<Meshlet> meshlets;			// Every level's, in level order
+		std::vector<unsigned int> lodMeshletStarts;	// Per level, its first meshlet; one more at the end
+		std::vector<float> cpuPositions;		// Welded positions, three floats each, for the CPU (occlusion culling)
+		std::vector<unsigned int> cpuIndices;	// Every level's indices, as in the index buffer
 
 		// Methods
+		void CreateBuffers(Vertex* verts, int numVerts, unsigned int* indices, int indexCount, Microsoft::WRL::ComPtr<ID3D11Device> device, JobQueue* queue);
 		void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+		void CalculateBounds(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+		void CreateVertexBuffer(Vertex* verts, int numVerts, unsigned int* indices, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
 
 	public:
 		// Constructors
@@ -25,12 +49,32 @@ class Mesh
 			unsigned int* _indices,
 			int _numIndicies,
 			Microsoft::WRL::ComPtr<ID3D11Device> _device,
-			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context);
-		Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> _device);
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+			bool _splitPositions = true,
+			JobQueue* _queue = 0);
+		Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> _device, bool _splitPositions = true, JobQueue* _queue = 0);
 		~Mesh(); // Deconstructor
 
 		// Functions
 		Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 		Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 		int GetIndexCount();
+		void SetBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, bool positionsOnly);
+		DirectX::XMFLOAT3 GetBoundsCenter();
+		float GetBoundsRadius();
+		float GetUvDensity();
+		UINT GetVertexBytes(bool positionsOnly);
+		bool HasSplitPositions();
+		DirectX::XMFLOAT3 GetPositionScale();
+		DirectX::XMFLOAT3 GetPositionOffset();
+		const std::string& GetName();
+		VertexPackingReport GetPackingReport();
+		unsigned int GetLodCount();
+		MeshLod GetLod(unsigned int level);
+		const std::vector<MeshLod>& GetLods();
+		LodReport GetLodReport();
+		const Meshlet* GetMeshlets(unsigned int level, unsigned int& count);
+		unsigned int GetMeshletCount();
+		const std::vector<float>& GetCpuPositions();
+		const std::vector<unsigned int>& GetCpuIndices();
 };
\ No newline at end of file
@@ -0,0 +1,926 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <queue>
+#include <string.h>
+#include <unordered_map>
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+// Up to eight floats' bits, for welding. Adding zero turns -0 into 0,
+// so the two weld.
+struct WeldKey
+{
+	unsigned int Bits[8];
+
+	WeldKey(const float* values, int count)
+	{
+		memset(Bits, 0, sizeof(Bits));
+		for (int i = 0; i < count; i++)
+		{
+			float value = values[i] + 0.0f;
+			memcpy(&Bits[i], &value, sizeof(float));
+		}
+	}
+
+	bool operator==(const WeldKey& other) const { return memcmp(Bits, other.Bits, sizeof(Bits)) == 0; }
+};
+
+struct WeldKeyHash
+{
+	size_t operator()(const WeldKey& key) const
+	{
+		// FNV-1a
+		size_t hash = 2166136261u;
+		for (unsigned int bits : key.Bits)
+			hash = (hash ^ bits) * 16777619u;
+		return hash;
+	}
+};
+
+static void Subtract(const double a[3], const double b[3], double result[3])
+{
+	result[0] = a[0] - b[0];
+	result[1] = a[1] - b[1];
+	result[2] = a[2] - b[2];
+}
+
+static double Dot(const double a[3], const double b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Cross(const double a[3], const double b[3], double result[3])
+{
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Ericson, Real-Time Collision Detection, 5.1.5
+static double DistanceToTriangle(const double p[3], const double a[3], const double b[3], const double c[3])
+{
+	double ab[3], ac[3], ap[3], bp[3], cp[3];
+	Subtract(b, a, ab);
+	Subtract(c, a, ac);
+	Subtract(p, a, ap);
+	Subtract(p, b, bp);
+	Subtract(p, c, cp);
+
+	double s = 0.0, t = 0.0;
+	double d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+	double d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+	double d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+	double va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+	if (d1 <= 0.0 && d2 <= 0.0)
+		s = t = 0.0;
+	else if (d3 >= 0.0 && d4 <= d3)
+		s = 1.0;
+	else if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+		s = d1 / (d1 - d3);
+	else if (d6 >= 0.0 && d5 <= d6)
+		t = 1.0;
+	else if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+		t = d2 / (d2 - d6);
+	else if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+	{
+		t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		s = 1.0 - t;
+	}
+	else
+	{
+		s = vb / (va + vb + vc);
+		t = vc / (va + vb + vc);
+	}
+
+	double d[3];
+	for (int i = 0; i < 3; i++)
+		d[i] = a[i] + ab[i] * s + ac[i] * t - p[i];
+	return sqrt(Dot(d, d));
+}
+
+// Sum of squared distances to a set of planes, weighted by the area
+// they came from: the upper triangle of a symmetric 4x4 matrix,
+// a2 ab ac ad b2 bc bd c2 cd d2
+struct Quadric
+{
+	double Q[10] = {};
+	double Weight = 0.0;
+
+	void AddPlane(const double n[3], double d, double weight)
+	{
+		const double p[4] = { n[0], n[1], n[2], d };
+		int i = 0;
+		for (int r = 0; r < 4; r++)
+			for (int c = r; c < 4; c++)
+				Q[i++] += p[r] * p[c] * weight;
+		Weight += weight;
+	}
+
+	void Add(const Quadric& other)
+	{
+		for (int i = 0; i < 10; i++)
+			Q[i] += other.Q[i];
+		Weight += other.Weight;
+	}
+
+	// Mean squared distance from the planes
+	double Evaluate(const double p[3]) const
+	{
+		if (Weight <= 0.0)
+			return 0.0;
+		double x = p[0], y = p[1], z = p[2];
+		double sum =
+			Q[0] * x * x + 2.0 * Q[1] * x * y + 2.0 * Q[2] * x * z + 2.0 * Q[3] * x +
+			Q[4] * y * y + 2.0 * Q[5] * y * z + 2.0 * Q[6] * y +
+			Q[7] * z * z + 2.0 * Q[8] * z +
+			Q[9];
+		return (std::max)(0.0, sum / Weight);
+	}
+};
+
+// Moving one position vertex onto a neighbor, and what it costs
+struct Collapse
+{
+	double Cost = 0.0;
+	double PositionError = 0.0;		// Squared, relative to the bounding radius
+	unsigned int From = 0;
+	unsigned int To = 0;
+	unsigned int Sides = 1;			// Two for a vertex on a seam, sliding along it
+	unsigned int FromVertex[2] = {};	// Each side's vertex at From, and the one at To that replaces it
+	unsigned int ToVertex[2] = {};
+	unsigned int Version = 0;		// Of From, when this was costed
+};
+
+// A collapse waiting its turn; the rest is worked out again when it's popped
+struct QueuedCollapse
+{
+	double Cost;
+	unsigned int From;
+	unsigned int To;
+	unsigned int Version;
+
+	QueuedCollapse(const Collapse& collapse) : Cost(collapse.Cost), From(collapse.From), To(collapse.To), Version(collapse.Version) {}
+};
+
+// Cheapest first; ties go to the lower vertex, so results don't depend on heap order
+struct CollapseOrder
+{
+	bool operator()(const QueuedCollapse& a, const QueuedCollapse& b) const
+	{
+		if (a.Cost != b.Cost)
+			return a.Cost > b.Cost;
+		return a.From > b.From;
+	}
+};
+
+// A mesh being simplified. Vertices (with attributes) group into
+// position vertices; collapses move position vertices onto their
+// neighbors. Ones with a single vertex, inside the surface, move
+// anywhere; ones on a seam or hard edge (two vertices, on either
+// side) only slide along it. The rest never move.
+struct CollapseMesh
+{
+	const SourceVertex* Vertices;
+	const LodSettings* Settings;
+
+	std::vector<unsigned int> PositionOf;		// Per vertex
+	std::vector<double> Points;					// Per position vertex, relative to the bounding sphere
+	std::vector<unsigned char> Locked;
+	std::vector<unsigned char> Seam;
+	std::vector<unsigned char> Removed;
+	std::vector<unsigned int> MovedTo;			// Per removed position vertex, the one it collapsed onto
+	std::vector<unsigned int> Versions;
+	std::vector<Quadric> Quadrics;
+	std::vector<std::vector<unsigned int>> Around;	// Per position vertex, its triangles; dead ones get dropped lazily
+
+	std::vector<unsigned int> Triangles;		// Vertex indices, 3 per triangle
+	std::vector<unsigned int> Corners;			// Their position vertices
+	std::vector<unsigned char> Alive;
+	size_t AliveCount = 0;
+
+	// The vertex being costed: its live triangles and neighbors
+	std::vector<unsigned int> ring;
+	std::vector<unsigned int> neighbors;
+	std::vector<unsigned int> otherNeighbors;
+
+	bool Contains(unsigned int triangle, unsigned int position) const
+	{
+		const unsigned int* corners = &Corners[triangle * 3];
+		return corners[0] == position || corners[1] == position || corners[2] == position;
+	}
+
+	// The vertex a triangle has at a position vertex it contains
+	unsigned int VertexAt(unsigned int triangle, unsigned int position) const
+	{
+		for (int c = 0; c < 2; c++)
+			if (Corners[triangle * 3 + c] == position)
+				return Triangles[triangle * 3 + c];
+		return Triangles[triangle * 3 + 2];
+	}
+
+	// Drops a position vertex's dead triangles, returning the rest
+	const std::vector<unsigned int>& LiveAround(unsigned int position)
+	{
+		std::vector<unsigned int>& triangles = Around[position];
+		size_t kept = 0;
+		for (unsigned int triangle : triangles)
+			if (Alive[triangle])
+				triangles[kept++] = triangle;
+		triangles.resize(kept);
+		return triangles;
+	}
+
+	void FindNeighbors(const std::vector<unsigned int>& triangles, unsigned int position, std::vector<unsigned int>& found)
+	{
+		found.clear();
+		for (unsigned int triangle : triangles)
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int corner = Corners[triangle * 3 + c];
+				if (corner != position && std::find(found.begin(), found.end(), corner) == found.end())
+					found.push_back(corner);
+			}
+	}
+
+	// Gathers what costing a vertex's collapses needs; false if it can't move
+	bool Prepare(unsigned int from)
+	{
+		if (Locked[from] || Removed[from])
+			return false;
+		ring = LiveAround(from);
+		FindNeighbors(ring, from, neighbors);
+		return true;
+	}
+
+	// Normal and UV error of dropping a vertex, against the triangles
+	// on its side that will cover it: the one its position projects
+	// furthest inside
+	double AttributeError(const Collapse& collapse, unsigned int side)
+	{
+		const SourceVertex& removed = Vertices[collapse.FromVertex[side]];
+		const double* p = &Points[collapse.From * 3];
+		double bestInside = -DBL_MAX;
+		double bestWeights[3] = {};
+		unsigned int bestVertices[3] = {};
+
+		for (unsigned int triangle : ring)
+		{
+			if (Contains(triangle, collapse.To) || VertexAt(triangle, collapse.From) != collapse.FromVertex[side])
+				continue;
+
+			unsigned int vertices[3];
+			const double* corners[3];
+			for (int c = 0; c < 3; c++)
+			{
+				bool moved = Corners[triangle * 3 + c] == collapse.From;
+				vertices[c] = moved ? collapse.ToVertex[side] : Triangles[triangle * 3 + c];
+				corners[c] = &Points[(moved ? collapse.To : Corners[triangle * 3 + c]) * 3];
+			}
+
+			// Barycentrics of the point projected onto the triangle
+			double e1[3], e2[3], d[3];
+			Subtract(corners[1], corners[0], e1);
+			Subtract(corners[2], corners[0], e2);
+			Subtract(p, corners[0], d);
+			double d11 = Dot(e1, e1), d12 = Dot(e1, e2), d22 = Dot(e2, e2);
+			double d1 = Dot(d, e1), d2 = Dot(d, e2);
+			double denominator = d11 * d22 - d12 * d12;
+			if (denominator <= 0.0)
+				continue;
+			double w1 = (d22 * d1 - d12 * d2) / denominator;
+			double w2 = (d11 * d2 - d12 * d1) / denominator;
+			double weights[3] = { 1.0 - w1 - w2, w1, w2 };
+
+			double inside = (std::min)(weights[0], (std::min)(weights[1], weights[2]));
+			if (inside > bestInside)
+			{
+				bestInside = inside;
+				for (int c = 0; c < 3; c++)
+				{
+					bestWeights[c] = weights[c];
+					bestVertices[c] = vertices[c];
+				}
+			}
+		}
+
+		// Clamped onto the triangle
+		double total = 0.0;
+		for (int c = 0; c < 3; c++)
+		{
+			bestWeights[c] = (std::max)(0.0, bestWeights[c]);
+			total += bestWeights[c];
+		}
+		if (total <= 0.0)
+			return 0.0;
+
+		double normalError = 0.0;
+		for (int i = 0; i < 3; i++)
+		{
+			double value = 0.0;
+			for (int c = 0; c < 3; c++)
+				value += Vertices[bestVertices[c]].Normal[i] * bestWeights[c] / total;
+			normalError += (value - removed.Normal[i]) * (value - removed.Normal[i]);
+		}
+
+		double uvError = 0.0;
+		for (int i = 0; i < 2; i++)
+		{
+			double value = 0.0;
+			for (int c = 0; c < 3; c++)
+				value += Vertices[bestVertices[c]].UV[i] * bestWeights[c] / total;
+			uvError += (value - removed.UV[i]) * (value - removed.UV[i]);
+		}
+
+		return Settings->NormalWeight * normalError + Settings->UvWeight * uvError;
+	}
+
+	// Costs collapsing the prepared vertex onto one neighbor; false if
+	// that would tear or merge a seam or move the surface further than
+	// MaxError (or the bound: the cheapest collapse found so far), or
+	// (when validating) leave the surface non-manifold or flip a
+	// triangle. Validating is most of the work, and only the cheapest
+	// collapse needs it, so the heap holds unvalidated ones.
+	bool EvaluateEdge(unsigned int from, unsigned int to, Collapse& result, bool validate, double bound)
+	{
+		// Exactly two triangles on the edge. Inside a surface they share
+		// both ends' vertices; along a seam, neither.
+		unsigned int shared = 0;
+		unsigned int fromVertices[2] = {}, toVertices[2] = {};
+		for (unsigned int triangle : ring)
+			if (Contains(triangle, to))
+			{
+				if (shared == 2)
+					return false;
+				fromVertices[shared] = VertexAt(triangle, from);
+				toVertices[shared] = VertexAt(triangle, to);
+				shared++;
+			}
+		if (shared != 2)
+			return false;
+
+		result.From = from;
+		result.To = to;
+		result.Version = Versions[from];
+		result.FromVertex[0] = fromVertices[0];
+		result.ToVertex[0] = toVertices[0];
+		if (Seam[from])
+		{
+			if (fromVertices[0] == fromVertices[1] || toVertices[0] == toVertices[1])
+				return false;
+			result.Sides = 2;
+			result.FromVertex[1] = fromVertices[1];
+			result.ToVertex[1] = toVertices[1];
+		}
+		else
+		{
+			if (toVertices[0] != toVertices[1])
+				return false;
+			result.Sides = 1;
+		}
+
+		double positionError = Quadrics[from].Evaluate(&Points[to * 3]);
+		if (positionError > (double)Settings->MaxError * Settings->MaxError || positionError > bound)
+			return false;
+
+		result.PositionError = positionError;
+		result.Cost = positionError;
+		for (unsigned int side = 0; side < result.Sides; side++)
+			result.Cost += AttributeError(result, side);
+		if (!validate)
+			return true;
+
+		// Link condition: the only neighbors the two share are the
+		// edge's two triangles' third corners
+		FindNeighbors(LiveAround(to), to, otherNeighbors);
+		unsigned int common = 0;
+		for (unsigned int other : neighbors)
+			if (other != to && std::find(otherNeighbors.begin(), otherNeighbors.end(), other) != otherNeighbors.end())
+				common++;
+		if (common != 2)
+			return false;
+
+		// No triangle left behind may turn over (or vanish)
+		for (unsigned int triangle : ring)
+		{
+			if (Contains(triangle, to))
+				continue;
+
+			const double* before[3];
+			const double* after[3];
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int corner = Corners[triangle * 3 + c];
+				before[c] = &Points[corner * 3];
+				after[c] = corner == from ? &Points[to * 3] : before[c];
+			}
+			double e1[3], e2[3], oldNormal[3], newNormal[3];
+			Subtract(before[1], before[0], e1);
+			Subtract(before[2], before[0], e2);
+			Cross(e1, e2, oldNormal);
+			Subtract(after[1], after[0], e1);
+			Subtract(after[2], after[0], e2);
+			Cross(e1, e2, newNormal);
+			if (Dot(oldNormal, newNormal) <= 0.0)
+				return false;
+		}
+		return true;
+	}
+
+	// Finds the cheapest collapse of a position vertex
+	bool Evaluate(unsigned int from, Collapse& best, bool validate)
+	{
+		if (!Prepare(from))
+			return false;
+
+		bool found = false;
+		for (unsigned int to : neighbors)
+		{
+			Collapse collapse;
+			if (EvaluateEdge(from, to, collapse, validate, found ? best.Cost : DBL_MAX) && (!found || collapse.Cost < best.Cost || (collapse.Cost == best.Cost && to < best.To)))
+			{
+				best = collapse;
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	// Moves the position vertex onto its neighbor: the edge's two
+	// triangles go, the rest take the neighbor's vertex on their side
+	void Apply(const Collapse& collapse)
+	{
+		for (unsigned int triangle : LiveAround(collapse.From))
+		{
+			if (Contains(triangle, collapse.To))
+			{
+				Alive[triangle] = 0;
+				AliveCount--;
+				continue;
+			}
+			for (int c = 0; c < 3; c++)
+				if (Corners[triangle * 3 + c] == collapse.From)
+				{
+					unsigned int side = collapse.Sides > 1 && Triangles[triangle * 3 + c] == collapse.FromVertex[1] ? 1 : 0;
+					Triangles[triangle * 3 + c] = collapse.ToVertex[side];
+					Corners[triangle * 3 + c] = collapse.To;
+				}
+			Around[collapse.To].push_back(triangle);
+		}
+		Quadrics[collapse.To].Add(Quadrics[collapse.From]);
+		Removed[collapse.From] = 1;
+		MovedTo[collapse.From] = collapse.To;
+		Around[collapse.From].clear();
+	}
+
+	// How far each removed position is from the surface around where it
+	// ended up (two rings of triangles). The surface's nearest point may
+	// be further out, so this can only overestimate.
+	double MeasureError()
+	{
+		double furthest = 0.0;
+		std::vector<unsigned int> triangles;
+		for (size_t position = 0; position < Removed.size(); position++)
+		{
+			if (!Removed[position])
+				continue;
+			unsigned int kept = MovedTo[position];
+			while (Removed[kept])
+				kept = MovedTo[kept];
+
+			triangles = LiveAround(kept);
+			FindNeighbors(triangles, kept, otherNeighbors);
+			for (unsigned int neighbor : otherNeighbors)
+			{
+				const std::vector<unsigned int>& around = LiveAround(neighbor);
+				triangles.insert(triangles.end(), around.begin(), around.end());
+			}
+
+			double nearest = DBL_MAX;
+			for (unsigned int triangle : triangles)
+			{
+				const unsigned int* corners = &Corners[triangle * 3];
+				nearest = (std::min)(nearest, DistanceToTriangle(&Points[position * 3], &Points[corners[0] * 3], &Points[corners[1] * 3], &Points[corners[2] * 3]));
+			}
+			if (nearest < DBL_MAX)
+				furthest = (std::max)(furthest, nearest);
+		}
+		return furthest;
+	}
+};
+
+/// <summary>
+/// Welds vertices with identical positions, normals and UVs (tangents
+/// are left as they are; compute them afterwards), and drops triangles
+/// that are degenerate or repeat another
+/// </summary>
+void MeshSimplifier::Weld(const SourceVertex* vertices, size_t count, const unsigned int* indices, size_t indexCount,
+	std::vector<SourceVertex>& welded, std::vector<unsigned int>& weldedIndices)
+{
+	welded.clear();
+	weldedIndices.resize(indexCount);
+
+	std::unordered_map<WeldKey, unsigned int, WeldKeyHash> found;
+	found.reserve(count);
+	std::vector<unsigned int> remap(count, 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		// Position, normal and UV are the first eight floats
+		WeldKey key(vertices[i].Position, 8);
+		std::pair<std::unordered_map<WeldKey, unsigned int, WeldKeyHash>::iterator, bool> inserted =
+			found.insert(std::make_pair(key, (unsigned int)welded.size()));
+		if (inserted.second)
+			welded.push_back(vertices[i]);
+		remap[i] = inserted.first->second;
+	}
+
+	for (size_t i = 0; i < indexCount; i++)
+		weldedIndices[i] = remap[indices[i]];
+
+	// Degenerate triangles draw nothing, and repeated ones (some
+	// exporters write double-sided meshes as every face twice, same
+	// winding) draw nothing new; both would make the surface look
+	// non-manifold to Simplify(). Repeats are found rotated so the
+	// smallest index leads, sorted, with the first one kept.
+	size_t triangleCount = indexCount / 3;
+	std::vector<std::array<unsigned int, 4>> sorted(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const unsigned int* corners = &weldedIndices[t * 3];
+		int first = corners[1] < corners[0] ? (corners[2] < corners[1] ? 2 : 1) : (corners[2] < corners[0] ? 2 : 0);
+		sorted[t] = { corners[first], corners[(first + 1) % 3], corners[(first + 2) % 3], (unsigned int)t };
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	std::vector<unsigned char> keep(triangleCount, 0);
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		const std::array<unsigned int, 4>& triangle = sorted[i];
+		bool degenerate = triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0];
+		bool repeat = i > 0 && triangle[0] == sorted[i - 1][0] && triangle[1] == sorted[i - 1][1] && triangle[2] == sorted[i - 1][2];
+		keep[triangle[3]] = !degenerate && !repeat;
+	}
+
+	size_t kept = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+		if (keep[t])
+		{
+			for (int c = 0; c < 3; c++)
+				weldedIndices[kept * 3 + c] = weldedIndices[t * 3 + c];
+			kept++;
+		}
+	weldedIndices.resize(kept * 3);
+}
+
+/// <summary>
+/// Collapses edges, cheapest first, until the triangles fit in
+/// targetIndexCount indices, or nothing can collapse without moving
+/// the surface further than settings.MaxError. Indices in the result
+/// refer to the same vertices.
+/// </summary>
+/// <returns>How far the full mesh's vertices are from the result, at most, relative to the bounding radius</returns>
+float MeshSimplifier::Simplify(const SourceVertex* vertices, size_t count, const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount, const LodSettings& settings, std::vector<unsigned int>& result)
+{
+	result.assign(indices, indices + (indexCount / 3) * 3);
+	if (count == 0 || result.size() <= targetIndexCount)
+		return 0.0f;
+
+	CollapseMesh mesh;
+	mesh.Vertices = vertices;
+	mesh.Settings = &settings;
+
+	// Group vertices by position
+	std::unordered_map<WeldKey, unsigned int, WeldKeyHash> found;
+	found.reserve(count);
+	std::vector<unsigned int> firstVertex;
+	mesh.PositionOf.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		std::pair<std::unordered_map<WeldKey, unsigned int, WeldKeyHash>::iterator, bool> inserted =
+			found.insert(std::make_pair(WeldKey(vertices[i].Position, 3), (unsigned int)firstVertex.size()));
+		if (inserted.second)
+			firstVertex.push_back((unsigned int)i);
+		mesh.PositionOf[i] = inserted.first->second;
+	}
+	size_t positionCount = firstVertex.size();
+
+	// Relative to the bounding sphere, so errors are too
+	float min[3], max[3];
+	for (int c = 0; c < 3; c++)
+		min[c] = max[c] = vertices[0].Position[c];
+	for (size_t i = 1; i < count; i++)
+		for (int c = 0; c < 3; c++)
+		{
+			min[c] = (std::min)(min[c], vertices[i].Position[c]);
+			max[c] = (std::max)(max[c], vertices[i].Position[c]);
+		}
+	double center[3] = { (min[0] + max[0]) * 0.5, (min[1] + max[1]) * 0.5, (min[2] + max[2]) * 0.5 };
+	double radius = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		double d[3] = { vertices[i].Position[0] - center[0], vertices[i].Position[1] - center[1], vertices[i].Position[2] - center[2] };
+		radius = (std::max)(radius, sqrt(Dot(d, d)));
+	}
+	double scale = radius > 0.0 ? 1.0 / radius : 1.0;
+	mesh.Points.resize(positionCount * 3);
+	for (size_t p = 0; p < positionCount; p++)
+		for (int c = 0; c < 3; c++)
+			mesh.Points[p * 3 + c] = (vertices[firstVertex[p]].Position[c] - center[c]) * scale;
+
+	mesh.Triangles = result;
+	mesh.Corners.resize(result.size());
+	for (size_t i = 0; i < result.size(); i++)
+		mesh.Corners[i] = mesh.PositionOf[result[i]];
+	size_t triangleCount = result.size() / 3;
+	mesh.Alive.assign(triangleCount, 1);
+	mesh.AliveCount = triangleCount;
+	mesh.Locked.assign(positionCount, 0);
+	mesh.Seam.assign(positionCount, 0);
+	mesh.Removed.assign(positionCount, 0);
+	mesh.MovedTo.assign(positionCount, 0);
+	mesh.Versions.assign(positionCount, 0);
+	mesh.Quadrics.resize(positionCount);
+	mesh.Around.resize(positionCount);
+
+	// How many vertices each position vertex's triangles use: one inside
+	// a surface, two on a seam or hard edge, more where seams meet
+	std::vector<unsigned int> vertexCounts(positionCount, 0);
+	std::vector<unsigned char> counted(count, 0);
+	for (unsigned int vertex : mesh.Triangles)
+		if (!counted[vertex])
+		{
+			counted[vertex] = 1;
+			vertexCounts[mesh.PositionOf[vertex]]++;
+		}
+
+	// Each position edge's first two triangles, and which way round they go
+	struct EdgeUse
+	{
+		unsigned int Count = 0;
+		unsigned int Triangles[2] = {};
+		bool Forward[2] = {};
+	};
+	std::unordered_map<unsigned long long, EdgeUse> edges;
+	edges.reserve(triangleCount * 3);
+	std::vector<double> normals(triangleCount * 3, 0.0);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		// Degenerate triangles never move
+		const unsigned int* corners = &mesh.Corners[t * 3];
+		if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+		{
+			for (int c = 0; c < 3; c++)
+				mesh.Locked[corners[c]] = 1;
+			continue;
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int a = corners[c], b = corners[(c + 1) % 3];
+			EdgeUse& use = edges[((unsigned long long)(std::min)(a, b) << 32) | (std::max)(a, b)];
+			if (use.Count < 2)
+			{
+				use.Triangles[use.Count] = t;
+				use.Forward[use.Count] = a < b;
+			}
+			use.Count++;
+			mesh.Around[corners[c]].push_back(t);
+		}
+
+		// Each triangle's plane, weighted by its area, on all three corners
+		double e1[3], e2[3];
+		double* normal = &normals[t * 3];
+		const double* p0 = &mesh.Points[corners[0] * 3];
+		Subtract(&mesh.Points[corners[1] * 3], p0, e1);
+		Subtract(&mesh.Points[corners[2] * 3], p0, e2);
+		Cross(e1, e2, normal);
+		double length = sqrt(Dot(normal, normal));
+		if (length <= 0.0)
+			continue;
+		for (int c = 0; c < 3; c++)
+			normal[c] /= length;
+		double d = -Dot(normal, p0);
+		for (int c = 0; c < 3; c++)
+			mesh.Quadrics[corners[c]].AddPlane(normal, d, length * 0.5);
+	}
+
+	// Borders, non-manifold edges, and edges whose two triangles go the
+	// same way round (a double-sided sheet, folded onto itself) lock both
+	// ends. Seam edges (the two triangles have different vertices at an
+	// end) get planes through them, square to their triangles, so sliding
+	// along a seam keeps its shape.
+	std::vector<unsigned int> seamEdges(positionCount, 0);
+	for (const std::pair<const unsigned long long, EdgeUse>& edge : edges)
+	{
+		unsigned int a = (unsigned int)(edge.first >> 32);
+		unsigned int b = (unsigned int)(edge.first & 0xFFFFFFFFu);
+		const EdgeUse& use = edge.second;
+		if (use.Count != 2 || use.Forward[0] == use.Forward[1])
+		{
+			mesh.Locked[a] = 1;
+			mesh.Locked[b] = 1;
+			continue;
+		}
+
+		bool seamAtA = mesh.VertexAt(use.Triangles[0], a) != mesh.VertexAt(use.Triangles[1], a);
+		bool seamAtB = mesh.VertexAt(use.Triangles[0], b) != mesh.VertexAt(use.Triangles[1], b);
+		seamEdges[a] += seamAtA;
+		seamEdges[b] += seamAtB;
+		if (!seamAtA && !seamAtB)
+			continue;
+
+		double direction[3];
+		Subtract(&mesh.Points[b * 3], &mesh.Points[a * 3], direction);
+		double weight = Dot(direction, direction);
+		for (unsigned int triangle : use.Triangles)
+		{
+			double normal[3];
+			Cross(direction, &normals[triangle * 3], normal);
+			double length = sqrt(Dot(normal, normal));
+			if (length <= 0.0)
+				continue;
+			for (int c = 0; c < 3; c++)
+				normal[c] /= length;
+			double d = -Dot(normal, &mesh.Points[a * 3]);
+			mesh.Quadrics[a].AddPlane(normal, d, weight);
+			mesh.Quadrics[b].AddPlane(normal, d, weight);
+		}
+	}
+	for (size_t p = 0; p < positionCount; p++)
+	{
+		if (vertexCounts[p] == 2 && seamEdges[p] == 2)
+			mesh.Seam[p] = 1;
+		else if (vertexCounts[p] > 1)
+			mesh.Locked[p] = 1;
+	}
+
+	std::vector<QueuedCollapse> queued;
+	queued.reserve(positionCount * 4);
+	std::priority_queue<QueuedCollapse, std::vector<QueuedCollapse>, CollapseOrder> heap(CollapseOrder(), std::move(queued));
+	for (unsigned int p = 0; p < positionCount; p++)
+	{
+		Collapse collapse;
+		if (mesh.Evaluate(p, collapse, false))
+			heap.push(collapse);
+	}
+
+	std::vector<unsigned int> touched;
+	while (mesh.AliveCount * 3 > targetIndexCount && !heap.empty())
+	{
+		QueuedCollapse collapse = heap.top();
+		heap.pop();
+		if (mesh.Removed[collapse.From] || collapse.Version != mesh.Versions[collapse.From])
+			continue;
+
+		// Validate it, now it's the cheapest. Collapses a step further
+		// away can also change its cost without touching this vertex's
+		// version. If it's no good, or dearer, the vertex's cheapest
+		// valid collapse goes back in.
+		Collapse current;
+		if (!mesh.Prepare(collapse.From))
+			continue;
+		if (!mesh.EvaluateEdge(collapse.From, collapse.To, current, true, DBL_MAX) || current.Cost > collapse.Cost)
+		{
+			if (mesh.Evaluate(collapse.From, current, true))
+				heap.push(current);
+			continue;
+		}
+
+		mesh.Apply(current);
+
+		// Everything around the vertex it went onto needs costing again
+		touched.clear();
+		touched.push_back(current.To);
+		for (unsigned int triangle : mesh.LiveAround(current.To))
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int position = mesh.Corners[triangle * 3 + c];
+				if (std::find(touched.begin(), touched.end(), position) == touched.end())
+					touched.push_back(position);
+			}
+		for (unsigned int position : touched)
+		{
+			mesh.Versions[position]++;
+			Collapse next;
+			if (mesh.Evaluate(position, next, false))
+				heap.push(next);
+		}
+	}
+
+	result.clear();
+	for (size_t t = 0; t < triangleCount; t++)
+		if (mesh.Alive[t])
+			result.insert(result.end(), &mesh.Triangles[t * 3], &mesh.Triangles[t * 3] + 3);
+	return (float)mesh.MeasureError();
+}
+
+/// <summary>
+/// Builds the chain of levels: the full mesh, then each level aiming
+/// for TriangleRatio of the one before's triangles, simplified from
+/// the full mesh on the queue's threads (or this one, without a
+/// queue). Levels land back to back in lodIndices.
+/// </summary>
+LodReport MeshSimplifier::BuildLods(const SourceVertex* vertices, size_t count, const unsigned int* indices, size_t indexCount,
+	const LodSettings& settings, std::vector<unsigned int>& lodIndices, std::vector<MeshLod>& lods, JobQueue* queue)
+{
+	LodReport report;
+	report.SourceTriangles = (unsigned int)(indexCount / 3);
+	report.Threads = queue ? queue->GetThreadCount() : 1;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	unsigned int levelCount = (std::max)(1u, settings.LevelCount);
+	std::vector<std::vector<unsigned int>> levels(levelCount);
+	std::vector<float> errors(levelCount, 0.0f);
+	levels[0].assign(indices, indices + (indexCount / 3) * 3);
+
+	double target = (double)report.SourceTriangles;
+	for (unsigned int level = 1; level < levelCount; level++)
+	{
+		target *= settings.TriangleRatio;
+		size_t targetIndexCount = (size_t)target * 3;
+		std::vector<unsigned int>* levelIndices = &levels[level];
+		float* error = &errors[level];
+		std::function<void()> job = [=, &settings]()
+		{
+			*error = Simplify(vertices, count, indices, indexCount, targetIndexCount, settings, *levelIndices);
+		};
+
+		if (queue)
+			queue->Push(job);
+		else
+			job();
+	}
+	if (queue)
+		queue->WaitIdle();
+
+	// Levels that barely shrank (simplification ran out of valid
+	// collapses) aren't worth switching to
+	lodIndices.clear();
+	lods.clear();
+	for (unsigned int level = 0; level < levelCount; level++)
+	{
+		if (!lods.empty() && (levels[level].empty() || levels[level].size() > lods.back().IndexCount * 0.9))
+			continue;
+
+		MeshLod lod;
+		lod.IndexStart = (unsigned int)lodIndices.size();
+		lod.IndexCount = (unsigned int)levels[level].size();
+		lod.Error = lods.empty() ? 0.0f : (std::max)(errors[level], lods.back().Error);
+		lods.push_back(lod);
+		lodIndices.insert(lodIndices.end(), levels[level].begin(), levels[level].end());
+	}
+
+	report.BuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return report;
+}
+
+/// <summary>
+/// Returns the radius, in pixels, of a bounding sphere on screen
+/// </summary>
+/// <param name="projectionScale">The projection matrix's y scale: 1 / tan(fov / 2)</param>
+/// <param name="screenHeight">In pixels</param>
+float MeshSimplifier::GetScreenRadius(float radius, float distance, float projectionScale, float screenHeight)
+{
+	if (distance <= radius)
+		return FLT_MAX;
+	return radius / distance * projectionScale * screenHeight * 0.5f;
+}
+
+/// <summary>
+/// Picks the coarsest level whose error stays under the pixel budget
+/// at this size on screen. Moving away from the current level takes
+/// going Hysteresis past the budget, so sizes near a threshold don't
+/// switch back and forth every frame.
+/// </summary>
+/// <param name="screenRadius">The mesh's bounding radius on screen, in pixels</param>
+/// <param name="current">The level drawn last frame</param>
+unsigned int MeshSimplifier::SelectLod(const std::vector<MeshLod>& lods, float screenRadius, unsigned int current, const LodSelection& selection)
+{
+	if (lods.empty())
+		return 0;
+	current = (std::min)(current, (unsigned int)lods.size() - 1);
+
+	// Errors only grow down the chain
+	auto coarsest = [&](float budget)
+	{
+		unsigned int level = 0;
+		while (level + 1 < lods.size() && lods[level + 1].Error * screenRadius <= budget)
+			level++;
+		return level;
+	};
+
+	unsigned int wanted = coarsest(selection.PixelError);
+	if (wanted > current)
+		return (std::max)(current, coarsest(selection.PixelError * (1.0f - selection.Hysteresis)));
+	if (wanted < current)
+		return (std::min)(current, coarsest(selection.PixelError * (1.0f + selection.Hysteresis)));
+	return current;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "JobQueue.h"
+#include "VertexPacking.h"
+
+// How a mesh's chain of levels of detail gets built
+struct LodSettings
+{
+	unsigned int LevelCount = 4;	// Including the full mesh; levels that barely shrink are dropped
+	float TriangleRatio = 0.5f;		// Each level aims for this fraction of the one before's triangles
+	float MaxError = 0.05f;			// Collapses stop at this quadric error (RMS distance to the planes they move off), relative to the bounding radius
+	float NormalWeight = 0.25f;		// Attribute errors, squared, against position errors relative to the radius, squared
+	float UvWeight = 1.0f;
+};
+
+// One level's triangles, as a range of the mesh's index buffer
+struct MeshLod
+{
+	unsigned int IndexStart = 0;
+	unsigned int IndexCount = 0;
+	float Error = 0.0f;		// How far the full mesh's vertices are from this level's surface, at most, relative to the bounding radius
+};
+
+// How far a level may stray on screen before a finer one is drawn
+struct LodSelection
+{
+	float PixelError = 1.0f;
+	float Hysteresis = 0.2f;	// Fraction past a threshold the error has to go before switching, both ways
+};
+
+// What building a mesh's levels cost
+struct LodReport
+{
+	unsigned int SourceTriangles = 0;
+	unsigned int Threads = 0;
+	double BuildMs = 0.0;
+};
+
+// --------------------------------------------------------
+// Builds levels of detail by collapsing edges, cheapest
+// first, where cost is the quadric error of the planes
+// around the vertex that goes (Garland and Heckbert) plus
+// how far its normal and UV are from what the triangles
+// left behind interpolate there.
+//
+// Vertices are welded first, and repeated triangles dropped.
+// Those on a UV seam or hard edge (one position, two
+// vertices) only slide along it, held there by planes
+// through the seam; ones where seams meet, on a border, or
+// on a non-manifold edge never move. No new vertices are
+// made, so every level shares the full mesh's vertex
+// buffer; a level is only a different index range.
+//
+// Levels are simplified from the full mesh independently,
+// one job each. Selection picks the coarsest whose error,
+// scaled by the mesh's size on screen, stays under a pixel
+// budget, with hysteresis so entities don't flicker.
+// --------------------------------------------------------
+class MeshSimplifier
+{
+	public:
+		static void Weld(const SourceVertex* vertices, size_t count, const unsigned int* indices, size_t indexCount,
+			std::vector<SourceVertex>& welded, std::vector<unsigned int>& weldedIndices);
+		static float Simplify(const SourceVertex* vertices, size_t count, const unsigned int* indices, size_t indexCount,
+			size_t targetIndexCount, const LodSettings& settings, std::vector<unsigned int>& result);
+		static LodReport BuildLods(const SourceVertex* vertices, size_t count, const unsigned int* indices, size_t indexCount,
+			const LodSettings& settings, std::vector<unsigned int>& lodIndices, std::vector<MeshLod>& lods, JobQueue* queue = 0);
+
+		static float GetScreenRadius(float radius, float distance, float projectionScale, float screenHeight);
+		static unsigned int SelectLod(const std::vector<MeshLod>& lods, float screenRadius, unsigned int current, const LodSelection& selection);
+};
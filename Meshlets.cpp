@@ -0,0 +1,351 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+static float Dot(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Cross(const float a[3], const float b[3], float result[3])
+{
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void Subtract(const float a[3], const float b[3], float result[3])
+{
+	for (int i = 0; i < 3; i++)
+		result[i] = a[i] - b[i];
+}
+
+// A triangle's unit normal, on its front (clockwise, as D3D sees it) side;
+// false if it has no area
+static bool TriangleNormal(const float* p0, const float* p1, const float* p2, float normal[3])
+{
+	float e1[3], e2[3];
+	Subtract(p1, p0, e1);
+	Subtract(p2, p0, e2);
+	Cross(e1, e2, normal);
+	float length = sqrtf(Dot(normal, normal));
+	if (length <= 0.0f)
+		return false;
+	for (int i = 0; i < 3; i++)
+		normal[i] /= length;
+	return true;
+}
+
+/// <summary>
+/// Splits a range of triangles into meshlets, reordering them in place
+/// so each meshlet's triangles are contiguous, and appends the meshlets
+/// (with bounds) to the list. Indices stay absolute, so meshlets from
+/// several ranges (levels of detail) can share one index buffer.
+/// </summary>
+void Meshlets::Build(const SourceVertex* vertices, size_t vertexCount, unsigned int* indices, size_t indexStart, size_t indexCount,
+	const MeshletSettings& settings, std::vector<Meshlet>& meshlets)
+{
+	unsigned int* triangles = indices + indexStart;
+	size_t triangleCount = indexCount / 3;
+	unsigned int maxVertices = (std::max)(3u, settings.MaxVertices);
+	unsigned int maxTriangles = (std::max)(1u, settings.MaxTriangles);
+	size_t firstMeshlet = meshlets.size();
+	if (triangleCount == 0)
+		return;
+
+	// Each vertex's triangles, and how many of them are still to place
+	std::vector<unsigned int> firstAround(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		firstAround[triangles[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		firstAround[v + 1] += firstAround[v];
+	std::vector<unsigned int> around(triangleCount * 3);
+	std::vector<unsigned int> filled(firstAround.begin(), firstAround.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+		for (int c = 0; c < 3; c++)
+			around[filled[triangles[t * 3 + c]]++] = (unsigned int)t;
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		remaining[v] = firstAround[v + 1] - firstAround[v];
+
+	// Unit face normals, to keep meshlets facing one way (tighter cones)
+	std::vector<float> normals(triangleCount * 3, 0.0f);
+	for (size_t t = 0; t < triangleCount; t++)
+		TriangleNormal(vertices[triangles[t * 3]].Position, vertices[triangles[t * 3 + 1]].Position, vertices[triangles[t * 3 + 2]].Position, &normals[t * 3]);
+
+	std::vector<unsigned char> placed(triangleCount, 0);
+	std::vector<unsigned char> inMeshlet(vertexCount, 0);
+	std::vector<unsigned int> order;
+	order.reserve(triangleCount);
+	std::vector<unsigned int> meshletVertices;
+	meshletVertices.reserve(maxVertices);
+
+	size_t seed = 0;
+	while (order.size() < triangleCount)
+	{
+		// Starts from the first triangle not yet placed, which keeps
+		// the original order's locality
+		while (placed[seed])
+			seed++;
+
+		size_t meshletStart = order.size();
+		unsigned int candidate = (unsigned int)seed;
+		float facing[3] = {};
+		while (true)
+		{
+			placed[candidate] = 1;
+			order.push_back(candidate);
+			for (int i = 0; i < 3; i++)
+				facing[i] += normals[candidate * 3 + i];
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int vertex = triangles[candidate * 3 + c];
+				remaining[vertex]--;
+				if (!inMeshlet[vertex])
+				{
+					inMeshlet[vertex] = 1;
+					meshletVertices.push_back(vertex);
+				}
+			}
+			if (order.size() - meshletStart >= maxTriangles)
+				break;
+
+			// The neighbor adding the fewest vertices, then facing most like
+			// the meshlet so far; ties go to the lower triangle, so the
+			// result doesn't depend on adjacency order
+			unsigned int best = UINT_MAX;
+			unsigned int bestNew = 3;
+			float bestFacing = -FLT_MAX;
+			for (unsigned int vertex : meshletVertices)
+			{
+				if (remaining[vertex] == 0)
+					continue;
+				for (unsigned int i = firstAround[vertex]; i < firstAround[vertex + 1]; i++)
+				{
+					unsigned int triangle = around[i];
+					if (placed[triangle])
+						continue;
+					unsigned int added = 0;
+					for (int c = 0; c < 3; c++)
+						added += !inMeshlet[triangles[triangle * 3 + c]];
+					if (added > bestNew)
+						continue;
+					float alike = Dot(facing, &normals[triangle * 3]);
+					if (added < bestNew || alike > bestFacing || (alike == bestFacing && triangle < best))
+					{
+						best = triangle;
+						bestNew = added;
+						bestFacing = alike;
+					}
+				}
+			}
+			if (best == UINT_MAX || meshletVertices.size() + bestNew > maxVertices)
+				break;
+			candidate = best;
+		}
+
+		Meshlet meshlet;
+		meshlet.IndexStart = (unsigned int)(indexStart + meshletStart * 3);
+		meshlet.IndexCount = (unsigned int)((order.size() - meshletStart) * 3);
+		meshlet.VertexCount = (unsigned int)meshletVertices.size();
+		meshlets.push_back(meshlet);
+
+		for (unsigned int vertex : meshletVertices)
+			inMeshlet[vertex] = 0;
+		meshletVertices.clear();
+	}
+
+	std::vector<unsigned int> reordered(triangleCount * 3);
+	for (size_t i = 0; i < triangleCount; i++)
+		for (int c = 0; c < 3; c++)
+			reordered[i * 3 + c] = triangles[order[i] * 3 + c];
+	std::copy(reordered.begin(), reordered.end(), triangles);
+
+	for (size_t m = firstMeshlet; m < meshlets.size(); m++)
+		ComputeBounds(vertices, indices, meshlets[m]);
+}
+
+/// <summary>
+/// Fits a meshlet's bounding sphere (around its box's center) and its
+/// normal cone: the average of its triangles' normals, widened to the
+/// one furthest off, with the apex pulled back behind every triangle's
+/// plane. Triangles spread over more than about 84 degrees from the
+/// axis get no cone.
+/// </summary>
+void Meshlets::ComputeBounds(const SourceVertex* vertices, const unsigned int* indices, Meshlet& meshlet)
+{
+	const unsigned int* triangles = indices + meshlet.IndexStart;
+	unsigned int triangleCount = meshlet.IndexCount / 3;
+	meshlet.ConeCutoff = 2.0f;
+	if (triangleCount == 0)
+		return;
+
+	float min[3], max[3];
+	for (int i = 0; i < 3; i++)
+		min[i] = max[i] = vertices[triangles[0]].Position[i];
+	for (unsigned int c = 1; c < meshlet.IndexCount; c++)
+		for (int i = 0; i < 3; i++)
+		{
+			min[i] = (std::min)(min[i], vertices[triangles[c]].Position[i]);
+			max[i] = (std::max)(max[i], vertices[triangles[c]].Position[i]);
+		}
+	for (int i = 0; i < 3; i++)
+		meshlet.Center[i] = (min[i] + max[i]) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (unsigned int c = 0; c < meshlet.IndexCount; c++)
+	{
+		float d[3];
+		Subtract(vertices[triangles[c]].Position, meshlet.Center, d);
+		radiusSquared = (std::max)(radiusSquared, Dot(d, d));
+	}
+	meshlet.Radius = sqrtf(radiusSquared);
+
+	// Area-less triangles can't be seen from anywhere, so they don't bound the cone
+	std::vector<float> normals(triangleCount * 3);
+	std::vector<unsigned char> valid(triangleCount, 0);
+	float axis[3] = {};
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		valid[t] = TriangleNormal(vertices[triangles[t * 3]].Position, vertices[triangles[t * 3 + 1]].Position,
+			vertices[triangles[t * 3 + 2]].Position, &normals[t * 3]);
+		if (valid[t])
+			for (int i = 0; i < 3; i++)
+				axis[i] += normals[t * 3 + i];
+	}
+	float axisLength = sqrtf(Dot(axis, axis));
+	if (axisLength <= 0.0f)
+		return;
+	for (int i = 0; i < 3; i++)
+		axis[i] /= axisLength;
+
+	float minDot = 1.0f;
+	for (unsigned int t = 0; t < triangleCount; t++)
+		if (valid[t])
+			minDot = (std::min)(minDot, Dot(axis, &normals[t * 3]));
+	if (minDot <= 0.1f)
+		return;
+
+	// Far enough back along the axis to be behind every triangle's plane:
+	// dot(center - axis * t - p0, normal) <= 0
+	float furthest = 0.0f;
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		if (!valid[t])
+			continue;
+		float d[3];
+		Subtract(meshlet.Center, vertices[triangles[t * 3]].Position, d);
+		furthest = (std::max)(furthest, Dot(d, &normals[t * 3]) / Dot(axis, &normals[t * 3]));
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		meshlet.ConeAxis[i] = axis[i];
+		meshlet.ConeApex[i] = meshlet.Center[i] - axis[i] * furthest;
+	}
+	meshlet.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+/// <summary>
+/// Culls meshlets against the frustum and, optionally, by facing, and
+/// returns the survivors as index ranges, merged where they're adjacent
+/// in the index buffer
+/// </summary>
+/// <param name="worldViewProjection">Row major, for row vectors (DirectXMath's layout)</param>
+/// <param name="eye">The camera's position in the mesh's model space</param>
+/// <param name="cullBackfaces">Off for meshes drawn without backface culling, or mirrored</param>
+/// <param name="stats">Meshlets and triangles seen and culled are added to this</param>
+void Meshlets::Cull(const Meshlet* meshlets, size_t count, const float worldViewProjection[16], const float eye[3], bool cullBackfaces,
+	std::vector<MeshletRange>& ranges, MeshletCullStats& stats)
+{
+	float planes[6][4];
+	GetFrustumPlanes(worldViewProjection, planes);
+
+	ranges.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		stats.Meshlets++;
+		stats.Triangles += meshlet.IndexCount / 3;
+
+		if (IsOutside(planes, meshlet.Center, meshlet.Radius))
+		{
+			stats.FrustumCulled++;
+			stats.TrianglesCulled += meshlet.IndexCount / 3;
+			continue;
+		}
+		if (cullBackfaces && IsBackfacing(meshlet, eye))
+		{
+			stats.BackfaceCulled++;
+			stats.TrianglesCulled += meshlet.IndexCount / 3;
+			continue;
+		}
+
+		if (!ranges.empty() && ranges.back().IndexStart + ranges.back().IndexCount == meshlet.IndexStart)
+			ranges.back().IndexCount += meshlet.IndexCount;
+		else
+			ranges.push_back({ meshlet.IndexStart, meshlet.IndexCount });
+	}
+	stats.Ranges += (unsigned int)ranges.size();
+}
+
+/// <summary>
+/// Extracts the six clip planes (left, right, bottom, top, near, far) of
+/// a row-vector matrix, in the space it transforms from, with unit
+/// normals pointing inside. Depth runs 0 to 1, as in D3D.
+/// </summary>
+void Meshlets::GetFrustumPlanes(const float matrix[16], float planes[6][4])
+{
+	// Clip space's x, y, z and w, as planes in the source space
+	float columns[4][4];
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+			columns[column][row] = matrix[row * 4 + column];
+
+	for (int i = 0; i < 4; i++)
+	{
+		planes[0][i] = columns[3][i] + columns[0][i];
+		planes[1][i] = columns[3][i] - columns[0][i];
+		planes[2][i] = columns[3][i] + columns[1][i];
+		planes[3][i] = columns[3][i] - columns[1][i];
+		planes[4][i] = columns[2][i];
+		planes[5][i] = columns[3][i] - columns[2][i];
+	}
+	for (int p = 0; p < 6; p++)
+	{
+		float length = sqrtf(Dot(planes[p], planes[p]));
+		if (length > 0.0f)
+			for (int i = 0; i < 4; i++)
+				planes[p][i] /= length;
+	}
+}
+
+/// <summary>
+/// Whether a sphere is entirely behind one of the planes
+/// </summary>
+bool Meshlets::IsOutside(const float planes[6][4], const float center[3], float radius)
+{
+	for (int p = 0; p < 6; p++)
+		if (Dot(planes[p], center) + planes[p][3] < -radius)
+			return true;
+	return false;
+}
+
+/// <summary>
+/// Whether every one of a meshlet's triangles faces away from the eye:
+/// it's inside the cone mirrored behind the apex
+/// </summary>
+bool Meshlets::IsBackfacing(const Meshlet& meshlet, const float eye[3])
+{
+	if (meshlet.ConeCutoff > 1.0f)
+		return false;
+	float toApex[3];
+	Subtract(meshlet.ConeApex, eye, toApex);
+	return Dot(toApex, meshlet.ConeAxis) >= meshlet.ConeCutoff * sqrtf(Dot(toApex, toApex));
+}
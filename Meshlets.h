@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "VertexPacking.h"
+
+// How big a meshlet may get (the usual mesh shader limits)
+struct MeshletSettings
+{
+	unsigned int MaxVertices = 64;
+	unsigned int MaxTriangles = 124;
+};
+
+// A cluster of neighboring triangles, as a range of the index buffer,
+// with bounds for culling it whole. Bounds are in model space.
+struct Meshlet
+{
+	unsigned int IndexStart = 0;
+	unsigned int IndexCount = 0;
+	unsigned int VertexCount = 0;	// Distinct vertices its triangles use
+	float Center[3] = {};			// Bounding sphere
+	float Radius = 0.0f;
+	float ConeApex[3] = {};			// Every triangle faces away from a camera inside the cone behind the apex
+	float ConeAxis[3] = {};
+	float ConeCutoff = 2.0f;		// Cosine of the cone's half angle; above 1, the triangles face too many ways to cull
+};
+
+// A run of visible meshlets' indices, to draw with one DrawIndexed
+struct MeshletRange
+{
+	unsigned int IndexStart = 0;
+	unsigned int IndexCount = 0;
+};
+
+// What cluster culling rejected, added up over calls
+struct MeshletCullStats
+{
+	unsigned int Meshlets = 0;
+	unsigned int FrustumCulled = 0;
+	unsigned int BackfaceCulled = 0;
+	unsigned int Triangles = 0;
+	unsigned int TrianglesCulled = 0;
+	unsigned int Ranges = 0;
+};
+
+// --------------------------------------------------------
+// Splits a mesh's triangles into meshlets: small clusters of
+// neighbors that cull as a unit. Each meshlet grows from the
+// next triangle not yet taken, always adding the neighbor
+// that brings the fewest new vertices, until it hits a limit
+// or runs out of neighbors. Triangles are reordered in place
+// so every meshlet is a contiguous range of indices.
+//
+// Culling rejects meshlets outside the frustum (sphere
+// against the planes of world * view * projection, so no
+// bounds are transformed) or facing away from the camera
+// (its position in model space against the normal cone),
+// then merges the survivors' ranges where they touch.
+// --------------------------------------------------------
+class Meshlets
+{
+	public:
+		static void Build(const SourceVertex* vertices, size_t vertexCount, unsigned int* indices, size_t indexStart, size_t indexCount,
+			const MeshletSettings& settings, std::vector<Meshlet>& meshlets);
+		static void ComputeBounds(const SourceVertex* vertices, const unsigned int* indices, Meshlet& meshlet);
+
+		static void Cull(const Meshlet* meshlets, size_t count, const float worldViewProjection[16], const float eye[3], bool cullBackfaces,
+			std::vector<MeshletRange>& ranges, MeshletCullStats& stats);
+
+		// Helpers
+		static void GetFrustumPlanes(const float matrix[16], float planes[6][4]);
+		static bool IsOutside(const float planes[6][4], const float center[3], float radius);
+		static bool IsBackfacing(const Meshlet& meshlet, const float eye[3]);
+};
@@ -0,0 +1,691 @@
+#include "MipGenerator.h"
+#include "CpuUtilities.h"
+
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <fstream>
+#include <math.h>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIP_GENERATOR_AVX2
+#if defined(_MSC_VER)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+// Output rows handed to each job
+static const unsigned int RowsPerJob = 16;
+
+// Levels smaller than this are built in one job, along with every level below them
+static const unsigned int SmallLevelPixels = 128 * 128;
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static float SrgbToLinear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static int ClampIndex(int value, unsigned int size)
+{
+	return (std::min)((int)size - 1, (std::max)(0, value));
+}
+
+// A filter as the source taps around each output texel: output x
+// reads source texels 2x + First through 2x + First + Taps - 1
+struct Kernel
+{
+	int First;
+	int Taps;
+	float Weights[8];
+};
+
+// Modified Bessel function of the first kind, order zero (for the Kaiser window)
+static double BesselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+struct Kernels
+{
+	Kernel Box;
+	Kernel Kaiser;
+
+	Kernels()
+	{
+		Box.First = 0;
+		Box.Taps = 2;
+		Box.Weights[0] = Box.Weights[1] = 0.5f;
+
+		// Sinc windowed to two output texels either side, alpha = 4
+		const double pi = 3.14159265358979323846;
+		const double alpha = 4.0;
+		const double halfWidth = 2.0;
+		Kaiser.First = -3;
+		Kaiser.Taps = 8;
+
+		double weights[8];
+		double total = 0.0;
+		for (int k = 0; k < Kaiser.Taps; k++)
+		{
+			// Distance from the output texel's center, in output texels
+			double d = (Kaiser.First + k + 0.5 - 1.0) / 2.0;
+			double sinc = sin(pi * d) / (pi * d);
+			double r = d / halfWidth;
+			weights[k] = sinc * BesselI0(alpha * sqrt(1.0 - r * r)) / BesselI0(alpha);
+			total += weights[k];
+		}
+		for (int k = 0; k < Kaiser.Taps; k++)
+			Kaiser.Weights[k] = (float)(weights[k] / total);
+	}
+};
+
+static const Kernel& GetKernel(MipFilter filter)
+{
+	static Kernels kernels;
+	return filter == MipFilter::Kaiser ? kernels.Kaiser : kernels.Box;
+}
+
+// Byte -> float for each kind of content, and linear float -> sRGB byte
+struct Tables
+{
+	float Decode[3][256 * 4];	// [content][byte * 4 + channel]; alpha is always linear
+	float SrgbThreshold[257];	// Lowest linear value that encodes to each byte
+	int SrgbBucket[1024];		// Byte at the start of each sqrt(linear) bucket
+
+	Tables()
+	{
+		for (int b = 0; b < 256; b++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				float linear = b / 255.0f;
+				Decode[(int)MipContent::Linear][b * 4 + c] = linear;
+				Decode[(int)MipContent::Srgb][b * 4 + c] = c < 3 ? SrgbToLinear(b / 255.0f) : linear;
+				Decode[(int)MipContent::Normal][b * 4 + c] = c < 3 ? b / 127.5f - 1.0f : linear;
+			}
+		}
+
+		SrgbThreshold[0] = -FLT_MAX;
+		for (int b = 1; b < 256; b++)
+			SrgbThreshold[b] = SrgbToLinear((b - 0.5f) / 255.0f);
+		SrgbThreshold[256] = FLT_MAX;
+
+		// Buckets are narrower than the gap between any two thresholds,
+		// so each holds at most one and a single compare finds the byte
+		int b = 0;
+		for (int i = 0; i < 1024; i++)
+		{
+			float start = (i / 1024.0f) * (i / 1024.0f);
+			while (b < 255 && SrgbThreshold[b + 1] <= start)
+				b++;
+			SrgbBucket[i] = b;
+		}
+	}
+};
+
+static const Tables& GetTables()
+{
+	static Tables tables;
+	return tables;
+}
+
+static unsigned char EncodeLinear(float value)
+{
+	return (unsigned char)(std::min)(255.0f, (std::max)(0.0f, value * 255.0f + 0.5f));
+}
+
+static unsigned char EncodeSrgb(float value, const Tables& tables)
+{
+	value = (std::min)(1.0f, (std::max)(0.0f, value));
+	int index = (std::min)(1023, (int)(sqrtf(value) * 1024.0f));
+	int b = tables.SrgbBucket[index];
+	b += value >= tables.SrgbThreshold[b + 1] ? 1 : 0;
+	b -= value < tables.SrgbThreshold[b] ? 1 : 0;
+	return (unsigned char)b;
+}
+
+// One level of a chain being built
+struct LevelView
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned char* Pixels;
+};
+
+// --------------------------------------------------------
+// Scalar path. Each function starts at "begin" so the AVX2
+// versions can hand over whatever's left at the end of a row.
+// --------------------------------------------------------
+static void DecodeRow(const unsigned char* source, float* row, unsigned int begin, unsigned int count, unsigned int channels, const float* table)
+{
+	for (unsigned int i = begin; i < count; i++)
+		row[i] = table[source[i] * 4 + (channels == 4 ? (i & 3) : 0)];
+}
+
+static void FilterRow(const float* row, unsigned int sourceWidth, float* output, unsigned int begin, unsigned int end, unsigned int channels, const Kernel& kernel)
+{
+	for (unsigned int x = begin; x < end; x++)
+	{
+		for (unsigned int c = 0; c < channels; c++)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < kernel.Taps; k++)
+				sum += kernel.Weights[k] * row[ClampIndex((int)x * 2 + kernel.First + k, sourceWidth) * channels + c];
+			output[x * channels + c] = sum;
+		}
+	}
+}
+
+static void FilterColumns(const float* const* rows, float* output, unsigned int begin, unsigned int count, const Kernel& kernel)
+{
+	for (unsigned int i = begin; i < count; i++)
+	{
+		float sum = 0.0f;
+		for (int k = 0; k < kernel.Taps; k++)
+			sum += kernel.Weights[k] * rows[k][i];
+		output[i] = sum;
+	}
+}
+
+static void EncodeRow(const float* row, unsigned char* output, unsigned int begin, unsigned int count, unsigned int channels, MipContent content, const Tables& tables)
+{
+	if (content == MipContent::Normal)
+	{
+		// Filtered normals get shorter, so stretch them back to unit length
+		for (unsigned int i = begin; i < count; i += 4)
+		{
+			float n[3] = { row[i], row[i + 1], row[i + 2] };
+			float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length < 1e-6f)
+			{
+				n[0] = n[1] = 0.0f;
+				n[2] = 1.0f;
+			}
+			else
+			{
+				for (int c = 0; c < 3; c++)
+					n[c] = n[c] / length;
+			}
+			for (int c = 0; c < 3; c++)
+				output[i + c] = EncodeLinear(n[c] * 0.5f + 0.5f);
+			output[i + 3] = 255;
+		}
+		return;
+	}
+
+	for (unsigned int i = begin; i < count; i++)
+	{
+		bool alpha = channels == 4 && (i & 3) == 3;
+		output[i] = content == MipContent::Srgb && !alpha ? EncodeSrgb(row[i], tables) : EncodeLinear(row[i]);
+	}
+}
+
+// --------------------------------------------------------
+// AVX2 path: the same math, eight floats at a time. Each
+// function returns where it stopped, for the scalar code.
+// --------------------------------------------------------
+#ifdef MIP_GENERATOR_AVX2
+AVX2_FUNCTION static unsigned int DecodeRowAvx2(const unsigned char* source, float* row, unsigned int count, unsigned int channels, const float* table)
+{
+	__m256i lanes = channels == 4 ? _mm256_setr_epi32(0, 1, 2, 3, 0, 1, 2, 3) : _mm256_setzero_si256();
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(source + i)));
+		__m256i index = _mm256_add_epi32(_mm256_slli_epi32(bytes, 2), lanes);
+		_mm256_storeu_ps(row + i, _mm256_i32gather_ps(table, index, 4));
+	}
+	return i;
+}
+
+AVX2_FUNCTION static unsigned int FilterRowAvx2(const float* row, unsigned int sourceWidth, float* output, unsigned int x, unsigned int width, unsigned int channels, const Kernel& kernel)
+{
+	// Two RGBA texels or eight single channel ones per step. The single
+	// channel loads read one texel past the last tap, so leave room for it.
+	unsigned int step = channels == 4 ? 2 : 8;
+	int overread = channels == 4 ? 0 : 1;
+	while (x + step <= width && (int)(x + step - 1) * 2 + kernel.First + kernel.Taps - 1 + overread <= (int)sourceWidth - 1)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for (int k = 0; k < kernel.Taps; k++)
+		{
+			int first = (int)x * 2 + kernel.First + k;
+			__m256 taps;
+			if (channels == 4)
+			{
+				taps = _mm256_set_m128(_mm_loadu_ps(row + (first + 2) * 4), _mm_loadu_ps(row + first * 4));
+			}
+			else
+			{
+				// Every other texel of sixteen
+				__m256 a = _mm256_loadu_ps(row + first);
+				__m256 b = _mm256_loadu_ps(row + first + 8);
+				__m256 evens = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+				taps = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(evens), _MM_SHUFFLE(3, 1, 2, 0)));
+			}
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(kernel.Weights[k]), taps));
+		}
+		_mm256_storeu_ps(output + x * channels, sum);
+		x += step;
+	}
+	return x;
+}
+
+AVX2_FUNCTION static unsigned int FilterColumnsAvx2(const float* const* rows, float* output, unsigned int count, const Kernel& kernel)
+{
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for (int k = 0; k < kernel.Taps; k++)
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(kernel.Weights[k]), _mm256_loadu_ps(rows[k] + i)));
+		_mm256_storeu_ps(output + i, sum);
+	}
+	return i;
+}
+
+AVX2_FUNCTION static __m256i EncodeLinearAvx2(__m256 value)
+{
+	__m256 scaled = _mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f));
+	return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_set1_ps(255.0f), _mm256_max_ps(_mm256_setzero_ps(), scaled)));
+}
+
+AVX2_FUNCTION static __m256i EncodeSrgbAvx2(__m256 value, const Tables& tables)
+{
+	value = _mm256_min_ps(_mm256_set1_ps(1.0f), _mm256_max_ps(_mm256_setzero_ps(), value));
+	__m256i index = _mm256_min_epi32(_mm256_set1_epi32(1023), _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sqrt_ps(value), _mm256_set1_ps(1024.0f))));
+	__m256i b = _mm256_i32gather_epi32(tables.SrgbBucket, index, 4);
+
+	// Compares are all ones (-1) where true
+	__m256 above = _mm256_i32gather_ps(tables.SrgbThreshold, _mm256_add_epi32(b, _mm256_set1_epi32(1)), 4);
+	b = _mm256_sub_epi32(b, _mm256_castps_si256(_mm256_cmp_ps(value, above, _CMP_GE_OQ)));
+	__m256 below = _mm256_i32gather_ps(tables.SrgbThreshold, b, 4);
+	return _mm256_add_epi32(b, _mm256_castps_si256(_mm256_cmp_ps(value, below, _CMP_LT_OQ)));
+}
+
+AVX2_FUNCTION static void StoreBytesAvx2(__m256i values, unsigned char* output)
+{
+	__m256i words = _mm256_packus_epi32(values, values);
+	__m256i bytes = _mm256_packus_epi16(words, words);
+	int low = _mm_cvtsi128_si32(_mm256_castsi256_si128(bytes));
+	int high = _mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1));
+	memcpy(output, &low, 4);
+	memcpy(output + 4, &high, 4);
+}
+
+AVX2_FUNCTION static unsigned int EncodeRowAvx2(const float* row, unsigned char* output, unsigned int count, unsigned int channels, MipContent content, const Tables& tables)
+{
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 value = _mm256_loadu_ps(row + i);
+		__m256i bytes;
+		if (content == MipContent::Linear)
+		{
+			bytes = EncodeLinearAvx2(value);
+		}
+		else if (content == MipContent::Srgb)
+		{
+			bytes = EncodeSrgbAvx2(value, tables);
+			if (channels == 4)
+				bytes = _mm256_blend_epi32(bytes, EncodeLinearAvx2(value), 0x88);
+		}
+		else
+		{
+			// Two normals; the dot product sums (x*x + y*y) + z*z, like the scalar code
+			__m256 length = _mm256_sqrt_ps(_mm256_dp_ps(value, value, 0x7F));
+			__m256 flat = _mm256_cmp_ps(length, _mm256_set1_ps(1e-6f), _CMP_LT_OQ);
+			__m256 n = _mm256_blendv_ps(_mm256_div_ps(value, length), _mm256_setr_ps(0, 0, 1, 0, 0, 0, 1, 0), flat);
+			bytes = EncodeLinearAvx2(_mm256_add_ps(_mm256_mul_ps(n, _mm256_set1_ps(0.5f)), _mm256_set1_ps(0.5f)));
+			bytes = _mm256_blend_epi32(bytes, _mm256_set1_epi32(255), 0x88);
+		}
+		StoreBytesAvx2(bytes, output + i);
+	}
+	return i;
+}
+#endif
+
+// --------------------------------------------------------
+// Level building
+// --------------------------------------------------------
+
+// Builds rows [firstRow, endRow) of target from source
+static void BuildRows(const LevelView& source, const LevelView& target, unsigned int channels, const MipSettings& settings, bool simd, unsigned int firstRow, unsigned int endRow)
+{
+	const Kernel& kernel = GetKernel(settings.Filter);
+	const Tables& tables = GetTables();
+	MipContent content = channels == 1 && settings.Content == MipContent::Normal ? MipContent::Linear : settings.Content;
+	const float* decodeTable = tables.Decode[(int)content];
+
+	unsigned int sourceFloats = source.Width * channels;
+	unsigned int targetFloats = target.Width * channels;
+
+	// Output texels whose taps start before the row does
+	unsigned int leftEdge = (std::min)(target.Width, (unsigned int)(1 - kernel.First) / 2);
+
+	// Every source row the band's taps touch, decoded and filtered horizontally
+	int firstSource = ClampIndex((int)firstRow * 2 + kernel.First, source.Height);
+	int lastSource = ClampIndex((int)(endRow - 1) * 2 + kernel.First + kernel.Taps - 1, source.Height);
+	std::vector<float> decoded(sourceFloats);
+	std::vector<float> filtered((size_t)(lastSource - firstSource + 1) * targetFloats);
+	for (int y = firstSource; y <= lastSource; y++)
+	{
+		const unsigned char* pixels = source.Pixels + (size_t)y * sourceFloats;
+		float* output = &filtered[(size_t)(y - firstSource) * targetFloats];
+
+		unsigned int i = 0;
+		unsigned int x = leftEdge;
+#ifdef MIP_GENERATOR_AVX2
+		if (simd)
+			i = DecodeRowAvx2(pixels, decoded.data(), sourceFloats, channels, decodeTable);
+#endif
+		DecodeRow(pixels, decoded.data(), i, sourceFloats, channels, decodeTable);
+
+		FilterRow(decoded.data(), source.Width, output, 0, leftEdge, channels, kernel);
+#ifdef MIP_GENERATOR_AVX2
+		if (simd)
+			x = FilterRowAvx2(decoded.data(), source.Width, output, x, target.Width, channels, kernel);
+#endif
+		FilterRow(decoded.data(), source.Width, output, x, target.Width, channels, kernel);
+	}
+
+	// Then vertically, and back to bytes
+	std::vector<float> column(targetFloats);
+	const float* rows[8];
+	for (unsigned int y = firstRow; y < endRow; y++)
+	{
+		for (int k = 0; k < kernel.Taps; k++)
+			rows[k] = &filtered[(size_t)(ClampIndex((int)y * 2 + kernel.First + k, source.Height) - firstSource) * targetFloats];
+		unsigned char* output = target.Pixels + (size_t)y * targetFloats;
+
+		unsigned int filteredCount = 0;
+		unsigned int encodedCount = 0;
+#ifdef MIP_GENERATOR_AVX2
+		if (simd)
+			filteredCount = FilterColumnsAvx2(rows, column.data(), targetFloats, kernel);
+#endif
+		FilterColumns(rows, column.data(), filteredCount, targetFloats, kernel);
+#ifdef MIP_GENERATOR_AVX2
+		if (simd)
+			encodedCount = EncodeRowAvx2(column.data(), output, targetFloats, channels, content, tables);
+#endif
+		EncodeRow(column.data(), output, encodedCount, targetFloats, channels, content, tables);
+	}
+}
+
+// Fills in every level after the first
+static void BuildChain(const std::vector<LevelView>& levels, unsigned int channels, const MipSettings& settings, JobQueue* queue)
+{
+	bool simd = settings.UseSimd && CpuUtilities::HasAvx2();
+	for (size_t level = 1; level < levels.size(); level++)
+	{
+		const LevelView& target = levels[level];
+
+		// Not worth splitting up: do the rest of the chain right here
+		if (!queue || target.Width * target.Height < SmallLevelPixels)
+		{
+			for (; level < levels.size(); level++)
+				BuildRows(levels[level - 1], levels[level], channels, settings, simd, 0, levels[level].Height);
+			return;
+		}
+
+		for (unsigned int y = 0; y < target.Height; y += RowsPerJob)
+		{
+			unsigned int end = (std::min)(target.Height, y + RowsPerJob);
+			queue->Push([&levels, level, channels, settings, simd, y, end]()
+			{
+				BuildRows(levels[level - 1], levels[level], channels, settings, simd, y, end);
+			});
+		}
+		queue->WaitIdle();
+	}
+}
+
+/// <summary>
+/// Builds the full mip chain of an RGBA image, down to 1x1
+/// </summary>
+/// <param name="image">The top level</param>
+/// <param name="settings">What the pixels are, and how to filter them</param>
+/// <param name="mips">Filled with the chain, largest (a copy of image) first</param>
+/// <param name="queue">Splits the big levels across its threads, if given</param>
+void MipGenerator::Generate(const CpuImage& image, const MipSettings& settings, std::vector<CpuImage>& mips, JobQueue* queue)
+{
+	mips.clear();
+	mips.push_back(image);
+	if (image.Width == 0 || image.Height == 0)
+		return;
+
+	while (mips.back().Width > 1 || mips.back().Height > 1)
+	{
+		CpuImage next;
+		next.Width = (std::max)(1u, mips.back().Width / 2);
+		next.Height = (std::max)(1u, mips.back().Height / 2);
+		next.Pixels.resize((size_t)next.Width * next.Height * 4);
+		mips.push_back(std::move(next));
+	}
+
+	std::vector<LevelView> levels;
+	for (CpuImage& mip : mips)
+		levels.push_back({ mip.Width, mip.Height, mip.Pixels.data() });
+	BuildChain(levels, 4, settings, queue);
+}
+
+/// <summary>
+/// Builds the full mip chain of a single channel (R8) image, down to 1x1
+/// </summary>
+/// <param name="pixels">The top level, one byte per texel</param>
+/// <param name="settings">What the pixels are (Normal is treated as Linear), and how to filter them</param>
+/// <param name="mips">Filled with the chain, largest (a copy of pixels) first</param>
+/// <param name="queue">Splits the big levels across its threads, if given</param>
+void MipGenerator::GenerateSingleChannel(const std::vector<unsigned char>& pixels, unsigned int width, unsigned int height,
+	const MipSettings& settings, std::vector<std::vector<unsigned char>>& mips, JobQueue* queue)
+{
+	mips.clear();
+	mips.push_back(pixels);
+	if (width == 0 || height == 0)
+		return;
+
+	std::vector<LevelView> levels;
+	levels.push_back({ width, height, 0 });
+	while (levels.back().Width > 1 || levels.back().Height > 1)
+		levels.push_back({ (std::max)(1u, levels.back().Width / 2), (std::max)(1u, levels.back().Height / 2), 0 });
+
+	mips.resize(levels.size());
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		mips[i].resize((size_t)levels[i].Width * levels[i].Height);
+		levels[i].Pixels = mips[i].data();
+	}
+	BuildChain(levels, 1, settings, queue);
+}
+
+const char* MipGenerator::GetFilterName(MipFilter filter)
+{
+	return filter == MipFilter::Kaiser ? "Kaiser" : "Box";
+}
+
+const char* MipGenerator::GetContentName(MipContent content)
+{
+	switch (content)
+	{
+		case MipContent::Srgb: return "sRGB";
+		case MipContent::Normal: return "Normal";
+		default: return "Linear";
+	}
+}
+
+/// <summary>
+/// Builds mip chains for a set of images with each filter, on the scalar
+/// and AVX2 paths, at each thread count. Every configuration runs several
+/// times and the fastest run is kept. Images with Linear content are
+/// reduced to their red channel and built as single channel images.
+/// </summary>
+/// <param name="contents">What each image is (same order as images)</param>
+/// <param name="threadCounts">Thread counts to try; 1 runs on the calling thread</param>
+/// <param name="repeats">Runs per configuration</param>
+/// <returns>One result per configuration, each filter's scalar runs first</returns>
+std::vector<MipBenchmarkResult> MipGenerator::RunBenchmark(
+	const std::vector<CpuImage>& images,
+	const std::vector<MipContent>& contents,
+	const std::vector<unsigned int>& threadCounts,
+	unsigned int repeats)
+{
+	repeats = (std::max)(1u, repeats);
+
+	// Single channel sources, pulled out up front so it isn't timed
+	std::vector<std::vector<unsigned char>> singleChannel(images.size());
+	double megapixels = 0.0;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		megapixels += (double)images[i].Width * images[i].Height / 1e6;
+		if (contents[i] != MipContent::Linear)
+			continue;
+		singleChannel[i].resize((size_t)images[i].Width * images[i].Height);
+		for (size_t p = 0; p < singleChannel[i].size(); p++)
+			singleChannel[i][p] = images[i].Pixels[p * 4];
+	}
+
+	std::vector<MipBenchmarkResult> results;
+	const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser };
+	for (MipFilter filter : filters)
+	{
+		// Every other configuration has to produce the same bytes as this one
+		std::vector<std::vector<unsigned char>> reference;
+
+		for (int simd = 0; simd < (CpuUtilities::HasAvx2() ? 2 : 1); simd++)
+		{
+			for (unsigned int threads : threadCounts)
+			{
+				std::unique_ptr<JobQueue> queue;
+				if (threads > 1)
+					queue = std::make_unique<JobQueue>(threads);
+
+				MipBenchmarkResult result;
+				result.Name = std::string(GetFilterName(filter)) + (simd ? " AVX2" : " scalar");
+				result.Filter = filter;
+				result.Simd = simd != 0;
+				result.Threads = (std::max)(1u, threads);
+				result.BestMs = 1e30;
+
+				std::vector<std::vector<unsigned char>> output(images.size());
+				for (unsigned int r = 0; r < repeats; r++)
+				{
+					// Only the generation is timed, not flattening the chains to compare
+					double ms = 0.0;
+					for (size_t i = 0; i < images.size(); i++)
+					{
+						MipSettings settings;
+						settings.Content = contents[i];
+						settings.Filter = filter;
+						settings.UseSimd = simd != 0;
+
+						output[i].clear();
+						if (contents[i] == MipContent::Linear)
+						{
+							std::vector<std::vector<unsigned char>> mips;
+							std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+							GenerateSingleChannel(singleChannel[i], images[i].Width, images[i].Height, settings, mips, queue.get());
+							ms += MillisecondsSince(start);
+							for (const std::vector<unsigned char>& mip : mips)
+								output[i].insert(output[i].end(), mip.begin(), mip.end());
+						}
+						else
+						{
+							std::vector<CpuImage> mips;
+							std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+							Generate(images[i], settings, mips, queue.get());
+							ms += MillisecondsSince(start);
+							for (const CpuImage& mip : mips)
+								output[i].insert(output[i].end(), mip.Pixels.begin(), mip.Pixels.end());
+						}
+					}
+					result.BestMs = (std::min)(result.BestMs, ms);
+				}
+
+				if (reference.empty())
+					reference = output;
+				result.MatchesScalar = output == reference;
+				result.MegapixelsPerSecond = megapixels / (result.BestMs / 1000.0);
+				results.push_back(result);
+			}
+		}
+	}
+	return results;
+}
+
+/// <summary>
+/// A printable table of benchmark results. Speedups are against
+/// the first (single threaded, scalar) run of the same filter.
+/// </summary>
+std::string MipGenerator::FormatBenchmark(const std::vector<MipBenchmarkResult>& results, size_t imageCount, unsigned int repeats)
+{
+	char line[256];
+	std::string table;
+	snprintf(line, sizeof(line), "Mip generation benchmark: %zu images, best of %u runs\n", imageCount, repeats);
+	table += line;
+	snprintf(line, sizeof(line), "%-16s %8s %10s %10s %8s %8s\n", "Path", "Threads", "Wall ms", "MP/s", "Speedup", "Matches");
+	table += line;
+
+	double baseline = 0.0;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const MipBenchmarkResult& result = results[i];
+		if (i == 0 || result.Filter != results[i - 1].Filter)
+			baseline = result.BestMs;
+
+		snprintf(line, sizeof(line), "%-16s %8u %10.2f %10.1f %7.2fx %8s\n",
+			result.Name.c_str(), result.Threads, result.BestMs, result.MegapixelsPerSecond,
+			baseline / result.BestMs, result.MatchesScalar ? "yes" : "NO");
+		table += line;
+	}
+	return table;
+}
+
+/// <summary>
+/// Writes benchmark results as JSON
+/// </summary>
+/// <returns>False if the file can't be written</returns>
+bool MipGenerator::WriteBenchmarkJson(const std::string& path, const std::vector<MipBenchmarkResult>& results, size_t imageCount, unsigned int repeats)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	char line[512];
+	snprintf(line, sizeof(line), "{\n  \"images\": %zu,\n  \"repeats\": %u,\n  \"avx2\": %s,\n  \"results\": [\n",
+		imageCount, repeats, CpuUtilities::HasAvx2() ? "true" : "false");
+	file << line;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const MipBenchmarkResult& result = results[i];
+		snprintf(line, sizeof(line),
+			"    { \"filter\": \"%s\", \"simd\": %s, \"threads\": %u, \"wall_ms\": %.3f, \"megapixels_per_second\": %.2f, \"matches_scalar\": %s }%s\n",
+			GetFilterName(result.Filter), result.Simd ? "true" : "false", result.Threads, result.BestMs,
+			result.MegapixelsPerSecond, result.MatchesScalar ? "true" : "false", i + 1 < results.size() ? "," : "");
+		file << line;
+	}
+	file << "  ]\n}\n";
+
+	return true;
+}
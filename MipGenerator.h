@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "JobQueue.h"
+#include "PngReader.h"
+
+// How a level's texels are weighed to make the next
+enum class MipFilter
+{
+	Box,	// 2x2 average: cheap, a little blurry
+	Kaiser	// 8x8 Kaiser-windowed sinc: sharper, may ring slightly
+};
+
+// What the values in an image mean, which decides how they're averaged
+enum class MipContent
+{
+	Linear,	// Data (roughness, masks): averaged as stored
+	Srgb,	// Gamma encoded color: averaged as light (alpha as stored)
+	Normal	// Tangent space normals in RGB: averaged, then renormalized
+};
+
+struct MipSettings
+{
+	MipContent Content = MipContent::Linear;
+	MipFilter Filter = MipFilter::Box;
+	bool UseSimd = true;	// AVX2, when the CPU has it; the results are identical
+};
+
+// Throughput of one configuration in RunBenchmark()
+struct MipBenchmarkResult
+{
+	std::string Name;
+	MipFilter Filter = MipFilter::Box;
+	bool Simd = false;
+	unsigned int Threads = 1;
+	double BestMs = 0.0;		// Whole set of images, best run
+	double MegapixelsPerSecond = 0.0;	// Of source (top level) pixels
+	bool MatchesScalar = true;	// Same bytes as the single threaded scalar run
+};
+
+// --------------------------------------------------------
+// Builds mip chains on the CPU, so the results don't depend
+// on the driver's GenerateMips. Each level comes from the
+// one above it; rows are decoded to floats (sRGB through a
+// table), filtered horizontally then vertically, and encoded
+// back to bytes (sRGB through an exact threshold search).
+//
+// Images are 8-bit, with 1 or 4 interleaved channels. The
+// AVX2 path computes every value the same way, in the same
+// order, as the scalar one, so their output is identical.
+//
+// With a JobQueue, each level is split into bands of rows
+// across its threads; the small levels at the end of the
+// chain are built together in one job. The call waits for
+// the queue to go idle, so don't call it from one of that
+// queue's own jobs.
+// --------------------------------------------------------
+class MipGenerator
+{
+	public:
+		static void Generate(const CpuImage& image, const MipSettings& settings, std::vector<CpuImage>& mips, JobQueue* queue = 0);
+		static void GenerateSingleChannel(const std::vector<unsigned char>& pixels, unsigned int width, unsigned int height,
+			const MipSettings& settings, std::vector<std::vector<unsigned char>>& mips, JobQueue* queue = 0);
+
+		static const char* GetFilterName(MipFilter filter);
+		static const char* GetContentName(MipContent content);
+
+		// Times every filter, path and thread count on a set of images
+		static std::vector<MipBenchmarkResult> RunBenchmark(
+			const std::vector<CpuImage>& images,
+			const std::vector<MipContent>& contents,
+			const std::vector<unsigned int>& threadCounts,
+			unsigned int repeats);
+		static std::string FormatBenchmark(const std::vector<MipBenchmarkResult>& results, size_t imageCount, unsigned int repeats);
+		static bool WriteBenchmarkJson(const std::string& path, const std::vector<MipBenchmarkResult>& results, size_t imageCount, unsigned int repeats);
+};
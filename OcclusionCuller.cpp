@@ -0,0 +1,410 @@
+#include "OcclusionCuller.h"
+#include "CpuUtilities.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OCCLUSION_CULLER_AVX2
+#if defined(_MSC_VER)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+// Clip space w below this is treated as crossing the near plane
+static const float MinW = 1e-5f;
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+// Row vectors, so a * b applies a first
+static void Multiply(const float a[16], const float b[16], float result[16])
+{
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			result[row * 4 + column] =
+				a[row * 4 + 0] * b[0 * 4 + column] + a[row * 4 + 1] * b[1 * 4 + column] +
+				a[row * 4 + 2] * b[2 * 4 + column] + a[row * 4 + 3] * b[3 * 4 + column];
+}
+
+static void TransformPoint(const float point[3], const float matrix[16], float result[4])
+{
+	for (int column = 0; column < 4; column++)
+		result[column] = point[0] * matrix[column] + point[1] * matrix[4 + column] + point[2] * matrix[8 + column] + matrix[12 + column];
+}
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// <summary>
+/// Creates the depth buffer and pyramid, and the job queue tiles are rasterized on
+/// </summary>
+OcclusionCuller::OcclusionCuller(OcclusionSettings _settings) :
+	settings(_settings)
+{
+	settings.TileWidth = (std::max)(8u, settings.TileWidth & ~7u);
+	settings.TileHeight = (std::max)(1u, settings.TileHeight);
+	settings.Width = (std::max)(1u, (settings.Width + settings.TileWidth - 1) / settings.TileWidth) * settings.TileWidth;
+	settings.Height = (std::max)(1u, (settings.Height + settings.TileHeight - 1) / settings.TileHeight) * settings.TileHeight;
+	tilesX = settings.Width / settings.TileWidth;
+	tilesY = settings.Height / settings.TileHeight;
+	bins.resize(tilesX * tilesY);
+	simd = settings.UseSimd && CpuUtilities::HasAvx2();
+
+	unsigned int threads = settings.Threads > 0 ? settings.Threads : (std::max)(1u, std::thread::hardware_concurrency());
+	if (threads > 1)
+		queue = std::make_unique<JobQueue>(threads);
+
+	// Each level half the one before, rounding up, down to a single texel
+	unsigned int width = settings.Width, height = settings.Height;
+	while (true)
+	{
+		levels.push_back(std::vector<float>((size_t)width * height, 1.0f));
+		levelWidths.push_back(width);
+		levelHeights.push_back(height);
+		if (width == 1 && height == 1)
+			break;
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+
+	for (int i = 0; i < 16; i++)
+		viewProjection[i] = i % 5 == 0 ? 1.0f : 0.0f;
+}
+
+/// <summary>
+/// Clears the depth buffer and takes the camera for this frame's
+/// occluders and tests
+/// </summary>
+/// <param name="_viewProjection">Row major, for row vectors (DirectXMath's layout)</param>
+void OcclusionCuller::BeginFrame(const float _viewProjection[16])
+{
+	for (int i = 0; i < 16; i++)
+		viewProjection[i] = _viewProjection[i];
+	triangles.clear();
+	for (std::vector<unsigned int>& bin : bins)
+		bin.clear();
+	std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+	stats = OcclusionStats();
+}
+
+/// <summary>
+/// Transforms an occluder's triangles to the screen and bins them into
+/// tiles. Back faces (if culled) and triangles crossing the near plane
+/// are dropped; triangles are wound clockwise on screen, as D3D's
+/// front faces are.
+/// </summary>
+/// <param name="positions">Three floats per vertex, in model space</param>
+/// <param name="world">Row major, for row vectors</param>
+void OcclusionCuller::AddOccluder(const float* positions, const unsigned int* indices, unsigned int indexCount, const float world[16])
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	float matrix[16];
+	Multiply(world, viewProjection, matrix);
+	float width = (float)settings.Width, height = (float)settings.Height;
+
+	stats.Occluders++;
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		stats.Triangles++;
+
+		// Pixel coordinates, y down, and depth
+		float screen[3][3];
+		bool clipped = false;
+		for (int c = 0; c < 3; c++)
+		{
+			float clip[4];
+			TransformPoint(&positions[indices[i + c] * 3], matrix, clip);
+			if (clip[3] < MinW || clip[2] < 0.0f)
+			{
+				clipped = true;
+				break;
+			}
+			screen[c][0] = (clip[0] / clip[3] * 0.5f + 0.5f) * width;
+			screen[c][1] = (0.5f - clip[1] / clip[3] * 0.5f) * height;
+			screen[c][2] = (std::min)(1.0f, clip[2] / clip[3]);
+		}
+		if (clipped)
+			continue;
+
+		float area = (screen[1][0] - screen[0][0]) * (screen[2][1] - screen[0][1]) - (screen[2][0] - screen[0][0]) * (screen[1][1] - screen[0][1]);
+		if (area == 0.0f || (area < 0.0f && settings.CullBackfaces))
+			continue;
+		if (area < 0.0f)
+		{
+			std::swap(screen[1], screen[2]);
+			area = -area;
+		}
+
+		ScreenTriangle triangle;
+		float minX = (std::min)(screen[0][0], (std::min)(screen[1][0], screen[2][0]));
+		float maxX = (std::max)(screen[0][0], (std::max)(screen[1][0], screen[2][0]));
+		float minY = (std::min)(screen[0][1], (std::min)(screen[1][1], screen[2][1]));
+		float maxY = (std::max)(screen[0][1], (std::max)(screen[1][1], screen[2][1]));
+		triangle.MinX = (std::max)(0, (int)ceilf(minX - 0.5f));
+		triangle.MinY = (std::max)(0, (int)ceilf(minY - 0.5f));
+		triangle.MaxX = (std::min)((int)settings.Width - 1, (int)floorf(maxX - 0.5f));
+		triangle.MaxY = (std::min)((int)settings.Height - 1, (int)floorf(maxY - 0.5f));
+		if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+			continue;
+
+		// Edge i runs between the other two corners, and is zero there
+		triangle.DepthA = triangle.DepthB = triangle.DepthC = 0.0f;
+		for (int e = 0; e < 3; e++)
+		{
+			const float* j = screen[(e + 1) % 3];
+			const float* k = screen[(e + 2) % 3];
+			triangle.EdgeA[e] = j[1] - k[1];
+			triangle.EdgeB[e] = k[0] - j[0];
+			triangle.EdgeC[e] = -triangle.EdgeB[e] * j[1] - triangle.EdgeA[e] * j[0];
+			triangle.DepthA += triangle.EdgeA[e] * screen[e][2];
+			triangle.DepthB += triangle.EdgeB[e] * screen[e][2];
+			triangle.DepthC += triangle.EdgeC[e] * screen[e][2];
+		}
+		triangle.DepthA /= area;
+		triangle.DepthB /= area;
+		triangle.DepthC /= area;
+
+		unsigned int index = (unsigned int)triangles.size();
+		triangles.push_back(triangle);
+		stats.Rasterized++;
+		for (unsigned int ty = triangle.MinY / settings.TileHeight; ty <= triangle.MaxY / settings.TileHeight; ty++)
+			for (unsigned int tx = triangle.MinX / settings.TileWidth; tx <= triangle.MaxX / settings.TileWidth; tx++)
+				bins[ty * tilesX + tx].push_back(index);
+	}
+	stats.RasterMs += MillisecondsSince(start);
+}
+
+/// <summary>
+/// Rasterizes every tile (one job each, if there are threads to spare)
+/// and builds the pyramid
+/// </summary>
+void OcclusionCuller::Rasterize()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int tile = 0; tile < tilesX * tilesY; tile++)
+	{
+		if (bins[tile].empty())
+			continue;
+		if (queue)
+			queue->Push([this, tile]() { RasterizeTile(tile); });
+		else
+			RasterizeTile(tile);
+	}
+	if (queue)
+		queue->WaitIdle();
+	stats.RasterMs += MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	BuildHiZ();
+	stats.HiZMs = MillisecondsSince(start);
+}
+
+// Scalar version of RasterizeRowsAvx2(): the same arithmetic, a pixel at a time
+static void RasterizeRowsScalar(const float edgeA[3], const float edgeB[3], const float edgeC[3], float depthA, float depthB, float depthC,
+	int minX, int maxX, int minY, int maxY, float* depth, unsigned int stride)
+{
+	for (int y = minY; y <= maxY; y++)
+	{
+		float py = (float)y + 0.5f;
+		float* row = depth + (size_t)y * stride;
+		for (int x = minX; x <= maxX; x++)
+		{
+			float px = (float)x + 0.5f;
+			bool inside = true;
+			for (int e = 0; e < 3; e++)
+				inside = inside && (edgeA[e] * px + edgeB[e] * py) + edgeC[e] >= 0.0f;
+			if (inside)
+				row[x] = (std::min)(row[x], (depthA * px + depthB * py) + depthC);
+		}
+	}
+}
+
+#ifdef OCCLUSION_CULLER_AVX2
+// Eight pixels at a time, from minX rounded down to a multiple of eight
+// (tiles are aligned to eight, so this stays inside the tile)
+AVX2_FUNCTION static void RasterizeRowsAvx2(const float edgeA[3], const float edgeB[3], const float edgeC[3], float depthA, float depthB, float depthC,
+	int minX, int maxX, int minY, int maxY, float* depth, unsigned int stride)
+{
+	__m256 a[3], b[3], c[3];
+	for (int e = 0; e < 3; e++)
+	{
+		a[e] = _mm256_set1_ps(edgeA[e]);
+		b[e] = _mm256_set1_ps(edgeB[e]);
+		c[e] = _mm256_set1_ps(edgeC[e]);
+	}
+	__m256 da = _mm256_set1_ps(depthA), db = _mm256_set1_ps(depthB), dc = _mm256_set1_ps(depthC);
+	__m256 lanes = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	__m256 first = _mm256_set1_ps((float)minX + 0.5f), last = _mm256_set1_ps((float)maxX + 0.5f);
+	__m256 zero = _mm256_setzero_ps();
+
+	int startX = minX & ~7;
+	for (int y = minY; y <= maxY; y++)
+	{
+		__m256 py = _mm256_set1_ps((float)y + 0.5f);
+		float* row = depth + (size_t)y * stride;
+		for (int x = startX; x <= maxX; x += 8)
+		{
+			__m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lanes);
+			__m256 inside = _mm256_and_ps(_mm256_cmp_ps(px, first, _CMP_GE_OQ), _mm256_cmp_ps(px, last, _CMP_LE_OQ));
+			for (int e = 0; e < 3; e++)
+			{
+				__m256 value = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[e], px), _mm256_mul_ps(b[e], py)), c[e]);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(value, zero, _CMP_GE_OQ));
+			}
+			if (_mm256_movemask_ps(inside) == 0)
+				continue;
+
+			__m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(da, px), _mm256_mul_ps(db, py)), dc);
+			__m256 stored = _mm256_loadu_ps(row + x);
+			_mm256_storeu_ps(row + x, _mm256_blendv_ps(stored, _mm256_min_ps(stored, z), inside));
+		}
+	}
+}
+#endif
+
+/// <summary>
+/// Rasterizes one tile's triangles into the depth buffer. Tiles don't
+/// overlap, so jobs never write the same pixel.
+/// </summary>
+void OcclusionCuller::RasterizeTile(unsigned int tile)
+{
+	int tileMinX = (int)((tile % tilesX) * settings.TileWidth);
+	int tileMinY = (int)((tile / tilesX) * settings.TileHeight);
+	int tileMaxX = tileMinX + (int)settings.TileWidth - 1;
+	int tileMaxY = tileMinY + (int)settings.TileHeight - 1;
+	float* depth = levels[0].data();
+
+	for (unsigned int index : bins[tile])
+	{
+		const ScreenTriangle& t = triangles[index];
+		int minX = (std::max)(t.MinX, tileMinX), maxX = (std::min)(t.MaxX, tileMaxX);
+		int minY = (std::max)(t.MinY, tileMinY), maxY = (std::min)(t.MaxY, tileMaxY);
+		if (minX > maxX || minY > maxY)
+			continue;
+#ifdef OCCLUSION_CULLER_AVX2
+		if (simd)
+		{
+			RasterizeRowsAvx2(t.EdgeA, t.EdgeB, t.EdgeC, t.DepthA, t.DepthB, t.DepthC, minX, maxX, minY, maxY, depth, settings.Width);
+			continue;
+		}
+#endif
+		RasterizeRowsScalar(t.EdgeA, t.EdgeB, t.EdgeC, t.DepthA, t.DepthB, t.DepthC, minX, maxX, minY, maxY, depth, settings.Width);
+	}
+}
+
+/// <summary>
+/// Reduces the depth buffer to the pyramid: every texel the furthest
+/// of the (up to) four it covers in the level below
+/// </summary>
+void OcclusionCuller::BuildHiZ()
+{
+	for (size_t level = 1; level < levels.size(); level++)
+	{
+		const std::vector<float>& below = levels[level - 1];
+		unsigned int belowWidth = levelWidths[level - 1], belowHeight = levelHeights[level - 1];
+		std::vector<float>& target = levels[level];
+		for (unsigned int y = 0; y < levelHeights[level]; y++)
+		{
+			unsigned int y0 = y * 2, y1 = (std::min)(y * 2 + 1, belowHeight - 1);
+			for (unsigned int x = 0; x < levelWidths[level]; x++)
+			{
+				unsigned int x0 = x * 2, x1 = (std::min)(x * 2 + 1, belowWidth - 1);
+				target[y * levelWidths[level] + x] = (std::max)(
+					(std::max)(below[y0 * belowWidth + x0], below[y0 * belowWidth + x1]),
+					(std::max)(below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]));
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Whether a bounding sphere may be visible past this frame's occluders
+/// </summary>
+bool OcclusionCuller::IsVisible(const float center[3], float radius)
+{
+	float boxMin[3] = { center[0] - radius, center[1] - radius, center[2] - radius };
+	float boxMax[3] = { center[0] + radius, center[1] + radius, center[2] + radius };
+	return IsBoxVisible(boxMin, boxMax);
+}
+
+/// <summary>
+/// Whether a world space box may be visible past this frame's occluders:
+/// false only if its nearest corner is further than the furthest
+/// occluder depth anywhere under its (on screen) rectangle. Boxes
+/// reaching past the near plane, or covering no pixel center, are
+/// always visible (frustum culling is someone else's job).
+/// </summary>
+bool OcclusionCuller::IsBoxVisible(const float boxMin[3], const float boxMax[3])
+{
+	stats.Tested++;
+
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		float point[3] = { corner & 1 ? boxMax[0] : boxMin[0], corner & 2 ? boxMax[1] : boxMin[1], corner & 4 ? boxMax[2] : boxMin[2] };
+		float clip[4];
+		TransformPoint(point, viewProjection, clip);
+		if (clip[3] < MinW || clip[2] < 0.0f)
+			return true;
+
+		float x = (clip[0] / clip[3] * 0.5f + 0.5f) * settings.Width;
+		float y = (0.5f - clip[1] / clip[3] * 0.5f) * settings.Height;
+		minX = (std::min)(minX, x);
+		maxX = (std::max)(maxX, x);
+		minY = (std::min)(minY, y);
+		maxY = (std::max)(maxY, y);
+		nearest = (std::min)(nearest, clip[2] / clip[3]);
+	}
+
+	// The pixel centers inside the rectangle
+	int x0 = (std::max)(0, (int)ceilf(minX - 0.5f));
+	int y0 = (std::max)(0, (int)ceilf(minY - 0.5f));
+	int x1 = (std::min)((int)settings.Width - 1, (int)floorf(maxX - 0.5f));
+	int y1 = (std::min)((int)settings.Height - 1, (int)floorf(maxY - 0.5f));
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	// The finest level where the rectangle spans at most two texels each way
+	unsigned int level = 0;
+	while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+
+	float furthest = 0.0f;
+	const std::vector<float>& texels = levels[level];
+	for (int y = y0 >> level; y <= (y1 >> level); y++)
+		for (int x = x0 >> level; x <= (x1 >> level); x++)
+			furthest = (std::max)(furthest, texels[y * levelWidths[level] + x]);
+
+	if (nearest > furthest + settings.DepthBias)
+	{
+		stats.Culled++;
+		return false;
+	}
+	return true;
+}
+
+// Getters
+const OcclusionSettings& OcclusionCuller::GetSettings() { return settings; }
+OcclusionStats OcclusionCuller::GetStats() { return stats; }
+unsigned int OcclusionCuller::GetLevelCount() { return (unsigned int)levels.size(); }
+
+/// <summary>
+/// Returns one level of the pyramid (level 0 is the depth buffer),
+/// row by row
+/// </summary>
+const float* OcclusionCuller::GetDepth(unsigned int level, unsigned int& width, unsigned int& height)
+{
+	level = (std::min)(level, (unsigned int)levels.size() - 1);
+	width = levelWidths[level];
+	height = levelHeights[level];
+	return levels[level].data();
+}
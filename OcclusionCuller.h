@@ -0,0 +1,96 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "JobQueue.h"
+
+struct OcclusionSettings
+{
+	unsigned int Width = 256;		// Of the depth buffer; a multiple of TileWidth
+	unsigned int Height = 128;		// A multiple of TileHeight
+	unsigned int TileWidth = 32;	// A multiple of 8 (one AVX2 row)
+	unsigned int TileHeight = 16;
+	unsigned int Threads = 0;		// 0 for every hardware thread
+	bool UseSimd = true;			// AVX2, when the CPU has it; the results are identical
+	bool CullBackfaces = true;		// Closed occluders' back faces are always behind their front faces
+	float DepthBias = 1e-5f;		// Tested bounds have to be this much further than the occluders
+};
+
+// What the last frame's rasterization and tests cost
+struct OcclusionStats
+{
+	unsigned int Occluders = 0;
+	unsigned int Triangles = 0;		// Submitted
+	unsigned int Rasterized = 0;	// After backface and near plane rejection
+	unsigned int Tested = 0;
+	unsigned int Culled = 0;
+	double RasterMs = 0.0;			// Transform, binning and rasterization
+	double HiZMs = 0.0;
+};
+
+// --------------------------------------------------------
+// Software occlusion culling. Large occluders are drawn on
+// the CPU into a small depth buffer, which is then reduced
+// to a hierarchical-Z pyramid (each texel the furthest of
+// the four below it) that bounds are tested against before
+// anything is submitted to the GPU.
+//
+// Triangles are transformed and set up on the calling
+// thread, binned into screen tiles, and each tile is
+// rasterized by its own job, eight pixels at a time with
+// AVX2. Depth is D3D's (0 near, 1 far), sampled at pixel
+// centers.
+//
+// Everything errs toward drawing: occluder triangles that
+// cross the near plane are dropped, and bounds are tested
+// by their box's nearest corner against the furthest
+// depth under their screen rectangle. A culled object is
+// hidden at every pixel center of the buffer.
+// --------------------------------------------------------
+class OcclusionCuller
+{
+	public:
+		OcclusionCuller(OcclusionSettings _settings);
+
+		void BeginFrame(const float viewProjection[16]);
+		void AddOccluder(const float* positions, const unsigned int* indices, unsigned int indexCount, const float world[16]);
+		void Rasterize();
+		bool IsVisible(const float center[3], float radius);
+		bool IsBoxVisible(const float boxMin[3], const float boxMax[3]);
+
+		// Getters
+		const OcclusionSettings& GetSettings();
+		OcclusionStats GetStats();
+		const float* GetDepth(unsigned int level, unsigned int& width, unsigned int& height);
+		unsigned int GetLevelCount();
+
+	private:
+		struct ScreenTriangle
+		{
+			float EdgeA[3];		// Edge functions a * x + b * y + c, positive inside
+			float EdgeB[3];
+			float EdgeC[3];
+			float DepthA;		// Depth plane
+			float DepthB;
+			float DepthC;
+			int MinX, MinY, MaxX, MaxY;	// Pixel bounds, inclusive
+		};
+
+		void RasterizeTile(unsigned int tile);
+		void BuildHiZ();
+
+		OcclusionSettings settings;
+		std::unique_ptr<JobQueue> queue;
+		bool simd;
+
+		float viewProjection[16];
+		std::vector<ScreenTriangle> triangles;
+		std::vector<std::vector<unsigned int>> bins;	// Per tile, the triangles touching it
+		unsigned int tilesX, tilesY;
+
+		std::vector<std::vector<float>> levels;			// Level 0 is the depth buffer
+		std::vector<unsigned int> levelWidths;
+		std::vector<unsigned int> levelHeights;
+
+		OcclusionStats stats;
+};
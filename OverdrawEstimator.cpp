@@ -0,0 +1,123 @@
+#include "OverdrawEstimator.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+// One sphere's depth at one grid cell
+struct Fragment
+{
+	unsigned int Cell;
+	float Depth;
+};
+
+// A cell coordinate, kept near the grid so it can't overflow an int
+static int ClampToGrid(float coordinate, unsigned int size)
+{
+	return (int)(std::max)(-1.0f, (std::min)((float)size, coordinate));
+}
+
+// Counts the fragments that pass a LESS depth test, drawing spheres in this order
+static unsigned int CountShaded(const std::vector<Fragment>& fragments, const std::vector<unsigned int>& starts, const std::vector<unsigned int>& order,
+	std::vector<float>& depth)
+{
+	std::fill(depth.begin(), depth.end(), FLT_MAX);
+	unsigned int shaded = 0;
+	for (unsigned int sphere : order)
+	{
+		for (unsigned int f = starts[sphere]; f < starts[sphere + 1]; f++)
+		{
+			float& stored = depth[fragments[f].Cell];
+			if (fragments[f].Depth < stored)
+			{
+				stored = fragments[f].Depth;
+				shaded++;
+			}
+		}
+	}
+	return shaded;
+}
+
+/// <summary>
+/// Draws the spheres into the grid in the order given, then nearest
+/// first, and counts what each order shades
+/// </summary>
+/// <param name="screenWidth">In pixels, the size ScreenX and ScreenRadius are measured in</param>
+OverdrawEstimate OverdrawEstimator::Estimate(const OverdrawSphere* spheres, size_t count, unsigned int screenWidth, unsigned int screenHeight,
+	const OverdrawSettings& settings)
+{
+	OverdrawEstimate estimate;
+	if (count == 0 || screenWidth == 0 || screenHeight == 0 || settings.GridWidth == 0 || settings.GridHeight == 0)
+		return estimate;
+
+	float scaleX = (float)settings.GridWidth / screenWidth;
+	float scaleY = (float)settings.GridHeight / screenHeight;
+
+	// Every sphere's fragments, back to back
+	std::vector<Fragment> fragments;
+	std::vector<unsigned int> starts(count + 1, 0);
+	std::vector<char> covered((size_t)settings.GridWidth * settings.GridHeight, 0);
+	for (size_t s = 0; s < count; s++)
+	{
+		const OverdrawSphere& sphere = spheres[s];
+		starts[s] = (unsigned int)fragments.size();
+		if (!(sphere.ScreenRadius > 0.0f))
+			continue;
+
+		float centerX = sphere.ScreenX * scaleX, centerY = sphere.ScreenY * scaleY;
+		float radiusX = sphere.ScreenRadius * scaleX, radiusY = sphere.ScreenRadius * scaleY;
+		int minX = (std::max)(0, ClampToGrid(floorf(centerX - radiusX), settings.GridWidth));
+		int maxX = (std::min)((int)settings.GridWidth - 1, ClampToGrid(ceilf(centerX + radiusX), settings.GridWidth));
+		int minY = (std::max)(0, ClampToGrid(floorf(centerY - radiusY), settings.GridHeight));
+		int maxY = (std::min)((int)settings.GridHeight - 1, ClampToGrid(ceilf(centerY + radiusY), settings.GridHeight));
+		for (int y = minY; y <= maxY; y++)
+		{
+			float v = ((float)y + 0.5f - centerY) / radiusY;
+			for (int x = minX; x <= maxX; x++)
+			{
+				float u = ((float)x + 0.5f - centerX) / radiusX;
+				float distanceSquared = u * u + v * v;
+				if (distanceSquared > 1.0f)
+					continue;
+
+				unsigned int cell = (unsigned int)y * settings.GridWidth + x;
+				fragments.push_back({ cell, sphere.ViewDepth - sphere.Radius * sqrtf(1.0f - distanceSquared) });
+				covered[cell] = 1;
+			}
+		}
+	}
+	starts[count] = (unsigned int)fragments.size();
+
+	estimate.Fragments = (unsigned int)fragments.size();
+	for (char cell : covered)
+		estimate.Covered += cell;
+	estimate.ShadedPrepass = estimate.Covered;
+
+	std::vector<float> depth(covered.size());
+	std::vector<unsigned int> order(count);
+	for (size_t s = 0; s < count; s++)
+		order[s] = (unsigned int)s;
+	estimate.ShadedSubmitted = CountShaded(fragments, starts, order, depth);
+	SortFrontToBack(spheres, count, order);
+	estimate.ShadedFrontToBack = CountShaded(fragments, starts, order, depth);
+	return estimate;
+}
+
+/// <summary>
+/// Orders the spheres by their nearest point, nearest first; ties keep
+/// their order
+/// </summary>
+void OverdrawEstimator::SortFrontToBack(const OverdrawSphere* spheres, size_t count, std::vector<unsigned int>& order)
+{
+	order.resize(count);
+	for (size_t s = 0; s < count; s++)
+		order[s] = (unsigned int)s;
+	std::stable_sort(order.begin(), order.end(), [spheres](unsigned int a, unsigned int b)
+	{
+		return spheres[a].ViewDepth - spheres[a].Radius < spheres[b].ViewDepth - spheres[b].Radius;
+	});
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// An entity as the estimator sees it: its bounding sphere,
+// projected to the screen and measured along the view direction
+struct OverdrawSphere
+{
+	float ScreenX = 0.0f;		// Center, in pixels
+	float ScreenY = 0.0f;
+	float ScreenRadius = 0.0f;	// In pixels
+	float ViewDepth = 0.0f;		// Of the center, in world units
+	float Radius = 0.0f;		// In world units
+};
+
+struct OverdrawSettings
+{
+	unsigned int GridWidth = 160;	// Cells the screen is estimated at
+	unsigned int GridHeight = 90;
+};
+
+// Pixel shader invocations, in grid cells, one way or another
+struct OverdrawEstimate
+{
+	unsigned int Covered = 0;			// Cells anything covers
+	unsigned int Fragments = 0;			// Every sphere's cells, added up: what a depth-only pass rasterizes
+	unsigned int ShadedSubmitted = 0;	// Fragments passing a LESS depth test in the order given
+	unsigned int ShadedFrontToBack = 0;	// ...nearest first
+	unsigned int ShadedPrepass = 0;		// Behind a depth pre-pass, with an EQUAL test: once per covered cell
+
+	// Shaded fragments per covered cell
+	float GetOverdraw(unsigned int shaded) const { return Covered > 0 ? (float)shaded / Covered : 0.0f; }
+};
+
+// --------------------------------------------------------
+// Estimates how many times each pixel gets shaded, with and
+// without a depth pre-pass, from nothing but entities'
+// bounding spheres. Each sphere's front half is drawn into a
+// coarse grid (its depth rising from the nearest point at
+// the center to the center's depth at the rim), so spheres
+// that overlap hide each other as the meshes inside them
+// would, roughly. Self overdraw inside a mesh isn't counted.
+// --------------------------------------------------------
+class OverdrawEstimator
+{
+	public:
+		static OverdrawEstimate Estimate(const OverdrawSphere* spheres, size_t count, unsigned int screenWidth, unsigned int screenHeight,
+			const OverdrawSettings& settings);
+		static void SortFrontToBack(const OverdrawSphere* spheres, size_t count, std::vector<unsigned int>& order);
+};
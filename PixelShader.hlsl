@@ -2,27 +2,92 @@
 
 cbuffer ExternalData : register(b0)
 {
+#ifndef BATCHED
 	float4 colorTint;
+#endif
 	float3 cameraPosition;
+#ifndef BATCHED
 	float roughness;
+#endif
 	float3 cameraPos;
 	float3 ambientLight;
+#ifndef BATCHED
 	float uvScale;
 	float2 uvOffset;
-	Light directionalLight1;
-	Light directionalLight2;
-	Light directionalLight3;
-	Light pointLight1;
-	Light pointLight2;
+#endif
+	int lightCount;
+	Light lights[MAX_LIGHTS];
+
+	// Environment lighting (see EnvironmentLighting)
+	float4 shAmbient[9];		// SH irradiance over pi, basis constants folded in
+	float specularIblMips;		// Highest mip of SpecularIbl
+	float iblIntensity;			// 0 until the environment is ready
+
+	// Ambient probes (see ProbeVolume)
+	int ambientMode;			// AMBIENT_SH_CONSTANTS or AMBIENT_SH_GRID
+	float3 probeGridMin;		// Position of the first probe
+	float3 probeGridInvCellSize;
+	uint3 probeGridCounts;		// Probes along x, y and z; x varies fastest
+
+	// Cascaded shadows (see ShadowRenderer)
+	matrix shadowViewProjections[MAX_SHADOW_CASCADES];
+	float4 shadowTexelSizes;	// World units per texel, per cascade
+	int shadowCascadeCount;		// 0 when there are no shadows
+	int shadowLightIndex;		// The light they belong to
+	float shadowMapSize;		// Texels across
 }
 
+#ifdef BATCHED
+// Every material's textures are a slice of a texture array, and its
+// parameters come from a buffer (must match MaterialParams in MaterialTable.h)
+struct MaterialParams
+{
+	float4 colorTint;
+	float roughness;
+	float uvScale;
+	float2 uvOffset;
+	uint slice;
+	uint3 padding;
+};
+StructuredBuffer<MaterialParams> Materials : register(t3);
+
+Texture2DArray AlbedoTextureArray	: register(t0);
+Texture2DArray NormalMapArray		: register(t1);
+Texture2DArray OrmMapArray			: register(t2);
+#define SAMPLE_MAP(map, uv) map##Array.Sample(BasicSampler, float3(uv, material.slice))
+#else
 //Texture2D SurfaceTexture  : register(t0);		For Non-PBR Lighting
 Texture2D AlbedoTexture		: register(t0);
 Texture2D NormalMap			: register(t1);
-Texture2D RoughnessMap		: register(t2);
-Texture2D MetalnessMap		: register(t3);
+Texture2D OrmMap			: register(t2);		// R = occlusion, G = roughness, B = metalness
+#define SAMPLE_MAP(map, uv) map.Sample(BasicSampler, uv)
+#endif
 SamplerState BasicSampler	: register(s0);
 
+TextureCube SpecularIbl		: register(t4);		// GGX prefiltered sky, roughness rising with each mip
+Texture2D BrdfLut			: register(t5);		// Split-sum scale (R) and bias (G) applied to F0
+SamplerState ClampSampler	: register(s1);
+
+// shAmbient's 27 values as half floats, two to a uint (must match PackedShProbe in ShProbeGrid.h)
+struct ShProbe
+{
+	uint halves[14];
+};
+StructuredBuffer<ShProbe> Probes : register(t6);
+
+Texture2DArray ShadowMap				: register(t7);		// Light-space depth, a slice per cascade
+SamplerComparisonState ShadowSampler	: register(s2);
+
+// How many lights main() loops over: compiled in for small counts
+// (see ShaderPermutations), so the loop unrolls; else the buffer's
+#ifdef LIGHT_COUNT
+#define LIGHT_LOOP_COUNT LIGHT_COUNT
+#define LIGHT_LOOP [unroll]
+#else
+#define LIGHT_LOOP_COUNT min(lightCount, MAX_LIGHTS)
+#define LIGHT_LOOP
+#endif
+
 
 float3 Attenuate(Light light, float3 worldPos)
 {
@@ -221,6 +286,189 @@ float3 CalculatePointLight(Light light, VertexToPixel inputData, float roughness
 	return lightColor;
 }
 
+#ifdef COARSE_LIGHTING
+// A light's diffuse (before the surface color) and specular, kept apart so
+// a quad can share them and still apply each pixel's own surface color
+void CalculateLightParts(Light light, VertexToPixel inputData, float roughnessValue, float metalnessValue, float3 surfaceValue, out float3 diffuse, out float3 specular)
+{
+	diffuse = 0;
+	specular = 0;
+
+	float3 dirToLight = 0;
+	float3 radiance = light.Intensity * light.Color;
+	switch (light.Type)
+	{
+		case LIGHT_TYPE_DIRECTIONAL:
+			dirToLight = normalize(-light.Direction);
+			break;
+
+		case LIGHT_TYPE_POINT:
+			dirToLight = normalize(light.Position - inputData.worldPosition);
+			radiance *= Attenuate(light, inputData.worldPosition);
+			break;
+
+		default:
+			return;
+	}
+
+	float diffuseAmount = saturate(dot(inputData.normal, dirToLight));
+	float3 specularColor = lerp(F0_NON_METAL.rrr, surfaceValue.rgb, metalnessValue);
+	float3 specularValue = MicrofacetBRDF(inputData.normal, dirToLight, normalize(cameraPosition - inputData.worldPosition), roughnessValue, specularColor);
+	diffuse = DiffuseEnergyConserve(diffuseAmount, specularValue, metalnessValue) * radiance;
+	specular = specularValue * radiance;
+}
+
+// The sum of a value over the pixel's 2x2 quad. ddx_fine is the right
+// pixel's value less the left's, in both of them, so each can rebuild
+// its row's sum; ddy_fine of the rows does the same down the quad.
+// Must be reached by the whole quad (not from inside a branch).
+float3 QuadSum(float3 value, uint2 quadPosition)
+{
+	float3 row = value * 2 + (quadPosition.x ? -ddx_fine(value) : ddx_fine(value));
+	return row * 2 + (quadPosition.y ? -ddy_fine(row) : ddy_fine(row));
+}
+#endif
+
+// How much of the shadow-casting light reaches a point: 1 is fully lit.
+// The first cascade that holds the point is used, filtered with 3x3
+// bilinear comparisons; past the last one, nothing is shadowed.
+float CalculateShadow(float3 worldPosition, float3 surfaceNormal)
+{
+	[loop]
+	for (int c = 0; c < shadowCascadeCount; c++)
+	{
+		// Pushed off the surface by about a texel, against acne
+		float3 offsetPosition = worldPosition + surfaceNormal * shadowTexelSizes[c] * 1.5f;
+		float4 shadowPosition = mul(shadowViewProjections[c], float4(offsetPosition, 1.0f));
+		float2 uv = shadowPosition.xy * float2(0.5f, -0.5f) + 0.5f;
+
+		// Leaves room for the filter's outer taps
+		float margin = 1.5f / shadowMapSize;
+		if (any(uv < margin) || any(uv > 1 - margin) || shadowPosition.z > 1)
+			continue;
+
+		float lit = 0;
+		[unroll]
+		for (int y = -1; y <= 1; y++)
+		{
+			[unroll]
+			for (int x = -1; x <= 1; x++)
+				lit += ShadowMap.SampleCmpLevelZero(ShadowSampler, float3(uv + float2(x, y) / shadowMapSize, c), shadowPosition.z);
+		}
+		return lit / 9;
+	}
+	return 1;
+}
+
+float UnpackProbeValue(ShProbe probe, uint index)
+{
+	return f16tof32(probe.halves[index / 2] >> ((index & 1) * 16));
+}
+
+// Blends the eight probes around a point; outside the grid, its nearest edge
+void SampleProbeGrid(float3 worldPosition, out float3 sh[9])
+{
+	float3 cell = clamp((worldPosition - probeGridMin) * probeGridInvCellSize, 0, (float3)(probeGridCounts - 1));
+	uint3 base = min((uint3)cell, probeGridCounts - 2);
+	float3 t = cell - base;
+
+	[unroll]
+	for (uint k = 0; k < 9; k++)
+		sh[k] = 0;
+
+	[unroll]
+	for (uint corner = 0; corner < 8; corner++)
+	{
+		uint3 offset = uint3(corner & 1, (corner >> 1) & 1, corner >> 2);
+		float3 weights = lerp(1 - t, t, (float3)offset);
+		uint3 p = base + offset;
+		ShProbe probe = Probes[(p.z * probeGridCounts.y + p.y) * probeGridCounts.x + p.x];
+
+		[unroll]
+		for (uint i = 0; i < 9; i++)
+		{
+			float3 value = float3(UnpackProbeValue(probe, i * 3), UnpackProbeValue(probe, i * 3 + 1), UnpackProbeValue(probe, i * 3 + 2));
+			sh[i] += value * (weights.x * weights.y * weights.z);
+		}
+	}
+}
+
+// The nine SH coefficients ambient light comes from: the sky's (or one
+// probe per entity) in shAmbient, or the grid's around this pixel
+void GetAmbientSh(float3 worldPosition, out float3 sh[9])
+{
+	if (ambientMode == AMBIENT_SH_GRID)
+	{
+		SampleProbeGrid(worldPosition, sh);
+	}
+	else
+	{
+		[unroll]
+		for (uint k = 0; k < 9; k++)
+			sh[k] = shAmbient[k].rgb;
+	}
+}
+
+// Irradiance (over pi) arriving around a direction
+float3 EvaluateSh(float3 sh[9], float3 n)
+{
+	float3 irradiance = sh[0]
+		+ sh[1] * n.y + sh[2] * n.z + sh[3] * n.x
+		+ sh[4] * (n.x * n.y) + sh[5] * (n.y * n.z) + sh[6] * (3 * n.z * n.z - 1)
+		+ sh[7] * (n.x * n.z) + sh[8] * (n.x * n.x - n.y * n.y);
+	return max(irradiance, 0);
+}
+
+// Ambient light from the sky: a few fetches instead of a loop.
+// Diffuse comes from nine SH coefficients (the sky's, or the probes'),
+// specular from the prefiltered cube and the BRDF table (the split-sum
+// approximation).
+float3 CalculateEnvironmentLight(float3 normal, float3 worldPosition, float3 dirToCamera, float roughnessValue, float metalnessValue, float3 surfaceValue)
+{
+	float3 sh[9];
+	GetAmbientSh(worldPosition, sh);
+	float3 irradiance = EvaluateSh(sh, normal);
+
+	// Determines the specular color
+	float3 specularColor = lerp(F0_NON_METAL.rrr, surfaceValue.rgb, metalnessValue);
+
+	float NdotV = saturate(dot(normal, dirToCamera));
+	float2 brdf = BrdfLut.SampleLevel(ClampSampler, float2(NdotV, roughnessValue), 0).rg;
+	float3 reflected = SpecularIbl.SampleLevel(ClampSampler, reflect(-dirToCamera, normal), roughnessValue * specularIblMips).rgb;
+	float3 specularValue = reflected * (specularColor * brdf.x + brdf.y);
+
+	// Calculate diffuse with energy conservation
+	float3 balancedDiff = DiffuseEnergyConserve(irradiance, specularColor * brdf.x + brdf.y, metalnessValue);
+
+	return (balancedDiff * surfaceValue + specularValue) * iblIntensity;
+}
+
+// Ambient light from the SH coefficients alone, for when the sky's
+// prefiltered cube and BRDF table aren't built (or are off): no texture
+// fetches besides the probes. The BRDF table's scale and bias come from
+// an analytic fit instead (Karis, "Physically Based Shading on Mobile"),
+// and the specular reflects the SH irradiance around the reflection, a
+// blurry stand-in for the prefiltered cube.
+float3 CalculateProbeAmbient(float3 normal, float3 worldPosition, float3 dirToCamera, float roughnessValue, float metalnessValue, float3 surfaceValue)
+{
+	float3 sh[9];
+	GetAmbientSh(worldPosition, sh);
+	float3 irradiance = EvaluateSh(sh, normal);
+
+	// Determines the specular color
+	float3 specularColor = lerp(F0_NON_METAL.rrr, surfaceValue.rgb, metalnessValue);
+
+	float NdotV = saturate(dot(normal, dirToCamera));
+	float4 r = roughnessValue * float4(-1, -0.0275f, -0.572f, 0.022f) + float4(1, 0.0425f, 1.04f, -0.04f);
+	float a004 = min(r.x * r.x, exp2(-9.28f * NdotV)) * r.x + r.y;
+	float2 brdf = float2(-1.04f, 1.04f) * a004 + r.zw;
+	float3 specularValue = EvaluateSh(sh, reflect(-dirToCamera, normal)) * (specularColor * brdf.x + brdf.y);
+
+	// Calculate diffuse with energy conservation
+	float3 balancedDiff = DiffuseEnergyConserve(irradiance, specularColor * brdf.x + brdf.y, metalnessValue);
+
+	return balancedDiff * surfaceValue + specularValue;
+}
 
 // --------------------------------------------------------
 // The entry point (main method) for our pixel shader
@@ -233,44 +481,120 @@ float3 CalculatePointLight(Light light, VertexToPixel inputData, float roughness
 // --------------------------------------------------------
 float4 main(VertexToPixel input) : SV_TARGET
 {
-	// Normalize the normals
+#ifdef BATCHED
+	MaterialParams material = Materials[input.materialIndex];
+	float4 colorTint = material.colorTint;
+	float uvScale = material.uvScale;
+	float2 uvOffset = material.uvOffset;
+#endif
+
+	// Normalize the normals; the unmapped one offsets shadow lookups
 	input.normal = normalize(input.normal);
+	float3 surfaceNormal = input.normal;
 
 	// Scales/Shifts the uvs
 	input.uv = (input.uv + uvOffset) * uvScale;
 
+#ifdef NO_ALBEDO_MAP
+	// Without a texture, the tint is the color
+	float3 surfaceColor = colorTint.rgb;
+#else
 	// Sets texture colors
-	float3 surfaceColor = pow(AlbedoTexture.Sample(BasicSampler, input.uv).rgb, 2.2f);
+	float3 surfaceColor = pow(SAMPLE_MAP(AlbedoTexture, input.uv).rgb, 2.2f);
 
 	// Tints the surface color with material surface
 	surfaceColor = surfaceColor * colorTint;
+#endif
 
-	// Unpacks the normals
-	float3 unpackedNormal = NormalMap.Sample(BasicSampler, input.uv).rgb * 2 - 1;
+#ifndef NO_NORMAL_MAP
+	// Unpacks the normals. Z is rebuilt from X and Y, so two-channel
+	// (BC5) normal maps work the same as RGB ones.
+	float3 unpackedNormal;
+	unpackedNormal.xy = SAMPLE_MAP(NormalMap, input.uv).rg * 2 - 1;
+	unpackedNormal.z = sqrt(saturate(1 - dot(unpackedNormal.xy, unpackedNormal.xy)));
 
 	// Creates a TBN matrix
 	float3 N = input.normal;
-	float3 T = normalize(input.tangent);
+	float3 T = normalize(input.tangent.xyz);
 	T = normalize(T - N * dot(T, N));
-	float3 B = cross(T, N);
+	float3 B = cross(T, N) * input.tangent.w;
 	float3x3 TBN = float3x3(T, B, N);
 
 	// Transform the unpacked normal
 	input.normal = mul(unpackedNormal, TBN);
-
-	// Samples the roughness map
-	float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
-
-	// Samples the metalness map
-	float metalness = MetalnessMap.Sample(BasicSampler, input.uv).r;
+#endif
+
+#ifdef NO_ORM_MAP
+	// Unoccluded and non-metal, at the material's own roughness
+	float occlusion = 1;
+	float metalness = 0;
+#ifdef BATCHED
+	float roughness = material.roughness;
+#endif
+#else
+	// Occlusion, roughness and metalness come from one packed fetch
+	float3 orm = SAMPLE_MAP(OrmMap, input.uv).rgb;
+	float occlusion = orm.r;
+	float roughness = orm.g;
+	float metalness = orm.b;
+#endif
 
 	// Adds lights values to the object
 	//float3 finalColor = surfaceColor + CalculateDirectionalLight(directionalLight1, input) + CalculateDirectionalLight(directionalLight2, input) + CalculateDirectionalLight(directionalLight3, input);
 	//finalColor += CalculatePointLight(pointLight1, input) + CalculatePointLight(pointLight2, input);
 
-	float3 finalColor = CalculateDirectionalLight(directionalLight1, input, roughness, metalness, surfaceColor) + CalculateDirectionalLight(directionalLight2, input, roughness, metalness, surfaceColor) +
-		CalculateDirectionalLight(directionalLight3, input, roughness, metalness, surfaceColor);
-	finalColor = finalColor + CalculatePointLight(pointLight1, input, roughness, metalness, surfaceColor) + CalculatePointLight(pointLight2, input, roughness, metalness, surfaceColor);
+	// Occlusion only darkens the ambient light; the lights are direct
+#if defined(PROBE_AMBIENT_ONLY)
+	// The probes' (or sky's) SH without the sky's cube, on even with it off
+	float3 dirToCamera = normalize(cameraPosition - input.worldPosition);
+	float3 finalColor = CalculateProbeAmbient(input.normal, input.worldPosition, dirToCamera, roughness, metalness, surfaceColor) * occlusion;
+#elif defined(NO_ENVIRONMENT_LIGHT)
+	// The sky's light is off (iblIntensity would be 0), so skip its fetches
+	float3 finalColor = 0;
+#else
+	float3 dirToCamera = normalize(cameraPosition - input.worldPosition);
+	float3 finalColor = CalculateEnvironmentLight(input.normal, input.worldPosition, dirToCamera, roughness, metalness, surfaceColor) * occlusion;
+#endif
+#ifdef COARSE_LIGHTING
+	// Lights at a quarter of the rate, like 2x2 variable-rate shading: each
+	// pixel of a quad takes every fourth light, starting from its place in
+	// the quad, and the quad adds up what its pixels found. Textures (and
+	// the sky's light) are still per pixel.
+	uint2 quadPosition = (uint2)input.screenPosition.xy & 1;
+	int quadIndex = quadPosition.x + quadPosition.y * 2;
+	float3 diffuseSum = 0;
+	float3 specularSum = 0;
+	LIGHT_LOOP
+	for (int first = 0; first < LIGHT_LOOP_COUNT; first += 4)
+	{
+		int i = first + quadIndex;
+		if (i < LIGHT_LOOP_COUNT)
+		{
+			float3 diffuse, specular;
+			CalculateLightParts(lights[i], input, roughness, metalness, surfaceColor, diffuse, specular);
+			float shadow = i == shadowLightIndex ? CalculateShadow(input.worldPosition, surfaceNormal) : 1.0f;
+			diffuseSum += diffuse * shadow;
+			specularSum += specular * shadow;
+		}
+	}
+	finalColor += QuadSum(diffuseSum, quadPosition) * surfaceColor + QuadSum(specularSum, quadPosition);
+#else
+	float shadow = CalculateShadow(input.worldPosition, surfaceNormal);
+	LIGHT_LOOP
+	for (int i = 0; i < LIGHT_LOOP_COUNT; i++)
+	{
+		switch (lights[i].Type)
+		{
+			case LIGHT_TYPE_DIRECTIONAL:
+				finalColor += CalculateDirectionalLight(lights[i], input, roughness, metalness, surfaceColor) * (i == shadowLightIndex ? shadow : 1.0f);
+				break;
+
+			case LIGHT_TYPE_POINT:
+				finalColor += CalculatePointLight(lights[i], input, roughness, metalness, surfaceColor);
+				break;
+		}
+	}
+#endif
 
 	return float4(pow(finalColor, 1.0f/2.2f), 1);
 }
\ No newline at end of file
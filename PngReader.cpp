@@ -0,0 +1,471 @@
+#include "PngReader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdlib.h>
+#include <string.h>
+
+// --------------------------------------------------------
+// Inflate (RFC 1950/1951)
+// --------------------------------------------------------
+
+// Canonical Huffman code: how many codes of each length, and the
+// symbols sorted by code
+struct HuffmanTable
+{
+	short Counts[16];
+	short Symbols[320];
+};
+
+struct InflateBits
+{
+	const unsigned char* Data;
+	size_t Size;
+	size_t Position;
+	unsigned int Buffer;
+	int Count;
+	bool Overrun;
+
+	int Read(int bits)
+	{
+		while (Count < bits)
+		{
+			if (Position >= Size)
+			{
+				Overrun = true;
+				return 0;
+			}
+			Buffer |= (unsigned int)Data[Position++] << Count;
+			Count += 8;
+		}
+
+		int value = (int)(Buffer & ((1u << bits) - 1));
+		Buffer >>= bits;
+		Count -= bits;
+		return value;
+	}
+};
+
+static bool BuildHuffman(HuffmanTable& table, const short* lengths, int count)
+{
+	memset(table.Counts, 0, sizeof(table.Counts));
+	for (int i = 0; i < count; i++)
+		table.Counts[lengths[i]]++;
+	if (table.Counts[0] == count)
+		return true;
+
+	// Over-subscribed code sets are invalid
+	int left = 1;
+	for (int length = 1; length < 16; length++)
+	{
+		left <<= 1;
+		left -= table.Counts[length];
+		if (left < 0)
+			return false;
+	}
+
+	short offsets[16];
+	offsets[1] = 0;
+	for (int length = 1; length < 15; length++)
+		offsets[length + 1] = offsets[length] + table.Counts[length];
+
+	for (int i = 0; i < count; i++)
+		if (lengths[i] != 0)
+			table.Symbols[offsets[lengths[i]]++] = (short)i;
+	return true;
+}
+
+static int DecodeSymbol(InflateBits& bits, const HuffmanTable& table)
+{
+	int code = 0, first = 0, index = 0;
+	for (int length = 1; length < 16; length++)
+	{
+		code |= bits.Read(1);
+		int count = table.Counts[length];
+		if (code - count < first)
+			return table.Symbols[index + (code - first)];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+// The fixed codes of block type 1, built once (thread safe, the
+// cooker decodes several files at a time)
+struct FixedHuffmanTables
+{
+	HuffmanTable Lengths;
+	HuffmanTable Distances;
+
+	FixedHuffmanTables()
+	{
+		short lengths[288];
+		for (int i = 0; i < 144; i++) lengths[i] = 8;
+		for (int i = 144; i < 256; i++) lengths[i] = 9;
+		for (int i = 256; i < 280; i++) lengths[i] = 7;
+		for (int i = 280; i < 288; i++) lengths[i] = 8;
+		BuildHuffman(Lengths, lengths, 288);
+
+		for (int i = 0; i < 30; i++) lengths[i] = 5;
+		BuildHuffman(Distances, lengths, 30);
+	}
+};
+
+static const FixedHuffmanTables& GetFixedTables()
+{
+	static FixedHuffmanTables tables;
+	return tables;
+}
+
+static const short LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const short LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const short DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const short DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static bool InflateCodes(InflateBits& bits, std::vector<unsigned char>& output, const HuffmanTable& lengths, const HuffmanTable& distances)
+{
+	while (true)
+	{
+		int symbol = DecodeSymbol(bits, lengths);
+		if (symbol < 0 || bits.Overrun)
+			return false;
+		if (symbol < 256)
+		{
+			output.push_back((unsigned char)symbol);
+			continue;
+		}
+		if (symbol == 256)
+			return true;
+
+		symbol -= 257;
+		if (symbol >= 29)
+			return false;
+		int length = LengthBase[symbol] + bits.Read(LengthExtra[symbol]);
+
+		symbol = DecodeSymbol(bits, distances);
+		if (symbol < 0 || symbol >= 30)
+			return false;
+		size_t distance = DistanceBase[symbol] + bits.Read(DistanceExtra[symbol]);
+		if (distance > output.size() || bits.Overrun)
+			return false;
+
+		// Copies can overlap themselves, so go a byte at a time
+		size_t from = output.size() - distance;
+		for (int i = 0; i < length; i++)
+			output.push_back(output[from + i]);
+	}
+}
+
+/// <summary>
+/// Decompresses a zlib stream (as stored in a PNG's IDAT chunks)
+/// </summary>
+/// <returns>False if the stream is damaged or truncated</returns>
+bool PngReader::Inflate(const unsigned char* data, size_t size, std::vector<unsigned char>& output)
+{
+	// zlib header: deflate, no preset dictionary
+	if (size < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20))
+		return false;
+
+	InflateBits bits = { data, size, 2, 0, 0, false };
+	bool last = false;
+	while (!last)
+	{
+		last = bits.Read(1) == 1;
+		int type = bits.Read(2);
+
+		if (type == 0)
+		{
+			// Stored: byte aligned length, its complement, then raw bytes
+			bits.Buffer = 0;
+			bits.Count = 0;
+			if (bits.Size - bits.Position < 4)
+				return false;
+			size_t length = bits.Data[bits.Position] | (bits.Data[bits.Position + 1] << 8);
+			bits.Position += 4;
+			if (bits.Size - bits.Position < length)
+				return false;
+			output.insert(output.end(), bits.Data + bits.Position, bits.Data + bits.Position + length);
+			bits.Position += length;
+		}
+		else if (type == 1)
+		{
+			// Fixed codes
+			const FixedHuffmanTables& fixed = GetFixedTables();
+			if (!InflateCodes(bits, output, fixed.Lengths, fixed.Distances))
+				return false;
+		}
+		else if (type == 2)
+		{
+			// Dynamic codes, themselves Huffman coded
+			int lengthCount = bits.Read(5) + 257;
+			int distanceCount = bits.Read(5) + 1;
+			int codeCount = bits.Read(4) + 4;
+			if (lengthCount > 286 || distanceCount > 30)
+				return false;
+
+			static const unsigned char order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+			short lengths[320] = {};
+			for (int i = 0; i < codeCount; i++)
+				lengths[order[i]] = (short)bits.Read(3);
+
+			HuffmanTable codeTable;
+			if (!BuildHuffman(codeTable, lengths, 19))
+				return false;
+
+			int index = 0;
+			while (index < lengthCount + distanceCount)
+			{
+				int symbol = DecodeSymbol(bits, codeTable);
+				if (symbol < 0 || bits.Overrun)
+					return false;
+
+				if (symbol < 16)
+				{
+					lengths[index++] = (short)symbol;
+					continue;
+				}
+
+				short repeat = 0;
+				int times;
+				if (symbol == 16)
+				{
+					if (index == 0)
+						return false;
+					repeat = lengths[index - 1];
+					times = 3 + bits.Read(2);
+				}
+				else if (symbol == 17)
+					times = 3 + bits.Read(3);
+				else
+					times = 11 + bits.Read(7);
+
+				if (index + times > lengthCount + distanceCount)
+					return false;
+				while (times-- > 0)
+					lengths[index++] = repeat;
+			}
+
+			HuffmanTable lengthTable, distanceTable;
+			if (!BuildHuffman(lengthTable, lengths, lengthCount) ||
+				!BuildHuffman(distanceTable, lengths + lengthCount, distanceCount) ||
+				!InflateCodes(bits, output, lengthTable, distanceTable))
+				return false;
+		}
+		else
+		{
+			return false;
+		}
+
+		if (bits.Overrun)
+			return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// PNG
+// --------------------------------------------------------
+static unsigned int ReadBigEndian(const unsigned char* bytes)
+{
+	return ((unsigned int)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+}
+
+static int PaethPredictor(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	if (pb <= pc) return b;
+	return c;
+}
+
+static bool Fail(std::string* error, const char* message)
+{
+	if (error)
+		*error = message;
+	return false;
+}
+
+/// <summary>
+/// Reads and decodes a PNG file
+/// </summary>
+/// <param name="error">Filled in with the reason on failure, if given</param>
+bool PngReader::Load(const std::string& path, CpuImage& image, std::string* error)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return Fail(error, "Unable to open file");
+
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Decode(data.data(), data.size(), image, error);
+}
+
+/// <summary>
+/// Decodes a PNG held in memory to RGBA8
+/// </summary>
+/// <param name="error">Filled in with the reason on failure, if given</param>
+bool PngReader::Decode(const unsigned char* data, size_t size, CpuImage& image, std::string* error)
+{
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	if (size < 8 || memcmp(data, signature, 8) != 0)
+		return Fail(error, "Not a PNG file");
+
+	unsigned int width = 0, height = 0;
+	int bitDepth = 0, colorType = -1, interlace = 0;
+	std::vector<unsigned char> palette;	// RGBA entries
+	std::vector<unsigned char> compressed;
+
+	// Walk the chunks, collecting what's needed
+	size_t position = 8;
+	while (size - position >= 12)
+	{
+		unsigned int length = ReadBigEndian(data + position);
+		const unsigned char* type = data + position + 4;
+		const unsigned char* body = data + position + 8;
+		if (size - position - 12 < length)
+			return Fail(error, "Truncated chunk");
+
+		if (memcmp(type, "IHDR", 4) == 0 && length >= 13)
+		{
+			width = ReadBigEndian(body);
+			height = ReadBigEndian(body + 4);
+			bitDepth = body[8];
+			colorType = body[9];
+			interlace = body[12];
+		}
+		else if (memcmp(type, "PLTE", 4) == 0)
+		{
+			for (unsigned int i = 0; i + 2 < length; i += 3)
+			{
+				palette.insert(palette.end(), body + i, body + i + 3);
+				palette.push_back(255);
+			}
+		}
+		else if (memcmp(type, "tRNS", 4) == 0 && colorType == 3)
+		{
+			for (unsigned int i = 0; i < length && i * 4 + 3 < palette.size(); i++)
+				palette[i * 4 + 3] = body[i];
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), body, body + length);
+		}
+		else if (memcmp(type, "IEND", 4) == 0)
+		{
+			break;
+		}
+
+		position += 12 + length;
+	}
+
+	if (width == 0 || height == 0 || colorType < 0)
+		return Fail(error, "Missing or empty IHDR chunk");
+	if (interlace != 0)
+		return Fail(error, "Interlaced PNGs are not supported");
+
+	int channels;
+	switch (colorType)
+	{
+		case 0: channels = 1; break;	// Gray
+		case 2: channels = 3; break;	// RGB
+		case 3: channels = 1; break;	// Palette
+		case 4: channels = 2; break;	// Gray + alpha
+		case 6: channels = 4; break;	// RGBA
+		default: return Fail(error, "Unknown color type");
+	}
+	if (bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16)
+		return Fail(error, "Unknown bit depth");
+	if (colorType == 3 && palette.empty())
+		return Fail(error, "Missing palette");
+
+	std::vector<unsigned char> filtered;
+	filtered.reserve((size_t)height * (((size_t)width * channels * bitDepth + 7) / 8 + 1));
+	if (!Inflate(compressed.data(), compressed.size(), filtered))
+		return Fail(error, "Damaged image data");
+
+	// Each row is a filter byte then the packed samples
+	size_t stride = ((size_t)width * channels * bitDepth + 7) / 8;
+	size_t bytesPerPixel = (std::max)((size_t)1, (size_t)channels * bitDepth / 8);
+	if (filtered.size() < height * (stride + 1))
+		return Fail(error, "Not enough image data");
+
+	std::vector<unsigned char> rows(height * stride);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		int filter = filtered[y * (stride + 1)];
+		const unsigned char* source = &filtered[y * (stride + 1) + 1];
+		unsigned char* row = &rows[y * stride];
+		const unsigned char* above = y > 0 ? &rows[(y - 1) * stride] : 0;
+
+		for (size_t x = 0; x < stride; x++)
+		{
+			int a = x >= bytesPerPixel ? row[x - bytesPerPixel] : 0;
+			int b = above ? above[x] : 0;
+			int c = above && x >= bytesPerPixel ? above[x - bytesPerPixel] : 0;
+
+			int predicted;
+			switch (filter)
+			{
+				case 0: predicted = 0; break;
+				case 1: predicted = a; break;
+				case 2: predicted = b; break;
+				case 3: predicted = (a + b) / 2; break;
+				case 4: predicted = PaethPredictor(a, b, c); break;
+				default: return Fail(error, "Unknown row filter");
+			}
+			row[x] = (unsigned char)(source[x] + predicted);
+		}
+	}
+
+	// Expand whatever we have to RGBA8
+	image.Width = width;
+	image.Height = height;
+	image.Pixels.resize((size_t)width * height * 4);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		const unsigned char* row = &rows[y * stride];
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned char samples[4];
+			for (int c = 0; c < channels; c++)
+			{
+				size_t index = (size_t)x * channels + c;
+				if (bitDepth == 8)
+					samples[c] = row[index];
+				else if (bitDepth == 16)
+					samples[c] = row[index * 2];
+				else
+				{
+					// Packed from the high bits down
+					size_t bit = index * bitDepth;
+					int value = (row[bit / 8] >> (8 - bitDepth - bit % 8)) & ((1 << bitDepth) - 1);
+					samples[c] = colorType == 3 ? (unsigned char)value : (unsigned char)(value * 255 / ((1 << bitDepth) - 1));
+				}
+			}
+
+			unsigned char* pixel = &image.Pixels[((size_t)y * width + x) * 4];
+			switch (colorType)
+			{
+				case 0: pixel[0] = pixel[1] = pixel[2] = samples[0]; pixel[3] = 255; break;
+				case 2: pixel[0] = samples[0]; pixel[1] = samples[1]; pixel[2] = samples[2]; pixel[3] = 255; break;
+				case 4: pixel[0] = pixel[1] = pixel[2] = samples[0]; pixel[3] = samples[1]; break;
+				case 6: memcpy(pixel, samples, 4); break;
+				case 3:
+				{
+					size_t entry = (size_t)samples[0] * 4;
+					if (entry + 3 < palette.size())
+						memcpy(pixel, &palette[entry], 4);
+					else
+						memcpy(pixel, "\0\0\0\xFF", 4);
+					break;
+				}
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// An 8-bit RGBA image in memory, rows top to bottom
+struct CpuImage
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	std::vector<unsigned char> Pixels;
+};
+
+// --------------------------------------------------------
+// Small, dependency-free PNG decoder for the offline tools,
+// which can't use WIC outside of Windows. Handles every
+// non-interlaced color type at 1 to 16 bits per channel;
+// 16-bit channels keep their top 8 bits.
+// --------------------------------------------------------
+class PngReader
+{
+	public:
+		static bool Load(const std::string& path, CpuImage& image, std::string* error = 0);
+		static bool Decode(const unsigned char* data, size_t size, CpuImage& image, std::string* error = 0);
+
+		// zlib stream -> bytes
+		static bool Inflate(const unsigned char* data, size_t size, std::vector<unsigned char>& output);
+};
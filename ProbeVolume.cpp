@@ -0,0 +1,121 @@
+#include "ProbeVolume.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace DirectX;
+
+// The shader's ambientMode (must match AMBIENT_* in ShaderIncludes.hlsli)
+static const int AmbientShConstants = 0;
+static const int AmbientShGrid = 1;
+
+/// <summary>
+/// Constructor. Nothing is baked until Build().
+/// </summary>
+ProbeVolume::ProbeVolume(
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context)
+	:
+	device(_device),
+	context(_context),
+	mode(AmbientMode::Sky),
+	ready(false),
+	bakeMs(0.0)
+{
+}
+
+/// <summary>
+/// Bakes the grid and uploads it
+/// </summary>
+/// <param name="boundsMin">Corner of the box the probes cover</param>
+/// <param name="boundsMax">Opposite corner</param>
+/// <param name="counts">Probes along x, y and z</param>
+/// <param name="skyRadiance">From EnvironmentLighting::GetSkyRadiance(); BuildDiffuse() is enough</param>
+/// <param name="bakedLights">Lights that aren't drawn directly; spot lights are baked as point lights</param>
+/// <returns>False if the buffer can't be created</returns>
+bool ProbeVolume::Build(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, const unsigned int counts[3],
+	const ShCoefficients& skyRadiance, const std::vector<Light>& bakedLights)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ready = false;
+
+	std::vector<ProbeLight> probeLights;
+	for (const Light& light : bakedLights)
+	{
+		ProbeLight probeLight;
+		probeLight.Type = light.Type == LIGHT_TYPE_DIRECTIONAL ? LIGHT_TYPE_DIRECTIONAL : LIGHT_TYPE_POINT;
+		probeLight.Direction[0] = light.Direction.x; probeLight.Direction[1] = light.Direction.y; probeLight.Direction[2] = light.Direction.z;
+		probeLight.Position[0] = light.Position.x; probeLight.Position[1] = light.Position.y; probeLight.Position[2] = light.Position.z;
+		probeLight.Color[0] = light.Color.x; probeLight.Color[1] = light.Color.y; probeLight.Color[2] = light.Color.z;
+		probeLight.Intensity = light.Intensity;
+		probeLight.Range = light.Range;
+		probeLights.push_back(probeLight);
+	}
+
+	const float minimum[3] = { boundsMin.x, boundsMin.y, boundsMin.z };
+	const float maximum[3] = { boundsMax.x, boundsMax.y, boundsMax.z };
+	grid.Bake(minimum, maximum, counts, skyRadiance, probeLights);
+
+	std::vector<PackedShProbe> packed;
+	grid.Pack(packed);
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = (UINT)(sizeof(PackedShProbe) * packed.size());
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = sizeof(PackedShProbe);
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = packed.data();
+
+	probeBuffer.Reset();
+	probeSRV.Reset();
+	if (FAILED(device->CreateBuffer(&desc, &data, probeBuffer.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(probeBuffer.Get(), 0, probeSRV.GetAddressOf())))
+		return false;
+
+	ready = true;
+	bakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+/// <summary>
+/// Sets the probe buffer and grid constants. Call after
+/// EnvironmentLighting::Bind(), since one probe per entity
+/// replaces its coefficients, and before CopyAllBufferData().
+/// </summary>
+/// <param name="entityPosition">Where the entity is in world space (ex. its bounds' center), or null for batched draws</param>
+void ProbeVolume::Bind(std::shared_ptr<SimplePixelShader> pixelShader, const XMFLOAT3* entityPosition)
+{
+	if (!ready || mode == AmbientMode::Sky)
+	{
+		pixelShader->SetInt("ambientMode", AmbientShConstants);
+		return;
+	}
+
+	if (mode == AmbientMode::ProbePerEntity && entityPosition)
+	{
+		const float position[3] = { entityPosition->x, entityPosition->y, entityPosition->z };
+		float shAmbient[9][4];
+		IblPrecompute::PackForShader(grid.Sample(position), shAmbient);
+		pixelShader->SetData("shAmbient", shAmbient, sizeof(shAmbient));
+		pixelShader->SetInt("ambientMode", AmbientShConstants);
+		return;
+	}
+
+	ProbeGridLayout layout = grid.GetLayout();
+	pixelShader->SetShaderResourceView("Probes", probeSRV);
+	pixelShader->SetInt("ambientMode", AmbientShGrid);
+	pixelShader->SetFloat3("probeGridMin", XMFLOAT3(layout.Min[0], layout.Min[1], layout.Min[2]));
+	pixelShader->SetFloat3("probeGridInvCellSize", XMFLOAT3(1.0f / layout.CellSize[0], 1.0f / layout.CellSize[1], 1.0f / layout.CellSize[2]));
+	pixelShader->SetData("probeGridCounts", layout.Counts, sizeof(layout.Counts));
+}
+
+// Getters
+bool ProbeVolume::IsReady() { return ready; }
+AmbientMode ProbeVolume::GetMode() { return mode; }
+size_t ProbeVolume::GetProbeCount() { return grid.GetProbeCount(); }
+double ProbeVolume::GetBakeMs() { return bakeMs; }
+
+// Setters
+void ProbeVolume::SetMode(AmbientMode _mode) { mode = _mode; }
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+#include "Light.h"
+#include "ShProbeGrid.h"
+#include "SimpleShader.h"
+
+// Where the diffuse ambient light's SH coefficients come from
+enum class AmbientMode
+{
+	Sky,				// EnvironmentLighting's, the same everywhere
+	ProbePerEntity,		// The grid, sampled on the CPU at each entity's position
+	ProbePerPixel		// The grid, sampled in the pixel shader
+};
+
+// --------------------------------------------------------
+// An ShProbeGrid on the GPU: the probes go into a structured
+// buffer, half floats, 56 bytes each. Bind() points the
+// pixel shader's ambient term at the sky's coefficients,
+// one probe per entity, or the grid itself.
+//
+// Batched draws have no per-entity constants, so they read
+// the grid per pixel in either probe mode.
+// --------------------------------------------------------
+class ProbeVolume
+{
+	public:
+		ProbeVolume(
+			Microsoft::WRL::ComPtr<ID3D11Device> _device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context);
+
+		bool Build(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, const unsigned int counts[3],
+			const ShCoefficients& skyRadiance, const std::vector<Light>& bakedLights);
+		void Bind(std::shared_ptr<SimplePixelShader> pixelShader, const DirectX::XMFLOAT3* entityPosition);
+
+		// Getters
+		bool IsReady();
+		AmbientMode GetMode();
+		size_t GetProbeCount();
+		double GetBakeMs();
+
+		// Setters
+		void SetMode(AmbientMode _mode);
+
+	private:
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+		ShProbeGrid grid;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> probeBuffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> probeSRV;
+
+		AmbientMode mode;
+		bool ready;
+		double bakeMs;
+};
@@ -0,0 +1,442 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ PROFILE AGGREGATOR --------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+/// <summary>
+/// Constructor for the aggregator
+/// </summary>
+/// <param name="_smoothing">Weight of a new sample in the moving average (0-1)</param>
+ProfileAggregator::ProfileAggregator(double _smoothing)
+{
+	smoothing = _smoothing;
+}
+
+/// <summary>
+/// Adds a single timing sample to the named scope, creating it if necessary
+/// </summary>
+/// <param name="name">The name of the scope</param>
+/// <param name="milliseconds">The measured duration</param>
+void ProfileAggregator::AddSample(const std::string& name, double milliseconds)
+{
+	auto it = lookup.find(name);
+	if (it == lookup.end())
+	{
+		ProfileScopeStats newStats;
+		newStats.Name = name;
+		newStats.AverageMs = milliseconds;
+		newStats.MinMs = milliseconds;
+		newStats.MaxMs = milliseconds;
+		it = lookup.insert({ name, stats.size() }).first;
+		stats.push_back(newStats);
+	}
+
+	ProfileScopeStats& s = stats[it->second];
+	s.LastMs = milliseconds;
+	s.AverageMs += (milliseconds - s.AverageMs) * smoothing;
+	s.MinMs = std::min(s.MinMs, milliseconds);
+	s.MaxMs = std::max(s.MaxMs, milliseconds);
+	s.TotalMs += milliseconds;
+	s.SampleCount++;
+}
+
+/// <summary>
+/// Removes all scopes and samples
+/// </summary>
+void ProfileAggregator::Reset()
+{
+	stats.clear();
+	lookup.clear();
+}
+
+/// <summary>
+/// Finds the stats for a named scope
+/// </summary>
+/// <returns>The stats, or null if the scope has never been sampled</returns>
+const ProfileScopeStats* ProfileAggregator::GetStats(const std::string& name) const
+{
+	auto it = lookup.find(name);
+	return it == lookup.end() ? nullptr : &stats[it->second];
+}
+
+const std::vector<ProfileScopeStats>& ProfileAggregator::GetAllStats() const { return stats; }
+
+/// <summary>
+/// Builds a human readable table of every scope
+/// </summary>
+/// <param name="title">Header line for the table</param>
+std::string ProfileAggregator::ToString(const char* title) const
+{
+	std::string result = title;
+	result += "\n";
+
+	char line[256];
+	for (const ProfileScopeStats& s : stats)
+	{
+		snprintf(line, sizeof(line), "  %-24s last %8.3fms  avg %8.3fms  min %8.3fms  max %8.3fms\n",
+			s.Name.c_str(), s.LastMs, s.AverageMs, s.MinMs, s.MaxMs);
+		result += line;
+	}
+
+	return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ CPU PROFILER --------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+/// <summary>
+/// Constructor for the CPU profiler
+/// </summary>
+CpuProfiler::CpuProfiler()
+{
+	frameStart = std::chrono::high_resolution_clock::now();
+}
+
+/// <summary>
+/// Marks the start of a frame
+/// </summary>
+void CpuProfiler::BeginFrame()
+{
+	openScopes.clear();
+	frameTotals.clear();
+	frameStart = std::chrono::high_resolution_clock::now();
+}
+
+/// <summary>
+/// Closes any scopes left open and pushes this frame's totals into the stats
+/// </summary>
+void CpuProfiler::EndFrame()
+{
+	while (!openScopes.empty())
+		EndScope(openScopes.back().Name.c_str());
+
+	std::chrono::duration<double, std::milli> frameTime = std::chrono::high_resolution_clock::now() - frameStart;
+	aggregator.AddSample("Frame", frameTime.count());
+
+	for (auto& total : frameTotals)
+		aggregator.AddSample(total.first, total.second);
+	frameTotals.clear();
+}
+
+/// <summary>
+/// Starts timing a named scope. Scopes may be nested.
+/// </summary>
+void CpuProfiler::BeginScope(const char* name)
+{
+	OpenScope scope;
+	scope.Name = name;
+	scope.Start = std::chrono::high_resolution_clock::now();
+	openScopes.push_back(scope);
+}
+
+/// <summary>
+/// Stops timing the innermost open scope
+/// </summary>
+/// <param name="name">The name it was begun with, to catch mismatched Begin/End pairs</param>
+void CpuProfiler::EndScope(const char* name)
+{
+	if (openScopes.empty())
+		return;
+
+	(void)name;	// Only checked in debug builds
+	assert(openScopes.back().Name == name && "EndScope doesn't match the innermost BeginScope");
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - openScopes.back().Start;
+	AddToFrame(openScopes.back().Name, elapsed.count());
+	openScopes.pop_back();
+}
+
+/// <summary>
+/// Accumulates a duration into this frame's total for the named scope
+/// </summary>
+void CpuProfiler::AddToFrame(const std::string& name, double milliseconds)
+{
+	for (auto& total : frameTotals)
+	{
+		if (total.first == name)
+		{
+			total.second += milliseconds;
+			return;
+		}
+	}
+	frameTotals.push_back({ name, milliseconds });
+}
+
+const ProfileAggregator& CpuProfiler::GetStats() const { return aggregator; }
+void CpuProfiler::ResetStats() { aggregator.Reset(); }
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ HEADLESS GPU BACKEND ------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+/// <summary>
+/// Constructor for the synthetic timestamp backend
+/// </summary>
+/// <param name="_latencyFrames">How many frames must end before a slot's results are readable</param>
+/// <param name="_frequency">Ticks per second reported with the results</param>
+/// <param name="_ticksPerTimestamp">Amount the fake clock advances on every timestamp write</param>
+HeadlessGpuTimestampBackend::HeadlessGpuTimestampBackend(unsigned int _latencyFrames, unsigned long long _frequency, unsigned long long _ticksPerTimestamp)
+{
+	latencyFrames = _latencyFrames;
+	frequency = _frequency;
+	ticksPerTimestamp = _ticksPerTimestamp;
+	clock = 0;
+	framesEnded = 0;
+	disjointNextFrame = false;
+}
+
+void HeadlessGpuTimestampBackend::BeginFrame(unsigned int slot)
+{
+	if (slot >= slots.size())
+		slots.resize(slot + 1);
+
+	slots[slot].Timestamps.clear();
+	slots[slot].Disjoint = false;
+}
+
+void HeadlessGpuTimestampBackend::WriteTimestamp(unsigned int slot, unsigned int index)
+{
+	std::vector<unsigned long long>& timestamps = slots[slot].Timestamps;
+	if (index >= timestamps.size())
+		timestamps.resize(index + 1, 0);
+
+	timestamps[index] = clock;
+	clock += ticksPerTimestamp;
+}
+
+/// <summary>
+/// The GPU still works through a frame the profiler skips, so it
+/// counts toward the latency like any other
+/// </summary>
+void HeadlessGpuTimestampBackend::SkipFrame()
+{
+	framesEnded++;
+}
+
+void HeadlessGpuTimestampBackend::EndFrame(unsigned int slot)
+{
+	framesEnded++;
+	slots[slot].EndedOnFrame = framesEnded;
+	slots[slot].Disjoint = disjointNextFrame;
+	disjointNextFrame = false;
+}
+
+/// <summary>
+/// Returns the synthetic timestamps once enough frames have passed
+/// </summary>
+bool HeadlessGpuTimestampBackend::TryReadFrame(unsigned int slot, unsigned int timestampCount, unsigned long long* timestamps, unsigned long long& _frequency, bool& disjoint)
+{
+	if (slot >= slots.size() || framesEnded - slots[slot].EndedOnFrame < latencyFrames)
+		return false;
+
+	const std::vector<unsigned long long>& source = slots[slot].Timestamps;
+	for (unsigned int i = 0; i < timestampCount; i++)
+		timestamps[i] = i < source.size() ? source[i] : 0;
+
+	_frequency = frequency;
+	disjoint = slots[slot].Disjoint;
+	return true;
+}
+
+void HeadlessGpuTimestampBackend::AdvanceClock(unsigned long long ticks) { clock += ticks; }
+void HeadlessGpuTimestampBackend::SetDisjoint(bool _disjoint) { disjointNextFrame = _disjoint; }
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ GPU PROFILER --------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+/// <summary>
+/// Constructor for the GPU profiler
+/// </summary>
+/// <param name="_backend">Where timestamps come from (D3D11 queries or synthetic)</param>
+GpuProfiler::GpuProfiler(std::shared_ptr<GpuTimestampBackend> _backend)
+{
+	backend = _backend;
+	frameIndex = 0;
+	droppedFrames = 0;
+	recording = false;
+}
+
+/// <summary>
+/// Starts recording a frame in the next slot of the latency ring. If the
+/// GPU is so far behind that the slot is still in flight, the frame is
+/// skipped instead of waiting on it.
+/// </summary>
+void GpuProfiler::BeginFrame()
+{
+	ResolvePendingFrames();
+
+	unsigned int slot = (unsigned int)(frameIndex % FrameLatency);
+	FrameSlot& frame = slots[slot];
+	openScopes.clear();
+
+	if (frame.Pending)
+	{
+		recording = false;
+		droppedFrames++;
+		backend->SkipFrame();
+		return;
+	}
+
+	recording = true;
+	frame.FrameNumber = frameIndex;
+	frame.TimestampCount = 0;
+	frame.Scopes.clear();
+	backend->BeginFrame(slot);
+
+	// The whole frame is always the first scope
+	BeginScope("Frame");
+}
+
+/// <summary>
+/// Closes the frame and harvests any older frames whose results are ready
+/// </summary>
+void GpuProfiler::EndFrame()
+{
+	if (recording)
+	{
+		while (!openScopes.empty())
+			EndScope(nullptr);
+
+		unsigned int slot = (unsigned int)(frameIndex % FrameLatency);
+		backend->EndFrame(slot);
+		slots[slot].Pending = true;
+		recording = false;
+	}
+
+	frameIndex++;
+	ResolvePendingFrames();
+}
+
+/// <summary>
+/// Starts timing a named scope. Scopes may be nested.
+/// </summary>
+void GpuProfiler::BeginScope(const char* name)
+{
+	if (!recording)
+		return;
+
+	FrameSlot& frame = slots[frameIndex % FrameLatency];
+
+	// Out of queries for this frame, so the scope is ignored
+	// (EndScope still needs something to pop). Every scope
+	// already open still owes its end timestamp.
+	size_t owedEnds = openScopes.size() - std::count(openScopes.begin(), openScopes.end(), UINT32_MAX);
+	if (frame.TimestampCount + owedEnds + 2 > MaxTimestampsPerFrame)
+	{
+		openScopes.push_back(UINT32_MAX);
+		return;
+	}
+
+	ScopeRecord record;
+	record.Name = name;
+	record.BeginIndex = WriteTimestamp();
+	record.EndIndex = UINT32_MAX;
+	openScopes.push_back((unsigned int)frame.Scopes.size());
+	frame.Scopes.push_back(record);
+}
+
+/// <summary>
+/// Stops timing the innermost open scope
+/// </summary>
+/// <param name="name">The name it was begun with, to catch mismatched Begin/End pairs (null closes whatever is open)</param>
+void GpuProfiler::EndScope(const char* name)
+{
+	if (!recording || openScopes.empty())
+		return;
+
+	unsigned int scope = openScopes.back();
+	openScopes.pop_back();
+	if (scope == UINT32_MAX)
+		return;
+
+	ScopeRecord& record = slots[frameIndex % FrameLatency].Scopes[scope];
+	(void)name;	// Only checked in debug builds
+	assert((!name || record.Name == name) && "EndScope doesn't match the innermost BeginScope");
+	record.EndIndex = WriteTimestamp();
+}
+
+/// <summary>
+/// Issues the next timestamp query in the current slot
+/// </summary>
+/// <returns>The index of the timestamp within the slot</returns>
+unsigned int GpuProfiler::WriteTimestamp()
+{
+	unsigned int slot = (unsigned int)(frameIndex % FrameLatency);
+	unsigned int index = slots[slot].TimestampCount++;
+	backend->WriteTimestamp(slot, index);
+	return index;
+}
+
+/// <summary>
+/// Reads back pending frames oldest-first, stopping at the first one that
+/// is not ready so samples are always aggregated in submission order
+/// </summary>
+void GpuProfiler::ResolvePendingFrames()
+{
+	while (true)
+	{
+		unsigned int oldest = UINT32_MAX;
+		for (unsigned int i = 0; i < FrameLatency; i++)
+		{
+			if (slots[i].Pending && (oldest == UINT32_MAX || slots[i].FrameNumber < slots[oldest].FrameNumber))
+				oldest = i;
+		}
+
+		if (oldest == UINT32_MAX || !TryResolveSlot(oldest))
+			return;
+	}
+}
+
+/// <summary>
+/// Converts one slot's timestamps into per-scope durations
+/// </summary>
+/// <returns>False if the backend has no data for the slot yet</returns>
+bool GpuProfiler::TryResolveSlot(unsigned int slot)
+{
+	FrameSlot& frame = slots[slot];
+	unsigned long long timestamps[MaxTimestampsPerFrame] = {};
+	unsigned long long frequency = 0;
+	bool disjoint = false;
+
+	if (!backend->TryReadFrame(slot, frame.TimestampCount, timestamps, frequency, disjoint))
+		return false;
+
+	frame.Pending = false;
+
+	// A disjoint frame (clock change, power event, etc.) has meaningless timestamps
+	if (disjoint || frequency == 0)
+	{
+		droppedFrames++;
+		return true;
+	}
+
+	// Sum repeated scopes so a scope opened in a loop reports its frame total
+	std::vector<std::pair<std::string, double>> totals;
+	for (const ScopeRecord& record : frame.Scopes)
+	{
+		if (record.EndIndex == UINT32_MAX || timestamps[record.EndIndex] < timestamps[record.BeginIndex])
+			continue;
+
+		double ms = (double)(timestamps[record.EndIndex] - timestamps[record.BeginIndex]) * 1000.0 / (double)frequency;
+
+		auto it = std::find_if(totals.begin(), totals.end(), [&](const std::pair<std::string, double>& t) { return t.first == record.Name; });
+		if (it == totals.end()) totals.push_back({ record.Name, ms });
+		else it->second += ms;
+	}
+
+	for (auto& total : totals)
+		aggregator.AddSample(total.first, total.second);
+
+	return true;
+}
+
+const ProfileAggregator& GpuProfiler::GetStats() const { return aggregator; }
+unsigned long long GpuProfiler::GetDroppedFrameCount() const { return droppedFrames; }
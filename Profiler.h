@@ -0,0 +1,214 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --------------------------------------------------------
+// Rolling timing statistics for a single named scope
+// --------------------------------------------------------
+struct ProfileScopeStats
+{
+	std::string Name;
+	double LastMs = 0.0;
+	double AverageMs = 0.0;		// Exponential moving average
+	double MinMs = 0.0;
+	double MaxMs = 0.0;
+	double TotalMs = 0.0;		// For exact means over a whole run
+	unsigned long long SampleCount = 0;
+};
+
+// Collects samples for named scopes, shared by the CPU and GPU profilers
+class ProfileAggregator
+{
+	public:
+		ProfileAggregator(double _smoothing = 0.1);
+
+		void AddSample(const std::string& name, double milliseconds);
+		void Reset();
+
+		// Getters
+		const ProfileScopeStats* GetStats(const std::string& name) const;
+		const std::vector<ProfileScopeStats>& GetAllStats() const;
+		std::string ToString(const char* title) const;
+
+	private:
+		double smoothing;
+
+		// Stats are kept in order of first appearance so reports are stable
+		std::vector<ProfileScopeStats> stats;
+		std::unordered_map<std::string, size_t> lookup;
+};
+
+// --------------------------------------------------------
+// RAII helper that opens a named scope on any profiler
+// exposing BeginScope()/EndScope(), ex:
+//
+//  ProfileScope<GpuProfiler> scope(*gpuProfiler, "Sky");
+// --------------------------------------------------------
+template<typename TProfiler>
+class ProfileScope
+{
+	public:
+		ProfileScope(TProfiler& _profiler, const char* _name) : profiler(_profiler), name(_name) { profiler.BeginScope(name); }
+		~ProfileScope() { profiler.EndScope(name); }
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		TProfiler& profiler;
+		const char* name;
+};
+
+// --------------------------------------------------------
+// CPU timer using the high resolution clock
+// --------------------------------------------------------
+class CpuProfiler
+{
+	public:
+		CpuProfiler();
+
+		// Frame and scope markers
+		void BeginFrame();
+		void EndFrame();
+		void BeginScope(const char* name);
+		void EndScope(const char* name);
+
+		// Getters
+		const ProfileAggregator& GetStats() const;
+		void ResetStats();
+
+	private:
+		struct OpenScope
+		{
+			std::string Name;
+			std::chrono::high_resolution_clock::time_point Start;
+		};
+
+		void AddToFrame(const std::string& name, double milliseconds);
+
+		std::vector<OpenScope> openScopes;
+		std::vector<std::pair<std::string, double>> frameTotals;	// Repeated scopes are summed per frame
+		std::chrono::high_resolution_clock::time_point frameStart;
+		ProfileAggregator aggregator;
+};
+
+// --------------------------------------------------------
+// Source of GPU timestamps. Each in-flight frame owns a
+// "slot" holding one disjoint query and a fixed number of
+// timestamp queries, so results can be read back several
+// frames later without stalling the pipeline.
+// --------------------------------------------------------
+class GpuTimestampBackend
+{
+	public:
+		virtual ~GpuTimestampBackend() {}
+
+		virtual void BeginFrame(unsigned int slot) = 0;
+		virtual void WriteTimestamp(unsigned int slot, unsigned int index) = 0;
+		virtual void EndFrame(unsigned int slot) = 0;
+
+		// A frame the profiler didn't record because its slot was still in flight
+		virtual void SkipFrame() {}
+
+		// Must never block. Returns false if the slot's data is not ready yet.
+		virtual bool TryReadFrame(
+			unsigned int slot,
+			unsigned int timestampCount,
+			unsigned long long* timestamps,
+			unsigned long long& frequency,
+			bool& disjoint) = 0;
+};
+
+// --------------------------------------------------------
+// Backend without a GPU: hands out synthetic timestamps from a
+// fake clock and only reports a frame as ready after a fixed
+// number of later frames, mimicking real query latency.
+// --------------------------------------------------------
+class HeadlessGpuTimestampBackend : public GpuTimestampBackend
+{
+	public:
+		HeadlessGpuTimestampBackend(unsigned int _latencyFrames = 2, unsigned long long _frequency = 1000000, unsigned long long _ticksPerTimestamp = 0);
+
+		void BeginFrame(unsigned int slot);
+		void WriteTimestamp(unsigned int slot, unsigned int index);
+		void EndFrame(unsigned int slot);
+		void SkipFrame();
+		bool TryReadFrame(unsigned int slot, unsigned int timestampCount, unsigned long long* timestamps, unsigned long long& frequency, bool& disjoint);
+
+		// Simulated GPU work between two timestamps
+		void AdvanceClock(unsigned long long ticks);
+
+		// Marks the frame currently being recorded as disjoint
+		void SetDisjoint(bool _disjoint);
+
+	private:
+		struct Slot
+		{
+			std::vector<unsigned long long> Timestamps;
+			unsigned long long EndedOnFrame = 0;
+			bool Disjoint = false;
+		};
+
+		unsigned int latencyFrames;
+		unsigned long long frequency;
+		unsigned long long ticksPerTimestamp;
+		unsigned long long clock;
+		unsigned long long framesEnded;
+		bool disjointNextFrame;
+		std::vector<Slot> slots;
+};
+
+// --------------------------------------------------------
+// GPU profiler with the same named-scope API as CpuProfiler.
+// Results show up FrameLatency frames after they are recorded.
+// --------------------------------------------------------
+class GpuProfiler
+{
+	public:
+		static const unsigned int FrameLatency = 4;
+		static const unsigned int MaxTimestampsPerFrame = 64;
+
+		GpuProfiler(std::shared_ptr<GpuTimestampBackend> _backend);
+
+		// Frame and scope markers
+		void BeginFrame();
+		void EndFrame();
+		void BeginScope(const char* name);
+		void EndScope(const char* name);
+
+		// Getters
+		const ProfileAggregator& GetStats() const;
+		unsigned long long GetDroppedFrameCount() const;
+
+	private:
+		struct ScopeRecord
+		{
+			std::string Name;
+			unsigned int BeginIndex;
+			unsigned int EndIndex;
+		};
+
+		struct FrameSlot
+		{
+			bool Pending = false;
+			unsigned long long FrameNumber = 0;
+			unsigned int TimestampCount = 0;
+			std::vector<ScopeRecord> Scopes;
+		};
+
+		void ResolvePendingFrames();
+		bool TryResolveSlot(unsigned int slot);
+		unsigned int WriteTimestamp();
+
+		std::shared_ptr<GpuTimestampBackend> backend;
+		FrameSlot slots[FrameLatency];
+		std::vector<unsigned int> openScopes;	// Indices into the current slot's scopes
+		unsigned long long frameIndex;
+		unsigned long long droppedFrames;
+		bool recording;
+		ProfileAggregator aggregator;
+};
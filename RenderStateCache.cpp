@@ -0,0 +1,198 @@
+#include "RenderStateCache.h"
+#include "ShaderCache.h"
+
+#include <string.h>
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+// Descriptions are hashed and compared as bytes, so each is
+// copied field by field into a zeroed one: padding is always
+// zero, and any nonzero BOOL becomes TRUE
+static D3D11_SAMPLER_DESC Normalize(const D3D11_SAMPLER_DESC& desc)
+{
+	D3D11_SAMPLER_DESC normalized;
+	memset(&normalized, 0, sizeof(normalized));
+	normalized.Filter = desc.Filter;
+	normalized.AddressU = desc.AddressU;
+	normalized.AddressV = desc.AddressV;
+	normalized.AddressW = desc.AddressW;
+	normalized.MipLODBias = desc.MipLODBias;
+	normalized.MaxAnisotropy = desc.MaxAnisotropy;
+	normalized.ComparisonFunc = desc.ComparisonFunc;
+	for (int i = 0; i < 4; i++)
+		normalized.BorderColor[i] = desc.BorderColor[i];
+	normalized.MinLOD = desc.MinLOD;
+	normalized.MaxLOD = desc.MaxLOD;
+	return normalized;
+}
+
+static D3D11_RASTERIZER_DESC Normalize(const D3D11_RASTERIZER_DESC& desc)
+{
+	D3D11_RASTERIZER_DESC normalized;
+	memset(&normalized, 0, sizeof(normalized));
+	normalized.FillMode = desc.FillMode;
+	normalized.CullMode = desc.CullMode;
+	normalized.FrontCounterClockwise = desc.FrontCounterClockwise ? TRUE : FALSE;
+	normalized.DepthBias = desc.DepthBias;
+	normalized.DepthBiasClamp = desc.DepthBiasClamp;
+	normalized.SlopeScaledDepthBias = desc.SlopeScaledDepthBias;
+	normalized.DepthClipEnable = desc.DepthClipEnable ? TRUE : FALSE;
+	normalized.ScissorEnable = desc.ScissorEnable ? TRUE : FALSE;
+	normalized.MultisampleEnable = desc.MultisampleEnable ? TRUE : FALSE;
+	normalized.AntialiasedLineEnable = desc.AntialiasedLineEnable ? TRUE : FALSE;
+	return normalized;
+}
+
+// Has two bytes of padding after the stencil masks
+static D3D11_DEPTH_STENCIL_DESC Normalize(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+	D3D11_DEPTH_STENCIL_DESC normalized;
+	memset(&normalized, 0, sizeof(normalized));
+	normalized.DepthEnable = desc.DepthEnable ? TRUE : FALSE;
+	normalized.DepthWriteMask = desc.DepthWriteMask;
+	normalized.DepthFunc = desc.DepthFunc;
+	normalized.StencilEnable = desc.StencilEnable ? TRUE : FALSE;
+	normalized.StencilReadMask = desc.StencilReadMask;
+	normalized.StencilWriteMask = desc.StencilWriteMask;
+	normalized.FrontFace = desc.FrontFace;
+	normalized.BackFace = desc.BackFace;
+	return normalized;
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+RenderStateCache::RenderStateCache(
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context)
+	:
+	device(_device),
+	context(_context),
+	boundValid(false)
+{
+}
+
+/// <summary>
+/// Finds (or creates) the sampler state for a description
+/// </summary>
+/// <returns>Its ID, or 0 (the default sampler) if it can't be created</returns>
+RenderStateId RenderStateCache::GetSamplerId(const D3D11_SAMPLER_DESC& desc)
+{
+	return Find(samplers, Normalize(desc), [this](const D3D11_SAMPLER_DESC& d, ID3D11SamplerState** state)
+	{
+		return device->CreateSamplerState(&d, state);
+	});
+}
+
+/// <summary>
+/// Finds (or creates) the rasterizer state for a description
+/// </summary>
+/// <returns>Its ID, or 0 (the default state) if it can't be created</returns>
+RenderStateId RenderStateCache::GetRasterizerId(const D3D11_RASTERIZER_DESC& desc)
+{
+	return Find(rasterizers, Normalize(desc), [this](const D3D11_RASTERIZER_DESC& d, ID3D11RasterizerState** state)
+	{
+		return device->CreateRasterizerState(&d, state);
+	});
+}
+
+/// <summary>
+/// Finds (or creates) the depth-stencil state for a description
+/// </summary>
+/// <returns>Its ID, or 0 (the default state) if it can't be created</returns>
+RenderStateId RenderStateCache::GetDepthStencilId(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+	return Find(depthStencils, Normalize(desc), [this](const D3D11_DEPTH_STENCIL_DESC& d, ID3D11DepthStencilState** state)
+	{
+		return device->CreateDepthStencilState(&d, state);
+	});
+}
+
+/// <summary>
+/// Binds a draw's rasterizer and depth-stencil states, skipping
+/// whichever already match what was bound last
+/// </summary>
+void RenderStateCache::Apply(const RenderState& state)
+{
+	if (!boundValid || state.Rasterizer != bound.Rasterizer)
+	{
+		context->RSSetState(GetRasterizer(state.Rasterizer).Get());
+		stats.Binds++;
+	}
+	else
+	{
+		stats.BindsSkipped++;
+	}
+
+	if (!boundValid || state.DepthStencil != bound.DepthStencil)
+	{
+		context->OMSetDepthStencilState(GetDepthStencil(state.DepthStencil).Get(), 0);
+		stats.Binds++;
+	}
+	else
+	{
+		stats.BindsSkipped++;
+	}
+
+	bound = state;
+	boundValid = true;
+}
+
+/// <summary>
+/// Forgets what's bound, so the next Apply() sets everything
+/// </summary>
+void RenderStateCache::Invalidate()
+{
+	boundValid = false;
+}
+
+// Getters
+Microsoft::WRL::ComPtr<ID3D11SamplerState> RenderStateCache::GetSampler(RenderStateId id) { return id > 0 && id <= samplers.States.size() ? samplers.States[id - 1] : nullptr; }
+Microsoft::WRL::ComPtr<ID3D11RasterizerState> RenderStateCache::GetRasterizer(RenderStateId id) { return id > 0 && id <= rasterizers.States.size() ? rasterizers.States[id - 1] : nullptr; }
+Microsoft::WRL::ComPtr<ID3D11DepthStencilState> RenderStateCache::GetDepthStencil(RenderStateId id) { return id > 0 && id <= depthStencils.States.size() ? depthStencils.States[id - 1] : nullptr; }
+
+RenderStateStats RenderStateCache::GetStats()
+{
+	stats.Samplers = (unsigned int)samplers.States.size();
+	stats.Rasterizers = (unsigned int)rasterizers.States.size();
+	stats.DepthStencils = (unsigned int)depthStencils.States.size();
+	return stats;
+}
+
+/// <summary>
+/// Looks a normalized description up in a table, creating its
+/// state object the first time it's seen
+/// </summary>
+/// <param name="create">Makes the D3D object, returning an HRESULT</param>
+template<typename Desc, typename State, typename Create>
+RenderStateId RenderStateCache::Find(StateTable<Desc, State>& table, const Desc& desc, Create create)
+{
+	stats.Lookups++;
+
+	unsigned long long hash = ShaderCache::Hash(&desc, sizeof(Desc));
+	auto range = table.Lookup.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (memcmp(&table.Descs[it->second - 1], &desc, sizeof(Desc)) == 0)
+		{
+			stats.Hits++;
+			return it->second;
+		}
+	}
+
+	// IDs have to fit in a RenderStateId
+	if (table.States.size() >= 0xFFFF)
+		return 0;
+
+	Microsoft::WRL::ComPtr<State> state;
+	if (FAILED(create(desc, state.GetAddressOf())))
+		return 0;
+
+	table.Descs.push_back(desc);
+	table.States.push_back(state);
+	RenderStateId id = (RenderStateId)table.States.size();
+	table.Lookup.insert({ hash, id });
+	return id;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <unordered_map>
+#include <vector>
+
+// Small integer handle to a state object in a RenderStateCache.
+// 0 always means D3D's default (null) state.
+typedef unsigned short RenderStateId;
+
+// The fixed-function state a draw needs, by ID
+struct RenderState
+{
+	RenderStateId Rasterizer = 0;
+	RenderStateId DepthStencil = 0;
+
+	// Both IDs in one integer, for sorting and comparing draws
+	unsigned int GetKey() const { return ((unsigned int)Rasterizer << 16) | DepthStencil; }
+};
+
+struct RenderStateStats
+{
+	unsigned int Samplers = 0;		// Unique state objects created
+	unsigned int Rasterizers = 0;
+	unsigned int DepthStencils = 0;
+	unsigned long long Lookups = 0;	// Get*Id() calls
+	unsigned long long Hits = 0;	// ...that found an existing object
+	unsigned long long Binds = 0;	// State changes Apply() made
+	unsigned long long BindsSkipped = 0;	// ...and ones it didn't need to
+};
+
+// --------------------------------------------------------
+// Creates each distinct sampler, rasterizer and depth-stencil
+// state once. Descriptions are hashed (after clearing any
+// padding and normalizing BOOLs), so asking for the same one
+// again returns the same ID and the same immutable object,
+// whoever asks.
+//
+// Apply() binds a RenderState, skipping any part that's the
+// same as the last one it bound. Call Invalidate() if anything
+// else may have changed the context's state since.
+// --------------------------------------------------------
+class RenderStateCache
+{
+	public:
+		RenderStateCache(
+			Microsoft::WRL::ComPtr<ID3D11Device> _device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context);
+
+		RenderStateId GetSamplerId(const D3D11_SAMPLER_DESC& desc);
+		RenderStateId GetRasterizerId(const D3D11_RASTERIZER_DESC& desc);
+		RenderStateId GetDepthStencilId(const D3D11_DEPTH_STENCIL_DESC& desc);
+
+		void Apply(const RenderState& state);
+		void Invalidate();
+
+		// Getters
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> GetSampler(RenderStateId id);
+		Microsoft::WRL::ComPtr<ID3D11RasterizerState> GetRasterizer(RenderStateId id);
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilState> GetDepthStencil(RenderStateId id);
+		RenderStateStats GetStats();
+
+	private:
+		// One kind of state: descriptions and objects share an index (ID - 1)
+		template<typename Desc, typename State>
+		struct StateTable
+		{
+			std::vector<Desc> Descs;
+			std::vector<Microsoft::WRL::ComPtr<State>> States;
+			std::unordered_multimap<unsigned long long, RenderStateId> Lookup;	// Hash of the desc to its ID
+		};
+
+		template<typename Desc, typename State, typename Create>
+		RenderStateId Find(StateTable<Desc, State>& table, const Desc& desc, Create create);
+
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+		StateTable<D3D11_SAMPLER_DESC, ID3D11SamplerState> samplers;
+		StateTable<D3D11_RASTERIZER_DESC, ID3D11RasterizerState> rasterizers;
+		StateTable<D3D11_DEPTH_STENCIL_DESC, ID3D11DepthStencilState> depthStencils;
+
+		// What Apply() last bound
+		RenderState bound;
+		bool boundValid;
+
+		RenderStateStats stats;
+};
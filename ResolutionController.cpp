@@ -0,0 +1,90 @@
+#include "ResolutionController.h"
+
+#include <algorithm>
+#include <math.h>
+
+/// <summary>
+/// Creates a controller that starts at the largest scale
+/// </summary>
+ResolutionController::ResolutionController(ResolutionSettings _settings) :
+	settings(_settings)
+{
+	settings.MinScale = (std::max)(0.01f, settings.MinScale);
+	settings.MaxScale = (std::max)(settings.MinScale, settings.MaxScale);
+	Reset(settings.MaxScale);
+}
+
+/// <summary>
+/// Feeds in one frame's GPU time
+/// </summary>
+/// <returns>True if the applied scale changed</returns>
+bool ResolutionController::AddSample(float gpuMs)
+{
+	if (!(gpuMs > 0.0f) || !(settings.TargetMs > 0.0f))
+		return false;
+
+	// Frames that ran on the old scale say little about the new one
+	if (cooldown > 0)
+	{
+		cooldown--;
+		return false;
+	}
+
+	float weight = (std::max)(0.0f, (std::min)(1.0f, settings.Smoothing));
+	averageMs = averageMs > 0.0f ? averageMs + (gpuMs - averageMs) * weight : gpuMs;
+	float error = logf(settings.TargetMs / averageMs);
+	if (fabsf(error) < logf(1.0f + settings.Deadband))
+		error = 0.0f;
+
+	float minLogArea = 2.0f * logf(settings.MinScale), maxLogArea = 2.0f * logf(settings.MaxScale);
+	logArea += settings.Proportional * (error - error1) + settings.Integral * error + settings.Derivative * (error - 2.0f * error1 + error2);
+	logArea = (std::max)(minLogArea, (std::min)(maxLogArea, logArea));
+	error2 = error1;
+	error1 = error;
+
+	// Scales sit on a grid of steps down from the largest; moving takes
+	// wanting to be a whole step away, or pinned at a limit
+	float desired = GetDesiredScale();
+	bool atLimit = logArea <= minLogArea || logArea >= maxLogArea;
+	if (fabsf(desired - scale) < settings.Step && !atLimit)
+		return false;
+	float stepped = settings.MaxScale - roundf((settings.MaxScale - desired) / settings.Step) * settings.Step;
+	stepped = (std::max)(settings.MinScale, (std::min)(settings.MaxScale, stepped));
+	if (stepped == scale)
+		return false;
+	scale = stepped;
+	cooldown = settings.Cooldown;
+	changes++;
+	return true;
+}
+
+/// <summary>
+/// Jumps to a scale and forgets the past samples
+/// </summary>
+void ResolutionController::Reset(float _scale)
+{
+	scale = (std::max)(settings.MinScale, (std::min)(settings.MaxScale, _scale));
+	logArea = 2.0f * logf(scale);
+	averageMs = 0.0f;
+	error1 = 0.0f;
+	error2 = 0.0f;
+	cooldown = 0;
+	changes = 0;
+}
+
+// Getters
+float ResolutionController::GetScale() { return scale; }
+const ResolutionSettings& ResolutionController::GetSettings() { return settings; }
+unsigned int ResolutionController::GetChangeCount() { return changes; }
+
+/// <summary>
+/// Returns the scale the controller is heading for, before it's
+/// rounded to a step
+/// </summary>
+float ResolutionController::GetDesiredScale()
+{
+	return expf(logArea * 0.5f);
+}
+
+// Setters
+void ResolutionController::SetTargetMs(float targetMs) { settings.TargetMs = targetMs; }
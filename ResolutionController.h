@@ -0,0 +1,62 @@
+#pragma once
+
+struct ResolutionSettings
+{
+	float TargetMs = 16.0f;		// The GPU frame time to hold
+	float MinScale = 0.5f;		// Of each axis
+	float MaxScale = 1.0f;
+	float Proportional = 0.25f;	// Gains, on the log of target / measured time
+	float Integral = 0.2f;
+	float Derivative = 0.05f;
+	float Smoothing = 0.2f;		// Weight of each new time in the running average the error comes from
+	float Deadband = 0.08f;		// Times within this fraction of the target count as on target
+	float Step = 1.0f / 32.0f;	// The applied scale moves in steps this big (and only if it's a whole step off)
+	unsigned int Cooldown = 4;	// Samples to wait after a change, while timings from before it come in
+};
+
+// --------------------------------------------------------
+// Picks the render resolution from measured GPU frame times.
+// GPU time goes roughly with the pixel count, so the
+// controller works on the log of the area: the error is
+// log(target / measured), and a PID in velocity form moves
+// the log area by
+//
+//  Kp * (e - e1) + Ki * e + Kd * (e - 2 e1 + e2)
+//
+// each sample (with Ki = 1 and the others 0, one sample
+// jumps straight to the area that would have hit the
+// target). Velocity form has no integral to wind up when
+// the scale is clamped.
+//
+// Hysteresis comes four ways: the error is taken from a
+// running average of the times, errors inside the dead band
+// are zero, the applied scale only moves by whole steps,
+// and after a change it holds for a few samples, since GPU
+// timings arrive frames late.
+// --------------------------------------------------------
+class ResolutionController
+{
+	public:
+		ResolutionController(ResolutionSettings _settings = ResolutionSettings());
+
+		bool AddSample(float gpuMs);
+		void Reset(float scale);
+
+		// Getters
+		float GetScale();
+		float GetDesiredScale();
+		const ResolutionSettings& GetSettings();
+		unsigned int GetChangeCount();
+
+		// Setters
+		void SetTargetMs(float targetMs);
+
+	private:
+		ResolutionSettings settings;
+		float logArea;			// Where the controller wants to be, unquantized
+		float scale;			// What's applied
+		float averageMs;		// Smoothed GPU time, 0 until the first sample
+		float error1, error2;	// The last two samples' errors
+		unsigned int cooldown;
+		unsigned int changes;
+};
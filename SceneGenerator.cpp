@@ -0,0 +1,221 @@
+#include "SceneGenerator.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+using namespace DirectX;
+
+/// <summary>
+/// Short description of the settings, used in benchmark reports
+/// </summary>
+std::string SceneSettings::ToString() const
+{
+	char text[256];
+	snprintf(text, sizeof(text), "seed %u, %u entities, %u meshes, %u materials, depth %u, %u lights, %s motion",
+		Seed, EntityCount, MeshVariety, MaterialVariety, HierarchyDepth, LightCount, SceneGenerator::GetMotionName(Motion));
+	return text;
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+/// <param name="_settings">What to generate</param>
+SceneGenerator::SceneGenerator(SceneSettings _settings)
+	: settings(_settings), rng(_settings.Seed), radius(0.0f)
+{
+	settings.HierarchyDepth = (std::max)(settings.HierarchyDepth, 1u);
+}
+
+/// <summary>
+/// Builds the scene. Entities are laid out on a jittered grid, children are
+/// attached to random entities one level up, and materials are copies of the
+/// base materials with their own tint, roughness and UV offset.
+/// </summary>
+/// <param name="meshPoolSize">Meshes to pick from</param>
+/// <param name="materialPoolSize">Materials to copy from</param>
+/// <param name="makeMaterial">Makes each generated material, before any entity</param>
+/// <param name="makeEntity">Makes each generated entity</param>
+/// <param name="lights">Replaced with the generated lights</param>
+void SceneGenerator::Generate(
+	unsigned int meshPoolSize,
+	unsigned int materialPoolSize,
+	MaterialFactory makeMaterial,
+	EntityFactory makeEntity,
+	std::vector<Light>& lights)
+{
+	// Always start from the seed so generating twice gives the same scene
+	rng.seed(settings.Seed);
+	motions.clear();
+
+	if (meshPoolSize == 0 || materialPoolSize == 0)
+		return;
+
+	unsigned int meshCount = settings.MeshVariety == 0 ? meshPoolSize : (std::min)(settings.MeshVariety, meshPoolSize);
+	unsigned int materialCount = settings.MaterialVariety == 0 ? materialPoolSize : settings.MaterialVariety;
+
+	// Material variations
+	for (unsigned int i = 0; i < materialCount; i++)
+	{
+		MaterialVariation variation;
+		variation.BaseMaterial = i % materialPoolSize;
+		variation.ColorTint = XMFLOAT4(RandomFloat(0.5f, 1.0f), RandomFloat(0.5f, 1.0f), RandomFloat(0.5f, 1.0f), 1.0f);
+		variation.Roughness = RandomFloat(0.1f, 1.0f);
+		variation.UvOffset = XMFLOAT2(RandomFloat(0.0f, 1.0f), RandomFloat(0.0f, 1.0f));
+		makeMaterial(variation);
+	}
+
+	// Entities are split evenly between hierarchy levels
+	unsigned int perLevel = (settings.EntityCount + settings.HierarchyDepth - 1) / settings.HierarchyDepth;
+	unsigned int gridSide = (unsigned int)ceilf(sqrtf((float)(std::max)(perLevel, 1u)));
+	radius = gridSide * settings.Spacing * 0.5f * 1.4142f;
+
+	std::vector<Transform*> transforms;
+	for (unsigned int i = 0; i < settings.EntityCount; i++)
+	{
+		unsigned int level = i / perLevel;
+		// Drawn one at a time so the order doesn't depend on the compiler
+		unsigned int mesh = RandomIndex(meshCount);
+		unsigned int material = RandomIndex(materialCount);
+		Transform* transform = makeEntity(mesh, material);
+
+		XMFLOAT3 position;
+		XMFLOAT3 rotation(0.0f, RandomFloat(0.0f, XM_2PI), 0.0f);
+		if (level == 0)
+		{
+			// Roots go on a jittered grid centered on the origin
+			float half = (gridSide - 1) * 0.5f;
+			position.x = ((i % gridSide) - half) * settings.Spacing + RandomFloat(-0.25f, 0.25f) * settings.Spacing;
+			position.y = RandomFloat(-1.0f, 1.0f);
+			position.z = ((i / gridSide) - half) * settings.Spacing + RandomFloat(-0.25f, 0.25f) * settings.Spacing;
+		}
+		else
+		{
+			// Children sit a little way from a random entity on the level above
+			unsigned int parentIndex = (level - 1) * perLevel + RandomIndex(perLevel);
+			transform->SetParent(transforms[parentIndex]);
+			transform->SetScale(0.6f, 0.6f, 0.6f);
+
+			float angle = RandomFloat(0.0f, XM_2PI);
+			position = XMFLOAT3(cosf(angle) * 2.0f, RandomFloat(-0.5f, 1.5f), sinf(angle) * 2.0f);
+		}
+
+		transform->SetPosition(position.x, position.y, position.z);
+		transform->SetRotation(rotation.x, rotation.y, rotation.z);
+		transforms.push_back(transform);
+
+		// Picks how (and if) the entity moves
+		MotionPattern pattern = settings.Motion;
+		if (pattern == MotionPattern::Mixed)
+			pattern = (MotionPattern)RandomIndex((unsigned int)MotionPattern::Mixed);
+
+		float speed = RandomFloat(0.25f, 1.5f);
+		float phase = RandomFloat(0.0f, XM_2PI);
+		float amount = RandomFloat(0.25f, 1.0f);
+		if (pattern != MotionPattern::Static)
+			motions.push_back({ transform, pattern, position, rotation, speed, phase, amount });
+	}
+
+	// One sun plus point lights scattered over the scene
+	lights.clear();
+	for (unsigned int i = 0; i < settings.LightCount; i++)
+	{
+		Light light = {};
+		if (i == 0)
+		{
+			light.Type = LIGHT_TYPE_DIRECTIONAL;
+			light.Direction = XMFLOAT3(1.0f, -1.0f, 0.5f);
+			light.Color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+			light.Intensity = 0.6f;
+		}
+		else
+		{
+			light.Type = LIGHT_TYPE_POINT;
+			light.Position = XMFLOAT3(RandomFloat(-radius, radius), RandomFloat(1.0f, 4.0f), RandomFloat(-radius, radius));
+			light.Range = settings.Spacing * 2.0f;
+			light.Color = XMFLOAT3(RandomFloat(0.2f, 1.0f), RandomFloat(0.2f, 1.0f), RandomFloat(0.2f, 1.0f));
+			light.Intensity = 2.0f;
+		}
+		lights.push_back(light);
+	}
+}
+
+/// <summary>
+/// Moves the generated entities. Only depends on the total time,
+/// never on the frame's delta, so every run is identical.
+/// </summary>
+void SceneGenerator::Update(float totalTime)
+{
+	for (EntityMotion& motion : motions)
+	{
+		Transform* transform = motion.Target;
+		float t = totalTime * motion.Speed + motion.Phase;
+		const XMFLOAT3& p = motion.BasePosition;
+		const XMFLOAT3& r = motion.BaseRotation;
+
+		switch (motion.Pattern)
+		{
+			case MotionPattern::Spin:
+				transform->SetRotation(r.x, r.y + t, r.z);
+				break;
+
+			case MotionPattern::Orbit:
+				transform->SetPosition(p.x + cosf(t) * motion.Amount, p.y, p.z + sinf(t) * motion.Amount);
+				break;
+
+			case MotionPattern::Bob:
+				transform->SetPosition(p.x, p.y + sinf(t) * motion.Amount, p.z);
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+// Getters
+const SceneSettings& SceneGenerator::GetSettings() { return settings; }
+float SceneGenerator::GetRadius() { return radius; }
+
+/// <summary>
+/// Converts a command line name into a motion pattern
+/// </summary>
+MotionPattern SceneGenerator::ParseMotion(const std::string& name)
+{
+	if (name == "static") return MotionPattern::Static;
+	if (name == "spin") return MotionPattern::Spin;
+	if (name == "orbit") return MotionPattern::Orbit;
+	if (name == "bob") return MotionPattern::Bob;
+	return MotionPattern::Mixed;
+}
+
+/// <summary>
+/// Name of a motion pattern, matching ParseMotion()
+/// </summary>
+const char* SceneGenerator::GetMotionName(MotionPattern motion)
+{
+	switch (motion)
+	{
+		case MotionPattern::Static: return "static";
+		case MotionPattern::Spin: return "spin";
+		case MotionPattern::Orbit: return "orbit";
+		case MotionPattern::Bob: return "bob";
+		default: return "mixed";
+	}
+}
+
+/// <summary>
+/// Uniform float in [min, max). Built directly on the generator's output
+/// because the standard distributions differ between library versions.
+/// </summary>
+float SceneGenerator::RandomFloat(float min, float max)
+{
+	return min + (max - min) * (float)((rng() >> 8) * (1.0 / 16777216.0));
+}
+
+/// <summary>
+/// Uniform index in [0, count)
+/// </summary>
+unsigned int SceneGenerator::RandomIndex(unsigned int count)
+{
+	return count == 0 ? 0 : (unsigned int)(rng() % count);
+}
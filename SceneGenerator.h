@@ -0,0 +1,105 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include "Light.h"
+#include "Transform.h"
+
+// How generated entities move over time
+enum class MotionPattern
+{
+	Static,		// Never moves
+	Spin,		// Rotates in place
+	Orbit,		// Circles its spawn point
+	Bob,		// Moves up and down
+	Mixed		// Picks one of the above per entity
+};
+
+// --------------------------------------------------------
+// Parameters for a generated stress scene. The same settings
+// (including the seed) always produce the same scene.
+// --------------------------------------------------------
+struct SceneSettings
+{
+	unsigned int Seed = 1;
+	unsigned int EntityCount = 0;		// 0 keeps the hand-built scene
+	unsigned int MeshVariety = 0;		// Distinct meshes to use, 0 for every mesh given
+	unsigned int MaterialVariety = 0;	// Distinct materials to create, 0 for one per base material
+	unsigned int HierarchyDepth = 1;	// Levels of parenting, 1 means every entity is a root
+	unsigned int LightCount = 5;		// Only MAX_LIGHTS of these reach the shader
+	MotionPattern Motion = MotionPattern::Mixed;
+	float Spacing = 3.0f;				// Distance between root entities
+
+	std::string ToString() const;
+};
+
+// A generated copy of one of the base materials
+struct MaterialVariation
+{
+	unsigned int BaseMaterial;		// Index into the material pool
+	DirectX::XMFLOAT4 ColorTint;
+	float Roughness;
+	DirectX::XMFLOAT2 UvOffset;
+};
+
+// --------------------------------------------------------
+// Builds a procedural scene out of existing meshes and
+// materials, and animates it as a pure function of time so
+// runs can be repeated exactly.
+//
+// The generator picks and places; the caller's factories
+// make the actual materials and entities, so it only ever
+// touches their transforms (and runs without a device, ex.
+// in Tools/SceneUpdate).
+// --------------------------------------------------------
+class SceneGenerator
+{
+	public:
+		// Called once per generated material, in order
+		typedef std::function<void(const MaterialVariation& variation)> MaterialFactory;
+
+		// Makes an entity from a mesh (index into the mesh pool) and a
+		// generated material, and hands back its transform, which has
+		// to live as long as the generator
+		typedef std::function<Transform*(unsigned int mesh, unsigned int material)> EntityFactory;
+
+		SceneGenerator(SceneSettings _settings);
+
+		void Generate(
+			unsigned int meshPoolSize,
+			unsigned int materialPoolSize,
+			MaterialFactory makeMaterial,
+			EntityFactory makeEntity,
+			std::vector<Light>& lights);
+		void Update(float totalTime);
+
+		// Getters
+		const SceneSettings& GetSettings();
+		float GetRadius();
+
+		static MotionPattern ParseMotion(const std::string& name);
+		static const char* GetMotionName(MotionPattern motion);
+
+	private:
+		struct EntityMotion
+		{
+			Transform* Target;
+			MotionPattern Pattern;
+			DirectX::XMFLOAT3 BasePosition;
+			DirectX::XMFLOAT3 BaseRotation;
+			float Speed;
+			float Phase;
+			float Amount;
+		};
+
+		float RandomFloat(float min, float max);
+		unsigned int RandomIndex(unsigned int count);
+
+		SceneSettings settings;
+		std::mt19937 rng;
+		std::vector<EntityMotion> motions;
+		float radius;
+};
@@ -0,0 +1,341 @@
+#include "ShProbeGrid.h"
+#include "CpuUtilities.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SH_PROBE_GRID_AVX2
+#if defined(_MSC_VER)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+static const float Pi = 3.14159265359f;
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+// A face's direction is U * u + V * v + W (see IblPrecompute::GetDirection)
+struct FaceAxes
+{
+	float U[3];
+	float V[3];
+	float W[3];
+};
+
+static const FaceAxes Faces[6] = {
+	{ { 0, 0, -1 }, { 0, -1, 0 }, { 1, 0, 0 } },
+	{ { 0, 0, 1 }, { 0, -1, 0 }, { -1, 0, 0 } },
+	{ { 1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+	{ { 1, 0, 0 }, { 0, 0, -1 }, { 0, -1, 0 } },
+	{ { 1, 0, 0 }, { 0, -1, 0 }, { 0, 0, 1 } },
+	{ { -1, 0, 0 }, { 0, -1, 0 }, { 0, 0, -1 } } };
+
+// Radiance times basis times solid angle for one row, from texel first on.
+// |U u + V v + W| is sqrt(1 + u^2 + v^2), so one reciprocal square root
+// both normalizes the direction and (cubed) gives the solid angle.
+static void ProjectRow(const float* texels, unsigned int first, unsigned int size, float v, const FaceAxes& axes, float sums[27], float& weightSum)
+{
+	float texelArea = 4.0f / ((float)size * size);
+	for (unsigned int x = first; x < size; x++)
+	{
+		float u = 2.0f * (x + 0.5f) / size - 1.0f;
+		float inverseLength = 1.0f / sqrtf(1.0f + u * u + v * v);
+		float direction[3];
+		for (int i = 0; i < 3; i++)
+			direction[i] = (axes.U[i] * u + axes.V[i] * v + axes.W[i]) * inverseLength;
+		float weight = texelArea * inverseLength * inverseLength * inverseLength;
+
+		float basis[9];
+		IblPrecompute::GetBasis(direction, basis);
+		for (int i = 0; i < 9; i++)
+			for (int c = 0; c < 3; c++)
+				sums[i * 3 + c] += basis[i] * texels[x * 3 + c] * weight;
+		weightSum += weight;
+	}
+}
+
+#ifdef SH_PROBE_GRID_AVX2
+// ProjectRow(), eight texels at a time
+// Returns where it stopped; the scalar version finishes the row
+AVX2_FUNCTION static unsigned int ProjectRowAvx2(const float* texels, unsigned int size, float v, const FaceAxes& axes, float sums[27], float& weightSum)
+{
+	const float* k = IblPrecompute::ShBasis;
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 three = _mm256_set1_ps(3.0f);
+	const __m256 texelArea = _mm256_set1_ps(4.0f / ((float)size * size));
+	const __m256 step = _mm256_set1_ps(2.0f / size);
+	const __m256 vVector = _mm256_set1_ps(v);
+	const __m256 vSquaredPlusOne = _mm256_set1_ps(1.0f + v * v);
+	const __m256i lanes = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+
+	__m256 accumulators[27];
+	for (int i = 0; i < 27; i++)
+		accumulators[i] = _mm256_setzero_ps();
+	__m256 weights = _mm256_setzero_ps();
+
+	unsigned int count = size & ~7u;
+	for (unsigned int x = 0; x < count; x += 8)
+	{
+		__m256 texel = _mm256_add_ps(_mm256_set1_ps((float)x + 0.5f), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+		__m256 u = _mm256_sub_ps(_mm256_mul_ps(texel, step), one);
+		__m256 inverseLength = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(vSquaredPlusOne, _mm256_mul_ps(u, u))));
+
+		__m256 d[3];
+		for (int i = 0; i < 3; i++)
+		{
+			__m256 axis = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(axes.U[i]), u), _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(axes.V[i]), vVector), _mm256_set1_ps(axes.W[i])));
+			d[i] = _mm256_mul_ps(axis, inverseLength);
+		}
+		__m256 weight = _mm256_mul_ps(texelArea, _mm256_mul_ps(inverseLength, _mm256_mul_ps(inverseLength, inverseLength)));
+		weights = _mm256_add_ps(weights, weight);
+
+		__m256 basis[9];
+		basis[0] = _mm256_set1_ps(k[0]);
+		basis[1] = _mm256_mul_ps(_mm256_set1_ps(k[1]), d[1]);
+		basis[2] = _mm256_mul_ps(_mm256_set1_ps(k[2]), d[2]);
+		basis[3] = _mm256_mul_ps(_mm256_set1_ps(k[3]), d[0]);
+		basis[4] = _mm256_mul_ps(_mm256_set1_ps(k[4]), _mm256_mul_ps(d[0], d[1]));
+		basis[5] = _mm256_mul_ps(_mm256_set1_ps(k[5]), _mm256_mul_ps(d[1], d[2]));
+		basis[6] = _mm256_mul_ps(_mm256_set1_ps(k[6]), _mm256_sub_ps(_mm256_mul_ps(three, _mm256_mul_ps(d[2], d[2])), one));
+		basis[7] = _mm256_mul_ps(_mm256_set1_ps(k[7]), _mm256_mul_ps(d[0], d[2]));
+		basis[8] = _mm256_mul_ps(_mm256_set1_ps(k[8]), _mm256_sub_ps(_mm256_mul_ps(d[0], d[0]), _mm256_mul_ps(d[1], d[1])));
+
+		// Texels are interleaved RGB, so each channel is a stride 3 gather
+		for (int c = 0; c < 3; c++)
+		{
+			__m256 radiance = _mm256_mul_ps(_mm256_i32gather_ps(texels + x * 3 + c, lanes, 4), weight);
+			for (int i = 0; i < 9; i++)
+				accumulators[i * 3 + c] = _mm256_add_ps(accumulators[i * 3 + c], _mm256_mul_ps(basis[i], radiance));
+		}
+	}
+
+	float values[8];
+	for (int i = 0; i < 27; i++)
+	{
+		_mm256_storeu_ps(values, accumulators[i]);
+		for (int lane = 0; lane < 8; lane++)
+			sums[i] += values[lane];
+	}
+	_mm256_storeu_ps(values, weights);
+	for (int lane = 0; lane < 8; lane++)
+		weightSum += values[lane];
+	return count;
+}
+#endif
+
+// Every row of one face; rows are summed in floats, faces in doubles
+static void ProjectFace(const CubeImage& cube, unsigned int face, bool simd, double sums[27], double& weightSum)
+{
+	for (unsigned int y = 0; y < cube.Size; y++)
+	{
+		const float* row = &cube.Faces[face][(size_t)y * cube.Size * 3];
+		float v = 2.0f * (y + 0.5f) / cube.Size - 1.0f;
+
+		float rowSums[27] = {};
+		float rowWeight = 0.0f;
+		unsigned int x = 0;
+#ifdef SH_PROBE_GRID_AVX2
+		if (simd)
+			x = ProjectRowAvx2(row, cube.Size, v, Faces[face], rowSums, rowWeight);
+#endif
+		ProjectRow(row, x, cube.Size, v, Faces[face], rowSums, rowWeight);
+
+		for (int i = 0; i < 27; i++)
+			sums[i] += rowSums[i];
+		weightSum += rowWeight;
+	}
+}
+
+/// <summary>
+/// Constructor. The grid is empty until Bake().
+/// </summary>
+ShProbeGrid::ShProbeGrid()
+{
+}
+
+/// <summary>
+/// Projects a cube's radiance onto nine SH coefficients, like
+/// IblPrecompute::ProjectRadiance(), but faster
+/// </summary>
+/// <param name="useSimd">AVX2, when the CPU has it</param>
+/// <param name="queue">Projects the faces on its threads, if given. The faces are
+/// added up in order afterwards, so the result doesn't depend on the threads.</param>
+ShCoefficients ShProbeGrid::ProjectCube(const CubeImage& cube, bool useSimd, JobQueue* queue)
+{
+	bool simd = useSimd && CpuUtilities::HasAvx2();
+	double faceSums[6][27] = {};
+	double faceWeights[6] = {};
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		if (queue)
+			queue->Push([&cube, face, simd, &faceSums, &faceWeights]() { ProjectFace(cube, face, simd, faceSums[face], faceWeights[face]); });
+		else
+			ProjectFace(cube, face, simd, faceSums[face], faceWeights[face]);
+	}
+	if (queue)
+		queue->WaitIdle();
+
+	double sums[27] = {};
+	double weight = 0.0;
+	for (int face = 0; face < 6; face++)
+	{
+		for (int i = 0; i < 27; i++)
+			sums[i] += faceSums[face][i];
+		weight += faceWeights[face];
+	}
+
+	// The texel solid angles are close to, but don't add up to exactly, 4 pi
+	ShCoefficients sh;
+	for (int i = 0; i < 9; i++)
+		for (int c = 0; c < 3; c++)
+			sh.Rgb[i][c] = (float)(sums[i * 3 + c] * 4.0 * Pi / weight);
+	return sh;
+}
+
+/// <summary>
+/// Adds a light's radiance, as seen from a point, to a set of
+/// coefficients. It's scaled by pi so that, after ConvolveLambert(),
+/// a surface facing it gets Intensity * Color * N dot L, like the
+/// shader's direct lighting.
+/// </summary>
+/// <param name="position">Where the probe is; point lights fade out like Attenuate() in the shader</param>
+void ShProbeGrid::AddLight(ShCoefficients& radiance, const ProbeLight& light, const float position[3])
+{
+	float toLight[3];
+	float strength = light.Intensity * Pi;
+	if (light.Type == 1)
+	{
+		for (int i = 0; i < 3; i++)
+			toLight[i] = light.Position[i] - position[i];
+		float distanceSquared = toLight[0] * toLight[0] + toLight[1] * toLight[1] + toLight[2] * toLight[2];
+		float falloff = (std::min)((std::max)(1.0f - distanceSquared / (light.Range * light.Range), 0.0f), 1.0f);
+		strength *= falloff * falloff;
+		if (strength <= 0.0f || distanceSquared <= 0.0f)
+			return;
+	}
+	else
+	{
+		for (int i = 0; i < 3; i++)
+			toLight[i] = -light.Direction[i];
+	}
+
+	float length = sqrtf(toLight[0] * toLight[0] + toLight[1] * toLight[1] + toLight[2] * toLight[2]);
+	if (length <= 0.0f)
+		return;
+	for (int i = 0; i < 3; i++)
+		toLight[i] /= length;
+
+	float basis[9];
+	IblPrecompute::GetBasis(toLight, basis);
+	for (int i = 0; i < 9; i++)
+		for (int c = 0; c < 3; c++)
+			radiance.Rgb[i][c] += basis[i] * light.Color[c] * strength;
+}
+
+/// <summary>
+/// Places probes evenly over a box (corners included) and fills
+/// each with the sky plus the lights it can see
+/// </summary>
+/// <param name="counts">Probes along x, y and z; at least 2 each</param>
+/// <param name="skyRadiance">From ProjectCube(); the same for every probe</param>
+/// <param name="lights">Baked in, ex. lights that aren't drawn directly. May be empty.</param>
+void ShProbeGrid::Bake(const float boundsMin[3], const float boundsMax[3], const unsigned int counts[3],
+	const ShCoefficients& skyRadiance, const std::vector<ProbeLight>& lights)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		layout.Counts[i] = (std::max)(2u, counts[i]);
+		layout.Min[i] = boundsMin[i];
+		layout.CellSize[i] = (std::max)(boundsMax[i] - boundsMin[i], 0.001f) / (layout.Counts[i] - 1);
+	}
+
+	probes.resize((size_t)layout.Counts[0] * layout.Counts[1] * layout.Counts[2]);
+	size_t index = 0;
+	for (unsigned int z = 0; z < layout.Counts[2]; z++)
+	{
+		for (unsigned int y = 0; y < layout.Counts[1]; y++)
+		{
+			for (unsigned int x = 0; x < layout.Counts[0]; x++)
+			{
+				float position[3] = {
+					layout.Min[0] + x * layout.CellSize[0],
+					layout.Min[1] + y * layout.CellSize[1],
+					layout.Min[2] + z * layout.CellSize[2] };
+
+				ShCoefficients radiance = skyRadiance;
+				for (const ProbeLight& light : lights)
+					AddLight(radiance, light, position);
+				probes[index++] = IblPrecompute::ConvolveLambert(radiance);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Blends the eight probes around a point, like the shader does.
+/// Points outside the grid get its nearest edge.
+/// </summary>
+/// <returns>Irradiance over pi, ready for IblPrecompute::Evaluate() or PackForShader()</returns>
+ShCoefficients ShProbeGrid::Sample(const float position[3])
+{
+	ShCoefficients result;
+	if (probes.empty())
+		return result;
+
+	unsigned int base[3];
+	float t[3];
+	for (int i = 0; i < 3; i++)
+	{
+		float cell = (position[i] - layout.Min[i]) / layout.CellSize[i];
+		cell = (std::min)((std::max)(cell, 0.0f), (float)(layout.Counts[i] - 1));
+		base[i] = (std::min)((unsigned int)cell, layout.Counts[i] - 2);
+		t[i] = cell - base[i];
+	}
+
+	for (unsigned int corner = 0; corner < 8; corner++)
+	{
+		unsigned int offset[3] = { corner & 1, (corner >> 1) & 1, corner >> 2 };
+		float weight = 1.0f;
+		for (int i = 0; i < 3; i++)
+			weight *= offset[i] ? t[i] : 1.0f - t[i];
+
+		const ShCoefficients& probe = probes[((size_t)(base[2] + offset[2]) * layout.Counts[1] + base[1] + offset[1]) * layout.Counts[0] + base[0] + offset[0]];
+		for (int i = 0; i < 9; i++)
+			for (int c = 0; c < 3; c++)
+				result.Rgb[i][c] += probe.Rgb[i][c] * weight;
+	}
+	return result;
+}
+
+/// <summary>
+/// Converts the probes to the shader's compact layout
+/// </summary>
+/// <param name="packed">Replaced with one entry per probe, in grid order</param>
+void ShProbeGrid::Pack(std::vector<PackedShProbe>& packed)
+{
+	packed.resize(probes.size());
+	for (size_t p = 0; p < probes.size(); p++)
+	{
+		float values[9][4];
+		IblPrecompute::PackForShader(probes[p], values);
+
+		unsigned short halves[28] = {};
+		for (int i = 0; i < 9; i++)
+			for (int c = 0; c < 3; c++)
+				halves[i * 3 + c] = CpuUtilities::FloatToHalf(values[i][c]);
+		for (int i = 0; i < 14; i++)
+			packed[p].Halves[i] = halves[i * 2] | ((unsigned int)halves[i * 2 + 1] << 16);
+	}
+}
+
+// Getters
+ProbeGridLayout ShProbeGrid::GetLayout() { return layout; }
+size_t ShProbeGrid::GetProbeCount() { return probes.size(); }
+ShCoefficients ShProbeGrid::GetProbe(size_t index) { return probes[index]; }
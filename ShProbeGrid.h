@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include "IblPrecompute.h"
+#include "JobQueue.h"
+
+// A light baked into probes. Same fields and meaning as Light.h's,
+// without DirectXMath, so the grid builds anywhere.
+struct ProbeLight
+{
+	int Type = 0;				// LIGHT_TYPE_DIRECTIONAL or LIGHT_TYPE_POINT
+	float Direction[3] = {};	// The way the light travels
+	float Position[3] = {};
+	float Color[3] = { 1.0f, 1.0f, 1.0f };
+	float Intensity = 1.0f;
+	float Range = 1.0f;
+};
+
+// Where the probes are: a regular grid, x fastest, then y, then z
+struct ProbeGridLayout
+{
+	float Min[3] = {};
+	float CellSize[3] = { 1.0f, 1.0f, 1.0f };
+	unsigned int Counts[3] = { 2, 2, 2 };		// At least 2 along every axis
+};
+
+// One probe as the shader reads it: IblPrecompute::PackForShader()'s
+// 27 values (9 RGB) as half floats, two to a uint, and one of padding.
+// Must match ShProbe in PixelShader.hlsl.
+struct PackedShProbe
+{
+	unsigned int Halves[14];
+};
+
+// --------------------------------------------------------
+// A grid of L2 spherical harmonics probes: ambient lighting
+// that costs a few multiply-adds to evaluate, instead of
+// the cube and table fetches of full IBL.
+//
+// Each probe holds the sky's radiance (projected from its
+// cube map once; AVX2 and across a JobQueue) plus whatever
+// lights are baked in, convolved to irradiance over pi, the
+// same units as IblPrecompute::ConvolveLambert(). Baked
+// lights use the shader's conventions, so a light baked in
+// looks like the same light drawn directly (up to SH9's
+// blur), attenuation included.
+// --------------------------------------------------------
+class ShProbeGrid
+{
+	public:
+		ShProbeGrid();
+
+		// Projection
+		static ShCoefficients ProjectCube(const CubeImage& cube, bool useSimd = true, JobQueue* queue = 0);
+		static void AddLight(ShCoefficients& radiance, const ProbeLight& light, const float position[3]);
+
+		// Grid
+		void Bake(const float boundsMin[3], const float boundsMax[3], const unsigned int counts[3],
+			const ShCoefficients& skyRadiance, const std::vector<ProbeLight>& lights);
+		ShCoefficients Sample(const float position[3]);
+		void Pack(std::vector<PackedShProbe>& packed);
+
+		// Getters
+		ProbeGridLayout GetLayout();
+		size_t GetProbeCount();
+		ShCoefficients GetProbe(size_t index);
+
+	private:
+		ProbeGridLayout layout;
+		std::vector<ShCoefficients> probes;	// Irradiance over pi
+};
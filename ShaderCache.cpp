@@ -0,0 +1,329 @@
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+// Bumped whenever the file layout or key recipe changes
+static const unsigned int CacheMagic = 0x32434853; // "SHC2"
+static const char* KeyVersion = "ShaderCache v2";
+
+// --------------------------------------------------------
+// File helpers
+// --------------------------------------------------------
+static bool ReadWholeFile(const std::string& path, std::string& contents)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::ostringstream stream;
+	stream << file.rdbuf();
+	contents = stream.str();
+	return true;
+}
+
+static void AppendUInt(std::vector<unsigned char>& out, unsigned int value)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static bool ReadUInt(const std::string& data, size_t& position, unsigned int& value)
+{
+	if (data.size() - position < 4)
+		return false;
+
+	value = 0;
+	for (int i = 0; i < 4; i++)
+		value |= (unsigned int)(unsigned char)data[position + i] << (i * 8);
+	position += 4;
+	return true;
+}
+
+// Hashes a file and, depth first, everything it includes. Each file is
+// only visited once, which handles include guards and include cycles.
+static void HashSourceTree(const std::filesystem::path& path, unsigned long long& hash, std::vector<std::string>& dependencies)
+{
+	std::string normalized = path.lexically_normal().string();
+	if (std::find(dependencies.begin(), dependencies.end(), normalized) != dependencies.end())
+		return;
+	dependencies.push_back(normalized);
+
+	// A missing include still changes the key, and will fail to compile anyway
+	std::string source;
+	if (!ReadWholeFile(normalized, source))
+	{
+		hash = ShaderCache::Hash(normalized.data(), normalized.size(), hash);
+		return;
+	}
+
+	hash = ShaderCache::Hash(source.data(), source.size(), hash);
+	for (const std::string& include : ShaderCache::FindIncludes(source))
+		HashSourceTree(path.parent_path() / include, hash, dependencies);
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+/// <param name="_directory">Folder holding the cache files, created on first store</param>
+ShaderCache::ShaderCache(std::string _directory)
+	: directory(_directory), hits(0), misses(0)
+{
+}
+
+/// <summary>
+/// Loads the request from the cache, or compiles it and stores the result
+/// </summary>
+/// <param name="request">What to compile</param>
+/// <param name="compile">Called on a cache miss</param>
+/// <param name="result">The bytecode, reflection and dependencies</param>
+/// <returns>False if the source is missing or fails to compile</returns>
+bool ShaderCache::GetOrCompile(const ShaderCompileRequest& request, const ShaderCompileFunction& compile, CompiledShader& result)
+{
+	result = CompiledShader();
+
+	unsigned long long key = 0;
+	std::vector<std::string> dependencies;
+	if (!ComputeKey(request, key, dependencies))
+	{
+		result.Errors = "Unable to read shader source '" + request.SourcePath + "'\n";
+		misses++;
+		return false;
+	}
+
+	if (Load(request, key, result))
+	{
+		result.Dependencies = dependencies;
+		hits++;
+		return true;
+	}
+
+	misses++;
+	bool compiled = compile(request, result);
+	result.Key = key;
+	result.Dependencies = dependencies;
+	result.FromCache = false;
+
+	if (compiled)
+		Store(request, result);
+
+	return compiled;
+}
+
+/// <summary>
+/// Reads a cache file, making sure it really is for the given key
+/// </summary>
+/// <returns>False on a miss or a damaged file</returns>
+bool ShaderCache::Load(const ShaderCompileRequest& request, unsigned long long key, CompiledShader& result)
+{
+	std::string data;
+	if (!ReadWholeFile((std::filesystem::path(directory) / GetCacheFileName(request, key)).string(), data))
+		return false;
+
+	size_t position = 0;
+	unsigned int magic, keyLow, keyHigh, bytecodeSize, reflectionSize;
+	if (!ReadUInt(data, position, magic) || magic != CacheMagic) return false;
+	if (!ReadUInt(data, position, keyLow) || !ReadUInt(data, position, keyHigh)) return false;
+	if ((((unsigned long long)keyHigh << 32) | keyLow) != key) return false;
+
+	if (!ReadUInt(data, position, bytecodeSize) || data.size() - position < bytecodeSize) return false;
+	std::vector<unsigned char> bytecode(data.begin() + position, data.begin() + position + bytecodeSize);
+	position += bytecodeSize;
+
+	if (!ReadUInt(data, position, reflectionSize) || data.size() - position < reflectionSize) return false;
+	size_t reflectionStart = position;
+	position += reflectionSize;
+
+	// A hash of everything before it ends the file, so damage anywhere is caught
+	unsigned int checksumLow, checksumHigh;
+	size_t checksummed = position;
+	if (!ReadUInt(data, position, checksumLow) || !ReadUInt(data, position, checksumHigh) || position != data.size()) return false;
+	if ((((unsigned long long)checksumHigh << 32) | checksumLow) != Hash(data.data(), checksummed)) return false;
+
+	ShaderReflectionData reflection;
+	if (!reflection.Deserialize((const unsigned char*)data.data() + reflectionStart, reflectionSize)) return false;
+
+	result.Bytecode.swap(bytecode);
+	result.Reflection = reflection;
+	result.Key = key;
+	result.FromCache = true;
+	return true;
+}
+
+/// <summary>
+/// Writes a compiled shader to the cache. Goes through a temporary
+/// file so a crash (or a second instance) never leaves half a file.
+/// </summary>
+/// <returns>False if the file could not be written</returns>
+bool ShaderCache::Store(const ShaderCompileRequest& request, const CompiledShader& shader)
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	std::vector<unsigned char> data;
+	AppendUInt(data, CacheMagic);
+	AppendUInt(data, (unsigned int)(shader.Key & 0xFFFFFFFF));
+	AppendUInt(data, (unsigned int)(shader.Key >> 32));
+	AppendUInt(data, (unsigned int)shader.Bytecode.size());
+	data.insert(data.end(), shader.Bytecode.begin(), shader.Bytecode.end());
+
+	std::vector<unsigned char> reflection;
+	shader.Reflection.Serialize(reflection);
+	AppendUInt(data, (unsigned int)reflection.size());
+	data.insert(data.end(), reflection.begin(), reflection.end());
+	unsigned long long checksum = Hash(data.data(), data.size());
+	AppendUInt(data, (unsigned int)(checksum & 0xFFFFFFFF));
+	AppendUInt(data, (unsigned int)(checksum >> 32));
+
+	std::filesystem::path path = std::filesystem::path(directory) / GetCacheFileName(request, shader.Key);
+	std::filesystem::path temp = path;
+	temp += ".tmp";
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		file.write((const char*)data.data(), data.size());
+		if (!file.good())
+			return false;
+	}
+
+	std::filesystem::rename(temp, path, error);
+	return !error;
+}
+
+// Getters
+const std::string& ShaderCache::GetDirectory() { return directory; }
+unsigned long long ShaderCache::GetHitCount() { return hits; }
+unsigned long long ShaderCache::GetMissCount() { return misses; }
+
+/// <summary>
+/// Builds the cache key for a request
+/// </summary>
+/// <param name="request">The permutation</param>
+/// <param name="key">The resulting key</param>
+/// <param name="dependencies">Every file the source pulls in, source first</param>
+/// <returns>False if the source file itself can't be read</returns>
+bool ShaderCache::ComputeKey(const ShaderCompileRequest& request, unsigned long long& key, std::vector<std::string>& dependencies)
+{
+	dependencies.clear();
+	std::string source;
+	if (!ReadWholeFile(request.SourcePath, source))
+		return false;
+
+	// Settings first. Defines are sorted so their order doesn't matter.
+	unsigned long long hash = Hash(KeyVersion, strlen(KeyVersion));
+	std::string fileName = std::filesystem::path(request.SourcePath).filename().string();
+	std::string settings = fileName + "|" + request.EntryPoint + "|" + request.Target + "|" + std::to_string(request.Flags) + "|";
+
+	std::vector<ShaderDefine> defines = request.Defines;
+	std::sort(defines.begin(), defines.end(), [](const ShaderDefine& a, const ShaderDefine& b) { return a.Name < b.Name; });
+	for (const ShaderDefine& define : defines)
+		settings += define.Name + "=" + define.Value + ";";
+	hash = Hash(settings.data(), settings.size(), hash);
+
+	// Then the text of every file involved
+	HashSourceTree(request.SourcePath, hash, dependencies);
+
+	key = hash;
+	return true;
+}
+
+/// <summary>
+/// Cache file name for a key, ex: "PixelShader_ps_5_0_0123456789abcdef.shc"
+/// </summary>
+std::string ShaderCache::GetCacheFileName(const ShaderCompileRequest& request, unsigned long long key)
+{
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx", key);
+	return std::filesystem::path(request.SourcePath).stem().string() + "_" + request.Target + "_" + hex + ".shc";
+}
+
+/// <summary>
+/// Finds the file names of every #include directive in the source
+/// </summary>
+std::vector<std::string> ShaderCache::FindIncludes(const std::string& source)
+{
+	std::vector<std::string> includes;
+	std::istringstream stream(source);
+	std::string line;
+
+	while (std::getline(stream, line))
+	{
+		// Must be: optional whitespace, '#', optional whitespace, "include"
+		size_t pos = line.find_first_not_of(" \t");
+		if (pos == std::string::npos || line[pos] != '#') continue;
+		pos = line.find_first_not_of(" \t", pos + 1);
+		if (pos == std::string::npos || line.compare(pos, 7, "include") != 0) continue;
+		pos = line.find_first_not_of(" \t", pos + 7);
+		if (pos == std::string::npos) continue;
+
+		char close = line[pos] == '"' ? '"' : (line[pos] == '<' ? '>' : 0);
+		if (close == 0) continue;
+		size_t end = line.find(close, pos + 1);
+		if (end == std::string::npos) continue;
+
+		includes.push_back(line.substr(pos + 1, end - pos - 1));
+	}
+
+	return includes;
+}
+
+/// <summary>
+/// 64-bit FNV-1a. Pass the previous result as the hash to chain calls.
+/// </summary>
+unsigned long long ShaderCache::Hash(const void* data, size_t size, unsigned long long hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/// <summary>
+/// Starts tracking a file, remembering its current modification time
+/// </summary>
+void ShaderFileWatcher::Watch(const std::string& path)
+{
+	if (files.find(path) != files.end())
+		return;
+
+	std::error_code error;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	files[path] = error ? std::filesystem::file_time_type::min() : time;
+}
+
+/// <summary>
+/// Stops tracking every file
+/// </summary>
+void ShaderFileWatcher::Clear()
+{
+	files.clear();
+}
+
+/// <summary>
+/// Checks every watched file
+/// </summary>
+/// <returns>The files that changed (or appeared, or vanished) since the last poll</returns>
+std::vector<std::string> ShaderFileWatcher::Poll()
+{
+	std::vector<std::string> changed;
+	for (auto& file : files)
+	{
+		std::error_code error;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(file.first, error);
+		if (error) time = std::filesystem::file_time_type::min();
+
+		if (time != file.second)
+		{
+			file.second = time;
+			changed.push_back(file.first);
+		}
+	}
+	return changed;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ShaderReflection.h"
+
+// A preprocessor define handed to the compiler, ex: { "USE_NORMAL_MAP", "1" }
+struct ShaderDefine
+{
+	std::string Name;
+	std::string Value;
+};
+
+// Everything that makes one compiled permutation unique
+struct ShaderCompileRequest
+{
+	std::string SourcePath;				// Full path to the .hlsl file
+	std::string EntryPoint = "main";
+	std::string Target;					// ex: "vs_5_0"
+	std::vector<ShaderDefine> Defines;
+	unsigned int Flags = 0;				// Compiler flags
+};
+
+// Output of a compile (or a cache hit)
+struct CompiledShader
+{
+	std::vector<unsigned char> Bytecode;
+	ShaderReflectionData Reflection;
+	unsigned long long Key = 0;
+	std::vector<std::string> Dependencies;	// The source file and everything it includes
+	bool FromCache = false;
+	std::string Errors;
+};
+
+// Compiles and reflects a request, filling in Bytecode and Reflection.
+// Returns false (with Errors filled in) on failure.
+typedef std::function<bool(const ShaderCompileRequest& request, CompiledShader& result)> ShaderCompileFunction;
+
+// --------------------------------------------------------
+// On-disk cache of compiled shaders. Entries are keyed by a
+// hash of the source text (including every #include), the
+// entry point, target, flags and defines, so any edit simply
+// misses and stale files are never read.
+// --------------------------------------------------------
+class ShaderCache
+{
+	public:
+		ShaderCache(std::string _directory);
+
+		bool GetOrCompile(const ShaderCompileRequest& request, const ShaderCompileFunction& compile, CompiledShader& result);
+		bool Load(const ShaderCompileRequest& request, unsigned long long key, CompiledShader& result);
+		bool Store(const ShaderCompileRequest& request, const CompiledShader& shader);
+
+		// Getters
+		const std::string& GetDirectory();
+		unsigned long long GetHitCount();
+		unsigned long long GetMissCount();
+
+		// Helpers
+		static bool ComputeKey(const ShaderCompileRequest& request, unsigned long long& key, std::vector<std::string>& dependencies);
+		static std::string GetCacheFileName(const ShaderCompileRequest& request, unsigned long long key);
+		static std::vector<std::string> FindIncludes(const std::string& source);
+		static unsigned long long Hash(const void* data, size_t size, unsigned long long hash = 14695981039346656037ULL);
+
+	private:
+		std::string directory;
+		std::atomic<unsigned long long> hits;
+		std::atomic<unsigned long long> misses;
+};
+
+// --------------------------------------------------------
+// Polls file modification times so edited shaders can be
+// recompiled while the program runs
+// --------------------------------------------------------
+class ShaderFileWatcher
+{
+	public:
+		void Watch(const std::string& path);
+		void Clear();
+		std::vector<std::string> Poll();
+
+	private:
+		std::unordered_map<std::string, std::filesystem::file_time_type> files;
+};
@@ -3,7 +3,11 @@
 #define LIGHT_TYPE_DIRECTIONAL	0
 #define LIGHT_TYPE_POINT		1
 #define LIGHT_TYPE_SPOT			2
+#define MAX_LIGHTS				64	// Must match Light.h
 #define MAX_SPECULAR_EXPONENT	256.0f
+#define MAX_SHADOW_CASCADES		4	// Must match ShadowCascades.h
+#define AMBIENT_SH_CONSTANTS	0	// shAmbient: the sky's, or one probe per entity
+#define AMBIENT_SH_GRID			1	// The probe grid, per pixel (must match ProbeVolume.cpp)
 
 // Structs
 
@@ -13,16 +17,34 @@ struct VertexToPixel
 	float2 uv				: TEXCOORD;
 	float3 normal			: NORMAL;
 	float3 worldPosition	: POSITION;
-	float3 tangent			: TANGENT;
+	float4 tangent			: TANGENT;		// w is the handedness, -1 where UVs are mirrored
+#ifdef BATCHED
+	nointerpolation uint materialIndex : MATERIAL;	// Into the material buffer
+#endif
 };
 
+// A packed vertex (must match PackedVertex in VertexPacking.h). The semantics'
+// suffixes give SimpleVertexShader's input layout 16 bit formats, which the
+// input assembler expands to these floats. The position is read from a stream
+// of its own (input slot 0), the rest from slot 1.
 struct VertexShaderInput
 {
-	float3 localPosition	: POSITION;     // XYZ position
-	float3 normal			: NORMAL;
-	float2 uv				: TEXCOORD;
-	float3 tangent			: TANGENT;
+	float4 packedPosition	: POSITION_UNORM16;	// 0-1 across the mesh's box; w is the tangent's handedness (0 or 1)
+	float2 packedNormal		: NORMAL_SNORM16;	// Octahedral
+	float2 packedTangent	: TANGENT_SNORM16;	// Octahedral
+	float2 uv				: TEXCOORD_FLOAT16;
+};
+
+#ifdef BATCHED
+// Per-instance data for instanced draws across materials (must match InstanceData in InstanceBatcher.h)
+struct InstanceData
+{
+	matrix world;
+	matrix worldInvTranspose;
+	uint materialIndex;
+	uint3 padding;
 };
+#endif
 
 // Struct for all types of lights
 struct Light
@@ -37,4 +59,34 @@ struct Light
 	float3 Padding;
 };
 
+// Functions
+
+// Unit direction from VertexPacking::EncodeOctahedral(): the lower
+// half of the octahedron is unfolded back over the diagonals
+float3 DecodeOctahedral(float2 encoded)
+{
+	float3 direction = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	float t = saturate(-direction.z);
+	direction.xy += direction.xy >= 0.0f ? -t : t;
+	return normalize(direction);
+}
+
+// The model space position of a packed vertex. Precise, like
+// ProjectPosition(), so every shader unpacks it the same way.
+float3 UnpackPosition(float4 packedPosition, float3 positionScale, float3 positionOffset)
+{
+	precise float3 localPosition = packedPosition.xyz * positionScale + positionOffset;
+	return localPosition;
+}
+
+// Clip space position from the camera. The depth pre-pass and the
+// main pass both go through here, and the main pass tests depth
+// for EQUAL, so the result must come out bit for bit the same.
+float4 ProjectPosition(float3 localPosition, matrix world, matrix view, matrix projection)
+{
+	matrix wvp = mul(mul(projection, view), world);
+	precise float4 position = mul(wvp, float4(localPosition, 1.0f));
+	return position;
+}
+
 #endif
\ No newline at end of file
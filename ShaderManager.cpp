@@ -0,0 +1,276 @@
+#include "ShaderManager.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+
+// How often to look for edited shader files
+static const std::chrono::milliseconds PollInterval(500);
+
+/// <summary>
+/// Constructor
+/// </summary>
+/// <param name="_sourceDirectory">Folder holding the .hlsl files</param>
+/// <param name="_cacheDirectory">Folder for cached bytecode</param>
+/// <param name="_fallbackDirectory">Folder holding prebuilt .cso files, used if the source can't be compiled</param>
+ShaderManager::ShaderManager(
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	std::string _sourceDirectory,
+	std::string _cacheDirectory,
+	std::string _fallbackDirectory)
+	:
+	device(_device),
+	context(_context),
+	sourceDirectory(_sourceDirectory),
+	fallbackDirectory(_fallbackDirectory),
+	cache(_cacheDirectory),
+	hotReload(true),
+	lastPoll(std::chrono::steady_clock::now()),
+	queue(1)
+{
+}
+
+/// <summary>
+/// Gets (and starts compiling, if this is the first request) a vertex shader permutation
+/// </summary>
+/// <param name="fileName">The .hlsl file, relative to the source directory</param>
+/// <param name="defines">Preprocessor defines for this permutation</param>
+std::shared_ptr<SimpleVertexShader> ShaderManager::GetVertexShader(const std::string& fileName, const std::vector<ShaderDefine>& defines)
+{
+	return std::static_pointer_cast<SimpleVertexShader>(GetShader(fileName, defines, "vs_5_0"));
+}
+
+/// <summary>
+/// Gets (and starts compiling, if this is the first request) a pixel shader permutation
+/// </summary>
+/// <param name="fileName">The .hlsl file, relative to the source directory</param>
+/// <param name="defines">Preprocessor defines for this permutation</param>
+std::shared_ptr<SimplePixelShader> ShaderManager::GetPixelShader(const std::string& fileName, const std::vector<ShaderDefine>& defines)
+{
+	return std::static_pointer_cast<SimplePixelShader>(GetShader(fileName, defines, "ps_5_0"));
+}
+
+/// <summary>
+/// Applies finished compiles and, every so often, queues
+/// recompiles for shaders whose files have changed
+/// </summary>
+void ShaderManager::Update()
+{
+	ApplyFinished();
+
+	if (!hotReload)
+		return;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - lastPoll < PollInterval)
+		return;
+	lastPoll = now;
+
+	std::vector<std::string> changed = watcher.Poll();
+	if (changed.empty())
+		return;
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		for (const std::string& dependency : entries[i].Dependencies)
+		{
+			if (std::find(changed.begin(), changed.end(), dependency) != changed.end())
+			{
+				QueueCompile(i);
+				break;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Blocks until every queued compile is done and applied
+/// </summary>
+void ShaderManager::WaitForAll()
+{
+	queue.WaitIdle();
+	ApplyFinished();
+}
+
+// Setters
+void ShaderManager::SetHotReload(bool _hotReload) { hotReload = _hotReload; }
+
+// Getters
+size_t ShaderManager::GetPendingCount() { return queue.GetPendingCount(); }
+ShaderCache& ShaderManager::GetCache() { return cache; }
+
+/// <summary>
+/// Finds or creates the entry for a permutation. The same file and
+/// defines (in any order) always return the same shader object.
+/// </summary>
+std::shared_ptr<ISimpleShader> ShaderManager::GetShader(const std::string& fileName, const std::vector<ShaderDefine>& defines, const std::string& target)
+{
+	std::vector<ShaderDefine> sorted = defines;
+	std::sort(sorted.begin(), sorted.end(), [](const ShaderDefine& a, const ShaderDefine& b) { return a.Name < b.Name; });
+
+	std::string name = target + "|" + fileName;
+	for (const ShaderDefine& define : sorted)
+		name += "|" + define.Name + "=" + define.Value;
+
+	std::unordered_map<std::string, size_t>::iterator existing = lookup.find(name);
+	if (existing != lookup.end())
+		return entries[existing->second].Shader;
+
+	ShaderEntry entry;
+	entry.Request.SourcePath = (std::filesystem::path(sourceDirectory) / fileName).lexically_normal().string();
+	entry.Request.Target = target;
+	entry.Request.Defines = sorted;
+#if defined(DEBUG) || defined(_DEBUG)
+	entry.Request.Flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+	entry.Request.Flags = D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#endif
+
+	if (target[0] == 'v')
+		entry.Shader = std::make_shared<SimpleVertexShader>(device, context);
+	else
+		entry.Shader = std::make_shared<SimplePixelShader>(device, context);
+
+	lookup[name] = entries.size();
+	entries.push_back(entry);
+	QueueCompile(entries.size() - 1);
+
+	return entry.Shader;
+}
+
+/// <summary>
+/// Compiles (or loads from the cache) an entry on the worker thread.
+/// The result is applied on the main thread by ApplyFinished().
+/// </summary>
+void ShaderManager::QueueCompile(size_t entryIndex)
+{
+	ShaderCompileRequest request = entries[entryIndex].Request;
+	queue.Push([this, entryIndex, request]()
+	{
+		FinishedCompile compile;
+		compile.EntryIndex = entryIndex;
+		compile.Success = cache.GetOrCompile(request, &ShaderManager::Compile, compile.Result);
+
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		finished.push_back(compile);
+	});
+}
+
+/// <summary>
+/// Hands every finished compile to its shader
+/// </summary>
+void ShaderManager::ApplyFinished()
+{
+	std::vector<FinishedCompile> done;
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		done.swap(finished);
+	}
+
+	for (FinishedCompile& compile : done)
+		Apply(compile);
+}
+
+/// <summary>
+/// Swaps new code into a shader. A failed recompile keeps the old code
+/// running; a shader that never worked falls back to its .cso file.
+/// </summary>
+void ShaderManager::Apply(FinishedCompile& compile)
+{
+	ShaderEntry& entry = entries[compile.EntryIndex];
+	std::string fileName = std::filesystem::path(entry.Request.SourcePath).filename().string();
+
+	// Keep watching whatever the source includes now
+	if (!compile.Result.Dependencies.empty())
+	{
+		entry.Dependencies = compile.Result.Dependencies;
+		for (const std::string& dependency : entry.Dependencies)
+			watcher.Watch(dependency);
+	}
+
+	if (compile.Success)
+	{
+		Microsoft::WRL::ComPtr<ID3DBlob> blob;
+		if (SUCCEEDED(D3DCreateBlob(compile.Result.Bytecode.size(), blob.GetAddressOf())))
+		{
+			memcpy(blob->GetBufferPointer(), compile.Result.Bytecode.data(), compile.Result.Bytecode.size());
+
+			bool wasLoaded = entry.Loaded;
+			entry.Loaded = entry.Shader->LoadShaderBytecode(blob, &compile.Result.Reflection);
+			if (entry.Loaded)
+			{
+				if (wasLoaded)
+					printf("Reloaded shader %s (%s)\n", fileName.c_str(), entry.Request.Target.c_str());
+				return;
+			}
+		}
+	}
+
+	printf("Unable to compile shader %s (%s):\n%s\n", fileName.c_str(), entry.Request.Target.c_str(), compile.Result.Errors.c_str());
+
+	if (!entry.Shader->IsShaderValid())
+		entry.Loaded = LoadFallback(entry);
+}
+
+/// <summary>
+/// Loads the prebuilt .cso for an entry, if it has no defines (a .cso
+/// only ever holds the default permutation)
+/// </summary>
+/// <returns>True if the fallback loaded</returns>
+bool ShaderManager::LoadFallback(ShaderEntry& entry)
+{
+	if (!entry.Request.Defines.empty())
+		return false;
+
+	std::filesystem::path path = std::filesystem::path(fallbackDirectory) / std::filesystem::path(entry.Request.SourcePath).stem();
+	path += ".cso";
+
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	if (FAILED(D3DReadFileToBlob(path.wstring().c_str(), blob.GetAddressOf())))
+		return false;
+
+	return entry.Shader->LoadShaderBytecode(blob);
+}
+
+/// <summary>
+/// Compiles and reflects HLSL. Runs on the worker thread, so it
+/// must not touch the device or any SimpleShader.
+/// </summary>
+bool ShaderManager::Compile(const ShaderCompileRequest& request, CompiledShader& result)
+{
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const ShaderDefine& define : request.Defines)
+		macros.push_back({ define.Name.c_str(), define.Value.c_str() });
+	macros.push_back({ 0, 0 });
+
+	Microsoft::WRL::ComPtr<ID3DBlob> code;
+	Microsoft::WRL::ComPtr<ID3DBlob> errors;
+	HRESULT hr = D3DCompileFromFile(
+		std::filesystem::path(request.SourcePath).wstring().c_str(),
+		macros.data(),
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		request.EntryPoint.c_str(),
+		request.Target.c_str(),
+		request.Flags,
+		0,
+		code.GetAddressOf(),
+		errors.GetAddressOf());
+
+	if (errors)
+		result.Errors.assign((const char*)errors->GetBufferPointer(), errors->GetBufferSize());
+	if (FAILED(hr))
+		return false;
+
+	const unsigned char* bytes = (const unsigned char*)code->GetBufferPointer();
+	result.Bytecode.assign(bytes, bytes + code->GetBufferSize());
+
+	if (!ISimpleShader::ReflectShader(code->GetBufferPointer(), code->GetBufferSize(), result.Reflection))
+	{
+		result.Errors += "Unable to reflect compiled shader\n";
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "JobQueue.h"
+#include "ShaderCache.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Hands out SimpleShaders compiled from HLSL source. Each
+// permutation (file + defines) compiles on a background
+// thread the first time it's asked for, going through the
+// on-disk ShaderCache, and recompiles whenever one of its
+// source files changes. Shaders are invalid (and skip their
+// SetShader calls) until their code arrives in Update().
+// --------------------------------------------------------
+class ShaderManager
+{
+	public:
+		ShaderManager(
+			Microsoft::WRL::ComPtr<ID3D11Device> _device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+			std::string _sourceDirectory,
+			std::string _cacheDirectory,
+			std::string _fallbackDirectory);
+
+		std::shared_ptr<SimpleVertexShader> GetVertexShader(const std::string& fileName, const std::vector<ShaderDefine>& defines = std::vector<ShaderDefine>());
+		std::shared_ptr<SimplePixelShader> GetPixelShader(const std::string& fileName, const std::vector<ShaderDefine>& defines = std::vector<ShaderDefine>());
+
+		// Applies finished compiles and checks for edited files. Call once per frame.
+		void Update();
+		void WaitForAll();
+
+		// Setters
+		void SetHotReload(bool _hotReload);
+
+		// Getters
+		size_t GetPendingCount();
+		ShaderCache& GetCache();
+
+	private:
+		struct ShaderEntry
+		{
+			std::shared_ptr<ISimpleShader> Shader;
+			ShaderCompileRequest Request;
+			std::vector<std::string> Dependencies;
+			bool Loaded = false;	// Has had working code at least once
+		};
+
+		struct FinishedCompile
+		{
+			size_t EntryIndex;
+			bool Success;
+			CompiledShader Result;
+		};
+
+		std::shared_ptr<ISimpleShader> GetShader(const std::string& fileName, const std::vector<ShaderDefine>& defines, const std::string& target);
+		void QueueCompile(size_t entryIndex);
+		void ApplyFinished();
+		void Apply(FinishedCompile& compile);
+		bool LoadFallback(ShaderEntry& entry);
+		static bool Compile(const ShaderCompileRequest& request, CompiledShader& result);
+
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		std::string sourceDirectory;
+		std::string fallbackDirectory;
+
+		std::vector<ShaderEntry> entries;
+		std::unordered_map<std::string, size_t> lookup;
+
+		ShaderCache cache;
+		ShaderFileWatcher watcher;
+		bool hotReload;
+		std::chrono::steady_clock::time_point lastPoll;
+
+		std::mutex finishedMutex;
+		std::vector<FinishedCompile> finished;
+
+		// Declared last so the worker finishes before anything it uses is destroyed
+		JobQueue queue;
+};
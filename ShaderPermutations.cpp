@@ -0,0 +1,108 @@
+#include "ShaderPermutations.h"
+
+#include <algorithm>
+
+// Features take the low 16 bits; the light count, plus one so
+// LoopedLights is 0, the 8 above them
+static const unsigned int LightCountShift = 16;
+
+/// <summary>
+/// Packs a feature mask and a light count into a key. Unknown
+/// feature bits are dropped, EnvironmentLight is dropped when
+/// ProbeAmbientOnly replaces it, and counts too big (or
+/// negative) to compile in become LoopedLights, so scenes that
+/// would compile the same permutation share a key.
+/// </summary>
+unsigned int ShaderPermutations::MakeKey(unsigned int features, int lightCount)
+{
+	if (lightCount < 0 || lightCount > MaxCompiledLights)
+		lightCount = LoopedLights;
+	if (features & ProbeAmbientOnly)
+		features &= ~EnvironmentLight;
+	return (features & AllFeatures) | ((unsigned int)(lightCount + 1) << LightCountShift);
+}
+
+/// <summary>
+/// The feature mask a key was made from
+/// </summary>
+unsigned int ShaderPermutations::GetFeatures(unsigned int key)
+{
+	return key & AllFeatures;
+}
+
+/// <summary>
+/// The light count a key was made from
+/// </summary>
+/// <returns>LoopedLights if the count isn't compiled in</returns>
+int ShaderPermutations::GetLightCount(unsigned int key)
+{
+	return (int)((key >> LightCountShift) & 0xFF) - 1;
+}
+
+/// <summary>
+/// The defines PixelShader.hlsl is compiled with for a key,
+/// sorted by name like the ShaderManager's own lookup
+/// </summary>
+std::vector<ShaderDefine> ShaderPermutations::GetDefines(unsigned int key)
+{
+	unsigned int features = GetFeatures(key);
+	std::vector<ShaderDefine> defines;
+	if (features & Batched)
+		defines.push_back({ "BATCHED", "1" });
+	if (features & CoarseLighting)
+		defines.push_back({ "COARSE_LIGHTING", "1" });
+	if (GetLightCount(key) != LoopedLights)
+		defines.push_back({ "LIGHT_COUNT", std::to_string(GetLightCount(key)) });
+	if (!(features & AlbedoMap))
+		defines.push_back({ "NO_ALBEDO_MAP", "1" });
+	if (!(features & (EnvironmentLight | ProbeAmbientOnly)))
+		defines.push_back({ "NO_ENVIRONMENT_LIGHT", "1" });
+	if (!(features & NormalMap))
+		defines.push_back({ "NO_NORMAL_MAP", "1" });
+	if (!(features & OrmMap))
+		defines.push_back({ "NO_ORM_MAP", "1" });
+	if (features & ProbeAmbientOnly)
+		defines.push_back({ "PROBE_AMBIENT_ONLY", "1" });
+
+	std::sort(defines.begin(), defines.end(), [](const ShaderDefine& a, const ShaderDefine& b) { return a.Name < b.Name; });
+	return defines;
+}
+
+/// <summary>
+/// A short readable name for a key, ex. "albedo+normal+orm+sky, 5 lights"
+/// </summary>
+std::string ShaderPermutations::Describe(unsigned int key)
+{
+	unsigned int features = GetFeatures(key);
+	const char* names[] = { "albedo", "normal", "orm", "sky", "batched", "coarse", "probes" };
+	std::string description;
+	for (unsigned int bit = 0; bit < 7; bit++)
+	{
+		if (!(features & (1 << bit)))
+			continue;
+		if (!description.empty())
+			description += "+";
+		description += names[bit];
+	}
+	if (description.empty())
+		description = "plain";
+
+	int lightCount = GetLightCount(key);
+	return description + ", " + (lightCount == LoopedLights ? std::string("looped lights") : std::to_string(lightCount) + " lights");
+}
+
+/// <summary>
+/// The feature a material's texture stands for, by the name
+/// PixelShader.hlsl gives it
+/// </summary>
+/// <returns>The feature bit, or 0 if it isn't one of the maps</returns>
+unsigned int ShaderPermutations::GetMapFeature(const std::string& textureName)
+{
+	if (textureName == "AlbedoTexture")
+		return AlbedoMap;
+	if (textureName == "NormalMap")
+		return NormalMap;
+	if (textureName == "OrmMap")
+		return OrmMap;
+	return 0;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ShaderCache.h"
+
+// --------------------------------------------------------
+// Keys for the permutations of PixelShader.hlsl. A key packs
+// a feature mask (which maps a material has, whether the
+// sky lights the scene, batched or not, full or coarse
+// lighting) with a light count, and maps to the defines
+// that compile exactly that permutation.
+//
+// Defines only take things away, so the permutation with
+// every map, the sky and a looped light count has none: it's
+// the shader as it always was, and the fallback while the
+// others compile. The exceptions are the pipeline bits, and
+// ProbeAmbientOnly, which swaps the sky's light for nine SH
+// coefficients and nothing else; it takes the place of
+// EnvironmentLight, and a key never has both. Light counts up to MaxCompiledLights are
+// compiled in and the loop unrolls; past that it loops over
+// the constant buffer's count.
+// --------------------------------------------------------
+class ShaderPermutations
+{
+	public:
+		// Feature bits
+		static const unsigned int AlbedoMap = 1 << 0;
+		static const unsigned int NormalMap = 1 << 1;
+		static const unsigned int OrmMap = 1 << 2;
+		static const unsigned int EnvironmentLight = 1 << 3;	// The sky's diffuse and specular
+		static const unsigned int Batched = 1 << 4;				// Transforms and materials from buffers
+		static const unsigned int CoarseLighting = 1 << 5;		// Lights once per 2x2 quad
+		static const unsigned int ProbeAmbientOnly = 1 << 6;	// Ambient from SH alone, no cube or BRDF table
+
+		static const unsigned int Maps = AlbedoMap | NormalMap | OrmMap;
+		static const unsigned int Full = Maps | EnvironmentLight;	// What PixelShader.hlsl has without defines
+		static const unsigned int AllFeatures = Full | Batched | CoarseLighting | ProbeAmbientOnly;
+
+		static const int MaxCompiledLights = 8;
+		static const int LoopedLights = -1;
+
+		static unsigned int MakeKey(unsigned int features, int lightCount);
+		static unsigned int GetFeatures(unsigned int key);
+		static int GetLightCount(unsigned int key);
+		static std::vector<ShaderDefine> GetDefines(unsigned int key);
+		static std::string Describe(unsigned int key);
+
+		static unsigned int GetMapFeature(const std::string& textureName);
+};
+
+// --------------------------------------------------------
+// Permutations made on first use and kept by key, so picking
+// one for a draw is a hash of an integer rather than a
+// string of defines. The factory does the making (ex. asks
+// the ShaderManager to compile), and is called once per key.
+// --------------------------------------------------------
+template<typename Variant>
+class ShaderVariantCache
+{
+	public:
+		typedef std::function<Variant(const std::vector<ShaderDefine>& defines)> Factory;
+
+		ShaderVariantCache(Factory _factory) :
+			factory(_factory),
+			hits(0),
+			misses(0)
+		{
+		}
+
+		Variant Get(unsigned int key)
+		{
+			typename std::unordered_map<unsigned int, Variant>::iterator found = variants.find(key);
+			if (found != variants.end())
+			{
+				hits++;
+				return found->second;
+			}
+
+			misses++;
+			Variant variant = factory(ShaderPermutations::GetDefines(key));
+			variants.insert({ key, variant });
+			return variant;
+		}
+
+		// Getters
+		size_t GetCount() { return variants.size(); }
+		unsigned long long GetHits() { return hits; }
+		unsigned long long GetMisses() { return misses; }
+
+	private:
+		Factory factory;
+		std::unordered_map<unsigned int, Variant> variants;
+		unsigned long long hits;
+		unsigned long long misses;
+};
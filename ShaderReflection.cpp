@@ -0,0 +1,158 @@
+#include "ShaderReflection.h"
+
+// Bumped whenever the layout below changes, so old data is rejected
+static const unsigned int ReflectionMagic = 0x31464552; // "REF1"
+
+// --------------------------------------------------------
+// Little helpers for a flat binary format: 32-bit values
+// and length-prefixed strings, in declaration order
+// --------------------------------------------------------
+static void WriteUInt(std::vector<unsigned char>& out, unsigned int value)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static void WriteString(std::vector<unsigned char>& out, const std::string& value)
+{
+	WriteUInt(out, (unsigned int)value.size());
+	out.insert(out.end(), value.begin(), value.end());
+}
+
+// Reads from a buffer and remembers if it ever ran off the end
+struct ReflectionReader
+{
+	const unsigned char* Data;
+	size_t Size;
+	size_t Position;
+	bool Failed;
+
+	unsigned int ReadUInt()
+	{
+		if (Size - Position < 4) { Failed = true; return 0; }
+		unsigned int value = 0;
+		for (int i = 0; i < 4; i++)
+			value |= (unsigned int)Data[Position + i] << (i * 8);
+		Position += 4;
+		return value;
+	}
+
+	std::string ReadString()
+	{
+		unsigned int length = ReadUInt();
+		if (Failed || Size - Position < length) { Failed = true; return std::string(); }
+		std::string value((const char*)Data + Position, length);
+		Position += length;
+		return value;
+	}
+
+	// Guards against absurd counts in corrupt data before resizing vectors
+	unsigned int ReadCount()
+	{
+		unsigned int count = ReadUInt();
+		if (count > Size - Position) { Failed = true; return 0; }
+		return count;
+	}
+};
+
+/// <summary>
+/// Appends the reflection data to a byte buffer
+/// </summary>
+void ShaderReflectionData::Serialize(std::vector<unsigned char>& out) const
+{
+	WriteUInt(out, ReflectionMagic);
+
+	WriteUInt(out, (unsigned int)ConstantBuffers.size());
+	for (const ReflectedConstantBuffer& cb : ConstantBuffers)
+	{
+		WriteString(out, cb.Name);
+		WriteUInt(out, cb.Type);
+		WriteUInt(out, cb.Size);
+		WriteUInt(out, cb.BindIndex);
+		WriteUInt(out, (unsigned int)cb.Variables.size());
+		for (const ReflectedVariable& v : cb.Variables)
+		{
+			WriteString(out, v.Name);
+			WriteUInt(out, v.ByteOffset);
+			WriteUInt(out, v.Size);
+		}
+	}
+
+	const std::vector<ReflectedResource>* resourceLists[] = { &Textures, &Samplers };
+	for (const std::vector<ReflectedResource>* list : resourceLists)
+	{
+		WriteUInt(out, (unsigned int)list->size());
+		for (const ReflectedResource& r : *list)
+		{
+			WriteString(out, r.Name);
+			WriteUInt(out, r.BindIndex);
+		}
+	}
+
+	WriteUInt(out, (unsigned int)Inputs.size());
+	for (const ReflectedInputElement& input : Inputs)
+	{
+		WriteString(out, input.SemanticName);
+		WriteUInt(out, input.SemanticIndex);
+		WriteUInt(out, input.Mask);
+		WriteUInt(out, input.ComponentType);
+	}
+}
+
+/// <summary>
+/// Replaces this data with data previously written by Serialize()
+/// </summary>
+/// <returns>False (leaving this data empty) if the buffer is truncated, too long, or not reflection data</returns>
+bool ShaderReflectionData::Deserialize(const unsigned char* data, size_t size)
+{
+	*this = ShaderReflectionData();
+	ReflectionReader reader = { data, size, 0, false };
+
+	if (reader.ReadUInt() != ReflectionMagic)
+		return false;
+
+	ConstantBuffers.resize(reader.ReadCount());
+	for (ReflectedConstantBuffer& cb : ConstantBuffers)
+	{
+		cb.Name = reader.ReadString();
+		cb.Type = reader.ReadUInt();
+		cb.Size = reader.ReadUInt();
+		cb.BindIndex = reader.ReadUInt();
+		cb.Variables.resize(reader.ReadCount());
+		for (ReflectedVariable& v : cb.Variables)
+		{
+			v.Name = reader.ReadString();
+			v.ByteOffset = reader.ReadUInt();
+			v.Size = reader.ReadUInt();
+		}
+	}
+
+	std::vector<ReflectedResource>* resourceLists[] = { &Textures, &Samplers };
+	for (std::vector<ReflectedResource>* list : resourceLists)
+	{
+		list->resize(reader.ReadCount());
+		for (ReflectedResource& r : *list)
+		{
+			r.Name = reader.ReadString();
+			r.BindIndex = reader.ReadUInt();
+		}
+	}
+
+	Inputs.resize(reader.ReadCount());
+	for (ReflectedInputElement& input : Inputs)
+	{
+		input.SemanticName = reader.ReadString();
+		input.SemanticIndex = reader.ReadUInt();
+		input.Mask = reader.ReadUInt();
+		input.ComponentType = reader.ReadUInt();
+	}
+
+	// Anything left over means the counts were wrong
+	if (reader.Failed || reader.Position != reader.Size)
+	{
+		*this = ShaderReflectionData();
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Plain copies of the parts of D3D11 shader reflection that
+// SimpleShader uses. Kept free of D3D types so they can be
+// saved next to cached bytecode and read back without
+// calling D3DReflect again.
+// --------------------------------------------------------
+struct ReflectedVariable
+{
+	std::string Name;
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;
+};
+
+struct ReflectedConstantBuffer
+{
+	std::string Name;
+	unsigned int Type = 0;			// D3D_CBUFFER_TYPE
+	unsigned int Size = 0;
+	unsigned int BindIndex = 0;
+	std::vector<ReflectedVariable> Variables;
+};
+
+// Textures (and structured buffers) and samplers
+struct ReflectedResource
+{
+	std::string Name;
+	unsigned int BindIndex = 0;
+};
+
+// Vertex shader inputs, for building input layouts
+struct ReflectedInputElement
+{
+	std::string SemanticName;
+	unsigned int SemanticIndex = 0;
+	unsigned int Mask = 0;
+	unsigned int ComponentType = 0;	// D3D_REGISTER_COMPONENT_TYPE
+};
+
+struct ShaderReflectionData
+{
+	std::vector<ReflectedConstantBuffer> ConstantBuffers;
+	std::vector<ReflectedResource> Textures;
+	std::vector<ReflectedResource> Samplers;
+	std::vector<ReflectedInputElement> Inputs;
+
+	void Serialize(std::vector<unsigned char>& out) const;
+	bool Deserialize(const unsigned char* data, size_t size);
+};
@@ -0,0 +1,20 @@
+#include "ShadingRate.h"
+
+/// <summary>
+/// Picks an entity's shading rate. Switching to coarse takes going
+/// Hysteresis past a threshold; switching back, Hysteresis inside both.
+/// </summary>
+/// <param name="distance">From the camera to the bounding sphere's center</param>
+/// <param name="screenRadius">The bounding radius on screen, in pixels (see MeshSimplifier::GetScreenRadius())</param>
+/// <param name="current">The rate drawn last frame</param>
+ShadingRate ShadingRateSelector::Select(float distance, float screenRadius, ShadingRate current, const ShadingRateSelection& selection)
+{
+	// A camera inside the bounds is as close as it gets
+	if (!(distance > 0.0f) || !(screenRadius >= 0.0f))
+		return ShadingRate::Full;
+
+	float margin = current == ShadingRate::Full ? selection.Hysteresis : -selection.Hysteresis;
+	bool distant = distance > selection.CoarseDistance * (1.0f + margin);
+	bool tiny = screenRadius < selection.CoarseScreenRadius * (1.0f - margin);
+	return distant || tiny ? ShadingRate::Coarse : ShadingRate::Full;
+}
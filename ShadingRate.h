@@ -0,0 +1,29 @@
+#pragma once
+
+// How often an entity's lights are evaluated
+enum class ShadingRate : unsigned char
+{
+	Full,		// Every pixel
+	Coarse		// Once per 2x2 quad, shared (PixelShader.hlsl's COARSE_LIGHTING)
+};
+
+// When an entity is far enough, or small enough on screen, for coarse lighting
+struct ShadingRateSelection
+{
+	float CoarseDistance = 30.0f;		// World units from the camera to the bounding sphere's center
+	float CoarseScreenRadius = 48.0f;	// Pixels; bounding spheres smaller than this on screen
+	float Hysteresis = 0.15f;			// Fraction past a threshold either has to go before switching, both ways
+};
+
+// --------------------------------------------------------
+// Picks each entity's shading rate from its bounds and the
+// camera, like levels of detail are: coarse once it's past
+// either threshold, full again only once it's back inside
+// both, with a band of hysteresis around each so entities
+// near one don't switch every frame.
+// --------------------------------------------------------
+class ShadingRateSelector
+{
+	public:
+		static ShadingRate Select(float distance, float screenRadius, ShadingRate current, const ShadingRateSelection& selection);
+};
@@ -0,0 +1,308 @@
+#include "ShadowCascades.h"
+#include "CpuUtilities.h"
+
+#include <algorithm>
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHADOW_CASCADES_AVX2
+#if defined(_MSC_VER)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+static float Dot(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Cross(const float a[3], const float b[3], float result[3])
+{
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void Normalize(float v[3])
+{
+	float length = sqrtf(Dot(v, v));
+	if (length > 0.0f)
+		for (int i = 0; i < 3; i++)
+			v[i] /= length;
+}
+
+// Row vectors, so a * b applies a first
+static void Multiply(const float a[16], const float b[16], float result[16])
+{
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			result[row * 4 + column] =
+				a[row * 4 + 0] * b[0 * 4 + column] + a[row * 4 + 1] * b[1 * 4 + column] +
+				a[row * 4 + 2] * b[2 * 4 + column] + a[row * 4 + 3] * b[3 * 4 + column];
+}
+
+// Scalar version of CullAvx2(): every sphere that overlaps the cascade's box
+static void CullScalar(const CasterSpheres& spheres, size_t first, const ShadowCascade& cascade, std::vector<unsigned int>& casters)
+{
+	for (size_t i = first; i < spheres.Size(); i++)
+	{
+		float r = spheres.Radius[i];
+		bool inside = true;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float p = cascade.Axes[axis][0] * spheres.X[i] + cascade.Axes[axis][1] * spheres.Y[i] + cascade.Axes[axis][2] * spheres.Z[i];
+			inside = inside && p + r >= cascade.BoxMin[axis] && p - r <= cascade.BoxMax[axis];
+		}
+		if (inside)
+			casters.push_back((unsigned int)i);
+	}
+}
+
+#ifdef SHADOW_CASCADES_AVX2
+// Tests eight spheres at a time against the box's three slabs
+// Returns where it stopped; the scalar version does the rest
+AVX2_FUNCTION static size_t CullAvx2(const CasterSpheres& spheres, const ShadowCascade& cascade, std::vector<unsigned int>& casters)
+{
+	__m256 axes[3][3], boxMin[3], boxMax[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int i = 0; i < 3; i++)
+			axes[axis][i] = _mm256_set1_ps(cascade.Axes[axis][i]);
+		boxMin[axis] = _mm256_set1_ps(cascade.BoxMin[axis]);
+		boxMax[axis] = _mm256_set1_ps(cascade.BoxMax[axis]);
+	}
+
+	size_t count = spheres.Size() & ~(size_t)7;
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&spheres.X[i]);
+		__m256 y = _mm256_loadu_ps(&spheres.Y[i]);
+		__m256 z = _mm256_loadu_ps(&spheres.Z[i]);
+		__m256 r = _mm256_loadu_ps(&spheres.Radius[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m256 p = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(axes[axis][0], x), _mm256_mul_ps(axes[axis][1], y)), _mm256_mul_ps(axes[axis][2], z));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(p, r), boxMin[axis], _CMP_GE_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_sub_ps(p, r), boxMax[axis], _CMP_LE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		while (mask)
+		{
+			int lane = 0;
+			while (!(mask & (1 << lane)))
+				lane++;
+			casters.push_back((unsigned int)(i + lane));
+			mask &= mask - 1;
+		}
+	}
+	return count;
+}
+#endif
+
+/// <summary>
+/// Constructor. Nothing is fit until Fit().
+/// </summary>
+ShadowCascades::ShadowCascades(CascadeSettings _settings)
+	:
+	settings(_settings)
+{
+	settings.CascadeCount = (std::min)((std::max)(settings.CascadeCount, 1u), (unsigned int)MAX_SHADOW_CASCADES);
+	settings.Resolution = (std::max)(settings.Resolution, 16u);
+}
+
+/// <summary>
+/// Splits the camera's view distance and fits a light-space box
+/// to each slice
+/// </summary>
+/// <param name="lightDirection">The way the light travels; needn't be normalized</param>
+void ShadowCascades::Fit(const CascadeCamera& camera, const float lightDirection[3])
+{
+	float splits[MAX_SHADOW_CASCADES + 1];
+	float farPlane = (std::min)(camera.FarPlane, settings.MaxDistance);
+	ComputeSplits(camera.NearPlane, (std::max)(farPlane, camera.NearPlane * 2.0f), settings.CascadeCount, settings.SplitLambda, splits);
+
+	// Light space: z along the light, y as close to world up as it can be
+	float z[3] = { lightDirection[0], lightDirection[1], lightDirection[2] };
+	Normalize(z);
+	float up[3] = { 0, 1, 0 };
+	if (fabsf(z[1]) > 0.99f)
+	{
+		up[1] = 0;
+		up[2] = 1;
+	}
+	float x[3], y[3];
+	Cross(up, z, x);
+	Normalize(x);
+	Cross(z, x, y);
+
+	float tanY = tanf(camera.FieldOfView * 0.5f);
+	float tanX = tanY * camera.AspectRatio;
+	float k = tanX * tanX + tanY * tanY;
+
+	for (unsigned int c = 0; c < settings.CascadeCount; c++)
+	{
+		ShadowCascade& cascade = cascades[c];
+		cascade.SplitNear = splits[c];
+		cascade.SplitFar = splits[c + 1];
+
+		// The smallest sphere around the slice: on the forward axis, as far from a
+		// near corner as from a far one, unless that's past the far plane. Only the
+		// splits and the lens decide its size, so turning doesn't change it.
+		float n = cascade.SplitNear, f = cascade.SplitFar;
+		float centerDistance = (std::min)(0.5f * (n + f) * (1.0f + k), f);
+		float radius = sqrtf((f - centerDistance) * (f - centerDistance) + f * f * k);
+
+		// Padded by a texel, since snapping moves the box by up to half of one
+		radius *= (float)settings.Resolution / (settings.Resolution - 2);
+		float texel = 2.0f * radius / settings.Resolution;
+
+		float center[3];
+		for (int i = 0; i < 3; i++)
+			center[i] = camera.Position[i] + camera.Forward[i] * centerDistance;
+
+		// Snapping the center to whole texels across the light keeps
+		// texel edges still in the world as the camera moves
+		float lightX = Dot(center, x), lightY = Dot(center, y);
+		float snappedX = floorf(lightX / texel + 0.5f) * texel;
+		float snappedY = floorf(lightY / texel + 0.5f) * texel;
+		for (int i = 0; i < 3; i++)
+			center[i] += x[i] * (snappedX - lightX) + y[i] * (snappedY - lightY);
+
+		for (int i = 0; i < 3; i++)
+		{
+			cascade.Center[i] = center[i];
+			cascade.Axes[0][i] = x[i];
+			cascade.Axes[1][i] = y[i];
+			cascade.Axes[2][i] = z[i];
+		}
+		cascade.Radius = radius;
+		cascade.TexelSize = texel;
+
+		// Casters between the light and the slice still cast into it
+		float lightZ = Dot(center, z);
+		float depth = 2.0f * radius + settings.CasterDistance;
+		cascade.BoxMin[0] = snappedX - radius;
+		cascade.BoxMin[1] = snappedY - radius;
+		cascade.BoxMin[2] = lightZ - radius - settings.CasterDistance;
+		cascade.BoxMax[0] = snappedX + radius;
+		cascade.BoxMax[1] = snappedY + radius;
+		cascade.BoxMax[2] = lightZ + radius;
+
+		// Like XMMatrixLookToLH(), from the box's near face...
+		float eye[3];
+		for (int i = 0; i < 3; i++)
+			eye[i] = center[i] - z[i] * (radius + settings.CasterDistance);
+		float* view = cascade.View;
+		for (int i = 0; i < 3; i++)
+		{
+			view[i * 4 + 0] = x[i];
+			view[i * 4 + 1] = y[i];
+			view[i * 4 + 2] = z[i];
+			view[i * 4 + 3] = 0.0f;
+		}
+		view[12] = -Dot(x, eye);
+		view[13] = -Dot(y, eye);
+		view[14] = -Dot(z, eye);
+		view[15] = 1.0f;
+
+		// ...and XMMatrixOrthographicLH() through the box
+		float* projection = cascade.Projection;
+		for (int i = 0; i < 16; i++)
+			projection[i] = 0.0f;
+		projection[0] = 1.0f / radius;
+		projection[5] = 1.0f / radius;
+		projection[10] = 1.0f / depth;
+		projection[15] = 1.0f;
+
+		Multiply(view, projection, cascade.ViewProjection);
+	}
+}
+
+/// <summary>
+/// Finds the spheres each cascade has to draw: the ones that
+/// overlap its box, which runs from the slice back toward the
+/// light. Conservative: a sphere near a box's edge may pass
+/// without quite touching it.
+/// </summary>
+/// <param name="useSimd">AVX2, when the CPU has it; the results are identical</param>
+void ShadowCascades::Cull(const CasterSpheres& spheres, bool useSimd)
+{
+	bool simd = useSimd && CpuUtilities::HasAvx2();
+	for (unsigned int c = 0; c < settings.CascadeCount; c++)
+	{
+		casters[c].clear();
+		size_t first = 0;
+#ifdef SHADOW_CASCADES_AVX2
+		if (simd)
+			first = CullAvx2(spheres, cascades[c], casters[c]);
+#endif
+		CullScalar(spheres, first, cascades[c], casters[c]);
+	}
+}
+
+// Getters
+const CascadeSettings& ShadowCascades::GetSettings() { return settings; }
+unsigned int ShadowCascades::GetCascadeCount() { return settings.CascadeCount; }
+const ShadowCascade& ShadowCascades::GetCascade(unsigned int index) { return cascades[index]; }
+const std::vector<unsigned int>& ShadowCascades::GetCasters(unsigned int cascade) { return casters[cascade]; }
+
+/// <summary>
+/// The "practical" split scheme: a blend of even and logarithmic
+/// splits, so near cascades stay small without the far ones
+/// getting huge
+/// </summary>
+/// <param name="splits">Receives count + 1 distances, from nearPlane to farPlane</param>
+void ShadowCascades::ComputeSplits(float nearPlane, float farPlane, unsigned int count, float lambda, float splits[])
+{
+	splits[0] = nearPlane;
+	for (unsigned int i = 1; i < count; i++)
+	{
+		float t = (float)i / count;
+		float logarithmic = nearPlane * powf(farPlane / nearPlane, t);
+		float uniform = nearPlane + (farPlane - nearPlane) * t;
+		splits[i] = lambda * logarithmic + (1.0f - lambda) * uniform;
+	}
+	splits[count] = farPlane;
+}
+
+/// <summary>
+/// The corners of the part of the camera's frustum between two
+/// distances: near face first, then far, each counter-clockwise
+/// from the bottom left
+/// </summary>
+void ShadowCascades::GetSliceCorners(const CascadeCamera& camera, float nearDistance, float farDistance, float corners[8][3])
+{
+	float tanY = tanf(camera.FieldOfView * 0.5f);
+	float tanX = tanY * camera.AspectRatio;
+	const float signs[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+	for (int face = 0; face < 2; face++)
+	{
+		float distance = face == 0 ? nearDistance : farDistance;
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float sideways = signs[corner][0] * tanX * distance;
+			float upward = signs[corner][1] * tanY * distance;
+			for (int i = 0; i < 3; i++)
+				corners[face * 4 + corner][i] = camera.Position[i] + camera.Forward[i] * distance + camera.Right[i] * sideways + camera.Up[i] * upward;
+		}
+	}
+}
+
+/// <summary>
+/// Transforms a point (w = 1) by a row-vector matrix
+/// </summary>
+void ShadowCascades::TransformPoint(const float point[3], const float matrix[16], float result[4])
+{
+	for (int column = 0; column < 4; column++)
+		result[column] = point[0] * matrix[column] + point[1] * matrix[4 + column] + point[2] * matrix[8 + column] + matrix[12 + column];
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// Most cascades a shadow map array holds (must match MAX_SHADOW_CASCADES in ShaderIncludes.hlsli)
+#define MAX_SHADOW_CASCADES 4
+
+// What the cascades are fit to: the camera's position, basis and lens
+struct CascadeCamera
+{
+	float Position[3] = {};
+	float Right[3] = { 1, 0, 0 };
+	float Up[3] = { 0, 1, 0 };
+	float Forward[3] = { 0, 0, 1 };
+	float FieldOfView = 0.785398f;	// Vertical, in radians
+	float AspectRatio = 1.0f;
+	float NearPlane = 0.01f;
+	float FarPlane = 1000.0f;
+};
+
+struct CascadeSettings
+{
+	unsigned int CascadeCount = 4;		// At most MAX_SHADOW_CASCADES
+	unsigned int Resolution = 2048;		// Of each cascade's shadow map
+	float MaxDistance = 100.0f;			// Shadows end here, or at the far plane if it's closer
+	float SplitLambda = 0.75f;			// 0 splits the distance evenly, 1 logarithmically
+	float CasterDistance = 50.0f;		// How far toward the light casters are kept
+};
+
+// One cascade's light-space box and matrices. Matrices are row major
+// and for row vectors, like DirectXMath's (left-handed, depth 0 to 1).
+struct ShadowCascade
+{
+	float SplitNear = 0.0f;		// Distances along the camera's forward axis
+	float SplitFar = 0.0f;
+	float Center[3] = {};		// Of the bounding sphere, after snapping
+	float Radius = 0.0f;		// Half the box's width, padded by a texel
+	float TexelSize = 0.0f;		// World units per shadow map texel
+	float Axes[3][3] = {};		// Light space's x, y and z (the light's direction)
+	float BoxMin[3] = {};		// The box, in light space coordinates
+	float BoxMax[3] = {};
+	float View[16] = {};
+	float Projection[16] = {};
+	float ViewProjection[16] = {};
+};
+
+// Bounding spheres of shadow casters, one array per component
+// so the culling loop reads them eight at a time
+struct CasterSpheres
+{
+	std::vector<float> X;
+	std::vector<float> Y;
+	std::vector<float> Z;
+	std::vector<float> Radius;
+
+	void Clear() { X.clear(); Y.clear(); Z.clear(); Radius.clear(); }
+	void Add(float x, float y, float z, float radius) { X.push_back(x); Y.push_back(y); Z.push_back(z); Radius.push_back(radius); }
+	size_t Size() const { return X.size(); }
+};
+
+// --------------------------------------------------------
+// Cascaded shadow maps for one directional light, on the
+// CPU: splitting the view distance, fitting each slice of
+// the camera's frustum with a light-space box, and picking
+// the casters each cascade has to draw.
+//
+// Each slice is bounded by a sphere rather than a tight box,
+// so the box's size doesn't change as the camera turns, and
+// its center is snapped to whole shadow map texels, so it
+// doesn't shimmer as the camera moves.
+// --------------------------------------------------------
+class ShadowCascades
+{
+	public:
+		ShadowCascades(CascadeSettings _settings);
+
+		void Fit(const CascadeCamera& camera, const float lightDirection[3]);
+		void Cull(const CasterSpheres& spheres, bool useSimd = true);
+
+		// Getters
+		const CascadeSettings& GetSettings();
+		unsigned int GetCascadeCount();
+		const ShadowCascade& GetCascade(unsigned int index);
+		const std::vector<unsigned int>& GetCasters(unsigned int cascade);
+
+		// Helpers
+		static void ComputeSplits(float nearPlane, float farPlane, unsigned int count, float lambda, float splits[]);
+		static void GetSliceCorners(const CascadeCamera& camera, float nearDistance, float farDistance, float corners[8][3]);
+		static void TransformPoint(const float point[3], const float matrix[16], float result[4]);
+
+	private:
+		CascadeSettings settings;
+		ShadowCascade cascades[MAX_SHADOW_CASCADES];
+		std::vector<unsigned int> casters[MAX_SHADOW_CASCADES];	// Indices into the last Cull()'s spheres
+};
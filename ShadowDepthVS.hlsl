@@ -0,0 +1,18 @@
+// --------------------------------------------------------
+// Depth only, from a shadow-casting light (see ShadowRenderer).
+// Only the position is read, so just the mesh's position
+// stream is bound; there's no pixel shader.
+// --------------------------------------------------------
+cbuffer ExternalData : register(b0)
+{
+	matrix world;
+	matrix viewProjection;	// The cascade's
+	float3 positionScale;	// The mesh's, to unpack positions
+	float3 positionOffset;
+}
+
+float4 main(float4 packedPosition : POSITION_UNORM16) : SV_POSITION
+{
+	float3 localPosition = packedPosition.xyz * positionScale + positionOffset;
+	return mul(viewProjection, mul(world, float4(localPosition, 1.0f)));
+}
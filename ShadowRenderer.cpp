@@ -0,0 +1,232 @@
+#include "ShadowRenderer.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// PixelShader.hlsl's ShadowMap register, unbound before the maps are drawn into
+static const UINT ShadowMapSlot = 7;
+
+/// <summary>
+/// Constructor. Creates the shadow maps and the states the pass
+/// and the shader's lookups use.
+/// </summary>
+/// <param name="_depthShader">ShadowDepthVS.hlsl</param>
+/// <param name="_settings">Cascade count, map size and shadow distance</param>
+ShadowRenderer::ShadowRenderer(
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	std::shared_ptr<RenderStateCache> _renderStates,
+	std::shared_ptr<SimpleVertexShader> _depthShader,
+	CascadeSettings _settings)
+	:
+	device(_device),
+	context(_context),
+	renderStates(_renderStates),
+	depthShader(_depthShader),
+	cascades(_settings),
+	enabled(true),
+	lightIndex(-1)
+{
+	// Bias grows with the slope, where acne is worst. Depth clipping is
+	// off, so casters in front of a cascade's near plane are flattened
+	// onto it rather than lost.
+	D3D11_RASTERIZER_DESC rasterizerDesc = {};
+	rasterizerDesc.FillMode = D3D11_FILL_SOLID;
+	rasterizerDesc.CullMode = D3D11_CULL_BACK;
+	rasterizerDesc.DepthBias = 1000;
+	rasterizerDesc.SlopeScaledDepthBias = 2.0f;
+	rasterizerDesc.DepthClipEnable = FALSE;
+	depthState.Rasterizer = renderStates->GetRasterizerId(rasterizerDesc);
+
+	// Outside the maps is lit
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.BorderColor[0] = 1.0f;
+	samplerDesc.BorderColor[1] = 1.0f;
+	samplerDesc.BorderColor[2] = 1.0f;
+	samplerDesc.BorderColor[3] = 1.0f;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	comparisonSampler = renderStates->GetSampler(renderStates->GetSamplerId(samplerDesc));
+
+	if (!CreateMaps())
+	{
+		printf("Unable to create the shadow maps\n");
+		enabled = false;
+	}
+}
+
+/// <summary>
+/// Fits the cascades to the camera, culls the entities for each,
+/// and draws their depth from the first directional light.
+/// Leaves the render target, viewport and input layout changed;
+/// call before binding them for the main pass.
+/// </summary>
+/// <param name="lightCount">How many of the lights reach the shader</param>
+void ShadowRenderer::Render(std::shared_ptr<Camera> camera, const std::vector<Light>& lights, int lightCount, const std::vector<std::shared_ptr<Entity>>& entities)
+{
+	stats = ShadowStats();
+	lightIndex = -1;
+	if (!enabled || !depthShader->IsShaderValid())
+		return;
+
+	for (int i = 0; i < lightCount && lightIndex < 0; i++)
+		if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
+			lightIndex = i;
+	if (lightIndex < 0)
+		return;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	Transform* transform = camera->GetTransform();
+	XMFLOAT3 position = transform->GetPosition();
+	XMFLOAT3 right = transform->GetRight();
+	XMFLOAT3 up = transform->GetUp();
+	XMFLOAT3 forward = transform->GetForward();
+	CascadeCamera view;
+	memcpy(view.Position, &position, sizeof(view.Position));
+	memcpy(view.Right, &right, sizeof(view.Right));
+	memcpy(view.Up, &up, sizeof(view.Up));
+	memcpy(view.Forward, &forward, sizeof(view.Forward));
+	view.FieldOfView = camera->GetFieldOfView();
+	view.AspectRatio = camera->GetAspectRatio();
+	view.NearPlane = camera->GetNearPlane();
+	view.FarPlane = camera->GetFarPlane();
+
+	const XMFLOAT3& direction = lights[lightIndex].Direction;
+	const float lightDirection[3] = { direction.x, direction.y, direction.z };
+	cascades.Fit(view, lightDirection);
+
+	spheres.Clear();
+	for (const std::shared_ptr<Entity>& entity : entities)
+	{
+		XMFLOAT3 center;
+		float radius;
+		entity->GetWorldBounds(center, radius);
+		spheres.Add(center.x, center.y, center.z, radius);
+	}
+	cascades.Cull(spheres);
+	stats.CullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// Last frame's maps are still bound for reading
+	ID3D11ShaderResourceView* none[1] = {};
+	context->PSSetShaderResources(ShadowMapSlot, 1, none);
+
+	unsigned int resolution = cascades.GetSettings().Resolution;
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)resolution;
+	viewport.Height = (float)resolution;
+	viewport.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &viewport);
+
+	// Depth only: no pixel shader at all
+	depthShader->SetShader();
+	context->PSSetShader(0, 0, 0);
+	renderStates->Apply(depthState);
+
+	stats.Cascades = cascades.GetCascadeCount();
+	for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+	{
+		context->ClearDepthStencilView(cascadeDSVs[c].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		context->OMSetRenderTargets(0, 0, cascadeDSVs[c].Get());
+
+		XMFLOAT4X4 viewProjection;
+		memcpy(&viewProjection, cascades.GetCascade(c).ViewProjection, sizeof(viewProjection));
+		depthShader->SetMatrix4x4("viewProjection", viewProjection);
+
+		const std::vector<unsigned int>& casters = cascades.GetCasters(c);
+		stats.Casters[c] = (unsigned int)casters.size();
+		for (unsigned int index : casters)
+		{
+			const std::shared_ptr<Entity>& entity = entities[index];
+			std::shared_ptr<Mesh> mesh = entity->GetMesh();
+			depthShader->SetMatrix4x4("world", entity->GetTransform()->GetWorldMatrix());
+			depthShader->SetFloat3("positionScale", mesh->GetPositionScale());
+			depthShader->SetFloat3("positionOffset", mesh->GetPositionOffset());
+			depthShader->CopyAllBufferData();
+
+			// The level picked for the camera; shadows are seen at about that size
+			MeshLod lod = mesh->GetLod(entity->GetLod());
+			mesh->SetBuffers(context, true);
+			context->DrawIndexed(lod.IndexCount, lod.IndexStart, 0);
+			stats.DrawCalls++;
+		}
+	}
+}
+
+/// <summary>
+/// Sets the shadow maps, sampler and matrices. With nothing drawn
+/// (shadows off, or no directional light) the shader skips them.
+/// Call before the shader's CopyAllBufferData().
+/// </summary>
+void ShadowRenderer::Bind(std::shared_ptr<SimplePixelShader> pixelShader)
+{
+	XMFLOAT4X4 viewProjections[MAX_SHADOW_CASCADES] = {};
+	float texelSizes[4] = {};
+	for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+	{
+		memcpy(&viewProjections[c], cascades.GetCascade(c).ViewProjection, sizeof(XMFLOAT4X4));
+		texelSizes[c] = cascades.GetCascade(c).TexelSize;
+	}
+
+	pixelShader->SetShaderResourceView("ShadowMap", shadowSRV);
+	pixelShader->SetSamplerState("ShadowSampler", comparisonSampler);
+	pixelShader->SetInt("shadowCascadeCount", lightIndex >= 0 ? (int)cascades.GetCascadeCount() : 0);
+	pixelShader->SetInt("shadowLightIndex", lightIndex);
+	pixelShader->SetData("shadowViewProjections", viewProjections, sizeof(viewProjections));
+	pixelShader->SetFloat4("shadowTexelSizes", XMFLOAT4(texelSizes));
+	pixelShader->SetFloat("shadowMapSize", (float)cascades.GetSettings().Resolution);
+}
+
+// Getters
+bool ShadowRenderer::IsEnabled() { return enabled; }
+ShadowStats ShadowRenderer::GetStats() { return stats; }
+
+// Setters
+void ShadowRenderer::SetEnabled(bool _enabled) { enabled = _enabled && shadowSRV.Get() != 0; }
+
+/// <summary>
+/// One depth texture array, a slice per cascade: a depth view
+/// of each slice to draw into, and one view of them all to read
+/// </summary>
+bool ShadowRenderer::CreateMaps()
+{
+	const CascadeSettings& settings = cascades.GetSettings();
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = settings.Resolution;
+	desc.Height = settings.Resolution;
+	desc.MipLevels = 1;
+	desc.ArraySize = settings.CascadeCount;
+	desc.Format = DXGI_FORMAT_R32_TYPELESS;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(device->CreateTexture2D(&desc, 0, texture.GetAddressOf())))
+		return false;
+
+	for (unsigned int c = 0; c < settings.CascadeCount; c++)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		dsvDesc.Texture2DArray.FirstArraySlice = c;
+		dsvDesc.Texture2DArray.ArraySize = 1;
+		if (FAILED(device->CreateDepthStencilView(texture.Get(), &dsvDesc, cascadeDSVs[c].GetAddressOf())))
+			return false;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.ArraySize = settings.CascadeCount;
+	return SUCCEEDED(device->CreateShaderResourceView(texture.Get(), &srvDesc, shadowSRV.GetAddressOf()));
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+#include "Camera.h"
+#include "Entity.h"
+#include "Light.h"
+#include "RenderStateCache.h"
+#include "ShadowCascades.h"
+#include "SimpleShader.h"
+
+// What the last Render() drew
+struct ShadowStats
+{
+	unsigned int Cascades = 0;
+	unsigned int Casters[MAX_SHADOW_CASCADES] = {};	// Per cascade, after culling
+	unsigned int DrawCalls = 0;
+	double CullMs = 0.0;	// Bounds, fitting and culling, on the CPU
+};
+
+// --------------------------------------------------------
+// Cascaded shadow maps for the first directional light.
+// ShadowCascades fits and culls on the CPU; this draws each
+// cascade's casters into a slice of a depth texture array,
+// with a depth-only vertex shader that reads nothing but
+// positions, from meshes' position streams.
+//
+// Bind() hands the maps and matrices to the PBR pixel shader,
+// which picks a cascade per pixel and filters 3x3 taps.
+// --------------------------------------------------------
+class ShadowRenderer
+{
+	public:
+		ShadowRenderer(
+			Microsoft::WRL::ComPtr<ID3D11Device> _device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+			std::shared_ptr<RenderStateCache> _renderStates,
+			std::shared_ptr<SimpleVertexShader> _depthShader,
+			CascadeSettings _settings);
+
+		void Render(std::shared_ptr<Camera> camera, const std::vector<Light>& lights, int lightCount, const std::vector<std::shared_ptr<Entity>>& entities);
+		void Bind(std::shared_ptr<SimplePixelShader> pixelShader);
+
+		// Getters
+		bool IsEnabled();
+		ShadowStats GetStats();
+
+		// Setters
+		void SetEnabled(bool _enabled);
+
+	private:
+		bool CreateMaps();
+
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		std::shared_ptr<RenderStateCache> renderStates;
+		std::shared_ptr<SimpleVertexShader> depthShader;
+
+		ShadowCascades cascades;
+		CasterSpheres spheres;	// Reused every frame
+
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> cascadeDSVs[MAX_SHADOW_CASCADES];
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> comparisonSampler;
+		RenderState depthState;
+
+		bool enabled;
+		int lightIndex;		// Of the light casting shadows; -1 if nothing was drawn
+		ShadowStats stats;
+};
@@ -54,14 +54,17 @@ void ISimpleShader::CleanUp()
 	if (constantBuffers)
 	{
 		delete[] constantBuffers;
+		constantBuffers = 0;
 		constantBufferCount = 0;
 	}
 
 	for (unsigned int i = 0; i < shaderResourceViews.size(); i++)
 		delete shaderResourceViews[i];
+	shaderResourceViews.clear();
 	
 	for (unsigned int i = 0; i < samplerStates.size(); i++)
 		delete samplerStates[i];
+	samplerStates.clear();
 
 	// Clean up tables
 	varTable.clear();
@@ -94,10 +97,8 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
-	// Create the shader - Calls an overloaded version of this abstract
-	// method in the appropriate child class
-	shaderValid = CreateShader(shaderBlob);
-	if (!shaderValid)
+	// Create the shader and its tables
+	if (!LoadShaderBytecode(shaderBlob))
 	{
 		if (ReportErrors)
 		{
@@ -109,63 +110,167 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	// All set
+	return true;
+}
+
+// --------------------------------------------------------
+// Creates the shader from compiled code and builds the
+// variable table from reflection data.  Safe to call again
+// on the same object (for instance, after a hot reload).
+//
+// blob - The compiled shader code
+// reflectionData - Reflection saved from an earlier load, or
+//                  null to reflect the bytecode now
+// 
+// Returns true if shader is created properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderBytecode(Microsoft::WRL::ComPtr<ID3DBlob> blob, const ShaderReflectionData* reflectionData)
+{
+	shaderBlob = blob;
+
+	// Reflect first, since creating a vertex shader's
+	// input layout relies on the reflected inputs
+	if (reflectionData)
+		reflection = *reflectionData;
+	else if (!ReflectShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), reflection))
+		return false;
+
+	// Create the shader - Calls an overloaded version of this abstract
+	// method in the appropriate child class
+	shaderValid = CreateShader(shaderBlob);
+	if (!shaderValid)
+		return false;
+
+	// Handle bound resources (like shaders and samplers)
+	for (const ReflectedResource& texture : reflection.Textures)
+	{
+		// Create the SRV wrapper
+		SimpleSRV* srv = new SimpleSRV();
+		srv->BindIndex = texture.BindIndex;						// Shader bind point
+		srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
+
+		textureTable.insert(std::pair<std::string, SimpleSRV*>(texture.Name, srv));
+		shaderResourceViews.push_back(srv);
+	}
+
+	for (const ReflectedResource& sampler : reflection.Samplers)
+	{
+		// Create the sampler wrapper
+		SimpleSampler* samp = new SimpleSampler();
+		samp->BindIndex = sampler.BindIndex;				// Shader bind point
+		samp->Index = (unsigned int)samplerStates.size();	// Raw index
+
+		samplerTable.insert(std::pair<std::string, SimpleSampler*>(sampler.Name, samp));
+		samplerStates.push_back(samp);
+	}
+
+	// Create resource arrays
+	constantBufferCount = (unsigned int)reflection.ConstantBuffers.size();
+	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+
+	// Loop through all constant buffers
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		const ReflectedConstantBuffer& bufferDesc = reflection.ConstantBuffers[b];
+
+		// Set up the buffer and put its pointer in the table
+		constantBuffers[b].Type = (D3D_CBUFFER_TYPE)bufferDesc.Type;
+		constantBuffers[b].BindIndex = bufferDesc.BindIndex;
+		constantBuffers[b].Name = bufferDesc.Name;
+		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
+
+		// Create this constant buffer
+		D3D11_BUFFER_DESC newBuffDesc = {};
+		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
+		newBuffDesc.ByteWidth = ((bufferDesc.Size + 15) / 16) * 16; // Quick and dirty 16-byte alignment using integer division
+		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		newBuffDesc.CPUAccessFlags = 0;
+		newBuffDesc.MiscFlags = 0;
+		newBuffDesc.StructureByteStride = 0;
+		device->CreateBuffer(&newBuffDesc, 0, constantBuffers[b].ConstantBuffer.GetAddressOf());
+
+		// Set up the data buffer for this constant buffer
+		constantBuffers[b].Size = bufferDesc.Size;
+		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
+		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+
+		// Loop through all variables in this buffer
+		for (const ReflectedVariable& varDesc : bufferDesc.Variables)
+		{
+			// Create the variable struct
+			SimpleShaderVariable varStruct = {};
+			varStruct.ConstantBufferIndex = b;
+			varStruct.ByteOffset = varDesc.ByteOffset;
+			varStruct.Size = varDesc.Size;
+
+			// Add this variable to the table and the constant buffer
+			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varDesc.Name, varStruct));
+			constantBuffers[b].Variables.push_back(varStruct);
+		}
+	}
+
+	// All set
+	return true;
+}
+
+// --------------------------------------------------------
+// Copies everything SimpleShader needs out of D3D shader
+// reflection into plain structs that can be saved to disk.
+// Doesn't touch the device, so it's safe on any thread.
+//
+// bytecode - The compiled shader code
+// size - Size of the code in bytes
+// reflectionData - Filled in with the results
+//
+// Returns true if the bytecode could be reflected
+// --------------------------------------------------------
+bool ISimpleShader::ReflectShader(const void* bytecode, size_t size, ShaderReflectionData& reflectionData)
+{
+	reflectionData = ShaderReflectionData();
+
 	// Set up shader reflection to get information about
 	// this shader and its variables,  buffers, etc.
 	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
+	HRESULT hr = D3DReflect(
+		bytecode,
+		size,
 		IID_ID3D11ShaderReflection,
 		(void**)refl.GetAddressOf());
-	
+	if (FAILED(hr))
+		return false;
+
 	// Get the description of the shader
 	D3D11_SHADER_DESC shaderDesc;
 	refl->GetDesc(&shaderDesc);
 
-	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
-	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
-	
 	// Handle bound resources (like shaders and samplers)
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
+	for (unsigned int r = 0; r < shaderDesc.BoundResources; r++)
 	{
 		// Get this resource's description
 		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
 		refl->GetResourceBindingDesc(r, &resourceDesc);
 
+		ReflectedResource resource;
+		resource.Name = resourceDesc.Name;
+		resource.BindIndex = resourceDesc.BindPoint;
+
 		// Check the type
 		switch (resourceDesc.Type)
 		{
 		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
 		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
+			reflectionData.Textures.push_back(resource);
 			break;
 
 		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
-
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
+			reflectionData.Samplers.push_back(resource);
 			break;
 		}
 	}
 
 	// Loop through all constant buffers
-	for (unsigned int b = 0; b < constantBufferCount; b++)
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
 	{
 		// Get this buffer
 		ID3D11ShaderReflectionConstantBuffer* cb =
@@ -175,61 +280,52 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		D3D11_SHADER_BUFFER_DESC bufferDesc;
 		cb->GetDesc(&bufferDesc);
 
-		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
 		// Get the description of the resource binding, so
 		// we know exactly how it's bound in the shader
 		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
 		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
-		
-		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
-
-		// Create this constant buffer
-		D3D11_BUFFER_DESC newBuffDesc = {};
-		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
-		newBuffDesc.ByteWidth = ((bufferDesc.Size + 15) / 16) * 16; // Quick and dirty 16-byte alignment using integer division
-		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		newBuffDesc.CPUAccessFlags = 0;
-		newBuffDesc.MiscFlags = 0;
-		newBuffDesc.StructureByteStride = 0;
-		device->CreateBuffer(&newBuffDesc, 0, constantBuffers[b].ConstantBuffer.GetAddressOf());
 
-		// Set up the data buffer for this constant buffer
-		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		ReflectedConstantBuffer buffer;
+		buffer.Name = bufferDesc.Name;
+		buffer.Type = bufferDesc.Type;
+		buffer.Size = bufferDesc.Size;
+		buffer.BindIndex = bindDesc.BindPoint;
 
 		// Loop through all variables in this buffer
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
+			// Get the description of the variable
 			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
-
-			// Create the variable struct
-			SimpleShaderVariable varStruct = {};
-			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
+			cb->GetVariableByIndex(v)->GetDesc(&varDesc);
 
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
-			constantBuffers[b].Variables.push_back(varStruct);
+			ReflectedVariable variable;
+			variable.Name = varDesc.Name;
+			variable.ByteOffset = varDesc.StartOffset;
+			variable.Size = varDesc.Size;
+			buffer.Variables.push_back(variable);
 		}
+
+		reflectionData.ConstantBuffers.push_back(buffer);
+	}
+
+	// Vertex inputs, used to build input layouts
+	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		// System values (SV_InstanceID, SV_VertexID) come from the GPU, not a buffer
+		if (paramDesc.SystemValueType != D3D_NAME_UNDEFINED)
+			continue;
+
+		ReflectedInputElement input;
+		input.SemanticName = paramDesc.SemanticName;
+		input.SemanticIndex = paramDesc.SemanticIndex;
+		input.Mask = paramDesc.Mask;
+		input.ComponentType = paramDesc.ComponentType;
+		reflectionData.Inputs.push_back(input);
 	}
 
-	// All set
 	return true;
 }
 
@@ -688,6 +784,17 @@ const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(unsigned int index)
 // ------ SIMPLE VERTEX SHADER ------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
 
+// --------------------------------------------------------
+// Constructor that doesn't load anything yet - the shader
+// stays invalid until LoadShaderBytecode() is called
+// --------------------------------------------------------
+SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+	: ISimpleShader(device, context)
+{
+	this->perInstanceCompatible = false;
+	this->customInputLayout = false;
+}
+
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
@@ -697,6 +804,7 @@ SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> devi
 	// Ensure we set to zero to successfully trigger
 	// the Input Layout creation during LoadShaderFile()
 	this->perInstanceCompatible = false;
+	this->customInputLayout = false;
 
 	// Load the actual compiled shader file
 	this->LoadShaderFile(shaderFile);
@@ -713,6 +821,7 @@ SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> devi
 {
 	// Save the custom input layout
 	this->inputLayout = inputLayout;
+	this->customInputLayout = inputLayout != 0;
 
 	// Unable to determine from an input layout, require user to tell us
 	this->perInstanceCompatible = perInstanceCompatible;
@@ -737,6 +846,35 @@ void SimpleVertexShader::CleanUp()
 	ISimpleShader::CleanUp();
 }
 
+// --------------------------------------------------------
+// Picks a packed format from a semantic's suffix, sized to
+// the components the shader declares (three take up four):
+//
+//  _UNORM16, _SNORM16, _FLOAT16, _UNORM8, _SNORM8
+//
+// Returns DXGI_FORMAT_UNKNOWN for any other semantic
+// --------------------------------------------------------
+DXGI_FORMAT SimpleVertexShader::GetPackedFormat(const std::string& semantic, unsigned int mask)
+{
+	struct PackedSuffix { const char* Suffix; DXGI_FORMAT Formats[3]; };
+	static const PackedSuffix suffixes[] = {
+		{ "_UNORM16", { DXGI_FORMAT_R16_UNORM, DXGI_FORMAT_R16G16_UNORM, DXGI_FORMAT_R16G16B16A16_UNORM } },
+		{ "_SNORM16", { DXGI_FORMAT_R16_SNORM, DXGI_FORMAT_R16G16_SNORM, DXGI_FORMAT_R16G16B16A16_SNORM } },
+		{ "_FLOAT16", { DXGI_FORMAT_R16_FLOAT, DXGI_FORMAT_R16G16_FLOAT, DXGI_FORMAT_R16G16B16A16_FLOAT } },
+		{ "_UNORM8", { DXGI_FORMAT_R8_UNORM, DXGI_FORMAT_R8G8_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM } },
+		{ "_SNORM8", { DXGI_FORMAT_R8_SNORM, DXGI_FORMAT_R8G8_SNORM, DXGI_FORMAT_R8G8B8A8_SNORM } } };
+
+	int size = mask == 1 ? 0 : (mask <= 3 ? 1 : 2);
+	for (const PackedSuffix& packed : suffixes)
+	{
+		std::string suffix = packed.Suffix;
+		if (semantic.size() >= suffix.size() &&
+			semantic.compare(semantic.size() - suffix.size(), suffix.size(), suffix) == 0)
+			return packed.Formats[size];
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
 // --------------------------------------------------------
 // Creates the  Direct3D vertex shader
 //
@@ -755,7 +893,7 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
+		shader.ReleaseAndGetAddressOf());
 
 	// Did the creation work?
 	if (result != S_OK)
@@ -763,33 +901,27 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 
 	// Do we already have an input layout?
 	// (This would come from one of the constructor overloads)
-	if (inputLayout)
+	if (customInputLayout)
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
+	// reflected inputs to create an input layout that 
 	// matches what the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
+	inputLayout.Reset();
+	perInstanceCompatible = false;
 
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
+	// Positions get a stream (input slot) of their own, so depth-only passes
+	// can bind nothing else: POSITION reads slot 0 and the rest of the per-vertex
+	// data slot 1. Shaders without a position read everything from slot 0.
+	bool splitPositions = false;
+	for (const ReflectedInputElement& paramDesc : reflection.Inputs)
+		splitPositions = splitPositions || paramDesc.SemanticName.compare(0, 8, "POSITION") == 0;
 
-	// Read input layout description from shader info
+	// Read input layout description from the reflected inputs
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (const ReflectedInputElement& paramDesc : reflection.Inputs)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
-
 		// Check the semantic name for "_PER_INSTANCE"
 		std::string perInstanceStr = "_PER_INSTANCE";
 		std::string sem = paramDesc.SemanticName;
@@ -800,9 +932,9 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc = {};
-		elementDesc.SemanticName = paramDesc.SemanticName;
+		elementDesc.SemanticName = paramDesc.SemanticName.c_str();
 		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
-		elementDesc.InputSlot = 0;
+		elementDesc.InputSlot = splitPositions && sem.compare(0, 8, "POSITION") != 0 ? 1 : 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 		elementDesc.InstanceDataStepRate = 0;
@@ -810,7 +942,7 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		// Replace anything affected by "per instance" data
 		if (isPerInstance)
 		{
-			elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
+			elementDesc.InputSlot = 2; // Assume per instance data comes from another input slot (after the two vertex streams)!
 			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
 			elementDesc.InstanceDataStepRate = 1;
 
@@ -843,10 +975,21 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 		}
 
+		// Packed vertex data: a suffix on the semantic ("POSITION_UNORM16", etc.)
+		// picks a smaller format, which the input assembler expands to the
+		// floats the shader declares
+		DXGI_FORMAT packedFormat = GetPackedFormat(sem, paramDesc.Mask);
+		if (packedFormat != DXGI_FORMAT_UNKNOWN)
+			elementDesc.Format = packedFormat;
+
 		// Save element desc
 		inputLayoutDesc.push_back(elementDesc);
 	}
 
+	// Shaders that generate their own vertices (from SV_VertexID) have no inputs
+	if (inputLayoutDesc.empty())
+		return true;
+
 	// Try to create Input Layout
 	HRESULT hr = device->CreateInputLayout(
 		&inputLayoutDesc[0], 
@@ -952,6 +1095,15 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 // ------ SIMPLE PIXEL SHADER -------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
 
+// --------------------------------------------------------
+// Constructor that doesn't load anything yet - the shader
+// stays invalid until LoadShaderBytecode() is called
+// --------------------------------------------------------
+SimplePixelShader::SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+	: ISimpleShader(device, context)
+{
+}
+
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
@@ -996,7 +1148,7 @@ bool SimplePixelShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
+		shader.ReleaseAndGetAddressOf());
 
 	// Check the result
 	return (result == S_OK);
@@ -1140,7 +1292,7 @@ bool SimpleDomainShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
+		shader.ReleaseAndGetAddressOf());
 
 	// Check the result
 	return (result == S_OK);
@@ -1283,7 +1435,7 @@ bool SimpleHullShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
+		shader.ReleaseAndGetAddressOf());
 
 	// Check the result
 	return (result == S_OK);
@@ -1435,7 +1587,7 @@ bool SimpleGeometryShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderB
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
+		shader.ReleaseAndGetAddressOf());
 
 	// Check the result
 	return (result == S_OK);
@@ -1507,7 +1659,7 @@ bool SimpleGeometryShader::CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3D
 		0,                              // No buffer strides
 		rast,                           // Index of the stream to rasterize (if any)
 		NULL,                           // Not using class linkage
-		shader.GetAddressOf());
+		shader.ReleaseAndGetAddressOf());
 	
 	return (result == S_OK);
 }
@@ -1724,7 +1876,7 @@ bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBl
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
+		shader.ReleaseAndGetAddressOf());
 
 	// Was the shader created correctly?
 	if (result != S_OK)
@@ -11,6 +11,8 @@
 #include <vector>
 #include <string>
 
+#include "ShaderReflection.h"
+
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -69,6 +71,11 @@ public:
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
 
+	// Creates (or re-creates) the shader from compiled code. Pass reflection
+	// data saved from an earlier load to skip reflecting the bytecode again.
+	bool LoadShaderBytecode(Microsoft::WRL::ComPtr<ID3DBlob> blob, const ShaderReflectionData* reflectionData = 0);
+	static bool ReflectShader(const void* bytecode, size_t size, ShaderReflectionData& reflectionData);
+
 	// Activating the shader and copying data
 	void SetShader();
 	void CopyAllBufferData();
@@ -117,6 +124,7 @@ public:
 	
 	// Misc getters
 	Microsoft::WRL::ComPtr<ID3DBlob> GetShaderBlob() { return shaderBlob; }
+	const ShaderReflectionData& GetReflection() { return reflection; }
 
 	// Error reporting
 	static bool ReportErrors;
@@ -126,6 +134,7 @@ protected:
 	
 	bool shaderValid;
 	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	ShaderReflectionData reflection;
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
 
@@ -171,6 +180,7 @@ protected:
 class SimpleVertexShader : public ISimpleShader
 {
 public:
+	SimpleVertexShader( Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
 	SimpleVertexShader( Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
 	SimpleVertexShader( Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile, Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout, bool perInstanceCompatible);
 	~SimpleVertexShader();
@@ -183,11 +193,13 @@ public:
 
 protected:
 	bool perInstanceCompatible;
+	bool customInputLayout;
 	 Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
 	 Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
 	void CleanUp();
+	static DXGI_FORMAT GetPackedFormat(const std::string& semantic, unsigned int mask);
 };
 
 
@@ -197,6 +209,7 @@ protected:
 class SimplePixelShader : public ISimpleShader
 {
 public:
+	SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
 	SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
 	~SimplePixelShader();
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> GetDirectXShader() { return shader; }
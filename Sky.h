@@ -1,26 +1,33 @@
 #pragma once
 #include "DXCore.h"
-#include "Mesh.h"
 #include "SimpleShader.h"
 #include "Camera.h"
+#include "RenderStateCache.h"
 #include <memory>
 #include <wrl/client.h>
+
+// --------------------------------------------------------
+// Draws the sky as one full-screen triangle at the far
+// plane, with no vertex or index buffer: the vertex shader
+// makes the corners from SV_VertexID, and each pixel's view
+// direction comes from the inverse view-projection. Drawn
+// after the opaque entities, so every pixel they cover is
+// rejected by the depth test before the pixel shader runs.
+// --------------------------------------------------------
 class Sky
 {
 	private:
 		Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skyTexture;
-		Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depthStencil;
-		Microsoft::WRL::ComPtr<ID3D11RasterizerState> rasterizerState;
-		std::shared_ptr<Mesh> mesh;
+		std::shared_ptr<RenderStateCache> renderStates;
+		RenderState renderState;	// Depth test passes at the far plane, without writing
 		std::shared_ptr<SimpleVertexShader> vertexShader;
 		std::shared_ptr<SimplePixelShader> pixelShader;
 
 
 	public:
-		Sky(std::shared_ptr<Mesh> _mesh,
-			Microsoft::WRL::ComPtr<ID3D11SamplerState> _samplerState,
-			Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Sky(Microsoft::WRL::ComPtr<ID3D11SamplerState> _samplerState,
+			std::shared_ptr<RenderStateCache> _renderStates,
 			std::shared_ptr<SimpleVertexShader> _vertexShader,
 			std::shared_ptr<SimplePixelShader> _pixelShader,
 			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture);	// Constructor
@@ -28,4 +35,3 @@ class Sky
 		void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera); // Draws the skybox
 
 };
-
@@ -1,11 +1,4 @@
-struct VertexShaderInput 
-{
-	float3 localPosition	: POSITION;     // XYZ position
-	float3 normal			: NORMAL;
-	float2 uv				: TEXCOORD;
-	float3 tangent			: TANGENT;
-};
-
+// The corners come from SV_VertexID alone; there's no vertex buffer
 struct VertexToPixel
 {
 	float4 position			: SV_POSITION;
@@ -14,30 +7,28 @@ struct VertexToPixel
 
 cbuffer ExternalData : register(b0)
 {
-	matrix viewMatrix;
-	matrix projectionMatrix;
+	matrix inverseViewProjection;	// Of the view without its translation
 }
 
-VertexToPixel main(VertexShaderInput input)
+// --------------------------------------------------------
+// One triangle covering the whole screen: corners at (-1, 1),
+// (3, 1) and (-1, -3) in clip space, clockwise, with the
+// screen inside it. The sky sits on the far plane (z = w),
+// so anything already drawn hides it.
+// --------------------------------------------------------
+VertexToPixel main(uint vertexID : SV_VertexID)
 {
 	// Variable for 
 	VertexToPixel output;
 
-	// Remove translation from the view matrix
-	matrix copyView = viewMatrix;
-	copyView._14 = 0;
-	copyView._24 = 0;
-	copyView._34 = 0;
+	float2 uv = float2((vertexID << 1) & 2, vertexID & 2);
+	float2 clip = uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f);
+	output.position = float4(clip, 1.0f, 1.0f);
 
-	// Apply view and projection matrix to position
-	matrix viewProj = mul(projectionMatrix, copyView);
-	output.position = mul(viewProj, float4(input.localPosition, 1.0f));
-
-	// Set output depth to exactly 1.0f
-	output.position.z = output.position.w;
-
-	// Set sample direction
-	output.sampleDir = input.localPosition;
+	// Unprojected onto the far plane: the view direction, scaled by
+	// w, which is positive everywhere. It's linear across the screen,
+	// so the rasterizer interpolates it exactly.
+	output.sampleDir = mul(inverseViewProjection, float4(clip, 1.0f, 1.0f)).xyz;
 
 	return output;
-}
\ No newline at end of file
+}
@@ -0,0 +1,590 @@
+#include "TextureCooker.h"
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <filesystem>
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+// DXGI_FORMAT values, so this file doesn't need dxgiformat.h
+static const unsigned int DxgiFormatBC1 = 71;
+static const unsigned int DxgiFormatBC4 = 80;
+static const unsigned int DxgiFormatBC5 = 83;
+static const unsigned int DxgiFormatBC7 = 98;
+
+// Block rows handed to each encoder job
+static const unsigned int RowsPerJob = 4;
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void AppendUInt(std::vector<unsigned char>& out, unsigned int value)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back((unsigned char)(value >> (i * 8)));
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+/// <param name="_threadCount">Encoder threads, 0 for one per hardware thread</param>
+TextureCooker::TextureCooker(unsigned int _threadCount)
+	:
+	mipFilter(MipFilter::Box),
+	queue(_threadCount > 0 ? _threadCount : (std::max)(1u, std::thread::hardware_concurrency()))
+{
+}
+
+/// <summary>
+/// Builds the mip chain for an image and compresses every level
+/// </summary>
+/// <param name="image">The source pixels</param>
+/// <param name="role">Decides how mips are filtered</param>
+/// <param name="format">The block format to encode</param>
+/// <param name="generateMips">False to only encode the top level</param>
+/// <param name="texture">The compressed result</param>
+/// <param name="report">Sizes, timings and quality (Name is left alone)</param>
+void TextureCooker::Cook(const CpuImage& image, TextureRole role, BlockFormat format, bool generateMips, CookedTexture& texture, CookReport& report)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<CpuImage> mips;
+	if (generateMips)
+		BuildMipChain(image, role, mips, mipFilter, &queue);
+	else
+		mips.push_back(image);
+	report.MipMs = MillisecondsSince(start);
+
+	texture.Format = format;
+	texture.Width = image.Width;
+	texture.Height = image.Height;
+	texture.Mips.resize(mips.size());
+
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < mips.size(); i++)
+		Encode(mips[i], format, texture.Mips[i]);
+	report.EncodeMs = MillisecondsSince(start);
+
+	report.Role = role;
+	report.Format = format;
+	report.Width = image.Width;
+	report.Height = image.Height;
+	report.MipCount = (unsigned int)mips.size();
+	report.UncompressedBytes = 0;
+	report.CookedBytes = 0;
+	for (size_t i = 0; i < mips.size(); i++)
+	{
+		report.UncompressedBytes += mips[i].Pixels.size();
+		report.CookedBytes += texture.Mips[i].size();
+	}
+
+	CpuImage decoded;
+	Decode(texture.Mips[0], image.Width, image.Height, format, decoded);
+	report.Psnr = ComputePsnr(image, decoded, GetRoleChannels(role));
+}
+
+/// <summary>
+/// Loads a PNG, cooks it and writes the DDS
+/// </summary>
+/// <param name="error">Filled in with the reason on failure, if given</param>
+/// <returns>False if the source can't be read or the output can't be written</returns>
+bool TextureCooker::CookFile(const std::string& sourcePath, const std::string& outputPath, TextureRole role, BlockFormat format, bool generateMips, CookReport& report, std::string* error)
+{
+	CpuImage image;
+	if (!PngReader::Load(sourcePath, image, error))
+		return false;
+
+	CookedTexture texture;
+	report.Name = std::filesystem::path(sourcePath).filename().string();
+	Cook(image, role, format, generateMips, texture, report);
+
+	if (!WriteDds(outputPath, texture))
+	{
+		if (error)
+			*error = "Unable to write '" + outputPath + "'";
+		return false;
+	}
+	return true;
+}
+
+// Getters
+unsigned int TextureCooker::GetThreadCount() { return queue.GetThreadCount(); }
+
+// Setters
+void TextureCooker::SetMipFilter(MipFilter _mipFilter) { mipFilter = _mipFilter; }
+
+/// <summary>
+/// Works out a texture's role from its file name, ex: "bronze_normals.png"
+/// </summary>
+/// <returns>The role, or Albedo if the name doesn't say</returns>
+TextureRole TextureCooker::GuessRole(const std::string& path)
+{
+	std::string stem = std::filesystem::path(path).stem().string();
+	std::transform(stem.begin(), stem.end(), stem.begin(), [](unsigned char c) { return (char)tolower(c); });
+
+	struct Suffix { const char* Text; TextureRole Role; };
+	static const Suffix suffixes[] = {
+		{ "_normals", TextureRole::Normal },
+		{ "_normal", TextureRole::Normal },
+		{ "_roughness", TextureRole::Roughness },
+		{ "_metalness", TextureRole::Metalness },
+		{ "_metal", TextureRole::Metalness },
+		{ "_occlusion", TextureRole::Occlusion },
+		{ "_ao", TextureRole::Occlusion },
+		{ "_orm", TextureRole::Packed } };
+
+	for (const Suffix& suffix : suffixes)
+	{
+		size_t length = strlen(suffix.Text);
+		if (stem.size() >= length && stem.compare(stem.size() - length, length, suffix.Text) == 0)
+			return suffix.Role;
+	}
+	return TextureRole::Albedo;
+}
+
+BlockFormat TextureCooker::GetDefaultFormat(TextureRole role)
+{
+	switch (role)
+	{
+		case TextureRole::Normal: return BlockFormat::BC5;
+		case TextureRole::Roughness: return BlockFormat::BC4;
+		case TextureRole::Metalness: return BlockFormat::BC4;
+		case TextureRole::Occlusion: return BlockFormat::BC4;
+		default: return BlockFormat::BC7;
+	}
+}
+
+const char* TextureCooker::GetRoleName(TextureRole role)
+{
+	switch (role)
+	{
+		case TextureRole::Normal: return "normal";
+		case TextureRole::Roughness: return "roughness";
+		case TextureRole::Metalness: return "metalness";
+		case TextureRole::Occlusion: return "occlusion";
+		case TextureRole::Packed: return "orm";
+		default: return "albedo";
+	}
+}
+
+const char* TextureCooker::GetFormatName(BlockFormat format)
+{
+	switch (format)
+	{
+		case BlockFormat::BC1: return "BC1";
+		case BlockFormat::BC4: return "BC4";
+		case BlockFormat::BC5: return "BC5";
+		default: return "BC7";
+	}
+}
+
+/// <summary>
+/// Reads a format name like "bc7" (any case)
+/// </summary>
+/// <returns>False if the name isn't a known format</returns>
+bool TextureCooker::ParseFormat(const std::string& name, BlockFormat& format)
+{
+	static const BlockFormat formats[] = { BlockFormat::BC1, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 };
+	for (BlockFormat candidate : formats)
+	{
+		const char* candidateName = GetFormatName(candidate);
+		if (name.size() == strlen(candidateName) && std::equal(name.begin(), name.end(), candidateName,
+			[](char a, char b) { return toupper((unsigned char)a) == b; }))
+		{
+			format = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+unsigned int TextureCooker::GetBlockBytes(BlockFormat format)
+{
+	return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+/// <summary>
+/// Channels the shader reads for a role, as a mask (1 = R, 2 = G, 4 = B, 8 = A)
+/// </summary>
+unsigned int TextureCooker::GetRoleChannels(TextureRole role)
+{
+	switch (role)
+	{
+		case TextureRole::Albedo: return 1 | 2 | 4;
+		case TextureRole::Normal: return 1 | 2;
+		case TextureRole::Packed: return 1 | 2 | 4;
+		default: return 1;
+	}
+}
+
+/// <summary>
+/// Size of a block compressed texture, optionally with its full mip chain
+/// </summary>
+size_t TextureCooker::GetChainBytes(unsigned int width, unsigned int height, BlockFormat format, bool generateMips)
+{
+	size_t bytes = 0;
+	while (true)
+	{
+		bytes += (size_t)((width + 3) / 4) * ((height + 3) / 4) * GetBlockBytes(format);
+		if (!generateMips || (width == 1 && height == 1))
+			return bytes;
+		width = (std::max)(1u, width / 2);
+		height = (std::max)(1u, height / 2);
+	}
+}
+
+/// <summary>
+/// Size of an uncompressed RGBA8 texture, optionally with its full mip chain
+/// </summary>
+size_t TextureCooker::GetRgba8ChainBytes(unsigned int width, unsigned int height, bool generateMips)
+{
+	size_t bytes = 0;
+	while (true)
+	{
+		bytes += (size_t)width * height * 4;
+		if (!generateMips || (width == 1 && height == 1))
+			return bytes;
+		width = (std::max)(1u, width / 2);
+		height = (std::max)(1u, height / 2);
+	}
+}
+
+/// <summary>
+/// Builds the full mip chain, down to 1x1, filtered the right way
+/// for the role. Level 0 is a copy of the image.
+/// </summary>
+/// <param name="queue">Splits the big levels across its threads, if given (see MipGenerator)</param>
+void TextureCooker::BuildMipChain(const CpuImage& image, TextureRole role, std::vector<CpuImage>& mips, MipFilter filter, JobQueue* queue)
+{
+	MipSettings settings;
+	settings.Content = GetMipContent(role);
+	settings.Filter = filter;
+	MipGenerator::Generate(image, settings, mips, queue);
+}
+
+/// <summary>
+/// How a role's texels are averaged: albedo as light (the shader
+/// treats it as gamma encoded), normals renormalized, the rest as stored
+/// </summary>
+MipContent TextureCooker::GetMipContent(TextureRole role)
+{
+	switch (role)
+	{
+		case TextureRole::Albedo: return MipContent::Srgb;
+		case TextureRole::Normal: return MipContent::Normal;
+		default: return MipContent::Linear;
+	}
+}
+
+/// <summary>
+/// Compresses one level. Rows of blocks are split across the worker threads.
+/// </summary>
+void TextureCooker::Encode(const CpuImage& image, BlockFormat format, std::vector<unsigned char>& blocks)
+{
+	unsigned int blocksWide = (image.Width + 3) / 4;
+	unsigned int blocksHigh = (image.Height + 3) / 4;
+	unsigned int blockBytes = GetBlockBytes(format);
+	blocks.resize((size_t)blocksWide * blocksHigh * blockBytes);
+
+	for (unsigned int firstRow = 0; firstRow < blocksHigh; firstRow += RowsPerJob)
+	{
+		unsigned int lastRow = (std::min)(firstRow + RowsPerJob, blocksHigh);
+		unsigned char* output = blocks.data();
+		queue.Push([&image, format, output, blocksWide, blockBytes, firstRow, lastRow]()
+		{
+			unsigned char rgba[64];
+			unsigned char red[16], green[16];
+			for (unsigned int by = firstRow; by < lastRow; by++)
+			{
+				for (unsigned int bx = 0; bx < blocksWide; bx++)
+				{
+					// Blocks hanging off the edge repeat the last row/column
+					for (unsigned int i = 0; i < 16; i++)
+					{
+						unsigned int x = (std::min)(bx * 4 + i % 4, image.Width - 1);
+						unsigned int y = (std::min)(by * 4 + i / 4, image.Height - 1);
+						memcpy(rgba + i * 4, &image.Pixels[((size_t)y * image.Width + x) * 4], 4);
+						red[i] = rgba[i * 4 + 0];
+						green[i] = rgba[i * 4 + 1];
+					}
+
+					unsigned char* block = output + ((size_t)by * blocksWide + bx) * blockBytes;
+					switch (format)
+					{
+						case BlockFormat::BC1: BlockCompression::EncodeBC1(rgba, block); break;
+						case BlockFormat::BC4: BlockCompression::EncodeBC4(red, block); break;
+						case BlockFormat::BC5: BlockCompression::EncodeBC5(red, green, block); break;
+						case BlockFormat::BC7: BlockCompression::EncodeBC7(rgba, block); break;
+					}
+				}
+			}
+		});
+	}
+
+	queue.WaitIdle();
+}
+
+/// <summary>
+/// Decompresses one level back to RGBA8, the way the GPU would
+/// (BC4 gives (r, 0, 0, 255), BC5 gives (r, g, 0, 255))
+/// </summary>
+void TextureCooker::Decode(const std::vector<unsigned char>& blocks, unsigned int width, unsigned int height, BlockFormat format, CpuImage& image)
+{
+	unsigned int blocksWide = (width + 3) / 4;
+	unsigned int blocksHigh = (height + 3) / 4;
+	unsigned int blockBytes = GetBlockBytes(format);
+
+	image.Width = width;
+	image.Height = height;
+	image.Pixels.assign((size_t)width * height * 4, 0);
+
+	unsigned char rgba[64];
+	unsigned char values[16];
+	for (unsigned int by = 0; by < blocksHigh; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksWide; bx++)
+		{
+			const unsigned char* block = &blocks[((size_t)by * blocksWide + bx) * blockBytes];
+			switch (format)
+			{
+				case BlockFormat::BC1: BlockCompression::DecodeBC1(block, rgba); break;
+				case BlockFormat::BC5: BlockCompression::DecodeBC5(block, rgba); break;
+				case BlockFormat::BC7: BlockCompression::DecodeBC7(block, rgba); break;
+				case BlockFormat::BC4:
+					BlockCompression::DecodeBC4(block, values);
+					for (int i = 0; i < 16; i++)
+					{
+						rgba[i * 4 + 0] = values[i];
+						rgba[i * 4 + 1] = 0;
+						rgba[i * 4 + 2] = 0;
+						rgba[i * 4 + 3] = 255;
+					}
+					break;
+			}
+
+			for (unsigned int i = 0; i < 16; i++)
+			{
+				unsigned int x = bx * 4 + i % 4;
+				unsigned int y = by * 4 + i / 4;
+				if (x < width && y < height)
+					memcpy(&image.Pixels[((size_t)y * width + x) * 4], rgba + i * 4, 4);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Peak signal to noise ratio between two images of the same size
+/// </summary>
+/// <param name="channelMask">Channels to compare (1 = R, 2 = G, 4 = B, 8 = A)</param>
+/// <returns>PSNR in dB, capped at 99 for identical images</returns>
+double TextureCooker::ComputePsnr(const CpuImage& reference, const CpuImage& test, unsigned int channelMask)
+{
+	if (reference.Width != test.Width || reference.Height != test.Height)
+		return 0.0;
+
+	double squaredError = 0.0;
+	size_t samples = 0;
+	for (size_t i = 0; i < reference.Pixels.size(); i += 4)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			if (!(channelMask & (1 << c)))
+				continue;
+			double difference = (double)reference.Pixels[i + c] - test.Pixels[i + c];
+			squaredError += difference * difference;
+			samples++;
+		}
+	}
+
+	if (samples == 0 || squaredError == 0.0)
+		return 99.0;
+	return (std::min)(99.0, 10.0 * log10(255.0 * 255.0 / (squaredError / samples)));
+}
+
+/// <summary>
+/// Writes a DDS file with the DX10 header extension, which is
+/// required for BC7 and understood by every DirectXTK loader
+/// </summary>
+/// <returns>False if the file can't be written</returns>
+bool TextureCooker::WriteDds(const std::string& path, const CookedTexture& texture)
+{
+	unsigned int dxgiFormat = DxgiFormatBC7;
+	switch (texture.Format)
+	{
+		case BlockFormat::BC1: dxgiFormat = DxgiFormatBC1; break;
+		case BlockFormat::BC4: dxgiFormat = DxgiFormatBC4; break;
+		case BlockFormat::BC5: dxgiFormat = DxgiFormatBC5; break;
+		case BlockFormat::BC7: dxgiFormat = DxgiFormatBC7; break;
+	}
+
+	std::vector<unsigned char> data;
+	AppendUInt(data, 0x20534444);	// "DDS "
+
+	// DDS_HEADER
+	AppendUInt(data, 124);
+	AppendUInt(data, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000);	// Caps, height, width, pixel format, mip count, linear size
+	AppendUInt(data, texture.Height);
+	AppendUInt(data, texture.Width);
+	AppendUInt(data, texture.Mips.empty() ? 0 : (unsigned int)texture.Mips[0].size());
+	AppendUInt(data, 0);			// Depth
+	AppendUInt(data, (unsigned int)texture.Mips.size());
+	for (int i = 0; i < 11; i++)
+		AppendUInt(data, 0);		// Reserved
+
+	// DDS_PIXELFORMAT, pointing at the DX10 header
+	AppendUInt(data, 32);
+	AppendUInt(data, 0x4);			// Four CC
+	AppendUInt(data, 0x30315844);	// "DX10"
+	for (int i = 0; i < 5; i++)
+		AppendUInt(data, 0);
+
+	AppendUInt(data, 0x1000 | 0x8 | 0x400000);	// Texture, complex, mipmap
+	for (int i = 0; i < 4; i++)
+		AppendUInt(data, 0);		// Caps 2-4, reserved
+
+	// DDS_HEADER_DXT10
+	AppendUInt(data, dxgiFormat);
+	AppendUInt(data, 3);			// Texture 2D
+	AppendUInt(data, 0);
+	AppendUInt(data, 1);			// Array size
+	AppendUInt(data, 0);
+
+	for (const std::vector<unsigned char>& mip : texture.Mips)
+		data.insert(data.end(), mip.begin(), mip.end());
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+	file.write((const char*)data.data(), data.size());
+	return file.good();
+}
+
+/// <summary>
+/// A printable table of cooked textures, with totals
+/// </summary>
+std::string TextureCooker::FormatReport(const std::vector<CookReport>& reports)
+{
+	char line[256];
+	std::string table;
+	snprintf(line, sizeof(line), "%-28s %-10s %-6s %11s %5s %11s %10s %6s %9s %10s %8s %8s\n",
+		"Texture", "Role", "Format", "Size", "Mips", "RGBA8 KB", "Cooked KB", "Ratio", "Mip ms", "Encode ms", "MPix/s", "PSNR dB");
+	table += line;
+
+	size_t totalUncompressed = 0, totalCooked = 0;
+	double totalMipMs = 0.0, totalEncodeMs = 0.0, totalPixels = 0.0;
+	for (const CookReport& report : reports)
+	{
+		char size[32];
+		snprintf(size, sizeof(size), "%ux%u", report.Width, report.Height);
+
+		// Every level is encoded, so count the whole chain
+		double pixels = report.UncompressedBytes / 4.0;
+		snprintf(line, sizeof(line), "%-28s %-10s %-6s %11s %5u %11.1f %10.1f %5.1fx %9.1f %10.1f %8.2f %8.2f\n",
+			report.Name.c_str(), GetRoleName(report.Role), GetFormatName(report.Format), size, report.MipCount,
+			report.UncompressedBytes / 1024.0, report.CookedBytes / 1024.0,
+			report.CookedBytes > 0 ? (double)report.UncompressedBytes / report.CookedBytes : 0.0,
+			report.MipMs, report.EncodeMs, report.EncodeMs > 0.0 ? pixels / (report.EncodeMs * 1000.0) : 0.0, report.Psnr);
+		table += line;
+
+		totalUncompressed += report.UncompressedBytes;
+		totalCooked += report.CookedBytes;
+		totalMipMs += report.MipMs;
+		totalEncodeMs += report.EncodeMs;
+		totalPixels += pixels;
+	}
+
+	snprintf(line, sizeof(line), "%-28s %-10s %-6s %11s %5s %11.1f %10.1f %5.1fx %9.1f %10.1f %8.2f\n",
+		"Total", "", "", "", "", totalUncompressed / 1024.0, totalCooked / 1024.0,
+		totalCooked > 0 ? (double)totalUncompressed / totalCooked : 0.0,
+		totalMipMs, totalEncodeMs, totalEncodeMs > 0.0 ? totalPixels / (totalEncodeMs * 1000.0) : 0.0);
+	table += line;
+	return table;
+}
+
+/// <summary>
+/// Writes the report as JSON so runs can be compared by scripts
+/// </summary>
+/// <returns>False if the file could not be opened</returns>
+bool TextureCooker::WriteReportJson(const std::string& path, const std::vector<CookReport>& reports, unsigned int threadCount)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	char line[512];
+	snprintf(line, sizeof(line), "{\n  \"threads\": %u,\n  \"textures\": [\n", threadCount);
+	file << line;
+	for (size_t i = 0; i < reports.size(); i++)
+	{
+		const CookReport& report = reports[i];
+		snprintf(line, sizeof(line),
+			"    { \"name\": \"%s\", \"role\": \"%s\", \"format\": \"%s\", \"width\": %u, \"height\": %u, \"mips\": %u, "
+			"\"rgba8_bytes\": %zu, \"cooked_bytes\": %zu, \"mip_ms\": %.3f, \"encode_ms\": %.3f, \"psnr_db\": %.3f }%s\n",
+			report.Name.c_str(), GetRoleName(report.Role), GetFormatName(report.Format), report.Width, report.Height, report.MipCount,
+			report.UncompressedBytes, report.CookedBytes, report.MipMs, report.EncodeMs, report.Psnr, i + 1 < reports.size() ? "," : "");
+		file << line;
+	}
+	file << "  ]\n}\n";
+
+	return true;
+}
+
+/// <summary>
+/// A printable table of what ORM packing saved for each material,
+/// in memory and in texture fetches per pixel
+/// </summary>
+std::string TextureCooker::FormatPackingReport(const std::vector<PackingReport>& reports)
+{
+	char line[256];
+	std::string table;
+	snprintf(line, sizeof(line), "%-14s %5s %15s %13s %9s %14s %12s %9s %8s %8s\n",
+		"Set", "Maps", "Separate RGBA8", "Packed RGBA8", "Saved", "Separate BC", "Packed BC", "Saved", "Fetches", "PSNR dB");
+	table += line;
+
+	// Albedo and normals are sampled either way
+	const unsigned int sharedFetches = 2;
+
+	size_t totals[4] = {};
+	unsigned int separateFetches = 0, packedFetches = 0;
+	for (const PackingReport& report : reports)
+	{
+		char fetches[32];
+		snprintf(fetches, sizeof(fetches), "%u -> %u", sharedFetches + report.SeparateMaps, sharedFetches + 1);
+		snprintf(line, sizeof(line), "%-14s %5u %12.1f KB %10.1f KB %8.1f%% %11.1f KB %9.1f KB %8.1f%% %8s %8.2f\n",
+			report.Set.c_str(), report.SeparateMaps,
+			report.SeparateRgba8Bytes / 1024.0, report.PackedRgba8Bytes / 1024.0,
+			report.SeparateRgba8Bytes > 0 ? 100.0 * (1.0 - (double)report.PackedRgba8Bytes / report.SeparateRgba8Bytes) : 0.0,
+			report.SeparateCookedBytes / 1024.0, report.PackedCookedBytes / 1024.0,
+			report.SeparateCookedBytes > 0 ? 100.0 * (1.0 - (double)report.PackedCookedBytes / report.SeparateCookedBytes) : 0.0,
+			fetches, report.Psnr);
+		table += line;
+
+		totals[0] += report.SeparateRgba8Bytes;
+		totals[1] += report.PackedRgba8Bytes;
+		totals[2] += report.SeparateCookedBytes;
+		totals[3] += report.PackedCookedBytes;
+		separateFetches += sharedFetches + report.SeparateMaps;
+		packedFetches += sharedFetches + 1;
+	}
+
+	char fetches[32];
+	snprintf(fetches, sizeof(fetches), "%u -> %u", separateFetches, packedFetches);
+	snprintf(line, sizeof(line), "%-14s %5s %12.1f KB %10.1f KB %8.1f%% %11.1f KB %9.1f KB %8.1f%% %8s\n",
+		"Total", "", totals[0] / 1024.0, totals[1] / 1024.0,
+		totals[0] > 0 ? 100.0 * (1.0 - (double)totals[1] / totals[0]) : 0.0,
+		totals[2] / 1024.0, totals[3] / 1024.0,
+		totals[2] > 0 ? 100.0 * (1.0 - (double)totals[3] / totals[2]) : 0.0,
+		fetches);
+	table += line;
+	return table;
+}
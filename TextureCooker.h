@@ -0,0 +1,119 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "JobQueue.h"
+#include "MipGenerator.h"
+#include "PngReader.h"
+
+// What a texture is used for, which decides how it's filtered and compressed
+enum class TextureRole
+{
+	Albedo,
+	Normal,
+	Roughness,
+	Metalness,
+	Occlusion,
+	Packed		// ORM: occlusion, roughness and metalness in R, G and B
+};
+
+enum class BlockFormat
+{
+	BC1,	// RGB, 4 bits per pixel
+	BC4,	// R, 4 bits per pixel
+	BC5,	// RG, 8 bits per pixel
+	BC7		// RGBA, 8 bits per pixel
+};
+
+// A compressed texture, ready to be written out
+struct CookedTexture
+{
+	BlockFormat Format = BlockFormat::BC7;
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	std::vector<std::vector<unsigned char>> Mips;	// Blocks for each level, largest first
+};
+
+// Measurements for one cooked texture
+struct CookReport
+{
+	std::string Name;
+	TextureRole Role = TextureRole::Albedo;
+	BlockFormat Format = BlockFormat::BC7;
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	unsigned int MipCount = 0;
+	size_t UncompressedBytes = 0;	// As RGBA8, whole mip chain
+	size_t CookedBytes = 0;
+	double MipMs = 0.0;
+	double EncodeMs = 0.0;
+	double Psnr = 0.0;				// Top mip, over the channels the role uses
+};
+
+// What packing one material's single-channel maps into an ORM texture saved
+struct PackingReport
+{
+	std::string Set;
+	unsigned int SeparateMaps = 0;	// Roughness, metalness and AO maps replaced
+	size_t SeparateRgba8Bytes = 0;	// Whole mip chains, as the runtime loads PNGs
+	size_t PackedRgba8Bytes = 0;
+	size_t SeparateCookedBytes = 0;	// Whole mip chains, block compressed
+	size_t PackedCookedBytes = 0;
+	double Psnr = 0.0;				// Of the cooked ORM texture
+};
+
+// --------------------------------------------------------
+// Offline texture cooker: builds a mip chain with
+// MipGenerator (box or Kaiser, filtered the right way for
+// the texture's role) and block compresses every level
+// across a pool of threads. The results are
+// DDS files that DirectXTK's CreateDDSTextureFromFile loads.
+//
+//  Albedo    - BC7 (or BC1), mips filtered in linear space
+//  Normal    - BC5, mips renormalized; Z is rebuilt in the shader
+//  Roughness - BC4
+//  Metalness - BC4
+//  Occlusion - BC4
+//  Packed    - BC7, see ChannelPacker for the layout
+// --------------------------------------------------------
+class TextureCooker
+{
+	public:
+		TextureCooker(unsigned int _threadCount = 0);
+
+		void Cook(const CpuImage& image, TextureRole role, BlockFormat format, bool generateMips, CookedTexture& texture, CookReport& report);
+		bool CookFile(const std::string& sourcePath, const std::string& outputPath, TextureRole role, BlockFormat format, bool generateMips, CookReport& report, std::string* error = 0);
+
+		// Getters
+		unsigned int GetThreadCount();
+
+		// Setters
+		void SetMipFilter(MipFilter _mipFilter);
+
+		// Helpers
+		static TextureRole GuessRole(const std::string& path);
+		static BlockFormat GetDefaultFormat(TextureRole role);
+		static const char* GetRoleName(TextureRole role);
+		static const char* GetFormatName(BlockFormat format);
+		static bool ParseFormat(const std::string& name, BlockFormat& format);
+		static unsigned int GetBlockBytes(BlockFormat format);
+		static unsigned int GetRoleChannels(TextureRole role);
+		static size_t GetChainBytes(unsigned int width, unsigned int height, BlockFormat format, bool generateMips);
+		static size_t GetRgba8ChainBytes(unsigned int width, unsigned int height, bool generateMips);
+
+		static void BuildMipChain(const CpuImage& image, TextureRole role, std::vector<CpuImage>& mips, MipFilter filter = MipFilter::Box, JobQueue* queue = 0);
+		static MipContent GetMipContent(TextureRole role);
+		static void Decode(const std::vector<unsigned char>& blocks, unsigned int width, unsigned int height, BlockFormat format, CpuImage& image);
+		static double ComputePsnr(const CpuImage& reference, const CpuImage& test, unsigned int channelMask);
+		static bool WriteDds(const std::string& path, const CookedTexture& texture);
+
+		static std::string FormatReport(const std::vector<CookReport>& reports);
+		static bool WriteReportJson(const std::string& path, const std::vector<CookReport>& reports, unsigned int threadCount);
+		static std::string FormatPackingReport(const std::vector<PackingReport>& reports);
+
+	private:
+		void Encode(const CpuImage& image, BlockFormat format, std::vector<unsigned char>& blocks);
+
+		MipFilter mipFilter;
+		JobQueue queue;
+};
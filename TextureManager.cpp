@@ -0,0 +1,485 @@
+#include "TextureManager.h"
+#include "ChannelPacker.h"
+#include "TextureCooker.h"
+#include "TextureStreamer.h"
+#include "packages/directxtk_desktop_win10.2022.3.24.2/include/WICTextureLoader.h"
+
+#include <wincodec.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdio.h>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Worker threads don't start out with COM, which WIC needs
+struct ComScope
+{
+	HRESULT Result;
+	ComScope() { Result = CoInitializeEx(0, COINIT_MULTITHREADED); }
+	~ComScope() { if (SUCCEEDED(Result)) CoUninitialize(); }
+};
+
+/// <summary>
+/// Constructor
+/// </summary>
+/// <param name="_threadCount">Number of decode threads, 0 for one per hardware thread</param>
+TextureManager::TextureManager(
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	unsigned int _threadCount)
+	:
+	device(_device),
+	context(_context),
+	outstanding(0),
+	queue(_threadCount > 0 ? _threadCount : (std::max)(1u, std::thread::hardware_concurrency()))
+{
+	placeholders[(int)TexturePlaceholder::White] = CreateSolidTexture(255, 255, 255, 255);
+	placeholders[(int)TexturePlaceholder::Gray] = CreateSolidTexture(128, 128, 128, 255);
+	placeholders[(int)TexturePlaceholder::Black] = CreateSolidTexture(0, 0, 0, 255);
+	placeholders[(int)TexturePlaceholder::FlatNormal] = CreateSolidTexture(128, 128, 255, 255);
+	placeholders[(int)TexturePlaceholder::Orm] = CreateSolidTexture(255, 128, 0, 255);
+}
+
+/// <summary>
+/// Starts loading an image file, or finds the texture for one already requested
+/// </summary>
+/// <param name="path">Full path to the image</param>
+/// <param name="placeholder">What the texture shows until it's loaded</param>
+/// <returns>A texture that's usable right away, and fills in later</returns>
+std::shared_ptr<Texture> TextureManager::Load(const std::wstring& path, TexturePlaceholder placeholder)
+{
+	stats.Requested++;
+
+	// "a/../b.png" and "b.png" are the same file
+	std::wstring key = std::filesystem::path(path).lexically_normal().wstring();
+	std::unordered_map<std::wstring, std::shared_ptr<Texture>>::iterator existing = textures.find(key);
+	if (existing != textures.end())
+	{
+		stats.Deduplicated++;
+		return existing->second;
+	}
+
+	return Request(key, placeholder, [key](CpuImage& image) { return Decode(key, image); });
+}
+
+/// <summary>
+/// Starts building a texture whose channels come from other images,
+/// ex: roughness and metalness maps packed into one. Sources of
+/// different sizes are resampled to the largest.
+/// </summary>
+/// <param name="channels">Where each of R, G, B and A come from</param>
+/// <param name="placeholder">What the texture shows until it's loaded</param>
+/// <returns>A texture that's usable right away, and fills in later</returns>
+std::shared_ptr<Texture> TextureManager::LoadPacked(const TextureChannel channels[4], TexturePlaceholder placeholder)
+{
+	stats.Requested++;
+
+	// The same sources in the same layout are the same texture
+	std::wstring key = L"packed";
+	std::vector<TextureChannel> layout(channels, channels + 4);
+	for (TextureChannel& channel : layout)
+	{
+		if (!channel.Path.empty())
+			channel.Path = std::filesystem::path(channel.Path).lexically_normal().wstring();
+		key += L"|" + channel.Path + L":" + std::to_wstring(channel.SourceChannel) + L":" + std::to_wstring(channel.Constant);
+	}
+
+	std::unordered_map<std::wstring, std::shared_ptr<Texture>>::iterator existing = textures.find(key);
+	if (existing != textures.end())
+	{
+		stats.Deduplicated++;
+		return existing->second;
+	}
+
+	return Request(key, placeholder, [layout](CpuImage& packed)
+	{
+		// Each file is only decoded once, even if it feeds several channels
+		std::vector<std::wstring> paths;
+		std::vector<CpuImage> images;
+		ChannelSource sources[4];
+		for (int c = 0; c < 4; c++)
+		{
+			sources[c].Channel = layout[c].SourceChannel;
+			sources[c].Constant = layout[c].Constant;
+			if (layout[c].Path.empty())
+				continue;
+
+			std::vector<std::wstring>::iterator found = std::find(paths.begin(), paths.end(), layout[c].Path);
+			if (found == paths.end())
+			{
+				paths.push_back(layout[c].Path);
+				images.push_back(CpuImage());
+				if (!Decode(layout[c].Path, images.back()))
+					printf("Unable to load texture '%ls', using a constant instead\n", layout[c].Path.c_str());
+			}
+		}
+
+		// Pointers are taken once the vector is done growing
+		for (int c = 0; c < 4; c++)
+		{
+			if (layout[c].Path.empty())
+				continue;
+			size_t index = std::find(paths.begin(), paths.end(), layout[c].Path) - paths.begin();
+			if (!images[index].Pixels.empty())
+				sources[c].Image = &images[index];
+		}
+
+		ChannelPacker::Pack(sources, packed);
+		return true;
+	});
+}
+
+/// <summary>
+/// Creates the texture for a new key and queues its decode
+/// </summary>
+/// <param name="decode">Runs on a worker thread, filling in the pixels</param>
+std::shared_ptr<Texture> TextureManager::Request(const std::wstring& key, TexturePlaceholder placeholder, std::function<bool(CpuImage&)> decode)
+{
+	std::shared_ptr<Texture> texture = std::make_shared<Texture>(key, GetPlaceholder(placeholder));
+	textures[key] = texture;
+	outstanding++;
+
+	// Mips are filtered on the worker like the cooker does (albedo in
+	// linear space, normals renormalized), rather than by GenerateMips
+	TextureRole role = key.compare(0, 7, L"packed|") == 0 ? TextureRole::Packed : TextureCooker::GuessRole(std::filesystem::path(key).filename().string());
+
+	queue.Push([this, texture, decode, role]()
+	{
+		DecodedImage image;
+		image.Target = texture;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		image.Success = decode(image.Image);
+		if (image.Success)
+			TextureCooker::BuildMipChain(image.Image, role, image.Mips);
+		image.DecodeMs = MillisecondsSince(start);
+
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		decoded.push_back(std::move(image));
+	});
+
+	return texture;
+}
+
+/// <summary>
+/// Uploads images the workers have finished decoding. Must be
+/// called on the thread that owns the immediate context.
+/// </summary>
+/// <param name="maxUploads">Most textures to upload this call, 0 for no limit.
+/// Keeps a big batch from landing on a single frame.</param>
+void TextureManager::Update(unsigned int maxUploads)
+{
+	std::vector<DecodedImage> ready;
+	{
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		if (decoded.empty())
+			return;
+
+		size_t count = maxUploads > 0 ? (std::min)((size_t)maxUploads, decoded.size()) : decoded.size();
+		ready.assign(std::make_move_iterator(decoded.begin()), std::make_move_iterator(decoded.begin() + count));
+		decoded.erase(decoded.begin(), decoded.begin() + count);
+	}
+
+	for (DecodedImage& image : ready)
+	{
+		stats.DecodeMs += image.DecodeMs;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool uploaded = image.Success && Upload(image);
+		stats.UploadMs += MillisecondsSince(start);
+
+		if (uploaded)
+		{
+			image.Target->state = TextureState::Ready;
+			stats.Loaded++;
+		}
+		else
+		{
+			// Keeps showing the placeholder
+			image.Target->state = TextureState::Failed;
+			stats.Failed++;
+			printf("Unable to load texture '%ls'\n", image.Target->path.c_str());
+		}
+
+		outstanding--;
+	}
+}
+
+/// <summary>
+/// Blocks until every requested texture is loaded (or has failed)
+/// </summary>
+void TextureManager::WaitForAll()
+{
+	queue.WaitIdle();
+	Update();
+}
+
+// Getters
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureManager::GetPlaceholder(TexturePlaceholder placeholder) { return placeholders[(int)placeholder]; }
+size_t TextureManager::GetPendingCount() { return outstanding; }
+unsigned int TextureManager::GetThreadCount() { return queue.GetThreadCount(); }
+TextureLoadStats TextureManager::GetStats() { return stats; }
+
+// Setters
+void TextureManager::SetStreamer(std::shared_ptr<TextureStreamer> _streamer) { streamer = _streamer; }
+
+/// <summary>
+/// Reads an image file into RGBA8 pixels. Runs on a worker
+/// thread, so it must not touch the device or context.
+/// </summary>
+/// <returns>False if the file is missing or can't be decoded</returns>
+bool TextureManager::Decode(const std::wstring& path, CpuImage& image)
+{
+	ComScope com;
+	if (FAILED(com.Result) && com.Result != RPC_E_CHANGED_MODE)
+		return false;
+
+	Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))))
+		return false;
+
+	Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+	if (FAILED(factory->CreateDecoderFromFilename(path.c_str(), 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())))
+		return false;
+
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+	if (FAILED(decoder->GetFrame(0, frame.GetAddressOf())))
+		return false;
+
+	// Everything becomes RGBA8 - grayscale and RGB files included
+	Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+	if (FAILED(factory->CreateFormatConverter(converter.GetAddressOf())) ||
+		FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, 0, 0.0, WICBitmapPaletteTypeCustom)))
+		return false;
+
+	UINT width, height;
+	if (FAILED(converter->GetSize(&width, &height)) || width == 0 || height == 0)
+		return false;
+
+	image.Width = width;
+	image.Height = height;
+	image.Pixels.resize((size_t)width * height * 4);
+	return SUCCEEDED(converter->CopyPixels(0, width * 4, (UINT)image.Pixels.size(), image.Pixels.data()));
+}
+
+/// <summary>
+/// Creates the GPU texture (with the worker's mip chain) for a decoded
+/// image and swaps it into the image's Texture
+/// </summary>
+/// <returns>False if any D3D call fails</returns>
+bool TextureManager::Upload(DecodedImage& image)
+{
+	// The streamer only uploads the small mips, and brings in the rest as they're needed
+	if (image.Mips.empty())
+		return false;
+	if (streamer)
+		return streamer->Add(image.Target, image.Mips);
+
+	// Every level is known up front, so the texture never changes
+	std::vector<D3D11_SUBRESOURCE_DATA> levels(image.Mips.size());
+	for (size_t i = 0; i < image.Mips.size(); i++)
+	{
+		levels[i].pSysMem = image.Mips[i].Pixels.data();
+		levels[i].SysMemPitch = image.Mips[i].Width * 4;
+	}
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = image.Mips[0].Width;
+	desc.Height = image.Mips[0].Height;
+	desc.MipLevels = (UINT)image.Mips.size();
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(device->CreateTexture2D(&desc, levels.data(), texture.GetAddressOf())))
+		return false;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf())))
+		return false;
+
+	image.Target->srv = srv;
+	return true;
+}
+
+/// <summary>
+/// Makes a 1x1 texture of a single color
+/// </summary>
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureManager::CreateSolidTexture(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+	unsigned char pixel[4] = { r, g, b, a };
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = pixel;
+	data.SysMemPitch = 4;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (SUCCEEDED(device->CreateTexture2D(&desc, &data, texture.GetAddressOf())))
+		device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf());
+	return srv;
+}
+
+/// <summary>
+/// Times how long a set of files takes to load from scratch, first with
+/// DirectXTK's loader one file at a time (what the game used to do), then
+/// with a fresh TextureManager for each thread count. Each configuration
+/// runs several times and the fastest run is reported, which keeps the
+/// disk cache from favoring whichever configuration runs second.
+/// </summary>
+/// <param name="paths">Full paths to the images</param>
+/// <param name="threadCounts">Decode thread counts to try</param>
+/// <param name="repeats">Runs per configuration</param>
+/// <param name="jsonPath">Where to write the results, or empty to skip the file</param>
+/// <returns>A printable table of the results</returns>
+std::string TextureManager::RunLoadBenchmark(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	const std::vector<std::wstring>& paths,
+	const std::vector<unsigned int>& threadCounts,
+	unsigned int repeats,
+	const std::string& jsonPath)
+{
+	struct Result
+	{
+		std::string Name;
+		unsigned int Threads;
+		double BestMs;
+		double DecodeMs;	// From the best run
+		double UploadMs;	// From the best run
+		unsigned int Loaded;
+	};
+	std::vector<Result> results;
+	repeats = (std::max)(1u, repeats);
+
+	// Sequential baseline, everything on this thread
+	{
+		Result result = { "DirectXTK (sequential)", 1, 1e30, 0.0, 0.0, 0 };
+		for (unsigned int r = 0; r < repeats; r++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			unsigned int loaded = 0;
+			for (const std::wstring& path : paths)
+			{
+				Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+				if (SUCCEEDED(DirectX::CreateWICTextureFromFile(device.Get(), context.Get(), path.c_str(), nullptr, srv.GetAddressOf())))
+					loaded++;
+			}
+			context->Flush();
+
+			double ms = MillisecondsSince(start);
+			if (ms < result.BestMs)
+			{
+				result.BestMs = ms;
+				result.Loaded = loaded;
+			}
+		}
+		results.push_back(result);
+	}
+
+	for (unsigned int threads : threadCounts)
+	{
+		Result result = { "TextureManager", threads, 1e30, 0.0, 0.0, 0 };
+		for (unsigned int r = 0; r < repeats; r++)
+		{
+			// Thread startup is part of the cost being measured
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			TextureManager manager(device, context, threads);
+			for (const std::wstring& path : paths)
+				manager.Load(path);
+			manager.WaitForAll();
+			context->Flush();
+
+			double ms = MillisecondsSince(start);
+			if (ms < result.BestMs)
+			{
+				TextureLoadStats stats = manager.GetStats();
+				result.BestMs = ms;
+				result.DecodeMs = stats.DecodeMs;
+				result.UploadMs = stats.UploadMs;
+				result.Loaded = stats.Loaded;
+			}
+		}
+		results.push_back(result);
+	}
+
+	// Table for the console
+	char line[256];
+	std::string table;
+	snprintf(line, sizeof(line), "Texture load benchmark: %zu files, best of %u runs\n", paths.size(), repeats);
+	table += line;
+	snprintf(line, sizeof(line), "%-24s %8s %10s %10s %12s %12s %8s\n", "Loader", "Threads", "Loaded", "Wall ms", "Decode ms", "Upload ms", "Speedup");
+	table += line;
+	for (const Result& result : results)
+	{
+		snprintf(line, sizeof(line), "%-24s %8u %10u %10.2f %12.2f %12.2f %7.2fx\n",
+			result.Name.c_str(), result.Threads, result.Loaded, result.BestMs,
+			result.DecodeMs, result.UploadMs, results[0].BestMs / result.BestMs);
+		table += line;
+	}
+
+	if (!jsonPath.empty())
+	{
+		std::ofstream file(jsonPath);
+		if (file.is_open())
+		{
+			snprintf(line, sizeof(line), "{\n  \"files\": %zu,\n  \"repeats\": %u,\n  \"results\": [\n", paths.size(), repeats);
+			file << line;
+			for (size_t i = 0; i < results.size(); i++)
+			{
+				const Result& result = results[i];
+				snprintf(line, sizeof(line), "    { \"loader\": \"%s\", \"threads\": %u, \"loaded\": %u, \"wall_ms\": %.3f, \"decode_ms\": %.3f, \"upload_ms\": %.3f }%s\n",
+					result.Name.c_str(), result.Threads, result.Loaded, result.BestMs,
+					result.DecodeMs, result.UploadMs, i + 1 < results.size() ? "," : "");
+				file << line;
+			}
+			file << "  ]\n}\n";
+		}
+		else
+		{
+			table += "Unable to write texture benchmark report to '" + jsonPath + "'\n";
+		}
+	}
+
+	return table;
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+/// <param name="_path">The image file</param>
+/// <param name="_placeholder">Shown until the image is uploaded</param>
+Texture::Texture(std::wstring _path, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> _placeholder)
+	: path(_path), srv(_placeholder), state(TextureState::Loading)
+{
+}
+
+// Getters
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Texture::GetSRV() { return srv; }
+TextureState Texture::GetState() { return state; }
+const std::wstring& Texture::GetPath() { return path; }
+bool Texture::IsReady() { return state == TextureState::Ready; }
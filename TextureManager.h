@@ -0,0 +1,150 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "JobQueue.h"
+#include "PngReader.h"
+
+class TextureStreamer;
+
+enum class TextureState
+{
+	Loading,
+	Ready,
+	Failed
+};
+
+// What a texture shows until (or instead of, if loading fails) its image
+enum class TexturePlaceholder
+{
+	White,
+	Gray,
+	Black,
+	FlatNormal,		// (0.5, 0.5, 1), a normal map with no bumps
+	Orm				// (1, 0.5, 0): unoccluded, half rough, not metal
+};
+
+// Where one channel of a packed texture comes from
+struct TextureChannel
+{
+	std::wstring Path;				// Empty for a constant
+	int SourceChannel = 0;			// 0-3 = RGBA of the source image
+	unsigned char Constant = 255;	// Used if there's no path or it fails to load
+};
+
+// --------------------------------------------------------
+// A texture that may still be loading. GetSRV() always
+// returns something bindable: the placeholder until the
+// image has been uploaded, then the real texture.
+// --------------------------------------------------------
+class Texture
+{
+	public:
+		Texture(std::wstring _path, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> _placeholder);
+
+		// Getters
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSRV();
+		TextureState GetState();
+		const std::wstring& GetPath();
+		bool IsReady();
+
+	private:
+		friend class TextureManager;
+		friend class TextureStreamer;
+
+		std::wstring path;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+		TextureState state;
+};
+
+// Totals for every load a manager has done
+struct TextureLoadStats
+{
+	unsigned int Requested = 0;		// Calls to Load()
+	unsigned int Deduplicated = 0;	// Calls answered by an existing texture
+	unsigned int Loaded = 0;
+	unsigned int Failed = 0;
+	double DecodeMs = 0.0;			// Summed over all worker threads
+	double UploadMs = 0.0;			// Main thread only
+};
+
+// --------------------------------------------------------
+// Loads image files as textures. Files are decoded with WIC
+// on worker threads, then uploaded (with generated mips) on
+// the main thread in Update(). Loading the same path twice
+// returns the same texture.
+//
+// With a streamer attached, the workers also build each
+// texture's mip chain, and the streamer uploads only its
+// small mips (see TextureStreamer).
+// --------------------------------------------------------
+class TextureManager
+{
+	public:
+		TextureManager(
+			Microsoft::WRL::ComPtr<ID3D11Device> _device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+			unsigned int _threadCount = 0);
+
+		std::shared_ptr<Texture> Load(const std::wstring& path, TexturePlaceholder placeholder = TexturePlaceholder::Gray);
+		std::shared_ptr<Texture> LoadPacked(const TextureChannel channels[4], TexturePlaceholder placeholder = TexturePlaceholder::Gray);
+
+		// Uploads decoded images. Pass 0 to upload everything that's ready.
+		void Update(unsigned int maxUploads = 0);
+		void WaitForAll();
+
+		// Getters
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetPlaceholder(TexturePlaceholder placeholder);
+		size_t GetPendingCount();
+		unsigned int GetThreadCount();
+		TextureLoadStats GetStats();
+
+		// Setters
+		void SetStreamer(std::shared_ptr<TextureStreamer> _streamer);
+
+		// Times loading a set of files with different numbers of threads
+		static std::string RunLoadBenchmark(
+			Microsoft::WRL::ComPtr<ID3D11Device> device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+			const std::vector<std::wstring>& paths,
+			const std::vector<unsigned int>& threadCounts,
+			unsigned int repeats,
+			const std::string& jsonPath);
+
+	private:
+		// CPU-side pixels waiting for upload
+		struct DecodedImage
+		{
+			std::shared_ptr<Texture> Target;
+			CpuImage Image;
+			std::vector<CpuImage> Mips;		// The whole chain, built by the worker
+			bool Success = false;
+			double DecodeMs = 0.0;
+		};
+
+		std::shared_ptr<Texture> Request(const std::wstring& key, TexturePlaceholder placeholder, std::function<bool(CpuImage&)> decode);
+		static bool Decode(const std::wstring& path, CpuImage& image);
+		bool Upload(DecodedImage& image);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateSolidTexture(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholders[5];
+
+		std::unordered_map<std::wstring, std::shared_ptr<Texture>> textures;
+		std::shared_ptr<TextureStreamer> streamer;	// Null if every mip is uploaded at once
+		unsigned int outstanding;	// Requested but not uploaded yet
+		TextureLoadStats stats;
+
+		std::mutex decodedMutex;
+		std::vector<DecodedImage> decoded;
+
+		// Declared last so the workers finish before anything they use is destroyed
+		JobQueue queue;
+};
@@ -0,0 +1,315 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+/// <summary>
+/// Creates an empty residency policy
+/// </summary>
+/// <param name="_budgetBytes">Memory all textures' streamed mips must fit in</param>
+/// <param name="_baseSize">Mips this size and smaller are loaded up front and never evicted</param>
+/// <param name="_maxLoadsPerUpdate">Limits how many uploads a single Update() asks for</param>
+/// <param name="_graceFrames">How long an unseen texture keeps its claim on its mips</param>
+TextureResidency::TextureResidency(size_t _budgetBytes, unsigned int _baseSize, unsigned int _maxLoadsPerUpdate, unsigned int _graceFrames)
+	:
+	budgetBytes(_budgetBytes),
+	residentBytes(0),
+	pendingBytes(0),
+	baseSize((std::max)(1u, _baseSize)),
+	maxLoadsPerUpdate((std::max)(1u, _maxLoadsPerUpdate)),
+	graceFrames(_graceFrames),
+	frame(0)
+{
+}
+
+/// <summary>
+/// Starts tracking a texture. Its base mips count against the
+/// budget right away, even if that goes over it.
+/// </summary>
+/// <returns>The texture's index, for the other functions</returns>
+unsigned int TextureResidency::Add(unsigned int width, unsigned int height, unsigned int bytesPerPixel)
+{
+	Entry entry = {};
+	entry.Width = (std::max)(1u, width);
+	entry.Height = (std::max)(1u, height);
+	entry.BytesPerPixel = bytesPerPixel;
+	entry.MipCount = CountMips(entry.Width, entry.Height);
+	entry.BaseMip = 0;
+	while (entry.BaseMip + 1 < entry.MipCount && (std::max)(entry.Width >> entry.BaseMip, entry.Height >> entry.BaseMip) > baseSize)
+		entry.BaseMip++;
+	entry.ResidentMip = entry.BaseMip;
+	entry.DesiredMip = entry.BaseMip;
+	entry.LastSeenFrame = frame;
+	entry.FrameMip = FLT_MAX;
+
+	for (unsigned int mip = entry.BaseMip; mip < entry.MipCount; mip++)
+		residentBytes += GetMipBytes(entry.Width, entry.Height, mip, entry.BytesPerPixel);
+
+	entries.push_back(entry);
+	return (unsigned int)entries.size() - 1;
+}
+
+/// <summary>
+/// Starts a new frame of feedback
+/// </summary>
+void TextureResidency::BeginFrame()
+{
+	frame++;
+	for (Entry& entry : entries)
+	{
+		entry.FrameMip = FLT_MAX;
+		entry.FrameWeight = 0.0f;
+	}
+}
+
+/// <summary>
+/// Reports one use of a texture this frame. Several uses combine:
+/// the finest mip wins, and their weights add up.
+/// </summary>
+/// <param name="mip">The level (fractional) this use samples from</param>
+/// <param name="weight">How much it matters, ex: pixels covered</param>
+void TextureResidency::Request(unsigned int texture, float mip, float weight)
+{
+	Entry& entry = entries[texture];
+	entry.FrameMip = (std::min)(entry.FrameMip, (std::max)(0.0f, mip));
+	entry.FrameWeight += (std::max)(0.0f, weight);
+}
+
+/// <summary>
+/// Applies this frame's feedback and decides what to stream. Loads are
+/// reserved against the budget right away; call CompleteLoad() when
+/// each one finishes. Evictions have already happened when this returns.
+/// </summary>
+/// <param name="loads">Filled with the levels to upload, most needed first</param>
+/// <param name="evictions">Filled with textures to shrink, and the level they keep</param>
+void TextureResidency::Update(std::vector<ResidencyChange>& loads, std::vector<ResidencyChange>& evictions)
+{
+	loads.clear();
+	evictions.clear();
+
+	for (Entry& entry : entries)
+	{
+		entry.Evicted = false;
+		if (entry.FrameWeight > 0.0f)
+		{
+			entry.DesiredMip = (std::min)(entry.BaseMip, (unsigned int)floorf((std::min)(entry.FrameMip, (float)entry.BaseMip)));
+			entry.Weight = entry.FrameWeight;
+			entry.LastSeenFrame = frame;
+		}
+		else if (frame - entry.LastSeenFrame > graceFrames)
+		{
+			entry.DesiredMip = entry.BaseMip;
+		}
+	}
+
+	// The budget may have shrunk
+	while (residentBytes > budgetBytes && EvictLeastUseful(FLT_MAX, (unsigned int)entries.size(), evictions))
+	{
+	}
+
+	// Textures missing the most of what they want, on the most screen, go first
+	std::vector<unsigned int> candidates;
+	for (unsigned int i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].DesiredMip < entries[i].ResidentMip && !entries[i].Loading && !entries[i].Evicted)
+			candidates.push_back(i);
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](unsigned int a, unsigned int b)
+	{
+		float priorityA = entries[a].Weight * (entries[a].ResidentMip - entries[a].DesiredMip);
+		float priorityB = entries[b].Weight * (entries[b].ResidentMip - entries[b].DesiredMip);
+		return priorityA != priorityB ? priorityA > priorityB : a < b;
+	});
+
+	for (unsigned int texture : candidates)
+	{
+		if (loads.size() >= maxLoadsPerUpdate)
+			break;
+
+		// Don't load back what was just evicted to make room for something else
+		Entry& entry = entries[texture];
+		if (entry.Evicted)
+			continue;
+		size_t cost = GetMipBytes(entry.Width, entry.Height, entry.ResidentMip - 1, entry.BytesPerPixel);
+
+		// Only mips that matter less than this one make room for it
+		bool fits = true;
+		while (residentBytes + cost > budgetBytes)
+		{
+			if (!EvictLeastUseful(entry.Weight, texture, evictions))
+			{
+				fits = false;
+				break;
+			}
+		}
+
+		if (!fits)
+		{
+			counters.LoadsDenied++;
+			continue;
+		}
+
+		entry.Loading = true;
+		residentBytes += cost;
+		pendingBytes += cost;
+		loads.push_back({ texture, entry.ResidentMip - 1 });
+		counters.LoadsIssued++;
+	}
+}
+
+/// <summary>
+/// Finishes a load started by Update()
+/// </summary>
+/// <param name="success">False releases the reservation without changing residency</param>
+void TextureResidency::CompleteLoad(unsigned int texture, bool success)
+{
+	Entry& entry = entries[texture];
+	if (!entry.Loading)
+		return;
+
+	size_t cost = GetMipBytes(entry.Width, entry.Height, entry.ResidentMip - 1, entry.BytesPerPixel);
+	entry.Loading = false;
+	pendingBytes -= cost;
+
+	if (success)
+	{
+		entry.ResidentMip--;
+	}
+	else
+	{
+		residentBytes -= cost;
+		counters.LoadsFailed++;
+	}
+}
+
+// Getters
+size_t TextureResidency::GetBudget() { return budgetBytes; }
+size_t TextureResidency::GetResidentBytes() { return residentBytes; }
+unsigned int TextureResidency::GetTextureCount() { return (unsigned int)entries.size(); }
+unsigned int TextureResidency::GetMipCount(unsigned int texture) { return entries[texture].MipCount; }
+unsigned int TextureResidency::GetBaseMip(unsigned int texture) { return entries[texture].BaseMip; }
+unsigned int TextureResidency::GetResidentMip(unsigned int texture) { return entries[texture].ResidentMip; }
+unsigned int TextureResidency::GetDesiredMip(unsigned int texture) { return entries[texture].DesiredMip; }
+bool TextureResidency::IsLoading(unsigned int texture) { return entries[texture].Loading; }
+
+/// <summary>
+/// Budget use right now, plus the counters since creation
+/// </summary>
+ResidencyStats TextureResidency::GetStats()
+{
+	ResidencyStats stats = counters;
+	stats.BudgetBytes = budgetBytes;
+	stats.ResidentBytes = residentBytes;
+	stats.PendingBytes = pendingBytes;
+	stats.Textures = (unsigned int)entries.size();
+	for (const Entry& entry : entries)
+	{
+		for (unsigned int mip = entry.DesiredMip; mip < entry.MipCount; mip++)
+			stats.WantedBytes += GetMipBytes(entry.Width, entry.Height, mip, entry.BytesPerPixel);
+		if (entry.ResidentMip <= entry.DesiredMip)
+			stats.SatisfiedTextures++;
+	}
+	return stats;
+}
+
+// Setters
+void TextureResidency::SetBudget(size_t _budgetBytes) { budgetBytes = _budgetBytes; }
+
+/// <summary>
+/// Levels in a full mip chain, down to 1x1
+/// </summary>
+unsigned int TextureResidency::CountMips(unsigned int width, unsigned int height)
+{
+	unsigned int count = 1;
+	while (width > 1 || height > 1)
+	{
+		width = (std::max)(1u, width / 2);
+		height = (std::max)(1u, height / 2);
+		count++;
+	}
+	return count;
+}
+
+size_t TextureResidency::GetMipBytes(unsigned int width, unsigned int height, unsigned int mip, unsigned int bytesPerPixel)
+{
+	return (size_t)(std::max)(1u, width >> mip) * (std::max)(1u, height >> mip) * bytesPerPixel;
+}
+
+/// <summary>
+/// The mip level a surface samples from, from how many texels of
+/// the texture land on each pixel of its screen footprint
+/// </summary>
+/// <param name="textureSize">Width (or height) of the texture's top level</param>
+/// <param name="uvDensity">UV units per world unit across the mesh's surface</param>
+/// <param name="uvScale">The material's UV multiplier</param>
+/// <param name="distance">From the camera to the closest point of the surface</param>
+/// <param name="fieldOfView">Vertical, in radians</param>
+/// <param name="viewportHeight">In pixels</param>
+/// <returns>The (fractional) mip level, 0 or more</returns>
+float TextureResidency::ComputeDesiredMip(unsigned int textureSize, float uvDensity, float uvScale, float distance, float fieldOfView, float viewportHeight)
+{
+	float pixelsPerUnit = viewportHeight / (2.0f * (std::max)(distance, 0.001f) * tanf(fieldOfView * 0.5f));
+	float texelsPerUnit = textureSize * uvDensity * fabsf(uvScale);
+	float texelsPerPixel = texelsPerUnit / (std::max)(pixelsPerUnit, 0.0001f);
+	return texelsPerPixel > 1.0f ? log2f(texelsPerPixel) : 0.0f;
+}
+
+/// <summary>
+/// Roughly how many pixels a bounding sphere covers
+/// </summary>
+float TextureResidency::ComputeScreenArea(float radius, float distance, float fieldOfView, float viewportHeight)
+{
+	float pixelRadius = radius * viewportHeight / (2.0f * (std::max)(distance, 0.001f) * tanf(fieldOfView * 0.5f));
+	pixelRadius = (std::min)(pixelRadius, viewportHeight);
+	return 3.14159265f * pixelRadius * pixelRadius;
+}
+
+/// <summary>
+/// How much a texture's finest resident level is worth keeping. Levels
+/// finer than the texture wants are worth less than any that are needed,
+/// and the longer ago it was seen, the less it's worth.
+/// </summary>
+float TextureResidency::GetUsefulness(const Entry& entry)
+{
+	float age = (float)(frame - entry.LastSeenFrame);
+	if (entry.ResidentMip < entry.DesiredMip)
+		return -1.0f - age;
+	return entry.Weight / (1.0f + age);
+}
+
+/// <summary>
+/// Drops the finest level of whichever texture needs it least
+/// </summary>
+/// <param name="usefulnessBelow">Only levels worth less than this are evicted</param>
+/// <param name="exclude">A texture to leave alone (the one making room)</param>
+/// <returns>False if nothing could be evicted</returns>
+bool TextureResidency::EvictLeastUseful(float usefulnessBelow, unsigned int exclude, std::vector<ResidencyChange>& evictions)
+{
+	unsigned int victim = (unsigned int)entries.size();
+	float lowest = usefulnessBelow;
+	for (unsigned int i = 0; i < entries.size(); i++)
+	{
+		const Entry& entry = entries[i];
+		if (i == exclude || entry.Loading || entry.ResidentMip >= entry.BaseMip)
+			continue;
+
+		float usefulness = GetUsefulness(entry);
+		if (usefulness < lowest)
+		{
+			lowest = usefulness;
+			victim = i;
+		}
+	}
+
+	if (victim == entries.size())
+		return false;
+
+	Entry& entry = entries[victim];
+	residentBytes -= GetMipBytes(entry.Width, entry.Height, entry.ResidentMip, entry.BytesPerPixel);
+	entry.ResidentMip++;
+	entry.Evicted = true;
+	evictions.push_back({ victim, entry.ResidentMip });
+	counters.Evictions++;
+	return true;
+}
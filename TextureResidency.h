@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// A mip level for the streamer to upload, or the level a texture drops to
+struct ResidencyChange
+{
+	unsigned int Texture;
+	unsigned int Mip;		// The texture's finest resident level once applied
+};
+
+// Budget accounting and streaming activity so far
+struct ResidencyStats
+{
+	size_t BudgetBytes = 0;
+	size_t ResidentBytes = 0;		// Includes loads in flight
+	size_t PendingBytes = 0;		// Reserved for loads in flight
+	size_t WantedBytes = 0;			// If every texture had the mips it wants
+	unsigned int Textures = 0;
+	unsigned int SatisfiedTextures = 0;	// Have (at least) the mips they want
+	unsigned int LoadsIssued = 0;
+	unsigned int LoadsFailed = 0;
+	unsigned int Evictions = 0;
+	unsigned int LoadsDenied = 0;	// Wanted, but nothing less useful could be evicted
+};
+
+// --------------------------------------------------------
+// Decides which mips of which textures are resident in a
+// fixed memory budget. Textures start with just their small
+// mips (the "base", always resident); each frame, feedback
+// says how fine a mip every visible texture needs and how
+// much of the screen it covers. Update() then asks for the
+// next finer level of the textures that need them most, and
+// when the budget is full, evicts the finest levels of the
+// ones that need them least.
+//
+// Levels are loaded and evicted one at a time, finest last
+// in and first out, so a texture's resident mips are always
+// one contiguous chain down to 1x1.
+// --------------------------------------------------------
+class TextureResidency
+{
+	public:
+		TextureResidency(size_t _budgetBytes, unsigned int _baseSize = 64, unsigned int _maxLoadsPerUpdate = 4, unsigned int _graceFrames = 30);
+
+		unsigned int Add(unsigned int width, unsigned int height, unsigned int bytesPerPixel = 4);
+
+		// Feedback, once per frame
+		void BeginFrame();
+		void Request(unsigned int texture, float mip, float weight);
+
+		void Update(std::vector<ResidencyChange>& loads, std::vector<ResidencyChange>& evictions);
+		void CompleteLoad(unsigned int texture, bool success);
+
+		// Getters
+		size_t GetBudget();
+		size_t GetResidentBytes();
+		unsigned int GetTextureCount();
+		unsigned int GetMipCount(unsigned int texture);
+		unsigned int GetBaseMip(unsigned int texture);
+		unsigned int GetResidentMip(unsigned int texture);
+		unsigned int GetDesiredMip(unsigned int texture);
+		bool IsLoading(unsigned int texture);
+		ResidencyStats GetStats();
+
+		// Setters
+		void SetBudget(size_t _budgetBytes);
+
+		// Helpers
+		static unsigned int CountMips(unsigned int width, unsigned int height);
+		static size_t GetMipBytes(unsigned int width, unsigned int height, unsigned int mip, unsigned int bytesPerPixel);
+		static float ComputeDesiredMip(unsigned int textureSize, float uvDensity, float uvScale, float distance, float fieldOfView, float viewportHeight);
+		static float ComputeScreenArea(float radius, float distance, float fieldOfView, float viewportHeight);
+
+	private:
+		struct Entry
+		{
+			unsigned int Width;
+			unsigned int Height;
+			unsigned int BytesPerPixel;
+			unsigned int MipCount;
+			unsigned int BaseMip;		// Coarser levels are always resident
+			unsigned int ResidentMip;	// Finest resident level
+			bool Loading;				// ResidentMip - 1 is on its way
+			bool Evicted;				// Lost a level in this Update()
+			unsigned int DesiredMip;
+			float Weight;				// Screen area the texture covered when last seen
+			unsigned int LastSeenFrame;
+			float FrameMip;				// This frame's requests, combined
+			float FrameWeight;
+		};
+
+		float GetUsefulness(const Entry& entry);
+		bool EvictLeastUseful(float usefulnessBelow, unsigned int exclude, std::vector<ResidencyChange>& evictions);
+
+		std::vector<Entry> entries;
+		size_t budgetBytes;
+		size_t residentBytes;
+		size_t pendingBytes;
+		unsigned int baseSize;
+		unsigned int maxLoadsPerUpdate;
+		unsigned int graceFrames;
+		unsigned int frame;
+		ResidencyStats counters;
+};
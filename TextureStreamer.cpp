@@ -0,0 +1,158 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+
+/// <summary>
+/// Constructor
+/// </summary>
+/// <param name="_budgetBytes">Video memory every streamed texture must fit in (base mips included)</param>
+/// <param name="_maxUploadsPerFrame">Most new levels uploaded by one Update()</param>
+TextureStreamer::TextureStreamer(
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	size_t _budgetBytes,
+	unsigned int _maxUploadsPerFrame)
+	:
+	device(_device),
+	context(_context),
+	residency(_budgetBytes, 64, _maxUploadsPerFrame),
+	fieldOfView(0.785398f),
+	viewportHeight(720.0f)
+{
+}
+
+/// <summary>
+/// Starts streaming a texture. Only its base mips are uploaded,
+/// and they replace whatever the texture was showing.
+/// </summary>
+/// <param name="mips">The full chain, largest first. Moved from.</param>
+/// <returns>False if the GPU texture can't be created</returns>
+bool TextureStreamer::Add(std::shared_ptr<Texture> texture, std::vector<CpuImage>& mips)
+{
+	if (mips.empty())
+		return false;
+
+	unsigned int index = residency.Add(mips[0].Width, mips[0].Height);
+
+	// Stays in the list even if it fails, to keep the indices lined up
+	textures.push_back(StreamedTexture());
+	StreamedTexture& streamed = textures.back();
+	streamed.Target = texture;
+	streamed.Mips = std::move(mips);
+	streamed.ResidentMip = (unsigned int)streamed.Mips.size();
+
+	if (!SetResidentMip(streamed, residency.GetBaseMip(index)))
+		return false;
+
+	indices[texture.get()] = index;
+	return true;
+}
+
+/// <summary>
+/// Starts a new frame of feedback
+/// </summary>
+/// <param name="_fieldOfView">The camera's vertical field of view, in radians</param>
+/// <param name="_viewportHeight">In pixels</param>
+void TextureStreamer::BeginFrame(float _fieldOfView, float _viewportHeight)
+{
+	fieldOfView = _fieldOfView;
+	viewportHeight = _viewportHeight;
+	residency.BeginFrame();
+}
+
+/// <summary>
+/// Reports one surface drawn with a texture this frame.
+/// Textures that aren't streamed are ignored.
+/// </summary>
+/// <param name="uvDensity">UV units per world unit on the surface (UV scale included)</param>
+/// <param name="distance">From the camera to the closest point of the surface</param>
+/// <param name="screenArea">Pixels the surface covers, roughly</param>
+void TextureStreamer::Request(Texture* texture, float uvDensity, float distance, float screenArea)
+{
+	std::unordered_map<Texture*, unsigned int>::iterator found = indices.find(texture);
+	if (found == indices.end())
+		return;
+
+	const CpuImage& top = textures[found->second].Mips[0];
+	float mip = TextureResidency::ComputeDesiredMip((std::max)(top.Width, top.Height), uvDensity, 1.0f, distance, fieldOfView, viewportHeight);
+	residency.Request(found->second, mip, screenArea);
+}
+
+/// <summary>
+/// Applies this frame's feedback: evicts the levels the policy gives
+/// up, then uploads the ones it asks for. The data is already in
+/// system memory, so every load finishes before this returns.
+/// </summary>
+void TextureStreamer::Update()
+{
+	residency.Update(loads, evictions);
+
+	// A texture can lose several levels at once; only its final size is made
+	for (const ResidencyChange& eviction : evictions)
+	{
+		StreamedTexture& streamed = textures[eviction.Texture];
+		unsigned int mip = residency.GetResidentMip(eviction.Texture);
+		if (streamed.Resource && streamed.ResidentMip != mip)
+			SetResidentMip(streamed, mip);
+	}
+
+	for (const ResidencyChange& load : loads)
+	{
+		StreamedTexture& streamed = textures[load.Texture];
+		residency.CompleteLoad(load.Texture, streamed.Resource && SetResidentMip(streamed, load.Mip));
+	}
+}
+
+// Getters
+bool TextureStreamer::IsStreamed(Texture* texture) { return indices.find(texture) != indices.end(); }
+ResidencyStats TextureStreamer::GetStats() { return residency.GetStats(); }
+
+// Setters
+void TextureStreamer::SetBudget(size_t _budgetBytes) { residency.SetBudget(_budgetBytes); }
+
+/// <summary>
+/// Recreates a texture's GPU resource with its levels from mip
+/// down. Levels it already had are copied on the GPU; the rest
+/// come from system memory. The new view is swapped into the
+/// Texture, so materials pick it up on their next draw.
+/// </summary>
+/// <returns>False (keeping the old resource) if any D3D call fails</returns>
+bool TextureStreamer::SetResidentMip(StreamedTexture& texture, unsigned int mip)
+{
+	const CpuImage& top = texture.Mips[mip];
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = top.Width;
+	desc.Height = top.Height;
+	desc.MipLevels = (UINT)texture.Mips.size() - mip;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> resource;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(device->CreateTexture2D(&desc, 0, resource.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(resource.Get(), 0, srv.GetAddressOf())))
+		return false;
+
+	for (unsigned int level = mip; level < texture.Mips.size(); level++)
+	{
+		UINT subresource = level - mip;
+		if (texture.Resource && level >= texture.ResidentMip)
+		{
+			context->CopySubresourceRegion(resource.Get(), subresource, 0, 0, 0, texture.Resource.Get(), level - texture.ResidentMip, 0);
+		}
+		else
+		{
+			const CpuImage& image = texture.Mips[level];
+			context->UpdateSubresource(resource.Get(), subresource, 0, image.Pixels.data(), image.Width * 4, 0);
+		}
+	}
+
+	texture.Resource = resource;
+	texture.ResidentMip = mip;
+	texture.Target->srv = srv;
+	return true;
+}
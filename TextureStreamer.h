@@ -0,0 +1,72 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "PngReader.h"
+#include "TextureManager.h"
+#include "TextureResidency.h"
+
+// --------------------------------------------------------
+// Streams the mips of loaded textures in and out of video
+// memory under a budget, as decided by TextureResidency.
+// Textures start out with only their small base mips on the
+// GPU; the full chain stays in system memory, and each
+// change of resident levels recreates the GPU texture with
+// one level more (or fewer), copying the levels it keeps
+// on the GPU and uploading the new one.
+//
+// Each frame: BeginFrame(), Request() every texture drawn,
+// then Update() on the thread that owns the context.
+// --------------------------------------------------------
+class TextureStreamer
+{
+	public:
+		TextureStreamer(
+			Microsoft::WRL::ComPtr<ID3D11Device> _device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+			size_t _budgetBytes,
+			unsigned int _maxUploadsPerFrame = 4);
+
+		bool Add(std::shared_ptr<Texture> texture, std::vector<CpuImage>& mips);
+
+		// Feedback, once per frame
+		void BeginFrame(float fieldOfView, float viewportHeight);
+		void Request(Texture* texture, float uvDensity, float distance, float screenArea);
+
+		void Update();
+
+		// Getters
+		bool IsStreamed(Texture* texture);
+		ResidencyStats GetStats();
+
+		// Setters
+		void SetBudget(size_t _budgetBytes);
+
+	private:
+		// A texture's mips in system memory, and what's on the GPU
+		struct StreamedTexture
+		{
+			std::shared_ptr<Texture> Target;
+			std::vector<CpuImage> Mips;
+			Microsoft::WRL::ComPtr<ID3D11Texture2D> Resource;
+			unsigned int ResidentMip;	// Level 0 of Resource
+		};
+
+		bool SetResidentMip(StreamedTexture& texture, unsigned int mip);
+
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+		TextureResidency residency;
+		std::vector<StreamedTexture> textures;				// Indexed like residency's
+		std::unordered_map<Texture*, unsigned int> indices;
+		float fieldOfView;
+		float viewportHeight;
+
+		// Reused every frame
+		std::vector<ResidencyChange> loads;
+		std::vector<ResidencyChange> evictions;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+// --------------------------------------------------------
+// Skies for the lighting validation tools under Tools/:
+// cube maps filled from a function of direction, and the
+// directions the results are compared in.
+// --------------------------------------------------------
+
+#include "IblPrecompute.h"
+
+#include <math.h>
+
+// Fills a cube from a function of direction
+template<typename Radiance>
+inline CubeImage MakeCube(unsigned int size, Radiance radiance)
+{
+	CubeImage cube;
+	cube.Size = size;
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		cube.Faces[face].resize((size_t)size * size * 3);
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				float d[3];
+				IblPrecompute::GetDirection(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f, d);
+				float length = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+				for (int i = 0; i < 3; i++)
+					d[i] /= length;
+				radiance(d, &cube.Faces[face][((size_t)y * size + x) * 3]);
+			}
+		}
+	}
+	return cube;
+}
+
+// Axes, a diagonal and two in-between directions, unit length
+inline const float TestNormals[][3] = {
+	{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+	{ 0.577350f, 0.577350f, 0.577350f }, { -0.707107f, 0.707107f, 0 }, { 0, -0.447214f, 0.894427f } };
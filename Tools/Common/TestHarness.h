@@ -0,0 +1,33 @@
+#pragma once
+
+// --------------------------------------------------------
+// What every validation tool under Tools/ shares: checks
+// that print a value and ok/FAILED on one line, a timer,
+// and the summary that sets the exit code. Each tool is one
+// translation unit, so everything here is inline.
+// --------------------------------------------------------
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+
+inline int failures = 0;
+
+inline void Check(bool condition, const char* what, double value)
+{
+	printf("  %-58s %10.5f  %s\n", what, value, condition ? "ok" : "FAILED");
+	if (!condition)
+		failures++;
+}
+
+inline double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Prints how the checks went; returns main()'s exit code
+inline int FinishChecks()
+{
+	printf("\n%s\n", failures == 0 ? "All checks passed" : (std::to_string(failures) + " checks FAILED").c_str());
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+// --------------------------------------------------------
+// Meshes for the validation tools under Tools/: OBJ files
+// read the way Mesh reads them, and a generated torus.
+// --------------------------------------------------------
+
+#include "MeshSimplifier.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Triangles the way Mesh's OBJ loader builds them: three vertices
+// each, UV v and position z flipped, winding reversed
+inline bool LoadObj(const std::string& path, std::vector<SourceVertex>& vertices, std::vector<unsigned int>& indices)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (!file)
+		return false;
+
+	std::vector<float> positions, normals, uvs;
+	char line[256];
+	while (fgets(line, sizeof(line), file))
+	{
+		float x, y, z;
+		if (sscanf(line, "vn %f %f %f", &x, &y, &z) == 3)
+			normals.insert(normals.end(), { x, y, -z });
+		else if (sscanf(line, "vt %f %f", &x, &y) == 2)
+			uvs.insert(uvs.end(), { x, 1.0f - y });
+		else if (sscanf(line, "v %f %f %f", &x, &y, &z) == 3)
+			positions.insert(positions.end(), { x, y, -z });
+		else if (line[0] == 'f')
+		{
+			unsigned int i[12];
+			int read = sscanf(line, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u",
+				&i[0], &i[1], &i[2], &i[3], &i[4], &i[5], &i[6], &i[7], &i[8], &i[9], &i[10], &i[11]);
+			if (read < 9)
+				continue;
+
+			SourceVertex corners[4] = {};
+			for (int c = 0; c < read / 3; c++)
+			{
+				memcpy(corners[c].Position, &positions[(i[c * 3] - 1) * 3], sizeof(float) * 3);
+				memcpy(corners[c].UV, &uvs[(i[c * 3 + 1] - 1) * 2], sizeof(float) * 2);
+				memcpy(corners[c].Normal, &normals[(i[c * 3 + 2] - 1) * 3], sizeof(float) * 3);
+			}
+			const int order[2][3] = { { 0, 2, 1 }, { 0, 3, 2 } };
+			for (int t = 0; t < (read == 12 ? 2 : 1); t++)
+				for (int c = 0; c < 3; c++)
+				{
+					indices.push_back((unsigned int)vertices.size());
+					vertices.push_back(corners[order[t][c]]);
+				}
+		}
+	}
+	fclose(file);
+	return !indices.empty();
+}
+
+// A torus, wound clockwise seen from outside like the loaded models.
+// Seamed, the UVs wrap at both angles and the seam's vertices are
+// duplicated with UVs 0 and 1; otherwise the grid closes on itself.
+inline void MakeTorus(unsigned int segments, bool seamed, std::vector<SourceVertex>& vertices, std::vector<unsigned int>& indices)
+{
+	unsigned int rings = segments / 2;
+	unsigned int columns = seamed ? segments + 1 : segments, rows = seamed ? rings + 1 : rings;
+	const float major = 1.0f, minor = 0.35f;
+	vertices.clear();
+	indices.clear();
+	for (unsigned int s = 0; s < columns; s++)
+		for (unsigned int r = 0; r < rows; r++)
+		{
+			float u = (float)s / segments, v = (float)r / rings;
+			float a = u * 6.2831853f, b = v * 6.2831853f;
+			SourceVertex vertex = {};
+			vertex.Normal[0] = cosf(b) * cosf(a);
+			vertex.Normal[1] = sinf(b);
+			vertex.Normal[2] = cosf(b) * sinf(a);
+			vertex.Position[0] = cosf(a) * major + vertex.Normal[0] * minor;
+			vertex.Position[1] = vertex.Normal[1] * minor;
+			vertex.Position[2] = sinf(a) * major + vertex.Normal[2] * minor;
+			if (seamed)
+			{
+				vertex.UV[0] = u;
+				vertex.UV[1] = v;
+			}
+			vertices.push_back(vertex);
+		}
+
+	if (seamed)
+	{
+		// Both wraps land on exactly the first row's and column's positions
+		for (unsigned int r = 0; r <= rings; r++)
+			memcpy(vertices[segments * (rings + 1) + r].Position, vertices[r].Position, sizeof(float) * 3);
+		for (unsigned int s = 0; s <= segments; s++)
+			memcpy(vertices[s * (rings + 1) + rings].Position, vertices[s * (rings + 1)].Position, sizeof(float) * 3);
+	}
+
+	for (unsigned int s = 0; s < segments; s++)
+		for (unsigned int r = 0; r < rings; r++)
+		{
+			unsigned int a = s * rows + r, b = ((s + 1) % columns) * rows + r;
+			unsigned int a1 = s * rows + (r + 1) % rows, b1 = ((s + 1) % columns) * rows + (r + 1) % rows;
+			indices.insert(indices.end(), { a, b, a1, b, b1, a1 });
+		}
+}
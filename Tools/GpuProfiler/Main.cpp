@@ -0,0 +1,223 @@
+// --------------------------------------------------------
+// Validation for GpuProfiler's latency ring, driven through
+// HeadlessGpuTimestampBackend so every timestamp (and so
+// every expected duration) is known exactly.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -I../.. -o GpuProfiler Main.cpp ../../Profiler.cpp
+//
+// Usage:
+//
+//  GpuProfiler [-frames <n>]
+//
+// Exits with 1 if any check fails:
+//  - A frame's results are read exactly as many frames
+//    later as the backend's latency, and none are dropped
+//    while that fits in the ring
+//  - Frames whose slot is still in flight when the ring
+//    wraps are counted as dropped, and results keep coming
+//  - Disjoint frames are discarded, not averaged in
+//  - Nested scopes and scopes repeated within a frame sum
+//    to the ticks spent in them
+//  - Scopes past the query budget are ignored without
+//    losing the ones around them, flat or nested
+// --------------------------------------------------------
+
+#include "Profiler.h"
+#include "../Common/TestHarness.h"
+
+#include <math.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Ticks per millisecond at the backend's default frequency
+static const unsigned long long TicksPerMs = 1000;
+
+static unsigned long long SampleCount(const GpuProfiler& profiler, const char* name)
+{
+	const ProfileScopeStats* stats = profiler.GetStats().GetStats(name);
+	return stats ? stats->SampleCount : 0;
+}
+
+static double LastMs(const GpuProfiler& profiler, const char* name)
+{
+	const ProfileScopeStats* stats = profiler.GetStats().GetStats(name);
+	return stats ? stats->LastMs : -1.0;
+}
+
+// One frame of a millisecond, with nothing in it but the frame
+static void RunFrame(GpuProfiler& profiler, HeadlessGpuTimestampBackend& backend)
+{
+	profiler.BeginFrame();
+	backend.AdvanceClock(TicksPerMs);
+	profiler.EndFrame();
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int frames = 100;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-frames") == 0)
+			frames = (unsigned int)atoi(argv[i + 1]);
+	}
+	if (frames < 2 * GpuProfiler::FrameLatency)
+		frames = 2 * GpuProfiler::FrameLatency;
+
+	printf("GpuProfiler: %u frames, a ring of %u slots, %u timestamps per frame\n\n", frames, GpuProfiler::FrameLatency, GpuProfiler::MaxTimestampsPerFrame);
+
+	printf("Latency\n");
+	for (unsigned int latency = 0; latency < GpuProfiler::FrameLatency; latency++)
+	{
+		std::shared_ptr<HeadlessGpuTimestampBackend> backend = std::make_shared<HeadlessGpuTimestampBackend>(latency);
+		GpuProfiler profiler(backend);
+
+		// After frame n ends, frames up to n - latency have been read
+		bool onTime = true;
+		for (unsigned int n = 0; n < frames; n++)
+		{
+			RunFrame(profiler, *backend);
+			unsigned long long expected = n + 1 >= latency ? n + 1 - latency : 0;
+			onTime = onTime && SampleCount(profiler, "Frame") == expected;
+		}
+
+		char what[64];
+		snprintf(what, sizeof(what), "Backend latency %u: read that many frames later", latency);
+		Check(onTime && profiler.GetDroppedFrameCount() == 0, what, (double)SampleCount(profiler, "Frame") / frames);
+		Check(LastMs(profiler, "Frame") == 1.0, "  Frame (ms)", LastMs(profiler, "Frame"));
+	}
+
+	printf("\nRing wrap\n");
+	for (unsigned int latency = GpuProfiler::FrameLatency; latency <= 2 * GpuProfiler::FrameLatency; latency += GpuProfiler::FrameLatency / 2)
+	{
+		std::shared_ptr<HeadlessGpuTimestampBackend> backend = std::make_shared<HeadlessGpuTimestampBackend>(latency);
+		GpuProfiler profiler(backend);
+
+		unsigned long long readHalfway = 0;
+		for (unsigned int n = 0; n < frames; n++)
+		{
+			RunFrame(profiler, *backend);
+			if (n == frames / 2)
+				readHalfway = SampleCount(profiler, "Frame");
+		}
+
+		// Every frame is read, dropped, or one of the last few still in flight
+		unsigned long long read = SampleCount(profiler, "Frame");
+		unsigned long long dropped = profiler.GetDroppedFrameCount();
+		char what[64];
+		snprintf(what, sizeof(what), "Backend latency %u: dropped / frames", latency);
+		Check(dropped > 0 && read + dropped <= frames && read + dropped + GpuProfiler::FrameLatency >= frames, what, (double)dropped / frames);
+		Check(read > readHalfway, "  Still reading frames after it wraps", (double)(read - readHalfway));
+		Check(LastMs(profiler, "Frame") == 1.0, "  Frame (ms)", LastMs(profiler, "Frame"));
+	}
+
+	printf("\nDisjoint frames\n");
+	{
+		const unsigned int latency = 2;
+		std::shared_ptr<HeadlessGpuTimestampBackend> backend = std::make_shared<HeadlessGpuTimestampBackend>(latency);
+		GpuProfiler profiler(backend);
+
+		// A clock change in one frame makes its timestamps garbage
+		const unsigned int disjointFrame = frames / 3;
+		for (unsigned int n = 0; n < frames; n++)
+		{
+			if (n != disjointFrame)
+			{
+				RunFrame(profiler, *backend);
+				continue;
+			}
+
+			profiler.BeginFrame();
+			backend->SetDisjoint(true);
+			backend->AdvanceClock(1000 * 1000 * TicksPerMs);
+			profiler.EndFrame();
+		}
+
+		const ProfileScopeStats* stats = profiler.GetStats().GetStats("Frame");
+		Check(profiler.GetDroppedFrameCount() == 1, "Dropped frames", (double)profiler.GetDroppedFrameCount());
+		Check(stats && stats->SampleCount == frames - latency - 1, "Frames read / frames out of flight", stats ? (double)stats->SampleCount / (frames - latency) : 0.0);
+		Check(stats && stats->MaxMs == 1.0, "Slowest frame read (ms)", stats ? stats->MaxMs : -1.0);
+	}
+
+	printf("\nNested and repeated scopes\n");
+	{
+		std::shared_ptr<HeadlessGpuTimestampBackend> backend = std::make_shared<HeadlessGpuTimestampBackend>(1);
+		GpuProfiler profiler(backend);
+
+		for (unsigned int n = 0; n < frames; n++)
+		{
+			profiler.BeginFrame();
+			{
+				ProfileScope<GpuProfiler> outer(profiler, "Outer");
+				backend->AdvanceClock(100);
+				for (unsigned long long work : { 200, 300 })
+				{
+					ProfileScope<GpuProfiler> inner(profiler, "Inner");
+					backend->AdvanceClock(work);
+				}
+				backend->AdvanceClock(50);
+			}
+			for (int i = 0; i < 3; i++)
+			{
+				ProfileScope<GpuProfiler> pass(profiler, "Pass");
+				backend->AdvanceClock(10);
+			}
+			backend->AdvanceClock(25);
+			profiler.EndFrame();
+		}
+
+		const double epsilon = 1e-9;
+		Check(fabs(LastMs(profiler, "Inner") - 0.5) < epsilon, "Inner, twice in Outer (ms)", LastMs(profiler, "Inner"));
+		Check(fabs(LastMs(profiler, "Outer") - 0.65) < epsilon, "Outer, around both (ms)", LastMs(profiler, "Outer"));
+		Check(fabs(LastMs(profiler, "Pass") - 0.03) < epsilon, "Pass, three times a frame (ms)", LastMs(profiler, "Pass"));
+		Check(fabs(LastMs(profiler, "Frame") - 0.705) < epsilon, "Frame, around everything (ms)", LastMs(profiler, "Frame"));
+		Check(SampleCount(profiler, "Inner") == SampleCount(profiler, "Frame") && SampleCount(profiler, "Pass") == frames - 1,
+			"One sample per frame for repeated scopes", (double)SampleCount(profiler, "Inner") / SampleCount(profiler, "Frame"));
+	}
+
+	printf("\nQuery budget\n");
+	{
+		std::shared_ptr<HeadlessGpuTimestampBackend> backend = std::make_shared<HeadlessGpuTimestampBackend>(0);
+		GpuProfiler profiler(backend);
+
+		// More scopes one after another than there are timestamps for
+		profiler.BeginFrame();
+		for (unsigned int i = 0; i < GpuProfiler::MaxTimestampsPerFrame; i++)
+		{
+			ProfileScope<GpuProfiler> scope(profiler, "Flat");
+			backend->AdvanceClock(10);
+		}
+		profiler.EndFrame();
+
+		// The Frame scope takes two timestamps, every other scope two more
+		double recorded = (GpuProfiler::MaxTimestampsPerFrame / 2 - 1) * 10.0 / TicksPerMs;
+		Check(fabs(LastMs(profiler, "Flat") - recorded) < 1e-9, "Flat scopes that fit (ms)", LastMs(profiler, "Flat"));
+		Check(LastMs(profiler, "Frame") == GpuProfiler::MaxTimestampsPerFrame * 10.0 / TicksPerMs, "  Frame still around all of them (ms)", LastMs(profiler, "Frame"));
+
+		// And nested deeper than there are timestamps for, which
+		// still owe their ends when the budget runs out
+		profiler.BeginFrame();
+		std::vector<std::unique_ptr<ProfileScope<GpuProfiler>>> nested;
+		for (unsigned int i = 0; i < GpuProfiler::MaxTimestampsPerFrame; i++)
+		{
+			nested.push_back(std::make_unique<ProfileScope<GpuProfiler>>(profiler, "Nested"));
+			backend->AdvanceClock(10);
+		}
+		while (!nested.empty())
+			nested.pop_back();
+		profiler.EndFrame();
+
+		// Each recorded scope runs from its begin to the innermost's end
+		double nestedMs = 0.0;
+		for (unsigned int depth = 0; depth < GpuProfiler::MaxTimestampsPerFrame / 2 - 1; depth++)
+			nestedMs += (GpuProfiler::MaxTimestampsPerFrame - depth) * 10.0 / TicksPerMs;
+		Check(fabs(LastMs(profiler, "Nested") - nestedMs) < 1e-9, "Nested scopes that fit (ms)", LastMs(profiler, "Nested"));
+		Check(LastMs(profiler, "Frame") == GpuProfiler::MaxTimestampsPerFrame * 10.0 / TicksPerMs, "  Frame still around all of them (ms)", LastMs(profiler, "Frame"));
+	}
+
+	return FinishChecks();
+}
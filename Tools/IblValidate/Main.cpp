@@ -0,0 +1,193 @@
+// --------------------------------------------------------
+// Validation and timing for IblPrecompute's integrators, on
+// synthetic environments whose answers are known: each
+// check compares a fast path against a brute force or an
+// analytic result.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -pthread -I../.. -o IblValidate Main.cpp ../../IblPrecompute.cpp
+//      ../../CpuUtilities.cpp ../../JobQueue.cpp ../../PngReader.cpp
+//
+// Usage:
+//
+//  IblValidate [-lutsize <n>] [-samples <n>] [-threads <n>]
+//
+// Exits with 1 if any check fails:
+//  - A constant environment gives the same irradiance (SH and
+//    brute force) and the same prefiltered color everywhere
+//  - SH irradiance of a smooth sky is within 3% of brute force
+//  - Prefiltering keeps the environment's average radiance
+//  - The AVX2 and scalar BRDF tables agree, stay within [0, 1],
+//    and add up to one as roughness goes to zero
+//  - A cached table loads back exactly, and a stale one is refused
+// --------------------------------------------------------
+
+#include "IblPrecompute.h"
+#include "CpuUtilities.h"
+#include "../Common/TestHarness.h"
+#include "../Common/TestCubes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// Solid angle weighted mean of one channel
+static double AverageRadiance(const CubeImage& cube, int channel)
+{
+	double sum = 0.0, weight = 0.0;
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < cube.Size; y++)
+		{
+			for (unsigned int x = 0; x < cube.Size; x++)
+			{
+				float u = 2.0f * (x + 0.5f) / cube.Size - 1.0f, v = 2.0f * (y + 0.5f) / cube.Size - 1.0f;
+				float d = 1.0f + u * u + v * v;
+				double w = 1.0 / (d * sqrt(d));
+				sum += cube.Faces[face][((size_t)y * cube.Size + x) * 3 + channel] * w;
+				weight += w;
+			}
+		}
+	}
+	return sum / weight;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int lutSize = 128;
+	unsigned int samples = 1024;
+	unsigned int threads = (std::max)(1u, std::thread::hardware_concurrency());
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-lutsize" && i + 1 < argc) lutSize = (unsigned int)atoi(argv[++i]);
+		else if (arg == "-samples" && i + 1 < argc) samples = (unsigned int)atoi(argv[++i]);
+		else if (arg == "-threads" && i + 1 < argc) threads = (std::max)(1, atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: IblValidate [-lutsize n] [-samples n] [-threads n]\n");
+			return 1;
+		}
+	}
+	JobQueue queue(threads);
+
+	// --- Constant environment ---
+	printf("Constant environment\n");
+	const float constant[3] = { 0.25f, 0.5f, 1.0f };
+	CubeImage flat = MakeCube(32, [&](const float*, float* rgb) { for (int i = 0; i < 3; i++) rgb[i] = constant[i]; });
+	ShCoefficients flatSh = IblPrecompute::ConvolveLambert(IblPrecompute::ProjectRadiance(flat));
+	double shError = 0.0, bruteError = 0.0;
+	for (const float* n : TestNormals)
+	{
+		float sh[3], brute[3];
+		IblPrecompute::Evaluate(flatSh, n, sh);
+		IblPrecompute::BruteForceIrradiance(flat, n, brute);
+		for (int c = 0; c < 3; c++)
+		{
+			shError = (std::max)(shError, (double)fabsf(sh[c] - constant[c]) / constant[c]);
+			bruteError = (std::max)(bruteError, (double)fabsf(brute[c] - constant[c]) / constant[c]);
+		}
+	}
+	Check(shError < 1e-3, "SH irradiance / pi equals the radiance (relative error)", shError);
+	Check(bruteError < 2e-2, "Brute force irradiance / pi equals the radiance", bruteError);
+
+	std::vector<CubeImage> flatChain, flatPrefiltered;
+	IblPrecompute::BuildChain(flat, flatChain);
+	IblPrecompute::PrefilterSpecular(flatChain, 16, 5, 64, flatPrefiltered, &queue);
+	double prefilterError = 0.0;
+	for (const CubeImage& level : flatPrefiltered)
+		for (unsigned int face = 0; face < 6; face++)
+			for (size_t i = 0; i < level.Faces[face].size(); i++)
+				prefilterError = (std::max)(prefilterError, (double)fabsf(level.Faces[face][i] - constant[i % 3]) / constant[i % 3]);
+	Check(prefilterError < 1e-4, "Every prefiltered texel equals the radiance", prefilterError);
+
+	// --- Smooth sky: bright above, a warm horizon, dark ground, a soft sun ---
+	printf("Smooth sky\n");
+	CubeImage sky = MakeCube(64, [](const float* d, float* rgb)
+	{
+		float up = (std::max)(d[1], 0.0f), down = (std::max)(-d[1], 0.0f);
+		float sun = (std::max)(0.0f, 0.6f * d[0] + 0.64f * d[1] + 0.48f * d[2]);
+		sun = sun * sun * sun * sun;
+		rgb[0] = 0.5f + 0.3f * up - 0.4f * down + 2.0f * sun;
+		rgb[1] = 0.6f + 0.2f * up - 0.45f * down + 1.8f * sun;
+		rgb[2] = 0.7f + 0.5f * up - 0.55f * down + 1.2f * sun;
+	});
+	ShCoefficients skySh = IblPrecompute::ConvolveLambert(IblPrecompute::ProjectRadiance(sky));
+	double skyError = 0.0, skyMax = 0.0;
+	for (const float* n : TestNormals)
+	{
+		float sh[3], brute[3];
+		IblPrecompute::Evaluate(skySh, n, sh);
+		IblPrecompute::BruteForceIrradiance(sky, n, brute);
+		for (int c = 0; c < 3; c++)
+		{
+			skyError = (std::max)(skyError, (double)fabsf(sh[c] - brute[c]));
+			skyMax = (std::max)(skyMax, (double)brute[c]);
+		}
+	}
+	Check(skyError < 0.03 * skyMax, "SH vs brute force irradiance (error / brightest)", skyError / skyMax);
+
+	std::vector<CubeImage> skyChain, skyPrefiltered;
+	IblPrecompute::BuildChain(sky, skyChain);
+	std::chrono::steady_clock::time_point prefilterStart = std::chrono::steady_clock::now();
+	IblPrecompute::PrefilterSpecular(skyChain, 64, 6, 128, skyPrefiltered, &queue);
+	double prefilterMs = MillisecondsSince(prefilterStart);
+	double energyError = 0.0;
+	for (const CubeImage& level : skyPrefiltered)
+		for (int c = 0; c < 3; c++)
+			energyError = (std::max)(energyError, fabs(AverageRadiance(level, c) / AverageRadiance(sky, c) - 1.0));
+	Check(energyError < 0.05, "Prefiltered levels keep the average radiance", energyError);
+
+	// --- BRDF lookup table ---
+	printf("BRDF LUT (%ux%u, %u samples)\n", lutSize, lutSize, samples);
+	BrdfLut scalar, simd, threaded;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	IblPrecompute::ComputeBrdfLut(lutSize, samples, scalar, false);
+	double scalarMs = MillisecondsSince(start);
+	start = std::chrono::steady_clock::now();
+	IblPrecompute::ComputeBrdfLut(lutSize, samples, simd, true);
+	double simdMs = MillisecondsSince(start);
+	start = std::chrono::steady_clock::now();
+	IblPrecompute::ComputeBrdfLut(lutSize, samples, threaded, true, &queue);
+	double threadedMs = MillisecondsSince(start);
+
+	double simdError = 0.0, threadError = 0.0, low = 1.0, high = 0.0, smoothError = 0.0;
+	for (size_t i = 0; i < scalar.Values.size(); i++)
+	{
+		simdError = (std::max)(simdError, (double)fabsf(simd.Values[i] - scalar.Values[i]));
+		threadError = (std::max)(threadError, (double)fabsf(threaded.Values[i] - simd.Values[i]));
+		low = (std::min)(low, (double)scalar.Values[i]);
+	}
+	for (size_t i = 0; i < scalar.Values.size(); i += 2)
+		high = (std::max)(high, (double)(scalar.Values[i] + scalar.Values[i + 1]));
+	for (unsigned int x = lutSize / 8; x < lutSize; x++)
+		smoothError = (std::max)(smoothError, fabs(scalar.Values[x * 2] + scalar.Values[x * 2 + 1] - 1.0));
+	Check(simdError < 1e-4, "AVX2 matches scalar (largest difference)", simdError);
+	Check(threadError == 0.0, "Threaded matches single threaded", threadError);
+	Check(low >= 0.0, "Smallest value is at least 0", low);
+	Check(high <= 1.001, "Scale + bias is at most 1", high);
+	Check(smoothError < 0.02, "Scale + bias is 1 for the smoothest row (N dot V > 1/8)", smoothError);
+
+	// --- Cache ---
+	printf("Cache\n");
+	std::string cachePath = "IblValidate_BrdfLut.bin";
+	BrdfLut loaded, stale;
+	bool saved = IblPrecompute::SaveBrdfLut(cachePath, simd);
+	bool reloaded = saved && IblPrecompute::LoadBrdfLut(cachePath, lutSize, samples, loaded) && loaded.Values == simd.Values;
+	Check(reloaded, "Saved table loads back exactly", reloaded ? 1.0 : 0.0);
+	bool refused = !IblPrecompute::LoadBrdfLut(cachePath, lutSize, samples * 2, stale);
+	Check(refused, "Table with a different sample count is refused", refused ? 1.0 : 0.0);
+	remove(cachePath.c_str());
+
+	printf("\nTimings\n");
+	printf("  Prefilter 64x64 x6 levels, 128 samples, %u threads: %8.2f ms\n", threads, prefilterMs);
+	printf("  BRDF LUT scalar, 1 thread:                   %8.2f ms\n", scalarMs);
+	printf("  BRDF LUT %s, 1 thread:                     %8.2f ms (%.2fx)\n", CpuUtilities::HasAvx2() ? "AVX2" : "----", simdMs, scalarMs / simdMs);
+	printf("  BRDF LUT %s, %u threads:                   %8.2f ms (%.2fx)\n", CpuUtilities::HasAvx2() ? "AVX2" : "----", threads, threadedMs, scalarMs / threadedMs);
+
+	return FinishChecks();
+}
@@ -0,0 +1,427 @@
+// --------------------------------------------------------
+// Validation and timing for MeshSimplifier: welding, the
+// LOD chains of the repo's models and a large generated
+// torus, simplification throughput single-threaded and on
+// a JobQueue, and level selection with hysteresis.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -pthread -I../.. -o MeshSimplifier Main.cpp ../../MeshSimplifier.cpp ../../JobQueue.cpp
+//
+// Usage:
+//
+//  MeshSimplifier [-models <dir>] [-segments <n>] [-runs <n>]
+//
+// Exits with 1 if any check fails:
+//  - Welding keeps every triangle's corners exactly, shares
+//    vertices between the OBJ loader's triangles, and drops
+//    repeated triangles (helix.obj has every face twice)
+//  - Every level lands within 10% of its triangle target,
+//    unless MaxError stopped it short, and has no degenerate
+//    triangles or out of range indices
+//  - Every level keeps every vertex on a border and every
+//    vertex where seams end or meet, and has seams (several
+//    vertices at one position) only where the full mesh did
+//  - The full mesh's vertices are no further from each
+//    level's surface than its reported error (measured by
+//    brute force here), which stays under 2.5x MaxError
+//    (MaxError caps each collapse's RMS distance to its
+//    planes; a vertex can end up further than that)
+//  - Threaded and single-threaded chains are identical
+//  - Screen size matches a hand-worked projection, and
+//    selection is monotonic in it, switches at different
+//    sizes in and out, and holds still under jitter
+// --------------------------------------------------------
+
+#include "MeshSimplifier.h"
+#include "../Common/TestHarness.h"
+#include "../Common/TestMeshes.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <float.h>
+#include <map>
+#include <set>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A triangle's corners' positions, normals and UVs, rotated to
+// start from the smallest, so repeats match however they're wound
+static std::array<float, 24> TriangleKey(const std::vector<SourceVertex>& vertices, const unsigned int* corners)
+{
+	std::array<float, 24> smallest = {};
+	for (int first = 0; first < 3; first++)
+	{
+		std::array<float, 24> key;
+		for (int c = 0; c < 3; c++)
+			memcpy(&key[c * 8], vertices[corners[(first + c) % 3]].Position, sizeof(float) * 8);
+		if (first == 0 || key < smallest)
+			smallest = key;
+	}
+	return smallest;
+}
+
+static float Distance(const float a[3], const float b[3])
+{
+	float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+	return sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+static void ClosestOnTriangle(const float p[3], const float a[3], const float b[3], const float c[3], float closest[3])
+{
+	// Ericson, Real-Time Collision Detection, 5.1.5
+	float ab[3], ac[3], ap[3];
+	for (int i = 0; i < 3; i++)
+	{
+		ab[i] = b[i] - a[i];
+		ac[i] = c[i] - a[i];
+		ap[i] = p[i] - a[i];
+	}
+	auto dot = [](const float* x, const float* y) { return x[0] * y[0] + x[1] * y[1] + x[2] * y[2]; };
+	auto set = [&](float s, float t) { for (int i = 0; i < 3; i++) closest[i] = a[i] + ab[i] * s + ac[i] * t; };
+
+	float d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if (d1 <= 0 && d2 <= 0) { set(0, 0); return; }
+	float bp[3] = { p[0] - b[0], p[1] - b[1], p[2] - b[2] };
+	float d3 = dot(ab, bp), d4 = dot(ac, bp);
+	if (d3 >= 0 && d4 <= d3) { set(1, 0); return; }
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) { set(d1 / (d1 - d3), 0); return; }
+	float cp[3] = { p[0] - c[0], p[1] - c[1], p[2] - c[2] };
+	float d5 = dot(ab, cp), d6 = dot(ac, cp);
+	if (d6 >= 0 && d5 <= d6) { set(0, 1); return; }
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) { set(0, d2 / (d2 - d6)); return; }
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+	{
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		set(1 - w, w);
+		return;
+	}
+	float denominator = 1.0f / (va + vb + vc);
+	set(vb * denominator, vc * denominator);
+}
+
+// Furthest any of the full mesh's vertices is from a level's surface
+static float SurfaceDistance(const std::vector<SourceVertex>& vertices, const unsigned int* levelIndices, size_t levelCount, const std::vector<unsigned int>& sourceIndices)
+{
+	std::vector<unsigned char> used(vertices.size(), 0);
+	for (unsigned int index : sourceIndices)
+		used[index] = 1;
+
+	float furthest = 0.0f;
+	for (size_t v = 0; v < vertices.size(); v++)
+	{
+		if (!used[v])
+			continue;
+		float nearest = FLT_MAX;
+		for (size_t i = 0; i + 2 < levelCount && nearest > 0.0f; i += 3)
+		{
+			float closest[3];
+			ClosestOnTriangle(vertices[v].Position, vertices[levelIndices[i]].Position, vertices[levelIndices[i + 1]].Position, vertices[levelIndices[i + 2]].Position, closest);
+			nearest = (std::min)(nearest, Distance(vertices[v].Position, closest));
+		}
+		furthest = (std::max)(furthest, nearest);
+	}
+	return furthest;
+}
+
+static float BoundingRadius(const std::vector<SourceVertex>& vertices)
+{
+	float min[3], max[3];
+	for (int c = 0; c < 3; c++)
+		min[c] = max[c] = vertices[0].Position[c];
+	for (const SourceVertex& vertex : vertices)
+		for (int c = 0; c < 3; c++)
+		{
+			min[c] = (std::min)(min[c], vertex.Position[c]);
+			max[c] = (std::max)(max[c], vertex.Position[c]);
+		}
+	float center[3] = { (min[0] + max[0]) * 0.5f, (min[1] + max[1]) * 0.5f, (min[2] + max[2]) * 0.5f };
+	float radius = 0.0f;
+	for (const SourceVertex& vertex : vertices)
+		radius = (std::max)(radius, Distance(vertex.Position, center));
+	return radius;
+}
+
+// Position vertices (vertices grouped by exact position) of a set of
+// triangles, with how many vertices each one's triangles use
+struct Positions
+{
+	std::vector<unsigned int> Of;		// Per vertex
+	std::vector<unsigned int> Vertices;	// Per position vertex
+	std::vector<unsigned char> Used;
+};
+
+static Positions FindPositions(const std::vector<SourceVertex>& vertices, const unsigned int* indices, size_t indexCount)
+{
+	Positions positions;
+	std::map<std::array<float, 3>, unsigned int> found;
+	for (const SourceVertex& vertex : vertices)
+	{
+		std::array<float, 3> key = { vertex.Position[0], vertex.Position[1], vertex.Position[2] };
+		positions.Of.push_back(found.insert(std::make_pair(key, (unsigned int)found.size())).first->second);
+	}
+	positions.Vertices.assign(found.size(), 0);
+	positions.Used.assign(found.size(), 0);
+
+	std::vector<unsigned char> counted(vertices.size(), 0);
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		positions.Used[positions.Of[indices[i]]] = 1;
+		if (!counted[indices[i]])
+		{
+			counted[indices[i]] = 1;
+			positions.Vertices[positions.Of[indices[i]]]++;
+		}
+	}
+	return positions;
+}
+
+// Position vertices the simplifier must never move: on borders,
+// non-manifold or folded edges, and where seams end or meet (more
+// than two vertices, or two without exactly two seam edges)
+static std::vector<unsigned char> FindFixed(const std::vector<unsigned int>& indices, const Positions& positions)
+{
+	struct Side { unsigned int Triangle; bool Forward; };
+	std::map<std::pair<unsigned int, unsigned int>, std::vector<Side>> edges;
+	for (size_t t = 0; t < indices.size() / 3; t++)
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int a = positions.Of[indices[t * 3 + c]], b = positions.Of[indices[t * 3 + (c + 1) % 3]];
+			edges[std::make_pair((std::min)(a, b), (std::max)(a, b))].push_back({ (unsigned int)t, a < b });
+		}
+
+	auto vertexAt = [&](unsigned int triangle, unsigned int position)
+	{
+		for (int c = 0; c < 3; c++)
+			if (positions.Of[indices[triangle * 3 + c]] == position)
+				return indices[triangle * 3 + c];
+		return 0u;
+	};
+
+	std::vector<unsigned char> fixed(positions.Vertices.size(), 0);
+	std::vector<unsigned int> seamEdges(positions.Vertices.size(), 0);
+	for (const auto& edge : edges)
+	{
+		unsigned int a = edge.first.first, b = edge.first.second;
+		const std::vector<Side>& sides = edge.second;
+		if (sides.size() != 2 || sides[0].Forward == sides[1].Forward)
+		{
+			fixed[a] = fixed[b] = 1;
+			continue;
+		}
+		seamEdges[a] += vertexAt(sides[0].Triangle, a) != vertexAt(sides[1].Triangle, a);
+		seamEdges[b] += vertexAt(sides[0].Triangle, b) != vertexAt(sides[1].Triangle, b);
+	}
+	for (size_t p = 0; p < fixed.size(); p++)
+		if (positions.Vertices[p] > 2 || (positions.Vertices[p] == 2 && seamEdges[p] != 2))
+			fixed[p] = 1;
+	return fixed;
+}
+
+// Checks one chain of levels built from an indexed mesh
+static void CheckChain(const char* name, const std::vector<SourceVertex>& vertices, const std::vector<unsigned int>& indices,
+	const LodSettings& settings, const std::vector<unsigned int>& lodIndices, const std::vector<MeshLod>& lods)
+{
+	float radius = BoundingRadius(vertices);
+	char what[128];
+
+	bool inRange = true, degenerate = false;
+	for (unsigned int index : lodIndices)
+		inRange &= index < vertices.size();
+	for (size_t i = 0; i + 2 < lodIndices.size(); i += 3)
+	{
+		const float* a = vertices[lodIndices[i]].Position;
+		const float* b = vertices[lodIndices[i + 1]].Position;
+		const float* c = vertices[lodIndices[i + 2]].Position;
+		degenerate |= memcmp(a, b, 12) == 0 || memcmp(b, c, 12) == 0 || memcmp(c, a, 12) == 0;
+	}
+	snprintf(what, sizeof(what), "%s: %zu levels, no bad indices or degenerate triangles", name, lods.size());
+	Check(inRange && !degenerate && lods.size() == settings.LevelCount, what, (double)lods.size());
+
+	Positions source = FindPositions(vertices, indices.data(), indices.size());
+	std::vector<unsigned char> fixed = FindFixed(indices, source);
+	size_t fixedCount = std::count(fixed.begin(), fixed.end(), 1);
+
+	double target = (double)(indices.size() / 3);
+	for (size_t level = 1; level < lods.size(); level++)
+	{
+		const MeshLod& lod = lods[level];
+		target *= settings.TriangleRatio;
+		double triangles = lod.IndexCount / 3.0;
+		snprintf(what, sizeof(what), "%s LOD %zu: %.0f triangles, within 10%% of %.0f or at MaxError", name, level, triangles, target);
+		Check(fabs(triangles - target) <= target * 0.1 || (triangles > target && lod.Error > settings.MaxError * 0.9f), what, triangles / target);
+
+		const unsigned int* levelIndices = &lodIndices[lod.IndexStart];
+		Positions kept = FindPositions(vertices, levelIndices, lod.IndexCount);
+		unsigned int missing = 0, newSeams = 0;
+		for (size_t p = 0; p < fixed.size(); p++)
+		{
+			missing += fixed[p] && !kept.Used[p];
+			newSeams += kept.Vertices[p] > 1 && source.Vertices[p] < 2;
+		}
+		snprintf(what, sizeof(what), "%s LOD %zu: %zu fixed vertices kept, no new seams", name, level, fixedCount);
+		Check(missing == 0 && newSeams == 0, what, (double)(missing + newSeams));
+
+		float distance = SurfaceDistance(vertices, levelIndices, lod.IndexCount, indices) / radius;
+		snprintf(what, sizeof(what), "%s LOD %zu: surface within its error %.4f, under 2.5x MaxError", name, level, lod.Error);
+		Check(distance <= lod.Error + 1e-5f && lod.Error <= settings.MaxError * 2.5f, what, distance);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string models = "../../Assets/Models/";
+	unsigned int segments = 512;
+	unsigned int runs = 3;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-models" && i + 1 < argc) models = std::string(argv[++i]) + "/";
+		else if (arg == "-segments" && i + 1 < argc) segments = (std::max)(8, atoi(argv[++i]));
+		else if (arg == "-runs" && i + 1 < argc) runs = (std::max)(1, atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: MeshSimplifier [-models dir] [-segments n] [-runs n]\n");
+			return 1;
+		}
+	}
+	unsigned int threads = (std::max)(1u, std::thread::hardware_concurrency());
+	JobQueue queue(threads);
+	LodSettings settings;
+
+	// --- Models ---
+	const char* names[] = { "helix", "torus", "sphere" };
+	for (const char* name : names)
+	{
+		std::vector<SourceVertex> source;
+		std::vector<unsigned int> sourceIndices;
+		if (!LoadObj(models + name + ".obj", source, sourceIndices))
+		{
+			printf("%s: unable to load %s%s.obj\n", name, models.c_str(), name);
+			failures++;
+			continue;
+		}
+
+		std::vector<SourceVertex> vertices;
+		std::vector<unsigned int> indices;
+		MeshSimplifier::Weld(source.data(), source.size(), sourceIndices.data(), sourceIndices.size(), vertices, indices);
+		printf("%s (%zu triangles, %zu -> %zu vertices)\n", name, indices.size() / 3, source.size(), vertices.size());
+
+		std::set<std::array<float, 24>> sourceTriangles, weldedTriangles;
+		for (size_t i = 0; i + 2 < sourceIndices.size(); i += 3)
+			sourceTriangles.insert(TriangleKey(source, &sourceIndices[i]));
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			weldedTriangles.insert(TriangleKey(vertices, &indices[i]));
+		bool same = sourceTriangles == weldedTriangles && weldedTriangles.size() == indices.size() / 3;
+		Check(same && vertices.size() < source.size(), "Welding keeps every triangle once, and shares vertices", (double)source.size() / vertices.size());
+
+		std::vector<unsigned int> lodIndices;
+		std::vector<MeshLod> lods;
+		LodReport report = MeshSimplifier::BuildLods(vertices.data(), vertices.size(), indices.data(), indices.size(), settings, lodIndices, lods, &queue);
+		printf("  Built in %.2f ms on %u threads:", report.BuildMs, report.Threads);
+		for (const MeshLod& lod : lods)
+			printf(" %u", lod.IndexCount / 3);
+		printf(" triangles\n");
+		CheckChain(name, vertices, indices, settings, lodIndices, lods);
+	}
+
+	// --- Generated torus: throughput ---
+	std::vector<SourceVertex> torus;
+	std::vector<unsigned int> torusIndices;
+	MakeTorus(segments, true, torus, torusIndices);
+	size_t torusTriangles = torusIndices.size() / 3;
+	printf("\nTorus (%zu triangles, %zu vertices, %u runs)\n", torusTriangles, torus.size(), runs);
+
+	std::vector<unsigned int> serialIndices, threadedIndices;
+	std::vector<MeshLod> serialLods, threadedLods;
+	double serialMs = DBL_MAX, threadedMs = DBL_MAX;
+	for (unsigned int run = 0; run < runs; run++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		MeshSimplifier::BuildLods(torus.data(), torus.size(), torusIndices.data(), torusIndices.size(), settings, serialIndices, serialLods);
+		serialMs = (std::min)(serialMs, MillisecondsSince(start));
+
+		start = std::chrono::steady_clock::now();
+		MeshSimplifier::BuildLods(torus.data(), torus.size(), torusIndices.data(), torusIndices.size(), settings, threadedIndices, threadedLods, &queue);
+		threadedMs = (std::min)(threadedMs, MillisecondsSince(start));
+	}
+
+	// Every level reads the whole source, so that's what's counted
+	double processed = (double)torusTriangles * (settings.LevelCount - 1);
+	printf("  1 thread:   %9.2f ms  %6.2f M triangles/s\n", serialMs, processed / serialMs / 1000.0);
+	printf("  %u threads: %9.2f ms  %6.2f M triangles/s (%.2fx)\n", threads, threadedMs, processed / threadedMs / 1000.0, serialMs / threadedMs);
+
+	bool identical = serialIndices == threadedIndices && serialLods.size() == threadedLods.size();
+	for (size_t i = 0; identical && i < serialLods.size(); i++)
+		identical = serialLods[i].IndexCount == threadedLods[i].IndexCount && serialLods[i].Error == threadedLods[i].Error;
+	Check(identical, "Threaded and single-threaded chains are identical", (double)threadedLods.size());
+
+	// The surface check is quadratic, so on a smaller torus
+	MakeTorus(64, true, torus, torusIndices);
+	std::vector<unsigned int> lodIndices;
+	std::vector<MeshLod> lods;
+	MeshSimplifier::BuildLods(torus.data(), torus.size(), torusIndices.data(), torusIndices.size(), settings, lodIndices, lods, &queue);
+	CheckChain("torus 64", torus, torusIndices, settings, lodIndices, lods);
+
+	// --- Selection ---
+	printf("\nSelection\n");
+	float screenRadius = MeshSimplifier::GetScreenRadius(1.0f, 10.0f, 1.0f / tanf(0.7853982f * 0.5f), 1000.0f);
+	Check(fabsf(screenRadius - 120.7107f) < 0.01f, "Radius 1 at 10 units, 45 degree fov, 1000 px: 120.71 px", screenRadius);
+	Check(MeshSimplifier::GetScreenRadius(1.0f, 0.5f, 1.0f, 1000.0f) == FLT_MAX, "Inside the bounds: the full mesh", 0.0);
+
+	LodSelection selection;
+	std::vector<float> down, up;	// Sizes each level switch happened at, shrinking then growing
+	unsigned int level = 0;
+	bool monotonic = true;
+	for (float size = 2000.0f; size > 1.0f; size *= 0.99f)
+	{
+		unsigned int next = MeshSimplifier::SelectLod(lods, size, level, selection);
+		monotonic &= next >= level;
+		if (next != level)
+			down.push_back(size);
+		level = next;
+	}
+	for (float size = 1.0f; size < 2000.0f; size *= 1.01f)
+	{
+		unsigned int next = MeshSimplifier::SelectLod(lods, size, level, selection);
+		monotonic &= next <= level;
+		if (next != level)
+			up.push_back(size);
+		level = next;
+	}
+	Check(monotonic && level == 0 && down.size() == lods.size() - 1 && up.size() == down.size(), "Shrinking then growing passes through every level in order", (double)down.size());
+
+	// Growing back switches at larger sizes than shrinking did
+	bool separated = true;
+	float band = FLT_MAX;
+	for (size_t i = 0; i < down.size() && i < up.size(); i++)
+	{
+		float ratio = up[up.size() - 1 - i] / down[i];
+		separated &= ratio > 1.0f;
+		band = (std::min)(band, ratio);
+	}
+	Check(separated, "Switching back needs a bigger size than switching away", band);
+
+	// Around the first threshold, +-10%, every frame
+	float threshold = down.empty() ? 100.0f : down[0];
+	level = MeshSimplifier::SelectLod(lods, threshold, 0, selection);
+	unsigned int switches = 0;
+	for (int frame = 0; frame < 1000; frame++)
+	{
+		unsigned int next = MeshSimplifier::SelectLod(lods, threshold * (frame % 2 ? 1.1f : 0.9f), level, selection);
+		switches += next != level;
+		level = next;
+	}
+	Check(switches <= 1, "Jitter of 10% around a threshold switches at most once", (double)switches);
+
+	return FinishChecks();
+}
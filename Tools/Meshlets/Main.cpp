@@ -0,0 +1,379 @@
+// --------------------------------------------------------
+// Validation and timing for Meshlets: building meshlets from
+// the repo's models (welded, as Mesh loads them) and a large
+// generated torus, culling them against random views, and
+// how many triangles culling rejects.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -pthread -I../.. -o Meshlets Main.cpp ../../Meshlets.cpp ../../MeshSimplifier.cpp ../../JobQueue.cpp
+//
+// Usage:
+//
+//  Meshlets [-models <dir>] [-segments <n>] [-views <n>]
+//
+// Exits with 1 if any check fails:
+//  - Every meshlet stays within 64 vertices and 124
+//    triangles, and together they hold every triangle
+//    exactly once, back to back
+//  - Every meshlet's sphere holds all of its vertices
+//  - Models' triangles face the way their normals point
+//    (so backface culling counts mean something)
+//  - Over random views, every meshlet the cone culls has
+//    all of its triangles facing away (checked one by one),
+//    and every meshlet the frustum culls has all of its
+//    vertices outside one clip plane
+//  - Merged ranges cover exactly the meshlets that survive
+// --------------------------------------------------------
+
+#include "Meshlets.h"
+#include "MeshSimplifier.h"
+#include "../Common/TestHarness.h"
+#include "../Common/TestMeshes.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <math.h>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static float Dot(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Cross(const float a[3], const float b[3], float result[3])
+{
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void Normalize(float v[3])
+{
+	float length = sqrtf(Dot(v, v));
+	for (int i = 0; i < 3; i++)
+		v[i] /= length;
+}
+
+// Unnormalized front face normal (clockwise, as D3D sees it)
+static void FaceNormal(const std::vector<SourceVertex>& vertices, const unsigned int* corners, float normal[3])
+{
+	const float* p0 = vertices[corners[0]].Position;
+	float e1[3], e2[3];
+	for (int i = 0; i < 3; i++)
+	{
+		e1[i] = vertices[corners[1]].Position[i] - p0[i];
+		e2[i] = vertices[corners[2]].Position[i] - p0[i];
+	}
+	Cross(e1, e2, normal);
+}
+
+// DirectXMath's XMMatrixLookAtLH() * XMMatrixPerspectiveFovLH(), row major for row vectors
+static void ViewProjection(const float eye[3], const float target[3], float fieldOfView, float aspect, float nearPlane, float farPlane, float result[16])
+{
+	float z[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+	Normalize(z);
+	float up[3] = { 0, 1, 0 };
+	if (fabsf(z[1]) > 0.99f)
+	{
+		up[1] = 0;
+		up[2] = 1;
+	}
+	float x[3], y[3];
+	Cross(up, z, x);
+	Normalize(x);
+	Cross(z, x, y);
+	float view[16] = {
+		x[0], y[0], z[0], 0,
+		x[1], y[1], z[1], 0,
+		x[2], y[2], z[2], 0,
+		-Dot(x, eye), -Dot(y, eye), -Dot(z, eye), 1 };
+
+	float yScale = 1.0f / tanf(fieldOfView * 0.5f);
+	float range = farPlane / (farPlane - nearPlane);
+	float projection[16] = {
+		yScale / aspect, 0, 0, 0,
+		0, yScale, 0, 0,
+		0, 0, range, 1,
+		0, 0, -nearPlane * range, 0 };
+
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+		{
+			result[row * 4 + column] = 0.0f;
+			for (int k = 0; k < 4; k++)
+				result[row * 4 + column] += view[row * 4 + k] * projection[k * 4 + column];
+		}
+}
+
+static float Random(float low, float high)
+{
+	return low + (high - low) * (float)rand() / (float)RAND_MAX;
+}
+
+static void Bounds(const std::vector<SourceVertex>& vertices, float center[3], float& radius)
+{
+	float min[3], max[3];
+	for (int i = 0; i < 3; i++)
+		min[i] = max[i] = vertices[0].Position[i];
+	for (const SourceVertex& vertex : vertices)
+		for (int i = 0; i < 3; i++)
+		{
+			min[i] = (std::min)(min[i], vertex.Position[i]);
+			max[i] = (std::max)(max[i], vertex.Position[i]);
+		}
+	radius = 0.0f;
+	for (int i = 0; i < 3; i++)
+		center[i] = (min[i] + max[i]) * 0.5f;
+	for (const SourceVertex& vertex : vertices)
+	{
+		float d[3] = { vertex.Position[0] - center[0], vertex.Position[1] - center[1], vertex.Position[2] - center[2] };
+		radius = (std::max)(radius, sqrtf(Dot(d, d)));
+	}
+}
+
+// Checks one mesh's meshlets: limits, coverage and spheres
+static void CheckMeshlets(const char* name, const std::vector<SourceVertex>& vertices, const std::vector<unsigned int>& before,
+	const std::vector<unsigned int>& indices, const std::vector<Meshlet>& meshlets, const MeshletSettings& settings)
+{
+	char what[128];
+	bool limits = true, contiguous = true;
+	unsigned int next = 0;
+	double vertexSum = 0.0;
+	for (const Meshlet& meshlet : meshlets)
+	{
+		std::set<unsigned int> used(indices.begin() + meshlet.IndexStart, indices.begin() + meshlet.IndexStart + meshlet.IndexCount);
+		limits = limits && used.size() == meshlet.VertexCount && meshlet.VertexCount <= settings.MaxVertices &&
+			meshlet.IndexCount / 3 <= settings.MaxTriangles && meshlet.IndexCount > 0 && meshlet.IndexCount % 3 == 0;
+		contiguous = contiguous && meshlet.IndexStart == next;
+		next = meshlet.IndexStart + meshlet.IndexCount;
+		vertexSum += meshlet.VertexCount;
+	}
+	snprintf(what, sizeof(what), "%s: %zu meshlets within %u vertices, %u triangles", name, meshlets.size(), settings.MaxVertices, settings.MaxTriangles);
+	Check(limits, what, meshlets.empty() ? 0.0 : indices.size() / 3.0 / meshlets.size());
+
+	std::multiset<std::array<unsigned int, 3>> original, reordered;
+	for (size_t i = 0; i + 2 < before.size(); i += 3)
+		original.insert({ before[i], before[i + 1], before[i + 2] });
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		reordered.insert({ indices[i], indices[i + 1], indices[i + 2] });
+	snprintf(what, sizeof(what), "%s: every triangle once, meshlets back to back", name);
+	Check(contiguous && next == indices.size() && original == reordered, what, meshlets.empty() ? 0.0 : vertexSum / meshlets.size());
+
+	float worst = 0.0f;
+	for (const Meshlet& meshlet : meshlets)
+		for (unsigned int i = meshlet.IndexStart; i < meshlet.IndexStart + meshlet.IndexCount; i++)
+		{
+			const float* p = vertices[indices[i]].Position;
+			float d[3] = { p[0] - meshlet.Center[0], p[1] - meshlet.Center[1], p[2] - meshlet.Center[2] };
+			worst = (std::max)(worst, sqrtf(Dot(d, d)) - meshlet.Radius);
+		}
+	snprintf(what, sizeof(what), "%s: spheres hold their vertices", name);
+	Check(worst <= 1e-5f, what, worst);
+}
+
+// Culls from random views around a mesh, checking every culled meshlet by
+// brute force. Returns the share of triangles culled.
+static double CheckCulling(const char* name, const std::vector<SourceVertex>& vertices, const std::vector<unsigned int>& indices,
+	const std::vector<Meshlet>& meshlets, unsigned int views, float minDistance, float maxDistance, bool lookAway)
+{
+	float center[3], radius;
+	Bounds(vertices, center, radius);
+
+	MeshletCullStats stats;
+	std::vector<MeshletRange> ranges;
+	bool conesHold = true, frustumHolds = true, rangesMatch = true;
+	unsigned int allBackfacing = 0;
+	for (unsigned int v = 0; v < views; v++)
+	{
+		float direction[3] = { Random(-1, 1), Random(-1, 1), Random(-1, 1) };
+		Normalize(direction);
+		float distance = radius * Random(minDistance, maxDistance);
+		float eye[3], target[3];
+		for (int i = 0; i < 3; i++)
+		{
+			eye[i] = center[i] + direction[i] * distance;
+			target[i] = lookAway ? eye[i] + Random(-1, 1) : center[i] + Random(-0.5f, 0.5f) * radius;
+		}
+		float matrix[16];
+		ViewProjection(eye, target, 0.785398f, 16.0f / 9.0f, 0.01f, 1000.0f, matrix);
+
+		unsigned int culledBefore = stats.FrustumCulled + stats.BackfaceCulled;
+		Meshlets::Cull(meshlets.data(), meshlets.size(), matrix, eye, true, ranges, stats);
+
+		float planes[6][4];
+		Meshlets::GetFrustumPlanes(matrix, planes);
+		std::vector<unsigned char> drawn(indices.size() / 3, 0);
+		unsigned int rangeTriangles = 0;
+		for (const MeshletRange& range : ranges)
+		{
+			rangeTriangles += range.IndexCount / 3;
+			for (unsigned int t = range.IndexStart / 3; t < (range.IndexStart + range.IndexCount) / 3; t++)
+				drawn[t] = 1;
+		}
+
+		unsigned int culled = 0;
+		for (const Meshlet& meshlet : meshlets)
+		{
+			bool facingAway = true;
+			for (unsigned int i = meshlet.IndexStart; i < meshlet.IndexStart + meshlet.IndexCount; i += 3)
+			{
+				float normal[3];
+				FaceNormal(vertices, &indices[i], normal);
+				const float* p0 = vertices[indices[i]].Position;
+				float toTriangle[3] = { p0[0] - eye[0], p0[1] - eye[1], p0[2] - eye[2] };
+				facingAway = facingAway && Dot(toTriangle, normal) >= -1e-6f * sqrtf(Dot(toTriangle, toTriangle) * Dot(normal, normal));
+			}
+			allBackfacing += facingAway;
+
+			bool wasDrawn = drawn[meshlet.IndexStart / 3] != 0;
+			culled += !wasDrawn;
+			if (wasDrawn)
+				continue;
+
+			if (Meshlets::IsOutside(planes, meshlet.Center, meshlet.Radius))
+			{
+				// All outside one clip plane, in clip space
+				bool outside = false;
+				for (int p = 0; p < 6 && !outside; p++)
+				{
+					bool allOut = true;
+					for (unsigned int i = meshlet.IndexStart; i < meshlet.IndexStart + meshlet.IndexCount && allOut; i++)
+					{
+						const float* q = vertices[indices[i]].Position;
+						allOut = Dot(planes[p], q) + planes[p][3] < 0.0f;
+					}
+					outside = allOut;
+				}
+				frustumHolds = frustumHolds && outside;
+			}
+			else
+				conesHold = conesHold && facingAway;
+		}
+		rangesMatch = rangesMatch && culled == stats.FrustumCulled + stats.BackfaceCulled - culledBefore &&
+			rangeTriangles == indices.size() / 3 - [&]() { unsigned int n = 0; for (const Meshlet& m : meshlets) n += drawn[m.IndexStart / 3] ? 0 : m.IndexCount / 3; return n; }();
+	}
+
+	char what[128];
+	snprintf(what, sizeof(what), "%s: cone-culled meshlets all face away", name);
+	Check(conesHold, what, (double)stats.BackfaceCulled / (std::max)(1u, allBackfacing));
+	snprintf(what, sizeof(what), "%s: frustum-culled meshlets outside a plane", name);
+	Check(frustumHolds, what, (double)stats.FrustumCulled / (std::max)(1u, stats.Meshlets));
+	snprintf(what, sizeof(what), "%s: ranges cover exactly the survivors", name);
+	Check(rangesMatch, what, (double)stats.Ranges / views);
+	return (double)stats.TrianglesCulled / (std::max)(1u, stats.Triangles);
+}
+
+int main(int argc, char** argv)
+{
+	std::string models = "../../Assets/Models/";
+	unsigned int segments = 512;
+	unsigned int views = 200;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-models" && i + 1 < argc) models = std::string(argv[++i]) + "/";
+		else if (arg == "-segments" && i + 1 < argc) segments = (std::max)(8, atoi(argv[++i]));
+		else if (arg == "-views" && i + 1 < argc) views = (std::max)(1, atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: Meshlets [-models dir] [-segments n] [-views n]\n");
+			return 1;
+		}
+	}
+	srand(1);
+	MeshletSettings settings;
+
+	// --- Models ---
+	const char* names[] = { "sphere", "helix", "cylinder", "quad", "quad_double_sided", "torus", "cube" };
+	std::vector<std::string> summary;
+	for (const char* name : names)
+	{
+		std::vector<SourceVertex> source;
+		std::vector<unsigned int> sourceIndices;
+		if (!LoadObj(models + name + ".obj", source, sourceIndices))
+		{
+			printf("%s: unable to load %s%s.obj\n", name, models.c_str(), name);
+			failures++;
+			continue;
+		}
+
+		std::vector<SourceVertex> vertices;
+		std::vector<unsigned int> indices;
+		MeshSimplifier::Weld(source.data(), source.size(), sourceIndices.data(), sourceIndices.size(), vertices, indices);
+		printf("%s\n", name);
+
+		// Front faces (clockwise) should point the way the normals do
+		unsigned int agree = 0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			float normal[3];
+			FaceNormal(vertices, &indices[i], normal);
+			float average[3] = {};
+			for (int c = 0; c < 3; c++)
+				for (int k = 0; k < 3; k++)
+					average[k] += vertices[indices[i + c]].Normal[k];
+			agree += Dot(normal, average) > 0.0f;
+		}
+		char what[128];
+		snprintf(what, sizeof(what), "%s: front faces agree with vertex normals", name);
+		Check(agree * 10 >= indices.size() / 3 * 9, what, (double)agree / (indices.size() / 3));
+
+		std::vector<unsigned int> before = indices;
+		std::vector<Meshlet> meshlets;
+		Meshlets::Build(vertices.data(), vertices.size(), indices.data(), 0, indices.size(), settings, meshlets);
+		CheckMeshlets(name, vertices, before, indices, meshlets, settings);
+
+		unsigned int cones = 0;
+		for (const Meshlet& meshlet : meshlets)
+			cones += meshlet.ConeCutoff <= 1.0f;
+		double outside = CheckCulling(name, vertices, indices, meshlets, views, 2.0f, 6.0f, false);
+		double near = CheckCulling(name, vertices, indices, meshlets, views, 0.6f, 1.5f, true);
+
+		char line[256];
+		snprintf(line, sizeof(line), "%-18s %9zu %9zu %12u %13.1f%% %13.1f%%", name, indices.size() / 3, meshlets.size(), cones, outside * 100.0, near * 100.0);
+		summary.push_back(line);
+	}
+
+	printf("\nTriangles culled, from outside looking at the model and from close by looking anywhere:\n");
+	printf("%-18s %9s %9s %12s %14s %14s\n", "", "triangles", "meshlets", "with cones", "from outside", "close by");
+	for (const std::string& line : summary)
+		printf("%s\n", line.c_str());
+
+	// --- Throughput ---
+	std::vector<SourceVertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeTorus(segments, false, vertices, indices);
+	printf("\nTorus (%zu triangles, %zu vertices)\n", indices.size() / 3, vertices.size());
+
+	std::vector<unsigned int> before = indices;
+	std::vector<Meshlet> meshlets;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Meshlets::Build(vertices.data(), vertices.size(), indices.data(), 0, indices.size(), settings, meshlets);
+	double buildMs = MillisecondsSince(start);
+	printf("  Build:  %9.2f ms   %7.2f M triangles/s\n", buildMs, indices.size() / 3 / buildMs / 1000.0);
+	CheckMeshlets("torus", vertices, before, indices, meshlets, settings);
+
+	float eye[3] = { 0.0f, 0.6f, -1.6f };
+	float target[3] = { 0.0f, 0.0f, 0.0f };
+	float matrix[16];
+	ViewProjection(eye, target, 0.785398f, 16.0f / 9.0f, 0.01f, 1000.0f, matrix);
+	MeshletCullStats stats;
+	std::vector<MeshletRange> ranges;
+	unsigned int repeats = (std::max)(1u, 2000000u / (unsigned int)meshlets.size());
+	start = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < repeats; r++)
+		Meshlets::Cull(meshlets.data(), meshlets.size(), matrix, eye, true, ranges, stats);
+	double cullMs = MillisecondsSince(start);
+	printf("  Cull:   %9.4f ms a view   %7.2f M meshlets/s, %.1f%% of triangles culled in %zu ranges\n",
+		cullMs / repeats, stats.Meshlets / cullMs / 1000.0, 100.0 * stats.TrianglesCulled / stats.Triangles, ranges.size());
+	CheckCulling("torus", vertices, indices, meshlets, views / 4, 0.3f, 3.0f, false);
+
+	return FinishChecks();
+}
@@ -0,0 +1,389 @@
+// --------------------------------------------------------
+// Validation and timing for OcclusionCuller: random scenes
+// of the repo's models (welded, as Mesh loads them) drawn as
+// occluders, compared against a brute force rasterizer, and
+// random boxes tested against them.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -pthread -I../.. -o OcclusionCuller Main.cpp ../../OcclusionCuller.cpp ../../MeshSimplifier.cpp ../../CpuUtilities.cpp ../../JobQueue.cpp
+//
+// Usage:
+//
+//  OcclusionCuller [-models <dir>] [-scenes <n>] [-boxes <n>] [-threads <n>]
+//
+// Exits with 1 if any check fails:
+//  - The depth buffer matches the brute force one (every
+//    triangle at every pixel center) but for a few pixels
+//    on edges, where rounding decides
+//  - AVX2 and scalar, one thread and many, give identical
+//    depth buffers
+//  - Culling back faces doesn't change closed models' depth
+//    (so the winding test is the right way around)
+//  - Every pyramid texel is the furthest depth it covers
+//  - Every culled box is behind the brute force depth at
+//    every pixel center it covers
+// --------------------------------------------------------
+
+#include "OcclusionCuller.h"
+#include "MeshSimplifier.h"
+#include "CpuUtilities.h"
+#include "../Common/TestHarness.h"
+#include "../Common/TestMeshes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Model
+{
+	std::string Name;
+	std::vector<float> Positions;	// Welded, three floats each
+	std::vector<unsigned int> Indices;
+	bool Closed;
+};
+
+struct Occluder
+{
+	const Model* Source;
+	float World[16];
+};
+
+// Row vectors, so a * b applies a first
+static void Multiply(const float a[16], const float b[16], float result[16])
+{
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			result[row * 4 + column] =
+				a[row * 4 + 0] * b[0 * 4 + column] + a[row * 4 + 1] * b[1 * 4 + column] +
+				a[row * 4 + 2] * b[2 * 4 + column] + a[row * 4 + 3] * b[3 * 4 + column];
+}
+
+// DirectXMath's XMMatrixLookToLH() * XMMatrixPerspectiveFovLH()
+static void MakeViewProjection(const float eye[3], const float forward[3], float fieldOfView, float aspect, float nearZ, float farZ, float result[16])
+{
+	float z[3] = { forward[0], forward[1], forward[2] };
+	float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+	for (float& v : z)
+		v /= length;
+	float x[3] = { z[2], 0.0f, -z[0] };	// Up (0, 1, 0) cross z
+	length = sqrtf(x[0] * x[0] + x[2] * x[2]);
+	x[0] /= length;
+	x[2] /= length;
+	float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+	float view[16] = {
+		x[0], y[0], z[0], 0.0f,
+		x[1], y[1], z[1], 0.0f,
+		x[2], y[2], z[2], 0.0f,
+		-(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]), -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]), -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]), 1.0f };
+	float yScale = 1.0f / tanf(fieldOfView * 0.5f);
+	float range = farZ / (farZ - nearZ);
+	float projection[16] = {
+		yScale / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, yScale, 0.0f, 0.0f,
+		0.0f, 0.0f, range, 1.0f,
+		0.0f, 0.0f, -range * nearZ, 0.0f };
+	Multiply(view, projection, result);
+}
+
+// Uniform scale, rotation about y then x, then translation
+static void MakeWorld(float scale, float yaw, float pitch, const float position[3], float world[16])
+{
+	float cy = cosf(yaw), sy = sinf(yaw), cp = cosf(pitch), sp = sinf(pitch);
+	float rotation[16] = {
+		cy, 0.0f, -sy, 0.0f,
+		sy * sp, cp, cy * sp, 0.0f,
+		sy * cp, -sp, cy * cp, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f };
+	for (int i = 0; i < 12; i++)
+		world[i] = rotation[i] * scale;
+	world[12] = position[0];
+	world[13] = position[1];
+	world[14] = position[2];
+	world[15] = 1.0f;
+}
+
+static void TransformPoint(const float point[3], const float matrix[16], double result[4])
+{
+	for (int column = 0; column < 4; column++)
+		result[column] = (double)point[0] * matrix[column] + (double)point[1] * matrix[4 + column] + (double)point[2] * matrix[8 + column] + matrix[12 + column];
+}
+
+// Every triangle against every pixel center, in doubles: the
+// nearest depth at each, 1 where there's nothing
+static void RasterizeReference(const std::vector<Occluder>& occluders, const float viewProjection[16], unsigned int width, unsigned int height,
+	bool cullBackfaces, std::vector<float>& depth)
+{
+	depth.assign((size_t)width * height, 1.0f);
+	for (const Occluder& occluder : occluders)
+	{
+		float matrix[16];
+		Multiply(occluder.World, viewProjection, matrix);
+		const std::vector<unsigned int>& indices = occluder.Source->Indices;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			double screen[3][3];
+			bool clipped = false;
+			for (int c = 0; c < 3; c++)
+			{
+				double clip[4];
+				TransformPoint(&occluder.Source->Positions[indices[i + c] * 3], matrix, clip);
+				if (clip[3] < 1e-5 || clip[2] < 0.0)
+					clipped = true;
+				screen[c][0] = (clip[0] / clip[3] * 0.5 + 0.5) * width;
+				screen[c][1] = (0.5 - clip[1] / clip[3] * 0.5) * height;
+				screen[c][2] = (std::min)(1.0, clip[2] / clip[3]);
+			}
+			double area = (screen[1][0] - screen[0][0]) * (screen[2][1] - screen[0][1]) - (screen[2][0] - screen[0][0]) * (screen[1][1] - screen[0][1]);
+			if (clipped || area == 0.0 || (area < 0.0 && cullBackfaces))
+				continue;
+
+			double minX = (std::min)(screen[0][0], (std::min)(screen[1][0], screen[2][0]));
+			double maxX = (std::max)(screen[0][0], (std::max)(screen[1][0], screen[2][0]));
+			double minY = (std::min)(screen[0][1], (std::min)(screen[1][1], screen[2][1]));
+			double maxY = (std::max)(screen[0][1], (std::max)(screen[1][1], screen[2][1]));
+			for (int y = (std::max)(0, (int)floor(minY)); y <= (std::min)((int)height - 1, (int)ceil(maxY)); y++)
+				for (int x = (std::max)(0, (int)floor(minX)); x <= (std::min)((int)width - 1, (int)ceil(maxX)); x++)
+				{
+					double px = x + 0.5, py = y + 0.5, weights[3];
+					for (int e = 0; e < 3; e++)
+					{
+						const double* j = screen[(e + 1) % 3];
+						const double* k = screen[(e + 2) % 3];
+						weights[e] = ((k[0] - j[0]) * (py - j[1]) - (k[1] - j[1]) * (px - j[0])) / area;
+					}
+					if (weights[0] < 0.0 || weights[1] < 0.0 || weights[2] < 0.0)
+						continue;
+					float z = (float)(weights[0] * screen[0][2] + weights[1] * screen[1][2] + weights[2] * screen[2][2]);
+					float& stored = depth[(size_t)y * width + x];
+					stored = (std::min)(stored, z);
+				}
+		}
+	}
+}
+
+static void RunCuller(OcclusionCuller& culler, const std::vector<Occluder>& occluders, const float viewProjection[16])
+{
+	culler.BeginFrame(viewProjection);
+	for (const Occluder& occluder : occluders)
+		culler.AddOccluder(occluder.Source->Positions.data(), occluder.Source->Indices.data(), (unsigned int)occluder.Source->Indices.size(), occluder.World);
+	culler.Rasterize();
+}
+
+// Pixels whose depths differ by more than the tolerance
+static unsigned int CountDifferent(const float* a, const float* b, size_t count, float tolerance)
+{
+	unsigned int different = 0;
+	for (size_t i = 0; i < count; i++)
+		if (fabsf(a[i] - b[i]) > tolerance)
+			different++;
+	return different;
+}
+
+// A scene in front of the camera: occluders near it, and the
+// camera at the origin looking down +z with a little wobble
+static void MakeScene(const std::vector<Model>& models, std::mt19937& random, unsigned int occluderCount, bool closedOnly,
+	std::vector<Occluder>& occluders, float viewProjection[16])
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float eye[3] = { 0.0f, 0.0f, 0.0f };
+	float forward[3] = { unit(random) * 0.2f - 0.1f, unit(random) * 0.2f - 0.1f, 1.0f };
+	MakeViewProjection(eye, forward, 0.7853982f, 2.0f, 0.01f, 1000.0f, viewProjection);
+
+	occluders.clear();
+	while (occluders.size() < occluderCount)
+	{
+		const Model& model = models[random() % models.size()];
+		if (closedOnly && !model.Closed)
+			continue;
+		Occluder occluder;
+		occluder.Source = &model;
+		float position[3] = { unit(random) * 12.0f - 6.0f, unit(random) * 6.0f - 3.0f, 4.0f + unit(random) * 10.0f };
+		MakeWorld(0.5f + unit(random) * 2.0f, unit(random) * 6.2831853f, unit(random) * 6.2831853f, position, occluder.World);
+		occluders.push_back(occluder);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string modelDirectory = "../../Assets/Models";
+	unsigned int sceneCount = 20, boxCount = 20000;
+	unsigned int threads = (std::max)(1u, std::thread::hardware_concurrency());
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-models") == 0)
+			modelDirectory = argv[i + 1];
+		else if (strcmp(argv[i], "-scenes") == 0)
+			sceneCount = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-boxes") == 0)
+			boxCount = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-threads") == 0)
+			threads = (unsigned int)atoi(argv[i + 1]);
+	}
+
+	// Closed meshes (once welded) can have their back faces culled without changing depth
+	const char* names[] = { "cube.obj", "sphere.obj", "cylinder.obj", "torus.obj", "helix.obj" };
+	const bool closed[] = { true, true, true, true, false };
+	std::vector<Model> models;
+	for (int m = 0; m < 5; m++)
+	{
+		std::vector<SourceVertex> vertices, welded;
+		std::vector<unsigned int> indices;
+		Model model;
+		model.Name = names[m];
+		model.Closed = closed[m];
+		if (!LoadObj(modelDirectory + "/" + names[m], vertices, indices))
+		{
+			printf("Unable to load '%s' from '%s'\n", names[m], modelDirectory.c_str());
+			return 1;
+		}
+		MeshSimplifier::Weld(vertices.data(), vertices.size(), indices.data(), indices.size(), welded, model.Indices);
+		for (const SourceVertex& vertex : welded)
+			model.Positions.insert(model.Positions.end(), { vertex.Position[0], vertex.Position[1], vertex.Position[2] });
+		models.push_back(model);
+	}
+
+	OcclusionSettings settings;
+	printf("OcclusionCuller: %ux%u depth buffer, %ux%u tiles, %u threads, AVX2 %s, %u scenes\n\n", settings.Width, settings.Height,
+		settings.TileWidth, settings.TileHeight, threads, CpuUtilities::HasAvx2() ? "yes" : "no", sceneCount);
+
+	OcclusionSettings scalarSettings = settings;
+	scalarSettings.UseSimd = false;
+	scalarSettings.Threads = 1;
+	OcclusionSettings threadedSettings = settings;
+	threadedSettings.Threads = (std::max)(threads, 4u);
+	OcclusionSettings noCullSettings = threadedSettings;
+	noCullSettings.CullBackfaces = false;
+	OcclusionCuller scalar(scalarSettings), threaded(threadedSettings), noCull(noCullSettings);
+	size_t pixels = (size_t)settings.Width * settings.Height;
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	unsigned int edgePixels = 0, simdDifferent = 0, backfaceDifferent = 0, pyramidWrong = 0;
+	unsigned int tested = 0, culled = 0, culledWrong = 0;
+	double worstEdgeFraction = 0.0;
+	std::vector<Occluder> occluders;
+	std::vector<float> reference;
+	for (unsigned int scene = 0; scene < sceneCount; scene++)
+	{
+		float viewProjection[16];
+		MakeScene(models, random, 8, true, occluders, viewProjection);
+		RunCuller(scalar, occluders, viewProjection);
+		RunCuller(threaded, occluders, viewProjection);
+		RunCuller(noCull, occluders, viewProjection);
+		RasterizeReference(occluders, viewProjection, settings.Width, settings.Height, true, reference);
+
+		unsigned int width, height;
+		const float* scalarDepth = scalar.GetDepth(0, width, height);
+		const float* threadedDepth = threaded.GetDepth(0, width, height);
+		unsigned int edges = CountDifferent(scalarDepth, reference.data(), pixels, 1e-4f);
+		edgePixels += edges;
+		worstEdgeFraction = (std::max)(worstEdgeFraction, (double)edges / pixels);
+		simdDifferent += memcmp(scalarDepth, threadedDepth, pixels * sizeof(float)) != 0;
+		backfaceDifferent += CountDifferent(threadedDepth, noCull.GetDepth(0, width, height), pixels, 1e-4f);
+
+		// Every pyramid texel against the level 0 pixels it covers
+		for (unsigned int level = 1; level < threaded.GetLevelCount(); level++)
+		{
+			unsigned int levelWidth, levelHeight;
+			const float* texels = threaded.GetDepth(level, levelWidth, levelHeight);
+			for (unsigned int y = 0; y < levelHeight; y++)
+				for (unsigned int x = 0; x < levelWidth; x++)
+				{
+					float furthest = 0.0f;
+					for (unsigned int py = y << level; py < (std::min)((y + 1) << level, height); py++)
+						for (unsigned int px = x << level; px < (std::min)((x + 1) << level, width); px++)
+							furthest = (std::max)(furthest, threadedDepth[py * width + px]);
+					pyramidWrong += texels[y * levelWidth + x] != furthest;
+				}
+		}
+
+		// Random boxes among and behind the occluders
+		for (unsigned int b = 0; b < boxCount / (std::max)(1u, sceneCount); b++)
+		{
+			float size = 0.1f + unit(random) * 1.5f;
+			float boxMin[3] = { unit(random) * 16.0f - 8.0f, unit(random) * 8.0f - 4.0f, 3.0f + unit(random) * 20.0f };
+			float boxMax[3] = { boxMin[0] + size, boxMin[1] + size, boxMin[2] + size };
+			tested++;
+			if (threaded.IsBoxVisible(boxMin, boxMax))
+				continue;
+			culled++;
+
+			// The box's corners, projected in doubles, against the brute force depth
+			double minX = 1e30, minY = 1e30, maxX = -1e30, maxY = -1e30, nearest = 1.0;
+			for (int corner = 0; corner < 8; corner++)
+			{
+				float point[3] = { corner & 1 ? boxMax[0] : boxMin[0], corner & 2 ? boxMax[1] : boxMin[1], corner & 4 ? boxMax[2] : boxMin[2] };
+				double clip[4];
+				TransformPoint(point, viewProjection, clip);
+				double x = (clip[0] / clip[3] * 0.5 + 0.5) * width, y = (0.5 - clip[1] / clip[3] * 0.5) * height;
+				minX = (std::min)(minX, x);
+				maxX = (std::max)(maxX, x);
+				minY = (std::min)(minY, y);
+				maxY = (std::max)(maxY, y);
+				nearest = (std::min)(nearest, clip[2] / clip[3]);
+			}
+			bool hidden = true;
+			for (int y = (std::max)(0, (int)ceil(minY - 0.5)); y <= (std::min)((int)height - 1, (int)floor(maxY - 0.5)); y++)
+				for (int x = (std::max)(0, (int)ceil(minX - 0.5)); x <= (std::min)((int)width - 1, (int)floor(maxX - 0.5)); x++)
+					hidden = hidden && nearest > reference[(size_t)y * width + x];
+			culledWrong += !hidden;
+		}
+	}
+
+	printf("Correctness over %u scenes of 8 closed occluders\n", sceneCount);
+	Check(worstEdgeFraction <= 0.001, "Worst fraction of pixels unlike brute force", worstEdgeFraction);
+	Check(simdDifferent == 0, "Scenes where AVX2 + threads differ from scalar", simdDifferent);
+	Check(backfaceDifferent <= sceneCount * pixels / 2000, "Pixels changed by culling back faces", backfaceDifferent);
+	Check(pyramidWrong == 0, "Pyramid texels that aren't the furthest below", pyramidWrong);
+	Check(culled > 0, "Boxes culled", culled);
+	Check(culledWrong == 0, "Culled boxes visible somewhere", culledWrong);
+	printf("  (%u of %u boxes culled, %u pixels off on edges)\n\n", culled, tested, edgePixels);
+
+	// Throughput: big scenes of every model, open ones too
+	printf("Timing (16 occluders, %u boxes per scene)\n", boxCount / (std::max)(1u, sceneCount));
+	printf("  %-26s %10s %10s %12s %10s\n", "", "tris", "raster ms", "HiZ ms", "Mtests/s");
+	const char* configurations[] = { "scalar, 1 thread", "AVX2, 1 thread", "AVX2, all threads" };
+	for (int c = 0; c < 3; c++)
+	{
+		OcclusionSettings timed = settings;
+		timed.UseSimd = c > 0;
+		timed.Threads = c < 2 ? 1 : threads;
+		OcclusionCuller culler(timed);
+
+		std::mt19937 sceneRandom(99);
+		double rasterMs = 0.0, hiZMs = 0.0, testMs = 0.0;
+		unsigned int triangles = 0, tests = 0;
+		for (unsigned int scene = 0; scene < sceneCount; scene++)
+		{
+			float viewProjection[16];
+			MakeScene(models, sceneRandom, 16, false, occluders, viewProjection);
+			RunCuller(culler, occluders, viewProjection);
+			rasterMs += culler.GetStats().RasterMs;
+			hiZMs += culler.GetStats().HiZMs;
+			triangles += culler.GetStats().Triangles;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (unsigned int b = 0; b < boxCount / (std::max)(1u, sceneCount); b++)
+			{
+				float boxMin[3] = { sceneRandom() % 1600 * 0.01f - 8.0f, sceneRandom() % 800 * 0.01f - 4.0f, 3.0f + sceneRandom() % 2000 * 0.01f };
+				float boxMax[3] = { boxMin[0] + 0.5f, boxMin[1] + 0.5f, boxMin[2] + 0.5f };
+				culler.IsBoxVisible(boxMin, boxMax);
+				tests++;
+			}
+			testMs += MillisecondsSince(start);
+		}
+		printf("  %-26s %10u %10.3f %12.4f %10.2f\n", configurations[c], triangles / sceneCount, rasterMs / sceneCount, hiZMs / sceneCount,
+			tests / (testMs * 1000.0));
+	}
+
+	return FinishChecks();
+}
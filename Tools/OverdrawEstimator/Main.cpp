@@ -0,0 +1,154 @@
+// --------------------------------------------------------
+// Validation and timing for OverdrawEstimator: hand-built
+// cases with known answers, random scenes, and how long an
+// estimate takes for big ones.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -I../.. -o OverdrawEstimator Main.cpp ../../OverdrawEstimator.cpp
+//
+// Usage:
+//
+//  OverdrawEstimator [-scenes <n>] [-spheres <n>]
+//
+// Exits with 1 if any check fails:
+//  - A lone sphere covers about pi r^2 cells and is shaded
+//    once per cell, whatever the order
+//  - Spheres side by side don't overdraw
+//  - A stack drawn back to front shades every layer, front
+//    to back (and with a pre-pass) only the nearest
+//  - Spheres crossing each other split the cells where the
+//    nearer surface wins
+//  - In random scenes, nothing shades fewer cells than are
+//    covered or more fragments than there are, and the
+//    pre-pass never loses
+// --------------------------------------------------------
+
+#include "OverdrawEstimator.h"
+#include "../Common/TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static OverdrawSphere MakeSphere(float x, float y, float screenRadius, float depth, float radius)
+{
+	OverdrawSphere sphere;
+	sphere.ScreenX = x;
+	sphere.ScreenY = y;
+	sphere.ScreenRadius = screenRadius;
+	sphere.ViewDepth = depth;
+	sphere.Radius = radius;
+	return sphere;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int sceneCount = 200, sphereCount = 2000;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-scenes") == 0)
+			sceneCount = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-spheres") == 0)
+			sphereCount = (unsigned int)atoi(argv[i + 1]);
+	}
+
+	// A 1280x720 screen at the default 160x90 grid: 8 pixels a cell
+	const unsigned int width = 1280, height = 720;
+	OverdrawSettings settings;
+	printf("OverdrawEstimator: %ux%u screen, %ux%u grid\n\n", width, height, settings.GridWidth, settings.GridHeight);
+
+	printf("Known cases\n");
+	{
+		OverdrawSphere sphere = MakeSphere(640.0f, 360.0f, 160.0f, 10.0f, 1.0f);
+		OverdrawEstimate estimate = OverdrawEstimator::Estimate(&sphere, 1, width, height, settings);
+		double expected = 3.14159265 * 20.0 * 20.0;
+		Check(fabs(estimate.Covered - expected) / expected < 0.03, "Lone sphere: covered cells / pi r^2", estimate.Covered / expected);
+		Check(estimate.ShadedSubmitted == estimate.Covered && estimate.ShadedFrontToBack == estimate.Covered && estimate.Fragments == estimate.Covered,
+			"Lone sphere: overdraw", estimate.GetOverdraw(estimate.ShadedSubmitted));
+	}
+	{
+		std::vector<OverdrawSphere> spheres;
+		for (int i = 0; i < 4; i++)
+			spheres.push_back(MakeSphere(160.0f + i * 320.0f, 360.0f, 150.0f, 10.0f + i, 1.0f));
+		OverdrawEstimate estimate = OverdrawEstimator::Estimate(spheres.data(), spheres.size(), width, height, settings);
+		Check(estimate.Fragments == estimate.Covered && estimate.ShadedSubmitted == estimate.Covered, "Side by side: overdraw",
+			estimate.GetOverdraw(estimate.ShadedSubmitted));
+	}
+	{
+		// Same size on screen, further and further away, submitted furthest first
+		const int layers = 5;
+		std::vector<OverdrawSphere> spheres;
+		for (int i = layers - 1; i >= 0; i--)
+			spheres.push_back(MakeSphere(640.0f, 360.0f, 200.0f, 10.0f + i * 5.0f, 1.0f + i * 0.5f));
+		OverdrawEstimate estimate = OverdrawEstimator::Estimate(spheres.data(), spheres.size(), width, height, settings);
+		Check(estimate.ShadedSubmitted == estimate.Covered * layers, "Stack back to front: overdraw", estimate.GetOverdraw(estimate.ShadedSubmitted));
+		Check(estimate.ShadedFrontToBack == estimate.Covered, "Stack front to back: overdraw", estimate.GetOverdraw(estimate.ShadedFrontToBack));
+		Check(estimate.ShadedPrepass == estimate.Covered, "Stack with a pre-pass: overdraw", estimate.GetOverdraw(estimate.ShadedPrepass));
+
+		std::vector<unsigned int> order;
+		OverdrawEstimator::SortFrontToBack(spheres.data(), spheres.size(), order);
+		bool reversed = true;
+		for (int i = 0; i < layers; i++)
+			reversed = reversed && order[i] == (unsigned int)(layers - 1 - i);
+		Check(reversed, "Stack sorted nearest first", reversed ? 1.0 : 0.0);
+	}
+	{
+		// Two equal spheres crossing halfway: the far one only wins around its own center
+		OverdrawSphere spheres[2] = { MakeSphere(600.0f, 360.0f, 160.0f, 10.5f, 1.0f), MakeSphere(680.0f, 360.0f, 160.0f, 10.0f, 1.0f) };
+		OverdrawEstimate estimate = OverdrawEstimator::Estimate(spheres, 2, width, height, settings);
+		unsigned int overlap = estimate.Fragments - estimate.Covered;
+		Check(estimate.ShadedSubmitted > estimate.Covered && estimate.ShadedSubmitted < estimate.Fragments, "Crossing, far first: extra shaded / overlap",
+			(double)(estimate.ShadedSubmitted - estimate.Covered) / overlap);
+		Check(estimate.ShadedFrontToBack > estimate.Covered && estimate.ShadedFrontToBack < estimate.ShadedSubmitted,
+			"Crossing, near first: extra shaded / overlap", (double)(estimate.ShadedFrontToBack - estimate.Covered) / overlap);
+	}
+	{
+		OverdrawSphere empty[2] = { MakeSphere(-5000.0f, 360.0f, 100.0f, 10.0f, 1.0f), MakeSphere(640.0f, 360.0f, 0.0f, 10.0f, 1.0f) };
+		OverdrawEstimate estimate = OverdrawEstimator::Estimate(empty, 2, width, height, settings);
+		Check(estimate.Fragments == 0, "Off screen and zero sized: fragments", estimate.Fragments);
+		OverdrawSphere huge = MakeSphere(640.0f, 360.0f, 1e30f, 0.0f, 1.0f);
+		estimate = OverdrawEstimator::Estimate(&huge, 1, width, height, settings);
+		Check(estimate.Covered == settings.GridWidth * settings.GridHeight, "Huge sphere: cells covered", estimate.Covered);
+	}
+
+	printf("\nRandom scenes (%u of %u spheres)\n", sceneCount, sphereCount);
+	std::mt19937 random(77);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	unsigned int bad = 0, prepassLost = 0;
+	double submitted = 0.0, frontToBack = 0.0, prepass = 0.0, ms = 0.0;
+	std::vector<OverdrawSphere> spheres(sphereCount);
+	for (unsigned int scene = 0; scene < sceneCount; scene++)
+	{
+		// Spheres of one world size spread through a volume in front of the camera
+		for (OverdrawSphere& sphere : spheres)
+		{
+			float depth = 5.0f + unit(random) * 95.0f, radius = 0.5f + unit(random) * 2.0f;
+			sphere = MakeSphere(unit(random) * width, unit(random) * height, radius / depth * 2.414f * height * 0.5f, depth, radius);
+		}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		OverdrawEstimate estimate = OverdrawEstimator::Estimate(spheres.data(), spheres.size(), width, height, settings);
+		ms += MillisecondsSince(start);
+
+		bad += estimate.ShadedSubmitted < estimate.Covered || estimate.ShadedFrontToBack < estimate.Covered ||
+			estimate.ShadedSubmitted > estimate.Fragments || estimate.ShadedFrontToBack > estimate.Fragments;
+		prepassLost += estimate.ShadedPrepass > (std::min)(estimate.ShadedSubmitted, estimate.ShadedFrontToBack);
+		submitted += estimate.GetOverdraw(estimate.ShadedSubmitted);
+		frontToBack += estimate.GetOverdraw(estimate.ShadedFrontToBack);
+		prepass += estimate.GetOverdraw(estimate.ShadedPrepass);
+	}
+	Check(bad == 0, "Scenes shading fewer than covered or more than drawn", bad);
+	Check(prepassLost == 0, "Scenes where the pre-pass shades more", prepassLost);
+	Check(frontToBack < submitted, "Mean overdraw front to back / in scene order", frontToBack / submitted);
+	printf("  Mean overdraw: %.3fx in scene order, %.3fx front to back, %.3fx with a pre-pass\n", submitted / sceneCount, frontToBack / sceneCount,
+		prepass / sceneCount);
+	printf("  %.3f ms per estimate\n", ms / sceneCount);
+
+	return FinishChecks();
+}
@@ -0,0 +1,204 @@
+// --------------------------------------------------------
+// Validation for ResolutionController: simulated GPUs whose
+// frame time is a fixed cost plus a cost per pixel, with
+// noise, sudden load changes, and timings that arrive as
+// late as the GPU profiler's do.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -I../.. -o ResolutionController Main.cpp ../../ResolutionController.cpp
+//
+// Usage:
+//
+//  ResolutionController [-frames <n>] [-latency <n>] [-seed <n>]
+//
+// Exits with 1 if any check fails:
+//  - A scene too heavy at full resolution settles within
+//    the dead band of the target, and stays put
+//  - A light scene never leaves full resolution
+//  - A scene too heavy even at the smallest scale pins it
+//    there (and comes back when the load drops)
+//  - Load steps up and down are followed within a couple
+//    of hundred frames
+//  - Noisy timings don't make the resolution hunt
+//  - The scale never leaves its limits, and stays on steps
+// --------------------------------------------------------
+
+#include "ResolutionController.h"
+#include "../Common/TestHarness.h"
+
+#include <algorithm>
+#include <deque>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// A GPU: fixed cost plus a cost for every pixel, at full resolution
+struct Load
+{
+	float FixedMs;
+	float PixelMs;
+};
+
+struct Run
+{
+	std::vector<float> Scales;	// Per frame, what was rendered at
+	std::vector<float> Times;	// ...and what it cost
+	unsigned int Changes = 0;
+	bool InBounds = true;
+	bool OnSteps = true;
+};
+
+// Frame f renders at the scale chosen so far; its time shows up latency frames later
+static Run Simulate(ResolutionController& controller, const std::vector<Load>& loads, unsigned int frames, unsigned int latency, float noise,
+	std::mt19937& random)
+{
+	std::normal_distribution<float> jitter(0.0f, noise);
+	std::deque<float> inFlight;
+	Run run;
+	const ResolutionSettings& settings = controller.GetSettings();
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		const Load& load = loads[(size_t)frame * loads.size() / frames];
+		float scale = controller.GetScale();
+		float ms = (load.FixedMs + load.PixelMs * scale * scale) * (std::max)(0.5f, 1.0f + (noise > 0.0f ? jitter(random) : 0.0f));
+		run.Scales.push_back(scale);
+		run.Times.push_back(ms);
+		run.InBounds = run.InBounds && scale >= settings.MinScale && scale <= settings.MaxScale;
+		float steps = (settings.MaxScale - scale) / settings.Step;
+		run.OnSteps = run.OnSteps && (scale == settings.MinScale || fabsf(steps - roundf(steps)) < 1e-3f);
+
+		inFlight.push_back(ms);
+		if (inFlight.size() > latency)
+		{
+			run.Changes += controller.AddSample(inFlight.front());
+			inFlight.pop_front();
+		}
+	}
+	return run;
+}
+
+// Mean time over a range of frames
+static float MeanTime(const Run& run, unsigned int first, unsigned int end)
+{
+	double total = 0.0;
+	for (unsigned int i = first; i < end; i++)
+		total += run.Times[i];
+	return (float)(total / (end - first));
+}
+
+// Scale changes over a range of frames
+static unsigned int CountChanges(const Run& run, unsigned int first, unsigned int end)
+{
+	unsigned int changes = 0;
+	for (unsigned int i = first + 1; i < end; i++)
+		changes += run.Scales[i] != run.Scales[i - 1];
+	return changes;
+}
+
+// The first frame from which every frame's time stays within the band of the target, up to end
+static unsigned int SettledFrom(const Run& run, unsigned int first, unsigned int end, float target, float band)
+{
+	unsigned int settled = end;
+	for (unsigned int i = end; i-- > first;)
+	{
+		if (fabsf(run.Times[i] - target) > target * band)
+			break;
+		settled = i;
+	}
+	return settled;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int frames = 1200, latency = 4, seed = 5;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-frames") == 0)
+			frames = (unsigned int)(std::max)(400, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-latency") == 0)
+			latency = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-seed") == 0)
+			seed = (unsigned int)atoi(argv[i + 1]);
+	}
+
+	ResolutionSettings settings;
+	const float target = settings.TargetMs;
+	// A settled frame is within the dead band, plus what one step of scale can move it
+	const float band = settings.Deadband + 2.0f * settings.Step + 0.01f;
+	std::mt19937 random(seed);
+	printf("ResolutionController: %.1f ms target, scale %.2f-%.2f in steps of %.4f, %u frames of latency\n\n", target, settings.MinScale, settings.MaxScale,
+		settings.Step, latency);
+
+	printf("Steady loads\n");
+	{
+		// Full resolution would take 28 ms: about 0.73 scale hits 16
+		ResolutionController controller(settings);
+		Run run = Simulate(controller, { { 2.0f, 26.0f } }, frames, latency, 0.0f, random);
+		unsigned int settled = SettledFrom(run, 0, frames, target, band);
+		Check(settled < 200, "Heavy: frames to settle", settled);
+		Check(fabsf(MeanTime(run, frames / 2, frames) - target) <= target * band, "Heavy: settled time / target", MeanTime(run, frames / 2, frames) / target);
+		Check(CountChanges(run, frames / 2, frames) == 0, "Heavy: changes once settled", CountChanges(run, frames / 2, frames));
+		Check(run.InBounds && run.OnSteps, "Heavy: scales in bounds and on steps", run.Scales.back());
+	}
+	{
+		ResolutionController controller(settings);
+		Run run = Simulate(controller, { { 2.0f, 8.0f } }, frames, latency, 0.0f, random);
+		Check(run.Changes == 0 && run.Scales.back() == settings.MaxScale, "Light: changes", run.Changes);
+	}
+	{
+		// Even the smallest scale takes 22 ms, then the load drops away
+		ResolutionController controller(settings);
+		Run run = Simulate(controller, { { 12.0f, 40.0f }, { 2.0f, 8.0f } }, frames, latency, 0.0f, random);
+		Check(run.Scales[frames / 2 - 1] == settings.MinScale, "Impossible: scale at the end of the heavy half", run.Scales[frames / 2 - 1]);
+		Check(run.Scales.back() == settings.MaxScale, "Impossible, then light: final scale", run.Scales.back());
+		Check(run.InBounds, "Impossible: scales in bounds", run.InBounds ? 1.0 : 0.0);
+	}
+
+	printf("\nLoad changes\n");
+	{
+		// Light, heavy, medium, heavy: each for a quarter of the run
+		ResolutionController controller(settings);
+		std::vector<Load> loads = { { 2.0f, 10.0f }, { 2.0f, 30.0f }, { 2.0f, 20.0f }, { 2.0f, 30.0f } };
+		Run run = Simulate(controller, loads, frames, latency, 0.0f, random);
+		unsigned int quarter = frames / 4, worst = 0;
+		for (unsigned int q = 1; q < 4; q++)
+			worst = (std::max)(worst, SettledFrom(run, q * quarter, (q + 1) * quarter, target, band) - q * quarter);
+		Check(worst < 200, "Worst frames to settle after a change", worst);
+		Check(run.InBounds && run.OnSteps, "Scales in bounds and on steps", 1.0);
+	}
+
+	printf("\nNoise\n");
+	{
+		// 5% of jitter every frame: the dead band and steps should soak it up
+		ResolutionController controller(settings);
+		Run run = Simulate(controller, { { 2.0f, 26.0f } }, frames, latency, 0.05f, random);
+		unsigned int changes = CountChanges(run, frames / 2, frames);
+		Check(changes <= frames / 100, "5% noise: changes per 100 settled frames", changes * 100.0 / (frames / 2));
+		Check(fabsf(MeanTime(run, frames / 2, frames) - target) <= target * band, "5% noise: settled time / target", MeanTime(run, frames / 2, frames) / target);
+	}
+	{
+		// Twice the latency, and 10% jitter
+		ResolutionController controller(settings);
+		Run run = Simulate(controller, { { 2.0f, 26.0f } }, frames, latency * 2, 0.1f, random);
+		unsigned int changes = CountChanges(run, frames / 2, frames);
+		Check(changes <= frames / 40, "10% noise, double latency: changes per 100 settled frames", changes * 100.0 / (frames / 2));
+		Check(fabsf(MeanTime(run, frames / 2, frames) - target) <= target * (band + 0.05f), "10% noise, double latency: settled time / target",
+			MeanTime(run, frames / 2, frames) / target);
+	}
+
+	printf("\nEdge cases\n");
+	{
+		ResolutionController controller(settings);
+		bool changed = controller.AddSample(0.0f) || controller.AddSample(-1.0f) || controller.AddSample(NAN);
+		Check(!changed && controller.GetScale() == settings.MaxScale, "Zero, negative and NaN times ignored", controller.GetScale());
+		controller.Reset(0.1f);
+		Check(controller.GetScale() == settings.MinScale, "Reset below the limit clamps", controller.GetScale());
+	}
+
+	return FinishChecks();
+}
@@ -0,0 +1,316 @@
+// --------------------------------------------------------
+// Headless driver for the CPU half of a benchmark frame: the
+// generated scene's animation, its world matrices, occlusion
+// culling and the front-to-back sort, along the same camera
+// path and with the same scene flags as the game's -benchmark.
+// Every entity stands in as a unit cube.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -pthread -I../.. -I<DirectXMath>/Inc -o SceneUpdate Main.cpp ../../Transform.cpp ../../SceneGenerator.cpp
+//      ../../Benchmark.cpp ../../FrameStats.cpp ../../Profiler.cpp ../../OcclusionCuller.cpp ../../OverdrawEstimator.cpp
+//      ../../MeshSimplifier.cpp ../../CpuUtilities.cpp ../../JobQueue.cpp
+//
+// DirectXMath is header-only: <DirectXMath> is a clone of
+// github.com/microsoft/DirectXMath. Outside Windows it also
+// includes <sal.h>; its README says where to get one.
+//
+// Usage:
+//
+//  SceneUpdate [-frames <n>] [-warmup <n>] [-dt <s>] [-entities <n>] [-seed <n>] [-depth <n>] [-motion <name>] [-spacing <n>]
+//
+// Exits with 1 if any check fails:
+//  - The same settings make the same scene, matrix for matrix
+//  - Entities only move with the total time: jumping straight
+//    to the last frame lands where stepping through them does
+//  - Children keep their distance from their parents, and
+//    copying a transform leaves the hierarchy alone
+//  - Every entity is tested each frame, and occluders are
+//    never culled by themselves
+//  - The sort is a permutation of what's visible, nearest
+//    first
+// --------------------------------------------------------
+
+#include "Benchmark.h"
+#include "MeshSimplifier.h"
+#include "OcclusionCuller.h"
+#include "OverdrawEstimator.h"
+#include "Profiler.h"
+#include "SceneGenerator.h"
+#include "Transform.h"
+#include "../Common/TestHarness.h"
+
+#include <algorithm>
+#include <math.h>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+// The stand-in mesh: a unit cube, wound clockwise like the game's
+static const float CubePositions[] = { -1, -1, -1,  1, -1, -1,  1, 1, -1,  -1, 1, -1,  -1, -1, 1,  1, -1, 1,  1, 1, 1,  -1, 1, 1 };
+static const unsigned int CubeIndices[] = { 0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,  3, 7, 6, 3, 6, 2,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5 };
+static const float CubeRadius = 1.7320508f;
+
+static const unsigned int ScreenWidth = 1280;
+static const unsigned int ScreenHeight = 720;
+static const float FieldOfView = XM_PIDIV4;
+static const float NearPlane = 0.01f;
+static const float FarPlane = 1000.0f;
+
+// A generated scene, with its entities cut down to their transforms
+struct Scene
+{
+	std::unique_ptr<SceneGenerator> Generator;
+	std::vector<std::unique_ptr<Transform>> Transforms;
+	std::vector<Light> Lights;
+};
+
+static void GenerateScene(const SceneSettings& settings, Scene& scene)
+{
+	scene.Transforms.clear();
+	scene.Generator = std::make_unique<SceneGenerator>(settings);
+	scene.Generator->Generate(8, 4,
+		[](const MaterialVariation&) {},
+		[&scene](unsigned int, unsigned int)
+		{
+			scene.Transforms.push_back(std::make_unique<Transform>());
+			return scene.Transforms.back().get();
+		},
+		scene.Lights);
+}
+
+// Whether two scenes' world matrices are identical, bit for bit
+static bool SameMatrices(Scene& a, Scene& b)
+{
+	if (a.Transforms.size() != b.Transforms.size())
+		return false;
+	for (size_t i = 0; i < a.Transforms.size(); i++)
+	{
+		XMFLOAT4X4 worldA = a.Transforms[i]->GetWorldMatrix();
+		XMFLOAT4X4 worldB = b.Transforms[i]->GetWorldMatrix();
+		if (memcmp(&worldA, &worldB, sizeof(XMFLOAT4X4)) != 0)
+			return false;
+	}
+	return true;
+}
+
+// The largest scale along any axis of a world matrix, like Entity::GetWorldBounds()
+static float GetWorldScale(const XMFLOAT4X4& world)
+{
+	return sqrtf((std::max)((std::max)(
+		world._11 * world._11 + world._12 * world._12 + world._13 * world._13,
+		world._21 * world._21 + world._22 * world._22 + world._23 * world._23),
+		world._31 * world._31 + world._32 * world._32 + world._33 * world._33));
+}
+
+int main(int argc, char** argv)
+{
+	// The game's own parser, so the flags mean the same thing
+	std::string commandLine;
+	for (int i = 1; i < argc; i++)
+		commandLine += std::string(i > 1 ? " \"" : "\"") + argv[i] + "\"";
+	BenchmarkOptions options = BenchmarkOptions::Parse(commandLine.c_str());
+	if (options.Scene.EntityCount == 0)
+		options.Scene.EntityCount = 5000;
+	if (options.Scene.HierarchyDepth == 1)
+		options.Scene.HierarchyDepth = 3;
+
+	printf("SceneUpdate: %u frames (+%u warmup) at fixed dt %.5fs\nScene: %s\n\n", options.FrameCount, options.WarmupFrames,
+		options.FixedDeltaTime, options.Scene.ToString().c_str());
+
+	Scene scene;
+	GenerateScene(options.Scene, scene);
+	size_t entityCount = scene.Transforms.size();
+
+	// The benchmark's fly-around, looked through like Camera does
+	float radius = (std::max)(scene.Generator->GetRadius() * 1.2f, 10.0f);
+	CameraPath path = CameraPath::CreateFlythrough(XMFLOAT3(0.0f, 0.0f, 0.0f), radius, radius * 0.2f, options.FrameCount * options.FixedDeltaTime);
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(FieldOfView, (float)ScreenWidth / ScreenHeight, NearPlane, FarPlane));
+
+	OcclusionCuller culler((OcclusionSettings()));
+	CpuProfiler profiler;
+	std::vector<XMFLOAT4X4> worlds(entityCount);
+	std::vector<XMFLOAT3> centers(entityCount);
+	std::vector<float> radii(entityCount);
+	std::vector<std::pair<float, unsigned int>> occluders;
+	std::vector<unsigned int> visible;
+	std::vector<OverdrawSphere> spheres;
+	std::vector<unsigned int> order;
+
+	bool allTested = true, occludersPass = true, sorted = true;
+	unsigned long long visibleTotal = 0, occluderTotal = 0;
+	unsigned int totalFrames = options.WarmupFrames + options.FrameCount;
+	float totalTime = 0.0f;
+	for (unsigned int frame = 0; frame < totalFrames; frame++)
+	{
+		if (frame == options.WarmupFrames)
+			profiler.ResetStats();
+		totalTime = frame * options.FixedDeltaTime;
+		profiler.BeginFrame();
+
+		profiler.BeginScope("Update.Entities");
+		scene.Generator->Update(totalTime);
+		profiler.EndScope("Update.Entities");
+
+		// Parents before children, as each world matrix asks its parent's
+		profiler.BeginScope("Update.Transforms");
+		for (size_t i = 0; i < entityCount; i++)
+		{
+			worlds[i] = scene.Transforms[i]->GetWorldMatrix();
+			XMStoreFloat3(&centers[i], XMVector3Transform(XMVectorZero(), XMLoadFloat4x4(&worlds[i])));
+			radii[i] = CubeRadius * GetWorldScale(worlds[i]);
+		}
+		profiler.EndScope("Update.Transforms");
+
+		Transform camera;
+		XMFLOAT3 cameraPosition, cameraRotation;
+		path.Evaluate(totalTime, cameraPosition, cameraRotation);
+		camera.SetPosition(cameraPosition.x, cameraPosition.y, cameraPosition.z);
+		camera.SetRotation(cameraRotation.x, cameraRotation.y, cameraRotation.z);
+		XMFLOAT3 forward = camera.GetForward(), up = camera.GetUp();
+		XMMATRIX view = XMMatrixLookToLH(XMLoadFloat3(&cameraPosition), XMLoadFloat3(&forward), XMLoadFloat3(&up));
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, XMLoadFloat4x4(&projection)));
+
+		// Like Game::CullOccluded(): the biggest on screen occlude, then everything is tested
+		profiler.BeginScope("Update.Occlusion");
+		culler.BeginFrame(&viewProjection._11);
+		occluders.clear();
+		for (size_t i = 0; i < entityCount; i++)
+		{
+			float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&centers[i]), XMLoadFloat3(&cameraPosition))));
+			float screenRadius = MeshSimplifier::GetScreenRadius(radii[i], distance, projection._22, (float)ScreenHeight);
+			if (screenRadius >= 0.1f * ScreenHeight)
+				occluders.push_back(std::make_pair(screenRadius, (unsigned int)i));
+		}
+		std::sort(occluders.begin(), occluders.end(), [](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b)
+		{
+			return a.first > b.first;
+		});
+		if (occluders.size() > 16)
+			occluders.resize(16);
+		for (std::pair<float, unsigned int>& occluder : occluders)
+			culler.AddOccluder(CubePositions, CubeIndices, 36, &worlds[occluder.second]._11);
+		culler.Rasterize();
+
+		visible.clear();
+		for (size_t i = 0; i < entityCount; i++)
+		{
+			if (culler.IsVisible(&centers[i].x, radii[i]))
+				visible.push_back((unsigned int)i);
+		}
+		profiler.EndScope("Update.Occlusion");
+
+		// Like Game::BuildOverdrawSpheres(), nearest first for the pre-pass
+		profiler.BeginScope("Update.Sort");
+		spheres.resize(visible.size());
+		for (size_t v = 0; v < visible.size(); v++)
+		{
+			spheres[v].Radius = radii[visible[v]];
+			spheres[v].ViewDepth = XMVectorGetZ(XMVector3Transform(XMLoadFloat3(&centers[visible[v]]), view));
+		}
+		OverdrawEstimator::SortFrontToBack(spheres.data(), spheres.size(), order);
+		profiler.EndScope("Update.Sort");
+
+		profiler.EndFrame();
+
+		OcclusionStats stats = culler.GetStats();
+		allTested = allTested && stats.Tested == entityCount && stats.Culled + visible.size() == entityCount;
+		for (std::pair<float, unsigned int>& occluder : occluders)
+			occludersPass = occludersPass && std::binary_search(visible.begin(), visible.end(), occluder.second);
+
+		std::vector<bool> seen(spheres.size(), false);
+		for (size_t o = 0; o < order.size(); o++)
+		{
+			sorted = sorted && order.size() == spheres.size() && order[o] < spheres.size() && !seen[order[o]];
+			if (!sorted)
+				break;
+			seen[order[o]] = true;
+			if (o > 0)
+				sorted = sorted && spheres[order[o - 1]].ViewDepth - spheres[order[o - 1]].Radius <= spheres[order[o]].ViewDepth - spheres[order[o]].Radius;
+		}
+
+		if (frame >= options.WarmupFrames)
+		{
+			visibleTotal += visible.size();
+			occluderTotal += occluders.size();
+		}
+	}
+
+	printf("%s\n", profiler.GetStats().ToString("CPU per frame").c_str());
+	printf("Per frame: %.1f occluders, %.1f of %zu entities visible\n\n", (double)occluderTotal / options.FrameCount,
+		(double)visibleTotal / options.FrameCount, entityCount);
+
+	printf("Scene\n");
+	{
+		Scene again;
+		GenerateScene(options.Scene, again);
+		again.Generator->Update(totalTime);
+		Check(SameMatrices(scene, again), "Same settings, same world matrices", (double)entityCount);
+
+		// Straight to the last frame's time, from a scene that has been through all of them
+		Scene jumped;
+		GenerateScene(options.Scene, jumped);
+		jumped.Generator->Update(totalTime * 0.37f);
+		jumped.Generator->Update(totalTime);
+		Check(SameMatrices(scene, jumped), "Moves only with the total time", totalTime);
+	}
+	{
+		// A child's local position is scaled by its parent's world scale
+		double worstError = 0.0;
+		unsigned int children = 0;
+		for (size_t i = 0; i < entityCount; i++)
+		{
+			Transform* transform = scene.Transforms[i].get();
+			Transform* parent = transform->GetParent();
+			if (!parent)
+				continue;
+
+			XMFLOAT4X4 world = transform->GetWorldMatrix();
+			XMFLOAT4X4 parentWorld = parent->GetWorldMatrix();
+			XMFLOAT3 local = transform->GetPosition();
+			float distance = sqrtf(
+				(world._41 - parentWorld._41) * (world._41 - parentWorld._41) +
+				(world._42 - parentWorld._42) * (world._42 - parentWorld._42) +
+				(world._43 - parentWorld._43) * (world._43 - parentWorld._43));
+			float expected = XMVectorGetX(XMVector3Length(XMLoadFloat3(&local))) * GetWorldScale(parentWorld);
+			worstError = (std::max)(worstError, (double)fabsf(distance - expected) / (std::max)(expected, 1.0f));
+			children++;
+		}
+		Check(children > 0 && worstError < 1e-4, "Children's distance from their parents (worst error)", worstError);
+	}
+	{
+		// Copies of a child and of a parent, one of them dropped right away
+		Transform parent, child;
+		child.SetParent(&parent);
+		child.SetPosition(1.0f, 2.0f, 3.0f);
+		Transform copy(child);
+		{
+			Transform dropped(parent);
+		}
+		parent.SetPosition(10.0f, 0.0f, 0.0f);
+
+		// Assigning onto the child moves it, but it keeps its parent
+		Transform moved;
+		moved.SetPosition(4.0f, 5.0f, 6.0f);
+		child = moved;
+
+		XMFLOAT4X4 copyWorld = copy.GetWorldMatrix();
+		XMFLOAT4X4 childWorld = child.GetWorldMatrix();
+		bool apart = copy.GetParent() == nullptr && copyWorld._41 == 1.0f && child.GetParent() == &parent && moved.GetParent() == nullptr &&
+			childWorld._41 == 14.0f && childWorld._42 == 5.0f && childWorld._43 == 6.0f;
+		Check(apart, "Copies take the position only, not the parent or children", apart ? 1.0 : 0.0);
+	}
+
+	printf("\nCulling and sorting\n");
+	Check(allTested, "Every entity tested, every frame", allTested ? 1.0 : 0.0);
+	Check(occludersPass, "Occluders never culled by themselves", occludersPass ? 1.0 : 0.0);
+	Check(sorted, "Sorted: all of the visible, nearest first", sorted ? 1.0 : 0.0);
+
+	return FinishChecks();
+}
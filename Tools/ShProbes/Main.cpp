@@ -0,0 +1,228 @@
+// --------------------------------------------------------
+// Validation and timing for ShProbeGrid: SH projection of a
+// cube map (scalar, AVX2, threaded), baked lights, grid
+// interpolation and the half float packing.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -pthread -I../.. -o ShProbes Main.cpp ../../ShProbeGrid.cpp
+//      ../../IblPrecompute.cpp ../../CpuUtilities.cpp ../../JobQueue.cpp ../../PngReader.cpp
+//
+// Usage:
+//
+//  ShProbes [-threads <n>] [-runs <n>]
+//
+// Exits with 1 if any check fails:
+//  - AVX2, scalar and threaded projection agree with each other
+//    and with IblPrecompute::ProjectRadiance()
+//  - Probe irradiance of a smooth sky is within 3% of brute
+//    force integration over the cube
+//  - A baked directional light matches I * max(0, N dot L) up
+//    to SH9's ringing, and a point light fades with range
+//  - Sampling the grid returns a probe at its position and
+//    blends linearly in between
+//  - Packed probes unpack to their coefficients
+// --------------------------------------------------------
+
+#include "ShProbeGrid.h"
+#include "CpuUtilities.h"
+#include "../Common/TestHarness.h"
+#include "../Common/TestCubes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+static void SmoothSky(const float* d, float* rgb)
+{
+	float up = (std::max)(d[1], 0.0f), down = (std::max)(-d[1], 0.0f);
+	float sun = (std::max)(0.0f, 0.6f * d[0] + 0.64f * d[1] + 0.48f * d[2]);
+	sun = sun * sun * sun * sun;
+	rgb[0] = 0.5f + 0.3f * up - 0.4f * down + 2.0f * sun;
+	rgb[1] = 0.6f + 0.2f * up - 0.45f * down + 1.8f * sun;
+	rgb[2] = 0.7f + 0.5f * up - 0.55f * down + 1.2f * sun;
+}
+
+static double LargestDifference(const ShCoefficients& a, const ShCoefficients& b)
+{
+	double largest = 0.0;
+	for (int i = 0; i < 9; i++)
+		for (int c = 0; c < 3; c++)
+			largest = (std::max)(largest, (double)fabsf(a.Rgb[i][c] - b.Rgb[i][c]));
+	return largest;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int threads = (std::max)(1u, std::thread::hardware_concurrency());
+	unsigned int runs = 20;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-threads" && i + 1 < argc) threads = (std::max)(1, atoi(argv[++i]));
+		else if (arg == "-runs" && i + 1 < argc) runs = (std::max)(1, atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: ShProbes [-threads n] [-runs n]\n");
+			return 1;
+		}
+	}
+	JobQueue queue(threads);
+
+	// --- Projection ---
+	printf("Projection (smooth sky, 64x64)\n");
+	CubeImage sky = MakeCube(64, SmoothSky);
+	ShCoefficients reference = IblPrecompute::ProjectRadiance(sky);
+	ShCoefficients scalar = ShProbeGrid::ProjectCube(sky, false);
+	ShCoefficients simd = ShProbeGrid::ProjectCube(sky, true);
+	ShCoefficients threaded = ShProbeGrid::ProjectCube(sky, true, &queue);
+	Check(LargestDifference(scalar, reference) < 1e-4, "Scalar matches IblPrecompute::ProjectRadiance()", LargestDifference(scalar, reference));
+	Check(LargestDifference(simd, scalar) < 1e-4, "AVX2 matches scalar (largest difference)", LargestDifference(simd, scalar));
+	Check(LargestDifference(threaded, simd) == 0.0, "Threaded matches single threaded", LargestDifference(threaded, simd));
+
+	// An odd size leaves a scalar tail on every row
+	CubeImage oddSky = MakeCube(21, SmoothSky);
+	double oddError = LargestDifference(ShProbeGrid::ProjectCube(oddSky, true), ShProbeGrid::ProjectCube(oddSky, false));
+	Check(oddError < 1e-4, "AVX2 matches scalar, 21x21 (row tails)", oddError);
+
+	// --- Irradiance ---
+	printf("Irradiance\n");
+	ShCoefficients irradiance = IblPrecompute::ConvolveLambert(simd);
+	double skyError = 0.0, skyMax = 0.0;
+	for (const float* n : TestNormals)
+	{
+		float sh[3], brute[3];
+		IblPrecompute::Evaluate(irradiance, n, sh);
+		IblPrecompute::BruteForceIrradiance(sky, n, brute);
+		for (int c = 0; c < 3; c++)
+		{
+			skyError = (std::max)(skyError, (double)fabsf(sh[c] - brute[c]));
+			skyMax = (std::max)(skyMax, (double)brute[c]);
+		}
+	}
+	Check(skyError < 0.03 * skyMax, "SH vs brute force irradiance (error / brightest)", skyError / skyMax);
+
+	// --- Baked lights ---
+	// SH9 can't hold the cosine lobe's kink at the terminator; the
+	// difference is largest there, at about 0.1 of the peak
+	printf("Baked lights\n");
+	ProbeLight sun;
+	sun.Direction[0] = 0.0f; sun.Direction[1] = -0.8f; sun.Direction[2] = 0.6f;
+	sun.Color[0] = 1.0f; sun.Color[1] = 0.9f; sun.Color[2] = 0.8f;
+	sun.Intensity = 2.0f;
+	const float origin[3] = { 0, 0, 0 };
+	ShCoefficients sunRadiance;
+	ShProbeGrid::AddLight(sunRadiance, sun, origin);
+	ShCoefficients sunIrradiance = IblPrecompute::ConvolveLambert(sunRadiance);
+	double lightError = 0.0, facingError = 0.0;
+	const float toSun[3] = { 0.0f, 0.8f, -0.6f };
+	for (const float* n : TestNormals)
+	{
+		float sh[3];
+		IblPrecompute::Evaluate(sunIrradiance, n, sh);
+		float nDotL = (std::max)(0.0f, n[0] * toSun[0] + n[1] * toSun[1] + n[2] * toSun[2]);
+		for (int c = 0; c < 3; c++)
+			lightError = (std::max)(lightError, (double)fabsf(sh[c] - sun.Intensity * sun.Color[c] * nDotL) / sun.Intensity);
+	}
+	float facing[3];
+	IblPrecompute::Evaluate(sunIrradiance, toSun, facing);
+	facingError = fabsf(facing[0] / (sun.Intensity * sun.Color[0]) - 1.0f);
+	Check(lightError < 0.12, "Directional light vs I * N dot L (error / intensity)", lightError);
+	Check(facingError < 0.12, "Facing the light (relative error)", facingError);
+
+	ProbeLight bulb;
+	bulb.Type = 1;
+	bulb.Position[0] = 2.0f;
+	bulb.Range = 4.0f;
+	ShCoefficients near, far, outside;
+	const float nearPoint[3] = { 1, 0, 0 }, farPoint[3] = { -1, 0, 0 }, outsidePoint[3] = { -3, 0, 0 };
+	ShProbeGrid::AddLight(near, bulb, nearPoint);
+	ShProbeGrid::AddLight(far, bulb, farPoint);
+	ShProbeGrid::AddLight(outside, bulb, outsidePoint);
+	float expected = (1.0f - 9.0f / 16.0f) * (1.0f - 9.0f / 16.0f) / ((1.0f - 1.0f / 16.0f) * (1.0f - 1.0f / 16.0f));
+	float ratio = far.Rgb[0][0] / near.Rgb[0][0];
+	Check(fabsf(ratio - expected) < 1e-5, "Point light falls off like Attenuate() (ratio)", ratio);
+	Check(outside.Rgb[0][0] == 0.0f, "Point light adds nothing out of range", outside.Rgb[0][0]);
+
+	// --- Grid ---
+	printf("Grid\n");
+	ShProbeGrid grid;
+	const float boundsMin[3] = { -8, 0, -8 }, boundsMax[3] = { 8, 4, 8 };
+	const unsigned int counts[3] = { 8, 4, 8 };
+	ProbeLight lamp = bulb;
+	lamp.Position[0] = 0.0f; lamp.Position[1] = 2.0f; lamp.Position[2] = 0.0f;
+	lamp.Range = 6.0f;
+	std::vector<ProbeLight> lights = { sun, lamp };
+	grid.Bake(boundsMin, boundsMax, counts, simd, lights);
+	ProbeGridLayout layout = grid.GetLayout();
+
+	size_t index = (2 * layout.Counts[1] + 1) * layout.Counts[0] + 3;
+	float atProbe[3] = { layout.Min[0] + 3 * layout.CellSize[0], layout.Min[1] + layout.CellSize[1], layout.Min[2] + 2 * layout.CellSize[2] };
+	double probeError = LargestDifference(grid.Sample(atProbe), grid.GetProbe(index));
+	Check(probeError < 1e-5, "Sampling at a probe returns it", probeError);
+
+	float between[3] = { atProbe[0] + 0.25f * layout.CellSize[0], atProbe[1], atProbe[2] };
+	ShCoefficients blended = grid.GetProbe(index);
+	ShCoefficients next = grid.GetProbe(index + 1);
+	for (int i = 0; i < 9; i++)
+		for (int c = 0; c < 3; c++)
+			blended.Rgb[i][c] = 0.75f * blended.Rgb[i][c] + 0.25f * next.Rgb[i][c];
+	double blendError = LargestDifference(grid.Sample(between), blended);
+	Check(blendError < 1e-5, "Sampling a quarter of the way blends linearly", blendError);
+
+	float outsideGrid[3] = { -100, -100, -100 };
+	double clampError = LargestDifference(grid.Sample(outsideGrid), grid.GetProbe(0));
+	Check(clampError < 1e-5, "Outside the grid clamps to the nearest probe", clampError);
+
+	// --- Packing ---
+	printf("Packing\n");
+	std::vector<PackedShProbe> packed;
+	grid.Pack(packed);
+	double packError = 0.0;
+	for (size_t p = 0; p < packed.size(); p++)
+	{
+		float values[9][4];
+		IblPrecompute::PackForShader(grid.GetProbe(p), values);
+		for (int i = 0; i < 27; i++)
+		{
+			unsigned short half = (unsigned short)(packed[p].Halves[i / 2] >> ((i & 1) * 16));
+			float value = values[i / 3][i % 3];
+			packError = (std::max)(packError, (double)fabsf(CpuUtilities::HalfToFloat(half) - value) / (std::max)(fabsf(value), 1e-2f));
+		}
+	}
+	Check(packError < 1e-3, "Packed probes unpack within half precision (relative)", packError);
+
+	bool exact = true;
+	for (unsigned int half = 0; half < 0x7C00; half++)
+		exact = exact && CpuUtilities::FloatToHalf(CpuUtilities::HalfToFloat((unsigned short)half)) == half;
+	Check(exact, "Every finite half round trips exactly", exact ? 1.0 : 0.0);
+	Check(sizeof(PackedShProbe) == 56, "Probe size in bytes", (double)sizeof(PackedShProbe));
+
+	// --- Timings ---
+	printf("\nTimings (average of %u runs)\n", runs);
+	const unsigned int sizes[] = { 32, 64, 128, 256 };
+	for (unsigned int size : sizes)
+	{
+		CubeImage cube = MakeCube(size, SmoothSky);
+		double ms[3] = {};
+		for (int mode = 0; mode < 3; mode++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (unsigned int run = 0; run < runs; run++)
+				ShProbeGrid::ProjectCube(cube, mode > 0, mode == 2 ? &queue : 0);
+			ms[mode] = MillisecondsSince(start) / runs;
+		}
+		printf("  Project %3ux%-3u  scalar %8.3f ms   %s %8.3f ms (%.2fx)   %u threads %8.3f ms (%.2fx)\n",
+			size, size, ms[0], CpuUtilities::HasAvx2() ? "AVX2" : "----", ms[1], ms[0] / ms[1], threads, ms[2], ms[0] / ms[2]);
+	}
+
+	std::chrono::steady_clock::time_point bakeStart = std::chrono::steady_clock::now();
+	for (unsigned int run = 0; run < runs; run++)
+		grid.Bake(boundsMin, boundsMax, counts, simd, lights);
+	printf("  Bake 8x4x8 probes, 2 lights:                       %8.3f ms\n", MillisecondsSince(bakeStart) / runs);
+
+	return FinishChecks();
+}
@@ -0,0 +1,319 @@
+// --------------------------------------------------------
+// Validation for ShaderCache's keys and files, and for the
+// reflection data stored next to the bytecode. Works on a
+// scratch folder of made-up shaders, with a stand-in for the
+// compiler, so it needs neither D3D nor fxc.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -I../.. -o ShaderCache Main.cpp ../../ShaderCache.cpp ../../ShaderReflection.cpp
+//
+// Usage:
+//
+//  ShaderCache [-folder <scratch folder>]
+//
+// Exits with 1 if any check fails:
+//  - The key changes with the source, an include (even a
+//    nested one), the entry point, the target, the flags,
+//    and a define's name or value
+//  - The key doesn't change with the order of the defines,
+//    and include cycles are followed once
+//  - Reflection data round-trips field for field, both on
+//    its own and through a cache file
+//  - Truncated, padded, damaged and mislabeled files (and
+//    reflection data) are rejected
+//  - GetOrCompile() compiles on a miss only, and an edited
+//    include misses again
+// --------------------------------------------------------
+
+#include "ShaderCache.h"
+#include "../Common/TestHarness.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static void WriteFile(const std::filesystem::path& path, const std::string& contents)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file << contents;
+}
+
+static std::vector<unsigned char> ReadFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteBytes(const std::filesystem::path& path, const std::vector<unsigned char>& bytes)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write((const char*)bytes.data(), bytes.size());
+}
+
+static unsigned long long KeyOf(const ShaderCompileRequest& request)
+{
+	unsigned long long key = 0;
+	std::vector<std::string> dependencies;
+	ShaderCache::ComputeKey(request, key, dependencies);
+	return key;
+}
+
+// Reflection with every field set, and no two values alike
+static ShaderReflectionData MakeReflection()
+{
+	ShaderReflectionData data;
+	unsigned int next = 1;
+	for (int b = 0; b < 2; b++)
+	{
+		ReflectedConstantBuffer cb;
+		cb.Name = "Buffer" + std::to_string(b);
+		cb.Type = next++;
+		cb.Size = next++ * 16;
+		cb.BindIndex = next++;
+		for (int v = 0; v < 3; v++)
+			cb.Variables.push_back({ cb.Name + "Variable" + std::to_string(v), next++, next++ });
+		data.ConstantBuffers.push_back(cb);
+	}
+	data.Textures = { { "AlbedoTexture", next++ }, { "NormalMap", next++ } };
+	data.Samplers = { { "BasicSampler", next++ } };
+	data.Inputs = { { "POSITION", next++, next++, next++ }, { "TEXCOORD", next++, next++, next++ } };
+	return data;
+}
+
+static bool Same(const ShaderReflectionData& a, const ShaderReflectionData& b)
+{
+	if (a.ConstantBuffers.size() != b.ConstantBuffers.size() || a.Textures.size() != b.Textures.size() ||
+		a.Samplers.size() != b.Samplers.size() || a.Inputs.size() != b.Inputs.size())
+		return false;
+
+	for (size_t i = 0; i < a.ConstantBuffers.size(); i++)
+	{
+		const ReflectedConstantBuffer& x = a.ConstantBuffers[i];
+		const ReflectedConstantBuffer& y = b.ConstantBuffers[i];
+		if (x.Name != y.Name || x.Type != y.Type || x.Size != y.Size || x.BindIndex != y.BindIndex || x.Variables.size() != y.Variables.size())
+			return false;
+		for (size_t v = 0; v < x.Variables.size(); v++)
+		{
+			if (x.Variables[v].Name != y.Variables[v].Name || x.Variables[v].ByteOffset != y.Variables[v].ByteOffset || x.Variables[v].Size != y.Variables[v].Size)
+				return false;
+		}
+	}
+
+	const std::vector<ReflectedResource>* listsA[] = { &a.Textures, &a.Samplers };
+	const std::vector<ReflectedResource>* listsB[] = { &b.Textures, &b.Samplers };
+	for (int l = 0; l < 2; l++)
+	{
+		for (size_t i = 0; i < listsA[l]->size(); i++)
+		{
+			if ((*listsA[l])[i].Name != (*listsB[l])[i].Name || (*listsA[l])[i].BindIndex != (*listsB[l])[i].BindIndex)
+				return false;
+		}
+	}
+
+	for (size_t i = 0; i < a.Inputs.size(); i++)
+	{
+		const ReflectedInputElement& x = a.Inputs[i];
+		const ReflectedInputElement& y = b.Inputs[i];
+		if (x.SemanticName != y.SemanticName || x.SemanticIndex != y.SemanticIndex || x.Mask != y.Mask || x.ComponentType != y.ComponentType)
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path folder = std::filesystem::temp_directory_path() / "ShaderCacheValidate";
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-folder") == 0)
+			folder = argv[i + 1];
+	}
+
+	std::error_code error;
+	std::filesystem::remove_all(folder, error);
+	std::filesystem::create_directories(folder / "Cache");
+	std::filesystem::path source = folder / "Test.hlsl";
+	std::filesystem::path include = folder / "Common.hlsli";
+	std::filesystem::path nested = folder / "Nested.hlsli";
+	WriteFile(source, "#include \"Common.hlsli\"\nfloat4 main() : SV_TARGET { return Tint; }\n");
+	WriteFile(include, "#pragma once\n  #  include \"Nested.hlsli\"\nstatic const float4 Tint = 1;\n");
+	WriteFile(nested, "#include \"Common.hlsli\"\n// Nested\n");
+	printf("ShaderCache: scratch folder '%s'\n\n", folder.string().c_str());
+
+	ShaderCompileRequest request;
+	request.SourcePath = source.string();
+	request.Target = "ps_5_0";
+	request.Defines = { { "BATCHED", "1" }, { "LIGHT_COUNT", "5" } };
+
+	printf("Keys\n");
+	unsigned long long key = 0;
+	{
+		std::vector<std::string> dependencies;
+		bool computed = ShaderCache::ComputeKey(request, key, dependencies);
+		Check(computed && dependencies.size() == 3, "Source, include and nested include followed once", (double)dependencies.size());
+		Check(KeyOf(request) == key, "Same request: same key", 1.0);
+
+		ShaderCompileRequest reordered = request;
+		reordered.Defines = { { "LIGHT_COUNT", "5" }, { "BATCHED", "1" } };
+		Check(KeyOf(reordered) == key, "Defines in another order: same key", 1.0);
+
+		ShaderCompileRequest missing = request;
+		missing.SourcePath = (folder / "Missing.hlsl").string();
+		unsigned long long unused;
+		Check(!ShaderCache::ComputeKey(missing, unused, dependencies), "Missing source: no key", 1.0);
+	}
+	{
+		// Each change on its own must move the key
+		unsigned int moved = 0, changes = 0;
+		ShaderCompileRequest changed = request;
+		changed.EntryPoint = "other";
+		moved += KeyOf(changed) != key; changes++;
+		changed = request;
+		changed.Target = "ps_5_1";
+		moved += KeyOf(changed) != key; changes++;
+		changed = request;
+		changed.Flags = 1;
+		moved += KeyOf(changed) != key; changes++;
+		changed = request;
+		changed.Defines[1].Value = "6";
+		moved += KeyOf(changed) != key; changes++;
+		changed = request;
+		changed.Defines[0].Name = "UNBATCHED";
+		moved += KeyOf(changed) != key; changes++;
+		changed = request;
+		changed.Defines.push_back({ "NO_ORM_MAP", "1" });
+		moved += KeyOf(changed) != key; changes++;
+		Check(moved == changes, "Entry point, target, flags, defines: keys moved / changes", (double)moved / changes);
+
+		// ...and so must every file's text
+		const std::filesystem::path files[] = { source, include, nested };
+		moved = 0;
+		for (const std::filesystem::path& file : files)
+		{
+			std::vector<unsigned char> original = ReadFile(file);
+			std::vector<unsigned char> edited = original;
+			edited.push_back(' ');
+			WriteBytes(file, edited);
+			moved += KeyOf(request) != key;
+			WriteBytes(file, original);
+		}
+		Check(moved == 3 && KeyOf(request) == key, "Source, include, nested include edited: keys moved", moved);
+	}
+
+	printf("\nReflection\n");
+	ShaderReflectionData reflection = MakeReflection();
+	std::vector<unsigned char> serialized;
+	{
+		reflection.Serialize(serialized);
+		ShaderReflectionData read;
+		Check(read.Deserialize(serialized.data(), serialized.size()) && Same(read, reflection), "Serialize, deserialize: field for field", (double)serialized.size());
+
+		unsigned int rejected = 0;
+		for (size_t size = 0; size < serialized.size(); size++)
+			rejected += !read.Deserialize(serialized.data(), size);
+		Check(rejected == serialized.size(), "Every truncation rejected / lengths", (double)rejected / serialized.size());
+
+		std::vector<unsigned char> padded = serialized;
+		padded.push_back(0);
+		Check(!read.Deserialize(padded.data(), padded.size()) && read.ConstantBuffers.empty(), "Extra byte rejected, and leaves it empty", 1.0);
+
+		std::vector<unsigned char> wrongMagic = serialized;
+		wrongMagic[0] ^= 0xFF;
+		Check(!read.Deserialize(wrongMagic.data(), wrongMagic.size()), "Wrong magic rejected", 1.0);
+
+		std::vector<unsigned char> hugeCount = serialized;
+		hugeCount[4] = hugeCount[5] = hugeCount[6] = hugeCount[7] = 0xFF;
+		Check(!read.Deserialize(hugeCount.data(), hugeCount.size()), "Absurd count rejected", 1.0);
+	}
+
+	printf("\nCache files\n");
+	ShaderCache cache((folder / "Cache").string());
+	CompiledShader stored;
+	stored.Key = key;
+	stored.Reflection = reflection;
+	for (unsigned int i = 0; i < 1000; i++)
+		stored.Bytecode.push_back((unsigned char)(i * 37 + 11));
+	std::filesystem::path file = folder / "Cache" / ShaderCache::GetCacheFileName(request, key);
+	std::vector<unsigned char> original;
+	{
+		CompiledShader loaded;
+		bool roundTrip = cache.Store(request, stored) && cache.Load(request, key, loaded);
+		Check(roundTrip && loaded.Bytecode == stored.Bytecode && Same(loaded.Reflection, reflection) && loaded.FromCache,
+			"Store, load: bytecode and reflection", (double)loaded.Bytecode.size());
+		Check(!std::filesystem::exists(file.string() + ".tmp"), "No temporary file left behind", 1.0);
+		original = ReadFile(file);
+	}
+	{
+		CompiledShader loaded;
+		unsigned int rejected = 0, tries = 0;
+		for (size_t size = 0; size < original.size(); size += 7, tries++)
+		{
+			WriteBytes(file, std::vector<unsigned char>(original.begin(), original.begin() + size));
+			rejected += !cache.Load(request, key, loaded);
+		}
+		Check(rejected == tries, "Truncated files rejected / tries", (double)rejected / tries);
+
+		std::vector<unsigned char> padded = original;
+		padded.push_back(0);
+		WriteBytes(file, padded);
+		Check(!cache.Load(request, key, loaded), "Padded file rejected", 1.0);
+
+		// A flipped bit anywhere: header, bytecode, reflection or checksum
+		rejected = 0;
+		tries = 0;
+		for (size_t at = 0; at < original.size(); at += 13, tries++)
+		{
+			std::vector<unsigned char> damaged = original;
+			damaged[at] ^= 0x10;
+			WriteBytes(file, damaged);
+			rejected += !cache.Load(request, key, loaded);
+		}
+		Check(rejected == tries, "Damaged files rejected / tries", (double)rejected / tries);
+
+		// This key's file under another key's name
+		WriteBytes(file, original);
+		std::filesystem::rename(file, folder / "Cache" / ShaderCache::GetCacheFileName(request, key + 1));
+		Check(!cache.Load(request, key + 1, loaded), "Mislabeled file rejected", 1.0);
+		std::filesystem::remove(folder / "Cache" / ShaderCache::GetCacheFileName(request, key + 1));
+	}
+
+	printf("\nGetOrCompile\n");
+	{
+		unsigned int compiles = 0;
+		ShaderCompileFunction compile = [&compiles, &stored](const ShaderCompileRequest&, CompiledShader& result)
+		{
+			compiles++;
+			result.Bytecode = stored.Bytecode;
+			result.Reflection = stored.Reflection;
+			return true;
+		};
+
+		CompiledShader first, second, edited;
+		cache.GetOrCompile(request, compile, first);
+		cache.GetOrCompile(request, compile, second);
+		Check(compiles == 1 && !first.FromCache && second.FromCache, "Compiled once, then read from the cache", compiles);
+		Check(second.Dependencies.size() == 3 && second.Bytecode == first.Bytecode, "Cache hit keeps its dependencies", (double)second.Dependencies.size());
+
+		std::vector<unsigned char> text = ReadFile(nested);
+		text.insert(text.end(), { '/', '/', '\n' });
+		WriteBytes(nested, text);
+		cache.GetOrCompile(request, compile, edited);
+		Check(compiles == 2 && !edited.FromCache && edited.Key != first.Key, "Edited nested include: compiled again", compiles);
+		Check(cache.GetHitCount() == 1 && cache.GetMissCount() == 2, "Hits / misses counted", (double)cache.GetHitCount() / cache.GetMissCount());
+
+		ShaderCompileFunction failing = [](const ShaderCompileRequest&, CompiledShader& result) { result.Errors = "error"; return false; };
+		ShaderCompileRequest other = request;
+		other.EntryPoint = "broken";
+		CompiledShader failed;
+		bool compiled = cache.GetOrCompile(other, failing, failed);
+		Check(!compiled && !std::filesystem::exists(folder / "Cache" / ShaderCache::GetCacheFileName(other, failed.Key)), "Failed compile not stored", 1.0);
+	}
+
+	std::filesystem::remove_all(folder, error);
+	return FinishChecks();
+}
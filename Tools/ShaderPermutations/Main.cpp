@@ -0,0 +1,209 @@
+// --------------------------------------------------------
+// Validation for ShaderPermutations' keys and defines, and
+// for ShaderVariantCache, with a counter standing in for
+// the shader compiler.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -I../.. -o ShaderPermutations Main.cpp ../../ShaderPermutations.cpp
+//
+// Usage:
+//
+//  ShaderPermutations [-lookups <n>] [-seed <n>]
+//
+// Exits with 1 if any check fails:
+//  - Every feature mask and light count has its own key,
+//    and both come back out of it
+//  - Unknown bits, light counts that can't be compiled in,
+//    and the sky alongside probe-only ambient don't make
+//    new keys
+//  - The full permutation has no defines (it's the shader
+//    as it was); every other key has its own, sorted set
+//  - Probe-only ambient keeps the ambient term (no
+//    NO_ENVIRONMENT_LIGHT) without the sky's
+//  - Texture names map to their features
+//  - The cache makes each variant once, and hands back the
+//    same one after that
+// --------------------------------------------------------
+
+#include "ShaderPermutations.h"
+#include "../Common/TestHarness.h"
+
+#include <random>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// One string for a set of defines, like the ShaderManager's lookup name
+static std::string Join(const std::vector<ShaderDefine>& defines)
+{
+	std::string joined;
+	for (const ShaderDefine& define : defines)
+		joined += "|" + define.Name + "=" + define.Value;
+	return joined;
+}
+
+// Masks that are keys of their own: probe-only ambient replaces the sky's
+static bool IsKeyMask(unsigned int features)
+{
+	const unsigned int both = ShaderPermutations::EnvironmentLight | ShaderPermutations::ProbeAmbientOnly;
+	return (features & both) != both;
+}
+
+static const ShaderDefine* Find(const std::vector<ShaderDefine>& defines, const char* name)
+{
+	for (const ShaderDefine& define : defines)
+	{
+		if (define.Name == name)
+			return &define;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int lookups = 100000, seed = 7;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-lookups") == 0)
+			lookups = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-seed") == 0)
+			seed = (unsigned int)atoi(argv[i + 1]);
+	}
+
+	const unsigned int maskCount = ShaderPermutations::AllFeatures + 1;
+	unsigned int keyMaskCount = 0;
+	for (unsigned int features = 0; features < maskCount; features++)
+		keyMaskCount += IsKeyMask(features) ? 1 : 0;
+	printf("ShaderPermutations: %u feature masks, light counts compiled in up to %d\n\n", keyMaskCount, ShaderPermutations::MaxCompiledLights);
+
+	printf("Keys\n");
+	{
+		std::set<unsigned int> keys;
+		bool roundTrips = true;
+		for (unsigned int features = 0; features < maskCount; features++)
+		{
+			if (!IsKeyMask(features))
+				continue;
+			for (int lightCount = ShaderPermutations::LoopedLights; lightCount <= ShaderPermutations::MaxCompiledLights; lightCount++)
+			{
+				unsigned int key = ShaderPermutations::MakeKey(features, lightCount);
+				keys.insert(key);
+				roundTrips = roundTrips && ShaderPermutations::GetFeatures(key) == features && ShaderPermutations::GetLightCount(key) == lightCount;
+			}
+		}
+		size_t expected = (size_t)keyMaskCount * (ShaderPermutations::MaxCompiledLights + 2);
+		Check(keys.size() == expected, "Distinct keys / masks x light counts", (double)keys.size() / expected);
+		Check(roundTrips, "Features and light count read back from every key", roundTrips ? 1.0 : 0.0);
+	}
+	{
+		unsigned int full = ShaderPermutations::MakeKey(ShaderPermutations::Full, 3);
+		Check(ShaderPermutations::MakeKey(0xFFFFFFFF & ~(ShaderPermutations::Batched | ShaderPermutations::CoarseLighting | ShaderPermutations::ProbeAmbientOnly), 3) == full,
+			"Unknown feature bits dropped", 1.0);
+
+		unsigned int probes = ShaderPermutations::MakeKey(ShaderPermutations::Maps | ShaderPermutations::ProbeAmbientOnly, 3);
+		Check(ShaderPermutations::MakeKey(ShaderPermutations::Full | ShaderPermutations::ProbeAmbientOnly, 3) == probes,
+			"The sky dropped when probe-only ambient replaces it", 1.0);
+
+		unsigned int looped = ShaderPermutations::MakeKey(ShaderPermutations::Full, ShaderPermutations::LoopedLights);
+		bool same = ShaderPermutations::MakeKey(ShaderPermutations::Full, ShaderPermutations::MaxCompiledLights + 1) == looped &&
+			ShaderPermutations::MakeKey(ShaderPermutations::Full, 64) == looped &&
+			ShaderPermutations::MakeKey(ShaderPermutations::Full, -7) == looped;
+		Check(same, "Too many (or negative) lights share the looped key", same ? 1.0 : 0.0);
+		Check(ShaderPermutations::MakeKey(ShaderPermutations::Full, 0) != looped, "No lights compiled in is its own key", 1.0);
+	}
+
+	printf("\nDefines\n");
+	{
+		std::vector<ShaderDefine> full = ShaderPermutations::GetDefines(ShaderPermutations::MakeKey(ShaderPermutations::Full, ShaderPermutations::LoopedLights));
+		Check(full.empty(), "Full permutation, looped lights: defines", (double)full.size());
+
+		std::vector<ShaderDefine> batchedCoarse = ShaderPermutations::GetDefines(ShaderPermutations::MakeKey(
+			ShaderPermutations::Full | ShaderPermutations::Batched | ShaderPermutations::CoarseLighting, ShaderPermutations::LoopedLights));
+		Check(Join(batchedCoarse) == "|BATCHED=1|COARSE_LIGHTING=1", "Batched and coarse: the defines they always had", (double)batchedCoarse.size());
+
+		std::vector<ShaderDefine> bare = ShaderPermutations::GetDefines(ShaderPermutations::MakeKey(0, 5));
+		const ShaderDefine* lightCount = Find(bare, "LIGHT_COUNT");
+		bool allOff = Find(bare, "NO_ALBEDO_MAP") && Find(bare, "NO_NORMAL_MAP") && Find(bare, "NO_ORM_MAP") && Find(bare, "NO_ENVIRONMENT_LIGHT");
+		Check(allOff, "No features: every NO_ define", (double)bare.size());
+		Check(lightCount && lightCount->Value == "5", "Five lights: LIGHT_COUNT", lightCount ? atof(lightCount->Value.c_str()) : -1.0);
+
+		std::vector<ShaderDefine> probes = ShaderPermutations::GetDefines(ShaderPermutations::MakeKey(
+			ShaderPermutations::Maps | ShaderPermutations::ProbeAmbientOnly, ShaderPermutations::LoopedLights));
+		Check(Join(probes) == "|PROBE_AMBIENT_ONLY=1", "Probe-only ambient: only its own define", (double)probes.size());
+	}
+	{
+		std::set<std::string> defineSets;
+		bool sorted = true;
+		for (unsigned int features = 0; features < maskCount; features++)
+		{
+			if (!IsKeyMask(features))
+				continue;
+			for (int lightCount = ShaderPermutations::LoopedLights; lightCount <= ShaderPermutations::MaxCompiledLights; lightCount++)
+			{
+				std::vector<ShaderDefine> defines = ShaderPermutations::GetDefines(ShaderPermutations::MakeKey(features, lightCount));
+				defineSets.insert(Join(defines));
+				for (size_t i = 1; i < defines.size(); i++)
+					sorted = sorted && defines[i - 1].Name < defines[i].Name;
+			}
+		}
+		size_t expected = (size_t)keyMaskCount * (ShaderPermutations::MaxCompiledLights + 2);
+		Check(defineSets.size() == expected, "Distinct define sets / keys", (double)defineSets.size() / expected);
+		Check(sorted, "Defines sorted by name, no repeats", sorted ? 1.0 : 0.0);
+	}
+
+	printf("\nMaterials\n");
+	{
+		unsigned int features = 0;
+		for (const char* name : { "AlbedoTexture", "NormalMap", "OrmMap", "SurfaceTexture" })
+			features |= ShaderPermutations::GetMapFeature(name);
+		Check(features == ShaderPermutations::Maps, "Albedo, normal, ORM and an unknown texture: features", features);
+		Check(ShaderPermutations::GetMapFeature("NormalMap") == ShaderPermutations::NormalMap &&
+			ShaderPermutations::GetMapFeature("") == 0, "Single names", 1.0);
+		printf("  (%s)\n", ShaderPermutations::Describe(ShaderPermutations::MakeKey(features | ShaderPermutations::EnvironmentLight, 5)).c_str());
+	}
+
+	printf("\nCache\n");
+	{
+		// Stands in for the compiler: counts compiles, and numbers each result
+		unsigned int compiles = 0;
+		ShaderVariantCache<std::string> cache([&compiles](const std::vector<ShaderDefine>& defines)
+		{
+			compiles++;
+			return std::to_string(compiles) + Join(defines);
+		});
+
+		// Draws ask for a handful of permutations, over and over
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<unsigned int> anyFeatures(0, ShaderPermutations::AllFeatures);
+		std::uniform_int_distribution<int> anyLights(0, 12);
+		std::vector<unsigned int> keys;
+		for (int i = 0; i < 24; i++)
+			keys.push_back(ShaderPermutations::MakeKey(anyFeatures(random), anyLights(random)));
+		std::set<unsigned int> distinct(keys.begin(), keys.end());
+
+		std::uniform_int_distribution<size_t> anyKey(0, keys.size() - 1);
+		std::vector<std::string> first(keys.size());
+		bool stable = true;
+		for (unsigned int i = 0; i < lookups; i++)
+		{
+			size_t k = anyKey(random);
+			std::string variant = cache.Get(keys[k]);
+			if (first[k].empty())
+				first[k] = variant;
+			stable = stable && variant == first[k];
+		}
+		Check(compiles == distinct.size() && cache.GetCount() == distinct.size(), "Compiles / distinct keys", (double)compiles / distinct.size());
+		Check(cache.GetHits() + cache.GetMisses() == lookups && cache.GetMisses() == compiles, "Hits and misses add up to the lookups",
+			(double)cache.GetHits() / lookups);
+		Check(stable, "The same variant back for a key, every time", stable ? 1.0 : 0.0);
+
+		std::string made = cache.Get(ShaderPermutations::MakeKey(ShaderPermutations::Full, 64));
+		Check(made.find("LIGHT_COUNT") == std::string::npos, "A variant's defines come from its key", (double)made.size());
+	}
+
+	return FinishChecks();
+}
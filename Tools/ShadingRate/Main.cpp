@@ -0,0 +1,180 @@
+// --------------------------------------------------------
+// Validation for ShadingRateSelector, and for the way
+// PixelShader.hlsl's COARSE_LIGHTING shares lights across
+// a 2x2 quad, worked through here on the CPU.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -I../.. -o ShadingRate Main.cpp ../../ShadingRate.cpp
+//
+// Usage:
+//
+//  ShadingRate [-frames <n>] [-seed <n>]
+//
+// Exits with 1 if any check fails:
+//  - Near and big is full rate; far, or small on screen, is
+//    coarse; a camera inside the bounds is full
+//  - Switching happens past the thresholds going out, and
+//    inside them coming back
+//  - Walking away switches once, walking back switches once
+//  - Jitter around a threshold doesn't make entities flicker
+//  - Each quad pixel's sum, rebuilt from fine derivatives,
+//    is the quad's total, and splitting lights over the
+//    quad adds up to every light, whatever the count
+// --------------------------------------------------------
+
+#include "ShadingRate.h"
+#include "../Common/TestHarness.h"
+
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// A bounding radius seen from a distance, in pixels, for a 720 pixel high screen at 45 degrees
+static float ScreenRadius(float radius, float distance)
+{
+	return radius / distance * 2.4142f * 720.0f * 0.5f;
+}
+
+// PixelShader.hlsl's QuadSum() for the pixel at (x, y) of a quad: ddx_fine is the
+// right pixel's value less the left's in both, ddy_fine the bottom's less the top's
+static float QuadSum(const float quad[2][2], int x, int y)
+{
+	float rows[2];
+	for (int r = 0; r < 2; r++)
+	{
+		float ddx = quad[r][1] - quad[r][0];
+		rows[r] = quad[r][x] * 2 + (x ? -ddx : ddx);
+	}
+	float ddy = rows[1] - rows[0];
+	return rows[y] * 2 + (y ? -ddy : ddy);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int frames = 2000, seed = 3;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-frames") == 0)
+			frames = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-seed") == 0)
+			seed = (unsigned int)atoi(argv[i + 1]);
+	}
+
+	ShadingRateSelection selection;
+	printf("ShadingRateSelector: coarse past %.1f units or under %.1f pixels, %.0f%% hysteresis\n\n", selection.CoarseDistance,
+		selection.CoarseScreenRadius, selection.Hysteresis * 100.0f);
+
+	printf("Selection\n");
+	{
+		float distance = selection.CoarseDistance * 0.5f, radius = 3.0f;
+		ShadingRate rate = ShadingRateSelector::Select(distance, ScreenRadius(radius, distance), ShadingRate::Full, selection);
+		Check(rate == ShadingRate::Full, "Near and big: coarse", rate == ShadingRate::Coarse);
+
+		distance = selection.CoarseDistance * 2.0f;
+		rate = ShadingRateSelector::Select(distance, ScreenRadius(20.0f, distance), ShadingRate::Full, selection);
+		Check(rate == ShadingRate::Coarse, "Far (and big): coarse", rate == ShadingRate::Coarse);
+
+		distance = selection.CoarseDistance * 0.5f;
+		rate = ShadingRateSelector::Select(distance, selection.CoarseScreenRadius * 0.5f, ShadingRate::Full, selection);
+		Check(rate == ShadingRate::Coarse, "Near and small: coarse", rate == ShadingRate::Coarse);
+
+		rate = ShadingRateSelector::Select(0.0f, 1e30f, ShadingRate::Coarse, selection);
+		Check(rate == ShadingRate::Full, "Camera inside the bounds: coarse", rate == ShadingRate::Coarse);
+		rate = ShadingRateSelector::Select(NAN, NAN, ShadingRate::Coarse, selection);
+		Check(rate == ShadingRate::Full, "NaN bounds: coarse", rate == ShadingRate::Coarse);
+	}
+	{
+		// Just past the distance threshold, but inside the band
+		float big = selection.CoarseScreenRadius * 10.0f;
+		float justPast = selection.CoarseDistance * (1.0f + selection.Hysteresis * 0.5f);
+		float justInside = selection.CoarseDistance * (1.0f - selection.Hysteresis * 0.5f);
+		bool held = ShadingRateSelector::Select(justPast, big, ShadingRate::Full, selection) == ShadingRate::Full &&
+			ShadingRateSelector::Select(justInside, big, ShadingRate::Coarse, selection) == ShadingRate::Coarse;
+		Check(held, "Inside the distance band, both rates hold", held ? 1.0 : 0.0);
+
+		float justSmaller = selection.CoarseScreenRadius * (1.0f - selection.Hysteresis * 0.5f);
+		float justBigger = selection.CoarseScreenRadius * (1.0f + selection.Hysteresis * 0.5f);
+		float nearby = selection.CoarseDistance * 0.5f;
+		held = ShadingRateSelector::Select(nearby, justSmaller, ShadingRate::Full, selection) == ShadingRate::Full &&
+			ShadingRateSelector::Select(nearby, justBigger, ShadingRate::Coarse, selection) == ShadingRate::Coarse;
+		Check(held, "Inside the screen size band, both rates hold", held ? 1.0 : 0.0);
+	}
+
+	printf("\nMoving camera\n");
+	{
+		// Walks away from a radius 2 sphere and back, a step a frame
+		ShadingRate rate = ShadingRate::Full;
+		unsigned int outSwitches = 0, backSwitches = 0;
+		float switchedOut = 0.0f, switchedBack = 0.0f;
+		for (int step = 0; step <= 200; step++)
+		{
+			float distance = 5.0f + step * 0.5f;
+			ShadingRate next = ShadingRateSelector::Select(distance, ScreenRadius(2.0f, distance), rate, selection);
+			if (next != rate) { outSwitches++; switchedOut = distance; }
+			rate = next;
+		}
+		for (int step = 200; step >= 0; step--)
+		{
+			float distance = 5.0f + step * 0.5f;
+			ShadingRate next = ShadingRateSelector::Select(distance, ScreenRadius(2.0f, distance), rate, selection);
+			if (next != rate) { backSwitches++; switchedBack = distance; }
+			rate = next;
+		}
+		Check(outSwitches == 1 && backSwitches == 1, "Switches walking away and back", outSwitches + backSwitches);
+		Check(switchedBack < switchedOut, "Distance switched back at / out at", switchedBack / switchedOut);
+	}
+	{
+		// 5% of jitter on the distance, right at the threshold
+		std::mt19937 random(seed);
+		std::normal_distribution<float> jitter(0.0f, 0.05f);
+		ShadingRate rate = ShadingRate::Full;
+		unsigned int switches = 0;
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			float distance = selection.CoarseDistance * (1.0f + jitter(random));
+			ShadingRate next = ShadingRateSelector::Select(distance, selection.CoarseScreenRadius * 10.0f, rate, selection);
+			switches += next != rate;
+			rate = next;
+		}
+		Check(switches * 100.0 / frames <= 1.0, "5% jitter at the threshold: switches per 100 frames", switches * 100.0 / frames);
+	}
+
+	printf("\nQuad sharing\n");
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		double worst = 0.0;
+		for (int trial = 0; trial < 1000; trial++)
+		{
+			float quad[2][2] = { { unit(random), unit(random) }, { unit(random), unit(random) } };
+			float total = quad[0][0] + quad[0][1] + quad[1][0] + quad[1][1];
+			for (int y = 0; y < 2; y++)
+				for (int x = 0; x < 2; x++)
+					worst = fmax(worst, fabs(QuadSum(quad, x, y) - total) / total);
+		}
+		Check(worst < 1e-5, "Worst quad sum error, relative", worst);
+	}
+	{
+		// Each pixel takes every fourth light from its place in the quad
+		bool everyLight = true;
+		for (int lightCount = 0; lightCount <= 9; lightCount++)
+		{
+			float quad[2][2] = {};
+			for (int y = 0; y < 2; y++)
+				for (int x = 0; x < 2; x++)
+					for (int i = x + y * 2; i < lightCount; i += 4)
+						quad[y][x] += (float)(1 << i);
+			float expected = (float)((1 << lightCount) - 1);
+			for (int y = 0; y < 2; y++)
+				for (int x = 0; x < 2; x++)
+					everyLight = everyLight && QuadSum(quad, x, y) == expected;
+		}
+		Check(everyLight, "0 to 9 lights split over a quad: all counted once", everyLight ? 1.0 : 0.0);
+	}
+
+	return FinishChecks();
+}
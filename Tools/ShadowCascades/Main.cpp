@@ -0,0 +1,251 @@
+// --------------------------------------------------------
+// Validation and timing for ShadowCascades: cascade fitting
+// for random cameras and lights, and per-cascade culling of
+// a large field of casters.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -I../.. -o ShadowCascades Main.cpp ../../ShadowCascades.cpp ../../CpuUtilities.cpp
+//
+// Usage:
+//
+//  ShadowCascades [-entities <n>] [-frames <n>] [-seed <n>]
+//
+// Exits with 1 if any check fails:
+//  - Splits start at the near plane, end at the shadow distance,
+//    increase, and are even with a lambda of 0
+//  - Every corner of every slice lands inside its cascade's
+//    shadow map and depth range
+//  - A cascade's size doesn't change as the camera turns, and
+//    moving the camera moves the map by whole texels
+//  - Culling keeps every sphere that touches a cascade's box
+//    (checked exactly, in doubles), including casters between
+//    the light and the slice, and AVX2 keeps the same ones
+// --------------------------------------------------------
+
+#include "ShadowCascades.h"
+#include "CpuUtilities.h"
+#include "../Common/TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// A camera at a position, turned by pitch and yaw like Transform
+static CascadeCamera MakeCamera(float x, float y, float z, float pitch, float yaw)
+{
+	CascadeCamera camera;
+	camera.Position[0] = x; camera.Position[1] = y; camera.Position[2] = z;
+	camera.Forward[0] = sinf(yaw) * cosf(pitch);
+	camera.Forward[1] = -sinf(pitch);
+	camera.Forward[2] = cosf(yaw) * cosf(pitch);
+	camera.Right[0] = cosf(yaw);
+	camera.Right[1] = 0.0f;
+	camera.Right[2] = -sinf(yaw);
+	camera.Up[0] = sinf(yaw) * sinf(pitch);
+	camera.Up[1] = cosf(pitch);
+	camera.Up[2] = cosf(yaw) * sinf(pitch);
+	camera.AspectRatio = 16.0f / 9.0f;
+	camera.NearPlane = 0.01f;
+	camera.FarPlane = 1000.0f;
+	return camera;
+}
+
+// Distance from a sphere's center to a cascade's box, in doubles
+static double DistanceToBox(const ShadowCascade& cascade, double x, double y, double z)
+{
+	double squared = 0.0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		double p = cascade.Axes[axis][0] * x + cascade.Axes[axis][1] * y + cascade.Axes[axis][2] * z;
+		double outside = (std::max)((std::max)(cascade.BoxMin[axis] - p, p - cascade.BoxMax[axis]), 0.0);
+		squared += outside * outside;
+	}
+	return sqrt(squared);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int entityCount = 100000;
+	unsigned int frames = 100;
+	unsigned int seed = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-entities" && i + 1 < argc) entityCount = (unsigned int)atoi(argv[++i]);
+		else if (arg == "-frames" && i + 1 < argc) frames = (std::max)(1, atoi(argv[++i]));
+		else if (arg == "-seed" && i + 1 < argc) seed = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "Usage: ShadowCascades [-entities n] [-frames n] [-seed n]\n");
+			return 1;
+		}
+	}
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// --- Splits ---
+	printf("Splits\n");
+	float splits[MAX_SHADOW_CASCADES + 1];
+	ShadowCascades::ComputeSplits(0.1f, 100.0f, 4, 0.75f, splits);
+	bool increasing = true;
+	for (int i = 0; i < 4; i++)
+		increasing = increasing && splits[i + 1] > splits[i];
+	Check(splits[0] == 0.1f && splits[4] == 100.0f, "First and last split are the near plane and distance", splits[4]);
+	Check(increasing, "Splits increase", increasing ? 1.0 : 0.0);
+	ShadowCascades::ComputeSplits(0.1f, 100.0f, 4, 0.0f, splits);
+	double evenError = 0.0;
+	for (int i = 1; i < 4; i++)
+		evenError = (std::max)(evenError, fabs(splits[i] - (0.1 + 99.9 * i / 4.0)));
+	Check(evenError < 1e-4, "Lambda 0 splits evenly (largest error)", evenError);
+
+	// --- Fitting ---
+	printf("Fitting (1000 random cameras and lights)\n");
+	CascadeSettings settings;
+	ShadowCascades cascades(settings);
+	double worstOutside = 0.0, worstRadiusChange = 0.0, worstTexelError = 0.0;
+	for (int trial = 0; trial < 1000; trial++)
+	{
+		float light[3] = { unit(random) * 2 - 1, -0.2f - unit(random), unit(random) * 2 - 1 };
+		if (trial == 0)
+		{
+			// Straight down, where world up can't be light space's up
+			light[0] = 0.0f; light[1] = -1.0f; light[2] = 0.0f;
+		}
+		CascadeCamera camera = MakeCamera(unit(random) * 200 - 100, unit(random) * 20, unit(random) * 200 - 100,
+			unit(random) * 2.4f - 1.2f, unit(random) * 6.28f);
+		cascades.Fit(camera, light);
+
+		// Every corner inside the cascade, with depth to spare for casters
+		for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+		{
+			const ShadowCascade& cascade = cascades.GetCascade(c);
+			float corners[8][3];
+			ShadowCascades::GetSliceCorners(camera, cascade.SplitNear, cascade.SplitFar, corners);
+			for (const float* corner : corners)
+			{
+				float clip[4];
+				ShadowCascades::TransformPoint(corner, cascade.ViewProjection, clip);
+				double outside = (std::max)((std::max)(fabs(clip[0]) - 1.0, fabs(clip[1]) - 1.0), (std::max)(-(double)clip[2], clip[2] - 1.0));
+				worstOutside = (std::max)(worstOutside, outside);
+			}
+		}
+
+		// Turning: same sizes
+		float radii[MAX_SHADOW_CASCADES];
+		for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+			radii[c] = cascades.GetCascade(c).Radius;
+		CascadeCamera turned = MakeCamera(camera.Position[0], camera.Position[1], camera.Position[2],
+			unit(random) * 2.4f - 1.2f, unit(random) * 6.28f);
+		cascades.Fit(turned, light);
+		for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+			worstRadiusChange = (std::max)(worstRadiusChange, (double)fabsf(cascades.GetCascade(c).Radius - radii[c]) / radii[c]);
+
+		// Moving: the world origin lands on the same spot within a texel
+		const float origin[3] = { 0, 0, 0 };
+		float before[MAX_SHADOW_CASCADES][2];
+		for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+		{
+			float clip[4];
+			ShadowCascades::TransformPoint(origin, cascades.GetCascade(c).ViewProjection, clip);
+			before[c][0] = clip[0] * settings.Resolution * 0.5f;
+			before[c][1] = clip[1] * settings.Resolution * 0.5f;
+		}
+		CascadeCamera moved = turned;
+		for (int i = 0; i < 3; i++)
+			moved.Position[i] += unit(random) * 2 - 1;
+		cascades.Fit(moved, light);
+		for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+		{
+			float clip[4];
+			ShadowCascades::TransformPoint(origin, cascades.GetCascade(c).ViewProjection, clip);
+			for (int i = 0; i < 2; i++)
+			{
+				double shift = clip[i] * settings.Resolution * 0.5f - before[c][i];
+				worstTexelError = (std::max)(worstTexelError, fabs(shift - floor(shift + 0.5)));
+			}
+		}
+	}
+	Check(worstOutside <= 1e-5, "Slice corners inside the cascade (worst overshoot, NDC)", worstOutside);
+	Check(worstRadiusChange < 1e-6, "Turning keeps every cascade's size (relative change)", worstRadiusChange);
+	Check(worstTexelError < 0.02, "Moving shifts the map by whole texels (worst fraction)", worstTexelError);
+
+	// --- Culling ---
+	printf("Culling (%u spheres)\n", entityCount);
+	CasterSpheres spheres;
+	for (unsigned int i = 0; i < entityCount; i++)
+		spheres.Add(unit(random) * 400 - 200, unit(random) * 40 - 10, unit(random) * 400 - 200, 0.25f + unit(random) * 2.0f);
+	const float sun[3] = { 0.4f, -1.0f, 0.3f };
+	CascadeCamera camera = MakeCamera(10, 3, -20, 0.2f, 0.6f);
+	cascades.Fit(camera, sun);
+
+	cascades.Cull(spheres, false);
+	std::vector<unsigned int> scalar[MAX_SHADOW_CASCADES];
+	for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+		scalar[c] = cascades.GetCasters(c);
+	cascades.Cull(spheres, true);
+
+	bool same = true;
+	unsigned int missed = 0, kept = 0, exact = 0;
+	for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+	{
+		same = same && scalar[c] == cascades.GetCasters(c);
+		std::vector<bool> inList(spheres.Size(), false);
+		for (unsigned int index : scalar[c])
+			inList[index] = true;
+		for (size_t i = 0; i < spheres.Size(); i++)
+		{
+			bool touches = DistanceToBox(cascades.GetCascade(c), spheres.X[i], spheres.Y[i], spheres.Z[i]) <= spheres.Radius[i];
+			missed += touches && !inList[i];
+			exact += touches;
+		}
+		kept += (unsigned int)scalar[c].size();
+		printf("  Cascade %u: %6.2f to %6.2f, %6.2f wide, %7u casters\n", c,
+			cascades.GetCascade(c).SplitNear, cascades.GetCascade(c).SplitFar, cascades.GetCascade(c).Radius * 2, (unsigned int)scalar[c].size());
+	}
+	Check(missed == 0, "Spheres touching a box that were culled", missed);
+	Check(kept <= exact * 1.05 + 8, "Kept / touching (conservative, but not by much)", (double)kept / (std::max)(exact, 1u));
+	Check(same, "AVX2 keeps the same spheres, in the same order", same ? 1.0 : 0.0);
+
+	// Along the light from the middle of the first slice: casters in front stay, ones behind go
+	const ShadowCascade& first = cascades.GetCascade(0);
+	CasterSpheres probes;
+	float back = settings.CasterDistance * 0.5f;
+	probes.Add(first.Center[0] - first.Axes[2][0] * back, first.Center[1] - first.Axes[2][1] * back, first.Center[2] - first.Axes[2][2] * back, 0.1f);
+	float behind = first.Radius * 2 + 1;
+	probes.Add(first.Center[0] + first.Axes[2][0] * behind, first.Center[1] + first.Axes[2][1] * behind, first.Center[2] + first.Axes[2][2] * behind, 0.1f);
+	cascades.Cull(probes);
+	const std::vector<unsigned int>& firstCasters = cascades.GetCasters(0);
+	bool between = std::find(firstCasters.begin(), firstCasters.end(), 0u) != firstCasters.end();
+	bool past = std::find(firstCasters.begin(), firstCasters.end(), 1u) != firstCasters.end();
+	Check(between, "A caster between the light and the slice is kept", between ? 1.0 : 0.0);
+	Check(!past, "A caster behind the slice is culled", past ? 1.0 : 0.0);
+
+	// --- Timings ---
+	printf("\nTimings (average of %u frames, %u casters, %u cascades)\n", frames, entityCount, cascades.GetCascadeCount());
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		CascadeCamera flying = MakeCamera(frame * 0.1f, 3, -20, 0.2f, 0.6f + frame * 0.01f);
+		cascades.Fit(flying, sun);
+	}
+	double fitMs = MillisecondsSince(start) / frames;
+
+	double cullMs[2] = {};
+	for (int simd = 0; simd < 2; simd++)
+	{
+		start = std::chrono::steady_clock::now();
+		for (unsigned int frame = 0; frame < frames; frame++)
+			cascades.Cull(spheres, simd == 1);
+		cullMs[simd] = MillisecondsSince(start) / frames;
+	}
+	printf("  Fit:              %8.4f ms\n", fitMs);
+	printf("  Cull scalar:      %8.4f ms\n", cullMs[0]);
+	printf("  Cull %s:        %8.4f ms (%.2fx)\n", CpuUtilities::HasAvx2() ? "AVX2" : "----", cullMs[1], cullMs[0] / cullMs[1]);
+
+	return FinishChecks();
+}
@@ -0,0 +1,303 @@
+// --------------------------------------------------------
+// Simulation test for TextureResidency: a camera flies past
+// rows of textured objects while loads complete a few frames
+// late, and the budget is checked after every update.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -I../.. -o StreamingSim Main.cpp ../../TextureResidency.cpp
+//
+// Usage:
+//
+//  StreamingSim [-budget <MB>] [-frames <n>] [-latency <frames>] [-seed <n>] [-verbose]
+//
+// Exits with 1 if any check fails:
+//  - Resident bytes (loads in flight included) stay within the
+//    budget, once the always-resident base mips fit in it
+//  - Resident bytes match the sum of every texture's mips
+//  - No texture is loaded and evicted in the same update
+//  - Standing still with room to spare, every texture ends up
+//    with the mips it wants
+//  - Standing still with too little room, the texture covering
+//    the most screen is served before the rest
+//  - Shrinking the budget evicts down to it right away
+// --------------------------------------------------------
+
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <deque>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// Something on screen that uses a few textures
+struct SimObject
+{
+	float X, Z;
+	float Radius;
+	float UvDensity;
+	std::vector<unsigned int> Textures;
+};
+
+// A load that finishes some frames from now
+struct InFlight
+{
+	unsigned int Texture;
+	unsigned int DoneFrame;
+};
+
+static const float FieldOfView = 0.785398f;
+static const float ViewportHeight = 720.0f;
+
+static int failures = 0;
+
+static void Check(bool condition, unsigned int frame, const char* what)
+{
+	if (condition)
+		return;
+	if (failures < 20)
+		printf("  FAILED at frame %u: %s\n", frame, what);
+	failures++;
+}
+
+// The simulated frame loop, shared by every phase
+class Simulation
+{
+	public:
+		Simulation(TextureResidency& _residency, std::vector<SimObject>& _objects, std::vector<unsigned int>& _sizes, unsigned int _latency)
+			: residency(_residency), objects(_objects), sizes(_sizes), latency(_latency), frame(0), baseBytes(_residency.GetResidentBytes())
+		{
+		}
+
+		void Step(float cameraX, float cameraZ)
+		{
+			frame++;
+			residency.BeginFrame();
+			for (const SimObject& object : objects)
+			{
+				float dx = object.X - cameraX;
+				float dz = object.Z - cameraZ;
+				float distance = (std::max)(0.1f, sqrtf(dx * dx + dz * dz) - object.Radius);
+
+				// Only what's in front of the camera (looking down +Z) is seen
+				if (dz + object.Radius < 0.0f)
+					continue;
+
+				float area = TextureResidency::ComputeScreenArea(object.Radius, distance, FieldOfView, ViewportHeight);
+				for (unsigned int texture : object.Textures)
+				{
+					float mip = TextureResidency::ComputeDesiredMip(sizes[texture], object.UvDensity, 1.0f, distance, FieldOfView, ViewportHeight);
+					residency.Request(texture, mip, area);
+				}
+			}
+
+			// Uploads land a few frames after they're asked for
+			while (!inFlight.empty() && inFlight.front().DoneFrame <= frame)
+			{
+				residency.CompleteLoad(inFlight.front().Texture, true);
+				inFlight.pop_front();
+			}
+
+			residency.Update(loads, evictions);
+			for (const ResidencyChange& load : loads)
+				inFlight.push_back({ load.Texture, frame + latency });
+
+			CheckInvariants();
+		}
+
+		void Drain()
+		{
+			while (!inFlight.empty())
+			{
+				residency.CompleteLoad(inFlight.front().Texture, true);
+				inFlight.pop_front();
+			}
+		}
+
+		unsigned int GetFrame() { return frame; }
+
+	private:
+		void CheckInvariants()
+		{
+			size_t resident = residency.GetResidentBytes();
+			if (baseBytes <= residency.GetBudget())
+				Check(resident <= residency.GetBudget(), frame, "resident bytes over budget");
+
+			size_t counted = 0;
+			for (unsigned int t = 0; t < residency.GetTextureCount(); t++)
+			{
+				unsigned int first = residency.GetResidentMip(t) - (residency.IsLoading(t) ? 1 : 0);
+				for (unsigned int mip = first; mip < residency.GetMipCount(t); mip++)
+					counted += TextureResidency::GetMipBytes(sizes[t], sizes[t], mip, 4);
+				Check(residency.GetResidentMip(t) <= residency.GetBaseMip(t), frame, "base mips evicted");
+			}
+			Check(counted == resident, frame, "resident bytes don't match resident mips");
+
+			for (const ResidencyChange& load : loads)
+			{
+				bool evicted = std::any_of(evictions.begin(), evictions.end(), [&](const ResidencyChange& e) { return e.Texture == load.Texture; });
+				Check(!evicted, frame, "texture loaded and evicted in the same update");
+			}
+		}
+
+		TextureResidency& residency;
+		std::vector<SimObject>& objects;
+		std::vector<unsigned int>& sizes;
+		unsigned int latency;
+		unsigned int frame;
+		size_t baseBytes;
+
+		std::deque<InFlight> inFlight;
+		std::vector<ResidencyChange> loads;
+		std::vector<ResidencyChange> evictions;
+};
+
+static void PrintStats(const char* phase, TextureResidency& residency)
+{
+	ResidencyStats stats = residency.GetStats();
+	printf("%-22s resident %7.1f / %7.1f MB  wanted %7.1f MB  satisfied %3u / %3u  loads %5u  evictions %5u  denied %5u\n",
+		phase, stats.ResidentBytes / 1048576.0, stats.BudgetBytes / 1048576.0, stats.WantedBytes / 1048576.0,
+		stats.SatisfiedTextures, stats.Textures, stats.LoadsIssued, stats.Evictions, stats.LoadsDenied);
+}
+
+int main(int argc, char** argv)
+{
+	double budgetMB = 48.0;
+	unsigned int frames = 2000;
+	unsigned int latency = 3;
+	unsigned int seed = 1;
+	bool verbose = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "-budget" && hasValue) budgetMB = (std::max)(1.0, atof(argv[++i]));
+		else if (arg == "-frames" && hasValue) frames = (unsigned int)(std::max)(10, atoi(argv[++i]));
+		else if (arg == "-latency" && hasValue) latency = (unsigned int)(std::max)(0, atoi(argv[++i]));
+		else if (arg == "-seed" && hasValue) seed = (unsigned int)strtoul(argv[++i], 0, 10);
+		else if (arg == "-verbose") verbose = true;
+		else
+		{
+			fprintf(stderr, "Usage: StreamingSim [-budget MB] [-frames n] [-latency frames] [-seed n] [-verbose]\n");
+			return 1;
+		}
+	}
+
+	// Texture sets like the PBR materials (albedo, normal, ORM), at a mix of sizes
+	std::mt19937 random(seed);
+	std::vector<unsigned int> sizes;
+	const unsigned int setCount = 24;
+	for (unsigned int set = 0; set < setCount; set++)
+	{
+		unsigned int size = 256u << (random() % 4);
+		for (int map = 0; map < 3; map++)
+			sizes.push_back(size);
+	}
+
+	TextureResidency residency((size_t)(budgetMB * 1048576.0));
+	for (unsigned int size : sizes)
+		residency.Add(size, size);
+
+	// Two rows of objects along the flight path
+	std::vector<SimObject> objects;
+	std::uniform_real_distribution<float> radius(0.5f, 3.0f);
+	for (unsigned int i = 0; i < 120; i++)
+	{
+		SimObject object;
+		object.X = (i % 2 == 0) ? -6.0f : 6.0f;
+		object.Z = i * 5.0f;
+		object.Radius = radius(random);
+		object.UvDensity = 1.0f / object.Radius;
+		unsigned int set = random() % setCount;
+		object.Textures = { set * 3, set * 3 + 1, set * 3 + 2 };
+		objects.push_back(object);
+	}
+
+	Simulation simulation(residency, objects, sizes, latency);
+	printf("%u textures, %zu objects, %.1f MB budget, %u frame load latency\n", residency.GetTextureCount(), objects.size(), budgetMB, latency);
+	PrintStats("Startup (base mips)", residency);
+
+	// Fly down the rows and back
+	float length = objects.back().Z;
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		float t = (float)f / frames;
+		float z = (t < 0.5f ? t * 2.0f : (1.0f - t) * 2.0f) * length - 10.0f;
+		simulation.Step(0.0f, z);
+		if (verbose && f % 100 == 0)
+		{
+			char label[32];
+			snprintf(label, sizeof(label), "Frame %u", f);
+			PrintStats(label, residency);
+		}
+	}
+	PrintStats("Flythrough", residency);
+
+	// Stand still with plenty of room: everything visible gets what it wants
+	residency.SetBudget((size_t)4096 * 1048576);
+	for (unsigned int f = 0; f < 200; f++)
+		simulation.Step(0.0f, length * 0.5f);
+	simulation.Drain();
+	simulation.Step(0.0f, length * 0.5f);
+	ResidencyStats roomy = residency.GetStats();
+	Check(roomy.SatisfiedTextures == roomy.Textures, simulation.GetFrame(), "textures still short of their mips with room to spare");
+	PrintStats("Still, large budget", residency);
+
+	// Whatever covers the most screen should be the first served
+	float bestArea = -1.0f;
+	const SimObject* biggest = 0;
+	for (const SimObject& object : objects)
+	{
+		float dx = object.X;
+		float dz = object.Z - length * 0.5f;
+		if (dz + object.Radius < 0.0f)
+			continue;
+		float distance = (std::max)(0.1f, sqrtf(dx * dx + dz * dz) - object.Radius);
+		float area = TextureResidency::ComputeScreenArea(object.Radius, distance, FieldOfView, ViewportHeight);
+		if (area > bestArea)
+		{
+			bestArea = area;
+			biggest = &object;
+		}
+	}
+	size_t biggestBytes = 0;
+	for (unsigned int texture : biggest->Textures)
+	{
+		for (unsigned int mip = residency.GetDesiredMip(texture); mip < residency.GetBaseMip(texture); mip++)
+			biggestBytes += TextureResidency::GetMipBytes(sizes[texture], sizes[texture], mip, 4);
+	}
+
+	// Shrink the budget to a quarter of what's streamed in (but still
+	// room for the biggest object): it has to be met on the next update
+	size_t baseBytes = 0;
+	for (unsigned int t = 0; t < residency.GetTextureCount(); t++)
+	{
+		for (unsigned int mip = residency.GetBaseMip(t); mip < residency.GetMipCount(t); mip++)
+			baseBytes += TextureResidency::GetMipBytes(sizes[t], sizes[t], mip, 4);
+	}
+	size_t tightBudget = baseBytes + (std::max)((residency.GetResidentBytes() - baseBytes) / 4, biggestBytes);
+	residency.SetBudget(tightBudget);
+	simulation.Step(0.0f, length * 0.5f);
+	Check(residency.GetResidentBytes() <= tightBudget, simulation.GetFrame(), "shrunk budget not met after one update");
+	for (unsigned int f = 0; f < 200; f++)
+		simulation.Step(0.0f, length * 0.5f);
+	simulation.Drain();
+	simulation.Step(0.0f, length * 0.5f);
+	PrintStats("Still, quarter budget", residency);
+
+	for (unsigned int texture : biggest->Textures)
+		Check(residency.GetResidentMip(texture) <= residency.GetDesiredMip(texture), simulation.GetFrame(), "largest object's textures not served under a tight budget");
+
+	if (failures > 0)
+	{
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,274 @@
+// --------------------------------------------------------
+// Offline texture cooker: PNG in, BC compressed DDS (with a
+// full mip chain) out, plus a throughput and quality report.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -pthread -I../.. -o TextureCooker Main.cpp ../../TextureCooker.cpp
+//      ../../BlockCompression.cpp ../../PngReader.cpp ../../JobQueue.cpp ../../ChannelPacker.cpp
+//      ../../MipGenerator.cpp ../../CpuUtilities.cpp
+//
+// Usage:
+//
+//  TextureCooker [options] <.png files or folders>
+//
+//  -out <folder>     Where the .dds files go (default: next to each source)
+//  -threads <n>      Encoder threads (default: one per hardware thread)
+//  -albedo <format>  bc7 (default) or bc1 for albedo maps
+//  -nomips           Only encode the top level
+//  -orm              Pack each material's roughness, metalness and AO
+//                    maps into one <material>_orm.dds (BC7)
+//  -kaiser           Filter mips with a Kaiser window instead of a box
+//  -report <file>    Also write the report as JSON
+//  -mipbench         Don't cook; time mip generation (box and Kaiser,
+//                    scalar and AVX2, 1 to -threads threads) instead
+//
+// Each file's role (and format) comes from its name: *_normals
+// is BC5, *_roughness, *_metal and *_ao are BC4, anything else
+// is albedo. A material is everything before the last '_'.
+// --------------------------------------------------------
+
+#include "TextureCooker.h"
+#include "ChannelPacker.h"
+#include "CpuUtilities.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+
+// The single-channel maps of one material
+struct OrmSources
+{
+	std::filesystem::path Folder;
+	std::filesystem::path Paths[3];	// Occlusion, roughness, metalness
+};
+
+// Packs and cooks one material's ORM texture
+static bool CookOrm(TextureCooker& cooker, const std::string& set, const OrmSources& sources, const std::string& outputFolder,
+	bool generateMips, CookReport& report, PackingReport& packing, std::string* error)
+{
+	// Missing maps get what the shader would otherwise have used:
+	// no occlusion, half rough, not metal
+	static const unsigned char defaults[3] = { 255, 128, 0 };
+
+	CpuImage images[3];
+	ChannelSource channels[4];
+	packing.Set = set;
+	for (int i = 0; i < 3; i++)
+	{
+		channels[i].Constant = defaults[i];
+		if (sources.Paths[i].empty())
+			continue;
+		if (!PngReader::Load(sources.Paths[i].string(), images[i], error))
+			return false;
+
+		channels[i].Image = &images[i];
+		packing.SeparateMaps++;
+		packing.SeparateRgba8Bytes += TextureCooker::GetRgba8ChainBytes(images[i].Width, images[i].Height, generateMips);
+		packing.SeparateCookedBytes += TextureCooker::GetChainBytes(images[i].Width, images[i].Height, BlockFormat::BC4, generateMips);
+	}
+
+	CpuImage packed;
+	ChannelPacker::Pack(channels, packed);
+
+	CookedTexture texture;
+	report.Name = set + "_orm";
+	cooker.Cook(packed, TextureRole::Packed, TextureCooker::GetDefaultFormat(TextureRole::Packed), generateMips, texture, report);
+
+	packing.PackedRgba8Bytes = TextureCooker::GetRgba8ChainBytes(packed.Width, packed.Height, generateMips);
+	packing.PackedCookedBytes = report.CookedBytes;
+	packing.Psnr = report.Psnr;
+
+	std::filesystem::path output = outputFolder.empty() ? sources.Folder : std::filesystem::path(outputFolder);
+	output /= set + "_orm.dds";
+	if (!TextureCooker::WriteDds(output.string(), texture))
+	{
+		if (error)
+			*error = "Unable to write '" + output.string() + "'";
+		return false;
+	}
+	return true;
+}
+
+// Times MipGenerator on the sources, each filtered for its role
+static int RunMipBenchmark(const std::vector<std::filesystem::path>& sources, unsigned int maxThreads, const std::string& reportPath)
+{
+	std::vector<CpuImage> images;
+	std::vector<MipContent> contents;
+	for (const std::filesystem::path& source : sources)
+	{
+		CpuImage image;
+		std::string error;
+		if (!PngReader::Load(source.string(), image, &error))
+		{
+			fprintf(stderr, "%s: %s\n", source.string().c_str(), error.c_str());
+			return 1;
+		}
+		images.push_back(std::move(image));
+		contents.push_back(TextureCooker::GetMipContent(TextureCooker::GuessRole(source.string())));
+	}
+
+	// 1, 2, 4... threads, up to (and including) the most asked for
+	if (maxThreads == 0)
+		maxThreads = (std::max)(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	const unsigned int repeats = 3;
+	printf("AVX2 %s\n", CpuUtilities::HasAvx2() ? "available" : "not available, scalar only");
+	std::vector<MipBenchmarkResult> results = MipGenerator::RunBenchmark(images, contents, threadCounts, repeats);
+	printf("%s", MipGenerator::FormatBenchmark(results, images.size(), repeats).c_str());
+
+	if (!reportPath.empty() && !MipGenerator::WriteBenchmarkJson(reportPath, results, images.size(), repeats))
+	{
+		fprintf(stderr, "Unable to write report to '%s'\n", reportPath.c_str());
+		return 1;
+	}
+
+	for (const MipBenchmarkResult& result : results)
+	{
+		if (!result.MatchesScalar)
+			return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	std::string outputFolder;
+	std::string reportPath;
+	unsigned int threadCount = 0;
+	BlockFormat albedoFormat = BlockFormat::BC7;
+	bool generateMips = true;
+	bool packOrm = false;
+	bool mipBenchmark = false;
+	MipFilter mipFilter = MipFilter::Box;
+	std::vector<std::filesystem::path> sources;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "-out" && hasValue) outputFolder = argv[++i];
+		else if (arg == "-threads" && hasValue) threadCount = (unsigned int)(std::max)(0, atoi(argv[++i]));
+		else if (arg == "-report" && hasValue) reportPath = argv[++i];
+		else if (arg == "-nomips") generateMips = false;
+		else if (arg == "-orm") packOrm = true;
+		else if (arg == "-kaiser") mipFilter = MipFilter::Kaiser;
+		else if (arg == "-mipbench") mipBenchmark = true;
+		else if (arg == "-albedo" && hasValue)
+		{
+			if (!TextureCooker::ParseFormat(argv[++i], albedoFormat))
+			{
+				fprintf(stderr, "Unknown format '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (std::filesystem::is_directory(arg))
+		{
+			for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(arg))
+				if (entry.path().extension() == ".png")
+					sources.push_back(entry.path());
+		}
+		else
+		{
+			sources.push_back(arg);
+		}
+	}
+
+	if (sources.empty())
+	{
+		fprintf(stderr, "Usage: TextureCooker [-out folder] [-threads n] [-albedo bc1|bc7] [-nomips] [-orm] [-kaiser] [-mipbench] [-report file.json] <.png files or folders>\n");
+		return 1;
+	}
+	std::sort(sources.begin(), sources.end());
+
+	if (mipBenchmark)
+		return RunMipBenchmark(sources, threadCount, reportPath);
+
+	if (!outputFolder.empty())
+		std::filesystem::create_directories(outputFolder);
+
+	TextureCooker cooker(threadCount);
+	cooker.SetMipFilter(mipFilter);
+
+	// Pull out the maps that get packed, grouped by material
+	std::map<std::string, OrmSources> ormSets;
+	if (packOrm)
+	{
+		std::vector<std::filesystem::path> remaining;
+		for (const std::filesystem::path& source : sources)
+		{
+			TextureRole role = TextureCooker::GuessRole(source.string());
+			int slot = role == TextureRole::Occlusion ? 0 : role == TextureRole::Roughness ? 1 : role == TextureRole::Metalness ? 2 : -1;
+			std::string stem = source.stem().string();
+			size_t split = stem.rfind('_');
+			if (slot < 0 || split == std::string::npos)
+			{
+				remaining.push_back(source);
+				continue;
+			}
+
+			OrmSources& set = ormSets[stem.substr(0, split)];
+			set.Folder = source.parent_path();
+			set.Paths[slot] = source;
+		}
+		sources.swap(remaining);
+	}
+	printf("Cooking %zu textures on %u threads\n", sources.size() + ormSets.size(), cooker.GetThreadCount());
+
+	int failures = 0;
+	std::vector<CookReport> reports;
+	std::vector<PackingReport> packingReports;
+	for (const std::pair<const std::string, OrmSources>& set : ormSets)
+	{
+		CookReport report;
+		PackingReport packing;
+		std::string error;
+		if (!CookOrm(cooker, set.first, set.second, outputFolder, generateMips, report, packing, &error))
+		{
+			fprintf(stderr, "%s: %s\n", set.first.c_str(), error.c_str());
+			failures++;
+			continue;
+		}
+		reports.push_back(report);
+		packingReports.push_back(packing);
+	}
+
+	for (const std::filesystem::path& source : sources)
+	{
+		std::filesystem::path output = outputFolder.empty() ? source.parent_path() : std::filesystem::path(outputFolder);
+		output /= source.stem();
+		output += ".dds";
+
+		TextureRole role = TextureCooker::GuessRole(source.string());
+		BlockFormat format = role == TextureRole::Albedo ? albedoFormat : TextureCooker::GetDefaultFormat(role);
+
+		CookReport report;
+		std::string error;
+		if (!cooker.CookFile(source.string(), output.string(), role, format, generateMips, report, &error))
+		{
+			fprintf(stderr, "%s: %s\n", source.string().c_str(), error.c_str());
+			failures++;
+			continue;
+		}
+		reports.push_back(report);
+	}
+
+	printf("%s", TextureCooker::FormatReport(reports).c_str());
+	if (!packingReports.empty())
+		printf("\nORM packing\n%s", TextureCooker::FormatPackingReport(packingReports).c_str());
+
+	if (!reportPath.empty() && !TextureCooker::WriteReportJson(reportPath, reports, cooker.GetThreadCount()))
+	{
+		fprintf(stderr, "Unable to write report to '%s'\n", reportPath.c_str());
+		failures++;
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,288 @@
+// --------------------------------------------------------
+// Validation and timing for VertexPacking: the AVX2 and
+// scalar encoders, the error of each packed attribute, the
+// tangents' handedness and what a model saves.
+//
+// Builds without Visual Studio or D3D, ex. on Linux:
+//
+//  g++ -std=c++17 -O2 -I../.. -o VertexPacking Main.cpp ../../VertexPacking.cpp ../../CpuUtilities.cpp
+//
+// Usage:
+//
+//  VertexPacking [-vertices <n>] [-runs <n>] [-seed <n>]
+//
+// Exits with 1 if any check fails:
+//  - AVX2 packs random vertices, and a sweep of every float
+//    exponent as UVs (specials included), to the same bits
+//    as the scalar encoder
+//  - Positions are within half a step of the mesh's box and
+//    UVs within half a half float step
+//  - Octahedral directions round trip to within 0.005 degrees
+//    all around the sphere, and zero or NaN becomes +Z
+//  - An unmirrored quad keeps cross(T, N) as its bitangent and
+//    a mirrored one flips it, both along -dP/dv
+//  - Split position and attribute streams hold the same bytes
+//    as the interleaved vertices
+// --------------------------------------------------------
+
+#include "VertexPacking.h"
+#include "CpuUtilities.h"
+#include "../Common/TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static void RandomDirection(std::mt19937& random, float direction[3])
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float z = unit(random) * 2.0f - 1.0f;
+	float angle = unit(random) * 6.2831853f;
+	float r = sqrtf((std::max)(0.0f, 1.0f - z * z));
+	direction[0] = r * cosf(angle);
+	direction[1] = r * sinf(angle);
+	direction[2] = z;
+}
+
+// Tangents the way Mesh::CalculateTangents() finds them, unnormalized
+// (the encoder only cares about the direction)
+static void AddTangents(std::vector<SourceVertex>& vertices, const std::vector<unsigned int>& indices)
+{
+	for (SourceVertex& vertex : vertices)
+		vertex.Tangent[0] = vertex.Tangent[1] = vertex.Tangent[2] = 0.0f;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		SourceVertex& v1 = vertices[indices[i]];
+		SourceVertex& v2 = vertices[indices[i + 1]];
+		SourceVertex& v3 = vertices[indices[i + 2]];
+		float s1 = v2.UV[0] - v1.UV[0], t1 = v2.UV[1] - v1.UV[1];
+		float s2 = v3.UV[0] - v1.UV[0], t2 = v3.UV[1] - v1.UV[1];
+		float r = 1.0f / (s1 * t2 - s2 * t1);
+		for (int c = 0; c < 3; c++)
+		{
+			float tangent = (t2 * (v2.Position[c] - v1.Position[c]) - t1 * (v3.Position[c] - v1.Position[c])) * r;
+			v1.Tangent[c] += tangent;
+			v2.Tangent[c] += tangent;
+			v3.Tangent[c] += tangent;
+		}
+	}
+}
+
+// A quad in the XY plane facing -Z (toward a default camera), wound
+// clockwise like the OBJ loader's output, with D3D UVs (v grows down)
+static void MakeQuad(bool mirrored, std::vector<SourceVertex>& vertices, std::vector<unsigned int>& indices)
+{
+	const float corners[4][4] = { { -1, 1, 0, 0 }, { 1, 1, 1, 0 }, { 1, -1, 1, 1 }, { -1, -1, 0, 1 } };
+	vertices.assign(4, SourceVertex());
+	for (int i = 0; i < 4; i++)
+	{
+		SourceVertex& vertex = vertices[i];
+		vertex.Position[0] = corners[i][0];
+		vertex.Position[1] = corners[i][1];
+		vertex.Position[2] = 0.0f;
+		vertex.Normal[0] = 0.0f;
+		vertex.Normal[1] = 0.0f;
+		vertex.Normal[2] = -1.0f;
+		vertex.UV[0] = mirrored ? 1.0f - corners[i][2] : corners[i][2];
+		vertex.UV[1] = corners[i][3];
+	}
+	indices = { 0, 1, 2, 0, 2, 3 };
+	AddTangents(vertices, indices);
+}
+
+// Whether the shader's bitangent, cross(T, N) * handedness, points along -dP/dv
+static bool BitangentFollowsUvs(bool mirrored)
+{
+	std::vector<SourceVertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeQuad(mirrored, vertices, indices);
+	std::vector<PackedVertex> packed(vertices.size());
+	PositionDecode decode = VertexPacking::Encode(vertices.data(), vertices.size(), indices.data(), indices.size(), packed.data());
+
+	// Corner 3 is straight below corner 0, one UV down
+	float dPdv[3];
+	for (int c = 0; c < 3; c++)
+		dPdv[c] = vertices[3].Position[c] - vertices[0].Position[c];
+
+	bool follows = true;
+	for (const PackedVertex& vertex : packed)
+	{
+		SourceVertex decoded;
+		float handedness;
+		VertexPacking::Decode(vertex, decode, decoded, handedness);
+		const float* t = decoded.Tangent;
+		const float* n = decoded.Normal;
+		float b[3] = { (t[1] * n[2] - t[2] * n[1]) * handedness, (t[2] * n[0] - t[0] * n[2]) * handedness, (t[0] * n[1] - t[1] * n[0]) * handedness };
+		follows = follows && -(b[0] * dPdv[0] + b[1] * dPdv[1] + b[2] * dPdv[2]) > 0.99f;
+	}
+	return follows;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int vertexCount = 1000000;
+	unsigned int runs = 10;
+	unsigned int seed = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-vertices" && i + 1 < argc) vertexCount = (std::max)(3, atoi(argv[++i]));
+		else if (arg == "-runs" && i + 1 < argc) runs = (std::max)(1, atoi(argv[++i]));
+		else if (arg == "-seed" && i + 1 < argc) seed = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "Usage: VertexPacking [-vertices n] [-runs n] [-seed n]\n");
+			return 1;
+		}
+	}
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// Random triangles in an off-center box, with mirrored UVs now and then
+	// and some broken tangents (no UV area) mixed in
+	std::vector<SourceVertex> vertices(vertexCount - vertexCount % 3);
+	std::vector<unsigned int> indices(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		SourceVertex& vertex = vertices[i];
+		vertex.Position[0] = 100.0f + unit(random) * 3.0f;
+		vertex.Position[1] = -5.0f + unit(random) * 10.0f;
+		vertex.Position[2] = unit(random) * 0.5f;
+		RandomDirection(random, vertex.Normal);
+		vertex.UV[0] = unit(random) * 8.0f - 2.0f;
+		vertex.UV[1] = unit(random);
+		indices[i] = (unsigned int)i;
+	}
+	AddTangents(vertices, indices);
+	for (size_t i = 0; i < vertices.size(); i += 1001)
+		vertices[i].Tangent[0] = vertices[i].Tangent[1] = vertices[i].Tangent[2] = i % 2 ? 0.0f : NAN;
+
+	// --- Encoders ---
+	printf("Encoders (%zu vertices)\n", vertices.size());
+	std::vector<PackedVertex> scalar(vertices.size());
+	std::vector<PackedVertex> simd(vertices.size());
+	PositionDecode decode = VertexPacking::Encode(vertices.data(), vertices.size(), indices.data(), indices.size(), scalar.data(), false);
+	VertexPacking::Encode(vertices.data(), vertices.size(), indices.data(), indices.size(), simd.data(), true);
+	Check(memcmp(scalar.data(), simd.data(), sizeof(PackedVertex) * scalar.size()) == 0, "AVX2 packs random vertices to the same bits", CpuUtilities::HasAvx2() ? 1.0 : 0.0);
+
+	// Every 4099th bit pattern: all exponents, subnormal halves, overflow, infinity and NaN
+	std::vector<SourceVertex> sweep;
+	for (unsigned long long bits = 0; bits < 0x100000000ull; bits += 4099)
+	{
+		SourceVertex vertex = {};
+		unsigned int pattern = (unsigned int)bits;
+		memcpy(&vertex.UV[0], &pattern, sizeof(float));
+		pattern ^= 0x80001000;
+		memcpy(&vertex.UV[1], &pattern, sizeof(float));
+		vertex.Normal[2] = 1.0f;
+		sweep.push_back(vertex);
+	}
+	const float specials[] = { 65504.0f, 65519.0f, 65520.0f, 1e9f, INFINITY, -INFINITY, NAN, 6.103515625e-05f, 6.1e-05f, 5.96e-08f, 2.98023224e-08f, 1.0f + 1.0f / 2048, 1.0f + 3.0f / 2048 };
+	for (float special : specials)
+	{
+		SourceVertex vertex = {};
+		vertex.UV[0] = special;
+		vertex.UV[1] = -special;
+		sweep.push_back(vertex);
+	}
+	std::vector<PackedVertex> sweepScalar(sweep.size());
+	std::vector<PackedVertex> sweepSimd(sweep.size());
+	VertexPacking::Encode(sweep.data(), sweep.size(), 0, 0, sweepScalar.data(), false);
+	VertexPacking::Encode(sweep.data(), sweep.size(), 0, 0, sweepSimd.data(), true);
+	Check(memcmp(sweepScalar.data(), sweepSimd.data(), sizeof(PackedVertex) * sweep.size()) == 0, "AVX2 packs a sweep of float bit patterns to the same halves", (double)sweep.size());
+
+	// --- Errors ---
+	printf("Errors\n");
+	VertexPackingError error = VertexPacking::Measure(vertices.data(), scalar.data(), vertices.size(), decode);
+	Check(error.MaxPosition <= error.PositionBound, "Position error (model units), within half a step", error.MaxPosition);
+	Check(error.MaxUv <= error.UvBound, "UV error, within half a half float step", error.MaxUv);
+	Check(error.MaxNormalDegrees < 0.005f, "Normal error (degrees)", error.MaxNormalDegrees);
+	Check(error.MaxTangentDegrees < 0.005f, "Tangent error (degrees)", error.MaxTangentDegrees);
+	Check(error.Mirrored > vertices.size() / 3 && error.Mirrored < vertices.size() * 2 / 3, "Random UVs: mirrored fraction", (double)error.Mirrored / vertices.size());
+
+	double worstDegrees = 0.0;
+	for (int i = 0; i < 1000000; i++)
+	{
+		float direction[3];
+		float decoded[3];
+		short encoded[2];
+		RandomDirection(random, direction);
+		VertexPacking::EncodeOctahedral(direction, encoded);
+		VertexPacking::DecodeOctahedral(encoded, decoded);
+		double cross[3] = {
+			(double)direction[1] * decoded[2] - (double)direction[2] * decoded[1],
+			(double)direction[2] * decoded[0] - (double)direction[0] * decoded[2],
+			(double)direction[0] * decoded[1] - (double)direction[1] * decoded[0] };
+		double dot = (double)direction[0] * decoded[0] + (double)direction[1] * decoded[1] + (double)direction[2] * decoded[2];
+		double sine = sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+		worstDegrees = (std::max)(worstDegrees, atan2(sine, dot) * 57.295779513);
+	}
+	Check(worstDegrees < 0.005, "Octahedral round trip, 1M directions (worst degrees)", worstDegrees);
+
+	bool axesExact = true;
+	const float axes[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	for (const float* axis : axes)
+	{
+		float decoded[3];
+		short encoded[2];
+		VertexPacking::EncodeOctahedral(axis, encoded);
+		VertexPacking::DecodeOctahedral(encoded, decoded);
+		axesExact = axesExact && decoded[0] == axis[0] && decoded[1] == axis[1] && decoded[2] == axis[2];
+	}
+	Check(axesExact, "The six axes round trip exactly", axesExact ? 1.0 : 0.0);
+
+	const float zero[3] = { 0, 0, 0 };
+	const float nan[3] = { NAN, NAN, NAN };
+	short zeroEncoded[2], nanEncoded[2];
+	VertexPacking::EncodeOctahedral(zero, zeroEncoded);
+	VertexPacking::EncodeOctahedral(nan, nanEncoded);
+	Check(zeroEncoded[0] == 0 && zeroEncoded[1] == 0 && nanEncoded[0] == 0 && nanEncoded[1] == 0, "Zero and NaN directions become +Z", 0.0);
+
+	// --- Handedness ---
+	printf("Handedness\n");
+	Check(BitangentFollowsUvs(false), "Unmirrored quad: cross(T, N) runs along -dP/dv", 1.0);
+	Check(BitangentFollowsUvs(true), "Mirrored quad: flipped, it still does", -1.0);
+
+	// --- Streams ---
+	printf("Streams\n");
+	std::vector<PackedPosition> positions(scalar.size());
+	std::vector<PackedAttributes> attributes(scalar.size());
+	VertexPacking::SplitStreams(scalar.data(), scalar.size(), positions.data(), attributes.data());
+	bool streamsMatch = true;
+	for (size_t i = 0; i < scalar.size(); i++)
+		streamsMatch = streamsMatch &&
+			memcmp(positions[i].Position, scalar[i].Position, sizeof(PackedPosition)) == 0 &&
+			memcmp(attributes[i].Normal, scalar[i].Normal, sizeof(attributes[i].Normal)) == 0 &&
+			memcmp(attributes[i].Tangent, scalar[i].Tangent, sizeof(attributes[i].Tangent)) == 0 &&
+			memcmp(attributes[i].UV, scalar[i].UV, sizeof(attributes[i].UV)) == 0;
+	Check(streamsMatch, "Position and attribute streams hold the packed vertices", (double)sizeof(PackedPosition));
+
+	// --- Size ---
+	size_t sourceBytes = sizeof(SourceVertex) * vertices.size();
+	size_t packedBytes = sizeof(PackedVertex) * vertices.size();
+	printf("\nSize: %zu -> %zu bytes a vertex, %.1f -> %.1f MB (%.0f%% of the vertex fetch bandwidth)\n",
+		sizeof(SourceVertex), sizeof(PackedVertex), sourceBytes / 1048576.0, packedBytes / 1048576.0, 100.0 * packedBytes / sourceBytes);
+	printf("Depth-only passes: %zu bytes a vertex from the position stream (%.0f%% of unpacked vertices)\n",
+		sizeof(PackedPosition), 100.0 * sizeof(PackedPosition) / sizeof(SourceVertex));
+
+	// --- Timings ---
+	printf("\nTimings (average of %u runs, %zu vertices)\n", runs, vertices.size());
+	double encodeMs[2] = {};
+	for (int useSimd = 0; useSimd < 2; useSimd++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int run = 0; run < runs; run++)
+			VertexPacking::Encode(vertices.data(), vertices.size(), indices.data(), indices.size(), simd.data(), useSimd == 1);
+		encodeMs[useSimd] = MillisecondsSince(start) / runs;
+	}
+	printf("  Encode scalar:    %8.3f ms\n", encodeMs[0]);
+	printf("  Encode %s:      %8.3f ms (%.2fx)\n", CpuUtilities::HasAvx2() ? "AVX2" : "----", encodeMs[1], encodeMs[0] / encodeMs[1]);
+
+	return FinishChecks();
+}
@@ -1,4 +1,5 @@
 #include "Transform.h"
+#include <algorithm>
 
 // Reduces code, and allows for operator overloads
 using namespace DirectX;
@@ -8,6 +9,8 @@ using namespace DirectX;
 /// </summary>
 Transform::Transform()
 {
+	parent = nullptr;
+
 	// Set up our initial values
 	SetPosition(0, 0, 0);
 	SetRotation(0, 0, 0);
@@ -21,6 +24,49 @@ Transform::Transform()
 	matrixDirty = false;
 }
 
+/// <summary>
+/// Copy constructor. Takes the other transform's position, rotation and
+/// scale, but not its parent or children: the copy starts as a root.
+/// </summary>
+Transform::Transform(const Transform& other)
+{
+	parent = nullptr;
+	*this = other;
+}
+
+/// <summary>
+/// Takes the other transform's position, rotation and scale. This
+/// transform keeps its own parent and children, which move with it.
+/// </summary>
+Transform& Transform::operator=(const Transform& other)
+{
+	if (this == &other)
+		return *this;
+
+	position = other.position;
+	pitchYawRoll = other.pitchYawRoll;
+	scale = other.scale;
+	right = other.right;
+	up = other.up;
+	forward = other.forward;
+
+	MarkDirty();
+	return *this;
+}
+
+/// <summary>
+/// Destructor. Detaches from the hierarchy so nothing points at a dead transform.
+/// </summary>
+Transform::~Transform()
+{
+	SetParent(nullptr);
+	for (Transform* child : children)
+	{
+		child->parent = nullptr;
+		child->MarkDirty();
+	}
+}
+
 /// <summary>
 /// Moves the object along the world X Y Z
 /// </summary>
@@ -32,7 +78,7 @@ void Transform::MoveAbsolute(float x, float y, float z)
 	XMStoreFloat3(&position, pos + offset);
 
 	// Updated matrix dirty
-	matrixDirty = true;
+	MarkDirty();
 }
 
 /// <summary>
@@ -51,7 +97,7 @@ void Transform::MoveRelative(float x, float y, float z)
 	XMStoreFloat3(&position, newPos);
 
 	// Updated matrix dirty
-	matrixDirty = true;
+	MarkDirty();
 }
 
 /// <summary>
@@ -68,7 +114,7 @@ void Transform::Rotate(float p, float y, float r)
 	UpdateDirections();
 
 	// Updated matrix dirty
-	matrixDirty = true;
+	MarkDirty();
 }
 
 /// <summary>
@@ -82,7 +128,7 @@ void Transform::Scale(float x, float y, float z)
 	XMStoreFloat3(&scale, XMVectorMultiply(scl, change));
 
 	// Updated matrix dirty
-	matrixDirty = true;
+	MarkDirty();
 }
 
 /// <summary>
@@ -93,7 +139,7 @@ void Transform::SetPosition(float x, float y, float z)
 	position = XMFLOAT3(x, y, z);
 
 	// Updated matrix dirty
-	matrixDirty = true;
+	MarkDirty();
 }
 
 /// <summary>
@@ -107,7 +153,7 @@ void Transform::SetRotation(float p, float y, float r)
 	UpdateDirections();
 
 	// Updated matrix dirty
-	matrixDirty = true;
+	MarkDirty();
 }
 
 /// <summary>
@@ -118,7 +164,7 @@ void Transform::SetScale(float x, float y, float z)
 	scale = XMFLOAT3(x, y, z);
 
 	// Updated matrix dirty
-	matrixDirty = true;
+	MarkDirty();
 }
 
 // Transform Component Getters
@@ -180,9 +226,59 @@ void Transform::CreateWorldMatrices()
 
 	// Combine transformations matrices and store result
 	XMMATRIX worldMat = scaleMatrix * rotationMatrix * translationMatrix;
+	if (parent)
+	{
+		XMFLOAT4X4 parentWorld = parent->GetWorldMatrix();
+		worldMat = worldMat * XMLoadFloat4x4(&parentWorld);
+	}
 	XMStoreFloat4x4(&worldMatrix, worldMat);
 	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixInverse(0, XMMatrixTranspose(worldMat)));
 
 	// Mark matrix as clean
 	matrixDirty = false;
 }
+
+/// <summary>
+/// Attaches this transform to a parent so it moves with it. Positions,
+/// rotations and scales become relative to the parent.
+/// </summary>
+/// <param name="_parent">The new parent, or nullptr to detach</param>
+void Transform::SetParent(Transform* _parent)
+{
+	// Refuse to create a cycle
+	for (Transform* t = _parent; t != nullptr; t = t->parent)
+		if (t == this) return;
+
+	if (parent)
+		parent->children.erase(std::remove(parent->children.begin(), parent->children.end(), this), parent->children.end());
+
+	parent = _parent;
+	if (parent)
+		parent->children.push_back(this);
+
+	MarkDirty();
+}
+
+// Hierarchy Getters
+Transform* Transform::GetParent() { return parent; }
+
+/// <summary>
+/// Number of parents above this transform
+/// </summary>
+unsigned int Transform::GetDepth()
+{
+	unsigned int depth = 0;
+	for (Transform* t = parent; t != nullptr; t = t->parent)
+		depth++;
+	return depth;
+}
+
+/// <summary>
+/// Marks this transform and everything below it as needing new matrices
+/// </summary>
+void Transform::MarkDirty()
+{
+	matrixDirty = true;
+	for (Transform* child : children)
+		child->MarkDirty();
+}
@@ -1,10 +1,17 @@
 #pragma once
 #include <DirectXMath.h>
+#include <vector>
 
 class Transform
 {
 	public:
 		Transform();
+		~Transform();
+
+		// Copies the position, rotation and scale only; the copy starts
+		// out of the hierarchy, and assigning keeps the target's place in it
+		Transform(const Transform& other);
+		Transform& operator=(const Transform& other);
 
 		// Transformations
 		void MoveAbsolute(float x, float y, float z);
@@ -17,6 +24,11 @@ class Transform
 		void SetRotation(float p, float y, float r);
 		void SetScale(float x, float y, float z);
 
+		// Hierarchy
+		void SetParent(Transform* _parent);
+		Transform* GetParent();
+		unsigned int GetDepth();
+
 		// Getters
 		DirectX::XMFLOAT3 GetPosition();
 		DirectX::XMFLOAT3 GetPitchYawRoll();
@@ -48,7 +60,12 @@ class Transform
 		// Matrix Updated
 		bool matrixDirty;
 
+		// Hierarchy (children are not owned)
+		Transform* parent;
+		std::vector<Transform*> children;
+
 		// Helper Function
 		void CreateWorldMatrices();
+		void MarkDirty();
 };
 
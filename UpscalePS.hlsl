@@ -0,0 +1,25 @@
+struct VertexToPixel
+{
+	float4 position			: SV_POSITION;
+	float2 uv				: TEXCOORD;
+};
+
+cbuffer ExternalData : register(b0)
+{
+	float2 uvScale;		// The drawn part of the scene texture: scaled size / full size
+	float2 uvMax;		// Half a texel inside its far edges, so nothing outside it bleeds in
+}
+
+Texture2D Scene				: register(t0);
+SamplerState LinearClamp	: register(s0);
+
+// --------------------------------------------------------
+// Stretches the part of the scene texture that was drawn
+// into (its top left corner) over the whole back buffer,
+// filtered bilinearly
+// --------------------------------------------------------
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	float2 uv = min(input.uv * uvScale, uvMax);
+	return float4(Scene.Sample(LinearClamp, uv).rgb, 1.0f);
+}
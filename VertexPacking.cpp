@@ -0,0 +1,387 @@
+#include "VertexPacking.h"
+#include "CpuUtilities.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VERTEX_PACKING_AVX2
+#if defined(_MSC_VER)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+static const double Degrees = 57.295779513;
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+
+// Which vertices have mirrored UVs: the way v grows across their
+// triangles (dP/dv) agrees with cross(T, N) instead of opposing it.
+// Triangles are weighted by area; ones without UV area are skipped.
+static void FindMirrored(const SourceVertex* vertices, size_t count, const unsigned int* indices, size_t indexCount, std::vector<unsigned char>& mirrored)
+{
+	std::vector<float> bitangents(count * 3, 0.0f);
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const SourceVertex& v1 = vertices[indices[i]];
+		const SourceVertex& v2 = vertices[indices[i + 1]];
+		const SourceVertex& v3 = vertices[indices[i + 2]];
+
+		float s1 = v2.UV[0] - v1.UV[0], t1 = v2.UV[1] - v1.UV[1];
+		float s2 = v3.UV[0] - v1.UV[0], t2 = v3.UV[1] - v1.UV[1];
+		float determinant = s1 * t2 - s2 * t1;
+		if (determinant == 0.0f)
+			continue;
+		float side = determinant > 0.0f ? 1.0f : -1.0f;
+
+		for (int c = 0; c < 3; c++)
+		{
+			float e1 = v2.Position[c] - v1.Position[c];
+			float e2 = v3.Position[c] - v1.Position[c];
+			float bitangent = (s1 * e2 - s2 * e1) * side;
+			for (int corner = 0; corner < 3; corner++)
+				bitangents[indices[i + corner] * 3 + c] += bitangent;
+		}
+	}
+
+	mirrored.assign(count, 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* t = vertices[i].Tangent;
+		const float* n = vertices[i].Normal;
+		const float* b = &bitangents[i * 3];
+		float cross[3] = { t[1] * n[2] - t[2] * n[1], t[2] * n[0] - t[0] * n[2], t[0] * n[1] - t[1] * n[0] };
+		mirrored[i] = cross[0] * b[0] + cross[1] * b[1] + cross[2] * b[2] > 0.0f;
+	}
+}
+
+static void EncodeVertex(const SourceVertex& vertex, const float minimum[3], const float inverseStep[3], bool mirrored, PackedVertex& packed)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		float steps = (vertex.Position[i] - minimum[i]) * inverseStep[i];
+		steps = steps < 0.0f ? 0.0f : (steps > 65535.0f ? 65535.0f : steps);
+		packed.Position[i] = (unsigned short)lrintf(steps);
+	}
+	packed.Position[3] = mirrored ? 0 : 65535;
+	VertexPacking::EncodeOctahedral(vertex.Normal, packed.Normal);
+	VertexPacking::EncodeOctahedral(vertex.Tangent, packed.Tangent);
+	packed.UV[0] = CpuUtilities::FloatToHalf(vertex.UV[0]);
+	packed.UV[1] = CpuUtilities::FloatToHalf(vertex.UV[1]);
+}
+
+#ifdef VERTEX_PACKING_AVX2
+// VertexPacking::EncodeOctahedral(), eight directions at a time
+AVX2_FUNCTION static void EncodeOctahedralAvx2(__m256 x, __m256 y, __m256 z, __m256i& u, __m256i& v)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 minusOne = _mm256_set1_ps(-1.0f);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+	// Zero (or NaN) directions become +Z
+	__m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_and_ps(x, absMask), _mm256_and_ps(y, absMask)), _mm256_and_ps(z, absMask));
+	__m256 valid = _mm256_cmp_ps(sum, zero, _CMP_GT_OQ);
+	x = _mm256_and_ps(x, valid);
+	y = _mm256_and_ps(y, valid);
+	z = _mm256_blendv_ps(one, z, valid);
+	sum = _mm256_blendv_ps(one, sum, valid);
+
+	__m256 inverseSum = _mm256_div_ps(one, sum);
+	__m256 a = _mm256_mul_ps(x, inverseSum);
+	__m256 b = _mm256_mul_ps(y, inverseSum);
+
+	// The lower half folds over the diagonals
+	__m256 signA = _mm256_blendv_ps(minusOne, one, _mm256_cmp_ps(a, zero, _CMP_GE_OQ));
+	__m256 signB = _mm256_blendv_ps(minusOne, one, _mm256_cmp_ps(b, zero, _CMP_GE_OQ));
+	__m256 foldedA = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_and_ps(b, absMask)), signA);
+	__m256 foldedB = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_and_ps(a, absMask)), signB);
+	__m256 lower = _mm256_cmp_ps(z, zero, _CMP_LT_OQ);
+	a = _mm256_blendv_ps(a, foldedA, lower);
+	b = _mm256_blendv_ps(b, foldedB, lower);
+
+	const __m256 scale = _mm256_set1_ps(32767.0f);
+	u = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(a, minusOne), one), scale));
+	v = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(b, minusOne), one), scale));
+}
+
+// CpuUtilities::FloatToHalf(), eight at a time, one half per 32 bit lane
+AVX2_FUNCTION static __m256i FloatToHalfAvx2(__m256 values)
+{
+	__m256i bits = _mm256_castps_si256(values);
+	__m256i sign = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(0x8000));
+	__m256i magnitude = _mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFFFF));
+
+	// Normal halves: rebias the exponent and round away 13 mantissa bits, ties to even.
+	// A carry into the exponent is correct; too big clamps to the largest half.
+	__m256i odd = _mm256_and_si256(_mm256_srli_epi32(magnitude, 13), _mm256_set1_epi32(1));
+	__m256i rounded = _mm256_add_epi32(magnitude, _mm256_add_epi32(_mm256_set1_epi32(0xFFF), odd));
+	__m256i normal = _mm256_sub_epi32(_mm256_srli_epi32(rounded, 13), _mm256_set1_epi32(112 << 10));
+	normal = _mm256_min_epi32(normal, _mm256_set1_epi32(0x7BFF));
+
+	// Subnormal halves: adding 0.5 lines the half's last bit up with the float's,
+	// and the addition rounds to nearest even
+	__m256 shifted = _mm256_add_ps(_mm256_castsi256_ps(magnitude), _mm256_set1_ps(0.5f));
+	__m256i subnormal = _mm256_sub_epi32(_mm256_castps_si256(shifted), _mm256_set1_epi32(0x3F000000));
+	__m256i isSubnormal = _mm256_cmpgt_epi32(_mm256_set1_epi32(0x38800000), magnitude);
+	__m256i half = _mm256_blendv_epi8(normal, subnormal, isSubnormal);
+
+	// Infinity stays infinite; NaN stays NaN
+	__m256i isNan = _mm256_cmpgt_epi32(magnitude, _mm256_set1_epi32(0x7F800000));
+	__m256i special = _mm256_blendv_epi8(_mm256_set1_epi32(0x7C00), _mm256_set1_epi32(0x7E00), isNan);
+	half = _mm256_blendv_epi8(half, special, _mm256_cmpgt_epi32(magnitude, _mm256_set1_epi32(0x7F7FFFFF)));
+	return _mm256_or_si256(half, sign);
+}
+
+// EncodeVertex(), eight vertices at a time, reading them with stride 11 gathers
+// Returns where it stopped; the scalar version finishes the rest
+AVX2_FUNCTION static size_t EncodeAvx2(const SourceVertex* vertices, size_t count, const float minimum[3], const float inverseStep[3], const unsigned char* mirrored, PackedVertex* packed)
+{
+	static_assert(sizeof(SourceVertex) == 11 * sizeof(float), "Gathers assume 11 floats a vertex");
+	const __m256i lanes = _mm256_setr_epi32(0, 11, 22, 33, 44, 55, 66, 77);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 maxSteps = _mm256_set1_ps(65535.0f);
+
+	size_t end = count & ~(size_t)7;
+	for (size_t first = 0; first < end; first += 8)
+	{
+		const float* base = vertices[first].Position;
+
+		// position x, y, z, normal u, v, tangent u, v, uv x, y
+		alignas(32) int values[9][8];
+		for (int i = 0; i < 3; i++)
+		{
+			__m256 position = _mm256_i32gather_ps(base + i, lanes, 4);
+			__m256 steps = _mm256_mul_ps(_mm256_sub_ps(position, _mm256_set1_ps(minimum[i])), _mm256_set1_ps(inverseStep[i]));
+			steps = _mm256_min_ps(_mm256_max_ps(steps, zero), maxSteps);
+			_mm256_store_si256((__m256i*)values[i], _mm256_cvtps_epi32(steps));
+		}
+
+		__m256i u, v;
+		EncodeOctahedralAvx2(_mm256_i32gather_ps(base + 3, lanes, 4), _mm256_i32gather_ps(base + 4, lanes, 4), _mm256_i32gather_ps(base + 5, lanes, 4), u, v);
+		_mm256_store_si256((__m256i*)values[3], u);
+		_mm256_store_si256((__m256i*)values[4], v);
+		EncodeOctahedralAvx2(_mm256_i32gather_ps(base + 8, lanes, 4), _mm256_i32gather_ps(base + 9, lanes, 4), _mm256_i32gather_ps(base + 10, lanes, 4), u, v);
+		_mm256_store_si256((__m256i*)values[5], u);
+		_mm256_store_si256((__m256i*)values[6], v);
+
+		_mm256_store_si256((__m256i*)values[7], FloatToHalfAvx2(_mm256_i32gather_ps(base + 6, lanes, 4)));
+		_mm256_store_si256((__m256i*)values[8], FloatToHalfAvx2(_mm256_i32gather_ps(base + 7, lanes, 4)));
+
+		for (int lane = 0; lane < 8; lane++)
+		{
+			PackedVertex& out = packed[first + lane];
+			out.Position[0] = (unsigned short)values[0][lane];
+			out.Position[1] = (unsigned short)values[1][lane];
+			out.Position[2] = (unsigned short)values[2][lane];
+			out.Position[3] = mirrored[first + lane] ? 0 : 65535;
+			out.Normal[0] = (short)values[3][lane];
+			out.Normal[1] = (short)values[4][lane];
+			out.Tangent[0] = (short)values[5][lane];
+			out.Tangent[1] = (short)values[6][lane];
+			out.UV[0] = (unsigned short)values[7][lane];
+			out.UV[1] = (unsigned short)values[8][lane];
+		}
+	}
+	return end;
+}
+#endif
+
+// Angle between a source direction (not necessarily unit length) and a decoded one.
+// From the cross and dot products in doubles: an arc cosine near 1 can't resolve
+// angles this small.
+static float AngleDegrees(const float source[3], const float decoded[3])
+{
+	double cross[3] = {
+		(double)source[1] * decoded[2] - (double)source[2] * decoded[1],
+		(double)source[2] * decoded[0] - (double)source[0] * decoded[2],
+		(double)source[0] * decoded[1] - (double)source[1] * decoded[0] };
+	double dot = (double)source[0] * decoded[0] + (double)source[1] * decoded[1] + (double)source[2] * decoded[2];
+	double sine = sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+	if (!(sine > 0.0 || dot != 0.0))
+		return 0.0f;
+	return (float)(atan2(sine, dot) * Degrees);
+}
+
+/// <summary>
+/// Packs vertices. Positions are stored relative to their bounding
+/// box, so the returned decode has to be used with them.
+/// </summary>
+/// <param name="indices">Triangles, for the tangents' handedness</param>
+/// <param name="packed">Room for count vertices</param>
+/// <param name="useSimd">AVX2, when the CPU has it. Gives the same result.</param>
+PositionDecode VertexPacking::Encode(const SourceVertex* vertices, size_t count, const unsigned int* indices, size_t indexCount, PackedVertex* packed, bool useSimd)
+{
+	PositionDecode decode;
+	if (count == 0)
+		return decode;
+
+	float minimum[3];
+	float maximum[3];
+	for (int i = 0; i < 3; i++)
+		minimum[i] = maximum[i] = vertices[0].Position[i];
+	for (size_t v = 1; v < count; v++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			minimum[i] = (std::min)(minimum[i], vertices[v].Position[i]);
+			maximum[i] = (std::max)(maximum[i], vertices[v].Position[i]);
+		}
+	}
+
+	// A flat axis has nothing to store
+	float inverseStep[3];
+	for (int i = 0; i < 3; i++)
+	{
+		float extent = maximum[i] - minimum[i];
+		decode.Scale[i] = extent;
+		decode.Offset[i] = minimum[i];
+		inverseStep[i] = extent > 0.0f ? 65535.0f / extent : 0.0f;
+	}
+
+	std::vector<unsigned char> mirrored;
+	FindMirrored(vertices, count, indices, indexCount, mirrored);
+
+	size_t first = 0;
+#ifdef VERTEX_PACKING_AVX2
+	if (useSimd && CpuUtilities::HasAvx2())
+		first = EncodeAvx2(vertices, count, minimum, inverseStep, mirrored.data(), packed);
+#endif
+	for (size_t v = first; v < count; v++)
+		EncodeVertex(vertices[v], minimum, inverseStep, mirrored[v] != 0, packed[v]);
+	return decode;
+}
+
+/// <summary>
+/// Unpacks a vertex the way the vertex shader does
+/// </summary>
+/// <param name="handedness">1, or -1 where the UVs are mirrored</param>
+void VertexPacking::Decode(const PackedVertex& packed, const PositionDecode& decode, SourceVertex& vertex, float& handedness)
+{
+	for (int i = 0; i < 3; i++)
+		vertex.Position[i] = packed.Position[i] / 65535.0f * decode.Scale[i] + decode.Offset[i];
+	DecodeOctahedral(packed.Normal, vertex.Normal);
+	DecodeOctahedral(packed.Tangent, vertex.Tangent);
+	vertex.UV[0] = CpuUtilities::HalfToFloat(packed.UV[0]);
+	vertex.UV[1] = CpuUtilities::HalfToFloat(packed.UV[1]);
+	handedness = packed.Position[3] >= 32768 ? 1.0f : -1.0f;
+}
+
+/// <summary>
+/// Compares packed vertices with their sources, along with the
+/// errors rounding alone allows for positions and UVs. Directions
+/// are off by at most about 0.004 degrees at 16 bits.
+/// </summary>
+VertexPackingError VertexPacking::Measure(const SourceVertex* vertices, const PackedVertex* packed, size_t count, const PositionDecode& decode)
+{
+	VertexPackingError error;
+	for (int i = 0; i < 3; i++)
+	{
+		float rounding = (fabsf(decode.Offset[i]) + decode.Scale[i]) * FLT_EPSILON;
+		error.PositionBound = (std::max)(error.PositionBound, decode.Scale[i] / 65535.0f * 0.5f + rounding);
+	}
+
+	for (size_t v = 0; v < count; v++)
+	{
+		SourceVertex decoded;
+		float handedness;
+		Decode(packed[v], decode, decoded, handedness);
+		if (handedness < 0.0f)
+			error.Mirrored++;
+
+		for (int i = 0; i < 3; i++)
+			error.MaxPosition = (std::max)(error.MaxPosition, fabsf(decoded.Position[i] - vertices[v].Position[i]));
+		error.MaxNormalDegrees = (std::max)(error.MaxNormalDegrees, AngleDegrees(vertices[v].Normal, decoded.Normal));
+		error.MaxTangentDegrees = (std::max)(error.MaxTangentDegrees, AngleDegrees(vertices[v].Tangent, decoded.Tangent));
+
+		// Halves keep 11 significant bits; below 2^-14 the step is fixed
+		for (int i = 0; i < 2; i++)
+		{
+			error.MaxUv = (std::max)(error.MaxUv, fabsf(decoded.UV[i] - vertices[v].UV[i]));
+			float magnitude = fabsf(vertices[v].UV[i]);
+			int exponent = 0;
+			frexpf(magnitude, &exponent);
+			float bound = magnitude < 6.103515625e-05f ? ldexpf(1.0f, -25) : ldexpf(1.0f, exponent - 12);
+			error.UvBound = (std::max)(error.UvBound, bound);
+		}
+	}
+	return error;
+}
+
+/// <summary>
+/// Splits packed vertices into a position stream and an
+/// attribute stream (see SimpleVertexShader's input slots)
+/// </summary>
+void VertexPacking::SplitStreams(const PackedVertex* packed, size_t count, PackedPosition* positions, PackedAttributes* attributes)
+{
+	static_assert(sizeof(PackedPosition) + sizeof(PackedAttributes) == sizeof(PackedVertex), "The streams hold exactly a packed vertex");
+	static_assert(offsetof(PackedVertex, Normal) == sizeof(PackedPosition), "Attributes follow the position");
+	for (size_t v = 0; v < count; v++)
+	{
+		memcpy(positions[v].Position, packed[v].Position, sizeof(PackedPosition));
+		memcpy(attributes[v].Normal, packed[v].Normal, sizeof(PackedAttributes));
+	}
+}
+
+/// <summary>
+/// Folds a direction onto the octahedron |x| + |y| + |z| = 1 and
+/// flattens it, the lower half over the diagonals, into a square
+/// of 16 bit signed normalized values. Zero becomes +Z.
+/// </summary>
+void VertexPacking::EncodeOctahedral(const float direction[3], short encoded[2])
+{
+	float x = direction[0];
+	float y = direction[1];
+	float z = direction[2];
+	float sum = fabsf(x) + fabsf(y) + fabsf(z);
+	if (!(sum > 0.0f))
+	{
+		x = 0.0f;
+		y = 0.0f;
+		z = 1.0f;
+		sum = 1.0f;
+	}
+
+	float inverseSum = 1.0f / sum;
+	float a = x * inverseSum;
+	float b = y * inverseSum;
+	if (z < 0.0f)
+	{
+		float foldedA = (1.0f - fabsf(b)) * (a >= 0.0f ? 1.0f : -1.0f);
+		float foldedB = (1.0f - fabsf(a)) * (b >= 0.0f ? 1.0f : -1.0f);
+		a = foldedA;
+		b = foldedB;
+	}
+
+	a = a < -1.0f ? -1.0f : (a > 1.0f ? 1.0f : a);
+	b = b < -1.0f ? -1.0f : (b > 1.0f ? 1.0f : b);
+	encoded[0] = (short)lrintf(a * 32767.0f);
+	encoded[1] = (short)lrintf(b * 32767.0f);
+}
+
+/// <summary>
+/// Unit direction from EncodeOctahedral(), like DecodeOctahedral()
+/// in ShaderIncludes.hlsli
+/// </summary>
+void VertexPacking::DecodeOctahedral(const short encoded[2], float direction[3])
+{
+	float x = (std::max)(encoded[0] / 32767.0f, -1.0f);
+	float y = (std::max)(encoded[1] / 32767.0f, -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float t = (std::max)(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float inverseLength = 1.0f / sqrtf(x * x + y * y + z * z);
+	direction[0] = x * inverseLength;
+	direction[1] = y * inverseLength;
+	direction[2] = z * inverseLength;
+}
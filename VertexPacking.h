@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stddef.h>
+
+// A vertex as meshes are built: full floats, 44 bytes. Same layout as Vertex.h's,
+// without DirectXMath, so the packing builds anywhere.
+struct SourceVertex
+{
+	float Position[3];
+	float Normal[3];
+	float UV[2];
+	float Tangent[3];
+};
+
+// A vertex as the GPU reads it, 20 bytes. Must match VertexShaderInput
+// in ShaderIncludes.hlsli, whose semantics pick these formats.
+struct PackedVertex
+{
+	unsigned short Position[4];	// UNORM16 across the mesh's box; w is the tangent's handedness (0 is -1, 65535 is +1)
+	short Normal[2];			// Octahedral, SNORM16
+	short Tangent[2];			// Octahedral, SNORM16
+	unsigned short UV[2];		// Half floats
+};
+
+// A PackedVertex split in two streams: positions alone, 8 bytes, for
+// depth-only passes, and everything else, 12 bytes, for the rest
+struct PackedPosition
+{
+	unsigned short Position[4];
+};
+
+struct PackedAttributes
+{
+	short Normal[2];
+	short Tangent[2];
+	unsigned short UV[2];
+};
+
+// Turns a packed position back into model space: unorm * Scale + Offset
+struct PositionDecode
+{
+	float Scale[3] = { 1.0f, 1.0f, 1.0f };	// The box's size
+	float Offset[3] = {};					// Its minimum corner
+};
+
+// Largest differences between packed vertices and their sources
+struct VertexPackingError
+{
+	float MaxPosition = 0.0f;		// Model space units, along any axis
+	float PositionBound = 0.0f;		// Half a step along the box's longest axis, plus float rounding
+	float MaxNormalDegrees = 0.0f;
+	float MaxTangentDegrees = 0.0f;
+	float MaxUv = 0.0f;
+	float UvBound = 0.0f;			// Half a half float step at the largest UV
+	unsigned int Mirrored = 0;		// Vertices whose tangent handedness is -1
+};
+
+// What packing a model saved, and what it cost
+struct VertexPackingReport
+{
+	unsigned int Vertices = 0;
+	size_t SourceBytes = 0;
+	size_t PackedBytes = 0;
+	double EncodeMs = 0.0;
+	VertexPackingError Error;
+};
+
+// --------------------------------------------------------
+// Packs vertices from 44 bytes to 20: positions as 16 bit
+// fractions of the mesh's bounding box, normals and tangents
+// as 16 bit octahedral coordinates, UVs as half floats.
+// Every attribute is one the input assembler expands on its
+// own, so the vertex shader reads floats and only has to
+// scale the position and unfold the two directions.
+//
+// Tangents get a handedness, from the triangles' UVs, so
+// mirrored UVs get their bitangents flipped; unmirrored
+// ones keep cross(T, N), as before.
+//
+// The encoder runs eight vertices at a time with AVX2; the
+// scalar version gives exactly the same bits.
+// --------------------------------------------------------
+class VertexPacking
+{
+	public:
+		static PositionDecode Encode(const SourceVertex* vertices, size_t count, const unsigned int* indices, size_t indexCount, PackedVertex* packed, bool useSimd = true);
+		static void Decode(const PackedVertex& packed, const PositionDecode& decode, SourceVertex& vertex, float& handedness);
+		static VertexPackingError Measure(const SourceVertex* vertices, const PackedVertex* packed, size_t count, const PositionDecode& decode);
+		static void SplitStreams(const PackedVertex* packed, size_t count, PackedPosition* positions, PackedAttributes* attributes);
+
+		// Helpers
+		static void EncodeOctahedral(const float direction[3], short encoded[2]);
+		static void DecodeOctahedral(const short encoded[2], float direction[3]);
+};
@@ -4,12 +4,23 @@
 // Allows us to store data on the GPU
 cbuffer ExternalData : register(b0)
 {
+#ifndef BATCHED
 	matrix world;
 	matrix worldInvTranspose;
+#endif
 	matrix view;
 	matrix projection;
+	float3 positionScale;	// The mesh's, to unpack positions
+	float3 positionOffset;
+#ifdef BATCHED
+	uint instanceOffset;	// SV_InstanceID always starts at zero
+#endif
 }
 
+#ifdef BATCHED
+StructuredBuffer<InstanceData> Instances : register(t0);
+#endif
+
 // --------------------------------------------------------
 // The entry point (main method) for our vertex shader
 // 
@@ -17,19 +28,34 @@ cbuffer ExternalData : register(b0)
 // - Output is a single struct of data to pass down the pipeline
 // - Named "main" because that's the default the shader compiler looks for
 // --------------------------------------------------------
+#ifdef BATCHED
+VertexToPixel main( VertexShaderInput input, uint instanceID : SV_InstanceID )
+#else
 VertexToPixel main( VertexShaderInput input )
+#endif
 {
 	// Set up output struct
 	VertexToPixel output;
-	
-	matrix wvp = mul(mul(projection, view), world);
-	output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+
+#ifdef BATCHED
+	InstanceData instance = Instances[instanceOffset + instanceID];
+	matrix world = instance.world;
+	matrix worldInvTranspose = instance.worldInvTranspose;
+	output.materialIndex = instance.materialIndex;
+#endif
+
+	// Unpacks the vertex
+	float3 localPosition = UnpackPosition(input.packedPosition, positionScale, positionOffset);
+	float3 normal = DecodeOctahedral(input.packedNormal);
+	float3 tangent = DecodeOctahedral(input.packedTangent);
+
+	output.screenPosition = ProjectPosition(localPosition, world, view, projection);
 	output.uv = input.uv;
 	
 	// Translating Normals
-	output.normal = mul((float3x3)worldInvTranspose, input.normal);
-	output.tangent = mul((float3x3)worldInvTranspose, input.tangent);
-	output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
+	output.normal = mul((float3x3)worldInvTranspose, normal);
+	output.tangent = float4(mul((float3x3)worldInvTranspose, tangent), input.packedPosition.w * 2.0f - 1.0f);
+	output.worldPosition = mul(world, float4(localPosition, 1)).xyz;
 
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)